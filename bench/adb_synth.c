@@ -0,0 +1,180 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Copyright (C) 2008 Liam Girdwood
+ */
+
+/*
+ * Writes a synthetic CDS catalog and plates with known solutions.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "synth.h"
+
+#define D2R (1.7453292519943295769e-2) /* deg->radian */
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+			"usage: %s [options] directory\n"
+			"catalog:\n"
+			"  -t name         table name, default synth\n"
+			"  -n objects      number of objects, default 1000000\n"
+			"  -a density      objects per square degree instead of -n\n"
+			"  -m min,max      magnitude range, default 0,16\n"
+			"  -l slope        log10 count increase per magnitude, default "
+			"0.35\n"
+			"  -c clusters     number of clusters, default 0\n"
+			"  -f fraction     fraction of objects in clusters, default 0.5\n"
+			"  -w sigma        cluster radius in degrees, default 2\n"
+			"  -s seed         random seed, default 1\n"
+			"plates:\n"
+			"  -p plates       number of plates, default 0\n"
+			"  -o objects      catalog objects per plate, default 8\n"
+			"  -k skip         brightest objects missing, default 0\n"
+			"  -x distractors  objects without a catalog object, default 0\n"
+			"  -e noise        position noise in pixels, default 0.5\n"
+			"  -g noise        magnitude noise, default 0.05\n"
+			"  -r scale        arc seconds per pixel, default 20\n",
+			name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct synth_catalog cat;
+	struct synth_plate plate, defaults;
+	struct adb_pobject *pobject;
+	char file[1024];
+	int opt, plates = 0, i, count, ret, fraction = 0;
+	long *seq;
+
+	synth_catalog_init(&cat, "synth", 1000000);
+	synth_plate_init(&defaults, 0.0, 0.0);
+	cat.cluster_fraction = 0.5;
+
+	while ((opt = getopt(argc, argv, "t:n:a:m:l:c:f:w:s:p:o:k:x:e:g:r:h")) !=
+		   -1) {
+		switch (opt) {
+		case 't':
+			cat.name = optarg;
+			break;
+		case 'n':
+			cat.objects = atol(optarg);
+			break;
+		case 'a':
+			cat.objects = atof(optarg) * 4.0 * M_PI / (D2R * D2R);
+			break;
+		case 'm':
+			if (sscanf(optarg, "%lf,%lf", &cat.mag_min, &cat.mag_max) != 2) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'l':
+			cat.mag_slope = atof(optarg);
+			break;
+		case 'c':
+			cat.clusters = atoi(optarg);
+			break;
+		case 'f':
+			cat.cluster_fraction = atof(optarg);
+			fraction = 1;
+			break;
+		case 'w':
+			cat.cluster_sigma = atof(optarg);
+			break;
+		case 's':
+			cat.seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'p':
+			plates = atoi(optarg);
+			break;
+		case 'o':
+			defaults.objects = atoi(optarg);
+			break;
+		case 'k':
+			defaults.skip = atoi(optarg);
+			break;
+		case 'x':
+			defaults.distractors = atoi(optarg);
+			break;
+		case 'e':
+			defaults.noise = atof(optarg);
+			break;
+		case 'g':
+			defaults.mag_noise = atof(optarg);
+			break;
+		case 'r':
+			defaults.scale = atof(optarg) / 3600.0 * D2R;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind != argc - 1 || cat.objects <= 0 || cat.seed == 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (fraction && cat.clusters == 0)
+		fprintf(stderr, "warning: -f has no effect without -c\n");
+
+	ret = synth_catalog_write(&cat, argv[optind]);
+	if (ret < 0) {
+		fprintf(stderr, "error: can't write catalog in %s: %s\n",
+				argv[optind], strerror(-ret));
+		return EXIT_FAILURE;
+	}
+	printf("wrote %ld objects to %s/%s.dat\n", cat.objects, argv[optind],
+		   cat.name);
+
+	pobject = calloc(defaults.objects + defaults.distractors,
+					 sizeof(*pobject));
+	seq = calloc(defaults.objects + defaults.distractors, sizeof(*seq));
+	if (pobject == NULL || seq == NULL)
+		return EXIT_FAILURE;
+
+	/* plates at reproducible positions and rotations */
+	for (i = 0; i < plates; i++) {
+		plate = defaults;
+		synth_plate_random(&plate, cat.seed + i + 1);
+
+		count = synth_plate_new(&plate, &cat, pobject, seq);
+		if (count < 0) {
+			fprintf(stderr, "error: plate %d has no objects\n", i);
+			continue;
+		}
+
+		snprintf(file, sizeof(file), "%s/plate%d.txt", argv[optind], i);
+		ret = synth_plate_write(&plate, pobject, seq, count, file);
+		if (ret < 0) {
+			fprintf(stderr, "error: can't write %s: %s\n", file,
+					strerror(-ret));
+			break;
+		}
+		printf("wrote %d plate objects to %s\n", count, file);
+	}
+
+	free(pobject);
+	free(seq);
+	return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,734 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Copyright (C) 2008 Liam Girdwood
+ */
+
+/*
+ * Benchmarks import, open, cone, nearest, hash and solve performance on the
+ * bundled Sky2000 and NGC catalogs and on synthetic uniform and clustered
+ * catalogs, and writes the results as JSON.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <time.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include <libastrodb/db-import.h>
+#include <libastrodb/db.h>
+#include <libastrodb/object.h>
+#include <libastrodb/solve.h>
+
+#include "synth.h"
+
+#define D2R (1.7453292519943295769e-2) /* deg->radian */
+
+#ifndef BENCH_DATA_DIR
+#define BENCH_DATA_DIR "tests"
+#endif
+
+#define HOST "cdsarc.u-strasbg.fr"
+#define REMOTE "/pub/cats"
+
+/* synthetic catalog directory and clusters */
+#define SYNTH_CLASS "S"
+#define SYNTH_ID "1"
+#define CLUSTERS 32
+
+#define LOOKUPS 1024
+
+struct ngc_object {
+	struct adb_object object;
+	unsigned char type[4];
+	char desc[51];
+};
+
+static struct adb_schema_field ngc_fields[] = {
+	adb_member("Name", "Name", struct ngc_object, object.designation,
+			   ADB_CTYPE_STRING, "", 0, NULL),
+	adb_member("Type", "Type", struct ngc_object, type, ADB_CTYPE_STRING, "",
+			   0, NULL),
+	adb_gmember("RA Hours", "RAh", struct ngc_object, object.ra,
+				ADB_CTYPE_DOUBLE_HMS_HRS, "hours", 1, NULL),
+	adb_gmember("RA Minutes", "RAm", struct ngc_object, object.ra,
+				ADB_CTYPE_DOUBLE_HMS_MINS, "minutes", 0, NULL),
+	adb_gmember("DEC Degrees", "DEd", struct ngc_object, object.dec,
+				ADB_CTYPE_DOUBLE_DMS_DEGS, "degrees", 2, NULL),
+	adb_gmember("DEC Minutes", "DEm", struct ngc_object, object.dec,
+				ADB_CTYPE_DOUBLE_DMS_MINS, "minutes", 1, NULL),
+	adb_gmember("DEC sign", "DE-", struct ngc_object, object.dec,
+				ADB_CTYPE_SIGN, "", 0, NULL),
+	adb_member("Integrated Mag", "mag", struct ngc_object, object.mag,
+			   ADB_CTYPE_FLOAT, "", 0, NULL),
+	adb_member("Description", "Desc", struct ngc_object, desc,
+			   ADB_CTYPE_STRING, "", 0, NULL),
+	adb_member("Largest Dimension", "size", struct ngc_object, object.size,
+			   ADB_CTYPE_FLOAT, "arcmin", 0, NULL),
+};
+
+/* Pleiades M45 plate objects */
+static struct adb_pobject pobject[] = {
+	{ 513, 434, 408725 }, /* Alcyone 25 */
+	{ 141, 545, 123643 }, /* 1 Atlas 27 */
+	{ 1049, 197, 128424 }, /* P Electra 17 */
+	{ 956, 517, 106906 }, /* 2 Maia 20 */
+	{ 682, 180, 98841 }, /* 3 Morope 23 */
+};
+
+/* cone radius in degrees and faintest magnitude of each cone query */
+static const double cone_fov[] = { 1.0, 5.0, 15.0, 45.0 };
+static const double cone_mag[] = { 6.0, 10.0, 16.0 };
+
+struct bench {
+	const char *data; /* bundled catalog directory */
+	char work[256]; /* import directory */
+	int size; /* synthetic catalog objects */
+	int iterations; /* queries per measurement */
+	int depth; /* HTM depth */
+	int solves; /* solves timed */
+	uint64_t seed; /* synthetic catalog and plate seed */
+	uint64_t rng; /* query position xorshift state */
+	FILE *out;
+	int catalogs; /* catalogs written */
+};
+
+/* plate solved by the benchmark */
+struct bench_plate {
+	struct adb_pobject *pobject;
+	const long *seq; /* known catalog objects or NULL */
+	int count;
+	double faint, bright; /* magnitude constraint */
+	double fov; /* largest plate FOV in radians */
+};
+
+struct import_result {
+	int objects;
+	long bytes;
+	double secs;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* reproducible uniform deviate in [0, 1) */
+static double rng_uniform(struct bench *b)
+{
+	b->rng ^= b->rng >> 12;
+	b->rng ^= b->rng << 25;
+	b->rng ^= b->rng >> 27;
+	return ((b->rng * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+/* uniform position on the sphere in radians */
+static void rng_position(struct bench *b, double *ra, double *dec)
+{
+	*ra = 2.0 * M_PI * rng_uniform(b);
+	*dec = asin(2.0 * rng_uniform(b) - 1.0);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int count, double p)
+{
+	return sorted[(int)(p * (count - 1) + 0.5)];
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int flag,
+						struct FTW *ftw)
+{
+	return remove(path);
+}
+
+static int make_dirs(const char *root, const char *lib,
+					 const char *cat_class, const char *cat_id)
+{
+	char path[512];
+
+	snprintf(path, sizeof(path), "%s/%s", root, lib);
+	if (mkdir(path, 0755) < 0 && errno != EEXIST)
+		return -errno;
+	snprintf(path, sizeof(path), "%s/%s/%s", root, lib, cat_class);
+	if (mkdir(path, 0755) < 0 && errno != EEXIST)
+		return -errno;
+	snprintf(path, sizeof(path), "%s/%s/%s/%s", root, lib, cat_class, cat_id);
+	if (mkdir(path, 0755) < 0 && errno != EEXIST)
+		return -errno;
+	return 0;
+}
+
+static int copy_file(const char *from, const char *to)
+{
+	char buf[65536];
+	FILE *in, *out;
+	size_t n;
+
+	in = fopen(from, "r");
+	if (in == NULL)
+		return -errno;
+	out = fopen(to, "w");
+	if (out == NULL) {
+		fclose(in);
+		return -errno;
+	}
+
+	while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+		fwrite(buf, 1, n, out);
+
+	fclose(in);
+	fclose(out);
+	return 0;
+}
+
+static int copy_ngc(struct bench *b)
+{
+	char from[512], to[512];
+	int ret;
+
+	ret = make_dirs(b->work, "ngc", "VII", "118");
+	if (ret < 0)
+		return ret;
+
+	snprintf(from, sizeof(from), "%s/VII/118/ReadMe", b->data);
+	snprintf(to, sizeof(to), "%s/ngc/VII/118/ReadMe", b->work);
+	ret = copy_file(from, to);
+	if (ret < 0)
+		return ret;
+
+	snprintf(from, sizeof(from), "%s/VII/118/ngc2000.dat", b->data);
+	snprintf(to, sizeof(to), "%s/ngc/VII/118/ngc2000.dat", b->work);
+	return copy_file(from, to);
+}
+
+/* import the raw NGC catalog */
+static int import_ngc(struct adb_db *db)
+{
+	int table_id, ret;
+
+	table_id = adb_table_import_new(db, "VII", "118", "ngc2000", "mag", 0.0,
+									18.0, ADB_IMPORT_INC);
+	if (table_id < 0)
+		return table_id;
+
+	ret = adb_table_import_schema(db, table_id, ngc_fields,
+								  adb_size(ngc_fields),
+								  sizeof(struct ngc_object));
+	if (ret >= 0)
+		ret = adb_table_import(db, table_id);
+	if (ret < 0) {
+		adb_table_close(db, table_id);
+		return ret;
+	}
+
+	return table_id;
+}
+
+/* import the NGC catalog, or a synthetic catalog, in lib and time it */
+static int import_catalog(struct bench *b, const char *lib,
+						  const struct synth_catalog *cat,
+						  struct import_result *result)
+{
+	struct adb_library *library;
+	struct adb_db *db;
+	char path[512];
+	struct stat st;
+	double start;
+	int table_id, ret;
+
+	if (cat)
+		snprintf(path, sizeof(path), "%s/%s/%s/%s/%s.dat", b->work, lib,
+				 SYNTH_CLASS, SYNTH_ID, cat->name);
+	else
+		snprintf(path, sizeof(path), "%s/%s/VII/118/ngc2000.dat", b->work,
+				 lib);
+	if (stat(path, &st) < 0)
+		return -errno;
+	result->bytes = st.st_size;
+
+	snprintf(path, sizeof(path), "%s/%s", b->work, lib);
+	library = adb_open_library(HOST, REMOTE, path);
+	if (library == NULL)
+		return -ENOMEM;
+
+	db = adb_create_db(library, b->depth, 1);
+	if (db == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	adb_set_msg_level(db, ADB_MSG_NONE);
+
+	start = now();
+	if (cat)
+		table_id = synth_catalog_import(db, SYNTH_CLASS, SYNTH_ID, cat);
+	else
+		table_id = import_ngc(db);
+	result->secs = now() - start;
+
+	if (table_id >= 0) {
+		ret = result->objects = adb_table_get_count(db, table_id);
+		adb_table_close(db, table_id);
+	} else
+		ret = table_id;
+
+	adb_db_free(db);
+out:
+	adb_close_library(library);
+	return ret;
+}
+
+static void bench_cones(struct bench *b, struct adb_object_set *set)
+{
+	double *latency, ra, dec, start;
+	long objects;
+	int f, m, i;
+
+	latency = calloc(b->iterations, sizeof(*latency));
+	if (latency == NULL)
+		return;
+
+	fprintf(b->out, "      \"cones\": [");
+	for (f = 0; f < (int)adb_size(cone_fov); f++) {
+		for (m = 0; m < (int)adb_size(cone_mag); m++) {
+			objects = 0;
+			for (i = 0; i < b->iterations; i++) {
+				rng_position(b, &ra, &dec);
+				start = now();
+				adb_table_set_constraints(set, ra, dec, cone_fov[f] * D2R,
+										  -2.0, cone_mag[m]);
+				adb_set_get_objects(set);
+				latency[i] = (now() - start) * 1e6;
+				objects += adb_set_get_count(set);
+			}
+
+			qsort(latency, b->iterations, sizeof(*latency), cmp_double);
+			fprintf(b->out,
+					"%s\n        { \"fov_deg\": %.1f, \"max_mag\": %.1f, "
+					"\"objects\": %.1f, \"p50_us\": %.3f, \"p90_us\": %.3f, "
+					"\"p99_us\": %.3f }",
+					f || m ? "," : "", cone_fov[f], cone_mag[m],
+					(double)objects / b->iterations,
+					percentile(latency, b->iterations, 0.5),
+					percentile(latency, b->iterations, 0.9),
+					percentile(latency, b->iterations, 0.99));
+		}
+	}
+	fprintf(b->out, "\n      ],\n");
+	free(latency);
+}
+
+static double bench_nearest(struct bench *b, struct adb_object_set *set)
+{
+	double ra, dec, start;
+	int i, count = b->iterations * 10;
+
+	adb_table_set_constraints(set, 0.0, 0.0, 2.0 * M_PI, -2.0, 18.0);
+	adb_set_get_objects(set);
+
+	start = now();
+	for (i = 0; i < count; i++) {
+		rng_position(b, &ra, &dec);
+		adb_table_set_get_nearest_on_pos(set, ra, dec);
+	}
+	return count / (now() - start);
+}
+
+/* look up keys sampled from the whole table */
+static double bench_hash(struct bench *b, struct adb_db *db, int table_id,
+						 struct adb_object_set *set, const char *key)
+{
+	const struct adb_object_head *head;
+	const struct adb_object *object;
+	int keys[LOOKUPS], heads, offset, size, i, j, n = 0;
+	double start;
+
+	if (adb_table_hash_key(db, table_id, key) < 0)
+		return 0.0;
+	offset = adb_table_get_field_offset(db, table_id, key);
+	if (offset < 0)
+		return 0.0;
+	size = adb_table_get_object_size(db, table_id);
+
+	adb_table_set_constraints(set, 0.0, 0.0, 2.0 * M_PI, -2.0, 18.0);
+	heads = adb_set_get_objects(set);
+	head = adb_set_get_head(set);
+	for (i = 0; i < heads && n < LOOKUPS; i++) {
+		object = head[i].objects;
+		for (j = 0; j < head[i].count && n < LOOKUPS; j += 7) {
+			memcpy(&keys[n++], (const char *)object + j * size + offset,
+				   sizeof(int));
+		}
+	}
+	if (n == 0)
+		return 0.0;
+
+	start = now();
+	for (i = 0; i < b->iterations * 10; i++) {
+		adb_table_get_object(db, table_id, &keys[i % n], key, &object);
+	}
+	return b->iterations * 10 / (now() - start);
+}
+
+/* plate objects solved to their known catalog objects */
+static int solve_matched(struct adb_solve *solve, int table_id,
+						 const struct bench_plate *plate)
+{
+	struct adb_solve_solution *solution;
+	struct adb_solve_object *sobject;
+	const struct synth_object *object;
+	int i, matched = 0;
+
+	solution = adb_solve_get_solution(solve, 0);
+	if (solution == NULL ||
+		adb_solution_set_search_limits(solution, plate->fov, plate->faint,
+									   table_id) < 0 ||
+		adb_solution_add_pobjects(solution,
+								  (struct adb_pobject *)plate->pobject,
+								  plate->count) < 0 ||
+		adb_solution_get_objects(solution) < 0)
+		return 0;
+
+	for (i = 0; i < plate->count; i++) {
+		sobject = adb_solution_get_object(solution, i);
+		if (sobject == NULL || sobject->object == NULL)
+			continue;
+		object = (const struct synth_object *)sobject->object;
+		if (object->seq == plate->seq[i])
+			matched++;
+	}
+
+	return matched;
+}
+
+static void bench_solve(struct bench *b, struct adb_db *db, int table_id,
+						struct adb_object_set *set,
+						const struct bench_plate *plate)
+{
+	struct adb_solve *solve;
+	double *latency, start;
+	int i, j, found = 0, matched = 0;
+
+	latency = calloc(b->solves, sizeof(*latency));
+	if (latency == NULL)
+		return;
+
+	adb_table_set_constraints(set, 0.0, 0.0, 2.0 * M_PI, -2.0, 18.0);
+
+	for (i = 0; i < b->solves; i++) {
+		solve = adb_solve_new(db, table_id);
+		if (solve == NULL)
+			break;
+		adb_solve_constraint(solve, ADB_CONSTRAINT_MAG, plate->faint,
+							 plate->bright);
+		adb_solve_constraint(solve, ADB_CONSTRAINT_FOV, 0.1 * D2R,
+							 plate->fov);
+		for (j = 0; j < plate->count; j++)
+			adb_solve_add_plate_object(solve, &plate->pobject[j]);
+		adb_solve_set_magnitude_delta(solve, 0.5);
+		adb_solve_set_distance_delta(solve, 5.0);
+		adb_solve_set_pa_delta(solve, 2.0 * D2R);
+
+		start = now();
+		found = adb_solve(solve, set, ADB_FIND_FIRST);
+		latency[i] = (now() - start) * 1e3;
+		if (found > 0 && plate->seq)
+			matched = solve_matched(solve, table_id, plate);
+		adb_solve_free(solve);
+	}
+
+	if (i > 0) {
+		qsort(latency, i, sizeof(*latency), cmp_double);
+		fprintf(b->out,
+				"      \"solve\": { \"runs\": %d, \"plate_objects\": %d, "
+				"\"found\": %d, ",
+				i, plate->count, found);
+		if (plate->seq)
+			fprintf(b->out, "\"matched\": %d, ", matched);
+		fprintf(b->out,
+				"\"min_ms\": %.3f, \"p50_ms\": %.3f, \"max_ms\": %.3f },\n",
+				latency[0], percentile(latency, i, 0.5), latency[i - 1]);
+	}
+	free(latency);
+}
+
+/* open a catalog, time it and run the queries */
+static int bench_table(struct bench *b, const char *label, const char *dir,
+					   const char *cat_class, const char *cat_id,
+					   const char *name, const struct import_result *import,
+					   const char *key, const struct bench_plate *plate)
+{
+	struct adb_object_set *set;
+	struct adb_library *lib;
+	struct adb_db *db;
+	double start, open;
+	int table_id, ret = 0;
+
+	lib = adb_open_library(HOST, REMOTE, dir);
+	if (lib == NULL)
+		return -ENOMEM;
+
+	db = adb_create_db(lib, b->depth, 1);
+	if (db == NULL) {
+		ret = -ENOMEM;
+		goto db_err;
+	}
+	adb_set_msg_level(db, ADB_MSG_NONE);
+
+	start = now();
+	table_id = adb_table_open(db, cat_class, cat_id, name);
+	open = (now() - start) * 1e3;
+	if (table_id < 0) {
+		fprintf(stderr, "error: can't open %s/%s/%s %d\n", cat_class, cat_id,
+				name, table_id);
+		ret = table_id;
+		goto table_err;
+	}
+
+	set = adb_table_set_new(db, table_id);
+	if (set == NULL) {
+		ret = -ENOMEM;
+		goto set_err;
+	}
+
+	fprintf(b->out, "%s\n    {\n", b->catalogs++ ? "," : "");
+	fprintf(b->out, "      \"name\": \"%s\",\n", label);
+	fprintf(b->out, "      \"table\": \"%s/%s/%s\",\n", cat_class, cat_id,
+			name);
+	fprintf(b->out, "      \"objects\": %d,\n",
+			adb_table_get_count(db, table_id));
+	if (import)
+		fprintf(b->out,
+				"      \"import\": { \"objects\": %d, \"seconds\": %.6f, "
+				"\"objects_per_sec\": %.1f, \"bytes_per_sec\": %.1f },\n",
+				import->objects, import->secs, import->objects / import->secs,
+				import->bytes / import->secs);
+	fprintf(b->out, "      \"open_ms\": %.3f,\n", open);
+
+	bench_cones(b, set);
+	if (key)
+		fprintf(b->out, "      \"hash_qps\": %.1f,\n",
+				bench_hash(b, db, table_id, set, key));
+	if (plate)
+		bench_solve(b, db, table_id, set, plate);
+	fprintf(b->out, "      \"nearest_qps\": %.1f\n    }",
+			bench_nearest(b, set));
+
+	adb_table_set_free(set);
+set_err:
+	adb_table_close(db, table_id);
+table_err:
+	adb_db_free(db);
+db_err:
+	adb_close_library(lib);
+	return ret;
+}
+
+/* import the NGC catalog in the work directory and benchmark it */
+static int bench_ngc(struct bench *b, const char *lib)
+{
+	struct import_result import;
+	char dir[512];
+	int ret;
+
+	ret = copy_ngc(b);
+	if (ret < 0)
+		return ret;
+
+	ret = import_catalog(b, lib, NULL, &import);
+	if (ret < 0) {
+		fprintf(stderr, "error: can't import %s catalog %d\n", lib, ret);
+		return ret;
+	}
+
+	snprintf(dir, sizeof(dir), "%s/%s", b->work, lib);
+	return bench_table(b, lib, dir, "VII", "118", "ngc2000", &import, NULL,
+					   NULL);
+}
+
+/* generate, import, query and solve a synthetic catalog */
+static int bench_synthetic(struct bench *b, const char *lib, int clusters)
+{
+	struct adb_pobject pobject[ADB_NUM_TARGETS];
+	long seq[ADB_NUM_TARGETS];
+	struct import_result import;
+	struct synth_catalog cat;
+	struct synth_plate plate;
+	struct bench_plate solve;
+	char dir[512];
+	int ret;
+
+	synth_catalog_init(&cat, "synth", b->size);
+	cat.clusters = clusters;
+	cat.cluster_fraction = 1.0;
+	cat.seed = b->seed;
+
+	ret = make_dirs(b->work, lib, SYNTH_CLASS, SYNTH_ID);
+	if (ret < 0)
+		return ret;
+	snprintf(dir, sizeof(dir), "%s/%s/%s/%s", b->work, lib, SYNTH_CLASS,
+			 SYNTH_ID);
+	ret = synth_catalog_write(&cat, dir);
+	if (ret < 0)
+		return ret;
+
+	ret = import_catalog(b, lib, &cat, &import);
+	if (ret < 0) {
+		fprintf(stderr, "error: can't import %s catalog %d\n", lib, ret);
+		return ret;
+	}
+
+	/* solve a plate with a known solution */
+	synth_plate_init(&plate, 0.0, 0.0);
+	synth_plate_random(&plate, b->seed);
+	memset(&solve, 0, sizeof(solve));
+	ret = synth_plate_new(&plate, &cat, pobject, seq);
+	if (ret > 0) {
+		solve.pobject = pobject;
+		solve.seq = seq;
+		solve.count = ret;
+		solve.bright = plate.zero_point - 2.5 * log10(pobject[0].adu) - 1.0;
+		solve.faint =
+			plate.zero_point - 2.5 * log10(pobject[ret - 1].adu) + 1.0;
+		solve.fov = 1.2 * plate.scale * hypot(plate.width, plate.height);
+	}
+
+	snprintf(dir, sizeof(dir), "%s/%s", b->work, lib);
+	return bench_table(b, lib, dir, SYNTH_CLASS, SYNTH_ID, cat.name, &import,
+					   "Seq", ret > 0 ? &solve : NULL);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+			"usage: %s [-d data dir] [-n synthetic objects] "
+			"[-i iterations]\n"
+			"          [-r solves] [-s seed] [-D depth] [-o output]\n",
+			name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench b = {
+		.data = BENCH_DATA_DIR,
+		.size = 100000,
+		.iterations = 200,
+		.depth = 7,
+		.solves = 5,
+		.seed = 1,
+		.out = stdout,
+	};
+	struct bench_plate pleiades = {
+		.pobject = pobject,
+		.count = adb_size(pobject),
+		.faint = 6.0,
+		.bright = -2.0,
+		.fov = 5.0 * D2R,
+	};
+	const char *output = NULL;
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "d:n:i:r:s:D:o:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			b.data = optarg;
+			break;
+		case 'n':
+			b.size = atoi(optarg);
+			break;
+		case 'i':
+			b.iterations = atoi(optarg);
+			break;
+		case 'r':
+			b.solves = atoi(optarg);
+			break;
+		case 's':
+			b.seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'D':
+			b.depth = atoi(optarg);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (b.size <= 0 || b.iterations <= 0 || b.solves < 0 || b.seed == 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	b.rng = b.seed;
+
+	if (output) {
+		b.out = fopen(output, "w");
+		if (b.out == NULL) {
+			fprintf(stderr, "error: can't open %s\n", output);
+			return EXIT_FAILURE;
+		}
+	}
+
+	snprintf(b.work, sizeof(b.work), "%s/adb_bench.XXXXXX", P_tmpdir);
+	if (mkdtemp(b.work) == NULL) {
+		fprintf(stderr, "error: can't create work directory\n");
+		return EXIT_FAILURE;
+	}
+
+	fprintf(b.out, "{\n  \"size\": %d,\n  \"iterations\": %d,\n", b.size,
+			b.iterations);
+	fprintf(b.out, "  \"depth\": %d,\n  \"catalogs\": [", b.depth);
+
+	ret = bench_table(&b, "sky2k", b.data, "V", "109", "sky2kv4", NULL, "HD",
+					  &pleiades);
+	if (ret < 0)
+		goto out;
+
+	ret = bench_ngc(&b, "ngc");
+	if (ret < 0)
+		goto out;
+
+	ret = bench_synthetic(&b, "uniform", 0);
+	if (ret < 0)
+		goto out;
+
+	ret = bench_synthetic(&b, "clustered", CLUSTERS);
+
+out:
+	fprintf(b.out, "\n  ]\n}\n");
+	nftw(b.work, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+	if (output)
+		fclose(b.out);
+	if (ret < 0)
+		fprintf(stderr, "error: benchmark failed %d\n", ret);
+	return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
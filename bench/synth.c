@@ -0,0 +1,481 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Copyright (C) 2008 Liam Girdwood
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <libastrodb/db-import.h>
+
+#include "synth.h"
+
+#define D2R (1.7453292519943295769e-2) /* deg->radian */
+#define R2D (5.7295779513082320877e1) /* radian->deg */
+
+/* data file record length */
+#define SYNTH_LRECL 37
+
+static struct adb_schema_field synth_fields[] = {
+	adb_member("Seq", "Seq", struct synth_object, seq, ADB_CTYPE_INT, "", 0,
+			   NULL),
+	adb_member("RA", "RAdeg", struct synth_object, object.ra,
+			   ADB_CTYPE_DEGREES, "degrees", 0, NULL),
+	adb_member("DEC", "DEdeg", struct synth_object, object.dec,
+			   ADB_CTYPE_DEGREES, "degrees", 0, NULL),
+	adb_member("Mag", "Vmag", struct synth_object, object.mag,
+			   ADB_CTYPE_FLOAT, "", 0, NULL),
+};
+
+/* xorshift64* deviate in [0, 1) */
+static double rng_uniform(uint64_t *rng)
+{
+	*rng ^= *rng >> 12;
+	*rng ^= *rng << 25;
+	*rng ^= *rng >> 27;
+	return ((*rng * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static double rng_gauss(uint64_t *rng)
+{
+	double u = rng_uniform(rng), v = rng_uniform(rng);
+
+	return sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * v);
+}
+
+static void equ_to_vec(double ra, double dec, double v[3])
+{
+	v[0] = cos(dec) * cos(ra);
+	v[1] = cos(dec) * sin(ra);
+	v[2] = sin(dec);
+}
+
+/* east and north unit vectors of the tangent plane at ra, dec */
+static void tangent_axes(double ra, double dec, double east[3],
+						 double north[3])
+{
+	east[0] = -sin(ra);
+	east[1] = cos(ra);
+	east[2] = 0.0;
+	north[0] = -sin(dec) * cos(ra);
+	north[1] = -sin(dec) * sin(ra);
+	north[2] = cos(dec);
+}
+
+static inline double dot(const double a[3], const double b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void synth_catalog_init(struct synth_catalog *cat, const char *name,
+						long objects)
+{
+	memset(cat, 0, sizeof(*cat));
+	cat->name = name;
+	cat->objects = objects;
+	cat->mag_min = 0.0;
+	cat->mag_max = 16.0;
+	cat->mag_slope = 0.35;
+	cat->cluster_sigma = 2.0;
+	cat->seed = 1;
+}
+
+/* magnitude with log10 counts growing by slope per magnitude */
+static double catalog_mag(const struct synth_catalog *cat, double u)
+{
+	double range = cat->mag_max - cat->mag_min;
+
+	if (cat->mag_slope == 0.0)
+		return cat->mag_min + u * range;
+
+	return cat->mag_min +
+		   log10(1.0 + u * (pow(10.0, cat->mag_slope * range) - 1.0)) /
+			   cat->mag_slope;
+}
+
+int synth_catalog_walk(const struct synth_catalog *cat,
+					   int (*fn)(void *data, const struct synth_star *star),
+					   void *data)
+{
+	double (*centre)[2] = NULL, v[3], east[3], north[3], dx, dy, r;
+	struct synth_star star;
+	uint64_t rng = cat->seed;
+	int c, k, ret = 0;
+	long i;
+
+	if (cat->seed == 0 || cat->objects < 0 || cat->clusters < 0)
+		return -EINVAL;
+
+	if (cat->clusters) {
+		centre = calloc(cat->clusters, sizeof(*centre));
+		if (centre == NULL)
+			return -ENOMEM;
+	}
+
+	for (c = 0; c < cat->clusters; c++) {
+		centre[c][0] = 2.0 * M_PI * rng_uniform(&rng);
+		centre[c][1] = asin(2.0 * rng_uniform(&rng) - 1.0);
+	}
+
+	for (i = 0; i < cat->objects; i++) {
+		star.seq = i + 1;
+
+		if (cat->clusters && rng_uniform(&rng) < cat->cluster_fraction) {
+			/* gaussian offset in the tangent plane of a cluster */
+			c = (int)(rng_uniform(&rng) * cat->clusters);
+			equ_to_vec(centre[c][0], centre[c][1], v);
+			tangent_axes(centre[c][0], centre[c][1], east, north);
+			dx = rng_gauss(&rng) * cat->cluster_sigma * D2R;
+			dy = rng_gauss(&rng) * cat->cluster_sigma * D2R;
+			for (k = 0; k < 3; k++)
+				v[k] += dx * east[k] + dy * north[k];
+			r = sqrt(dot(v, v));
+			star.ra = atan2(v[1], v[0]);
+			if (star.ra < 0.0)
+				star.ra += 2.0 * M_PI;
+			star.dec = asin(v[2] / r);
+		} else {
+			star.ra = 2.0 * M_PI * rng_uniform(&rng);
+			star.dec = asin(2.0 * rng_uniform(&rng) - 1.0);
+		}
+
+		star.mag = catalog_mag(cat, rng_uniform(&rng));
+
+		ret = fn(data, &star);
+		if (ret < 0)
+			break;
+	}
+
+	free(centre);
+	return ret < 0 ? ret : 0;
+}
+
+static int write_star(void *data, const struct synth_star *star)
+{
+	FILE *out = data;
+	double ra = star->ra * R2D;
+
+	/* keep the rounded RA below 360 */
+	if (ra >= 359.9999995)
+		ra = 0.0;
+
+	if (fprintf(out, "%9ld %10.6f %+10.6f %5.2f\n", star->seq, ra,
+				star->dec * R2D, star->mag) < 0)
+		return -EIO;
+	return 0;
+}
+
+static int write_readme(const struct synth_catalog *cat, const char *dir)
+{
+	char file[1024], name[64];
+	FILE *out;
+
+	snprintf(file, sizeof(file), "%s/ReadMe", dir);
+	out = fopen(file, "w");
+	if (out == NULL)
+		return -errno;
+
+	snprintf(name, sizeof(name), "%s.dat", cat->name);
+	fprintf(out,
+			"Synthetic catalog %s\n"
+			"================================================================"
+			"================\n"
+			"Synthetic catalog of %ld objects, seed %llu\n"
+			"================================================================"
+			"================\n\n"
+			"File Summary:\n"
+			"----------------------------------------------------------------"
+			"----------------\n"
+			" FileName    Lrecl    Records    Explanations\n"
+			"----------------------------------------------------------------"
+			"----------------\n"
+			"ReadMe          80          .    This file\n"
+			"%-12s %5d %10ld    Synthetic objects\n"
+			"----------------------------------------------------------------"
+			"----------------\n\n"
+			"Byte-by-byte Description of file: %s\n"
+			"----------------------------------------------------------------"
+			"----------------\n"
+			"   Bytes Format  Units   Label    Explanations\n"
+			"----------------------------------------------------------------"
+			"----------------\n"
+			"   1-  9  I9     ---     Seq      Sequence number\n"
+			"  11- 20  F10.6  deg     RAdeg    Right ascension\n"
+			"  22- 31  F10.6  deg     DEdeg    Declination\n"
+			"  33- 37  F5.2   mag     Vmag     Magnitude\n"
+			"----------------------------------------------------------------"
+			"----------------\n",
+			cat->name, cat->objects, (unsigned long long)cat->seed, name,
+			SYNTH_LRECL, cat->objects, name);
+
+	if (fclose(out) < 0)
+		return -errno;
+	return 0;
+}
+
+int synth_catalog_write(const struct synth_catalog *cat, const char *dir)
+{
+	char file[1024];
+	FILE *out;
+	int ret;
+
+	if (cat->mag_min < -9.99 || cat->mag_max > 99.99 ||
+		cat->mag_min > cat->mag_max || cat->objects > 999999999L)
+		return -EINVAL;
+
+	ret = write_readme(cat, dir);
+	if (ret < 0)
+		return ret;
+
+	snprintf(file, sizeof(file), "%s/%s.dat", dir, cat->name);
+	out = fopen(file, "w");
+	if (out == NULL)
+		return -errno;
+
+	ret = synth_catalog_walk(cat, write_star, out);
+	if (fclose(out) < 0 && ret == 0)
+		ret = -errno;
+	return ret;
+}
+
+int synth_catalog_import(struct adb_db *db, const char *cat_class,
+						 const char *cat_id, const struct synth_catalog *cat)
+{
+	int table_id, ret;
+
+	table_id = adb_table_import_new(db, cat_class, cat_id, cat->name, "Vmag",
+									floor(cat->mag_min) - 1.0,
+									ceil(cat->mag_max) + 1.0,
+									ADB_IMPORT_INC);
+	if (table_id < 0)
+		return table_id;
+
+	ret = adb_table_import_schema(db, table_id, synth_fields,
+								  adb_size(synth_fields),
+								  sizeof(struct synth_object));
+	if (ret < 0)
+		goto err;
+
+	ret = adb_table_import(db, table_id);
+	if (ret < 0)
+		goto err;
+
+	return table_id;
+
+err:
+	adb_table_close(db, table_id);
+	return ret;
+}
+
+void synth_plate_init(struct synth_plate *plate, double ra, double dec)
+{
+	memset(plate, 0, sizeof(*plate));
+	plate->ra = ra;
+	plate->dec = dec;
+	plate->scale = 20.0 / 3600.0 * D2R;
+	plate->width = 1280;
+	plate->height = 1024;
+	plate->objects = 8;
+	plate->noise = 0.5;
+	plate->mag_noise = 0.05;
+	plate->zero_point = 25.0;
+	plate->seed = 1;
+}
+
+void synth_plate_random(struct synth_plate *plate, uint64_t seed)
+{
+	uint64_t rng = seed;
+
+	plate->ra = 2.0 * M_PI * rng_uniform(&rng);
+	plate->dec = asin(2.0 * rng_uniform(&rng) - 1.0);
+	plate->pa = 2.0 * M_PI * rng_uniform(&rng);
+	plate->seed = seed;
+}
+
+/* brightest catalog objects on the plate, brightest first */
+struct plate_walk {
+	const struct synth_plate *plate;
+	double centre[3], east[3], north[3];
+	double cos_radius;
+	struct synth_star *star;
+	double (*xy)[2];
+	int size, count;
+};
+
+static int plate_star(void *data, const struct synth_star *star)
+{
+	struct plate_walk *walk = data;
+	const struct synth_plate *plate = walk->plate;
+	double v[3], d, xi, eta, u, w, x, y;
+	int i;
+
+	/* skip objects fainter than the faintest kept so far */
+	if (walk->count == walk->size &&
+		star->mag >= walk->star[walk->size - 1].mag)
+		return 0;
+
+	equ_to_vec(star->ra, star->dec, v);
+	d = dot(v, walk->centre);
+	if (d < walk->cos_radius)
+		return 0;
+
+	/* gnomonic projection, plate x follows RA as the solver expects */
+	xi = dot(v, walk->east) / d;
+	eta = dot(v, walk->north) / d;
+	u = xi / plate->scale;
+	w = eta / plate->scale;
+	x = plate->width / 2.0 + u * cos(plate->pa) - w * sin(plate->pa);
+	y = plate->height / 2.0 + u * sin(plate->pa) + w * cos(plate->pa);
+	if (x < 0.0 || x >= plate->width || y < 0.0 || y >= plate->height)
+		return 0;
+
+	/* insert in magnitude order */
+	i = walk->count < walk->size ? walk->count++ : walk->size - 1;
+	for (; i > 0 && walk->star[i - 1].mag > star->mag; i--) {
+		walk->star[i] = walk->star[i - 1];
+		walk->xy[i][0] = walk->xy[i - 1][0];
+		walk->xy[i][1] = walk->xy[i - 1][1];
+	}
+	walk->star[i] = *star;
+	walk->xy[i][0] = x;
+	walk->xy[i][1] = y;
+	return 0;
+}
+
+/* plate object and its catalog object */
+struct plate_object {
+	struct adb_pobject pobject;
+	long seq;
+};
+
+static int adu_cmp(const void *a, const void *b)
+{
+	const struct plate_object *p1 = a, *p2 = b;
+
+	return (p1->pobject.adu < p2->pobject.adu) -
+		   (p1->pobject.adu > p2->pobject.adu);
+}
+
+int synth_plate_new(const struct synth_plate *plate,
+					const struct synth_catalog *cat,
+					struct adb_pobject *pobject, long *seq)
+{
+	struct plate_object *object = NULL;
+	struct plate_walk walk;
+	uint64_t rng = plate->seed;
+	double x, y, mag, bright, faint, radius;
+	int i, n, count, ret;
+
+	if (plate->objects <= 0 || plate->skip < 0 || plate->distractors < 0 ||
+		plate->scale <= 0.0 || plate->width <= 0 || plate->height <= 0 ||
+		plate->seed == 0)
+		return -EINVAL;
+
+	memset(&walk, 0, sizeof(walk));
+	walk.plate = plate;
+	walk.size = plate->objects + plate->skip;
+	equ_to_vec(plate->ra, plate->dec, walk.centre);
+	tangent_axes(plate->ra, plate->dec, walk.east, walk.north);
+	radius = atan(hypot(plate->width, plate->height) / 2.0 * plate->scale);
+	walk.cos_radius = cos(fmin(radius, M_PI / 2.0 - 1e-6));
+
+	walk.star = calloc(walk.size, sizeof(*walk.star));
+	walk.xy = calloc(walk.size, sizeof(*walk.xy));
+	if (walk.star == NULL || walk.xy == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = synth_catalog_walk(cat, plate_star, &walk);
+	if (ret < 0)
+		goto out;
+
+	/* objects on the plate after the missing brightest */
+	count = walk.count - plate->skip;
+	if (count <= 0) {
+		ret = -ENODATA;
+		goto out;
+	}
+	object = calloc(count + plate->distractors, sizeof(*object));
+	if (object == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	n = 0;
+	bright = walk.star[plate->skip].mag;
+	faint = walk.star[walk.count - 1].mag;
+
+	for (i = plate->skip; i < walk.count; i++, n++) {
+		x = walk.xy[i][0] + rng_gauss(&rng) * plate->noise;
+		y = walk.xy[i][1] + rng_gauss(&rng) * plate->noise;
+		mag = walk.star[i].mag + rng_gauss(&rng) * plate->mag_noise;
+
+		object[n].pobject.x = (int)fmax(fmin(x + 0.5, plate->width - 1), 0.0);
+		object[n].pobject.y = (int)fmax(fmin(y + 0.5, plate->height - 1), 0.0);
+		object[n].pobject.adu = pow(10.0, 0.4 * (plate->zero_point - mag));
+		object[n].seq = walk.star[i].seq;
+	}
+
+	/* distractors as bright as the plate objects */
+	for (i = 0; i < plate->distractors; i++, n++) {
+		mag = bright + rng_uniform(&rng) * (faint - bright);
+		object[n].pobject.x = (int)(rng_uniform(&rng) * plate->width);
+		object[n].pobject.y = (int)(rng_uniform(&rng) * plate->height);
+		object[n].pobject.adu = pow(10.0, 0.4 * (plate->zero_point - mag));
+		object[n].seq = SYNTH_DISTRACTOR;
+	}
+
+	qsort(object, n, sizeof(*object), adu_cmp);
+	for (i = 0; i < n; i++) {
+		pobject[i] = object[i].pobject;
+		if (seq)
+			seq[i] = object[i].seq;
+	}
+	ret = n;
+
+out:
+	free(object);
+	free(walk.star);
+	free(walk.xy);
+	return ret;
+}
+
+int synth_plate_write(const struct synth_plate *plate,
+					  const struct adb_pobject *pobject, const long *seq,
+					  int count, const char *file)
+{
+	FILE *out;
+	int i;
+
+	out = fopen(file, "w");
+	if (out == NULL)
+		return -errno;
+
+	fprintf(out, "# ra %.6f dec %.6f pa %.6f scale %.6f width %d height %d\n",
+			plate->ra * R2D, plate->dec * R2D, plate->pa * R2D,
+			plate->scale * R2D * 3600.0, plate->width, plate->height);
+	fprintf(out, "# x y adu seq\n");
+	for (i = 0; i < count; i++)
+		fprintf(out, "%d %d %u %ld\n", pobject[i].x, pobject[i].y,
+				pobject[i].adu, seq[i]);
+
+	if (fclose(out) < 0)
+		return -errno;
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Copyright (C) 2008 Liam Girdwood
+ */
+
+#ifndef __ADB_SYNTH_H
+#define __ADB_SYNTH_H
+
+#include <stdint.h>
+
+#include <libastrodb/db.h>
+#include <libastrodb/object.h>
+#include <libastrodb/solve.h>
+
+/*! \defgroup synth Synthetic Catalogs
+ *
+ * \brief Reproducible synthetic catalogs and plates for scaling tests.
+ *
+ * Catalogs are written as a CDS ReadMe and data file that import like any
+ * other CDS table. Plates are projected from the same catalog, so every
+ * plate object has a known catalog object and the plate has a known
+ * centre, rotation and scale.
+ */
+
+/* plate objects without a catalog object */
+#define SYNTH_DISTRACTOR (-1L)
+
+/*! \struct synth_catalog
+ * \ingroup synth
+ *
+ * Synthetic catalog parameters. Catalogs with the same parameters and seed
+ * have the same objects.
+ */
+struct synth_catalog {
+	const char *name; /*!< table name, the data file is name.dat */
+	long objects; /*!< number of objects */
+	double mag_min; /*!< brightest magnitude */
+	double mag_max; /*!< faintest magnitude */
+	double mag_slope; /*!< log10 increase in counts per magnitude */
+	int clusters; /*!< number of clusters */
+	double cluster_fraction; /*!< fraction of objects in clusters */
+	double cluster_sigma; /*!< cluster radius in degrees */
+	uint64_t seed; /*!< random seed, not 0 */
+};
+
+/*! \struct synth_star
+ * \ingroup synth
+ *
+ * One generated catalog object.
+ */
+struct synth_star {
+	long seq; /*!< sequence number from 1, imported as Seq */
+	double ra; /*!< RA in radians */
+	double dec; /*!< DEC in radians */
+	float mag; /*!< magnitude */
+};
+
+/*! \struct synth_object
+ * \ingroup synth
+ *
+ * Imported synthetic catalog object.
+ */
+struct synth_object {
+	struct adb_object object;
+	unsigned int seq; /*!< catalog sequence number */
+};
+
+/*! \struct synth_plate
+ * \ingroup synth
+ *
+ * Synthetic plate parameters and its known solution.
+ */
+struct synth_plate {
+	double ra; /*!< plate centre RA in radians */
+	double dec; /*!< plate centre DEC in radians */
+	double pa; /*!< plate rotation in radians */
+	double scale; /*!< plate scale in radians per pixel */
+	int width; /*!< plate width in pixels */
+	int height; /*!< plate height in pixels */
+	int objects; /*!< plate objects taken from the catalog */
+	int skip; /*!< brightest catalog objects missing from the plate */
+	int distractors; /*!< plate objects without a catalog object */
+	double noise; /*!< plate position noise sigma in pixels */
+	double mag_noise; /*!< plate magnitude noise sigma */
+	double zero_point; /*!< magnitude of 1 ADU */
+	uint64_t seed; /*!< random seed, not 0 */
+};
+
+/**
+ * \brief Set default catalog parameters.
+ * \ingroup synth
+ * \param cat Catalog parameters.
+ * \param name Table name.
+ * \param objects Number of objects.
+ */
+void synth_catalog_init(struct synth_catalog *cat, const char *name,
+						long objects);
+
+/**
+ * \brief Generate every catalog object in sequence order.
+ * \ingroup synth
+ * \param cat Catalog parameters.
+ * \param fn Called with each object, a negative return stops the walk.
+ * \param data Passed to fn.
+ * \return 0 on success or the negative return of fn.
+ */
+int synth_catalog_walk(const struct synth_catalog *cat,
+					   int (*fn)(void *data, const struct synth_star *star),
+					   void *data);
+
+/**
+ * \brief Write the catalog ReadMe and data file.
+ * \ingroup synth
+ * \param cat Catalog parameters.
+ * \param dir Existing table directory.
+ * \return 0 on success or a negative error code.
+ */
+int synth_catalog_write(const struct synth_catalog *cat, const char *dir);
+
+/**
+ * \brief Import a written catalog.
+ * \ingroup synth
+ * \param db Database, its library has the catalog in cat_class/cat_id.
+ * \param cat_class Catalog class directory.
+ * \param cat_id Catalog ID directory.
+ * \param cat Catalog parameters.
+ * \return Table ID on success or a negative error code.
+ */
+int synth_catalog_import(struct adb_db *db, const char *cat_class,
+						 const char *cat_id, const struct synth_catalog *cat);
+
+/**
+ * \brief Set default plate parameters centred on a position.
+ * \ingroup synth
+ * \param plate Plate parameters.
+ * \param ra Plate centre RA in radians.
+ * \param dec Plate centre DEC in radians.
+ */
+void synth_plate_init(struct synth_plate *plate, double ra, double dec);
+
+/**
+ * \brief Move a plate to a random position and rotation.
+ * \ingroup synth
+ * \param plate Plate parameters.
+ * \param seed Random seed, not 0. The same seed gives the same plate.
+ */
+void synth_plate_random(struct synth_plate *plate, uint64_t seed);
+
+/**
+ * \brief Project catalog objects onto a plate.
+ * \ingroup synth
+ *
+ * Takes the brightest catalog objects on the plate after skipping the
+ * brightest plate->skip, adds position and magnitude noise and mixes in
+ * distractors. Plate objects are ordered brightest first.
+ *
+ * \param plate Plate parameters.
+ * \param cat Catalog parameters.
+ * \param pobject Output plate objects, objects + distractors long.
+ * \param seq Output catalog sequence number of each plate object or
+ *            SYNTH_DISTRACTOR, may be NULL.
+ * \return Number of plate objects or a negative error code.
+ */
+int synth_plate_new(const struct synth_plate *plate,
+					const struct synth_catalog *cat,
+					struct adb_pobject *pobject, long *seq);
+
+/**
+ * \brief Write plate objects and the plate solution as text.
+ * \ingroup synth
+ * \param plate Plate parameters.
+ * \param pobject Plate objects.
+ * \param seq Catalog sequence number of each plate object.
+ * \param count Number of plate objects.
+ * \param file Output file name.
+ * \return 0 on success or a negative error code.
+ */
+int synth_plate_write(const struct synth_plate *plate,
+					  const struct adb_pobject *pobject, const long *seq,
+					  int count, const char *file);
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Copyright (C) 2008 Liam Girdwood
+ */
+
+/*
+ * Query daemon keeping catalog tables resident for client processes.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libastrodb/astrodb.h>
+
+static struct adb_server *server;
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+			"usage: %s [options] library\n"
+			"  -s path         socket path, default /tmp/adbd.sock\n"
+			"  -d depth        HTM depth, default 9\n"
+			"  -n tables       most tables open, default 16\n"
+			"  -t class:id:name[:key]\n"
+			"                  open a table at start and hash a key\n"
+			"  -v              log table opens and clients\n",
+			name);
+}
+
+static void stop(int sig)
+{
+	(void)sig;
+	adb_server_stop(server);
+}
+
+/* tables given at start are opened before any client connects */
+static int open_table(struct adb_db *db, char *spec, int *id)
+{
+	char *cat_class, *cat_id, *name, *key;
+	int table_id, ret;
+
+	cat_class = strtok(spec, ":");
+	cat_id = strtok(NULL, ":");
+	name = strtok(NULL, ":");
+	key = strtok(NULL, ":");
+	if (cat_class == NULL || cat_id == NULL || name == NULL)
+		return -EINVAL;
+
+	table_id = adb_table_open(db, cat_class, cat_id, name);
+	if (table_id < 0) {
+		fprintf(stderr, "failed to open table %s/%s/%s %d\n", cat_class,
+				cat_id, name, table_id);
+		return table_id;
+	}
+
+	if (key) {
+		ret = adb_table_hash_key(db, table_id, key);
+		if (ret < 0) {
+			fprintf(stderr, "failed to hash key %s %d\n", key, ret);
+			adb_table_close(db, table_id);
+			return ret;
+		}
+	}
+
+	*id = table_id;
+	fprintf(stdout, "opened %s/%s/%s with %d objects\n", cat_class, cat_id,
+			name, adb_table_get_count(db, table_id));
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct adb_library *lib;
+	struct adb_db *db;
+	struct sigaction sa;
+	const char *path = "/tmp/adbd.sock";
+	char *table[16];
+	int table_id[16], opened = 0;
+	int opt, depth = 9, tables = 16, num_tables = 0, verbose = 0, i, ret;
+
+	while ((opt = getopt(argc, argv, "s:d:n:t:vh")) != -1) {
+		switch (opt) {
+		case 's':
+			path = optarg;
+			break;
+		case 'd':
+			depth = atoi(optarg);
+			break;
+		case 'n':
+			tables = atoi(optarg);
+			break;
+		case 't':
+			if (num_tables == 16) {
+				fprintf(stderr, "too many tables\n");
+				return -EINVAL;
+			}
+			table[num_tables++] = optarg;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : -EINVAL;
+		}
+	}
+
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return -EINVAL;
+	}
+
+	lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", argv[optind]);
+	if (lib == NULL) {
+		fprintf(stderr, "failed to open library %s\n", argv[optind]);
+		return -EINVAL;
+	}
+
+	db = adb_create_db(lib, depth, tables);
+	if (db == NULL) {
+		fprintf(stderr, "failed to create db\n");
+		ret = -ENOMEM;
+		goto lib_err;
+	}
+	if (verbose) {
+		adb_set_msg_level(db, ADB_MSG_INFO);
+		adb_set_log_level(db, ADB_LOG_CDS_TABLE | ADB_LOG_CDS_DB);
+	}
+
+	/* clients share the table pages through the page cache */
+	adb_set_table_load(db, ADB_TABLE_LOAD_MMAP);
+
+	for (i = 0; i < num_tables; i++) {
+		ret = open_table(db, table[i], &table_id[opened]);
+		if (ret < 0)
+			goto db_err;
+		opened++;
+	}
+
+	server = adb_server_new(db, path);
+	if (server == NULL) {
+		fprintf(stderr, "failed to listen on %s\n", path);
+		ret = -EINVAL;
+		goto db_err;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	fprintf(stdout, "serving %s on %s\n", argv[optind], path);
+	ret = adb_server_run(server);
+	if (ret < 0)
+		fprintf(stderr, "daemon stopped %d\n", ret);
+
+	adb_server_free(server);
+
+db_err:
+	for (i = 0; i < opened; i++)
+		adb_table_close(db, table_id[i]);
+	adb_db_free(db);
+lib_err:
+	adb_close_library(lib);
+	return ret;
+}
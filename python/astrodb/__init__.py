@@ -3,12 +3,18 @@ from .lib import (
     adb_object,
     adb_object_p,
     adb_pobject,
+    adb_solve_frame,
+    adb_db_stats,
+    adb_trixel_aggregate_p,
+    adb_set_delta,
     ADB_OP_AND,
     ADB_OP_OR,
     ADB_COMP_LT,
     ADB_COMP_GT,
     ADB_COMP_EQ,
     ADB_COMP_NE,
+    ADB_LIMIT_FIRST,
+    ADB_LIMIT_BRIGHTEST,
     ADB_CONSTRAINT_MAG,
     ADB_CONSTRAINT_FOV,
     ADB_CONSTRAINT_RA,
@@ -21,18 +27,34 @@ from .lib import (
     ADB_FIND_PLANETS,
     ADB_FIND_ASTEROIDS,
     ADB_FIND_PROPER_MOTION,
+    ADB_FIND_INDEX,
+    ADB_FIND_NEIGHBOURS,
     ADB_BOUND_TOP_RIGHT,
     ADB_BOUND_TOP_LEFT,
     ADB_BOUND_BOTTOM_RIGHT,
     ADB_BOUND_BOTTOM_LEFT,
     ADB_BOUND_CENTRE,
+    ADB_PLATE_FIT_PAIRS,
+    ADB_PLATE_FIT_LSQ,
     ADB_CTYPE_INT,
+    ADB_CTYPE_SHORT,
     ADB_CTYPE_FLOAT,
     ADB_CTYPE_DOUBLE,
+    ADB_CTYPE_DEGREES,
     ADB_CTYPE_STRING
 )
 
 import ctypes
+import errno
+
+# ctypes and NumPy types of exported fields, other fields export as bytes
+_FIELD_TYPES = {
+    ADB_CTYPE_INT: (ctypes.c_int, 'i4'),
+    ADB_CTYPE_SHORT: (ctypes.c_short, 'i2'),
+    ADB_CTYPE_FLOAT: (ctypes.c_float, 'f4'),
+    ADB_CTYPE_DOUBLE: (ctypes.c_double, 'f8'),
+    ADB_CTYPE_DEGREES: (ctypes.c_double, 'f8'),
+}
 
 class AstroDBError(Exception):
     """Base exception for astrodb wrapper errors."""
@@ -48,6 +70,13 @@ class Library:
         if not self._ptr:
             raise AstroDBError("Failed to open library. Check paths and network.")
 
+    def set_mirror(self, url: str = None):
+        """Download from an HTTP(S) mirror of the remote repository when FTP fails."""
+        res = libadb.adb_library_set_mirror(
+            self._ptr, url.encode('utf-8') if url else None)
+        if res < 0:
+            raise AstroDBError(f"Failed to set mirror: {res}")
+
     @property
     def version(self) -> str:
         v = libadb.adb_get_version()
@@ -68,6 +97,20 @@ class Database:
         if not self._ptr:
             raise AstroDBError("Failed to create database context.")
 
+    def get_stats(self) -> dict:
+        stats = adb_db_stats()
+        res = libadb.adb_db_get_stats(self._ptr, ctypes.byref(stats))
+        if res < 0:
+            raise AstroDBError(f"Failed to get database stats: {res}")
+        return {name: getattr(stats, name) for name, _ in stats._fields_}
+
+    def reset_stats(self):
+        libadb.adb_db_reset_stats(self._ptr)
+
+    def set_table_aggregates(self, enable: bool = True):
+        """Store per trixel aggregates in the tables imported after this."""
+        libadb.adb_set_table_aggregates(self._ptr, 1 if enable else 0)
+
     def close(self):
         if self._ptr:
             libadb.adb_db_free(self._ptr)
@@ -148,6 +191,13 @@ class Table:
         if res < 0:
             raise AstroDBError(f"Failed to set hash key {key} for table.")
 
+    def range_key(self, key: str):
+        bkey = key.encode('utf-8')
+        self._kept_strings.append(bkey)
+        res = libadb.adb_table_range_key(self.db._ptr, self.table_id, bkey)
+        if res < 0:
+            raise AstroDBError(f"Failed to set range key {key} for table.")
+
     def get_object(self, id_val, field: str):
         if isinstance(id_val, int):
             c_val = ctypes.c_int(id_val)
@@ -184,12 +234,21 @@ class Table:
         if res < 0:
             raise AstroDBError("Failed to run full database importing routine.")
 
+    def run_import_update(self, path: str, key: str = None) -> int:
+        res = libadb.adb_table_import_update(self.db._ptr, self.table_id, path.encode('utf-8'), key.encode('utf-8') if key else None)
+        if res < 0:
+            raise AstroDBError(f"Failed to update table from {path}.")
+        return res
+
     def get_field_type(self, field: str) -> int:
         return libadb.adb_table_get_field_type(self.db._ptr, self.table_id, field.encode('utf-8'))
 
     def get_field_offset(self, field: str) -> int:
         return libadb.adb_table_get_field_offset(self.db._ptr, self.table_id, field.encode('utf-8'))
 
+    def get_field_size(self, field: str) -> int:
+        return libadb.adb_table_get_field_size(self.db._ptr, self.table_id, field.encode('utf-8'))
+
     def close(self):
         if self.table_id >= 0 and self.db._ptr:
             libadb.adb_table_close(self.db._ptr, self.table_id)
@@ -212,6 +271,28 @@ class ObjectSet:
         if res < 0:
             raise AstroDBError(f"Constraints failed with error {res}")
 
+    def reclip(self, ra: float, dec: float, fov: float, min_z: float, max_z: float):
+        """Move the set cone and populate it, returning the runs of objects
+        added and removed as lists of (table index, count) tuples."""
+        delta = adb_set_delta()
+        res = libadb.adb_table_set_reclip(self._ptr, ra, dec, fov, min_z, max_z, ctypes.byref(delta))
+        if res < 0:
+            raise AstroDBError(f"Re-clip failed with error {res}")
+        self._head_count = res
+        added = [(delta.added[i].index, delta.added[i].count) for i in range(delta.added_count)]
+        removed = [(delta.removed[i].index, delta.removed[i].count) for i in range(delta.removed_count)]
+        return added, removed
+
+    def apply_polygon(self, ra, dec, min_z: float, max_z: float):
+        n = len(ra)
+        if len(dec) != n:
+            raise AstroDBError("ra and dec must have the same length")
+        c_ra = (ctypes.c_double * max(n, 1))(*ra)
+        c_dec = (ctypes.c_double * max(n, 1))(*dec)
+        res = libadb.adb_table_set_polygon(self._ptr, c_ra, c_dec, n, min_z, max_z)
+        if res < 0:
+            raise AstroDBError(f"Polygon constraints failed with error {res}")
+
     def populate(self):
         res = libadb.adb_set_get_objects(self._ptr)
         if res < 0:
@@ -250,6 +331,36 @@ class ObjectSet:
             return None
         return AstroObject(obj_ptr.contents, self.table)
 
+    def get_knearest_on_pos(self, ra: float, dec: float, k: int):
+        objects = (adb_object_p * max(k, 1))()
+        res = libadb.adb_table_set_get_knearest_on_pos(self._ptr, ra, dec, k, objects)
+        if res < 0:
+            raise AstroDBError(f"Failed to get {k} nearest objects, error: {res}")
+        return [AstroObject(objects[i].contents, self.table) for i in range(res)]
+
+    def get_within_radius(self, ra: float, dec: float, radius: float):
+        # count first, then fetch every object inside the radius
+        count = libadb.adb_table_set_get_within_radius(self._ptr, ra, dec, radius, None, 0)
+        if count < 0:
+            raise AstroDBError(f"Failed to get objects within radius, error: {count}")
+        objects = (adb_object_p * max(count, 1))()
+        res = libadb.adb_table_set_get_within_radius(self._ptr, ra, dec, radius, objects, count)
+        if res < 0:
+            raise AstroDBError(f"Failed to get objects within radius, error: {res}")
+        return [AstroObject(objects[i].contents, self.table) for i in range(min(res, count))]
+
+    def crossmatch(self, ra, dec, radius: float):
+        n = len(ra)
+        if len(dec) != n:
+            raise AstroDBError("ra and dec must have the same length")
+        c_ra = (ctypes.c_double * max(n, 1))(*ra)
+        c_dec = (ctypes.c_double * max(n, 1))(*dec)
+        out = (adb_object_p * max(n, 1))()
+        res = libadb.adb_table_crossmatch(self._ptr, c_ra, c_dec, n, radius, out)
+        if res < 0:
+            raise AstroDBError(f"Failed to crossmatch {n} positions, error: {res}")
+        return [AstroObject(out[i].contents, self.table) if out[i] else None for i in range(n)]
+
     # Omit adb_table_set_get_nearest_on_object for now, requires C adb_object reference lookup.
 
     @property
@@ -259,6 +370,96 @@ class ObjectSet:
             return None
         return {"objects_ptr": head_ptr.contents.objects, "count": head_ptr.contents.count}
 
+    def _field_types(self, field: str):
+        size = self.table.get_field_size(field)
+        if size <= 0:
+            raise AstroDBError(f"Unknown field {field}")
+        types = _FIELD_TYPES.get(self.table.get_field_type(field))
+        if types is None or ctypes.sizeof(types[0]) != size:
+            types = (ctypes.c_char * size, f'S{size}')
+        return types
+
+    def export_columns(self, fields=()):
+        """Copy ra, dec, mag and the named fields of every object into
+        contiguous ctypes arrays keyed on column name. The arrays support
+        the buffer protocol and are owned by the caller."""
+        fields = list(fields)
+        count = len(self)
+        columns = {
+            "ra": (ctypes.c_double * count)(),
+            "dec": (ctypes.c_double * count)(),
+            "mag": (ctypes.c_float * count)(),
+        }
+        for field in fields:
+            columns[field] = (self._field_types(field)[0] * count)()
+
+        n = len(fields)
+        c_fields = (ctypes.c_char_p * max(n, 1))(*[f.encode('utf-8') for f in fields])
+        c_columns = (ctypes.c_void_p * max(n, 1))(*[ctypes.addressof(columns[f]) for f in fields])
+        res = libadb.adb_set_export_columns(self._ptr, columns["ra"], columns["dec"],
+                                            columns["mag"], c_fields, c_columns, n, count)
+        if res < 0:
+            raise AstroDBError(f"Failed to export columns, error: {res}")
+        return columns
+
+    def get_aggregates(self, resolution: float):
+        """Summaries of the clip trixels no larger than resolution radians,
+        each a dict of id, count, brightest, flux, ra and dec."""
+        aggregates = adb_trixel_aggregate_p()
+        res = libadb.adb_set_get_aggregates(self._ptr, resolution, ctypes.byref(aggregates))
+        if res < 0:
+            raise AstroDBError(f"Failed to get trixel aggregates, error: {res}")
+        return [{name: getattr(aggregates[i], name) for name, _ in aggregates[i]._fields_}
+                for i in range(res)]
+
+    def to_numpy(self, fields=()):
+        """Export ra, dec, mag and the named fields as NumPy arrays keyed on
+        column name, without creating a Python object per object."""
+        import numpy as np
+
+        fields = list(fields)
+        columns = self.export_columns(fields)
+        dtypes = {"ra": 'f8', "dec": 'f8', "mag": 'f4'}
+        for field in fields:
+            dtypes[field] = self._field_types(field)[1]
+        return {name: np.frombuffer(column, dtype=dtypes[name])
+                for name, column in columns.items()}
+
+    def views(self, fields=()):
+        """Read only structured NumPy views straight over the object blocks
+        of each object head, without copying. The views are only valid until
+        the set is populated again or closed."""
+        import numpy as np
+
+        names = ["ra", "dec", "mag"]
+        formats = ['f8', 'f8', 'f4']
+        offsets = [adb_object.ra.offset, adb_object.dec.offset, adb_object.mag.offset]
+        for field in fields:
+            offset = self.table.get_field_offset(field)
+            if offset < 0:
+                raise AstroDBError(f"Unknown field {field}")
+            names.append(field)
+            formats.append(self._field_types(field)[1])
+            offsets.append(offset)
+
+        object_size = self.table.object_size
+        dtype = np.dtype({"names": names, "formats": formats,
+                          "offsets": offsets, "itemsize": object_size})
+
+        views = []
+        head_arr = libadb.adb_set_get_head(self._ptr)
+        if self._head_count <= 0 or not bool(head_arr):
+            return views
+        for i in range(self._head_count):
+            head = head_arr[i]
+            if head.count == 0:
+                continue
+            block = (ctypes.c_char * (head.count * object_size)).from_address(head.objects)
+            view = np.frombuffer(block, dtype=dtype)
+            view.flags.writeable = False
+            views.append(view)
+        return views
+
     def __iter__(self):
         # adb_set_get_head returns an array of struct adb_object_head
         if self._head_count <= 0:
@@ -271,7 +472,7 @@ class ObjectSet:
         head_arr = ctypes.cast(head_arr_ptr, ctypes.POINTER(lib.adb_object_head))
         # Important: the layout in memory for custom dataset items relies on `table.object_size` dynamically computed by DB at open.
         # But we don't have python subclasses. We can cast generically to byte arrays or adb_object wrappers.
-        object_bytes_size = self.table.size
+        object_bytes_size = self.table.object_size
         
         for i in range(self._head_count):
             head_obj = head_arr[i]
@@ -335,6 +536,24 @@ class Search:
         self._hit_count = hit_count
         return hit_count
 
+    def set_limit(self, limit: int, brightest: bool = False):
+        kind = ADB_LIMIT_BRIGHTEST if brightest else ADB_LIMIT_FIRST
+        res = libadb.adb_search_set_limit(self._ptr, limit, kind)
+        if res < 0:
+            raise AstroDBError("Failed to set search limit.")
+
+    def iterate(self, obj_set: ObjectSet):
+        """Yield search hits as they are found, without a result array."""
+        res = libadb.adb_search_iter_begin(self._ptr, obj_set._ptr)
+        if res < 0:
+            raise AstroDBError(f"Search iteration failed with {res}")
+
+        while True:
+            obj_ptr = libadb.adb_search_iter_next(self._ptr)
+            if not obj_ptr:
+                return
+            yield AstroObject(obj_ptr.contents, self.table)
+
     def __iter__(self):
         if not getattr(self, '_hit_count', 0) or not getattr(self, '_results_arr', None):
             return
@@ -395,6 +614,32 @@ class Solution:
         libadb.adb_solution_equ_to_plate_position(self._ptr, ra, dec, ctypes.byref(x), ctypes.byref(y))
         return x.value, y.value
 
+    def plate_to_equ_positions(self, x, y) -> tuple[list[float], list[float]]:
+        n = len(x)
+        if len(y) != n:
+            raise AstroDBError("x and y must have the same length")
+        c_x = (ctypes.c_double * max(n, 1))(*x)
+        c_y = (ctypes.c_double * max(n, 1))(*y)
+        ra = (ctypes.c_double * max(n, 1))()
+        dec = (ctypes.c_double * max(n, 1))()
+        res = libadb.adb_solution_plate_to_equ_positions(self._ptr, c_x, c_y, n, ra, dec)
+        if res < 0:
+            raise AstroDBError(f"Failed to transform {n} plate positions, error: {res}")
+        return list(ra[:n]), list(dec[:n])
+
+    def equ_to_plate_positions(self, ra, dec) -> tuple[list[float], list[float]]:
+        n = len(ra)
+        if len(dec) != n:
+            raise AstroDBError("ra and dec must have the same length")
+        c_ra = (ctypes.c_double * max(n, 1))(*ra)
+        c_dec = (ctypes.c_double * max(n, 1))(*dec)
+        x = (ctypes.c_double * max(n, 1))()
+        y = (ctypes.c_double * max(n, 1))()
+        res = libadb.adb_solution_equ_to_plate_positions(self._ptr, c_ra, c_dec, n, x, y)
+        if res < 0:
+            raise AstroDBError(f"Failed to transform {n} equatorial positions, error: {res}")
+        return list(x[:n]), list(y[:n])
+
 class Solver:
     def __init__(self, table: Table):
         self.table = table
@@ -422,13 +667,106 @@ class Solver:
         if res < 0:
             raise AstroDBError("Failed to set constraint.")
 
+    def set_track_delta(self, delta: float):
+        res = libadb.adb_solve_set_track_delta(self._ptr, delta)
+        if res < 0:
+            raise AstroDBError("Failed to set track delta.")
+
+    def set_plate_fit(self, fit: int):
+        res = libadb.adb_solve_set_plate_fit(self._ptr, fit)
+        if res < 0:
+            raise AstroDBError("Failed to set plate fit.")
+
+    def prepare_index(self):
+        res = libadb.adb_solve_prepare_index(self._ptr)
+        if res < 0:
+            raise AstroDBError(f"Failed to prepare quad index: {res}")
+
     def execute(self, obj_set: ObjectSet = None, find_flags: int = ADB_FIND_ALL):
-        set_ptr = obj_set._ptr if obj_set else None
+        set_ptr = obj_set._ptr if obj_set is not None else None
         res = libadb.adb_solve(self._ptr, set_ptr, find_flags)
         if res < 0:
             raise AstroDBError(f"Solve execution failed with code {res}")
         return res
 
+    def execute_timed(self, obj_set: ObjectSet, msecs: int,
+                      find_flags: int = ADB_FIND_FIRST):
+        """Solve within msecs, returning 0 if nothing was found in time."""
+        res = libadb.adb_solve_timed(self._ptr, obj_set._ptr, find_flags, msecs)
+        if res == -errno.ETIMEDOUT:
+            return 0
+        if res < 0:
+            raise AstroDBError(f"Timed solve failed with code {res}")
+        return res
+
+    def track(self, prior: Solution, obj_set: ObjectSet = None,
+              find_flags: int = ADB_FIND_FIRST):
+        set_ptr = obj_set._ptr if obj_set is not None else None
+        res = libadb.adb_solve_track(self._ptr, set_ptr, prior._ptr, find_flags)
+        if res < 0:
+            raise AstroDBError(f"Tracked solve failed with code {res}")
+        return res
+
+    def start(self, obj_set: ObjectSet = None, find_flags: int = ADB_FIND_ALL,
+              callback: callable = None):
+        """Start a solve on the solver thread and return at once. callback is
+        called with the result on the solver thread. Collect the result with
+        wait()."""
+        from .lib import adb_solve_callback
+        set_ptr = obj_set._ptr if obj_set is not None else None
+        if callback is not None:
+            self._c_callback = adb_solve_callback(lambda data, solve, res: callback(res))
+        else:
+            self._c_callback = adb_solve_callback()
+        self._started_set = obj_set # keep the set alive while solving
+        res = libadb.adb_solve_start(self._ptr, set_ptr, find_flags, self._c_callback, None)
+        if res < 0:
+            raise AstroDBError(f"Failed to start solve: {res}")
+
+    def fileno(self) -> int:
+        """Descriptor readable once the started solve ends."""
+        fd = libadb.adb_solve_get_fd(self._ptr)
+        if fd < 0:
+            raise AstroDBError("No solve is started.")
+        return fd
+
+    def wait(self) -> int:
+        res = libadb.adb_solve_wait(self._ptr)
+        self._started_set = None
+        if res < 0:
+            raise AstroDBError(f"Solve execution failed with code {res}")
+        return res
+
+    def stop(self):
+        libadb.adb_solve_stop(self._ptr)
+
+    @property
+    def progress(self) -> float:
+        return libadb.adb_solve_get_progress(self._ptr)
+
+    async def solve(self, obj_set: ObjectSet = None, find_flags: int = ADB_FIND_ALL):
+        """Awaitable solve. Other coroutines and threads run while the solver
+        thread works, and cancelling the awaiting task stops the solve."""
+        import asyncio
+
+        loop = asyncio.get_running_loop()
+        done = loop.create_future()
+        self.start(obj_set, find_flags)
+        fd = self.fileno()
+        loop.add_reader(fd, lambda: done.done() or done.set_result(None))
+        try:
+            await done
+        except BaseException:
+            self.stop()
+            raise
+        finally:
+            loop.remove_reader(fd)
+            res = libadb.adb_solve_wait(self._ptr)
+            self._started_set = None
+        if res < 0:
+            raise AstroDBError(f"Solve execution failed with code {res}")
+        return res
+
     def get_solution(self, index: int = 0) -> Solution:
         return Solution(self, index)
 
@@ -440,3 +778,15 @@ class Solver:
     def __del__(self):
         self.close()
 
+def solve_batch(frames, find_flags: int = ADB_FIND_FIRST) -> list[int]:
+    """Solve (Solver, ObjectSet) frames concurrently, returning each result."""
+    array = (adb_solve_frame * len(frames))()
+    for i, (solver, obj_set) in enumerate(frames):
+        array[i].solve = solver._ptr
+        array[i].set = obj_set._ptr
+        array[i].find = find_flags
+    res = libadb.adb_solve_batch(array, len(frames))
+    if res < 0:
+        raise AstroDBError(f"Batch solve failed with code {res}")
+    return [array[i].result for i in range(len(frames))]
+
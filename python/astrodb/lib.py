@@ -62,10 +62,30 @@ adb_object_p = ctypes.POINTER(adb_object)
 class adb_object_head(ctypes.Structure):
     _fields_ = [
         ("objects", ctypes.c_void_p),
-        ("count", ctypes.c_uint)
+        ("count", ctypes.c_uint),
+        ("index", ctypes.c_uint)
     ]
 adb_object_head_p = ctypes.POINTER(adb_object_head)
 
+class adb_set_delta(ctypes.Structure):
+    _fields_ = [
+        ("added", adb_object_head_p),
+        ("added_count", ctypes.c_int),
+        ("removed", adb_object_head_p),
+        ("removed_count", ctypes.c_int)
+    ]
+
+class adb_trixel_aggregate(ctypes.Structure):
+    _fields_ = [
+        ("id", ctypes.c_uint32),
+        ("count", ctypes.c_uint32),
+        ("brightest", ctypes.c_float),
+        ("flux", ctypes.c_float),
+        ("ra", ctypes.c_double),
+        ("dec", ctypes.c_double)
+    ]
+adb_trixel_aggregate_p = ctypes.POINTER(adb_trixel_aggregate)
+
 class adb_pobject(ctypes.Structure):
     _fields_ = [
         ("x", ctypes.c_int),
@@ -87,6 +107,36 @@ class adb_solve_object(ctypes.Structure):
     ]
 adb_solve_object_p = ctypes.POINTER(adb_solve_object)
 
+class adb_db_stats(ctypes.Structure):
+    _fields_ = [
+        ("clips", ctypes.c_uint64),
+        ("trixels", ctypes.c_uint64),
+        ("heads", ctypes.c_uint64),
+        ("searches", ctypes.c_uint64),
+        ("objects_tested", ctypes.c_uint64),
+        ("kd_searches", ctypes.c_uint64),
+        ("kd_nodes", ctypes.c_uint64),
+        ("hash_lookups", ctypes.c_uint64),
+        ("hash_probes", ctypes.c_uint64),
+        ("solve_primaries", ctypes.c_uint64),
+        ("solve_mag", ctypes.c_uint64),
+        ("solve_dist", ctypes.c_uint64),
+        ("solve_pa", ctypes.c_uint64),
+        ("import_objects", ctypes.c_uint64),
+        ("import_histogram_ns", ctypes.c_uint64),
+        ("import_rows_ns", ctypes.c_uint64),
+        ("import_kd_ns", ctypes.c_uint64),
+        ("import_write_ns", ctypes.c_uint64)
+    ]
+
+class adb_solve_frame(ctypes.Structure):
+    _fields_ = [
+        ("solve", adb_solve_p),
+        ("set", adb_object_set_p),
+        ("find", ctypes.c_int),
+        ("result", ctypes.c_int)
+    ]
+
 
 ### Library Bindings ###
 
@@ -98,6 +148,10 @@ libadb.adb_open_library.restype = adb_library_p
 libadb.adb_close_library.argtypes = [adb_library_p]
 libadb.adb_close_library.restype = None
 
+# int adb_library_set_mirror(struct adb_library *lib, const char *url);
+libadb.adb_library_set_mirror.argtypes = [adb_library_p, ctypes.c_char_p]
+libadb.adb_library_set_mirror.restype = ctypes.c_int
+
 # const char *adb_get_version(void);
 libadb.adb_get_version.argtypes = []
 libadb.adb_get_version.restype = ctypes.c_char_p
@@ -113,6 +167,18 @@ libadb.adb_create_db.restype = adb_db_p
 libadb.adb_db_free.argtypes = [adb_db_p]
 libadb.adb_db_free.restype = None
 
+# int adb_db_get_stats(struct adb_db *db, struct adb_db_stats *stats);
+libadb.adb_db_get_stats.argtypes = [adb_db_p, ctypes.POINTER(adb_db_stats)]
+libadb.adb_db_get_stats.restype = ctypes.c_int
+
+# void adb_db_reset_stats(struct adb_db *db);
+libadb.adb_db_reset_stats.argtypes = [adb_db_p]
+libadb.adb_db_reset_stats.restype = None
+
+# void adb_set_table_aggregates(struct adb_db *db, int enable);
+libadb.adb_set_table_aggregates.argtypes = [adb_db_p, ctypes.c_int]
+libadb.adb_set_table_aggregates.restype = None
+
 
 ### Table Bindings ###
 
@@ -132,6 +198,10 @@ libadb.adb_table_get_count.restype = ctypes.c_int
 libadb.adb_table_hash_key.argtypes = [adb_db_p, ctypes.c_int, ctypes.c_char_p]
 libadb.adb_table_hash_key.restype = ctypes.c_int
 
+# int adb_table_range_key(struct adb_db *db, int table_id, const char *key);
+libadb.adb_table_range_key.argtypes = [adb_db_p, ctypes.c_int, ctypes.c_char_p]
+libadb.adb_table_range_key.restype = ctypes.c_int
+
 # int adb_table_get_size(struct adb_db *db, int table_id);
 libadb.adb_table_get_size.argtypes = [adb_db_p, ctypes.c_int]
 libadb.adb_table_get_size.restype = ctypes.c_int
@@ -151,6 +221,14 @@ libadb.adb_table_set_new.restype = adb_object_set_p
 libadb.adb_table_set_constraints.argtypes = [adb_object_set_p, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double]
 libadb.adb_table_set_constraints.restype = ctypes.c_int
 
+# int adb_table_set_reclip(struct adb_object_set *set, double ra, double dec, double fov, double min_Z, double max_Z, struct adb_set_delta *delta);
+libadb.adb_table_set_reclip.argtypes = [adb_object_set_p, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.POINTER(adb_set_delta)]
+libadb.adb_table_set_reclip.restype = ctypes.c_int
+
+# int adb_table_set_polygon(struct adb_object_set *set, const double ra[], const double dec[], int count, double min_Z, double max_Z);
+libadb.adb_table_set_polygon.argtypes = [adb_object_set_p, ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_double), ctypes.c_int, ctypes.c_double, ctypes.c_double]
+libadb.adb_table_set_polygon.restype = ctypes.c_int
+
 # void adb_table_set_free(struct adb_object_set *set);
 libadb.adb_table_set_free.argtypes = [adb_object_set_p]
 libadb.adb_table_set_free.restype = None
@@ -183,10 +261,30 @@ libadb.adb_table_set_get_nearest_on_object.restype = adb_object_p
 libadb.adb_table_set_get_nearest_on_pos.argtypes = [adb_object_set_p, ctypes.c_double, ctypes.c_double]
 libadb.adb_table_set_get_nearest_on_pos.restype = adb_object_p
 
+# int adb_table_set_get_knearest_on_pos(struct adb_object_set *set, double ra, double dec, int k, const struct adb_object *objects[]);
+libadb.adb_table_set_get_knearest_on_pos.argtypes = [adb_object_set_p, ctypes.c_double, ctypes.c_double, ctypes.c_int, ctypes.POINTER(adb_object_p)]
+libadb.adb_table_set_get_knearest_on_pos.restype = ctypes.c_int
+
+# int adb_table_set_get_within_radius(struct adb_object_set *set, double ra, double dec, double radius, const struct adb_object *objects[], int size);
+libadb.adb_table_set_get_within_radius.argtypes = [adb_object_set_p, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.POINTER(adb_object_p), ctypes.c_int]
+libadb.adb_table_set_get_within_radius.restype = ctypes.c_int
+
+# int adb_table_crossmatch(struct adb_object_set *set, const double ra[], const double dec[], int n, double radius, const struct adb_object *out[]);
+libadb.adb_table_crossmatch.argtypes = [adb_object_set_p, ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_double), ctypes.c_int, ctypes.c_double, ctypes.POINTER(adb_object_p)]
+libadb.adb_table_crossmatch.restype = ctypes.c_int
+
 # struct adb_object_head *adb_set_get_head(struct adb_object_set *set);
 libadb.adb_set_get_head.argtypes = [adb_object_set_p]
 libadb.adb_set_get_head.restype = adb_object_head_p
 
+# int adb_set_export_columns(struct adb_object_set *set, double ra[], double dec[], float mag[], const char *fields[], void *columns[], int num_fields, int count);
+libadb.adb_set_export_columns.argtypes = [adb_object_set_p, ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_char_p), ctypes.POINTER(ctypes.c_void_p), ctypes.c_int, ctypes.c_int]
+libadb.adb_set_export_columns.restype = ctypes.c_int
+
+# int adb_set_get_aggregates(struct adb_object_set *set, double resolution, const struct adb_trixel_aggregate **aggregates);
+libadb.adb_set_get_aggregates.argtypes = [adb_object_set_p, ctypes.c_double, ctypes.POINTER(adb_trixel_aggregate_p)]
+libadb.adb_set_get_aggregates.restype = ctypes.c_int
+
 
 ### Search Bindings ###
 
@@ -199,6 +297,9 @@ ADB_COMP_GT = 1
 ADB_COMP_EQ = 2
 ADB_COMP_NE = 3
 
+ADB_LIMIT_FIRST = 0
+ADB_LIMIT_BRIGHTEST = 1
+
 # struct adb_search *adb_search_new(struct adb_db *db, int table_id);
 libadb.adb_search_new.argtypes = [adb_db_p, ctypes.c_int]
 libadb.adb_search_new.restype = adb_search_p
@@ -225,6 +326,18 @@ libadb.adb_search_add_custom_comparator.restype = ctypes.c_int
 libadb.adb_search_get_results.argtypes = [adb_search_p, adb_object_set_p, ctypes.c_void_p]
 libadb.adb_search_get_results.restype = ctypes.c_int
 
+# int adb_search_set_limit(struct adb_search *search, int limit, enum adb_search_limit type);
+libadb.adb_search_set_limit.argtypes = [adb_search_p, ctypes.c_int, ctypes.c_int]
+libadb.adb_search_set_limit.restype = ctypes.c_int
+
+# int adb_search_iter_begin(struct adb_search *search, struct adb_object_set *set);
+libadb.adb_search_iter_begin.argtypes = [adb_search_p, adb_object_set_p]
+libadb.adb_search_iter_begin.restype = ctypes.c_int
+
+# const struct adb_object *adb_search_iter_next(struct adb_search *search);
+libadb.adb_search_iter_next.argtypes = [adb_search_p]
+libadb.adb_search_iter_next.restype = adb_object_p
+
 # int adb_search_get_hits(struct adb_search *search);
 libadb.adb_search_get_hits.argtypes = [adb_search_p]
 libadb.adb_search_get_hits.restype = ctypes.c_int
@@ -293,6 +406,10 @@ libadb.adb_table_import_field.restype = ctypes.c_int
 libadb.adb_table_import.argtypes = [adb_db_p, ctypes.c_int]
 libadb.adb_table_import.restype = ctypes.c_int
 
+# int adb_table_import_update(struct adb_db *db, int table_id, const char *file, const char *key);
+libadb.adb_table_import_update.argtypes = [adb_db_p, ctypes.c_int, ctypes.c_char_p, ctypes.c_char_p]
+libadb.adb_table_import_update.restype = ctypes.c_int
+
 # adb_ctype adb_table_get_field_type(struct adb_db *db, int table_id, const char *field);
 libadb.adb_table_get_field_type.argtypes = [adb_db_p, ctypes.c_int, ctypes.c_char_p]
 libadb.adb_table_get_field_type.restype = ctypes.c_int
@@ -301,6 +418,10 @@ libadb.adb_table_get_field_type.restype = ctypes.c_int
 libadb.adb_table_get_field_offset.argtypes = [adb_db_p, ctypes.c_int, ctypes.c_char_p]
 libadb.adb_table_get_field_offset.restype = ctypes.c_int
 
+# int adb_table_get_field_size(struct adb_db *db, int table_id, const char *field);
+libadb.adb_table_get_field_size.argtypes = [adb_db_p, ctypes.c_int, ctypes.c_char_p]
+libadb.adb_table_get_field_size.restype = ctypes.c_int
+
 # int adb_table_import_alt_dataset(struct adb_db *db, int table_id, const char *dataset, int num_objects);
 libadb.adb_table_import_alt_dataset.argtypes = [adb_db_p, ctypes.c_int, ctypes.c_char_p, ctypes.c_int]
 libadb.adb_table_import_alt_dataset.restype = ctypes.c_int
@@ -330,6 +451,8 @@ ADB_FIND_FIRST = 1 << 1
 ADB_FIND_PLANETS = 1 << 2
 ADB_FIND_ASTEROIDS = 1 << 3
 ADB_FIND_PROPER_MOTION = 1 << 4
+ADB_FIND_INDEX = 1 << 5
+ADB_FIND_NEIGHBOURS = 1 << 6
 
 ADB_BOUND_TOP_RIGHT = 0
 ADB_BOUND_TOP_LEFT = 1
@@ -337,6 +460,9 @@ ADB_BOUND_BOTTOM_RIGHT = 2
 ADB_BOUND_BOTTOM_LEFT = 3
 ADB_BOUND_CENTRE = 4
 
+ADB_PLATE_FIT_PAIRS = 0
+ADB_PLATE_FIT_LSQ = 1
+
 # struct adb_solve *adb_solve_new(struct adb_db *db, int table_id);
 libadb.adb_solve_new.argtypes = [adb_db_p, ctypes.c_int]
 libadb.adb_solve_new.restype = adb_solve_p
@@ -369,6 +495,53 @@ libadb.adb_solve_constraint.restype = ctypes.c_int
 libadb.adb_solve.argtypes = [adb_solve_p, adb_object_set_p, ctypes.c_int]
 libadb.adb_solve.restype = ctypes.c_int
 
+# int adb_solve_batch(struct adb_solve_frame *frame, int count);
+libadb.adb_solve_batch.argtypes = [ctypes.POINTER(adb_solve_frame), ctypes.c_int]
+libadb.adb_solve_batch.restype = ctypes.c_int
+
+# int adb_solve_track(struct adb_solve *solve, struct adb_object_set *set, struct adb_solve_solution *prior, enum adb_find find);
+libadb.adb_solve_track.argtypes = [adb_solve_p, adb_object_set_p, adb_solve_solution_p, ctypes.c_int]
+libadb.adb_solve_track.restype = ctypes.c_int
+
+# int adb_solve_timed(struct adb_solve *solve, struct adb_object_set *set, enum adb_find find, int msecs);
+libadb.adb_solve_timed.argtypes = [adb_solve_p, adb_object_set_p, ctypes.c_int, ctypes.c_int]
+libadb.adb_solve_timed.restype = ctypes.c_int
+
+# typedef void (*adb_solve_callback)(void *data, struct adb_solve *solve, int result);
+adb_solve_callback = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int)
+
+# int adb_solve_start(struct adb_solve *solve, struct adb_object_set *set, enum adb_find find, adb_solve_callback callback, void *data);
+libadb.adb_solve_start.argtypes = [adb_solve_p, adb_object_set_p, ctypes.c_int, adb_solve_callback, ctypes.c_void_p]
+libadb.adb_solve_start.restype = ctypes.c_int
+
+# int adb_solve_get_fd(struct adb_solve *solve);
+libadb.adb_solve_get_fd.argtypes = [adb_solve_p]
+libadb.adb_solve_get_fd.restype = ctypes.c_int
+
+# int adb_solve_wait(struct adb_solve *solve);
+libadb.adb_solve_wait.argtypes = [adb_solve_p]
+libadb.adb_solve_wait.restype = ctypes.c_int
+
+# void adb_solve_stop(struct adb_solve *solve);
+libadb.adb_solve_stop.argtypes = [adb_solve_p]
+libadb.adb_solve_stop.restype = None
+
+# float adb_solve_get_progress(struct adb_solve *solve);
+libadb.adb_solve_get_progress.argtypes = [adb_solve_p]
+libadb.adb_solve_get_progress.restype = ctypes.c_float
+
+# int adb_solve_set_track_delta(struct adb_solve *solve, double delta_pixels);
+libadb.adb_solve_set_track_delta.argtypes = [adb_solve_p, ctypes.c_double]
+libadb.adb_solve_set_track_delta.restype = ctypes.c_int
+
+# int adb_solve_set_plate_fit(struct adb_solve *solve, enum adb_plate_fit fit);
+libadb.adb_solve_set_plate_fit.argtypes = [adb_solve_p, ctypes.c_int]
+libadb.adb_solve_set_plate_fit.restype = ctypes.c_int
+
+# int adb_solve_prepare_index(struct adb_solve *solve);
+libadb.adb_solve_prepare_index.argtypes = [adb_solve_p]
+libadb.adb_solve_prepare_index.restype = ctypes.c_int
+
 # struct adb_solve_solution *adb_solve_get_solution(struct adb_solve *solve, unsigned int solution);
 libadb.adb_solve_get_solution.argtypes = [adb_solve_p, ctypes.c_uint]
 libadb.adb_solve_get_solution.restype = adb_solve_solution_p
@@ -401,3 +574,11 @@ libadb.adb_solution_plate_to_equ_position.restype = None
 libadb.adb_solution_equ_to_plate_position.argtypes = [adb_solve_solution_p, ctypes.c_double, ctypes.c_double, ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_double)]
 libadb.adb_solution_equ_to_plate_position.restype = None
 
+# int adb_solution_plate_to_equ_positions(struct adb_solve_solution *solution, const double *x, const double *y, int count, double *ra, double *dec);
+libadb.adb_solution_plate_to_equ_positions.argtypes = [adb_solve_solution_p, ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_double), ctypes.c_int, ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_double)]
+libadb.adb_solution_plate_to_equ_positions.restype = ctypes.c_int
+
+# int adb_solution_equ_to_plate_positions(struct adb_solve_solution *solution, const double *ra, const double *dec, int count, double *x, double *y);
+libadb.adb_solution_equ_to_plate_positions.argtypes = [adb_solve_solution_p, ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_double), ctypes.c_int, ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_double)]
+libadb.adb_solution_equ_to_plate_positions.restype = ctypes.c_int
+
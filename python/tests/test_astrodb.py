@@ -67,5 +67,25 @@ class TestAstroDB(unittest.TestCase):
             print("Table open failed, dataset might be missing locally:", e)
         db.close()
 
+    def test_stats(self):
+        db = Database(self.lib, 7, 1)
+        tbl = Table(db, "V", "109", "sky2kv4")
+        from astrodb import ObjectSet
+        oset = ObjectSet(tbl)
+        db.reset_stats()
+        oset.apply_constraints(2.0, 0.3, 0.2, -2.0, 16.0)
+        oset.populate()
+        oset.get_nearest_on_pos(2.0, 0.3)
+        stats = db.get_stats()
+        self.assertEqual(stats["clips"], 1)
+        self.assertTrue(stats["trixels"] > 0)
+        self.assertEqual(stats["kd_searches"], 1)
+        self.assertTrue(stats["kd_nodes"] > 0)
+        db.reset_stats()
+        self.assertEqual(db.get_stats()["clips"], 0)
+        oset.close()
+        tbl.close()
+        db.close()
+
 if __name__ == '__main__':
     unittest.main()
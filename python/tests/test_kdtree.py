@@ -34,5 +34,26 @@ class TestKDTree(unittest.TestCase):
         oset.close()
         tbl.close()
 
+    def test_kdtree_knearest_radius(self):
+        tbl = Table(self.db, "V", "109", "sky2kv4")
+        oset = ObjectSet(tbl)
+
+        nearest = oset.get_nearest_on_pos(1.0, 0.5)
+        found = oset.get_knearest_on_pos(1.0, 0.5, 8)
+        self.assertEqual(len(found), 8)
+        self.assertEqual(found[0].ra, nearest.ra)
+        self.assertEqual(found[0].dec, nearest.dec)
+
+        within = oset.get_within_radius(1.0, 0.5, 10.0 * D2R)
+        self.assertGreater(len(within), 0)
+        self.assertEqual(within[0].ra, nearest.ra)
+
+        matched = oset.crossmatch([1.0, nearest.ra], [0.5, nearest.dec], 1.0 * D2R)
+        self.assertIsNone(matched[0])
+        self.assertEqual(matched[1].ra, nearest.ra)
+
+        oset.close()
+        tbl.close()
+
 if __name__ == '__main__':
     unittest.main()
@@ -93,5 +93,57 @@ class TestNGC(unittest.TestCase):
         oset.close()
         tbl.close()
 
+    def test_query_polygon(self):
+        tbl = self._get_table_safely()
+        oset = ObjectSet(tbl)
+
+        # CCD like footprint around RA 11h, DEC 10 deg
+        ra = [2.7, 3.0, 3.0, 2.7]
+        dec = [0.05, 0.05, 0.3, 0.3]
+        oset.apply_polygon(ra, dec, 0.0, 16.0)
+        oset.populate()
+
+        count = len(oset)
+        self.assertTrue(count > 0 and count < 7765)
+        self.assertEqual(count, len(list(oset)))
+        for obj in oset:
+            self.assertTrue(2.7 <= obj.ra <= 3.0)
+
+        # self intersecting footprints are rejected
+        with self.assertRaises(AstroDBError):
+            oset.apply_polygon([2.7, 3.0, 2.7, 3.0], dec, 0.0, 16.0)
+
+        oset.close()
+        tbl.close()
+
+    def test_aggregates_not_stored(self):
+        tbl = self._get_table_safely()
+        oset = ObjectSet(tbl)
+        oset.apply_constraints(0.0, 0.0, 2.0 * math.pi, 0.0, 16.0)
+
+        # the reference table was imported without trixel aggregates
+        with self.assertRaises(AstroDBError):
+            oset.get_aggregates(math.pi)
+
+        oset.close()
+        tbl.close()
+
+    def test_reclip(self):
+        tbl = self._get_table_safely()
+        oset = ObjectSet(tbl)
+
+        added, removed = oset.reclip(math.radians(80.0), math.radians(20.0), math.radians(10.0), 0.0, 16.0)
+        self.assertEqual(removed, [])
+        count = sum(n for _, n in added)
+        self.assertEqual(count, len(oset))
+
+        # objects entering and leaving account for the new count
+        added, removed = oset.reclip(math.radians(81.0), math.radians(20.0), math.radians(10.0), 0.0, 16.0)
+        count += sum(n for _, n in added) - sum(n for _, n in removed)
+        self.assertEqual(count, len(oset))
+
+        oset.close()
+        tbl.close()
+
 if __name__ == '__main__':
     unittest.main()
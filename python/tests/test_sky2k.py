@@ -1,6 +1,11 @@
 import unittest
 import os
 import math
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
 from astrodb import Library, Database, Table, ObjectSet, Search, AstroDBError
 from astrodb import Solver, Solution
 
@@ -101,6 +106,52 @@ class TestSky2k(unittest.TestCase):
         oset.close()
         tbl.close()
 
+    def test_search_iterate(self):
+        tbl = self._get_table_safely()
+        search = Search(tbl)
+        oset = ObjectSet(tbl)
+
+        search.add_comparator("Sp", 2, "G5*") # EQ
+        search.add_operator(1) # OR
+
+        hits = search.execute(oset)
+        mags = [obj.mag for obj in search]
+        self.assertEqual(len(list(search.iterate(oset))), hits)
+
+        search.set_limit(5)
+        self.assertEqual(len(list(search.iterate(oset))), min(5, hits))
+
+        search.set_limit(5, brightest=True)
+        brightest = [obj.mag for obj in search.iterate(oset)]
+        self.assertEqual(brightest, sorted(mags)[:5])
+
+        search.close()
+        oset.close()
+        tbl.close()
+
+    def test_search_range_key(self):
+        tbl = self._get_table_safely()
+        oset = ObjectSet(tbl)
+
+        def run():
+            search = Search(tbl)
+            search.add_comparator("RV", 1, "30") # GT
+            search.add_comparator("pmRA", 0, "0.05") # LT
+            search.add_operator(0) # AND
+            search.execute(oset)
+            result = ([obj.c_obj.ra for obj in search], search.tests)
+            search.close()
+            return result
+
+        scanned, scan_tests = run()
+        tbl.range_key("RV")
+        indexed, index_tests = run()
+        self.assertEqual(indexed, scanned)
+        self.assertLess(index_tests, scan_tests)
+
+        oset.close()
+        tbl.close()
+
     def test_get4(self):
         tbl = self._get_table_safely()
         oset = ObjectSet(tbl)
@@ -120,5 +171,49 @@ class TestSky2k(unittest.TestCase):
         oset.close()
         tbl.close()
 
+    def _export_set(self, tbl):
+        oset = ObjectSet(tbl)
+        oset.apply_constraints(1.0, 0.5, 30.0 * D2R, -2.0, 16.0)
+        oset.populate()
+        self.assertTrue(len(oset) > 0)
+        return oset
+
+    def test_export_columns(self):
+        tbl = self._get_table_safely()
+        oset = self._export_set(tbl)
+
+        columns = oset.export_columns(["HD", "Sp"])
+        objects = list(oset)
+        self.assertEqual(len(columns["ra"]), len(objects))
+        self.assertEqual(memoryview(columns["dec"]).nbytes, 8 * len(objects))
+        for i, obj in enumerate(objects):
+            self.assertEqual(columns["ra"][i], obj.ra)
+            self.assertEqual(columns["dec"][i], obj.dec)
+            self.assertEqual(columns["HD"][i], obj.get_int("HD"))
+            self.assertEqual(columns["Sp"][i].value.decode('utf-8', 'ignore'),
+                             obj.get_string("Sp"))
+
+        with self.assertRaises(AstroDBError):
+            oset.export_columns(["NoSuchField"])
+
+        oset.close()
+        tbl.close()
+
+    @unittest.skipIf(numpy is None, "NumPy is not installed")
+    def test_to_numpy(self):
+        tbl = self._get_table_safely()
+        oset = self._export_set(tbl)
+
+        columns = oset.to_numpy(["HD"])
+        views = oset.views(["HD"])
+        self.assertEqual(sum(len(v) for v in views), len(oset))
+        merged = numpy.concatenate(views)
+        self.assertTrue(numpy.array_equal(columns["ra"], merged["ra"]))
+        self.assertTrue(numpy.array_equal(columns["HD"], merged["HD"]))
+        self.assertFalse(views[0].flags.writeable)
+
+        oset.close()
+        tbl.close()
+
 if __name__ == '__main__':
     unittest.main()
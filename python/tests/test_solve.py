@@ -1,6 +1,10 @@
+import asyncio
 import unittest
 import os
-from astrodb import Library, Database, Table, Solver, AstroDBError
+from astrodb import Library, Database, Table, Solver, ObjectSet, AstroDBError, solve_batch
+from astrodb import ADB_CONSTRAINT_MAG, ADB_CONSTRAINT_FOV, ADB_FIND_FIRST
+
+D2R = 1.7453292519943295769e-2
 
 class TestSolver(unittest.TestCase):
     def setUp(self):
@@ -32,5 +36,134 @@ class TestSolver(unittest.TestCase):
         except AstroDBError as e:
             self.skipTest(f"Skipping solver test because dataset might be missing: {e}")
 
+    def test_batch_reports_each_frame(self):
+        try:
+            tbl = Table(self.db, "V", "109", "sky2kv4")
+        except AstroDBError as e:
+            self.skipTest(f"Skipping solver test because dataset might be missing: {e}")
+
+        oset = ObjectSet(tbl)
+        solvers = [Solver(tbl), Solver(tbl)]
+
+        # too few plate objects, each frame fails on its own
+        solvers[0].add_plate_object(100, 100, 500, 0)
+        results = solve_batch([(solver, oset) for solver in solvers])
+        self.assertEqual(len(results), 2)
+        self.assertTrue(all(res < 0 for res in results))
+
+        for solver in solvers:
+            solver.close()
+        tbl.close()
+
+    def test_timed_rejects_bad_plates(self):
+        try:
+            tbl = Table(self.db, "V", "109", "sky2kv4")
+        except AstroDBError as e:
+            self.skipTest(f"Skipping solver test because dataset might be missing: {e}")
+
+        oset = ObjectSet(tbl)
+        solver = Solver(tbl)
+        solver.add_plate_object(100, 100, 500, 0)
+        with self.assertRaises(AstroDBError):
+            solver.execute_timed(oset, 100)
+        with self.assertRaises(AstroDBError):
+            solver.execute_timed(oset, 0)
+
+        solver.close()
+        tbl.close()
+
+    def _pleiades_solver(self, tbl):
+        solver = Solver(tbl)
+        solver.add_constraint(ADB_CONSTRAINT_MAG, 6.0, -2.0)
+        solver.add_constraint(ADB_CONSTRAINT_FOV, 0.1 * D2R, 5.0 * D2R)
+        for x, y, adu in ((513, 434, 408725), (141, 545, 123643),
+                          (1049, 197, 128424), (956, 517, 106906),
+                          (682, 180, 98841)):
+            solver.add_plate_object(x, y, adu)
+        solver.set_magnitude_delta(0.5)
+        solver.set_distance_delta(5.0)
+        solver.set_pa_delta(2.0 * D2R)
+        return solver
+
+    def test_async_solve(self):
+        try:
+            tbl = Table(self.db, "V", "109", "sky2kv4")
+        except AstroDBError as e:
+            self.skipTest(f"Skipping solver test because dataset might be missing: {e}")
+
+        oset = ObjectSet(tbl)
+        oset.apply_constraints(0.0, 0.0, 360.0 * D2R, -90.0, 90.0)
+        solver = self._pleiades_solver(tbl)
+        found = solver.execute(oset, ADB_FIND_FIRST)
+
+        # other coroutines keep running while the solver works
+        async def run():
+            ticks = 0
+
+            async def tick():
+                nonlocal ticks
+                while True:
+                    ticks += 1
+                    await asyncio.sleep(0)
+
+            ticker = asyncio.ensure_future(tick())
+            res = await solver.solve(oset, ADB_FIND_FIRST)
+            ticker.cancel()
+            return res, ticks
+
+        res, ticks = asyncio.run(run())
+        self.assertEqual(res, found)
+        self.assertTrue(ticks > 0)
+
+        # thread start with a completion callback
+        results = []
+        solver.start(oset, ADB_FIND_FIRST, callback=results.append)
+        self.assertEqual(solver.wait(), found)
+        self.assertEqual(results, [found])
+        with self.assertRaises(AstroDBError):
+            solver.wait()
+
+        solver.close()
+        oset.close()
+        tbl.close()
+
+    def test_solution_positions(self):
+        try:
+            tbl = Table(self.db, "V", "109", "sky2kv4")
+        except AstroDBError as e:
+            self.skipTest(f"Skipping solver test because dataset might be missing: {e}")
+
+        oset = ObjectSet(tbl)
+        oset.apply_constraints(0.0, 0.0, 360.0 * D2R, -90.0, 90.0)
+        solver = Solver(tbl)
+        solver.add_constraint(ADB_CONSTRAINT_MAG, 6.0, -2.0)
+        solver.add_constraint(ADB_CONSTRAINT_FOV, 0.1 * D2R, 5.0 * D2R)
+        for x, y, adu in ((513, 434, 408725), (141, 545, 123643),
+                          (1049, 197, 128424), (956, 517, 106906),
+                          (682, 180, 98841)):
+            solver.add_plate_object(x, y, adu)
+        solver.set_magnitude_delta(0.5)
+        solver.set_distance_delta(5.0)
+        solver.set_pa_delta(2.0 * D2R)
+        if solver.execute(oset, ADB_FIND_FIRST) <= 0:
+            self.skipTest("Skipping positions test because the plate did not solve")
+
+        solution = solver.get_solution(0)
+        xs = [0, 300, 513, 800, 1200]
+        ys = [0, 200, 434, 600, 800]
+        ra, dec = solution.plate_to_equ_positions(xs, ys)
+        for i in range(len(xs)):
+            self.assertAlmostEqual(ra[i], solution.plate_to_equ(xs[i], ys[i])[0], places=12)
+            self.assertAlmostEqual(dec[i], solution.plate_to_equ(xs[i], ys[i])[1], places=12)
+        x, y = solution.equ_to_plate_positions(ra, dec)
+        for i in range(len(xs)):
+            self.assertEqual((x[i], y[i]), solution.equ_to_plate(ra[i], dec[i]))
+        with self.assertRaises(AstroDBError):
+            solution.plate_to_equ_positions(xs, ys[:2])
+
+        solver.close()
+        oset.close()
+        tbl.close()
+
 if __name__ == '__main__':
     unittest.main()
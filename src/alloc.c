@@ -0,0 +1,204 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#if HAVE_NUMA
+#include <numa.h>
+#endif
+
+#include "alloc.h"
+#include "debug.h"
+#include "lib.h"
+#include "libastrodb/db.h"
+
+/* policies that place their large arrays in their own mappings */
+#define ALLOC_MAPPED \
+	(ADB_ALLOC_HUGEPAGE | ADB_ALLOC_HUGETLB | ADB_ALLOC_INTERLEAVE)
+
+/**
+ * \brief Map zeroed pages aligned to the huge page size.
+ *
+ * Transparent huge pages only back aligned huge page ranges, so the mapping
+ * is made one huge page larger and trimmed to an aligned start.
+ *
+ * \param bytes Mapping size, a multiple of the huge page size.
+ * \return Mapping or MAP_FAILED.
+ */
+static void *alloc_map_aligned(size_t bytes)
+{
+	size_t head;
+	char *map;
+
+	map = mmap(NULL, bytes + ALLOC_HUGE_PAGE, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		return MAP_FAILED;
+
+	/* trim to the aligned start, the head is always under a huge page */
+	head = -(uintptr_t)map & (ALLOC_HUGE_PAGE - 1);
+	if (head)
+		munmap(map, head);
+	munmap(map + head + bytes, ALLOC_HUGE_PAGE - head);
+
+	return map + head;
+}
+
+/**
+ * \brief Allocate a zeroed array placed by the database allocation policy.
+ *
+ * Arrays smaller than ALLOC_LARGE_SIZE, or under a policy that does not
+ * place arrays, come from the heap. Reserved huge pages fall back to
+ * transparent huge pages when none are free.
+ *
+ * \param db Database with the allocation policy.
+ * \param size Array size in bytes.
+ * \param mapped Output mapped bytes, 0 for heap arrays.
+ * \return Array or NULL on failure.
+ */
+void *alloc_large(struct adb_db *db, size_t size, size_t *mapped)
+{
+	void *ptr = MAP_FAILED;
+	size_t bytes;
+
+	*mapped = 0;
+	if (!(db->alloc & ALLOC_MAPPED) || size < ALLOC_LARGE_SIZE)
+		return calloc(1, size);
+
+	bytes = (size + ALLOC_HUGE_PAGE - 1) & ~(ALLOC_HUGE_PAGE - 1);
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_2MB)
+	if (db->alloc & ADB_ALLOC_HUGETLB)
+		ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB,
+				   -1, 0);
+#endif
+
+	if (ptr == MAP_FAILED) {
+		ptr = alloc_map_aligned(bytes);
+		if (ptr == MAP_FAILED)
+			return NULL;
+#ifdef MADV_HUGEPAGE
+		if (db->alloc & (ADB_ALLOC_HUGEPAGE | ADB_ALLOC_HUGETLB))
+			madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+	}
+
+	/* no page is touched yet so every page follows the policy */
+#if HAVE_NUMA
+	if ((db->alloc & ADB_ALLOC_INTERLEAVE) && numa_available() >= 0)
+		numa_interleave_memory(ptr, bytes, numa_all_nodes_ptr);
+#endif
+
+	adb_debug(db, ADB_LOG_CDS_DB, "mapped %zu bytes for %zu byte array\n",
+			  bytes, size);
+	*mapped = bytes;
+	return ptr;
+}
+
+/**
+ * \brief Free an array from alloc_large().
+ *
+ * \param ptr Array or NULL.
+ * \param mapped Mapped bytes from alloc_large().
+ */
+void alloc_free_large(void *ptr, size_t mapped)
+{
+	if (mapped)
+		munmap(ptr, mapped);
+	else
+		free(ptr);
+}
+
+/**
+ * \brief Interleave the pages the calling thread allocates over the nodes.
+ *
+ * The mesh trixels and vertices are many small heap allocations, so the
+ * thread memory policy rather than a mapping places them.
+ *
+ * \param db Database with the allocation policy.
+ */
+void alloc_mesh_begin(struct adb_db *db)
+{
+#if HAVE_NUMA
+	if ((db->alloc & ADB_ALLOC_INTERLEAVE) && numa_available() >= 0)
+		numa_set_interleave_mask(numa_all_nodes_ptr);
+#else
+	(void)db;
+#endif
+}
+
+/**
+ * \brief Return the calling thread to local allocation after the mesh.
+ *
+ * \param db Database with the allocation policy.
+ */
+void alloc_mesh_end(struct adb_db *db)
+{
+#if HAVE_NUMA
+	if ((db->alloc & ADB_ALLOC_INTERLEAVE) && numa_available() >= 0)
+		numa_set_localalloc();
+#else
+	(void)db;
+#endif
+}
+
+/**
+ * \brief Run the calling worker thread on the NUMA nodes in turn.
+ *
+ * Workers are spread round robin, so worker N runs on node N modulo the
+ * number of nodes. Nodes without CPUs refuse the binding and the worker
+ * keeps running anywhere.
+ *
+ * \param db Database with the allocation policy.
+ * \param worker Worker index.
+ */
+void alloc_bind_worker(struct adb_db *db, int worker)
+{
+#if HAVE_NUMA
+	if (!(db->alloc & ADB_ALLOC_BIND_WORKERS) || numa_available() < 0)
+		return;
+
+	if (numa_run_on_node(worker % (numa_max_node() + 1)) < 0)
+		adb_debug(db, ADB_LOG_CDS_DB, "worker %d not bound\n", worker);
+#else
+	(void)db;
+	(void)worker;
+#endif
+}
+
+/**
+ * \brief Bind the OpenMP worker team to the NUMA nodes.
+ *
+ * OpenMP keeps its worker threads between parallel regions, so binding
+ * the team once holds for the later regions of the same size.
+ *
+ * \param db Database with the allocation policy.
+ */
+void alloc_bind_workers(struct adb_db *db)
+{
+	if (!(db->alloc & ADB_ALLOC_BIND_WORKERS))
+		return;
+
+#if HAVE_OPENMP
+#pragma omp parallel num_threads(db_workers(db))
+	alloc_bind_worker(db, omp_get_thread_num());
+#endif
+}
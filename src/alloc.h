@@ -0,0 +1,59 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#ifndef __ADB_ALLOC_H
+#define __ADB_ALLOC_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <stddef.h>
+
+/*! \defgroup alloc Alloc
+ *
+ * \brief Placement of large read only arrays and worker threads.
+ *
+ * Table objects, KD search nodes and field arrays are read at random by
+ * every worker. Arrays of at least ALLOC_LARGE_SIZE bytes get their own
+ * mapping, so the database allocation policy can back them with huge pages
+ * and spread their pages over the NUMA nodes before they are first
+ * touched. Smaller arrays, and every array under the default policy, come
+ * from the heap.
+ */
+
+#define ALLOC_HUGE_PAGE (2UL << 20) /* huge page size on x86 and arm64 */
+#define ALLOC_LARGE_SIZE ALLOC_HUGE_PAGE /* smallest mapped array */
+
+struct adb_db;
+
+/*
+ * Zeroed arrays. mapped is set to the mapped bytes to free, or 0 for heap
+ * arrays.
+ */
+void *alloc_large(struct adb_db *db, size_t size, size_t *mapped);
+void alloc_free_large(void *ptr, size_t mapped);
+
+/* the HTM mesh built between these is interleaved over the NUMA nodes */
+void alloc_mesh_begin(struct adb_db *db);
+void alloc_mesh_end(struct adb_db *db);
+
+/* run the calling thread, or the OpenMP worker team, on its NUMA node */
+void alloc_bind_worker(struct adb_db *db, int worker);
+void alloc_bind_workers(struct adb_db *db);
+
+#endif
+#endif
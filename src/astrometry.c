@@ -19,301 +19,675 @@
 #ifdef DEBUG
 #include <stdio.h>
 #endif
+#include <errno.h>
 #include <unistd.h>
 #include <math.h>
-#include <pthread.h>
+#include <stdlib.h>
 #include <pthread.h>
 
+#include "debug.h"
+#include "lib.h"
+#include "simd.h"
 #include "solve.h"
 
+/* plate positions transformed at a time by each thread */
+#define POSN_CHUNK SIMD_CHUNK
+
+/* reference objects are clipped beyond this many RMS fit residuals */
+#define POSN_CLIP_RMS 3.0
+
+/* smallest RMS fit residual in pixels, stops exact plates being clipped */
+#define POSN_CLIP_FLOOR 1e-3
+
+/* most clip and refit passes */
+#define POSN_CLIP_TRIES 10
+
+static void equ_to_tangent(const struct adb_object *centre, double ra,
+						   double dec, double *xi, double *eta);
+static void tangent_to_equ(const struct adb_object *centre, double xi,
+						   double eta, double *ra_, double *dec_);
+
+/*
+ * Reference object positions as contiguous arrays for the least squares
+ * plate fit. Clipped references have a zero keep weight so each pass sums
+ * every array with the same vector kernel.
+ */
+struct posn_clip {
+	int count;
+	double *x, *y; /* plate position less the fit centre */
+	double *xi, *eta; /* tangent plane position */
+	double *keep; /* 1.0 for unclipped refs */
+	double *kx, *ky; /* keep * x, keep * y */
+	double *res; /* fit residual in pixels */
+};
+
+/*! \struct posn_equ_pair
+ * \brief Equatorial to plate transform taken from one reference pair.
+ */
+struct posn_equ_pair {
+	double x, y; /*!< plate position of the first reference */
+	double sin_dec, cos_dec; /*!< first reference DEC */
+	double sin_ra, cos_ra; /*!< first reference RA */
+	double cos_pa, sin_pa; /*!< equatorial to plate rotation */
+	double rad_per_pix; /*!< plate scale */
+};
+
 /**
- * @brief Converts equatorial coordinates back to plate pixel coordinates.
+ * @brief Check if a reference pair can be used for a transform.
  *
- * Uses two reference objects (o1, o2 and their corresponding plate coords p1, p2)
- * to calculate the transformation scale and rotation, and then applies this
- * transformation to find the plate position (x_, y_) for a target equatorial position.
+ * @param ref The first reference object.
+ * @param refn The second reference object.
+ * @param fast Use clipped reference objects too.
+ * @return 1 if the pair can be used, 0 otherwise.
+ */
+static int posn_pair_valid(struct adb_reference_object *ref,
+						   struct adb_reference_object *refn, int fast)
+{
+	if (ref == refn)
+		return 0;
+
+	if (!fast && (ref->clip_posn || refn->clip_posn))
+		return 0;
+
+	/* dont compare objects against itself */
+	if (ref->pobject.x == refn->pobject.x && ref->pobject.y == refn->pobject.y)
+		return 0;
+
+	return 1;
+}
+
+/**
+ * @brief Get the number of reference objects used for transforms.
  *
- * @param solution The active solve solution (unused in this function).
- * @param o1 The first reference object in equatorial coordinates.
- * @param o2 The second reference object in equatorial coordinates.
- * @param p1 The first reference object in plate coordinates.
- * @param p2 The second reference object in plate coordinates.
- * @param ra Target Right Ascension to convert.
- * @param dec Target Declination to convert.
- * @param x_ Output pointer for calculated plate X coordinate.
- * @param y_ Output pointer for calculated plate Y coordinate.
+ * @param solution The active solve solution holding reference objects.
+ * @param fast Only use the most confident reference objects.
+ * @return Number of reference objects.
  */
-static void equ_to_plate(struct adb_solve_solution *solution,
-						 const struct adb_object *o1,
-						 const struct adb_object *o2, struct adb_pobject *p1,
-						 struct adb_pobject *p2, double ra, double dec, int *x_,
-						 int *y_)
+static int posn_pair_objects(struct adb_solve_solution *solution, int fast)
 {
-	(void)solution;
-	struct adb_object otarget;
-	double plate_pa, equ_pa, delta_pa;
-	double plate_dist, equ_dist;
-	double rad_per_pixel, target_pa, target_dist;
-
-	/* delta PA between plate and equ */
-	plate_pa = equ_quad(pa_get_plate(p1, p2));
-	equ_pa = equ_quad(pa_get_equ(o1, o2));
-	delta_pa = plate_pa - equ_pa;
-
-	/* delta distance between plate and equ */
-	plate_dist = distance_get_plate(p1, p2);
-	equ_dist = distance_get_equ(o1, o2);
-	rad_per_pixel = equ_dist / plate_dist;
-
-	/* plate PA between object1 and target */
-	otarget.ra = ra;
-	otarget.dec = dec;
-	target_pa = equ_quad(pa_get_equ(o1, &otarget));
-	target_pa += delta_pa;
-
-	/* EQU dist between object1 and target */
-	target_dist = distance_get_equ(o1, &otarget);
-	target_dist /= rad_per_pixel;
-
-	/* add angle and distance onto P1 */
-	*x_ = p1->x - cos(target_pa) * target_dist;
-	*y_ = p1->y - sin(target_pa) * target_dist;
+	if (fast && solution->num_ref_objects > MIN_PLATE_OBJECTS)
+		return MIN_PLATE_OBJECTS;
+
+	return solution->num_ref_objects;
 }
 
 /**
- * @brief Converts plate pixel coordinates to equatorial coordinates.
- *
- * Uses two solved reference objects to calculate plate scale and rotation,
- * and then computes the RA/DEC corresponding to a target plate position
- * by interpolating from the references.
- *
- * @param solution The active solve solution (unused in this function).
- * @param o1 The first reference object in equatorial coordinates.
- * @param o2 The second reference object in equatorial coordinates.
- * @param p1 The first reference object in plate coordinates.
- * @param p2 The second reference object in plate coordinates.
- * @param ptarget The target plate object to convert.
- * @param ra_ Output pointer for calculated Right Ascension.
- * @param dec_ Output pointer for calculated Declination.
+ * @brief Solves 3 linear equations with Cramer's rule.
+ *
+ * @param m Symmetric normal equation matrix.
+ * @param r Right hand side.
+ * @param det Determinant of m.
+ * @param out Output solution.
  */
-static void plate_to_equ(struct adb_solve_solution *solution,
-						 const struct adb_object *o1,
-						 const struct adb_object *o2, struct adb_pobject *p1,
-						 struct adb_pobject *p2, struct adb_pobject *ptarget,
-						 double *ra_, double *dec_)
+static void fit_solve3(const double m[3][3], const double r[3], double det,
+					   double out[3])
 {
-	(void)solution;
-	double plate_pa, equ_pa, delta_pa;
-	double plate_dist, equ_dist;
-	double rad_per_pixel, target_pa, target_dist;
-	double ra, dec, mid_dec;
-
-	/* delta PA between plate and equ */
-	plate_pa = equ_quad(pa_get_plate(p1, p2));
-	equ_pa = equ_quad(pa_get_equ(o1, o2));
-	delta_pa = plate_pa - equ_pa;
-
-	/* delta distance between plate and equ */
-	plate_dist = distance_get_plate(p1, p2);
-	equ_dist = distance_get_equ(o1, o2);
-	rad_per_pixel = equ_dist / plate_dist;
-
-	/* EQU PA between object1 and target */
-	target_pa = equ_quad(pa_get_plate(p1, ptarget));
-	target_pa -= delta_pa;
-
-	/* EQU dist between object1 and target */
-	target_dist = distance_get_plate(p1, ptarget);
-	target_dist *= rad_per_pixel;
-
-	/* middle declination of line */
-	mid_dec = o1->dec + ((o2->dec - o1->dec) / 2.0);
-
-	/* Add line to object o1, reverse RA since RHS of plate increases X and
-	 * RHS of sky is decreasing in RA.
-	 */
-	ra = -cos(target_pa) * target_dist / cos(mid_dec);
-	dec = -sin(target_pa) * target_dist;
-
-	/* make sure DEC is -90.0 .. 90.0 */
-	dec = dec + o1->dec;
-	if (dec > M_PI_2) {
-		dec = M_PI_2 - (dec - M_PI_2);
-		ra += M_PI; /* swap sides */
-	} else if (dec < -M_PI_2) {
-		dec = -M_PI_2 - (dec + M_PI_2);
-		ra += M_PI; /* swap sides */
+	out[0] = (r[0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+			  m[0][1] * (r[1] * m[2][2] - m[1][2] * r[2]) +
+			  m[0][2] * (r[1] * m[2][1] - m[1][1] * r[2])) /
+			 det;
+	out[1] = (m[0][0] * (r[1] * m[2][2] - m[1][2] * r[2]) -
+			  r[0] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+			  m[0][2] * (m[1][0] * r[2] - r[1] * m[2][0])) /
+			 det;
+	out[2] = (m[0][0] * (m[1][1] * r[2] - r[1] * m[2][1]) -
+			  m[0][1] * (m[1][0] * r[2] - r[1] * m[2][0]) +
+			  r[0] * (m[1][0] * m[2][1] - m[1][1] * m[2][0])) /
+			 det;
+}
+
+static void posn_clip_free(struct posn_clip *clip)
+{
+	free(clip->x);
+}
+
+/**
+ * @brief Gathers the plate and tangent plane position of each reference.
+ *
+ * @param solution The active solve solution holding reference objects.
+ * @param clip Clip arrays to fill.
+ * @return 0 on success or -ENOMEM.
+ */
+static int posn_clip_init(struct adb_solve_solution *solution,
+						  struct posn_clip *clip)
+{
+	struct posn_plate_fit *fit = &solution->fit;
+	struct adb_reference_object *ref;
+	int n = solution->num_ref_objects, i;
+
+	clip->count = n;
+	clip->x = calloc(n * 8, sizeof(double));
+	if (clip->x == NULL)
+		return -ENOMEM;
+
+	clip->y = clip->x + n;
+	clip->xi = clip->y + n;
+	clip->eta = clip->xi + n;
+	clip->keep = clip->eta + n;
+	clip->kx = clip->keep + n;
+	clip->ky = clip->kx + n;
+	clip->res = clip->ky + n;
+
+	/* centre the plate so the normal equations keep their precision */
+	fit->centre = solution->object[0];
+	fit->xm = fit->ym = 0.0;
+	for (i = 0; i < n; i++) {
+		fit->xm += solution->ref[i].pobject.x;
+		fit->ym += solution->ref[i].pobject.y;
 	}
+	fit->xm /= n;
+	fit->ym /= n;
 
-	/* make sure RA is between 0..360 */
-	ra = ra + o1->ra;
-	if (ra > 2.0 * M_PI)
-		ra -= 2.0 * M_PI;
-	if (ra < 0.0)
-		ra += 2.0 * M_PI;
+	for (i = 0; i < n; i++) {
+		ref = &solution->ref[i];
+		clip->x[i] = ref->pobject.x - fit->xm;
+		clip->y[i] = ref->pobject.y - fit->ym;
+		equ_to_tangent(fit->centre, ref->object->ra, ref->object->dec,
+					   &clip->xi[i], &clip->eta[i]);
+	}
 
-	*ra_ = ra;
-	*dec_ = dec;
+	return 0;
 }
 
 /**
- * @brief Calculates the mean positional difference ratio per reference target.
+ * @brief Fits the unclipped references and gets every residual.
  *
- * Scans all reference objects to compute the average ratio of equatorial distance
- * to plate distance (radians per pixel), relative to the specified target.
+ * Least squares fit of xi = a0 + a1 * x + a2 * y and eta = b0 + b1 * x +
+ * b2 * y, so scale, rotation, parity and shear are all part of the model.
  *
  * @param solution The active solve solution holding reference objects.
- * @param target The index of the reference object being evaluated.
- * @return The mean radians per pixel ratio for the target.
+ * @param clip Clip arrays, residuals are updated.
+ * @param rms Output RMS residual of the unclipped references in pixels.
+ * @return Number of unclipped references or -EINVAL for a degenerate fit.
  */
-static double get_ref_posn_delta_mean(struct adb_solve_solution *solution,
-									  int target)
+static int posn_clip_fit(struct adb_solve_solution *solution,
+						 struct posn_clip *clip, double *rms)
 {
-	struct adb_reference_object *ref, *reft;
-	double mean = 0.0, plate_dist, equ_dist, rad_per_pixel;
-	int i, count = 0;
+	struct posn_plate_fit *fit = &solution->fit;
+	double m[3][3], r[3], det, scale, dxi, deta, sum = 0.0;
+	int n = clip->count, i, kept = 0;
+
+	for (i = 0; i < n; i++) {
+		clip->keep[i] = solution->ref[i].clip_posn ? 0.0 : 1.0;
+		clip->kx[i] = clip->keep[i] * clip->x[i];
+		clip->ky[i] = clip->keep[i] * clip->y[i];
+		kept += !solution->ref[i].clip_posn;
+	}
 
-	reft = &solution->ref[target];
+	/* normal equations share the plate sums */
+	m[0][0] = simd_dot(clip->keep, clip->keep, n);
+	m[0][1] = m[1][0] = simd_dot(clip->keep, clip->x, n);
+	m[0][2] = m[2][0] = simd_dot(clip->keep, clip->y, n);
+	m[1][1] = simd_dot(clip->kx, clip->x, n);
+	m[1][2] = m[2][1] = simd_dot(clip->kx, clip->y, n);
+	m[2][2] = simd_dot(clip->ky, clip->y, n);
+
+	det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+		  m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+		  m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+
+	/* references on a line can't fix the plate */
+	if (kept < 3 || det <= 1e-9 * m[0][0] * m[1][1] * m[2][2])
+		return -EINVAL;
+
+	r[0] = simd_dot(clip->keep, clip->xi, n);
+	r[1] = simd_dot(clip->kx, clip->xi, n);
+	r[2] = simd_dot(clip->ky, clip->xi, n);
+	fit_solve3(m, r, det, fit->a);
+
+	r[0] = simd_dot(clip->keep, clip->eta, n);
+	r[1] = simd_dot(clip->kx, clip->eta, n);
+	r[2] = simd_dot(clip->ky, clip->eta, n);
+	fit_solve3(m, r, det, fit->b);
+
+	scale = sqrt(fabs(fit->a[1] * fit->b[2] - fit->a[2] * fit->b[1]));
+	if (scale == 0.0)
+		return -EINVAL;
+
+	for (i = 0; i < n; i++) {
+		dxi = fit->a[0] + fit->a[1] * clip->x[i] + fit->a[2] * clip->y[i] -
+			  clip->xi[i];
+		deta = fit->b[0] + fit->b[1] * clip->x[i] + fit->b[2] * clip->y[i] -
+			   clip->eta[i];
+		clip->res[i] = sqrt(dxi * dxi + deta * deta) / scale;
+		sum += clip->keep[i] * clip->res[i] * clip->res[i];
+
+		solution->ref[i].dist_mean = scale;
+		solution->ref[i].posn_sigma = clip->res[i];
+	}
 
-	/* get RA, DEC for each reference object */
-	for (i = 0; i < solution->num_ref_objects; i++) {
-		ref = &solution->ref[i];
+	*rms = sqrt(sum / kept);
+	return kept;
+}
 
-		if (ref->clip_posn || i == target)
-			continue;
+/**
+ * @brief Fits the plate to the reference objects.
+ *
+ * @param solution The active solve solution holding reference objects.
+ * @param tries Clip and refit passes, 0 to only fit the unclipped references.
+ * @return 0 on success or a negative error code.
+ */
+static int posn_fit_plate(struct adb_solve_solution *solution, int tries)
+{
+	struct posn_clip clip;
+	double rms, limit;
+	int i, kept, clipped, ret;
 
-		/* dont compare object against itself */
-		if (ref->pobject.x == reft->pobject.x &&
-			ref->pobject.y == reft->pobject.y)
-			continue;
+	solution->fit.valid = 0;
 
-		/* get plate distance */
-		plate_dist = distance_get_plate(&reft->pobject, &ref->pobject);
+	/* we need at least 3 reference objects */
+	if (solution->num_ref_objects < 3 || solution->object[0] == NULL)
+		return -EINVAL;
 
-		/* get equ distance */
-		equ_dist = distance_get_equ(reft->object, ref->object);
+	ret = posn_clip_init(solution, &clip);
+	if (ret < 0)
+		return ret;
 
-		/* get plate/equ ratio */
-		rad_per_pixel = equ_dist / plate_dist;
+	while ((kept = posn_clip_fit(solution, &clip, &rms)) > 0 && tries--) {
+		limit = POSN_CLIP_RMS * (rms > POSN_CLIP_FLOOR ? rms : POSN_CLIP_FLOOR);
 
-		mean += rad_per_pixel;
-		count++;
+		/* keep enough references to overdetermine the fit */
+		for (i = 0, clipped = 0; i < clip.count; i++)
+			clipped += clip.keep[i] != 0.0 && clip.res[i] > limit;
+		if (clipped == 0 || kept - clipped < MIN_PLATE_OBJECTS)
+			break;
+
+		for (i = 0; i < clip.count; i++) {
+			if (clip.res[i] > limit)
+				solution->ref[i].clip_posn = 1;
+		}
 	}
 
-	if (count == 0)
-		return 0.0;
+	posn_clip_free(&clip);
+	if (kept < 0)
+		return kept;
 
-	return mean / (double)count;
+	solution->fit.valid = 1;
+	return 0;
 }
 
 /**
- * @brief Calculates the positional variance (sigma) for a reference target.
+ * @brief Gets the least squares plate fit when the solve uses it.
  *
- * Computes the standard deviation of the plate/equ_dist ratios for all
- * reference objects relative to the provided target object, against the mean.
+ * Fits the unclipped references when they have changed since the last fit.
  *
  * @param solution The active solve solution holding reference objects.
- * @param target The index of the reference object being evaluated.
- * @param mean The previously calculated mean distance ratio.
- * @return The standard deviation representing positional variance.
+ * @return The plate fit or NULL to use the reference pairs.
  */
-static double get_ref_posn_delta_sigma(struct adb_solve_solution *solution,
-									   int target, double mean)
+static const struct posn_plate_fit *
+posn_get_fit(struct adb_solve_solution *solution)
 {
-	(void)mean;
-	struct adb_reference_object *ref, *reft;
-	double sigma = 0.0, plate_dist, equ_dist, rad_per_pixel;
-	int i, count = 0;
+	if (solution->solve == NULL ||
+		solution->solve->plate_fit != ADB_PLATE_FIT_LSQ)
+		return NULL;
 
-	reft = &solution->ref[target];
+	if (!solution->fit.valid && posn_fit_plate(solution, 0) < 0)
+		return NULL;
 
-	/* get RA, DEC for each reference object */
-	for (i = 0; i < solution->num_ref_objects - 1; i++) {
-		ref = &solution->ref[i];
+	return &solution->fit;
+}
 
-		if (ref->clip_posn || i == target)
-			continue;
+/**
+ * @brief Converts plate positions with the least squares plate fit.
+ *
+ * @param fit The plate fit.
+ * @param x Plate X positions.
+ * @param y Plate Y positions.
+ * @param count Number of positions.
+ * @param ra Output Right Ascensions.
+ * @param dec Output Declinations.
+ */
+static void posn_fit_to_equ(const struct posn_plate_fit *fit, const double *x,
+							const double *y, int count, double *ra,
+							double *dec)
+{
+	double dx, dy;
+	int i;
 
-		/* dont compare object against itself */
-		if (ref->pobject.x == reft->pobject.x &&
-			ref->pobject.y == reft->pobject.y)
-			continue;
+	for (i = 0; i < count; i++) {
+		dx = x[i] - fit->xm;
+		dy = y[i] - fit->ym;
+		tangent_to_equ(fit->centre, fit->a[0] + fit->a[1] * dx + fit->a[2] * dy,
+					   fit->b[0] + fit->b[1] * dx + fit->b[2] * dy, &ra[i],
+					   &dec[i]);
+	}
+}
 
-		/* get plate distance */
-		plate_dist = distance_get_plate(&reft->pobject, &ref->pobject);
+/**
+ * @brief Converts equatorial positions with the least squares plate fit.
+ *
+ * @param fit The plate fit.
+ * @param ra Right Ascensions.
+ * @param dec Declinations.
+ * @param count Number of positions.
+ * @param x Output plate X positions.
+ * @param y Output plate Y positions.
+ */
+static void posn_fit_to_plate(const struct posn_plate_fit *fit,
+							  const double *ra, const double *dec, int count,
+							  double *x, double *y)
+{
+	double det = fit->a[1] * fit->b[2] - fit->a[2] * fit->b[1], xi, eta;
+	int i;
 
-		/* get equ distance */
-		equ_dist = distance_get_equ(reft->object, ref->object);
+	for (i = 0; i < count; i++) {
+		equ_to_tangent(fit->centre, ra[i], dec[i], &xi, &eta);
+		xi -= fit->a[0];
+		eta -= fit->b[0];
+		x[i] = fit->xm + (fit->b[2] * xi - fit->a[2] * eta) / det;
+		y[i] = fit->ym + (fit->a[1] * eta - fit->b[1] * xi) / det;
+	}
+}
 
-		/* get plate/equ ratio */
-		rad_per_pixel = equ_dist / plate_dist;
+/**
+ * @brief Get the plate to equatorial transform of every reference pair.
+ *
+ * Uses each ordered pair of reference objects (o1, o2 and their plate
+ * coords p1, p2) to calculate the plate scale and rotation. Targets are
+ * later placed relative to p1 and o1.
+ *
+ * @param solution The active solve solution holding reference objects.
+ * @param fast Only use the most confident reference objects.
+ * @param pair_ Output pair transforms, NULL if there are none.
+ * @return Number of pairs or -ENOMEM.
+ */
+static int posn_get_plate_pairs(struct adb_solve_solution *solution, int fast,
+								struct simd_plate_pair **pair_)
+{
+	struct adb_reference_object *ref, *refn;
+	struct simd_plate_pair *pair;
+	double plate_pa, equ_pa, delta_pa;
+	int i, j, n = 0, objects = posn_pair_objects(solution, fast);
 
-		rad_per_pixel -= reft->dist_mean;
-		rad_per_pixel *= rad_per_pixel;
-		sigma += rad_per_pixel;
-		count++;
-	}
+	*pair_ = NULL;
+	if (objects < 2)
+		return 0;
+
+	pair = calloc(objects * objects, sizeof(*pair));
+	if (pair == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < objects; i++) {
+		for (j = 0; j < objects; j++) {
+			ref = &solution->ref[i];
+			refn = &solution->ref[j];
 
-	if (count == 0)
-		return 0.0;
+			if (!posn_pair_valid(ref, refn, fast))
+				continue;
 
-	sigma /= (double)count;
-	return sqrtf(sigma);
+			/* delta PA between plate and equ */
+			plate_pa = equ_quad(pa_get_plate(&ref->pobject, &refn->pobject));
+			equ_pa = equ_quad(pa_get_equ(ref->object, refn->object));
+			delta_pa = plate_pa - equ_pa;
+
+			pair[n].x1 = ref->pobject.x;
+			pair[n].y1 = ref->pobject.y;
+			pair[n].x2 = refn->pobject.x;
+			pair[n].y2 = refn->pobject.y;
+			pair[n].ra = ref->object->ra;
+			pair[n].dec = ref->object->dec;
+			pair[n].cos_pa = cos(delta_pa);
+			pair[n].sin_pa = sin(delta_pa);
+
+			/* delta distance between plate and equ */
+			pair[n].rad_per_pix =
+				distance_get_equ(ref->object, refn->object) /
+				distance_get_plate(&ref->pobject, &refn->pobject);
+
+			/* middle declination of line */
+			pair[n].cos_mid_dec =
+				cos(ref->object->dec +
+					((refn->object->dec - ref->object->dec) / 2.0));
+			n++;
+		}
+	}
+
+	*pair_ = pair;
+	return n;
 }
 
 /**
- * @brief Averages equatorial-to-plate coordinate transformations.
- *
- * Calculates plate X,Y coordinates for a given RA/DEC by independently computing
- * the transformation using every pair of reference objects and averaging the result.
+ * @brief Get the equatorial to plate transform of every reference pair.
  *
  * @param solution The active solve solution holding reference objects.
- * @param ra Target Right Ascension to convert.
- * @param dec Target Declination to convert.
- * @param x_ Output pointer for averaged plate X coordinate.
- * @param y_ Output pointer for averaged plate Y coordinate.
+ * @param fast Only use the most confident reference objects.
+ * @param pair_ Output pair transforms, NULL if there are none.
+ * @return Number of pairs or -ENOMEM.
  */
-void posn_equ_to_plate(struct adb_solve_solution *solution, double ra,
-					   double dec, double *x_, double *y_)
+static int posn_get_equ_pairs(struct adb_solve_solution *solution, int fast,
+							  struct posn_equ_pair **pair_)
 {
 	struct adb_reference_object *ref, *refn;
-	int x_sum = 0, y_sum = 0, i, j, count = 0, x, y;
+	struct posn_equ_pair *pair;
+	double plate_pa, equ_pa, delta_pa;
+	int i, j, n = 0, objects = posn_pair_objects(solution, fast);
 
-	/* get RA, DEC for each reference object */
-	for (i = 0; i < solution->num_ref_objects; i++) {
-		for (j = 0; j < solution->num_ref_objects; j++) {
+	*pair_ = NULL;
+	if (objects < 2)
+		return 0;
+
+	pair = calloc(objects * objects, sizeof(*pair));
+	if (pair == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < objects; i++) {
+		for (j = 0; j < objects; j++) {
 			ref = &solution->ref[i];
 			refn = &solution->ref[j];
 
-			if (j == i)
+			if (!posn_pair_valid(ref, refn, fast))
 				continue;
 
-			if (ref->clip_posn || refn->clip_posn)
-				continue;
+			/* delta PA between plate and equ */
+			plate_pa = equ_quad(pa_get_plate(&ref->pobject, &refn->pobject));
+			equ_pa = equ_quad(pa_get_equ(ref->object, refn->object));
+			delta_pa = plate_pa - equ_pa;
+
+			pair[n].x = ref->pobject.x;
+			pair[n].y = ref->pobject.y;
+			pair[n].sin_dec = sin(ref->object->dec);
+			pair[n].cos_dec = cos(ref->object->dec);
+			pair[n].sin_ra = sin(ref->object->ra);
+			pair[n].cos_ra = cos(ref->object->ra);
+			pair[n].cos_pa = cos(delta_pa);
+			pair[n].sin_pa = sin(delta_pa);
+
+			/* delta distance between plate and equ */
+			pair[n].rad_per_pix =
+				distance_get_equ(ref->object, refn->object) /
+				distance_get_plate(&ref->pobject, &refn->pobject);
+			n++;
+		}
+	}
 
-			/* dont compare objects against itself */
-			if (ref->pobject.x == refn->pobject.x &&
-				ref->pobject.y == refn->pobject.y)
-				continue;
+	*pair_ = pair;
+	return n;
+}
+
+/**
+ * @brief Averages plate-to-equatorial transforms of a run of positions.
+ *
+ * Each position is transformed by every reference pair that doesn't
+ * include it on the plate, then the results are averaged.
+ *
+ * @param pair Reference pair transforms.
+ * @param pairs Number of pairs.
+ * @param x Plate X positions.
+ * @param y Plate Y positions.
+ * @param count Number of positions, at most POSN_CHUNK.
+ * @param ra Output averaged Right Ascensions.
+ * @param dec Output averaged Declinations.
+ */
+static void posn_plate_to_equ_chunk(const struct simd_plate_pair *pair,
+									int pairs, const double *x,
+									const double *y, int count, double *ra,
+									double *dec)
+{
+	double hits[POSN_CHUNK];
+	int i;
 
-			equ_to_plate(solution, ref->object, refn->object, &ref->pobject,
-						 &refn->pobject, ra, dec, &x, &y);
+	for (i = 0; i < count; i++) {
+		ra[i] = 0.0;
+		dec[i] = 0.0;
+		hits[i] = 0.0;
+	}
+
+	for (i = 0; i < pairs; i++)
+		simd_plate_to_equ(x, y, count, &pair[i], ra, dec, hits);
 
-			x_sum += x;
-			y_sum += y;
-			count++;
+	for (i = 0; i < count; i++) {
+		if (hits[i] > 0.0) {
+			ra[i] /= hits[i];
+			dec[i] /= hits[i];
 		}
 	}
+}
+
+int posn_plate_to_equ_array(struct adb_solve_solution *solution,
+							const double *x, const double *y, int count,
+							double *ra, double *dec, int fast)
+{
+	const struct posn_plate_fit *fit = posn_get_fit(solution);
+	struct simd_plate_pair *pair;
+	int i, pairs, n;
+
+	if (fit) {
+		posn_fit_to_equ(fit, x, y, count, ra, dec);
+		return 0;
+	}
+
+	pairs = posn_get_plate_pairs(solution, fast, &pair);
+	if (pairs < 0)
+		return pairs;
+
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) private(n) \
+	num_threads(db_workers(solution->db)) if (count > 16 * POSN_CHUNK)
+#endif
+	for (i = 0; i < count; i += POSN_CHUNK) {
+		n = count - i;
+		if (n > POSN_CHUNK)
+			n = POSN_CHUNK;
 
-	if (count > 0) {
-		*x_ = (double)x_sum / (double)count;
-		*y_ = (double)y_sum / (double)count;
+		posn_plate_to_equ_chunk(pair, pairs, x + i, y + i, n, ra + i, dec + i);
+	}
+
+	free(pair);
+	return 0;
+}
+
+/**
+ * @brief Averages equatorial-to-plate transforms of one position.
+ *
+ * Calculates the plate position of the target from every reference pair,
+ * placing it relative to the first reference on the plate, and averages
+ * the integer positions.
+ *
+ * @param pair Reference pair transforms.
+ * @param pairs Number of pairs.
+ * @param ra Target Right Ascension to convert.
+ * @param dec Target Declination to convert.
+ * @param x_ Output averaged plate X coordinate.
+ * @param y_ Output averaged plate Y coordinate.
+ */
+static void posn_equ_to_plate_pairs(const struct posn_equ_pair *pair,
+									int pairs, double ra, double dec,
+									double *x_, double *y_)
+{
+	double sin_dec = sin(dec), cos_dec = cos(dec);
+	double sin_ra = sin(ra), cos_ra = cos(ra);
+	double sin_rd, cos_rd, k, px, py, dx, dy, dz, len, dist, c, s;
+	int x_sum = 0, y_sum = 0, i;
+
+	for (i = 0; i < pairs; i++) {
+		/* sin, cos of the first reference RA less the target RA */
+		sin_rd = pair[i].sin_ra * cos_ra - pair[i].cos_ra * sin_ra;
+		cos_rd = pair[i].cos_ra * cos_ra + pair[i].sin_ra * sin_ra;
+
+		/* plate PA between the first reference and target */
+		k = 2.0 / (1.0 + sin_dec * pair[i].sin_ra +
+				   cos_dec * pair[i].cos_dec * cos_rd);
+		px = k * (pair[i].cos_dec * sin_rd);
+		py = k * (cos_dec * pair[i].sin_dec -
+				  sin_dec * pair[i].cos_dec * cos_rd);
+
+		/* EQU dist between the first reference and target */
+		dx = pair[i].cos_dec * sin_dec - pair[i].sin_dec * cos_dec * cos_rd;
+		dy = -cos_dec * sin_rd;
+		dz = pair[i].sin_dec * sin_dec + pair[i].cos_dec * cos_dec * cos_rd;
+		dist = atan2(sqrt(dx * dx + dy * dy), dz) / pair[i].rad_per_pix;
+
+		/* rotate the target PA onto the plate */
+		len = sqrt(px * px + py * py);
+		if (len > 0.0) {
+			c = (px * pair[i].cos_pa - py * pair[i].sin_pa) / len;
+			s = (py * pair[i].cos_pa + px * pair[i].sin_pa) / len;
+		} else {
+			c = pair[i].cos_pa;
+			s = pair[i].sin_pa;
+		}
+
+		/* add angle and distance onto P1 */
+		x_sum += (int)(pair[i].x - c * dist);
+		y_sum += (int)(pair[i].y - s * dist);
+	}
+
+	if (pairs > 0) {
+		*x_ = (double)x_sum / (double)pairs;
+		*y_ = (double)y_sum / (double)pairs;
 	} else {
 		*x_ = 0;
 		*y_ = 0;
 	}
 }
 
+int posn_equ_to_plate_array(struct adb_solve_solution *solution,
+							const double *ra, const double *dec, int count,
+							double *x, double *y, int fast)
+{
+	const struct posn_plate_fit *fit = posn_get_fit(solution);
+	struct posn_equ_pair *pair;
+	int i, pairs;
+
+	if (fit) {
+		posn_fit_to_plate(fit, ra, dec, count, x, y);
+		return 0;
+	}
+
+	pairs = posn_get_equ_pairs(solution, fast, &pair);
+	if (pairs < 0)
+		return pairs;
+
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) \
+	num_threads(db_workers(solution->db)) if (count > 16 * POSN_CHUNK)
+#endif
+	for (i = 0; i < count; i++)
+		posn_equ_to_plate_pairs(pair, pairs, ra[i], dec[i], &x[i], &y[i]);
+
+	free(pair);
+	return 0;
+}
+
+/**
+ * @brief Averages equatorial-to-plate coordinate transformations.
+ *
+ * Calculates plate X,Y coordinates for a given RA/DEC by independently computing
+ * the transformation using every pair of reference objects and averaging the result.
+ *
+ * @param solution The active solve solution holding reference objects.
+ * @param ra Target Right Ascension to convert.
+ * @param dec Target Declination to convert.
+ * @param x_ Output pointer for averaged plate X coordinate.
+ * @param y_ Output pointer for averaged plate Y coordinate.
+ */
+void posn_equ_to_plate(struct adb_solve_solution *solution, double ra,
+					   double dec, double *x_, double *y_)
+{
+	if (posn_equ_to_plate_array(solution, &ra, &dec, 1, x_, y_, 0) < 0)
+		*x_ = *y_ = 0.0;
+}
+
 /**
  * @brief Quickly averages equatorial-to-plate coordinate transformations.
  *
@@ -329,44 +703,8 @@ void posn_equ_to_plate(struct adb_solve_solution *solution, double ra,
 void posn_equ_to_plate_fast(struct adb_solve_solution *solution, double ra,
 							double dec, double *x_, double *y_)
 {
-	struct adb_reference_object *ref, *refn;
-	int x_sum = 0, y_sum = 0, i, j, count = 0, x, y, objects;
-
-	if (solution->num_ref_objects < MIN_PLATE_OBJECTS)
-		objects = solution->num_ref_objects;
-	else
-		objects = MIN_PLATE_OBJECTS;
-
-	/* get RA, DEC for each reference object */
-	for (i = 0; i < objects; i++) {
-		for (j = 0; j < objects; j++) {
-			ref = &solution->ref[i];
-			refn = &solution->ref[j];
-
-			if (j == i)
-				continue;
-
-			/* dont compare objects against itself */
-			if (ref->pobject.x == refn->pobject.x &&
-				ref->pobject.y == refn->pobject.y)
-				continue;
-
-			equ_to_plate(solution, ref->object, refn->object, &ref->pobject,
-						 &refn->pobject, ra, dec, &x, &y);
-
-			x_sum += x;
-			y_sum += y;
-			count++;
-		}
-	}
-
-	if (count > 0) {
-		*x_ = (double)x_sum / (double)count;
-		*y_ = (double)y_sum / (double)count;
-	} else {
-		*x_ = 0;
-		*y_ = 0;
-	}
+	if (posn_equ_to_plate_array(solution, &ra, &dec, 1, x_, y_, 1) < 0)
+		*x_ = *y_ = 0.0;
 }
 
 /**
@@ -383,51 +721,10 @@ void posn_equ_to_plate_fast(struct adb_solve_solution *solution, double ra,
 void posn_plate_to_equ(struct adb_solve_solution *solution,
 					   struct adb_pobject *primary, double *ra_, double *dec_)
 {
-	struct adb_reference_object *ref, *refn;
-	double ra_sum = 0.0, dec_sum = 0.0, ra, dec;
-	int i, j, count = 0;
-
-	/* get RA, DEC for each reference object */
-	for (i = 0; i < solution->num_ref_objects; i++) {
-		for (j = 0; j < solution->num_ref_objects; j++) {
-			ref = &solution->ref[i];
-			refn = &solution->ref[j];
-
-			if (j == i)
-				continue;
+	double x = primary->x, y = primary->y;
 
-			if (ref->clip_posn || refn->clip_posn)
-				continue;
-
-			/* dont primary object against itself */
-			if (ref->pobject.x == primary->x && ref->pobject.y == primary->y)
-				continue;
-
-			/* dont primary object against itself */
-			if (refn->pobject.x == primary->x && refn->pobject.y == primary->y)
-				continue;
-
-			/* dont compare objects against itself */
-			if (ref->pobject.x == refn->pobject.x &&
-				ref->pobject.y == refn->pobject.y)
-				continue;
-
-			plate_to_equ(solution, ref->object, refn->object, &ref->pobject,
-						 &refn->pobject, primary, &ra, &dec);
-
-			ra_sum += ra;
-			dec_sum += dec;
-			count++;
-		}
-	}
-
-	if (count > 0) {
-		*ra_ = ra_sum / count;
-		*dec_ = dec_sum / count;
-	} else {
-		*ra_ = 0.0;
-		*dec_ = 0.0;
-	}
+	if (posn_plate_to_equ_array(solution, &x, &y, 1, ra_, dec_, 0) < 0)
+		*ra_ = *dec_ = 0.0;
 }
 
 /**
@@ -445,134 +742,183 @@ void posn_plate_to_equ_fast(struct adb_solve_solution *solution,
 							struct adb_pobject *primary, double *ra_,
 							double *dec_)
 {
-	struct adb_reference_object *ref, *refn;
-	double ra_sum = 0.0, dec_sum = 0.0, ra, dec;
-	int i, j, count = 0, objects;
+	double x = primary->x, y = primary->y;
 
-	if (solution->num_ref_objects < MIN_PLATE_OBJECTS)
-		objects = solution->num_ref_objects;
-	else
-		objects = MIN_PLATE_OBJECTS;
-
-	/* get RA, DEC for each reference object */
-	for (i = 0; i < objects; i++) {
-		for (j = 0; j < objects; j++) {
-			ref = &solution->ref[i];
-			refn = &solution->ref[j];
-
-			if (j == i)
-				continue;
-
-			/* dont primary object against itself */
-			if (ref->pobject.x == primary->x && ref->pobject.y == primary->y)
-				continue;
-
-			/* dont primary object against itself */
-			if (refn->pobject.x == primary->x && refn->pobject.y == primary->y)
-				continue;
-
-			/* dont compare objects against itself */
-			if (ref->pobject.x == refn->pobject.x &&
-				ref->pobject.y == refn->pobject.y)
-				continue;
+	if (posn_plate_to_equ_array(solution, &x, &y, 1, ra_, dec_, 1) < 0)
+		*ra_ = *dec_ = 0.0;
+}
 
-			plate_to_equ(solution, ref->object, refn->object, &ref->pobject,
-						 &refn->pobject, primary, &ra, &dec);
+/**
+ * @brief Projects equatorial coordinates onto the tangent plane at a centre.
+ *
+ * @param centre Tangent point.
+ * @param ra Right Ascension to project.
+ * @param dec Declination to project.
+ * @param xi Output standard coordinate towards increasing RA.
+ * @param eta Output standard coordinate towards increasing DEC.
+ */
+static void equ_to_tangent(const struct adb_object *centre, double ra,
+						   double dec, double *xi, double *eta)
+{
+	double cos_c, ra_delta = ra - centre->ra;
 
-			ra_sum += ra;
-			dec_sum += dec;
-			count++;
-		}
-	}
+	cos_c = sin(centre->dec) * sin(dec) +
+			cos(centre->dec) * cos(dec) * cos(ra_delta);
 
-	if (count > 0) {
-		*ra_ = ra_sum / count;
-		*dec_ = dec_sum / count;
-	} else {
-		*ra_ = 0.0;
-		*dec_ = 0.0;
-	}
+	*xi = cos(dec) * sin(ra_delta) / cos_c;
+	*eta = (cos(centre->dec) * sin(dec) -
+			sin(centre->dec) * cos(dec) * cos(ra_delta)) /
+		   cos_c;
 }
 
 /**
- * @brief Clips out reference objects with anomalous positional divergence.
- *
- * Iteratively computes the standard deviation of positional ratios for all
- * reference objects and flags out any elements that deviate beyond 1-sigma.
- * This statistically stabilizes the celestial coordinate transformations.
+ * @brief Projects tangent plane coordinates back to equatorial coordinates.
  *
- * @param solution The active solve solution holding reference objects.
+ * @param centre Tangent point.
+ * @param xi Standard coordinate towards increasing RA.
+ * @param eta Standard coordinate towards increasing DEC.
+ * @param ra_ Output pointer for Right Ascension.
+ * @param dec_ Output pointer for Declination.
  */
-void posn_clip_plate_coefficients(struct adb_solve_solution *solution)
+static void tangent_to_equ(const struct adb_object *centre, double xi,
+						   double eta, double *ra_, double *dec_)
 {
-	struct adb_reference_object *ref;
-	int i, count = 0, tries = 10, lastcount;
-	double mean_sigma = 0.0, sigma_sigma = 0.0, t, clip;
+	double rho = sqrt(xi * xi + eta * eta), c, ra;
 
-	/* we need at least 3 reference objects */
-	if (solution->num_ref_objects < 3)
+	if (rho == 0.0) {
+		*ra_ = centre->ra;
+		*dec_ = centre->dec;
 		return;
+	}
 
-	do {
-		lastcount = count;
-		count = 0;
-
-		/* calc mean sigma delta per reference target */
-		for (i = 0; i < solution->num_ref_objects; i++) {
-			ref = &solution->ref[i];
-
-			if (ref->clip_posn)
-				continue;
-
-			ref->dist_mean = get_ref_posn_delta_mean(solution, i);
-			ref->posn_sigma =
-				get_ref_posn_delta_sigma(solution, i, ref->dist_mean);
-
-			mean_sigma += ref->posn_sigma;
-			count++;
-		}
-
-		if (count == 0)
-			return;
+	c = atan(rho);
+	*dec_ = asin(cos(c) * sin(centre->dec) +
+				 eta * sin(c) * cos(centre->dec) / rho);
 
-		mean_sigma /= count;
+	ra = centre->ra + atan2(xi * sin(c), rho * cos(centre->dec) * cos(c) -
+											 eta * sin(centre->dec) * sin(c));
+	if (ra >= 2.0 * M_PI)
+		ra -= 2.0 * M_PI;
+	if (ra < 0.0)
+		ra += 2.0 * M_PI;
+	*ra_ = ra;
+}
 
-		/* calc sigm sigma delta per target */
-		count = 0;
-		sigma_sigma = 0.0;
-		for (i = 0; i < solution->num_ref_objects; i++) {
-			ref = &solution->ref[i];
+/**
+ * @brief Fits plate to tangent plane scale, rotation and offset.
+ *
+ * Least squares fit of w = a * z + b with z = x + iy (x - iy when flipped)
+ * on the plate and w = xi + i eta on the tangent plane.
+ *
+ * @param solution The solve solution.
+ * @param flip Mirror the plate Y axis.
+ * @param a Output rotation and scale, real and imaginary parts.
+ * @param b Output offset, real and imaginary parts.
+ * @return Sum of the squared fit residuals.
+ */
+static double fit_solve_plate(struct adb_solve_solution *solution, int flip,
+							  double a[2], double b[2])
+{
+	double xi[MIN_PLATE_OBJECTS], eta[MIN_PLATE_OBJECTS];
+	double zx, zy, wx, wy, zx_mean = 0.0, zy_mean = 0.0;
+	double wx_mean = 0.0, wy_mean = 0.0, zz = 0.0, err = 0.0;
+	int i;
 
-			if (ref->clip_posn)
-				continue;
+	a[0] = a[1] = 0.0;
+	for (i = 0; i < MIN_PLATE_OBJECTS; i++) {
+		equ_to_tangent(solution->object[0], solution->object[i]->ra,
+					   solution->object[i]->dec, &xi[i], &eta[i]);
+		zx_mean += solution->soln_pobject[i].x;
+		zy_mean += flip ? -solution->soln_pobject[i].y :
+						  solution->soln_pobject[i].y;
+		wx_mean += xi[i];
+		wy_mean += eta[i];
+	}
+	zx_mean /= MIN_PLATE_OBJECTS;
+	zy_mean /= MIN_PLATE_OBJECTS;
+	wx_mean /= MIN_PLATE_OBJECTS;
+	wy_mean /= MIN_PLATE_OBJECTS;
+
+	/* a = sum((w - w_mean) * conj(z - z_mean)) / sum(|z - z_mean|^2) */
+	for (i = 0; i < MIN_PLATE_OBJECTS; i++) {
+		zx = solution->soln_pobject[i].x - zx_mean;
+		zy = (flip ? -solution->soln_pobject[i].y :
+					 solution->soln_pobject[i].y) -
+			 zy_mean;
+		wx = xi[i] - wx_mean;
+		wy = eta[i] - wy_mean;
+		a[0] += wx * zx + wy * zy;
+		a[1] += wy * zx - wx * zy;
+		zz += zx * zx + zy * zy;
+	}
 
-			t = ref->posn_sigma - mean_sigma;
-			t *= t;
-			sigma_sigma += t;
-			count++;
-		}
+	if (zz == 0.0)
+		return HUGE_VAL;
 
-		if (count == 0)
-			return;
+	a[0] /= zz;
+	a[1] /= zz;
+	b[0] = wx_mean - (a[0] * zx_mean - a[1] * zy_mean);
+	b[1] = wy_mean - (a[0] * zy_mean + a[1] * zx_mean);
 
-		sigma_sigma /= count;
-		sigma_sigma = sqrtf(sigma_sigma);
-		clip = mean_sigma + sigma_sigma;
+	for (i = 0; i < MIN_PLATE_OBJECTS; i++) {
+		zx = solution->soln_pobject[i].x;
+		zy = flip ? -solution->soln_pobject[i].y : solution->soln_pobject[i].y;
+		wx = a[0] * zx - a[1] * zy + b[0] - xi[i];
+		wy = a[0] * zy + a[1] * zx + b[1] - eta[i];
+		err += wx * wx + wy * wy;
+	}
 
-		count = 0;
+	return err;
+}
 
-		/* clip objects outside sigma */
-		for (i = 0; i < solution->num_ref_objects; i++) {
-			ref = &solution->ref[i];
+/**
+ * @brief Converts plate coordinates with a fit to the solve objects.
+ *
+ * Fits scale, rotation, parity and offset from the plate to the tangent
+ * plane at the first of the MIN_PLATE_OBJECTS catalog objects matched by
+ * the solve, so it works before any reference objects have been added.
+ *
+ * @param solution The solve solution.
+ * @param primary The target plate object coordinates.
+ * @param ra_ Output pointer for calculated Right Ascension.
+ * @param dec_ Output pointer for calculated Declination.
+ */
+void posn_plate_to_equ_solve(struct adb_solve_solution *solution,
+							 struct adb_pobject *primary, double *ra_,
+							 double *dec_)
+{
+	double a[2], b[2], fa[2], fb[2], x, y;
+	int flip = 0;
+
+	if (fit_solve_plate(solution, 1, fa, fb) <
+		fit_solve_plate(solution, 0, a, b)) {
+		flip = 1;
+		a[0] = fa[0];
+		a[1] = fa[1];
+		b[0] = fb[0];
+		b[1] = fb[1];
+	}
 
-			if (ref->posn_sigma >= clip) {
-				ref->clip_posn = 1;
-				count++;
-			}
-		}
+	x = primary->x;
+	y = flip ? -primary->y : primary->y;
+	tangent_to_equ(solution->object[0], a[0] * x - a[1] * y + b[0],
+				   a[0] * y + a[1] * x + b[1], ra_, dec_);
+}
 
-		/* clip targets outside sigma */
-	} while (count != lastcount && --tries);
+/**
+ * @brief Clips out reference objects with anomalous positional divergence.
+ *
+ * Fits the plate to the tangent plane with least squares, then clips the
+ * references with residuals beyond POSN_CLIP_RMS times the RMS residual and
+ * refits. Each pass is linear in the number of references.
+ *
+ * @param solution The active solve solution holding reference objects.
+ */
+void posn_clip_plate_coefficients(struct adb_solve_solution *solution)
+{
+	if (posn_fit_plate(solution, POSN_CLIP_TRIES) < 0)
+		adb_debug(solution->db, ADB_LOG_SOLVE, "no plate fit for %d refs\n",
+				  solution->num_ref_objects);
 }
 
 /**
@@ -615,18 +961,44 @@ void posn_calc_solved_plate(struct adb_solve_solution *solution)
 void posn_calc_unsolved_plate(struct adb_solve_solution *solution)
 {
 	struct adb_solve_object *solve_object;
-	int i;
+	double *x, *y, *ra, *dec;
+	int i, count = 0;
 
-	/* compare each detected object against reference objects */
-	for (i = 0; i < solution->num_ref_objects; i++) {
+	x = calloc(solution->total_objects * 4, sizeof(double));
+	if (x == NULL)
+		return;
+	y = x + solution->total_objects;
+	ra = y + solution->total_objects;
+	dec = ra + solution->total_objects;
+
+	/* gather each unsolved detected object */
+	for (i = 0; i < solution->total_objects; i++) {
 		solve_object = &solution->solve_object[i];
 
 		/* skip if the object is solved */
 		if (solve_object->object)
 			continue;
 
-		posn_plate_to_equ(solution, &solution->pobjects[i],
-						  &solution->solve_object[i].ra,
-						  &solution->solve_object[i].dec);
+		x[count] = solution->pobjects[i].x;
+		y[count] = solution->pobjects[i].y;
+		count++;
 	}
+
+	if (count == 0 ||
+		posn_plate_to_equ_array(solution, x, y, count, ra, dec, 0) < 0)
+		goto out;
+
+	for (i = 0, count = 0; i < solution->total_objects; i++) {
+		solve_object = &solution->solve_object[i];
+
+		if (solve_object->object)
+			continue;
+
+		solve_object->ra = ra[count];
+		solve_object->dec = dec[count];
+		count++;
+	}
+
+out:
+	free(x);
 }
@@ -41,11 +41,24 @@
  *  - IX/number 		High Energy Catalogues
  */
 
+struct NetBuf;
+struct cds_fetch;
+
+/* download connections, kept open and reused for every file */
+struct cds_conn {
+	struct NetBuf *ftp; /*!< FTP control connection */
+	void *curl; /*!< mirror HTTP(S) handle */
+};
+
 struct table_cds {
 	char *cat_class; /*!< catalog class */
 	char *index; /*!< catalog number (in repo) */
 	char *host; /*!< remote host */
+	char *mirror; /*!< HTTP(S) mirror URL or NULL */
 	char *name; /*!< table CDS file name */
+	struct cds_conn conn; /*!< import download connections */
+	int ftp_down; /*!< FTP host unusable, only try the mirror */
+	struct cds_fetch *fetch; /*!< split download feeding a streamed import */
 };
 
 struct table_path {
@@ -0,0 +1,780 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <ftplib.h>
+
+#if HAVE_CURL
+#include <curl/curl.h>
+#endif
+
+#include "libastrodb/db.h"
+#include "debug.h"
+#include "private.h"
+#include "readme.h"
+#include "table.h"
+
+#define FETCH_MAX_WORKERS 4
+#define FETCH_MAX_FILES 1024
+
+/*! \struct fetch_worker
+ * \brief Split data file download thread and its own connections.
+ */
+struct fetch_worker {
+	struct cds_fetch *fetch;
+	struct cds_conn conn; /*!< unused by the first worker */
+	pthread_t thread;
+};
+
+/*! \struct cds_fetch
+ * \brief Split data file download.
+ *
+ * Workers claim the parts in name order, so the streamed import reading
+ * the parts in the same order waits on the part it needs while the later
+ * parts are still downloading. The first worker reuses the table connection
+ * and the others open their own and keep it for every part they claim.
+ *
+ * A hidden manifest in the table directory marks the download in progress
+ * until every part is complete, so an interrupted download is resumed by
+ * the next import rather than imported short.
+ */
+struct cds_fetch {
+	struct adb_table *table;
+	char manifest[ADB_PATH_SIZE]; /*!< download in progress marker */
+	char *files[FETCH_MAX_FILES]; /*!< remote part names in name order */
+	int state[FETCH_MAX_FILES]; /*!< 0 pending, 1 done or negative error */
+	int num_files;
+	int next; /*!< next part to claim */
+	int stop; /*!< claim no more parts */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct fetch_worker worker[FETCH_MAX_WORKERS];
+	int num_workers;
+};
+
+static pthread_once_t fetch_once = PTHREAD_ONCE_INIT;
+
+/* Ftplib resolves host names with gethostbyname() */
+static pthread_mutex_t ftp_connect_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void fetch_init(void)
+{
+	FtpInit();
+#if HAVE_CURL
+	curl_global_init(CURL_GLOBAL_DEFAULT);
+#endif
+}
+
+/* the first worker and single file downloads use the table connections */
+static int conn_is_table(struct adb_table *table, struct cds_conn *conn)
+{
+	return conn == &table->cds.conn;
+}
+
+static int ftp_connect(struct adb_table *table, struct cds_conn *conn)
+{
+	struct adb_db *db = table->db;
+	netbuf *nbuf;
+	int ret;
+
+	if (conn->ftp)
+		return 0;
+
+	/* don't keep retrying a host that refused the table connection */
+	if (__atomic_load_n(&table->cds.ftp_down, __ATOMIC_ACQUIRE))
+		return -EIO;
+
+	/* for some reason Ftplib return 0 for errors */
+	pthread_mutex_lock(&ftp_connect_lock);
+	ret = FtpConnect(table->cds.host, &nbuf);
+	pthread_mutex_unlock(&ftp_connect_lock);
+	if (ret == 0) {
+		adb_warn(db, ADB_LOG_CDS_FTP, "FTP could not connect to %s\n",
+				 table->cds.host);
+		goto down;
+	}
+
+	if (FtpLogin("anonymous", "anonymous@", nbuf) == 0) {
+		adb_warn(db, ADB_LOG_CDS_FTP, "FTP could not login to %s\n",
+				 table->cds.host);
+		FtpQuit(nbuf);
+		goto down;
+	}
+
+	conn->ftp = nbuf;
+	return 0;
+
+down:
+	if (conn_is_table(table, conn))
+		__atomic_store_n(&table->cds.ftp_down, 1, __ATOMIC_RELEASE);
+	return -EIO;
+}
+
+/* a permanent 5xx reply means the file is missing, not a dropped connection */
+static int ftp_retry(struct cds_conn *conn, int reused)
+{
+	char *response;
+
+	if (!reused)
+		return 0;
+
+	response = FtpLastResponse(conn->ftp);
+	if (response && response[0] == '5')
+		return 0;
+
+	/* idle connection was probably dropped by the server, reconnect once */
+	FtpQuit(conn->ftp);
+	conn->ftp = NULL;
+	return 1;
+}
+
+static int ftp_get(struct adb_table *table, struct cds_conn *conn,
+				   const char *dest, const char *file)
+{
+	struct adb_db *db = table->db;
+	char src[ADB_PATH_SIZE];
+	int reused;
+
+	snprintf(src, ADB_PATH_SIZE, "%s%s", table->path.remote, file);
+
+	do {
+		reused = conn->ftp != NULL;
+		if (ftp_connect(table, conn) < 0)
+			return -EIO;
+
+		adb_info(db, ADB_LOG_CDS_FTP, "ftp %s to %s\n", src, dest);
+		if (FtpGet(dest, src, FTPLIB_IMAGE, conn->ftp))
+			return 0;
+	} while (ftp_retry(conn, reused));
+
+	adb_warn(db, ADB_LOG_CDS_FTP, "FTP could not get %s\n", src);
+	return -EIO;
+}
+
+/* add a listed file name matching pattern, keeping only its base name */
+static int fetch_list_add(char **files, int count, char *name,
+						  const char *pattern)
+{
+	char *end, *base;
+	int i;
+
+	/* strip any CR/LF */
+	for (end = name; *end && !isspace(*end); end++)
+		;
+	*end = 0;
+
+	base = strrchr(name, '/');
+	base = base ? base + 1 : name;
+	if (!strstr(base, pattern))
+		return count;
+
+	for (i = 0; i < count; i++) {
+		if (!strcmp(files[i], base))
+			return count;
+	}
+
+	if (count == FETCH_MAX_FILES)
+		return -E2BIG;
+
+	files[count] = strdup(base);
+	if (files[count] == NULL)
+		return -ENOMEM;
+	return count + 1;
+}
+
+static int ftp_list(struct adb_table *table, struct cds_conn *conn,
+					const char *pattern, char **files)
+{
+	struct adb_db *db = table->db;
+	char line[ADB_PATH_SIZE];
+	netbuf *dir = NULL;
+	int ret, reused, count = 0;
+
+	do {
+		reused = conn->ftp != NULL;
+		if (ftp_connect(table, conn) < 0)
+			return -EIO;
+
+		if (FtpAccess(table->path.remote, FTPLIB_DIR, FTPLIB_ASCII,
+					  conn->ftp, &dir))
+			break;
+		dir = NULL;
+	} while (ftp_retry(conn, reused));
+
+	if (dir == NULL) {
+		adb_warn(db, ADB_LOG_CDS_FTP, "FTP could not access directory %s\n",
+				 table->path.remote);
+		return -EIO;
+	}
+
+	/* read entire directory, file by file */
+	while ((ret = FtpRead(line, sizeof(line), dir)) > 0) {
+		count = fetch_list_add(files, count, line, pattern);
+		if (count < 0)
+			break;
+	}
+	FtpClose(dir);
+
+	if (ret < 0 && count >= 0) {
+		adb_warn(db, ADB_LOG_CDS_FTP, "FTP could not read directory %s\n",
+				 table->path.remote);
+		count = -EIO;
+	}
+	return count;
+}
+
+#if HAVE_CURL
+
+struct mirror_buf {
+	char *data;
+	size_t size;
+};
+
+static size_t mirror_buf_write(char *ptr, size_t size, size_t nmemb,
+							   void *data)
+{
+	struct mirror_buf *buf = data;
+	size_t bytes = size * nmemb;
+	char *new;
+
+	new = realloc(buf->data, buf->size + bytes + 1);
+	if (new == NULL)
+		return 0;
+
+	memcpy(new + buf->size, ptr, bytes);
+	buf->data = new;
+	buf->size += bytes;
+	buf->data[buf->size] = 0;
+	return bytes;
+}
+
+static CURL *mirror_handle(struct adb_table *table, struct cds_conn *conn,
+						   const char *file, char *url)
+{
+	snprintf(url, ADB_PATH_SIZE, "%s/%s/%s/%s", table->cds.mirror,
+			 table->cds.cat_class, table->cds.index, file);
+
+	/* the handle keeps its connection open between transfers */
+	if (conn->curl == NULL)
+		conn->curl = curl_easy_init();
+	if (conn->curl == NULL)
+		return NULL;
+
+	curl_easy_reset(conn->curl);
+	curl_easy_setopt(conn->curl, CURLOPT_URL, url);
+	curl_easy_setopt(conn->curl, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(conn->curl, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(conn->curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(conn->curl, CURLOPT_CONNECTTIMEOUT, 30L);
+	return conn->curl;
+}
+
+static int mirror_get(struct adb_table *table, struct cds_conn *conn,
+					  const char *dest, const char *file)
+{
+	struct adb_db *db = table->db;
+	char url[ADB_PATH_SIZE];
+	CURLcode res = CURLE_OK;
+	curl_off_t offset;
+	CURL *curl;
+	FILE *f;
+	int tries;
+
+	for (tries = 0; tries < 2; tries++) {
+		curl = mirror_handle(table, conn, file, url);
+		if (curl == NULL)
+			return -ENOMEM;
+
+		/* resume any partial download left by an earlier import */
+		f = fopen(dest, tries ? "wb" : "ab");
+		if (f == NULL)
+			return -errno;
+		fseeko(f, 0, SEEK_END);
+		offset = ftello(f);
+
+		adb_info(db, ADB_LOG_CDS_FTP, "mirror %s to %s from %ld\n", url, dest,
+				 (long)offset);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, f);
+		curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, offset);
+		res = curl_easy_perform(curl);
+		if (fclose(f) != 0 && res == CURLE_OK)
+			res = CURLE_WRITE_ERROR;
+		if (res == CURLE_OK)
+			return 0;
+
+		/* start again from the beginning if the mirror can't resume */
+		if (offset == 0 ||
+			(res != CURLE_RANGE_ERROR && res != CURLE_HTTP_RETURNED_ERROR))
+			break;
+	}
+
+	adb_warn(db, ADB_LOG_CDS_FTP, "mirror could not get %s: %s\n", url,
+			 curl_easy_strerror(res));
+	return -EIO;
+}
+
+/* list an HTML index page by its links or a plain listing by its lines */
+static int mirror_list(struct adb_table *table, struct cds_conn *conn,
+					   const char *pattern, char **files)
+{
+	struct adb_db *db = table->db;
+	struct mirror_buf buf = { NULL, 0 };
+	char url[ADB_PATH_SIZE], *pos, *end;
+	int count = 0, html;
+	CURLcode res;
+	CURL *curl;
+
+	curl = mirror_handle(table, conn, "", url);
+	if (curl == NULL)
+		return -ENOMEM;
+
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, mirror_buf_write);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buf);
+	res = curl_easy_perform(curl);
+	if (res != CURLE_OK || buf.data == NULL) {
+		adb_warn(db, ADB_LOG_CDS_FTP, "mirror could not list %s: %s\n", url,
+				 curl_easy_strerror(res));
+		free(buf.data);
+		return -EIO;
+	}
+
+	html = strstr(buf.data, "href=\"") != NULL;
+	for (pos = buf.data; pos && count >= 0; pos = end) {
+		if (html) {
+			pos = strstr(pos, "href=\"");
+			if (pos == NULL)
+				break;
+			pos += strlen("href=\"");
+			end = strchr(pos, '"');
+			if (end == NULL)
+				break;
+			*end++ = 0;
+
+			/* skip sort links and sub or parent directories */
+			if (*pos == '?' || strchr(pos, '/'))
+				continue;
+		} else {
+			end = strchr(pos, '\n');
+			if (end)
+				*end++ = 0;
+		}
+		count = fetch_list_add(files, count, pos, pattern);
+	}
+
+	free(buf.data);
+	return count;
+}
+
+#endif
+
+static void conn_close(struct cds_conn *conn)
+{
+	if (conn->ftp)
+		FtpQuit(conn->ftp);
+	conn->ftp = NULL;
+#if HAVE_CURL
+	if (conn->curl)
+		curl_easy_cleanup(conn->curl);
+#endif
+	conn->curl = NULL;
+}
+
+/* download a file over FTP or else the mirror, it appears when complete */
+static int fetch_file(struct adb_table *table, struct cds_conn *conn,
+					  const char *file)
+{
+	char dest[ADB_PATH_SIZE], part[ADB_PATH_SIZE];
+	struct stat st;
+	int ret;
+
+	pthread_once(&fetch_once, fetch_init);
+
+	snprintf(dest, ADB_PATH_SIZE, "%s%s", table->path.local, file);
+	snprintf(part, ADB_PATH_SIZE, "%s.%s.part", table->path.local, file);
+
+	/* Ftplib can't resume, so FTP always starts the part again */
+	ret = ftp_get(table, conn, part, file);
+#if HAVE_CURL
+	if (ret < 0 && table->cds.mirror)
+		ret = mirror_get(table, conn, part, file);
+#endif
+	if (ret < 0) {
+		/* keep partial downloads for the mirror to resume */
+		if (stat(part, &st) == 0 && st.st_size == 0)
+			unlink(part);
+		return ret;
+	}
+
+	if (rename(part, dest) < 0) {
+		ret = -errno;
+		adb_error(table->db, "failed to rename %s to %s %d\n", part, dest,
+				  ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Download a single catalog file from CDS.
+ *
+ * The file is fetched over the table FTP connection, which stays open for
+ * the ReadMe and every dataset the import tries, and falls back to the
+ * library HTTP(S) mirror if FTP fails.
+ *
+ * @param table Table being imported
+ * @param file File name in the catalog directory
+ * @return 0 on success, negative error code on failure
+ */
+int cds_fetch_file(struct adb_table *table, const char *file)
+{
+	return fetch_file(table, &table->cds.conn, file);
+}
+
+static void fetch_manifest_path(struct adb_table *table, char *path)
+{
+	snprintf(path, ADB_PATH_SIZE, "%s.%s.fetch", table->path.local,
+			 table->path.file);
+}
+
+/**
+ * @brief Check for an interrupted split data file download.
+ *
+ * @param table Table being imported
+ * @return Non zero if the local data files are incomplete
+ */
+int cds_fetch_resuming(struct adb_table *table)
+{
+	char path[ADB_PATH_SIZE];
+	struct stat st;
+
+	fetch_manifest_path(table, path);
+	return stat(path, &st) == 0;
+}
+
+static int fetch_manifest_write(struct cds_fetch *fetch)
+{
+	FILE *f;
+	int i;
+
+	fetch_manifest_path(fetch->table, fetch->manifest);
+	f = fopen(fetch->manifest, "w");
+	if (f == NULL)
+		return -errno;
+
+	for (i = 0; i < fetch->num_files; i++)
+		fprintf(f, "%s\n", fetch->files[i]);
+
+	return fclose(f) ? -errno : 0;
+}
+
+/* download and, unless streamed, inflate one split part */
+static int fetch_part(struct cds_fetch *fetch, struct cds_conn *conn, int i)
+{
+	struct adb_table *table = fetch->table;
+	struct adb_db *db = table->db;
+	const char *file = fetch->files[i];
+	char path[ADB_PATH_SIZE], plain[ADB_PATH_SIZE], *gz = NULL;
+	struct stat st;
+	int have, ret;
+
+	/* parts only appear under their own name once complete */
+	snprintf(path, ADB_PATH_SIZE, "%s%s", table->path.local, file);
+	have = stat(path, &st) == 0;
+
+	/* inflate as we go, the import concatenates the inflated parts */
+	if (!db->import_stream) {
+		snprintf(plain, ADB_PATH_SIZE, "%s", file);
+		gz = strstr(plain, ".gz");
+		if (gz)
+			*gz = 0;
+	}
+
+	/* inflate deletes the part, so an interrupted import inflated it */
+	if (gz && !have) {
+		snprintf(path, ADB_PATH_SIZE, "%s%s", table->path.local, plain);
+		if (stat(path, &st) == 0)
+			return 0;
+	}
+
+	if (!have) {
+		ret = fetch_file(table, conn, file);
+		if (ret < 0)
+			return ret;
+	} else
+		adb_info(db, ADB_LOG_CDS_FTP, "already have %s\n", path);
+
+	if (gz)
+		return cds_inflate_file(db, table->path.local, file, plain);
+	return 0;
+}
+
+static void *fetch_thread(void *data)
+{
+	struct fetch_worker *worker = data;
+	struct cds_fetch *fetch = worker->fetch;
+	struct adb_table *table = fetch->table;
+	struct cds_conn *conn = &worker->conn;
+	int i, ret;
+
+	if (worker == &fetch->worker[0])
+		conn = &table->cds.conn;
+
+	for (;;) {
+		pthread_mutex_lock(&fetch->lock);
+		if (fetch->stop || fetch->next == fetch->num_files) {
+			pthread_mutex_unlock(&fetch->lock);
+			break;
+		}
+		i = fetch->next++;
+		pthread_mutex_unlock(&fetch->lock);
+
+		ret = fetch_part(fetch, conn, i);
+
+		pthread_mutex_lock(&fetch->lock);
+		fetch->state[i] = ret < 0 ? ret : 1;
+		if (ret < 0)
+			fetch->stop = 1;
+		pthread_cond_broadcast(&fetch->cond);
+		pthread_mutex_unlock(&fetch->lock);
+	}
+
+	if (!conn_is_table(table, conn))
+		conn_close(conn);
+	return NULL;
+}
+
+/* wait for the workers and remove the manifest if every part is complete */
+static int fetch_join(struct cds_fetch *fetch)
+{
+	int i, ret = 0;
+
+	for (i = 0; i < fetch->num_workers; i++)
+		pthread_join(fetch->worker[i].thread, NULL);
+
+	for (i = 0; i < fetch->num_files && ret == 0; i++) {
+		if (fetch->state[i] < 0)
+			ret = fetch->state[i];
+		else if (fetch->state[i] == 0)
+			ret = -ECANCELED;
+	}
+
+	if (ret == 0)
+		unlink(fetch->manifest);
+	return ret;
+}
+
+static void fetch_free(struct cds_fetch *fetch)
+{
+	int i;
+
+	/* listed names are kept in order from the first */
+	for (i = 0; i < FETCH_MAX_FILES && fetch->files[i]; i++)
+		free(fetch->files[i]);
+	pthread_mutex_destroy(&fetch->lock);
+	pthread_cond_destroy(&fetch->cond);
+	free(fetch);
+}
+
+static int fetch_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * @brief Download the split data files matching a pattern from CDS.
+ *
+ * The catalog directory is listed over FTP, or the mirror if FTP fails, and
+ * up to four workers download the matching parts in parallel. Parts already
+ * complete from an interrupted import are kept. Without streaming the parts
+ * are inflated as they arrive and this returns once all are ready. A
+ * streamed import returns at once and reads each part as soon as it is
+ * complete, so cds_fetch_finish() must be called after the import.
+ *
+ * @param table Table being imported
+ * @param pattern Substring the part file names contain
+ * @return Number of parts, or a negative error code on failure
+ */
+int cds_fetch_files(struct adb_table *table, const char *pattern)
+{
+	struct adb_db *db = table->db;
+	struct cds_fetch *fetch;
+	int i, count, ret;
+
+	pthread_once(&fetch_once, fetch_init);
+
+	fetch = calloc(1, sizeof(*fetch));
+	if (fetch == NULL)
+		return -ENOMEM;
+	fetch->table = table;
+	pthread_mutex_init(&fetch->lock, NULL);
+	pthread_cond_init(&fetch->cond, NULL);
+
+	adb_info(db, ADB_LOG_CDS_FTP, "listing %s for %s\n", table->path.remote,
+			 pattern);
+	count = ftp_list(table, &table->cds.conn, pattern, fetch->files);
+#if HAVE_CURL
+	if (count < 0 && table->cds.mirror) {
+		for (i = 0; i < FETCH_MAX_FILES && fetch->files[i]; i++) {
+			free(fetch->files[i]);
+			fetch->files[i] = NULL;
+		}
+		count = mirror_list(table, &table->cds.conn, pattern, fetch->files);
+	}
+#endif
+	if (count <= 0) {
+		ret = count < 0 ? count : -ENOENT;
+		goto err;
+	}
+	fetch->num_files = count;
+
+	qsort(fetch->files, count, sizeof(char *), fetch_cmp);
+	ret = fetch_manifest_write(fetch);
+	if (ret < 0)
+		goto err;
+
+	fetch->num_workers = db_workers(db);
+	if (fetch->num_workers > FETCH_MAX_WORKERS)
+		fetch->num_workers = FETCH_MAX_WORKERS;
+	if (fetch->num_workers > count)
+		fetch->num_workers = count;
+
+	adb_info(db, ADB_LOG_CDS_FTP, "downloading %d files with %d workers\n",
+			 count, fetch->num_workers);
+
+	for (i = 0; i < fetch->num_workers; i++) {
+		fetch->worker[i].fetch = fetch;
+		ret = pthread_create(&fetch->worker[i].thread, NULL, fetch_thread,
+							 &fetch->worker[i]);
+		if (ret) {
+			/* the started workers download every part */
+			fetch->num_workers = i;
+			if (i == 0) {
+				ret = -ret;
+				goto err;
+			}
+			break;
+		}
+	}
+
+	if (db->import_stream) {
+		table->cds.fetch = fetch;
+		return count;
+	}
+
+	ret = fetch_join(fetch);
+	fetch_free(fetch);
+	return ret < 0 ? ret : count;
+
+err:
+	fetch_free(fetch);
+	return ret;
+}
+
+/**
+ * @brief Get the number of split data files being downloaded.
+ *
+ * @param fetch Split download
+ * @return Number of parts
+ */
+int cds_fetch_count(struct cds_fetch *fetch)
+{
+	return fetch->num_files;
+}
+
+/**
+ * @brief Get a split data file name.
+ *
+ * @param fetch Split download
+ * @param i Part index, in name order
+ * @return Part file name in the catalog directory
+ */
+const char *cds_fetch_name(struct cds_fetch *fetch, int i)
+{
+	return fetch->files[i];
+}
+
+/**
+ * @brief Wait for a split data file to finish downloading.
+ *
+ * @param fetch Split download
+ * @param path Local path of the part
+ * @return 0 once the part is complete, negative error code if it failed
+ */
+int cds_fetch_wait(struct cds_fetch *fetch, const char *path)
+{
+	struct adb_table *table = fetch->table;
+	size_t local = strlen(table->path.local);
+	int i, ret;
+
+	if (strncmp(path, table->path.local, local))
+		return 0;
+
+	for (i = 0; i < fetch->num_files; i++) {
+		if (!strcmp(path + local, fetch->files[i]))
+			break;
+	}
+	if (i == fetch->num_files)
+		return 0;
+
+	pthread_mutex_lock(&fetch->lock);
+	while (fetch->state[i] == 0 && !(fetch->stop && i >= fetch->next))
+		pthread_cond_wait(&fetch->cond, &fetch->lock);
+	ret = fetch->state[i];
+	pthread_mutex_unlock(&fetch->lock);
+
+	if (ret == 0)
+		return -ECANCELED;
+	return ret < 0 ? ret : 0;
+}
+
+/**
+ * @brief Finish the downloads of a table import.
+ *
+ * Waits for any split download feeding a streamed import, claiming no more
+ * parts, and closes the table connections.
+ *
+ * @param table Table being imported
+ * @return 0 on success, negative error code if a download failed
+ */
+int cds_fetch_finish(struct adb_table *table)
+{
+	struct cds_fetch *fetch = table->cds.fetch;
+	int ret = 0;
+
+	if (fetch) {
+		pthread_mutex_lock(&fetch->lock);
+		fetch->stop = 1;
+		pthread_mutex_unlock(&fetch->lock);
+
+		ret = fetch_join(fetch);
+		fetch_free(fetch);
+		table->cds.fetch = NULL;
+	}
+
+	conn_close(&table->cds.conn);
+	table->cds.ftp_down = 0;
+	return ret;
+}
@@ -18,10 +18,13 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <string.h>
-#include <ftplib.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <dirent.h>
 
@@ -31,9 +34,34 @@
 #include "libastrodb/object.h"
 #include "debug.h"
 #include "private.h"
+#include "readme.h"
+#include "table.h"
 
 #define GZ_CHUNK 16384
 #define CHUNK_SIZE (1024 * 32)
+#define STREAM_MAX_PARTS 1024
+
+/*! \struct cds_stream
+ * \brief Catalog data stream.
+ *
+ * Catalog data is either read from a single plain data file or streamed
+ * through a socket pair by an inflate thread. The thread gzread()s each data
+ * file part in name order, so decompression overlaps with row parsing and
+ * nothing is inflated or concatenated on disk. Parts still downloading are
+ * waited for, so the import also overlaps with the download.
+ */
+struct cds_stream {
+	struct adb_db *db;
+	FILE *file; /*!< parser end of the stream */
+	char path[ADB_PATH_SIZE]; /*!< plain data file path */
+	char **parts; /*!< data file part paths, NULL for a plain file */
+	int num_parts;
+	pthread_t thread; /*!< inflate thread */
+	int running;
+	int fd; /*!< inflate thread end of the stream */
+	int error; /*!< inflate error */
+	struct cds_fetch *fetch; /*!< download of the parts, or NULL */
+};
 
 /**
  * @brief Inflates a gzip compressed file into a new destination file.
@@ -44,8 +72,8 @@
  * @param dest_file The target name for the uncompressed file.
  * @return 0 on success, negative error code on failure.
  */
-static int inflate_file(struct adb_db *db, const char *path,
-						const char *src_file, const char *dest_file)
+int cds_inflate_file(struct adb_db *db, const char *path, const char *src_file,
+					 const char *dest_file)
 {
 	gzFile src;
 	FILE *dest;
@@ -89,165 +117,6 @@ static int inflate_file(struct adb_db *db, const char *path,
 	return 0;
 }
 
-/**
- * @brief Retrieves a single file from a remote FTP server.
- *
- * This function connects to the CDS FTP server anonymously and downloads
- * the specified file from the remote path to the local table path.
- *
- * @param table The database table containing local and remote path configurations.
- * @param file The name of the file to download.
- * @return 1 on success, negative error code or 0 on failure.
- */
-static int ftp_get_file(struct adb_table *table, const char *file)
-{
-	struct adb_db *db = table->db;
-	netbuf *nbuf;
-	int ret;
-	char dest[ADB_PATH_SIZE], src[ADB_PATH_SIZE];
-
-	snprintf(dest, ADB_PATH_SIZE, "%s%s", table->path.local, file);
-	snprintf(src, ADB_PATH_SIZE, "%s%s", table->path.remote, file);
-
-	adb_info(db, ADB_LOG_CDS_FTP, "ftp %s to %s\n", src, dest);
-	FtpInit();
-
-	/* for some reason Ftplib return 0 for errors */
-	ret = FtpConnect(table->cds.host, &nbuf);
-	if (ret == 0) {
-		adb_error(db, "FTP could not connect to %s\n", table->cds.host);
-		return -EIO;
-	}
-
-	ret = FtpLogin("anonymous", "anonymous@", nbuf);
-	if (ret == 0) {
-		adb_error(db, "FTP could not login\n", ret);
-		ret = -EIO;
-		goto out;
-	}
-
-	//TODO: FtpDir(NULL, "/", nbuf);
-	ret = FtpGet(dest, src, FTPLIB_IMAGE, nbuf);
-	if (ret == 0) {
-		adb_warn(db, ADB_LOG_CDS_FTP, "FTP could not get %s\n", src);
-		ret = -EIO;
-		unlink(dest);
-	} else
-		ret = 1;
-
-out:
-	FtpQuit(nbuf);
-	return ret;
-}
-
-/**
- * @brief Retrieves multiple files matching a pattern from a remote FTP server.
- *
- * This function accesses the remote directory on the CDS FTP server, reads its
- * contents, and downloads all files that match the provided substring pattern.
- *
- * @param table The database table containing local and remote path configurations.
- * @param pattern The substring pattern to match file names against.
- * @return The number of successfully downloaded files, or a negative error code on failure.
- */
-static int ftp_get_files(struct adb_table *table, const char *pattern)
-{
-	struct adb_db *db = table->db;
-	netbuf *nbuf, *nbuf_dir = NULL;
-	char dest[ADB_PATH_SIZE], src[ADB_PATH_SIZE], dir[ADB_PATH_SIZE];
-	static char *ftp_dir[CHUNK_SIZE];
-	char *file;
-	int ret, count = 0, got = 0;
-
-	snprintf(src, ADB_PATH_SIZE, "%s", table->path.remote);
-
-	adb_info(db, ADB_LOG_CDS_FTP, "FTP files %s pattern %s\n", src, pattern);
-
-	FtpInit();
-
-	ret = FtpConnect(table->cds.host, &nbuf);
-	if (ret == 0) {
-		adb_error(db, "FTP connect to %s failed\n", table->cds.host);
-		return -EIO;
-	}
-
-	ret = FtpLogin("anonymous", "anonymous@", nbuf);
-	if (ret == 0) {
-		adb_error(db, "FTP could not login\n");
-		ret = -EIO;
-		goto out;
-	}
-
-	/* open directory */
-	ret = FtpAccess(src, FTPLIB_DIR, FTPLIB_ASCII, nbuf, &nbuf_dir);
-	if (ret == 0) {
-		adb_error(db, "FTP could not access directory %s\n", src);
-		ret = -EIO;
-		goto out;
-	}
-
-	/* read entire directory, file by file */
-	do {
-		char *space;
-
-		/* read the directory */
-		ret = FtpRead(dir, ADB_PATH_SIZE, nbuf_dir);
-		if (ret == -1) {
-			adb_error(db, "FTP could not read directory %s\n", src);
-			ret = -EIO;
-			goto out;
-		}
-
-		/* copy file name */
-		space = ftp_dir[count] = strdup(dir);
-
-		/* strip any CR/LF */
-		while (!isspace(*space))
-			space++;
-		*space = 0;
-
-		count++;
-	} while (ret > 0);
-
-	FtpClose(nbuf_dir);
-
-	/* parse directory */
-	count--;
-	do {
-		/* check for pattern */
-		file = strstr(ftp_dir[count], pattern);
-		adb_info(db, ADB_LOG_CDS_FTP, "found file %s\n", ftp_dir[count]);
-		if (file) {
-			int err;
-
-			strncpy(dest, table->path.local, ADB_PATH_SIZE - 1);
-			strncat(dest, file, ADB_PATH_SIZE - strlen(file) - 1);
-
-			/* download file by file*/
-			adb_info(db, ADB_LOG_CDS_FTP, "FTP downloading %s\n",
-					 ftp_dir[count]);
-			err = FtpGet(dest, ftp_dir[count], FTPLIB_IMAGE, nbuf);
-			if (err == 0) {
-				adb_error(db, "FTP could not get %s to %s\n", ftp_dir[count],
-						  dest);
-				ret = -EIO;
-				goto out;
-			} else
-				got++;
-		}
-		free(ftp_dir[count]);
-		count--;
-	} while (count);
-
-	ret = got;
-
-out:
-	for (; count >= 0; count--)
-		free(ftp_dir[count]);
-	FtpQuit(nbuf);
-	return ret;
-}
-
 /**
  * @brief Appends the contents of a single local file to an open output file stream.
  *
@@ -400,9 +269,10 @@ static int table_concat_files(struct adb_table *table, const char *ext)
 }
 
 /**
- * @brief Attempts to download a complete dataset from CDS via FTP.
+ * @brief Attempts to download a complete dataset from CDS.
  *
- * Uses the table's path settings to download the base file with the given extension.
+ * Uses the table's path settings to download the base file with the given
+ * extension over FTP, or the HTTP(S) mirror if FTP fails.
  *
  * @param db Database instance for logging.
  * @param table The table containing paths to use for the download.
@@ -417,8 +287,8 @@ int cds_get_dataset(struct adb_db *db, struct adb_table *table, const char *ext)
 	/* now try tablet name with a .gz extension */
 	sprintf(file, "%s%s", table->path.file, ext);
 	adb_info(db, ADB_LOG_CDS_FTP, "Try to download %s from CDS\n", file);
-	ret = ftp_get_file(table, file);
-	if (ret <= 0) {
+	ret = cds_fetch_file(table, file);
+	if (ret < 0) {
 		/* give up ! */
 		adb_warn(db, ADB_LOG_CDS_FTP, "couldn't download %s\n",
 				 table->path.file);
@@ -428,10 +298,11 @@ int cds_get_dataset(struct adb_db *db, struct adb_table *table, const char *ext)
 }
 
 /**
- * @brief Attempts to download split dataset files from CDS via FTP.
+ * @brief Attempts to download split dataset files from CDS.
  *
  * Uses the base file name and extension as a pattern to match multiple files
- * on the remote server and download them all.
+ * on the remote server and download them all in parallel. A streamed import
+ * reads the parts while they download.
  *
  * @param db Database instance for logging.
  * @param table The table containing paths to use for the download.
@@ -448,7 +319,7 @@ int cds_get_split_dataset(struct adb_db *db, struct adb_table *table,
 	adb_info(db, ADB_LOG_CDS_FTP, "Try to download %s  splits from CDS\n",
 			 file);
 
-	ret = ftp_get_files(table, file);
+	ret = cds_fetch_files(table, file);
 	if (ret <= 0) {
 		adb_error(db, "Error can't get split files %s\n", file);
 		return -ENOENT;
@@ -462,6 +333,7 @@ int cds_get_split_dataset(struct adb_db *db, struct adb_table *table,
  * Scans the local directory for CDS data files matching the given extension.
  * It will automatically inflate any gzipped files it finds. If multiple split
  * files are found, it uses table_concat_files to merge them into a single file.
+ * Neither is done when the import streams the data files.
  *
  * @param db Database instance for logging.
  * @param table The table configuration indicating the local working directory.
@@ -476,6 +348,13 @@ int cds_prepare_files(struct adb_db *db, struct adb_table *table,
 	char dest[1024], *suffix;
 	int found = 0, err;
 
+	/* finish an interrupted split download before using any parts */
+	if (cds_fetch_resuming(table)) {
+		adb_info(db, ADB_LOG_CDS_FTP, "Resuming download of %s\n",
+				 table->path.file);
+		return 0;
+	}
+
 	/* open local directory */
 	dir = opendir(table->path.local);
 	if (dir == NULL) {
@@ -511,8 +390,8 @@ int cds_prepare_files(struct adb_db *db, struct adb_table *table,
 			adb_info(db, ADB_LOG_CDS_FTP, " --> %s\n", dent->d_name);
 			found++;
 
-			/* if the extension is .gz then inflate it */
-			if (strstr(dent->d_name, ".gz")) {
+			/* if the extension is .gz then inflate it, unless streaming */
+			if (strstr(dent->d_name, ".gz") && !db->import_stream) {
 				/* chop the .gz from the inflate destination file */
 				sprintf(dest, "%s", dent->d_name);
 				suffix = strstr(dest, ".gz");
@@ -520,7 +399,8 @@ int cds_prepare_files(struct adb_db *db, struct adb_table *table,
 					*suffix = 0;
 
 				/* unzip if we got it */
-				err = inflate_file(db, table->path.local, dent->d_name, dest);
+				err = cds_inflate_file(db, table->path.local, dent->d_name,
+									   dest);
 				if (err < 0) {
 					adb_info(db, ADB_LOG_CDS_FTP,
 							 "Error: failed to inflate %s \n", dent->d_name);
@@ -533,8 +413,8 @@ int cds_prepare_files(struct adb_db *db, struct adb_table *table,
 	closedir(dir);
 	adb_info(db, ADB_LOG_CDS_FTP, "Found %d CDS data files\n", found);
 
-	/* if required, concat files */
-	if (found > 1)
+	/* if required, concat files - streams concat parts on the fly */
+	if (found > 1 && !db->import_stream)
 		table_concat_files(table, ext);
 
 	return found;
@@ -567,10 +447,310 @@ int cds_get_readme(struct adb_db *db, int table_id)
 
 	/* local binary or ASCII not available, so download ASCII ReadMe*/
 	adb_info(db, ADB_LOG_CDS_FTP, "%s not found, using remote version\n", file);
-	ret = ftp_get_file(table, "ReadMe");
+	ret = cds_fetch_file(table, "ReadMe");
 	if (ret < 0)
 		adb_error(db, "failed to load ReadMe %d\n", ret);
 
 	adb_info(db, ADB_LOG_CDS_FTP, "Got CDS ReadMe version at %s\n", file);
 	return ret;
 }
+
+/* inflate each data file part in order into the stream */
+static void *stream_inflate(void *data)
+{
+	struct cds_stream *stream = data;
+	struct adb_db *db = stream->db;
+	char buf[GZ_CHUNK << 1];
+	gzFile src;
+	ssize_t sent;
+	int i, size, offset;
+
+	for (i = 0; i < stream->num_parts; i++) {
+		if (stream->fetch) {
+			stream->error = cds_fetch_wait(stream->fetch, stream->parts[i]);
+			if (stream->error < 0) {
+				adb_error(db, "failed to download %s\n", stream->parts[i]);
+				break;
+			}
+		}
+
+		adb_info(db, ADB_LOG_CDS_FTP, "streaming %s\n", stream->parts[i]);
+
+		/* gzread() passes plain files through untouched */
+		src = gzopen(stream->parts[i], "rb");
+		if (src == NULL) {
+			adb_error(db, "could not open %s\n", stream->parts[i]);
+			stream->error = -EIO;
+			break;
+		}
+
+		while ((size = gzread(src, buf, sizeof(buf))) > 0) {
+			for (offset = 0; offset < size; offset += sent) {
+				sent = send(stream->fd, buf + offset, size - offset,
+							MSG_NOSIGNAL);
+				if (sent < 0 && errno == EINTR)
+					sent = 0;
+				else if (sent < 0) {
+					/* parser closed the stream, nothing more to do */
+					gzclose(src);
+					goto out;
+				}
+			}
+		}
+
+		if (size < 0) {
+			adb_error(db, "failed to inflate %s\n", stream->parts[i]);
+			stream->error = -EIO;
+			gzclose(src);
+			break;
+		}
+		gzclose(src);
+	}
+
+out:
+	close(stream->fd);
+	return NULL;
+}
+
+static int stream_start(struct cds_stream *stream)
+{
+	int sv[2], err;
+
+	stream->error = 0;
+
+	/* single plain file is read directly */
+	if (stream->parts == NULL) {
+		stream->file = fopen(stream->path, "r");
+		if (stream->file == NULL) {
+			adb_debug(stream->db, ADB_LOG_CDS_IMPORT,
+					  "failed to open file %s\n", stream->path);
+			return -EIO;
+		}
+		return 0;
+	}
+
+	/* a socket pair lets the thread see the parser close without SIGPIPE */
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+		return -errno;
+
+	stream->file = fdopen(sv[0], "r");
+	if (stream->file == NULL) {
+		err = -errno;
+		close(sv[0]);
+		close(sv[1]);
+		return err;
+	}
+
+	stream->fd = sv[1];
+	err = pthread_create(&stream->thread, NULL, stream_inflate, stream);
+	if (err) {
+		fclose(stream->file);
+		stream->file = NULL;
+		close(stream->fd);
+		return -err;
+	}
+
+	stream->running = 1;
+	return 0;
+}
+
+static int stream_stop(struct cds_stream *stream)
+{
+	if (stream->file) {
+		fclose(stream->file);
+		stream->file = NULL;
+	}
+
+	if (stream->running) {
+		pthread_join(stream->thread, NULL);
+		stream->running = 0;
+	}
+
+	return stream->error;
+}
+
+static int stream_part_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* add a data file part for ext unless it is one of our own files */
+static int stream_add_part(struct cds_stream *stream, struct adb_table *table,
+						   const char *name, const char *ext)
+{
+	char path[ADB_PATH_SIZE];
+
+	if (strncmp(table->path.file, name, strlen(table->path.file)))
+		return 0;
+
+	/* skip our own files */
+	if (strstr(name, ".db") || strstr(name, ".schema") || strstr(name, ".tmp"))
+		return 0;
+
+	if (!strstr(name, ext))
+		return 0;
+
+	/* only stream compressed parts when asked for */
+	if (!strstr(ext, ".gz") && strstr(name, ".gz"))
+		return 0;
+
+	if (stream->num_parts == STREAM_MAX_PARTS) {
+		adb_error(stream->db, "too many data file parts in %s\n",
+				  table->path.local);
+		return -E2BIG;
+	}
+
+	snprintf(path, ADB_PATH_SIZE, "%s%s", table->path.local, name);
+	stream->parts[stream->num_parts] = strdup(path);
+	if (stream->parts[stream->num_parts] == NULL)
+		return -ENOMEM;
+	stream->num_parts++;
+	return 0;
+}
+
+/* find the data file parts for ext in the local table directory */
+static int stream_find_parts(struct cds_stream *stream,
+							 struct adb_table *table, const char *ext)
+{
+	struct adb_db *db = stream->db;
+	struct dirent *dent;
+	DIR *dir;
+	int i, err = 0;
+
+	stream->parts = calloc(STREAM_MAX_PARTS, sizeof(char *));
+	if (stream->parts == NULL)
+		return -ENOMEM;
+
+	/* parts still downloading are not all in the directory yet */
+	if (stream->fetch) {
+		for (i = 0; i < cds_fetch_count(stream->fetch) && !err; i++)
+			err = stream_add_part(stream, table,
+								  cds_fetch_name(stream->fetch, i), ext);
+		return err < 0 ? err : stream->num_parts;
+	}
+
+	dir = opendir(table->path.local);
+	if (dir == NULL) {
+		adb_error(db, "can't open directory %s\n", table->path.local);
+		return -EIO;
+	}
+
+	while ((dent = readdir(dir)) != NULL && !err)
+		err = stream_add_part(stream, table, dent->d_name, ext);
+	closedir(dir);
+	if (err < 0)
+		return err;
+
+	/* split parts are numbered, stream them in order */
+	qsort(stream->parts, stream->num_parts, sizeof(char *), stream_part_cmp);
+	return stream->num_parts;
+}
+
+/**
+ * @brief Open the catalog data for a table import.
+ *
+ * By default the single data file <file><ext> is opened. When streaming is
+ * enabled with adb_set_import_stream() all the local data file parts matching
+ * ext are inflated and concatenated on the fly by a separate thread instead.
+ *
+ * @param db Database catalog
+ * @param table Table being imported
+ * @param ext Data file extension
+ * @return Catalog data stream, or NULL if there is no data
+ */
+struct cds_stream *cds_stream_open(struct adb_db *db, struct adb_table *table,
+								   const char *ext)
+{
+	struct cds_stream *stream;
+	int ret, i;
+
+	stream = calloc(1, sizeof(*stream));
+	if (stream == NULL)
+		return NULL;
+	stream->db = db;
+	stream->fetch = table->cds.fetch;
+	snprintf(stream->path, ADB_PATH_SIZE, "%s%s%s", table->path.local,
+			 table->path.file, ext);
+
+	if (db->import_stream) {
+		ret = stream_find_parts(stream, table, ext);
+		if (ret <= 0)
+			goto err;
+
+		adb_info(db, ADB_LOG_CDS_IMPORT, "Streaming %d data files for %s%s\n",
+				 ret, table->path.file, ext);
+
+		/* single uncompressed local part needs no inflate thread */
+		if (ret == 1 && !strstr(stream->parts[0], ".gz") && !stream->fetch) {
+			snprintf(stream->path, ADB_PATH_SIZE, "%s", stream->parts[0]);
+			free(stream->parts[0]);
+			free(stream->parts);
+			stream->parts = NULL;
+			stream->num_parts = 0;
+		}
+	}
+
+	if (stream_start(stream) < 0)
+		goto err;
+
+	return stream;
+
+err:
+	for (i = 0; i < stream->num_parts; i++)
+		free(stream->parts[i]);
+	free(stream->parts);
+	free(stream);
+	return NULL;
+}
+
+/**
+ * @brief Get the readable end of a catalog data stream.
+ *
+ * @param stream Catalog data stream
+ * @return Stream file, valid until the stream is rewound or closed
+ */
+FILE *cds_stream_file(struct cds_stream *stream)
+{
+	return stream->file;
+}
+
+/**
+ * @brief Restart a catalog data stream from the first row.
+ *
+ * @param stream Catalog data stream
+ * @return 0 on success, or a negative error code if the data failed to inflate
+ */
+int cds_stream_rewind(struct cds_stream *stream)
+{
+	int err;
+
+	if (stream->parts == NULL) {
+		rewind(stream->file);
+		return 0;
+	}
+
+	err = stream_stop(stream);
+	if (err < 0)
+		return err;
+
+	return stream_start(stream);
+}
+
+/**
+ * @brief Close a catalog data stream.
+ *
+ * @param stream Catalog data stream
+ * @return 0 on success, or a negative error code if the data failed to inflate
+ */
+int cds_stream_close(struct cds_stream *stream)
+{
+	int err, i;
+
+	err = stream_stop(stream);
+
+	for (i = 0; i < stream->num_parts; i++)
+		free(stream->parts[i]);
+	free(stream->parts);
+	free(stream);
+	return err;
+}
@@ -25,9 +25,12 @@
 #include <unistd.h>
 
 #include "config.h"
+#include "alloc.h"
 #include "debug.h"
 #include "libastrodb/db.h"
 #include "libastrodb/object.h"
+#include "remote.h"
+#include "simd.h"
 
 static const char *dirs[] = {
 	"/I", "/II", "/III", "/IV", "/V", "/VI", "/VII", "/VIII", "/IX", "/B",
@@ -135,12 +138,49 @@ err:
  */
 void adb_close_library(struct adb_library *lib)
 {
+	free(lib->mirror);
 	free(lib->remote);
 	free(lib->local);
 	free(lib->host);
 	free(lib);
 }
 
+/**
+ * @brief Set the HTTP(S) mirror used when FTP downloads fail.
+ *
+ * The mirror URL replaces the host and remote path, so catalog files are
+ * fetched from url/class/id/file.
+ *
+ * @param lib Library repository
+ * @param url Mirror URL, or NULL to only use FTP
+ * @return 0 on success, -ENOTSUP without libcurl or -ENOMEM
+ */
+int adb_library_set_mirror(struct adb_library *lib, const char *url)
+{
+	char *mirror = NULL;
+	size_t len;
+
+#if !HAVE_CURL
+	if (url)
+		return -ENOTSUP;
+#endif
+
+	if (url) {
+		mirror = strdup(url);
+		if (mirror == NULL)
+			return -ENOMEM;
+
+		/* files are appended with their own separator */
+		len = strlen(mirror);
+		while (len > 0 && mirror[len - 1] == '/')
+			mirror[--len] = 0;
+	}
+
+	free(lib->mirror);
+	lib->mirror = mirror;
+	return 0;
+}
+
 /**
  * @brief Sets the global message logging level for the database.
  *
@@ -171,6 +211,18 @@ void adb_set_log_level(struct adb_db *db, unsigned int log)
 	db->htm->msg_flags = log;
 }
 
+/**
+ * @brief Set the number of worker threads used by parallel operations.
+ *
+ * @param db Database catalog
+ * @param workers Worker threads, 0 for the OpenMP default
+ */
+void adb_set_workers(struct adb_db *db, int workers)
+{
+	db->workers = workers < 0 ? 0 : workers;
+	alloc_bind_workers(db);
+}
+
 /**
  * @brief Create a new database catalog instance.
  *
@@ -184,6 +236,44 @@ void adb_set_log_level(struct adb_db *db, unsigned int log)
  * @return A pointer to the newly allocated adb_db object, or NULL on failure
  */
 struct adb_db *adb_create_db(struct adb_library *lib, int depth, int tables)
+{
+	return adb_create_db_mesh(lib, depth, tables, ADB_MESH_FULL);
+}
+
+/**
+ * @brief Create a new database catalog instance with a mesh mode.
+ *
+ * As adb_create_db() but sparse meshes only create trixels when objects
+ * are inserted into them.
+ *
+ * @param lib Library repository to bind the database to
+ * @param depth HTM resolution depth
+ * @param tables Number of tables
+ * @param mesh HTM mesh build mode
+ * @return A pointer to the newly allocated adb_db object, or NULL on failure
+ */
+struct adb_db *adb_create_db_mesh(struct adb_library *lib, int depth,
+								  int tables, enum adb_mesh mesh)
+{
+	return adb_create_db_alloc(lib, depth, tables, mesh, ADB_ALLOC_DEFAULT);
+}
+
+/**
+ * @brief Create a new database catalog instance with a placement policy.
+ *
+ * As adb_create_db_mesh() but large table arrays, the mesh and the worker
+ * threads are placed by the allocation policy flags.
+ *
+ * @param lib Library repository to bind the database to
+ * @param depth HTM resolution depth
+ * @param tables Number of tables
+ * @param mesh HTM mesh build mode
+ * @param alloc enum adb_alloc placement flags
+ * @return A pointer to the newly allocated adb_db object, or NULL on failure
+ */
+struct adb_db *adb_create_db_alloc(struct adb_library *lib, int depth,
+								   int tables, enum adb_mesh mesh,
+								   unsigned int alloc)
 {
 	struct adb_db *db;
 
@@ -193,17 +283,23 @@ struct adb_db *adb_create_db(struct adb_library *lib, int depth, int tables)
 	db->lib = lib;
 	db->msg_level = ADB_MSG_INFO;
 	db->msg_flags = ADB_LOG_SEARCH | ADB_LOG_SOLVE;
+	db->alloc = alloc;
+	stats_init(&db->stats);
 
-	db->htm = htm_new(depth, tables);
+	alloc_mesh_begin(db);
+	db->htm = htm_new(depth, tables, mesh);
+	alloc_mesh_end(db);
 	if (db->htm == NULL) {
 		astrolib_error(lib,
 					   "failed to create DB with HTM depth of"
 					   "%d degrees and %d tables\n",
 					   depth, tables);
+		stats_free(&db->stats);
 		free(db);
 		return NULL;
 	}
 
+	alloc_bind_workers(db);
 	return db;
 }
 
@@ -218,10 +314,120 @@ struct adb_db *adb_create_db(struct adb_library *lib, int depth, int tables)
 void adb_db_free(struct adb_db *db)
 {
 	// TODO: free tables and htm
-	htm_free(db->htm);
+	remote_db_free(db);
+	if (db->htm)
+		htm_free(db->htm);
+	stats_free(&db->stats);
 	free(db);
 }
 
+/**
+ * @brief Freeze a catalog for concurrent read only queries.
+ *
+ * Builds everything queries would otherwise create on first use, so that
+ * afterwards they only write to their own object sets and searches.
+ *
+ * @param db Catalog database with its tables open
+ * @return 0 on success, or a negative error code on failure
+ */
+int adb_db_freeze(struct adb_db *db)
+{
+	struct adb_table *table;
+	int i, ret;
+
+	ret = db_check_local(db);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < ADB_MAX_TABLES; i++) {
+		if (!db->table_in_use[i])
+			continue;
+		table = &db->table[i];
+
+		ret = table_load_all(table);
+		if (ret < 0)
+			return ret;
+
+		if (table->object.count > 0 && table_get_columns(table) == NULL)
+			return -ENOMEM;
+
+		ret = kd_prepare_nodes(table);
+		if (ret < 0)
+			return ret;
+	}
+
+	/* kernels are selected on first use */
+	simd_get_level();
+
+	db->frozen = 1;
+	return 0;
+}
+
+/**
+ * @brief Thaw a frozen catalog.
+ *
+ * @param db Catalog database with no queries in flight
+ */
+void adb_db_thaw(struct adb_db *db)
+{
+	db->frozen = 0;
+}
+
+/**
+ * @brief Check that a catalog may be changed.
+ *
+ * @param db Catalog database
+ * @return 0 if thawed, or -EBUSY if frozen for concurrent queries
+ */
+int db_check_thawed(struct adb_db *db)
+{
+	if (!db->frozen)
+		return 0;
+
+	adb_error(db, "catalog is frozen for concurrent queries\n");
+	return -EBUSY;
+}
+
+/**
+ * @brief Check that a catalog is not connected to a query daemon.
+ *
+ * @param db Catalog database
+ * @return 0 if local, or -EOPNOTSUPP if remote
+ */
+int db_check_local(struct adb_db *db)
+{
+	if (!db->remote)
+		return 0;
+
+	adb_error(db, "not supported by remote catalogs\n");
+	return -EOPNOTSUPP;
+}
+
+/**
+ * @brief Register a callback for hot path trace events.
+ *
+ * The callback may only change while no queries run, so it is refused
+ * while the catalog is frozen.
+ *
+ * @param db Catalog database
+ * @param callback Event callback, or NULL to stop tracing
+ * @param data Private data passed to the callback
+ * @return 0 on success, -EBUSY if frozen or -ENOTSUP without tracing
+ */
+int adb_set_trace(struct adb_db *db, adb_trace_callback callback, void *data)
+{
+#if HAVE_TRACE
+	if (db_check_thawed(db) < 0)
+		return -EBUSY;
+
+	db->trace.callback = callback;
+	db->trace.data = data;
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
 /**
  * @brief Retrieve the library version string.
  *
@@ -0,0 +1,314 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "epoch.h"
+#include "table.h"
+#include "libastrodb/db.h"
+#include "libastrodb/object.h"
+
+#define EPOCH_AS2R (M_PI / (180.0 * 3600.0))
+#define EPOCH_JULIAN_YEAR 365.25
+
+/* proper motion field value in the field C type, NaN as no motion */
+static double epoch_field(const void *object, int offset, adb_ctype type)
+{
+	double value;
+
+	switch (type) {
+	case ADB_CTYPE_INT:
+		return *(const int *)(object + offset);
+	case ADB_CTYPE_FLOAT:
+		value = *(const float *)(object + offset);
+		break;
+	case ADB_CTYPE_DOUBLE:
+		value = *(const double *)(object + offset);
+		break;
+	default:
+		return 0.0;
+	}
+
+	return isnan(value) ? 0.0 : value;
+}
+
+/**
+ * \brief Propagate an object position by its proper motion.
+ *
+ * The motion is applied along the tangent plane at the catalog position and
+ * the result projected back onto the sphere, so objects near the poles move
+ * the same way as everywhere else.
+ *
+ * \param epoch Table proper motion fields.
+ * \param object Table object.
+ * \param years Julian years from the catalog epoch.
+ * \param ra Propagated RA.
+ * \param dec Propagated DEC.
+ */
+static void epoch_propagate(const struct table_epoch *epoch,
+							const struct adb_object *object, double years,
+							double *ra, double *dec)
+{
+	double pm_ra, pm_dec, sin_ra, cos_ra, sin_dec, cos_dec, x, y, z;
+
+	pm_ra = epoch_field(object, epoch->pm_ra, epoch->pm_ra_type);
+	pm_dec = epoch_field(object, epoch->pm_dec, epoch->pm_dec_type);
+
+	*ra = object->ra;
+	*dec = object->dec;
+	if ((pm_ra == 0.0 && pm_dec == 0.0) || years == 0.0)
+		return;
+
+	sincos(object->ra, &sin_ra, &cos_ra);
+	sincos(object->dec, &sin_dec, &cos_dec);
+
+	/* tangent plane motions in radians per year */
+	switch (epoch->units) {
+	case ADB_PM_MAS:
+		pm_ra *= EPOCH_AS2R / 1000.0;
+		pm_dec *= EPOCH_AS2R / 1000.0;
+		break;
+	case ADB_PM_ARCSEC:
+		pm_ra *= EPOCH_AS2R;
+		pm_dec *= EPOCH_AS2R;
+		break;
+	case ADB_PM_SEC_ARCSEC:
+		pm_ra *= 15.0 * EPOCH_AS2R * cos_dec;
+		pm_dec *= EPOCH_AS2R;
+		break;
+	}
+	pm_ra *= years;
+	pm_dec *= years;
+
+	x = cos_dec * cos_ra - pm_ra * sin_ra - pm_dec * sin_dec * cos_ra;
+	y = cos_dec * sin_ra + pm_ra * cos_ra - pm_dec * sin_dec * sin_ra;
+	z = sin_dec + pm_dec * cos_dec;
+
+	*ra = atan2(y, x);
+	if (*ra < 0.0)
+		*ra += 2.0 * M_PI;
+	*dec = atan2(z, sqrt(x * x + y * y));
+}
+
+/* cached view at an epoch or NULL */
+static struct epoch_view *epoch_find(struct adb_table *table, double JD)
+{
+	int i;
+
+	for (i = 0; i < EPOCH_VIEWS; i++) {
+		if (table->epoch.view[i].ra && table->epoch.view[i].JD == JD)
+			return &table->epoch.view[i];
+	}
+
+	return NULL;
+}
+
+void epoch_free_views(struct adb_table *table)
+{
+	int i;
+
+	for (i = 0; i < EPOCH_VIEWS; i++) {
+		free(table->epoch.view[i].ra);
+		table->epoch.view[i].ra = NULL;
+		table->epoch.view[i].dec = NULL;
+	}
+}
+
+/**
+ * \brief Set the proper motion fields used to propagate table positions.
+ *
+ * \param db Database catalog
+ * \param table_id Table ID
+ * \param pm_ra RA proper motion field name
+ * \param pm_dec DEC proper motion field name
+ * \param units Proper motion field units
+ * \param JD Julian Date of the catalog positions
+ * \return 0 on success, or a negative error code on failure
+ */
+int adb_table_proper_motion(struct adb_db *db, int table_id, const char *pm_ra,
+							const char *pm_dec, enum adb_pm_units units,
+							double JD)
+{
+	struct table_epoch *epoch;
+	const char *key[2] = { pm_ra, pm_dec };
+	adb_ctype type[2];
+	int offset[2], i;
+
+	if (table_id < 0 || table_id >= ADB_MAX_TABLES)
+		return -EINVAL;
+	if (db_check_thawed(db) < 0)
+		return -EBUSY;
+
+	if (units > ADB_PM_SEC_ARCSEC) {
+		adb_error(db, "invalid proper motion units %d\n", units);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < 2; i++) {
+		offset[i] = adb_table_get_field_offset(db, table_id, key[i]);
+		if (offset[i] < 0) {
+			adb_error(db, "invalid field offset %s\n", key[i]);
+			return -EINVAL;
+		}
+
+		type[i] = adb_table_get_field_type(db, table_id, key[i]);
+		switch (type[i]) {
+		case ADB_CTYPE_INT:
+		case ADB_CTYPE_FLOAT:
+		case ADB_CTYPE_DOUBLE:
+			break;
+		default:
+			adb_error(db, "field %s type not supported for proper motion\n",
+					  key[i]);
+			return -EINVAL;
+		}
+	}
+
+	epoch = &db->table[table_id].epoch;
+	epoch_free_views(&db->table[table_id]);
+	epoch->pm_ra = offset[0];
+	epoch->pm_dec = offset[1];
+	epoch->pm_ra_type = type[0];
+	epoch->pm_dec_type = type[1];
+	epoch->units = units;
+	epoch->JD = JD;
+	epoch->valid = 1;
+	return 0;
+}
+
+/**
+ * \brief Compute the positions of all table objects at an epoch.
+ *
+ * The least recently used cached epoch is replaced when all are in use.
+ *
+ * \param db Database catalog
+ * \param table_id Table ID
+ * \param JD Julian Date to propagate the positions to
+ * \return 0 on success, or a negative error code on failure
+ */
+int adb_table_epoch_view(struct adb_db *db, int table_id, double JD)
+{
+	struct adb_table *table;
+	struct epoch_view *view;
+	const void *objects;
+	double years;
+	int i, count, bytes, ret;
+
+	if (table_id < 0 || table_id >= ADB_MAX_TABLES)
+		return -EINVAL;
+	ret = db_check_local(db);
+	if (ret < 0)
+		return ret;
+	table = &db->table[table_id];
+
+	if (!table->epoch.valid) {
+		adb_error(db, "table %d has no proper motion fields\n", table_id);
+		return -EINVAL;
+	}
+
+	/* frozen catalogs may only read the cache */
+	view = epoch_find(table, JD);
+	if (view) {
+		if (!db->frozen)
+			view->used = ++table->epoch.clock;
+		return 0;
+	}
+	if (db_check_thawed(db) < 0)
+		return -EBUSY;
+
+	ret = table_load_all(table);
+	if (ret < 0)
+		return ret;
+
+	view = &table->epoch.view[0];
+	for (i = 1; i < EPOCH_VIEWS && view->ra; i++) {
+		if (!table->epoch.view[i].ra || table->epoch.view[i].used < view->used)
+			view = &table->epoch.view[i];
+	}
+	free(view->ra);
+	view->ra = NULL;
+	view->dec = NULL;
+
+	count = table->object.count;
+	view->ra = malloc(2 * (size_t)(count ? count : 1) * sizeof(double));
+	if (view->ra == NULL)
+		return -ENOMEM;
+	view->dec = view->ra + count;
+
+	objects = table->objects;
+	bytes = table->object.bytes;
+	years = (JD - table->epoch.JD) / EPOCH_JULIAN_YEAR;
+
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(db_workers(db))
+#endif
+	for (i = 0; i < count; i++)
+		epoch_propagate(&table->epoch, objects + (size_t)i * bytes, years,
+						&view->ra[i], &view->dec[i]);
+
+	view->JD = JD;
+	view->used = ++table->epoch.clock;
+
+	adb_info(db, ADB_LOG_CDS_TABLE,
+			 "propagated %d objects of table %d by %.2f years\n", count,
+			 table_id, years);
+	return 0;
+}
+
+/**
+ * \brief Get the position of a table object at an epoch.
+ *
+ * \param db Database catalog
+ * \param table_id Table ID
+ * \param object Table object
+ * \param JD Julian Date of the position
+ * \param ra RA of the object at JD
+ * \param dec DEC of the object at JD
+ * \return 0 on success, or a negative error code on failure
+ */
+int adb_table_get_epoch_position(struct adb_db *db, int table_id,
+								 const struct adb_object *object, double JD,
+								 double *ra, double *dec)
+{
+	struct adb_table *table;
+	struct epoch_view *view;
+	size_t offset;
+	int ret;
+
+	ret = adb_table_epoch_view(db, table_id, JD);
+	if (ret < 0)
+		return ret;
+
+	table = &db->table[table_id];
+	offset = (const char *)object - (const char *)table->objects;
+	if ((const void *)object < (const void *)table->objects ||
+		offset % table->object.bytes ||
+		offset / table->object.bytes >= table->object.count) {
+		adb_error(db, "object is not in table %d\n", table_id);
+		return -EINVAL;
+	}
+
+	view = epoch_find(table, JD);
+	*ra = view->ra[offset / table->object.bytes];
+	*dec = view->dec[offset / table->object.bytes];
+	return 0;
+}
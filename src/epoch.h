@@ -0,0 +1,77 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#ifndef __ADB_EPOCH_H
+#define __ADB_EPOCH_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include "libastrodb/db.h"
+#include "libastrodb/db-import.h"
+
+/*! \defgroup epoch Epoch
+ *
+ * \brief Table positions propagated by proper motion to other epochs.
+ *
+ * The positions of every table object at an epoch are computed once into
+ * arrays in table object order, next to the table field arrays, and kept
+ * for the most recently used epochs.
+ */
+
+#define EPOCH_VIEWS 4 /* cached epochs per table */
+
+/*! \struct epoch_view
+ * \brief Table object positions at one epoch.
+ * \ingroup epoch
+ */
+struct epoch_view {
+	double JD; /*!< epoch of the positions */
+	double *ra; /*!< object RA at JD in table object order */
+	double *dec; /*!< object DEC at JD in table object order */
+	unsigned int used; /*!< use stamp for replacement */
+};
+
+/*! \struct table_epoch
+ * \brief Proper motion fields and cached epoch positions of a table.
+ * \ingroup epoch
+ */
+struct table_epoch {
+	int valid; /*!< proper motion fields are set */
+	int pm_ra; /*!< RA proper motion field offset */
+	int pm_dec; /*!< DEC proper motion field offset */
+	adb_ctype pm_ra_type; /*!< RA proper motion field C type */
+	adb_ctype pm_dec_type; /*!< DEC proper motion field C type */
+	enum adb_pm_units units; /*!< proper motion units */
+	double JD; /*!< catalog epoch */
+	struct epoch_view view[EPOCH_VIEWS];
+	unsigned int clock; /*!< last use stamp */
+};
+
+struct adb_table;
+
+/*!
+ * \brief Free the cached epoch positions of a table.
+ * \ingroup epoch
+ *
+ * \param table Database table pointer
+ */
+void epoch_free_views(struct adb_table *table);
+
+#endif
+
+#endif
@@ -19,10 +19,12 @@
 #include <assert.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -36,274 +38,534 @@
 #include "libastrodb/db.h"
 #include "libastrodb/object.h"
 
+#define HASH_FILE_MAGIC 0x48534148 /* "HASH" */
+#define HASH_FILE_VERSION 2
+
+/*! \struct hash_file_hdr
+ * \brief hash map file header
+ * \ingroup hash
+ *
+ * The header is followed by the slots. Slots refer to table objects by
+ * position in the table file.
+ */
+struct hash_file_hdr {
+	u_int32_t magic; /*!< HASH_FILE_MAGIC */
+	u_int32_t version; /*!< HASH_FILE_VERSION */
+	u_int32_t object_bytes; /*!< size of each table object */
+	u_int32_t object_count; /*!< number of table objects */
+	u_int32_t offset; /*!< key field offset */
+	u_int32_t size; /*!< key field size */
+	u_int32_t type; /*!< key field C type */
+	u_int32_t slots; /*!< number of slots */
+	u_int32_t checksum; /*!< FNV-1a of the slot words */
+	u_int32_t reserved;
+} __attribute__((packed));
+
+/* spread the bits of a hash so any run of low bits indexes the slots */
+static inline u_int32_t hash_mix(u_int32_t val)
+{
+	val ^= val >> 16;
+	val *= 0x85ebca6b;
+	val ^= val >> 13;
+	val *= 0xc2b2ae35;
+	val ^= val >> 16;
+	return val;
+}
+
 /**
  * @brief Calculate a hash value for a string.
  * @ingroup hash
  *
- * Computes an integer hash value based on the characters in the string `data`
- * up to length `len`, modulo the given `mod` value. Spaces (' ') and hyphens
- * ('-') are explicitly ignored during the hashing process.
+ * Computes a FNV-1a hash of the characters in the string `data` up to
+ * length `len` or its terminator. Characters outside '0' to 'z', like
+ * spaces (' ') and hyphens ('-'), are ignored during the hashing process.
  *
  * @param data The string to hash
- * @param len Length of the string
- * @param mod Modulo to apply to the final hash value
- * @return The calculated integer hash value in the range [0, mod-1]
+ * @param len Maximum length of the string
+ * @return The calculated hash value
  */
-int hash_string(const char *data, int len, int mod)
+unsigned int hash_string(const char *data, int len)
 {
-	int val = 0;
+	u_int32_t val = 2166136261u;
+	int i;
 
-	if (mod == 0) {
-		// adb_error(db, "mod is 0\n");
-		return 0;
-	}
-
-	while (*data != 0) {
-		if (*data >= '0' && *data <= 'z')
-			val = ((val << 5) ^ (val >> 27)) ^ *data;
-		data++;
+	for (i = 0; i < len && data[i] != 0; i++) {
+		if (data[i] >= '0' && data[i] <= 'z') {
+			val ^= (unsigned char)data[i];
+			val *= 16777619u;
+		}
 	}
 
-	val = abs(val % mod);
-	return val;
+	return hash_mix(val);
 }
 
 /**
  * @brief Calculate a hash value for an integer.
  * @ingroup hash
  *
- * Computes an integer hash value based on the integer `val`,
- * modulo the given `mod` value. Returns the absolute value of the modulus.
- *
  * @param val The integer value to hash
- * @param mod Modulo to apply to the final hash value
- * @return The calculated integer hash value in the range [0, mod-1]
+ * @return The calculated hash value
  */
-int hash_int(int val, int mod)
+unsigned int hash_int(int val)
+{
+	return hash_mix((u_int32_t)val);
+}
+
+/* hash the key field of an object */
+static inline u_int32_t hash_key(const struct hash_map *map,
+								 const void *object)
+{
+	const void *field = object + map->offset;
+
+	if (map->type == ADB_CTYPE_STRING)
+		return hash_string(field, map->size);
+	return hash_int(*((int *)field));
+}
+
+static int hash_check_type(struct adb_db *db, struct hash_map *map)
+{
+	switch (map->type) {
+	case ADB_CTYPE_STRING:
+	case ADB_CTYPE_SHORT:
+	case ADB_CTYPE_INT:
+		return 0;
+	case ADB_CTYPE_DOUBLE_MPC:
+	case ADB_CTYPE_SIGN:
+	case ADB_CTYPE_NULL:
+	case ADB_CTYPE_FLOAT:
+	case ADB_CTYPE_DOUBLE:
+	case ADB_CTYPE_DEGREES:
+	case ADB_CTYPE_DOUBLE_DMS_DEGS:
+	case ADB_CTYPE_DOUBLE_DMS_MINS:
+	case ADB_CTYPE_DOUBLE_DMS_SECS:
+	case ADB_CTYPE_DOUBLE_HMS_HRS:
+	case ADB_CTYPE_DOUBLE_HMS_MINS:
+	case ADB_CTYPE_DOUBLE_HMS_SECS:
+	default:
+		break;
+	}
+
+	adb_error(db, "ctype %d not implemented\n", map->type);
+	return -EINVAL;
+}
+
+/* checksum of the slots saved with the map */
+static u_int32_t hash_checksum(const struct hash_slot *slot,
+							   unsigned int slots)
+{
+	const u_int32_t *word = (const u_int32_t *)slot;
+	u_int32_t val = 2166136261u;
+	size_t i, words = (size_t)slots * sizeof(*slot) / sizeof(*word);
+
+	for (i = 0; i < words; i++) {
+		val ^= word[i];
+		val *= 16777619u;
+	}
+
+	return val;
+}
+
+/* release allocated or mapped slots */
+static void hash_release_slots(struct hash_map *map)
+{
+	if (map->map)
+		munmap(map->map, map->map_size);
+	else
+		free(map->slot);
+
+	map->slot = NULL;
+	map->map = NULL;
+	map->map_size = 0;
+}
+
+/* allocate empty slots for count objects */
+static int hash_alloc_slots(struct hash_map *map, int count)
+{
+	unsigned int slots = 2;
+
+	while (slots < 2 * (unsigned int)count)
+		slots <<= 1;
+
+	hash_release_slots(map);
+	map->slot = malloc(slots * sizeof(*map->slot));
+	if (map->slot == NULL)
+		return -ENOMEM;
+
+	/* all bits set marks a slot empty with index -1 */
+	memset(map->slot, 0xff, slots * sizeof(*map->slot));
+	map->mask = slots - 1;
+	return 0;
+}
+
+static void hash_insert_object(struct hash_map *map, u_int32_t hash,
+							   int index)
 {
-	return abs(val % mod);
+	unsigned int i = hash & map->mask;
+
+	while (map->slot[i].index >= 0)
+		i = (i + 1) & map->mask;
+
+	map->slot[i].hash = hash;
+	map->slot[i].index = index;
+}
+
+static void hash_free(struct table_hash *hash)
+{
+	int i;
+
+	for (i = 0; i < ADB_MAX_HASH_MAPS; i++)
+		hash_release_slots(&hash->map[i]);
 }
 
 /**
  * @brief Free memory allocated for table hash maps.
  *
- * Iterates through all configured hash maps associated with the specified table and
- * releases the dynamically allocated internal index arrays previously used mapping references.
+ * Releases the slot arrays of every hash map configured on the table.
  *
- * @param table The tracking database layout object table containing allocated mapping arrays.
+ * @param table The table containing allocated mapping arrays.
  */
 void hash_free_maps(struct adb_table *table)
 {
-	int i, j;
-
-	for (i = 0; i < table->hash.num; i++) {
-		for (j = 0; j < table->object.count; j++) {
-			if (table->hash.map[i].index[j])
-				free(table->hash.map[i].index[j]);
-		}
+	hash_free(&table->hash);
+}
 
-		free(table->hash.map[i].index);
-	}
+/**
+ * @brief Free memory allocated for object set hash maps.
+ *
+ * @param set The object set containing allocated mapping arrays.
+ */
+void hash_free_set_maps(struct adb_object_set *set)
+{
+	hash_free(&set->hash);
 }
 
-static int hash_insert_object(struct hash_map *hash_map,
-							  const struct adb_object *object,
-							  unsigned int index)
+/**
+ * @brief Map a hash map file.
+ *
+ * The file is only used when it was written for the same table objects and
+ * key field, is newer than the table file and its slots match the saved
+ * checksum. The slots are used in place from a read only mapping.
+ *
+ * @param table Table with loaded objects.
+ * @param map Hash map with its key field set.
+ * @param file Hash map file name.
+ * @return 0 on success, or a negative error code.
+ */
+static int hash_read(struct adb_table *table, struct hash_map *map,
+					 const char *file)
 {
-	int size, count;
-
-	if (hash_map->index[index]) {
-		/* hash exists, realloc and add to end*/
-		count = hash_map->index[index]->count + 1;
-
-		size =
-			sizeof(struct hash_object *) + sizeof(struct adb_object *) * count;
-
-		hash_map->index[index] = realloc(hash_map->index[index], size);
-		if (!hash_map->index[index])
-			return -ENOMEM;
-
-		hash_map->index[index]->object[count - 1] = object;
-		hash_map->index[index]->count++;
-	} else {
-		/* no hash,so create new one */
-		hash_map->index[index] =
-			calloc(1, sizeof(struct hash_object) + sizeof(struct adb_object *));
-		if (!hash_map->index[index])
-			return -ENOMEM;
-
-		hash_map->index[index]->object[0] = object;
-		hash_map->index[index]->count = 1;
+	const struct hash_file_hdr *hdr;
+	const struct hash_slot *slot;
+	struct stat db_stat, hash_stat;
+	char db_file[ADB_PATH_SIZE];
+	unsigned int i, used = 0;
+	int fd, ret = -EINVAL;
+	void *data;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &hash_stat) < 0) {
+		ret = -errno;
+		close(fd);
+		return ret;
 	}
 
-	return 0;
-}
+	sprintf(db_file, "%s%s%s", table->path.local, table->path.file, ".db");
+	if (stat(db_file, &db_stat) == 0 && db_stat.st_mtime > hash_stat.st_mtime) {
+		adb_info(table->db, ADB_LOG_CDS_TABLE, "Hash map %s is stale\n", file);
+		close(fd);
+		return -EINVAL;
+	}
 
-static void table_hash_string(struct adb_table *table, int map)
-{
-	const void *object = table->objects;
-	const void *field;
-	int i, index;
+	if (hash_stat.st_size < sizeof(*hdr)) {
+		close(fd);
+		goto err;
+	}
 
-	/* hash object for this map */
-	for (i = 0; i < table->object.count; i++) {
-		field = object + table->hash.map[map].offset;
+	data = mmap(NULL, hash_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		ret = -errno;
+		adb_error(table->db, "Error failed to map hash map %s %d\n", file,
+				  ret);
+		return ret;
+	}
 
-		index =
-			hash_string(field, table->hash.map[map].size, table->object.count);
+	hdr = data;
+	slot = data + sizeof(*hdr);
+
+	if (hdr->magic != HASH_FILE_MAGIC || hdr->version != HASH_FILE_VERSION ||
+		hdr->object_bytes != table->object.bytes ||
+		hdr->object_count != table->object.count ||
+		hdr->offset != map->offset || hdr->size != map->size ||
+		hdr->type != map->type || hdr->slots < 2 * hdr->object_count ||
+		(hdr->slots & (hdr->slots - 1)) ||
+		hash_stat.st_size !=
+			sizeof(*hdr) + (off_t)hdr->slots * sizeof(*slot)) {
+		adb_info(table->db, ADB_LOG_CDS_TABLE,
+				 "Hash map %s is for another table or key\n", file);
+		goto unmap;
+	}
 
-		hash_insert_object(&table->hash.map[map], object, index);
-		object += table->object.bytes;
+	if (hash_checksum(slot, hdr->slots) != hdr->checksum)
+		goto unmap;
+
+	for (i = 0; i < hdr->slots; i++) {
+		if (slot[i].index < 0)
+			continue;
+		if (slot[i].index >= hdr->object_count)
+			goto unmap;
+		used++;
 	}
+	if (used != hdr->object_count)
+		goto unmap;
+
+	map->slot = (struct hash_slot *)slot;
+	map->mask = hdr->slots - 1;
+	map->map = data;
+	map->map_size = hash_stat.st_size;
+	return 0;
+
+unmap:
+	munmap(data, hash_stat.st_size);
+err:
+	adb_error(table->db, "Error can't use hash map %s\n", file);
+	return ret;
 }
 
-static void table_hash_int(struct adb_table *table, int map)
+/**
+ * @brief Write a hash map file.
+ *
+ * @param table Table with the hashed objects.
+ * @param map Hash map to write.
+ * @param file Hash map file name.
+ * @return 0 on success, or a negative error code.
+ */
+static int hash_write(struct adb_table *table, struct hash_map *map,
+					  const char *file)
 {
-	const void *object = table->objects;
-	const void *field;
-	int i, index;
+	struct hash_file_hdr hdr;
+	int ret = 0;
+	FILE *f;
+
+	f = fopen(file, "w");
+	if (f == NULL) {
+		adb_error(table->db, "Error can't open hash map %s for writing\n",
+				  file);
+		return -EIO;
+	}
 
-	/* hash object for this map */
-	for (i = 0; i < table->object.count; i++) {
-		field = object + table->hash.map[map].offset;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = HASH_FILE_MAGIC;
+	hdr.version = HASH_FILE_VERSION;
+	hdr.object_bytes = table->object.bytes;
+	hdr.object_count = table->object.count;
+	hdr.offset = map->offset;
+	hdr.size = map->size;
+	hdr.type = map->type;
+	hdr.slots = map->mask + 1;
+	hdr.checksum = hash_checksum(map->slot, hdr.slots);
+
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+		fwrite(map->slot, sizeof(*map->slot), hdr.slots, f) != hdr.slots)
+		ret = -EIO;
+
+	if (fclose(f) != 0)
+		ret = -EIO;
+
+	if (ret < 0) {
+		adb_error(table->db, "Error writing hash map %s\n", file);
+		remove(file);
+	}
+	return ret;
+}
+
+/**
+ * @brief Hash every table object into a map.
+ *
+ * Keys are hashed by the database workers and then inserted in table order,
+ * so objects with equal keys are found in table order.
+ *
+ * @param table Table with loaded objects.
+ * @param map Hash map with its key field set.
+ * @return 0 on success, or a negative error code.
+ */
+static int hash_build(struct adb_table *table, struct hash_map *map)
+{
+	int count = table->object.count, bytes = table->object.bytes, i, ret;
+	const void *objects = table->objects;
+	u_int32_t *hash;
 
-		index = hash_int(*((int *)field), table->object.count);
+	hash = malloc(count * sizeof(*hash));
+	if (hash == NULL)
+		return -ENOMEM;
 
-		hash_insert_object(&table->hash.map[map], object, index);
-		object += table->object.bytes;
+	ret = hash_alloc_slots(map, count);
+	if (ret < 0) {
+		free(hash);
+		return ret;
 	}
+
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(db_workers(table->db))
+#endif
+	for (i = 0; i < count; i++)
+		hash[i] = hash_key(map, objects + (size_t)i * bytes);
+
+	for (i = 0; i < count; i++)
+		hash_insert_object(map, hash[i], i);
+
+	free(hash);
+	return 0;
 }
 
 /**
- * @brief Build a comprehensive hash map index layer mapping all table targets.
+ * @brief Build or map a table hash map.
  *
- * Initializes spatial map tracking index constraints over targeted fields and values sequentially.
- * Allocates fresh pointer lookup boundaries spanning full active imported table sizes. Evaluates
- * string maps or numerical mapping constraints parsing appropriate types correctly.
+ * Lookups compare keys against the table objects, so lazily loaded tables
+ * are loaded first. The map is mapped from the .hash file for the key next
+ * to the table .db file when it matches the table, otherwise it is built and
+ * saved there.
  *
- * @param table Operational catalog layout referencing raw struct blocks targets.
- * @param map Map target layout parameter index ID identifying internal map index bindings.
- * @return Returns termination logic status descriptors (zero identifying completion).
+ * @param table Table with the map key field set.
+ * @param map Map index in the table hash maps.
+ * @return 0 on success, or a negative error code.
  */
 int hash_build_table(struct adb_table *table, int map)
 {
-	struct hash_object **hash_object;
+	struct hash_map *hash_map = &table->hash.map[map];
+	char file[ADB_PATH_SIZE];
+	int ret;
 
 	if (table->object.count == 0) {
 		adb_error(table->db, "table has no objects to hash\n");
 		return -EINVAL;
 	}
 
-	hash_object = calloc(sizeof(struct hash_object *), table->object.count);
-	if (hash_object == NULL)
-		return -ENOMEM;
+	ret = hash_check_type(table->db, hash_map);
+	if (ret < 0)
+		return ret;
 
-	table->hash.map[map].index = hash_object;
+	ret = table_load_all(table);
+	if (ret < 0)
+		return ret;
 
-	switch (table->hash.map[map].type) {
-	case ADB_CTYPE_STRING:
-		table_hash_string(table, map);
-		break;
-	case ADB_CTYPE_SHORT:
-	case ADB_CTYPE_INT:
-		table_hash_int(table, map);
-		break;
-	case ADB_CTYPE_DOUBLE_MPC:
-	case ADB_CTYPE_SIGN:
-	case ADB_CTYPE_NULL:
-	case ADB_CTYPE_FLOAT:
-	case ADB_CTYPE_DOUBLE:
-	case ADB_CTYPE_DEGREES:
-	case ADB_CTYPE_DOUBLE_DMS_DEGS:
-	case ADB_CTYPE_DOUBLE_DMS_MINS:
-	case ADB_CTYPE_DOUBLE_DMS_SECS:
-	case ADB_CTYPE_DOUBLE_HMS_HRS:
-	case ADB_CTYPE_DOUBLE_HMS_MINS:
-	case ADB_CTYPE_DOUBLE_HMS_SECS:
-		adb_error(table->db, "ctype %d not implemented\n",
-				  table->hash.map[map].type);
-		break;
+	/* imported objects are only in the trixels until the table is opened */
+	if (table->objects == NULL) {
+		adb_error(table->db, "table objects not loaded, open the table\n");
+		return -ENODATA;
 	}
 
+	sprintf(file, "%s%s.%s%s", table->path.local, table->path.file,
+			hash_map->key, ".hash");
+	if (hash_read(table, hash_map, file) == 0) {
+		adb_info(table->db, ADB_LOG_CDS_TABLE, "Mapped hash map %s\n", file);
+		return 0;
+	}
+
+	ret = hash_build(table, hash_map);
+	if (ret < 0)
+		return ret;
+
+	/* the map still works for this session if it can't be saved */
+	hash_write(table, hash_map, file);
 	return 0;
 }
 
-static void set_hash_string(struct adb_object_set *set, int map)
+/**
+ * @brief Hash the objects of an object set into a map.
+ *
+ * @param set Object set with its objects gathered.
+ * @param map Map index in the set hash maps.
+ * @return 0 on success, or a negative error code.
+ */
+int hash_build_set(struct adb_object_set *set, int map)
 {
 	const struct adb_object_head *object_heads = set->object_heads;
+	struct hash_map *hash_map = &set->hash.map[map];
+	struct adb_table *table = set->table;
 	const void *object;
-	const void *field;
-	int i, j, index;
+	int i, j, ret;
+
+	if (set->count == 0) {
+		adb_error(set->db, "set has no objects to hash\n");
+		return -EINVAL;
+	}
+
+	ret = hash_check_type(set->db, hash_map);
+	if (ret < 0)
+		return ret;
+
+	ret = hash_alloc_slots(hash_map, set->count);
+	if (ret < 0)
+		return ret;
 
 	for (i = 0; i < set->head_count; i++) {
 		object = object_heads->objects;
 
 		for (j = 0; j < object_heads->count; j++) {
-			field = object + set->hash.map[map].offset;
-			index = hash_string(field, set->hash.map[map].size, set->count);
-
-			hash_insert_object(&set->hash.map[map], object, index);
-			object += set->table->object.bytes;
+			hash_insert_object(hash_map, hash_key(hash_map, object),
+							   (object - (const void *)table->objects) /
+								   table->object.bytes);
+			object += table->object.bytes;
 		}
 
 		object_heads++;
 	}
+
+	return 0;
 }
 
-static void set_hash_int(struct adb_object_set *set, int map)
+/* is a table object inside the object heads of a set */
+static int hash_set_has_object(const struct adb_object_set *set,
+							   unsigned int index)
 {
-	const struct adb_object_head *object_heads = set->object_heads;
-	const void *object;
-	const void *field;
-	int i, j, index;
-
-	for (i = 0; i < set->head_count; i++) {
-		object = object_heads->objects;
+	const struct adb_object_head *head = set->object_heads;
+	int i;
 
-		for (j = 0; j < object_heads->count; j++) {
-			field = object + set->hash.map[map].offset;
-			index = hash_int(*((int *)field), set->count);
-
-			hash_insert_object(&set->hash.map[map], object, index);
-			object += set->table->object.bytes;
-		}
-
-		object_heads++;
+	for (i = 0; i < set->head_count; i++, head++) {
+		if (index - head->index < head->count)
+			return 1;
 	}
+
+	return 0;
 }
 
 /**
- * @brief Compile and instantiate a generic hash mapped object filter selection query results grouping.
+ * @brief Look up an object by key in a hash map.
  *
- * Performs runtime dynamic evaluations indexing memory object pointers matching specified parameters criteria
- * rapidly organizing search result intersections against loaded active table records attributes fields indices.
+ * Probes from the key's home slot until an empty slot, comparing objects
+ * only for slots holding the same full hash. Probing a table map for a set
+ * skips objects outside the set, so a later object with the same key that
+ * is inside the set is still found.
  *
- * @param set Active grouping result index object containing references target mapped arrays constraints.
- * @param map Targeting map dimension layout parameter tracking boundary ID metrics layer references.
- * @return 0 on success, or negative evaluation bound limits missing structures logic errors.
+ * @param table Table holding the hashed objects.
+ * @param map Hash map to probe.
+ * @param set Object set filtering hits, or NULL.
+ * @param id Key value, a string or an int.
+ * @param offset Offset of the key field in each object.
+ * @param ctype C type of the key field.
+ * @param object Output object on a hit.
+ * @return 1 on a hit, 0 on a miss or -EINVAL for an unsupported type.
  */
-int hash_build_set(struct adb_object_set *set, int map)
+int hash_get_object(const struct adb_table *table, const struct hash_map *map,
+					const struct adb_object_set *set, const void *id,
+					int offset, adb_ctype ctype,
+					const struct adb_object **object)
 {
-	struct hash_object **hash_object;
-
-	if (set->count == 0) {
-		adb_error(set->db, "set has no objects to hash\n");
-		return -EINVAL;
-	}
-
-	hash_object = calloc(sizeof(struct hash_object *), set->count);
-	if (hash_object == NULL)
-		return -ENOMEM;
-
-	set->hash.map[map].index = hash_object;
+	const void *o;
+	u_int32_t hash;
+	unsigned int i, probes = 0;
 
-	switch (set->hash.map[map].type) {
+	switch (ctype) {
 	case ADB_CTYPE_STRING:
-		set_hash_string(set, map);
+		hash = hash_string(id, strlen(id));
 		break;
 	case ADB_CTYPE_SHORT:
 	case ADB_CTYPE_INT:
-		set_hash_int(set, map);
+		hash = hash_int(*((int *)id));
 		break;
 	case ADB_CTYPE_DOUBLE_MPC:
 	case ADB_CTYPE_SIGN:
@@ -317,10 +579,38 @@ int hash_build_set(struct adb_object_set *set, int map)
 	case ADB_CTYPE_DOUBLE_HMS_HRS:
 	case ADB_CTYPE_DOUBLE_HMS_MINS:
 	case ADB_CTYPE_DOUBLE_HMS_SECS:
-		adb_error(set->db, "ctype %d not implemented\n",
-				  set->hash.map[map].type);
-		break;
+	default:
+		return -EINVAL;
+	}
+
+	stats_add(&table->db->stats, STATS_HASH_LOOKUPS, 1);
+	if (map->slot == NULL)
+		return 0;
+
+	for (i = hash & map->mask; map->slot[i].index >= 0;
+		 i = (i + 1) & map->mask) {
+		probes++;
+		if (map->slot[i].hash != hash)
+			continue;
+
+		o = (const void *)table->objects +
+			(size_t)map->slot[i].index * table->object.bytes;
+
+		/* search through hashes for exact match */
+		if (ctype == ADB_CTYPE_STRING) {
+			if (!strstr((const char *)o + offset, id))
+				continue;
+		} else if (*((int *)(o + offset)) != *((int *)id))
+			continue;
+
+		if (set && !hash_set_has_object(set, map->slot[i].index))
+			continue;
+
+		stats_add(&table->db->stats, STATS_HASH_PROBES, probes);
+		*object = o;
+		return 1;
 	}
 
+	stats_add(&table->db->stats, STATS_HASH_PROBES, probes);
 	return 0;
 }
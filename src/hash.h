@@ -21,6 +21,9 @@
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
+#include <stdint.h>
+#include <sys/types.h>
+
 #include "libastrodb/db-import.h"
 #include "htm.h"
 /*! \defgroup hash Hash
@@ -35,25 +38,30 @@
 
 struct adb_table;
 
-/*! \struct hash_object
- * \brief Object hash bucket.
+/*! \struct hash_slot
+ * \brief Open addressing hash slot.
  * \ingroup table
  *
- * Points to an array of objects that match a hash number. We can store > 1 object to cope with hash collisions.
+ * Holds the table position of one object and the full hash of its key, so
+ * most probes of other keys are rejected without touching the object.
  */
-struct hash_object {
-	int count; /*!< Number of objects in this block */
-	const struct adb_object *object[]; /*!< Array of objects matching this hash */
+struct hash_slot {
+	u_int32_t hash; /*!< full hash of the object key */
+	int32_t index; /*!< table position of the object, -1 when empty */
 };
 
 /*! \struct hash_map
  * \brief Single hash map index.
  * \ingroup table
  *
- * Defines a hash index over a specific field.
+ * Defines a linear probing hash index over a specific field. The slot count
+ * is a power of two at least twice the number of objects.
  */
 struct hash_map {
-	struct hash_object **index; /*!< Hash table pointing to objects */
+	struct hash_slot *slot; /*!< hash slots */
+	unsigned int mask; /*!< slot count - 1 */
+	void *map; /*!< mapped .hash file holding the slots, or NULL */
+	size_t map_size; /*!< size of the mapped file */
 	int offset; /*!< Offset in object for hashed ID */
 	adb_ctype type; /*!< C type (string or int) */
 	int size; /*!< Size of the hashed field in bytes */
@@ -75,42 +83,50 @@ struct table_hash {
  * \brief Hash a string value.
  * \ingroup hash
  *
- * Computes a hash index for a given string.
+ * Computes a 32 bit FNV-1a hash of a string, finalised so the low bits are
+ * usable as a slot index. Characters outside '0' to 'z', like spaces and
+ * hyphens, are skipped.
  *
  * \param data The string data to hash
- * \param len The length of the string
- * \param mod Modulo divisor (number of buckets)
- * \return The computed hash index
+ * \param len The maximum length of the string
+ * \return The computed hash
  */
-int hash_string(const char *data, int len, int mod);
+unsigned int hash_string(const char *data, int len);
 
 /*!
  * \brief Hash an integer value.
  * \ingroup hash
  *
- * Computes a hash index for a given integer.
- *
  * \param val The integer value to hash
- * \param mod Modulo divisor (number of buckets)
- * \return The computed hash index
+ * \return The computed hash
  */
-int hash_int(int val, int mod);
+unsigned int hash_int(int val);
 
 /*!
  * \brief Free hash maps in a table.
  * \ingroup hash
  *
- * Frees all dynamically allocated memory within a table's hash index array.
+ * Frees the slot arrays of a table's hash maps.
  *
  * \param table Database table pointer
  */
 void hash_free_maps(struct adb_table *table);
 
 /*!
- * \brief Build hash table maps.
+ * \brief Free hash maps in an object set.
+ * \ingroup hash
+ *
+ * \param set Object set
+ */
+void hash_free_set_maps(struct adb_object_set *set);
+
+/*!
+ * \brief Build or map a table hash map.
  * \ingroup hash
  *
- * Populates a table's given hash map by hashing each object.
+ * Maps the slots from the .hash file next to the table .db file when that
+ * was written for the same table and key and its checksum matches,
+ * otherwise hashes each object and saves the map there.
  *
  * \param table Database table to index
  * \param map Index of the map inside `table->hash` to populate
@@ -130,6 +146,27 @@ int hash_build_table(struct adb_table *table, int map);
  */
 int hash_build_set(struct adb_object_set *set, int map);
 
+/*!
+ * \brief Look up an object by key in a hash map.
+ * \ingroup hash
+ *
+ * A table map probed for an object set only returns objects inside the
+ * set object heads, so sets can share the table index.
+ *
+ * \param table Table holding the hashed objects
+ * \param map Hash map to probe
+ * \param set Object set filtering the hits, or NULL for any object
+ * \param id Key value, a string or an int
+ * \param offset Offset of the key field in each object
+ * \param ctype C type of the key field
+ * \param object Output object on a hit
+ * \return 1 on a hit, 0 on a miss or -EINVAL for an unsupported type
+ */
+int hash_get_object(const struct adb_table *table, const struct hash_map *map,
+					const struct adb_object_set *set, const void *id,
+					int offset, adb_ctype ctype,
+					const struct adb_object **object);
+
 #endif
 
 #endif
@@ -23,8 +23,10 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "libastrodb/db.h"
+#include "libastrodb/db-import.h"
 #include "private.h"
 
 /*! \defgroup htm HTM
@@ -42,6 +44,11 @@
 #define HTM_HEMI_NORTH 0
 #define HTM_HEMI_SOUTH 1
 
+/* trixel visibility within a clipping cone */
+#define HTM_VISIBLE_NONE 0
+#define HTM_VISIBLE_PARTIAL 1
+#define HTM_VISIBLE_FULL 2
+
 #define HTM_MAX_TABLES 8
 
 #define TRIXEL_UP 0
@@ -55,6 +62,10 @@
 
 #define HTM_MAX_DEPTH 12
 
+/* clip covers kept for reuse and largest cover worth keeping */
+#define HTM_COVER_CACHE_SIZE 16
+#define HTM_COVER_MAX_TRIXELS 16384
+
 /*
  * Pixel ID is 32 bit filed as follows :-
  *  31....24  23....16  15.....8  7......0
@@ -79,8 +90,9 @@
 
 #define htm_trixel_position(id, depth) ((id >> (depth << 1)) & HTM_ID_POS_MASK)
 
-#define htm_for_each_trixel_object(trixel, table_id, object) \
-	for (object = trixel->data[table_id].objects; object; object = object->next)
+#define htm_for_each_trixel_object(trixel, table_id, object)    \
+	for (object = htm_trixel_objects(trixel, table_id); object; \
+		 object = object->next)
 
 #define htm_for_each_clipped_trixel(htm, trixel) \
 	for (trixel = htm->clitrixels[0]; trixel != NULL; trixel++)
@@ -128,7 +140,7 @@ struct htm_trixel {
 	struct htm_trixel *parent; /*!< parent trixel link */
 	struct htm_trixel *child; /*!< base array to 4 child trixels */
 
-	struct htm_trixel_data data[ADB_MAX_TABLES]; /*!< object data */
+	struct htm_trixel_data *data; /*!< object data, NULL until inserted */
 
 	/* flags */
 	unsigned int visible : 2; /*!< visible in query - partial or full */
@@ -164,6 +176,24 @@ struct htm_depth_map {
 	int object_count[ADB_MAX_TABLES]; /*!< Count of objects per table */
 };
 
+/*! \struct htm_cover
+ * \brief Cached trixel list of a clip
+ * \ingroup htm
+ *
+ * The trixels gathered for a clip only depend on the home trixels of its
+ * centre and its depth limits.
+ */
+struct htm_cover {
+	unsigned int centre; /*!< centre trixel ID, 1 whole sky, 0 unused */
+	unsigned int boundary; /*!< boundary centre trixel ID or 0 */
+	float fov; /*!< clip fov radius */
+	int min_depth; /*!< clip min depth */
+	int max_depth; /*!< clip max depth */
+	unsigned long used; /*!< last use for LRU replacement */
+	int count; /*!< number of trixels */
+	struct htm_trixel **trixels; /*!< trixels of the clip */
+};
+
 /*! \struct htm
  * \brief Main Hierarchical Triangular Mesh context
  * \ingroup htm
@@ -173,6 +203,14 @@ struct htm {
 	struct htm_trixel N[4]; /*!< Northern hemisphere root trixels */
 	struct htm_trixel S[4]; /*!< Southern hemisphere root trixels */
 	int depth; /*!< Maximum HTM depth */
+	int sparse; /*!< trixels are created when objects are inserted */
+
+	/* clip cover cache */
+	struct htm_cover cover[HTM_COVER_CACHE_SIZE]; /*!< LRU clip covers */
+	unsigned long cover_use; /*!< cover use counter */
+	unsigned long cover_hits; /*!< clips served from the cache */
+	unsigned long cover_misses; /*!< clips gathered from the mesh */
+	pthread_mutex_t cover_lock; /*!< serialises concurrent clips */
 
 	/* domain */
 	double dec_step;
@@ -193,9 +231,107 @@ struct htm {
  * \ingroup htm
  * \param depth Maximum depth for this HTM mesh
  * \param tables Maximum number of tables to support
+ * \param mesh Build every trixel now or only when objects are inserted
  * \return pointer to new htm context, or NULL on failure
  */
-struct htm *htm_new(int depth, int tables);
+struct htm *htm_new(int depth, int tables, enum adb_mesh mesh);
+
+/**
+ * \brief Create the four children of a sparse mesh trixel.
+ * \ingroup htm
+ *
+ * Does nothing if the children exist or the trixel is at the mesh depth.
+ *
+ * \param htm The HTM context
+ * \param t Trixel to split
+ */
+void htm_trixel_create_children(struct htm *htm, struct htm_trixel *t);
+
+/**
+ * \brief Allocate the per table object data of a trixel.
+ * \ingroup htm
+ * \param t Trixel about to receive objects
+ * \return 0 on success or -ENOMEM
+ */
+int htm_trixel_alloc_data(struct htm_trixel *t);
+
+/**
+ * \brief Get the objects of a table in a trixel.
+ * \ingroup htm
+ * \param t Trixel
+ * \param table_id Table ID
+ * \return First object or NULL
+ */
+static inline struct adb_object *htm_trixel_objects(const struct htm_trixel *t,
+													int table_id)
+{
+	return t->data ? t->data[table_id].objects : NULL;
+}
+
+/**
+ * \brief Get the number of objects of a table in a trixel.
+ * \ingroup htm
+ * \param t Trixel
+ * \param table_id Table ID
+ * \return Object count
+ */
+static inline int htm_trixel_num_objects(const struct htm_trixel *t,
+										 int table_id)
+{
+	return t->data ? t->data[table_id].num_objects : 0;
+}
+
+/**
+ * \brief Get the number of passes over the mesh for a table file layout.
+ * \ingroup htm
+ *
+ * Imports store objects and build KD trees in table file order by walking
+ * the mesh subtrees once for each pass.
+ *
+ * \param htm HTM
+ * \param layout enum adb_table_layout
+ * \return Number of passes
+ */
+static inline int htm_layout_passes(const struct htm *htm, int layout)
+{
+	return layout == ADB_TABLE_LAYOUT_DEPTH ? htm->depth + 1 : 1;
+}
+
+/**
+ * \brief Get the trixel depth a pass over the mesh walks.
+ * \ingroup htm
+ * \param layout enum adb_table_layout
+ * \param pass Pass number
+ * \return Depth, or -1 for every depth
+ */
+static inline int htm_layout_depth(int layout, int pass)
+{
+	return layout == ADB_TABLE_LAYOUT_DEPTH ? pass : -1;
+}
+
+/**
+ * \brief Check if a pass over the mesh takes the objects of a trixel.
+ * \ingroup htm
+ * \param t Trixel
+ * \param depth Pass depth from htm_layout_depth()
+ * \return Non zero if the trixel objects are taken
+ */
+static inline int htm_layout_takes(const struct htm_trixel *t, int depth)
+{
+	return depth < 0 || t->depth == depth;
+}
+
+/**
+ * \brief Check if a pass over the mesh walks the children of a trixel.
+ * \ingroup htm
+ * \param t Trixel
+ * \param depth Pass depth from htm_layout_depth()
+ * \return Non zero if the children are walked
+ */
+static inline int htm_layout_descends(const struct htm_trixel *t, int depth)
+{
+	return t->child && (depth < 0 || t->depth < depth);
+}
 
 /**
  * \brief free HTM and resources
@@ -228,6 +364,15 @@ int htm_clip(struct htm *htm, struct adb_object_set *set, double ra, double dec,
  */
 int htm_get_trixels(struct htm *htm, struct adb_object_set *set);
 
+/**
+ * \brief Get the clipped objects of several tables in one HTM traversal
+ * \ingroup htm
+ * \param sets Object sets of different tables clipped by the same cone
+ * \param count Number of object sets
+ * \return Number of object heads in all the sets, or negative error code
+ */
+int htm_get_clipped_multi(struct adb_object_set *sets[], int count);
+
 /**
  * \brief Find the minimum required HTM depth to represent a specific resolution
  * \ingroup htm
@@ -270,10 +415,25 @@ int htm_get_depth_from_magnitude(struct htm *htm, double mag);
  * \param point HTM vertex representing RA/DEC
  * \param depth Constraints target search bounding depth
  * \return Trixel containing the point, or NULL
+ *
+ * Sparse meshes return the deepest created trixel above depth.
  */
 struct htm_trixel *htm_get_home_trixel(struct htm *htm,
 									   struct htm_vertex *point, int depth);
 
+/**
+ * \brief Retrieve the trixel a point is inserted into
+ * \ingroup htm
+ * \param htm HTM context
+ * \param point HTM vertex representing RA/DEC
+ * \param depth Insert depth
+ * \return Trixel at depth with object data allocated, or NULL
+ *
+ * Sparse meshes create the trixels down to depth.
+ */
+struct htm_trixel *htm_new_home_trixel(struct htm *htm,
+									   struct htm_vertex *point, int depth);
+
 /**
  * \brief Retrieve all trixels encapsulating a specific spatial point
  * \ingroup htm
@@ -306,9 +466,38 @@ int htm_get_object_depth(struct htm *htm, double value);
  * \param htm HTM context
  * \param id Binary encoded ID for the target trixel
  * \return Found trixel or NULL
+ *
+ * Sparse meshes return the deepest created ancestor of the trixel. The
+ * mesh is not written, so lookups may run from several threads.
  */
 struct htm_trixel *htm_get_trixel(struct htm *htm, unsigned int id);
 
+/**
+ * \brief Fetch the trixel with an ID ready to take objects
+ * \ingroup htm
+ * \param htm HTM context
+ * \param id Binary encoded ID for the target trixel
+ * \return Trixel with object data allocated, or NULL
+ *
+ * Sparse meshes create the trixel and its ancestors.
+ */
+struct htm_trixel *htm_new_trixel(struct htm *htm, unsigned int id);
+
+/**
+ * \brief Compute the ID of the trixel holding a point
+ * \ingroup htm
+ * \param htm HTM context
+ * \param point HTM vertex representing RA/DEC, normalised on return
+ * \param depth Trixel depth
+ * \return Trixel ID, or 0 for an invalid point
+ *
+ * Descends from the root trixels by edge midpoints without reading or
+ * writing the mesh below the roots, so it is safe to call from several
+ * threads and works for trixels a sparse mesh has not created.
+ */
+unsigned int htm_get_home_id(struct htm *htm, struct htm_vertex *point,
+							 int depth);
+
 /**
  * \brief Insert an astronomical object record directly into the mesh structure
  * \ingroup htm
@@ -404,7 +593,7 @@ static inline void htm_vertex_update_unit(struct htm_vertex *v)
 					  "H:%s Q:%d D:%d P:%x objects %d\n",               \
 					  trixel->hemisphere ? "S" : "N", trixel->quadrant, \
 					  trixel->depth, trixel->position,                  \
-					  trixel->data[idx].num_objects);                   \
+					  htm_trixel_num_objects(trixel, idx));             \
 	}
 
 #endif /* TABLE_HTM_H_ */
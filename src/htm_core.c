@@ -66,10 +66,13 @@ static const double htm_resolution[] = {
  * \param id The target trixel ID being searched for.
  * \param t The current parent trixel pointer at the active depth.
  * \param depth The current recursion depth.
- * \return Pointer to the matched trixel, or the deepest found node if target depth exceeds bounds.
+ * \param create Create missing sparse mesh children on the way down.
+ * \return Pointer to the matched trixel, or the deepest created trixel of a
+ * sparse mesh.
  */
 static struct htm_trixel *trixel_get_from_id_(struct htm *htm, unsigned int id,
-											  struct htm_trixel *t, int depth)
+											  struct htm_trixel *t, int depth,
+											  int create)
 {
 	int pos;
 
@@ -79,9 +82,15 @@ static struct htm_trixel *trixel_get_from_id_(struct htm *htm, unsigned int id,
 	if (depth >= HTM_MAX_DEPTH)
 		return NULL;
 
+	/* sparse meshes stop at the deepest trixel unless inserting */
+	if (!t->child && create)
+		htm_trixel_create_children(htm, t);
+	if (!t->child)
+		return t;
+
 	pos = htm_trixel_position(id, depth);
 
-	return trixel_get_from_id_(htm, id, &t->child[pos], depth);
+	return trixel_get_from_id_(htm, id, &t->child[pos], depth, create);
 }
 
 /**
@@ -98,10 +107,42 @@ struct htm_trixel *htm_get_trixel(struct htm *htm, unsigned int id)
 {
 	int quad = htm_trixel_quadrant(id);
 
+	if (htm_trixel_depth(id) > htm->depth)
+		return NULL;
+
+	if (htm_trixel_north(id))
+		return trixel_get_from_id_(htm, id, &htm->N[quad], 0, 0);
+	else
+		return trixel_get_from_id_(htm, id, &htm->S[quad], 0, 0);
+}
+
+/**
+ * \brief Retrieve the HTM trixel with an ID ready to take objects.
+ *
+ * Creates the trixel and its ancestors in sparse meshes and allocates the
+ * trixel object data.
+ *
+ * \param htm The initialized HTM spatial index context.
+ * \param id The bitwise encoded ID of the trixel.
+ * \return Pointer to the trixel, or NULL if invalid or out of memory.
+ */
+struct htm_trixel *htm_new_trixel(struct htm *htm, unsigned int id)
+{
+	struct htm_trixel *t;
+	int quad = htm_trixel_quadrant(id);
+
+	if (htm_trixel_depth(id) > htm->depth)
+		return NULL;
+
 	if (htm_trixel_north(id))
-		return trixel_get_from_id_(htm, id, &htm->N[quad], 0);
+		t = trixel_get_from_id_(htm, id, &htm->N[quad], 0, 1);
 	else
-		return trixel_get_from_id_(htm, id, &htm->S[quad], 0);
+		t = trixel_get_from_id_(htm, id, &htm->S[quad], 0, 1);
+
+	if (t == NULL || htm_trixel_alloc_data(t) < 0)
+		return NULL;
+
+	return t;
 }
 
 /**
@@ -149,7 +190,13 @@ static int dec_strip_init(struct htm *htm)
 		dec_strip->half_size = num_ra_steps / 2;
 		dec_strip->vertex_count = num_ra_steps;
 
-		dec_strip->vertex = calloc(num_ra_steps, sizeof(struct htm_vertex));
+		/* sparse meshes allocate strips when a vertex is created */
+		if (!htm->sparse) {
+			dec_strip->vertex =
+				calloc(num_ra_steps, sizeof(struct htm_vertex));
+			if (dec_strip->vertex == NULL)
+				return -ENOMEM;
+		}
 		dec_strip++;
 	}
 	return 0;
@@ -164,6 +211,8 @@ static void free_trixel(struct htm_trixel *t)
 {
 	struct htm_trixel *child = t->child;
 
+	free(t->data);
+
 	if (child) {
 		free_trixel(&child[0]);
 		free_trixel(&child[1]);
@@ -187,8 +236,8 @@ void htm_free(struct htm *htm)
 	int i, j;
 
 	/* free verticies and trixel maps */
-	for (i = 0; i < htm->dec_strip_count; i++) {
-		for (j = 0; j < dec_strip->vertex_count; j++) {
+	for (i = 0; dec_strip && i < htm->dec_strip_count; i++) {
+		for (j = 0; dec_strip->vertex && j < dec_strip->vertex_count; j++) {
 			v = dec_strip->vertex + j;
 			free(v->trixel);
 		}
@@ -206,6 +255,15 @@ void htm_free(struct htm *htm)
 	free_trixel(&htm->S[2]);
 	free_trixel(&htm->S[3]);
 
+	/* free clip covers */
+	for (i = 0; i < HTM_COVER_CACHE_SIZE; i++)
+		free(htm->cover[i].trixels);
+
+	adb_htm_debug(htm, ADB_LOG_HTM_GET,
+				  "clip cover cache hits %lu misses %lu\n", htm->cover_hits,
+				  htm->cover_misses);
+
+	pthread_mutex_destroy(&htm->cover_lock);
 	free(htm->dec);
 	free(htm);
 }
@@ -288,6 +346,12 @@ struct htm_vertex *vertex_get(struct htm *htm, int level, double x, double y,
 			x_pos += dec_strip->half_size; /* neg Z values */
 	}
 
+	if (dec_strip->vertex == NULL) {
+		dec_strip->vertex =
+			calloc(dec_strip->vertex_count, sizeof(struct htm_vertex));
+		assert(dec_strip->vertex);
+	}
+
 	/* get vertex */
 	v = dec_strip->vertex + x_pos;
 	if (v->trixel)
@@ -756,6 +820,48 @@ static void trixel_create_down(struct htm *htm, struct htm_trixel *parent,
 	trixel_create_down(htm, &child[3], depth, level, hemisphere);
 }
 
+/**
+ * \brief Create the four children of a sparse mesh trixel.
+ *
+ * Cached clip covers are dropped as they do not hold the new trixels.
+ *
+ * \param htm Parent spatial engine.
+ * \param t The trixel to split.
+ */
+void htm_trixel_create_children(struct htm *htm, struct htm_trixel *t)
+{
+	int i;
+
+	if (t->child || t->depth >= htm->depth)
+		return;
+
+	if (t->orientation == TRIXEL_UP)
+		trixel_create_up(htm, t, t->depth + 1, t->depth, t->hemisphere);
+	else
+		trixel_create_down(htm, t, t->depth + 1, t->depth, t->hemisphere);
+
+	for (i = 0; i < HTM_COVER_CACHE_SIZE; i++)
+		htm->cover[i].centre = 0;
+}
+
+/**
+ * \brief Allocate the per table object data of a trixel.
+ *
+ * \param t The trixel about to receive objects.
+ * \return 0 on success or -ENOMEM.
+ */
+int htm_trixel_alloc_data(struct htm_trixel *t)
+{
+	if (t->data)
+		return 0;
+
+	t->data = calloc(ADB_MAX_TABLES, sizeof(struct htm_trixel_data));
+	if (t->data == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
 /*! \struct polyhedron
  * \brief polyhedron
  * \ingroup htm
@@ -780,21 +886,31 @@ static struct polyhedron poly[] = {
  *
  * \param depth The targeted subdivisional limits guiding grid granularity.
  * \param tables Unused legacy compatibility argument.
+ * \param mesh ADB_MESH_SPARSE only creates the root trixels.
  * \return Allocates and returns an internally initialized structure tracking HTM trees.
  */
-struct htm *htm_new(int depth, int tables)
+struct htm *htm_new(int depth, int tables, enum adb_mesh mesh)
 {
 	struct htm *htm;
 	struct htm_trixel *t;
+	int mesh_depth;
 
 	htm = calloc(1, sizeof(struct htm));
 	if (htm == NULL)
 		return NULL;
 	htm->depth = depth;
+	htm->sparse = mesh == ADB_MESH_SPARSE;
 	htm->trixel_count = 8;
+	pthread_mutex_init(&htm->cover_lock, NULL);
 
 	/* create and init DEC domain */
-	dec_strip_init(htm);
+	if (dec_strip_init(htm) < 0) {
+		htm_free(htm);
+		return NULL;
+	}
+
+	/* sparse meshes create children when objects are inserted */
+	mesh_depth = htm->sparse ? 0 : depth;
 
 	/* create northern hemisphere trixels and verticies */
 	t = &htm->N[0];
@@ -807,7 +923,7 @@ struct htm *htm_new(int depth, int tables)
 	t->position = 0;
 	t->depth = 0;
 	trixel_0_parent_up(htm, t, t->a, t->b, t->c, 0);
-	trixel_create_up(htm, &htm->N[0], depth, 0, HEMI_NORTH);
+	trixel_create_up(htm, &htm->N[0], mesh_depth, 0, HEMI_NORTH);
 
 	t = &htm->N[1];
 	t->a = vertex_get(htm, 0, poly[0].x, poly[0].y, poly[0].z);
@@ -819,7 +935,7 @@ struct htm *htm_new(int depth, int tables)
 	t->position = 0;
 	t->depth = 0;
 	trixel_0_parent_up(htm, t, t->a, t->b, t->c, 0);
-	trixel_create_up(htm, &htm->N[1], depth, 0, HEMI_NORTH);
+	trixel_create_up(htm, &htm->N[1], mesh_depth, 0, HEMI_NORTH);
 
 	t = &htm->N[2];
 	t->a = vertex_get(htm, 0, poly[0].x, poly[0].y, poly[0].z);
@@ -831,7 +947,7 @@ struct htm *htm_new(int depth, int tables)
 	t->position = 0;
 	t->depth = 0;
 	trixel_0_parent_up(htm, t, t->a, t->b, t->c, 0);
-	trixel_create_up(htm, &htm->N[2], depth, 0, HEMI_NORTH);
+	trixel_create_up(htm, &htm->N[2], mesh_depth, 0, HEMI_NORTH);
 
 	t = &htm->N[3];
 	t->a = vertex_get(htm, 0, poly[0].x, poly[0].y, poly[0].z);
@@ -843,7 +959,7 @@ struct htm *htm_new(int depth, int tables)
 	t->position = 0;
 	t->depth = 0;
 	trixel_0_parent_up(htm, t, t->a, t->b, t->c, 0);
-	trixel_create_up(htm, &htm->N[3], depth, 0, HEMI_NORTH);
+	trixel_create_up(htm, &htm->N[3], mesh_depth, 0, HEMI_NORTH);
 
 	/* create southern hemisphere trixels and verticies */
 	t = &htm->S[0];
@@ -856,7 +972,7 @@ struct htm *htm_new(int depth, int tables)
 	t->position = 0;
 	t->depth = 0;
 	trixel_0_parent_down(htm, t, t->a, t->b, t->c, 0);
-	trixel_create_down(htm, &htm->S[0], depth, 0, HEMI_SOUTH);
+	trixel_create_down(htm, &htm->S[0], mesh_depth, 0, HEMI_SOUTH);
 
 	t = &htm->S[1];
 	t->a = vertex_get(htm, 0, poly[5].x, poly[5].y, poly[5].z);
@@ -868,7 +984,7 @@ struct htm *htm_new(int depth, int tables)
 	t->position = 0;
 	t->depth = 0;
 	trixel_0_parent_down(htm, t, t->a, t->b, t->c, 0);
-	trixel_create_down(htm, &htm->S[1], depth, 0, HEMI_SOUTH);
+	trixel_create_down(htm, &htm->S[1], mesh_depth, 0, HEMI_SOUTH);
 
 	t = &htm->S[2];
 	t->a = vertex_get(htm, 0, poly[5].x, poly[5].y, poly[5].z);
@@ -880,7 +996,7 @@ struct htm *htm_new(int depth, int tables)
 	t->position = 0;
 	t->depth = 0;
 	trixel_0_parent_down(htm, t, t->a, t->b, t->c, 0);
-	trixel_create_down(htm, &htm->S[2], depth, 0, HEMI_SOUTH);
+	trixel_create_down(htm, &htm->S[2], mesh_depth, 0, HEMI_SOUTH);
 
 	t = &htm->S[3];
 	t->a = vertex_get(htm, 0, poly[5].x, poly[5].y, poly[5].z);
@@ -892,7 +1008,7 @@ struct htm *htm_new(int depth, int tables)
 	t->position = 0;
 	t->depth = 0;
 	trixel_0_parent_down(htm, t, t->a, t->b, t->c, 0);
-	trixel_create_down(htm, &htm->S[3], depth, 0, HEMI_SOUTH);
+	trixel_create_down(htm, &htm->S[3], mesh_depth, 0, HEMI_SOUTH);
 
 	adb_htm_info(htm, ADB_LOG_HTM_CORE, "HTM: depth %d\n", htm->depth);
 	adb_htm_info(htm, ADB_LOG_HTM_CORE,
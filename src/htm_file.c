@@ -18,18 +18,22 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "alloc.h"
 #include "debug.h"
 #include "htm.h"
 #include "table.h"
 #include "libastrodb/db.h"
+#include "libastrodb/db-import.h"
 #include "libastrodb/object.h"
 
 /*! \struct trixel_hdr
@@ -41,6 +45,247 @@ struct trixel_hdr {
 	u_int32_t num_objects; /*!< number of objects */
 } __attribute__((packed));
 
+/* "ADBT" - HTM ID valid bit is clear so legacy streams can be detected */
+#define ADB_TABLE_FILE_MAGIC 0x41444254
+#define ADB_TABLE_FILE_VERSION 2
+/* version 1 files have no encoding and always hold raw objects */
+#define ADB_TABLE_FILE_VERSION_RAW 1
+/* version 3 files end with trixel aggregates and their trailer */
+#define ADB_TABLE_FILE_VERSION_AGGREGATE 3
+/* "ADBA" */
+#define ADB_TABLE_AGGREGATE_MAGIC 0x41444241
+
+/* compact fixed point scales, positions to 0.15 mas and magnitudes to mmag */
+#define COMPACT_RA_SCALE (4294967296.0 / (2.0 * M_PI))
+#define COMPACT_DEC_SCALE (4294967295.0 / M_PI)
+#define COMPACT_MAG_SCALE 1000.0f
+#define COMPACT_MAG_MAX 32.767f
+#define COMPACT_MAG_NAN INT16_MIN
+
+/*! \struct table_file_hdr
+ * \brief table file header
+ * \ingroup htm
+ *
+ * The header is followed by the trixel directory and then by all the table
+ * objects stored contiguously in HTM (and therefore KD tree index) order.
+ * Compact objects are followed by the designation string pool.
+ */
+struct table_file_hdr {
+	u_int32_t magic; /*!< ADB_TABLE_FILE_MAGIC */
+	u_int32_t version; /*!< ADB_TABLE_FILE_VERSION */
+	u_int32_t trixel_count; /*!< number of trixel directory entries */
+	u_int32_t object_bytes; /*!< size of each object in memory */
+	u_int32_t object_count; /*!< number of objects */
+	u_int32_t encoding; /*!< enum adb_table_encoding of the objects */
+	u_int64_t data_offset; /*!< file offset of first object */
+} __attribute__((packed));
+
+/*! \struct compact_object
+ * \brief compact table file object
+ * \ingroup htm
+ *
+ * Replaces the struct adb_object part of an object, the rest of the object
+ * follows unchanged. The designation bytes up to the last non zero byte are
+ * in the string pool.
+ */
+struct compact_object {
+	u_int32_t ra; /*!< RA fixed point over 0 to 2 pi */
+	u_int32_t dec; /*!< DEC fixed point over -pi/2 to pi/2 */
+	int16_t mag; /*!< magnitude in mmag or COMPACT_MAG_NAN */
+	u_int8_t name_len; /*!< designation bytes in the pool */
+	u_int8_t reserved;
+	float size; /*!< angular size */
+	u_int32_t name; /*!< designation offset in the pool */
+	struct adb_kd_tree kd; /*!< KD tree node */
+} __attribute__((packed));
+
+/*! \struct trixel_dir
+ * \brief trixel directory entry
+ * \ingroup htm
+ */
+struct trixel_dir {
+	u_int64_t offset; /*!< file offset of first trixel object */
+	u_int32_t id; /*!< trixel ID */
+	u_int32_t num_objects; /*!< number of objects */
+	u_int32_t depth; /*!< trixel depth */
+	u_int32_t layout; /*!< enum adb_table_layout of the writer */
+} __attribute__((packed));
+
+/*! \struct aggregate_trailer
+ * \brief trixel aggregate locator
+ * \ingroup htm
+ *
+ * Ends version 3 table files. The aggregates follow the objects and any
+ * compact designations, sorted by trixel ID.
+ */
+struct aggregate_trailer {
+	u_int64_t offset; /*!< file offset of the first aggregate */
+	u_int32_t count; /*!< number of aggregates */
+	u_int32_t magic; /*!< ADB_TABLE_AGGREGATE_MAGIC */
+} __attribute__((packed));
+
+/*! \struct aggregate_sum
+ * \brief running sums of the objects in and below a trixel
+ * \ingroup htm
+ */
+struct aggregate_sum {
+	unsigned int count; /*!< number of objects */
+	float brightest; /*!< brightest magnitude or NAN */
+	double flux; /*!< integrated flux */
+	double x, y, z; /*!< sum of object unit vectors */
+};
+
+/*! \struct aggregate_writer
+ * \brief trixel aggregates gathered for a table file
+ * \ingroup htm
+ */
+struct aggregate_writer {
+	struct adb_trixel_aggregate *aggregate; /*!< gathered aggregates */
+	unsigned int count; /*!< aggregates used */
+	unsigned int size; /*!< aggregates allocated */
+};
+
+/*! \struct table_lazy
+ * \brief lazily loaded table state
+ * \ingroup htm
+ *
+ * Objects for ADB_TABLE_LOAD_LAZY tables are read a trixel at a time on
+ * first use through the trixel directory.
+ */
+struct table_lazy {
+	int fd; /*!< table file */
+	u_int64_t data_offset; /*!< file offset of first object */
+	u_int64_t record_bytes; /*!< size of each object in the file */
+	u_int64_t pool_offset; /*!< file offset of compact designations */
+	u_int64_t pool_size; /*!< size of compact designations */
+	u_int32_t encoding; /*!< enum adb_table_encoding of the objects */
+	unsigned int trixel_count; /*!< number of trixel directory entries */
+	unsigned int loaded_count; /*!< number of trixels loaded */
+	unsigned char *loaded; /*!< loaded flag for each directory entry */
+	struct trixel_dir dir[]; /*!< trixel directory in file offset order */
+};
+
+/*! \struct trixel_writer
+ * \brief trixel file writer state
+ * \ingroup htm
+ */
+struct trixel_writer {
+	FILE *file; /*!< table file */
+	struct trixel_dir *dir; /*!< trixel directory */
+	unsigned int trixel_count; /*!< directory entries used */
+	u_int64_t offset; /*!< current file offset */
+	u_int64_t record_bytes; /*!< size of each object in the file */
+	u_int32_t encoding; /*!< enum adb_table_encoding of the objects */
+	void *record; /*!< compact object being written */
+	char *pool; /*!< compact designations */
+	size_t pool_bytes; /*!< pool bytes used */
+	size_t pool_size; /*!< pool bytes allocated */
+	int depth; /*!< layout pass depth, -1 for every depth */
+};
+
+/**
+ * \brief Get the size of each object in a table file.
+ *
+ * \param hdr Table file header with its object size and encoding.
+ * \return Object size in the file.
+ */
+static u_int64_t file_record_bytes(const struct table_file_hdr *hdr)
+{
+	if (hdr->encoding == ADB_TABLE_ENCODING_COMPACT)
+		return sizeof(struct compact_object) + hdr->object_bytes -
+			   sizeof(struct adb_object);
+	return hdr->object_bytes;
+}
+
+/**
+ * \brief Decode compact table file objects.
+ *
+ * \param table Table owning the objects.
+ * \param objects Decoded objects.
+ * \param records Compact objects read from the table file.
+ * \param count Number of objects.
+ * \param pool Designation pool bytes from pool offset base.
+ * \param base Pool offset of the first pool byte.
+ * \param size Number of pool bytes.
+ * \return 0 on success or -EINVAL if a designation is outside the pool.
+ */
+static int compact_decode(const struct adb_table *table, void *objects,
+						  const void *records, unsigned int count,
+						  const char *pool, u_int64_t base, u_int64_t size)
+{
+	size_t tail = table->object.bytes - sizeof(struct adb_object);
+	const struct compact_object *record;
+	struct adb_object *object;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		record = records + i * (sizeof(*record) + tail);
+		object = objects + (size_t)i * table->object.bytes;
+
+		if (record->name_len > ADB_OBJECT_NAME_SIZE || record->name < base ||
+			record->name - base + record->name_len > size)
+			return -EINVAL;
+
+		memset(object, 0, sizeof(*object));
+		memcpy(object->designation, pool + (record->name - base),
+			   record->name_len);
+		object->ra = record->ra / COMPACT_RA_SCALE;
+		object->dec = record->dec / COMPACT_DEC_SCALE - M_PI_2;
+		object->mag = record->mag == COMPACT_MAG_NAN ?
+						  NAN :
+						  record->mag / COMPACT_MAG_SCALE;
+		object->size = record->size;
+		memcpy(&object->kd, &record->kd, sizeof(object->kd));
+		memcpy(object + 1, record + 1, tail);
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Encode an object as a compact table file object.
+ *
+ * \param w Table file writer with a record and designation pool.
+ * \param object Object to encode, already checked by compact_check().
+ * \param tail Object bytes after the struct adb_object part.
+ * \return 0 on success or -ENOMEM.
+ */
+static int compact_encode(struct trixel_writer *w,
+						  const struct adb_object *object, size_t tail)
+{
+	struct compact_object *record = w->record;
+	int len = ADB_OBJECT_NAME_SIZE;
+	char *pool;
+
+	while (len > 0 && !object->designation[len - 1])
+		len--;
+
+	if (w->pool_bytes + len > w->pool_size) {
+		pool = realloc(w->pool, w->pool_size * 2 + ADB_OBJECT_NAME_SIZE);
+		if (pool == NULL)
+			return -ENOMEM;
+		w->pool = pool;
+		w->pool_size = w->pool_size * 2 + ADB_OBJECT_NAME_SIZE;
+	}
+
+	/* RA of 2 pi wraps to 0 */
+	record->ra = (u_int64_t)llround(object->ra * COMPACT_RA_SCALE);
+	record->dec = lround((object->dec + M_PI_2) * COMPACT_DEC_SCALE);
+	record->mag = isnan(object->mag) ?
+					  COMPACT_MAG_NAN :
+					  lroundf(object->mag * COMPACT_MAG_SCALE);
+	record->name_len = len;
+	record->reserved = 0;
+	record->size = object->size;
+	record->name = w->pool_bytes;
+	memcpy(&record->kd, &object->kd, sizeof(record->kd));
+	memcpy(record + 1, object + 1, tail);
+
+	memcpy(w->pool + w->pool_bytes, object->designation, len);
+	w->pool_bytes += len;
+	return 0;
+}
+
 /**
  * \brief Stream astronomical object block data for a specific trixel into memory.
  *
@@ -71,6 +316,9 @@ static int read_trixel(struct adb_db *db, struct adb_table *table,
 /**
  * \brief Sequentially stream all trixel headers and their attached object frames from disk.
  *
+ * Used for legacy table files where each trixel header is directly followed
+ * by its objects.
+ *
  * \param db Active database connection context.
  * \param table Catalog table owning the data mapping logic.
  * \param objects Output buffer block large enough to contain all rows.
@@ -115,50 +363,762 @@ static int read_trixels(struct adb_db *db, struct adb_table *table,
 	return count;
 }
 
+/**
+ * \brief Insert all trixels from a table file directory into the HTM.
+ *
+ * \param db Active database connection context.
+ * \param table Catalog table owning the data mapping logic.
+ * \param hdr Validated table file header.
+ * \param dir Trixel directory with hdr->trixel_count entries.
+ * \param objects Table objects, in the order they are in the file.
+ * \return The total count of inserted objects or a negative error code.
+ */
+static int insert_trixel_dir(struct adb_db *db, struct adb_table *table,
+							 const struct table_file_hdr *hdr,
+							 const struct trixel_dir *dir, void *objects)
+{
+	u_int64_t data_end, record_bytes = file_record_bytes(hdr), offset;
+	int i, ret, count = 0;
+
+	data_end = hdr->data_offset + hdr->object_count * record_bytes;
+
+	/* depth layout only when every entry was written depth first */
+	table->layout = hdr->trixel_count ? ADB_TABLE_LAYOUT_DEPTH :
+										ADB_TABLE_LAYOUT_TRIXEL;
+
+	for (i = 0; i < hdr->trixel_count; i++) {
+		adb_vdebug(db, ADB_LOG_HTM_FILE,
+				   "dir trixel %sQ%dD%dP%x with objs %d at %lu\n",
+				   htm_trixel_north(dir[i].id) ? "N" : "S",
+				   htm_trixel_quadrant(dir[i].id), dir[i].depth,
+				   htm_trixel_position(dir[i].id, dir[i].depth),
+				   dir[i].num_objects, (unsigned long)dir[i].offset);
+
+		if (!htm_trixel_valid(dir[i].id) ||
+			dir[i].depth != htm_trixel_depth(dir[i].id)) {
+			adb_error(db, "Error invalid trixel ID %x\n", dir[i].id);
+			return -EINVAL;
+		}
+
+		offset = dir[i].offset - hdr->data_offset;
+		if (dir[i].offset < hdr->data_offset || offset % record_bytes ||
+			dir[i].offset + dir[i].num_objects * record_bytes > data_end) {
+			adb_error(db, "Error trixel %x objects outside table data\n",
+					  dir[i].id);
+			return -EINVAL;
+		}
+
+		ret = htm_table_insert_object(
+			db->htm, table,
+			objects + offset / record_bytes * table->object.bytes,
+			dir[i].num_objects, dir[i].id);
+		if (ret < 0)
+			return ret;
+
+		count += dir[i].num_objects;
+		table->depth_count[dir[i].depth] += dir[i].num_objects;
+		if (dir[i].layout != ADB_TABLE_LAYOUT_DEPTH)
+			table->layout = ADB_TABLE_LAYOUT_TRIXEL;
+	}
+
+	return count;
+}
+
+/**
+ * \brief Validate a table file header against the table schema.
+ *
+ * \param db Active database connection context.
+ * \param table Catalog table with its schema loaded.
+ * \param hdr Table file header to check.
+ * \param size Table file size in bytes.
+ * \return 0 if the header is valid or -EINVAL.
+ */
+static int check_file_hdr(struct adb_db *db, struct adb_table *table,
+						  const struct table_file_hdr *hdr, off_t size)
+{
+	u_int64_t dir_end, data_end;
+
+	if (hdr->version != ADB_TABLE_FILE_VERSION &&
+		hdr->version != ADB_TABLE_FILE_VERSION_RAW &&
+		hdr->version != ADB_TABLE_FILE_VERSION_AGGREGATE) {
+		adb_error(db, "Error table file is version %d need %d\n", hdr->version,
+				  ADB_TABLE_FILE_VERSION);
+		return -EINVAL;
+	}
+
+	if (hdr->encoding > ADB_TABLE_ENCODING_COMPACT ||
+		(hdr->encoding == ADB_TABLE_ENCODING_COMPACT &&
+		 (hdr->version == ADB_TABLE_FILE_VERSION_RAW ||
+		  hdr->object_bytes < sizeof(struct adb_object)))) {
+		adb_error(db, "Error table file has unknown encoding %d\n",
+				  hdr->encoding);
+		return -EINVAL;
+	}
+
+	if (hdr->object_bytes != table->object.bytes ||
+		hdr->object_count != table->object.count) {
+		adb_error(db, "Error table file has %d objects of %d bytes, "
+				  "schema has %d objects of %d bytes\n",
+				  hdr->object_count, hdr->object_bytes, table->object.count,
+				  table->object.bytes);
+		return -EINVAL;
+	}
+
+	dir_end = sizeof(*hdr) +
+			  (u_int64_t)hdr->trixel_count * sizeof(struct trixel_dir);
+	data_end = hdr->data_offset + hdr->object_count * file_record_bytes(hdr);
+
+	if (hdr->data_offset < dir_end || data_end > (u_int64_t)size) {
+		adb_error(db, "Error table file is truncated\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Read the trixel aggregates ending a version 3 table file.
+ *
+ * \param db Active database connection context.
+ * \param table Catalog table receiving the aggregates.
+ * \param f Table file, positioned after the header on return.
+ * \param size Table file size, set to the end of the objects on return.
+ * \return 0 on success or a negative error code.
+ */
+static int read_aggregates(struct adb_db *db, struct adb_table *table, FILE *f,
+						   off_t *size)
+{
+	struct aggregate_trailer trailer;
+	struct adb_trixel_aggregate *aggregates;
+	off_t end = *size - (off_t)sizeof(trailer);
+
+	if (end < (off_t)sizeof(struct table_file_hdr) ||
+		fseeko(f, end, SEEK_SET) < 0 ||
+		fread(&trailer, sizeof(trailer), 1, f) != 1 ||
+		trailer.magic != ADB_TABLE_AGGREGATE_MAGIC ||
+		trailer.offset > (u_int64_t)end ||
+		(u_int64_t)end - trailer.offset !=
+			(u_int64_t)trailer.count * sizeof(*aggregates)) {
+		adb_error(db, "Error table file aggregates are corrupt\n");
+		return -EINVAL;
+	}
+
+	aggregates = malloc(trailer.count ? trailer.count * sizeof(*aggregates) :
+										1);
+	if (aggregates == NULL)
+		return -ENOMEM;
+
+	if (fseeko(f, trailer.offset, SEEK_SET) < 0 ||
+		fread(aggregates, sizeof(*aggregates), trailer.count, f) !=
+			trailer.count ||
+		fseeko(f, sizeof(struct table_file_hdr), SEEK_SET) < 0) {
+		adb_error(db, "Error failed to read table file aggregates\n");
+		free(aggregates);
+		return -EIO;
+	}
+
+	adb_info(db, ADB_LOG_HTM_FILE, "Read %d trixel aggregates\n",
+			 trailer.count);
+	table->aggregates = aggregates;
+	table->aggregate_count = trailer.count;
+	*size = trailer.offset;
+	return 0;
+}
+
+/**
+ * \brief Read table objects into a private heap buffer.
+ *
+ * Reads the trixel directory and then all objects with a single read.
+ *
+ * \param db Active database connection context.
+ * \param table Catalog table with its schema loaded.
+ * \param f Table file positioned after the header.
+ * \param hdr Validated table file header.
+ * \return The total count of loaded objects or a negative error code.
+ */
+static int read_table_copy(struct adb_db *db, struct adb_table *table, FILE *f,
+						   const struct table_file_hdr *hdr)
+{
+	struct trixel_dir *dir;
+	void *objects;
+	size_t size, mapped;
+	int count;
+
+	dir = calloc(hdr->trixel_count, sizeof(*dir));
+	if (dir == NULL)
+		return -ENOMEM;
+
+	objects = alloc_large(db, (size_t)table->object.count * table->object.bytes,
+						  &mapped);
+	if (objects == NULL) {
+		free(dir);
+		return -ENOMEM;
+	}
+
+	size = fread(dir, sizeof(*dir), hdr->trixel_count, f);
+	if (size != hdr->trixel_count) {
+		adb_error(db, "read %d trixels expected %d\n", size, hdr->trixel_count);
+		count = -EIO;
+		goto out;
+	}
+
+	if (fseeko(f, hdr->data_offset, SEEK_SET) < 0) {
+		count = -errno;
+		goto out;
+	}
+
+	size = fread(objects, table->object.bytes, table->object.count, f);
+	if (size != table->object.count) {
+		adb_error(db, "read %d objects expected %d\n", size,
+				  table->object.count);
+		count = -EIO;
+		goto out;
+	}
+
+	count = insert_trixel_dir(db, table, hdr, dir, objects);
+
+out:
+	free(dir);
+	if (count < 0) {
+		alloc_free_large(objects, mapped);
+	} else {
+		table->objects = objects;
+		table->objects_mapped = mapped;
+	}
+	return count;
+}
+
+/**
+ * \brief Prepare a table for lazy loading of its objects.
+ *
+ * Only the trixel directory is read. The object buffer is allocated but its
+ * pages are untouched until a trixel is referenced by a clip or the whole
+ * table is needed by a table wide KD tree or hash operation.
+ *
+ * \param db Active database connection context.
+ * \param table Catalog table with its schema loaded.
+ * \param f Table file positioned after the header.
+ * \param hdr Validated table file header.
+ * \param size Table file size in bytes.
+ * \return The total count of objects in the table or a negative error code.
+ */
+static int read_table_lazy(struct adb_db *db, struct adb_table *table, FILE *f,
+						   const struct table_file_hdr *hdr, off_t size)
+{
+	struct table_lazy *lazy;
+	void *objects;
+	size_t read, mapped;
+	int count;
+
+	lazy = calloc(1, sizeof(*lazy) + hdr->trixel_count * sizeof(lazy->dir[0]) +
+						 hdr->trixel_count);
+	if (lazy == NULL)
+		return -ENOMEM;
+
+	objects = alloc_large(db, (size_t)table->object.count * table->object.bytes,
+						  &mapped);
+	if (objects == NULL) {
+		free(lazy);
+		return -ENOMEM;
+	}
+
+	read = fread(lazy->dir, sizeof(lazy->dir[0]), hdr->trixel_count, f);
+	if (read != hdr->trixel_count) {
+		adb_error(db, "read %d trixels expected %d\n", read, hdr->trixel_count);
+		count = -EIO;
+		goto err;
+	}
+
+	count = insert_trixel_dir(db, table, hdr, lazy->dir, objects);
+	if (count < 0)
+		goto err;
+
+	lazy->fd = dup(fileno(f));
+	if (lazy->fd < 0) {
+		count = -errno;
+		goto err;
+	}
+
+	lazy->data_offset = hdr->data_offset;
+	lazy->record_bytes = file_record_bytes(hdr);
+	lazy->pool_offset = hdr->data_offset +
+						hdr->object_count * lazy->record_bytes;
+	lazy->pool_size = size - lazy->pool_offset;
+	lazy->encoding = hdr->encoding;
+	lazy->trixel_count = hdr->trixel_count;
+	lazy->loaded = (unsigned char *)&lazy->dir[hdr->trixel_count];
+
+	table->objects = objects;
+	table->objects_mapped = mapped;
+	table->lazy = lazy;
+	return count;
+
+err:
+	alloc_free_large(objects, mapped);
+	free(lazy);
+	return count;
+}
+
+/**
+ * \brief Read and decode the compact objects of a trixel directory entry.
+ *
+ * The trixel designations are read from the part of the string pool they
+ * were written to.
+ *
+ * \param table Table with lazy state.
+ * \param dir Trixel directory entry.
+ * \param objects Decoded trixel objects.
+ * \return 0 on success or a negative error code.
+ */
+static int lazy_read_compact(struct adb_table *table,
+							 const struct trixel_dir *dir, void *objects)
+{
+	struct table_lazy *lazy = table->lazy;
+	size_t bytes = dir->num_objects * lazy->record_bytes;
+	const struct compact_object *record;
+	u_int64_t first = lazy->pool_size, last = 0;
+	char *records, *pool = NULL;
+	unsigned int i;
+	ssize_t size;
+	int ret = -EIO;
+
+	records = malloc(bytes ? bytes : 1);
+	if (records == NULL)
+		return -ENOMEM;
+
+	size = pread(lazy->fd, records, bytes, dir->offset);
+	if (size != bytes)
+		goto out;
+
+	for (i = 0; i < dir->num_objects; i++) {
+		record = (const void *)(records + i * lazy->record_bytes);
+		if (record->name < first)
+			first = record->name;
+		if (record->name + record->name_len > last)
+			last = record->name + record->name_len;
+	}
+	if (last < first)
+		last = first;
+
+	size = 0;
+	if (last > first && last <= lazy->pool_size) {
+		pool = malloc(last - first);
+		if (pool == NULL) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		size = pread(lazy->fd, pool, last - first, lazy->pool_offset + first);
+		if (size != last - first)
+			goto out;
+	}
+
+	/* does the bounds checks of the pool slice */
+	ret = compact_decode(table, objects, records, dir->num_objects, pool, first,
+						 size);
+
+out:
+	free(pool);
+	free(records);
+	return ret;
+}
+
+/**
+ * \brief Read the objects of a lazily loaded trixel directory entry.
+ *
+ * \param table Table with lazy state.
+ * \param idx Trixel directory index.
+ * \return 0 on success or a negative error code.
+ */
+static int lazy_read_dir(struct adb_table *table, unsigned int idx)
+{
+	struct table_lazy *lazy = table->lazy;
+	struct trixel_dir *dir = &lazy->dir[idx];
+	size_t bytes = (size_t)dir->num_objects * table->object.bytes;
+	void *objects = (void *)table->objects +
+					(dir->offset - lazy->data_offset) / lazy->record_bytes *
+						table->object.bytes;
+	ssize_t size;
+	int ret;
+
+	if (lazy->encoding == ADB_TABLE_ENCODING_COMPACT) {
+		ret = lazy_read_compact(table, dir, objects);
+		if (ret < 0) {
+			adb_error(table->db, "Error failed to read trixel %x %d\n",
+					  dir->id, ret);
+			return ret;
+		}
+		goto done;
+	}
+
+	size = pread(lazy->fd, objects, bytes, dir->offset);
+	if (size != bytes) {
+		adb_error(table->db, "Error failed to read trixel %x %d\n", dir->id,
+				  size < 0 ? -errno : -EIO);
+		return -EIO;
+	}
+
+done:
+	lazy->loaded[idx] = 1;
+	lazy->loaded_count++;
+	return 0;
+}
+
+/**
+ * \brief Make sure the objects of a trixel are loaded.
+ *
+ * Does nothing unless the table was opened with ADB_TABLE_LOAD_LAZY.
+ *
+ * \param table Table owning the trixel objects.
+ * \param trixel Trixel with objects for table.
+ * \return 0 on success or a negative error code.
+ */
+int table_load_trixel(struct adb_table *table, struct htm_trixel *trixel)
+{
+	struct table_lazy *lazy = table->lazy;
+	u_int64_t offset;
+	int low, high, mid;
+
+	if (lazy == NULL || htm_trixel_num_objects(trixel, table->id) == 0)
+		return 0;
+
+	offset = (u_int64_t)((void *)trixel->data[table->id].objects -
+						 (void *)table->objects) /
+				 table->object.bytes * lazy->record_bytes +
+			 lazy->data_offset;
+
+	/* directory is in file offset order */
+	low = 0;
+	high = lazy->trixel_count - 1;
+	while (low <= high) {
+		mid = (low + high) >> 1;
+
+		if (lazy->dir[mid].offset == offset) {
+			if (lazy->loaded[mid])
+				return 0;
+			return lazy_read_dir(table, mid);
+		}
+
+		if (lazy->dir[mid].offset < offset)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+
+	adb_error(table->db, "Error no directory entry for trixel objects\n");
+	return -EINVAL;
+}
+
+/**
+ * \brief Make sure all table objects are loaded.
+ *
+ * Table wide operations like KD tree searches and table hashing can touch any
+ * object. Lazy tables are fully read and then behave like copied tables.
+ *
+ * \param table Table to load.
+ * \return 0 on success or a negative error code.
+ */
+int table_load_all(struct adb_table *table)
+{
+	struct table_lazy *lazy = table->lazy;
+	unsigned int i;
+	int ret;
+
+	if (lazy == NULL)
+		return 0;
+
+	adb_info(table->db, ADB_LOG_HTM_FILE,
+			 "Loading remaining %d of %d trixels\n",
+			 lazy->trixel_count - lazy->loaded_count, lazy->trixel_count);
+
+	for (i = 0; i < lazy->trixel_count; i++) {
+		if (lazy->loaded[i])
+			continue;
+
+		ret = lazy_read_dir(table, i);
+		if (ret < 0)
+			return ret;
+	}
+
+	close(lazy->fd);
+	free(lazy);
+	table->lazy = NULL;
+	return 0;
+}
+
+/**
+ * \brief Map table objects read only and shared from the table file.
+ *
+ * Trixel object blocks point straight into the mapping so loading costs no
+ * copies and the page cache is shared by every process using the table.
+ *
+ * \param db Active database connection context.
+ * \param table Catalog table with its schema loaded.
+ * \param fd Table file descriptor.
+ * \param size Table file size in bytes.
+ * \return The total count of mapped objects or a negative error code.
+ */
+static int read_table_mmap(struct adb_db *db, struct adb_table *table, int fd,
+						   off_t size)
+{
+	const struct table_file_hdr *hdr;
+	void *map;
+	int count;
+
+	map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		adb_error(db, "Error failed to map table file %d\n", -errno);
+		return -errno;
+	}
+
+	hdr = map;
+	count = insert_trixel_dir(db, table, hdr, map + sizeof(*hdr),
+							  map + hdr->data_offset);
+	if (count < 0) {
+		munmap(map, size);
+		return count;
+	}
+
+	table->objects = map + hdr->data_offset;
+	table->map = map;
+	table->map_size = size;
+	return count;
+}
+
+/**
+ * \brief Recursively count the populated trixels of a table.
+ *
+ * \param table Parent dataset.
+ * \param trixel The active HTM leaf/node to process.
+ * \return Number of trixels with objects at or below this trixel.
+ */
+static int count_trixels(struct adb_table *table, struct htm_trixel *trixel)
+{
+	int count;
+
+	if (!trixel)
+		return 0;
+
+	count = htm_trixel_num_objects(trixel, table->id) ? 1 : 0;
+
+	if (!trixel->child)
+		return count;
+
+	count += count_trixels(table, &trixel->child[0]);
+	count += count_trixels(table, &trixel->child[1]);
+	count += count_trixels(table, &trixel->child[2]);
+	count += count_trixels(table, &trixel->child[3]);
+	return count;
+}
+
+/**
+ * \brief Recursively check the objects of a trixel fit the compact encoding.
+ *
+ * \param table Parent dataset.
+ * \param trixel The active HTM leaf/node to process.
+ * \return 0 if every object fits or -ERANGE.
+ */
+static int compact_check(struct adb_table *table, struct htm_trixel *trixel)
+{
+	struct adb_object *object;
+	int i;
+
+	if (!trixel)
+		return 0;
+
+	object = htm_trixel_num_objects(trixel, table->id) ?
+				 trixel->data[table->id].objects :
+				 NULL;
+	for (; object; object = object->import.next) {
+		if (!(object->ra >= 0.0 && object->ra <= 2.0 * M_PI) ||
+			!(object->dec >= -M_PI_2 && object->dec <= M_PI_2) ||
+			(!isnan(object->mag) && !(object->mag >= -COMPACT_MAG_MAX &&
+									  object->mag <= COMPACT_MAG_MAX)))
+			return -ERANGE;
+	}
+
+	if (!trixel->child)
+		return 0;
+
+	for (i = 0; i < 4; i++) {
+		if (compact_check(table, &trixel->child[i]) < 0)
+			return -ERANGE;
+	}
+	return 0;
+}
+
+/**
+ * \brief Add the sums of one trixel or child tree to another.
+ *
+ * \param sum Sums to add to.
+ * \param add Sums to add.
+ */
+static void aggregate_add(struct aggregate_sum *sum,
+						  const struct aggregate_sum *add)
+{
+	sum->count += add->count;
+	sum->flux += add->flux;
+	sum->x += add->x;
+	sum->y += add->y;
+	sum->z += add->z;
+	if (!isnan(add->brightest) &&
+		(isnan(sum->brightest) || add->brightest < sum->brightest))
+		sum->brightest = add->brightest;
+}
+
+/**
+ * \brief Recursively gather the aggregates of a trixel and its child trees.
+ *
+ * Must run before the trixel is written as writing replaces the object list
+ * links with the KD tree nodes.
+ *
+ * \param table Parent dataset.
+ * \param trixel The active HTM leaf/node to process.
+ * \param a Gathered aggregates.
+ * \param sum Output sums of the objects in and below the trixel.
+ * \return 0 on success or -ENOMEM.
+ */
+static int aggregate_trixel(struct adb_table *table, struct htm_trixel *trixel,
+							struct aggregate_writer *a,
+							struct aggregate_sum *sum)
+{
+	struct adb_trixel_aggregate *aggregate;
+	struct aggregate_sum child;
+	struct adb_object *object;
+	double cos_dec, len;
+	int i;
+
+	memset(sum, 0, sizeof(*sum));
+	sum->brightest = NAN;
+	if (!trixel)
+		return 0;
+
+	object = htm_trixel_num_objects(trixel, table->id) ?
+				 trixel->data[table->id].objects :
+				 NULL;
+	for (; object; object = object->import.next) {
+		cos_dec = cos(object->dec);
+		sum->x += cos_dec * cos(object->ra);
+		sum->y += cos_dec * sin(object->ra);
+		sum->z += sin(object->dec);
+		if (!isnan(object->mag)) {
+			sum->flux += pow(10.0, -0.4 * object->mag);
+			if (isnan(sum->brightest) || object->mag < sum->brightest)
+				sum->brightest = object->mag;
+		}
+		sum->count++;
+	}
+
+	for (i = 0; trixel->child && i < 4; i++) {
+		if (aggregate_trixel(table, &trixel->child[i], a, &child) < 0)
+			return -ENOMEM;
+		aggregate_add(sum, &child);
+	}
+
+	if (sum->count == 0)
+		return 0;
+
+	if (a->count == a->size) {
+		a->size = a->size ? a->size * 2 : 1024;
+		aggregate = realloc(a->aggregate, a->size * sizeof(*aggregate));
+		if (aggregate == NULL)
+			return -ENOMEM;
+		a->aggregate = aggregate;
+	}
+
+	aggregate = &a->aggregate[a->count++];
+	aggregate->id = htm_trixel_id(trixel);
+	aggregate->count = sum->count;
+	aggregate->brightest = sum->brightest;
+	aggregate->flux = sum->flux;
+	aggregate->ra = atan2(sum->y, sum->x);
+	if (aggregate->ra < 0.0)
+		aggregate->ra += 2.0 * M_PI;
+	len = sqrt(sum->x * sum->x + sum->y * sum->y + sum->z * sum->z);
+	aggregate->dec = len > 0.0 ? asin(fmax(-1.0, fmin(1.0, sum->z / len))) :
+								 0.0;
+	return 0;
+}
+
+/* trixel aggregates are searched by trixel ID */
+static int aggregate_cmp(const void *a, const void *b)
+{
+	const struct adb_trixel_aggregate *aa = a, *ab = b;
+
+	return aa->id < ab->id ? -1 : aa->id > ab->id;
+}
+
+/**
+ * \brief Gather the aggregates of every populated trixel of a table.
+ *
+ * \param db Active database connection logging context.
+ * \param table Table being written.
+ * \param a Gathered aggregates, sorted by trixel ID.
+ * \return 0 on success or -ENOMEM.
+ */
+static int aggregate_table(struct adb_db *db, struct adb_table *table,
+						   struct aggregate_writer *a)
+{
+	struct aggregate_sum sum;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		if (aggregate_trixel(table, &db->htm->N[i], a, &sum) < 0 ||
+			aggregate_trixel(table, &db->htm->S[i], a, &sum) < 0)
+			return -ENOMEM;
+	}
+
+	qsort(a->aggregate, a->count, sizeof(*a->aggregate), aggregate_cmp);
+	adb_info(db, ADB_LOG_HTM_FILE, " gathered %d trixel aggregates\n",
+			 a->count);
+	return 0;
+}
+
 /**
  * \brief Recursively stream a populated HTM trixel and child trees to a database file.
  *
- * Skips empty trixels traversing downward until it locates populated nodes, writing
- * custom struct trixel_hdr blocks followed by tightly packed astronomical objects mappings.
+ * Skips empty trixels traversing downward until it locates populated nodes,
+ * adding a trixel directory entry and writing the tightly packed objects.
  *
  * \param db Active database connection logging context.
  * \param table Parent dataset to pull structural mappings limits from.
  * \param trixel The active HTM leaf/node to process.
- * \param file The output file pointer.
+ * \param w The table file writer.
  * \return Returns the number of successfully written objects (bubbles up recursively).
  */
 static int write_trixel(struct adb_db *db, struct adb_table *table,
-						struct htm_trixel *trixel, FILE *file)
+						struct htm_trixel *trixel, struct trixel_writer *w)
 {
 	struct adb_object *object, *object_next;
 	struct adb_kd_tree *kd;
-	struct trixel_hdr hdr;
+	struct trixel_dir *dir;
 	int count = 0, _count;
 	size_t size;
 
 	if (!trixel)
 		return 0;
 
-	/* write children if this trixel has no objects */
-	if (!trixel->data[table->id].num_objects)
+	/* write children if this trixel has no objects in this pass */
+	if (!htm_trixel_num_objects(trixel, table->id) ||
+		!htm_layout_takes(trixel, w->depth))
 		goto children;
 
-	/* write trixel header */
-	hdr.id = 1 << HTM_ID_VALID_SHIFT | trixel->hemisphere << HTM_ID_HEMI_SHIFT |
-			 trixel->quadrant << HTM_ID_QUAD_SHIFT |
-			 trixel->depth << HTM_ID_DEPTH_SHIFT | trixel->position;
-	hdr.num_objects = trixel->data[table->id].num_objects;
-
-	size = fwrite(&hdr, sizeof(struct trixel_hdr), 1, file);
-	if (size == 0)
-		return 0;
+	/* add trixel directory entry */
+	dir = &w->dir[w->trixel_count++];
+	dir->id = 1 << HTM_ID_VALID_SHIFT | trixel->hemisphere << HTM_ID_HEMI_SHIFT |
+			  trixel->quadrant << HTM_ID_QUAD_SHIFT |
+			  trixel->depth << HTM_ID_DEPTH_SHIFT | trixel->position;
+	dir->num_objects = trixel->data[table->id].num_objects;
+	dir->depth = trixel->depth;
+	dir->layout = w->depth < 0 ? ADB_TABLE_LAYOUT_TRIXEL :
+								 ADB_TABLE_LAYOUT_DEPTH;
+	dir->offset = w->offset;
 
 	adb_vdebug(db, ADB_LOG_HTM_FILE,
 			   "write trixel %sQ%dD%dP%x id %x with objs %d\n",
-			   htm_trixel_north(hdr.id) ? "N" : "S",
-			   htm_trixel_quadrant(hdr.id), htm_trixel_depth(hdr.id),
-			   htm_trixel_position(hdr.id, htm_trixel_depth(hdr.id)), hdr.id,
-			   hdr.num_objects);
+			   htm_trixel_north(dir->id) ? "N" : "S",
+			   htm_trixel_quadrant(dir->id), htm_trixel_depth(dir->id),
+			   htm_trixel_position(dir->id, htm_trixel_depth(dir->id)), dir->id,
+			   dir->num_objects);
 
 	/* write objects */
 	object = trixel->data[table->id].objects;
@@ -166,56 +1126,96 @@ static int write_trixel(struct adb_db *db, struct adb_table *table,
 		kd = object->import.kd;
 		object_next = object->import.next;
 
-		/* copy KD tree data */
-		memcpy(&object->kd, object->import.kd, sizeof(struct adb_kd_tree));
-		free(kd);
+		/* copy KD tree data, the node is owned by the import arena */
+		memcpy(&object->kd, kd, sizeof(struct adb_kd_tree));
 
 		/* write object + KD data to file */
-		size = fwrite(object, table->object.bytes, 1, file);
+		if (w->encoding == ADB_TABLE_ENCODING_COMPACT) {
+			if (compact_encode(w, object,
+							   table->object.bytes - sizeof(*object)) < 0)
+				return -ENOMEM;
+			size = fwrite(w->record, w->record_bytes, 1, w->file);
+		} else
+			size = fwrite(object, table->object.bytes, 1, w->file);
 		if (size == 0)
-			return 0;
+			return -EIO;
 
 		object = object_next;
 		count++;
 	}
-	count = trixel->data[table->id].num_objects;
 
 	if (count != trixel->data[table->id].num_objects) {
 		adb_error(db, "wrote %d expected %d ", count,
 				  trixel->data[table->id].num_objects);
-		adb_error(db, "for trixel %x\n", hdr.id);
+		adb_error(db, "for trixel %x\n", dir->id);
 		return -EINVAL;
 	}
-	table->depth_count[htm_trixel_depth(hdr.id)] += hdr.num_objects;
+	w->offset += count * w->record_bytes;
+	table->depth_count[dir->depth] += dir->num_objects;
 
 children:
-	if (!trixel->child)
+	if (!htm_layout_descends(trixel, w->depth))
 		return count;
 
-	_count = write_trixel(db, table, &trixel->child[0], file);
+	_count = write_trixel(db, table, &trixel->child[0], w);
 	if (_count < 0)
 		return _count;
 	count += _count;
-	_count = write_trixel(db, table, &trixel->child[1], file);
+	_count = write_trixel(db, table, &trixel->child[1], w);
 	if (_count < 0)
 		return _count;
 	count += _count;
-	_count = write_trixel(db, table, &trixel->child[2], file);
+	_count = write_trixel(db, table, &trixel->child[2], w);
 	if (_count < 0)
 		return _count;
 	count += _count;
-	_count = write_trixel(db, table, &trixel->child[3], file);
+	_count = write_trixel(db, table, &trixel->child[3], w);
 	if (_count < 0)
 		return _count;
 	count += _count;
 	return count;
 }
 
+/**
+ * \brief Read legacy table files, streaming each trixel into a heap buffer.
+ *
+ * \param db Active framework connection instances.
+ * \param table Targeting subset catalog identifier parameters.
+ * \param f Table file positioned at the first trixel header.
+ * \return Loaded objects total or standard system negative error code.
+ */
+static int read_table_legacy(struct adb_db *db, struct adb_table *table,
+							 FILE *f)
+{
+	struct adb_object *objects;
+	size_t mapped;
+	int count;
+
+	/* allocate object buffer */
+	objects = alloc_large(db, (size_t)table->object.count * table->object.bytes,
+						  &mapped);
+	if (objects == NULL)
+		return -ENOMEM;
+
+	count = read_trixels(db, table, objects, f);
+	if (count < 0) {
+		alloc_free_large(objects, mapped);
+		return count;
+	}
+
+	table->objects = objects;
+	table->objects_mapped = mapped;
+	return count;
+}
+
 /**
  * \brief Initialize and orchestrate the population of a database table from its `.db` data file.
  *
- * Allocates primary contiguous memory and opens disk I/O, redirecting stream processing
- * to `read_trixels` sequentially.
+ * Tables are either copied into a private heap buffer, mapped read only from
+ * the file for ADB_TABLE_LOAD_MMAP or have each trixel read on first use for
+ * ADB_TABLE_LOAD_LAZY. Legacy table files without a trixel directory are
+ * always copied, compact table files are decoded a trixel at a time and
+ * copied unless lazy.
  *
  * \param db Active framework connection instances.
  * \param table Targeting subset catalog identifier parameters.
@@ -223,21 +1223,19 @@ children:
  */
 int table_read_trixels(struct adb_db *db, struct adb_table *table)
 {
-	struct adb_object *objects;
-	int count, i;
+	struct table_file_hdr hdr;
+	struct stat stat_info;
+	int count, i, ret;
 	char file[ADB_PATH_SIZE];
+	off_t file_size;
+	size_t size;
 	FILE *f;
 
 	if (table->object.bytes <= 0) {
-		adb_error(db, "Error invalid object size\n", table->object.bytes);
+		adb_error(db, "Error invalid object size %d\n", table->object.bytes);
 		return -EINVAL;
 	}
 
-	/* allocate object buffer */
-	objects = calloc(table->object.count, table->object.bytes);
-	if (objects == NULL)
-		return -ENOMEM;
-
 	sprintf(file, "%s%s%s", table->path.local, table->path.file, ".db");
 	adb_info(db, ADB_LOG_HTM_FILE, "Reading table objects from %s\n", file);
 
@@ -245,20 +1243,84 @@ int table_read_trixels(struct adb_db *db, struct adb_table *table)
 	f = fopen(file, "r");
 	if (f == NULL) {
 		adb_error(db, "Error can't open table file %s for reading\n", file);
-		free(objects);
 		return -EIO;
 	}
 
+	if (fstat(fileno(f), &stat_info) < 0) {
+		count = -errno;
+		goto out;
+	}
+
 	adb_info(db, ADB_LOG_HTM_FILE,
 			 "Reading %d objects from %s with object size %d bytes\n",
 			 table->object.count, file, table->object.bytes);
 
+	/* legacy files start with a valid trixel ID rather than the magic */
+	size = fread(&hdr, sizeof(hdr), 1, f);
+	if (size == 0 || hdr.magic != ADB_TABLE_FILE_MAGIC) {
+		if (db->table_load != ADB_TABLE_LOAD_COPY)
+			adb_info(db, ADB_LOG_HTM_FILE,
+					 "Legacy table file %s has no directory, copying\n",
+					 file);
+		rewind(f);
+		count = read_table_legacy(db, table, f);
+		goto out;
+	}
+
+	/* aggregates end the file, the objects end before them */
+	file_size = stat_info.st_size;
+	if (hdr.version == ADB_TABLE_FILE_VERSION_AGGREGATE) {
+		count = read_aggregates(db, table, f, &file_size);
+		if (count < 0)
+			goto out;
+	}
+
+	count = check_file_hdr(db, table, &hdr, file_size);
+	if (count < 0)
+		goto out;
+
+	/* compact objects are decoded as each trixel is read */
+	if (hdr.encoding == ADB_TABLE_ENCODING_COMPACT) {
+		if (db->table_load == ADB_TABLE_LOAD_MMAP)
+			adb_info(db, ADB_LOG_HTM_FILE,
+					 "Compact table file %s can't be mapped, copying\n",
+					 file);
+		count = read_table_lazy(db, table, f, &hdr, file_size);
+		if (count >= 0 && db->table_load != ADB_TABLE_LOAD_LAZY) {
+			ret = table_load_all(table);
+			if (ret < 0) {
+				table_free_trixels(table);
+				count = ret;
+			}
+		}
+		goto out;
+	}
+
 	/* read in table rows */
-	count = read_trixels(db, table, objects, f);
+	switch (db->table_load) {
+	case ADB_TABLE_LOAD_MMAP:
+		count = read_table_mmap(db, table, fileno(f), file_size);
+		break;
+	case ADB_TABLE_LOAD_LAZY:
+		count = read_table_lazy(db, table, f, &hdr, file_size);
+		break;
+	case ADB_TABLE_LOAD_COPY:
+	default:
+		count = read_table_copy(db, table, f, &hdr);
+		break;
+	}
+
+out:
 	fclose(f);
+	if (count < 0) {
+		free(table->aggregates);
+		table->aggregates = NULL;
+		table->aggregate_count = 0;
+		return count;
+	}
 
-	adb_info(db, ADB_LOG_HTM_FILE, "Read and inserted %d objects\n", count);
-	table->objects = objects;
+	adb_info(db, ADB_LOG_HTM_FILE, "%s and inserted %d objects\n",
+			 table->map ? "Mapped" : table->lazy ? "Indexed" : "Read", count);
 
 	for (i = 0; i <= table->db->htm->depth; i++)
 		adb_info(db, ADB_LOG_HTM_FILE, "Read %d objects at %d depth\n",
@@ -266,11 +1328,43 @@ int table_read_trixels(struct adb_db *db, struct adb_table *table)
 	return count;
 }
 
+/**
+ * \brief Release the object memory of a table read by table_read_trixels().
+ *
+ * \param table Table to release objects for.
+ */
+void table_free_trixels(struct adb_table *table)
+{
+	kd_free_nodes(table);
+	table_free_columns(table);
+
+	if (table->lazy) {
+		close(table->lazy->fd);
+		free(table->lazy);
+		table->lazy = NULL;
+	}
+
+	if (table->map)
+		munmap(table->map, table->map_size);
+	else
+		alloc_free_large(table->objects, table->objects_mapped);
+
+	free(table->aggregates);
+	table->aggregates = NULL;
+	table->aggregate_count = 0;
+
+	table->map = NULL;
+	table->map_size = 0;
+	table->objects = NULL;
+	table->objects_mapped = 0;
+}
+
 /**
  * \brief Export an in-memory database catalog into the custom serialized binary file format.
  *
  * Overwrites the table datasets local `.db` file dynamically invoking `write_trixel` for
- * all 8 master hemispheres.
+ * all 8 master hemispheres. Objects are written compact when the catalog
+ * table encoding asks for it and every object fits.
  *
  * \param db Parent state and HTM spatial indexes references.
  * \param table Reference table tracking schema configuration data.
@@ -279,7 +1373,11 @@ int table_read_trixels(struct adb_db *db, struct adb_table *table)
 int table_write_trixels(struct adb_db *db, struct adb_table *table)
 {
 	struct htm *htm = db->htm;
-	int count = 0, count_, i;
+	struct aggregate_trailer trailer;
+	struct aggregate_writer a;
+	struct table_file_hdr hdr;
+	struct trixel_writer w;
+	int count = 0, count_, pass, i;
 	char file[ADB_PATH_SIZE];
 	FILE *f;
 
@@ -292,51 +1390,128 @@ int table_write_trixels(struct adb_db *db, struct adb_table *table)
 		return -EIO;
 	}
 
-	count_ = write_trixel(db, table, &htm->N[0], f);
-	if (count_ < 0)
-		goto err;
-	adb_info(db, ADB_LOG_HTM_FILE, " wrote %d N0 objects\n", count_);
-	count += count_;
-	count_ = write_trixel(db, table, &htm->N[1], f);
-	if (count_ < 0)
-		goto err;
-	adb_info(db, ADB_LOG_HTM_FILE, " wrote %d N1 objects\n", count_);
-	count += count_;
-	count_ = write_trixel(db, table, &htm->N[2], f);
-	if (count_ < 0)
-		goto err;
-	adb_info(db, ADB_LOG_HTM_FILE, " wrote %d N2 objects\n", count_);
-	count += count_;
-	count_ = write_trixel(db, table, &htm->N[3], f);
-	if (count_ < 0)
-		goto err;
-	adb_info(db, ADB_LOG_HTM_FILE, " wrote %d N3 objects\n", count_);
-	count += count_;
-	count_ = write_trixel(db, table, &htm->S[0], f);
-	if (count_ < 0)
-		goto err;
-	adb_info(db, ADB_LOG_HTM_FILE, " wrote %d S0 objects\n", count_);
-	count += count_;
-	count_ = write_trixel(db, table, &htm->S[1], f);
-	if (count_ < 0)
-		goto err;
-	adb_info(db, ADB_LOG_HTM_FILE, " wrote %d S1 objects\n", count_);
-	count += count_;
-	count_ = write_trixel(db, table, &htm->S[2], f);
-	if (count_ < 0)
+	/* aggregates are gathered while the trixel object lists are intact */
+	memset(&a, 0, sizeof(a));
+	memset(&w, 0, sizeof(w));
+	if (db->table_aggregates) {
+		count_ = aggregate_table(db, table, &a);
+		if (count_ < 0)
+			goto err;
+	}
+
+	/* size the trixel directory, objects are written after it */
+	for (i = 0; i < 4; i++) {
+		w.trixel_count += count_trixels(table, &htm->N[i]);
+		w.trixel_count += count_trixels(table, &htm->S[i]);
+	}
+
+	/* pool offsets are 32 bit */
+	w.encoding = db->table_encoding;
+	if (w.encoding == ADB_TABLE_ENCODING_COMPACT &&
+		table->object.count < UINT32_MAX / ADB_OBJECT_NAME_SIZE) {
+		for (i = 0; i < 4; i++) {
+			if (compact_check(table, &htm->N[i]) < 0 ||
+				compact_check(table, &htm->S[i]) < 0)
+				break;
+		}
+		if (i < 4) {
+			adb_info(db, ADB_LOG_HTM_FILE,
+					 "Objects outside compact range, writing raw\n");
+			w.encoding = ADB_TABLE_ENCODING_RAW;
+		}
+	} else
+		w.encoding = ADB_TABLE_ENCODING_RAW;
+
+	w.dir = calloc(w.trixel_count, sizeof(struct trixel_dir));
+	if (w.dir == NULL) {
+		count_ = -ENOMEM;
 		goto err;
-	adb_info(db, ADB_LOG_HTM_FILE, " wrote %d S2 objects\n", count_);
-	count += count_;
-	count_ = write_trixel(db, table, &htm->S[3], f);
-	if (count_ < 0)
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = ADB_TABLE_FILE_MAGIC;
+	hdr.version = db->table_aggregates ? ADB_TABLE_FILE_VERSION_AGGREGATE :
+										 ADB_TABLE_FILE_VERSION;
+	hdr.trixel_count = w.trixel_count;
+	hdr.object_bytes = table->object.bytes;
+	hdr.object_count = table->object.count;
+	hdr.encoding = w.encoding;
+	hdr.data_offset = sizeof(hdr) + w.trixel_count * sizeof(struct trixel_dir);
+
+	w.file = f;
+	w.offset = hdr.data_offset;
+	w.trixel_count = 0;
+	w.record_bytes = file_record_bytes(&hdr);
+
+	if (w.encoding == ADB_TABLE_ENCODING_COMPACT) {
+		w.record = calloc(1, w.record_bytes);
+		if (w.record == NULL) {
+			count_ = -ENOMEM;
+			goto err;
+		}
+	}
+
+	if (fseeko(f, hdr.data_offset, SEEK_SET) < 0) {
+		count_ = -errno;
 		goto err;
-	adb_info(db, ADB_LOG_HTM_FILE, " wrote %d S3 objects\n", count_);
-	count += count_;
+	}
+
+	/* each pass writes a subtree or a depth of every root trixel */
+	for (pass = 0; pass < htm_layout_passes(htm, db->table_layout); pass++) {
+		w.depth = htm_layout_depth(db->table_layout, pass);
+		for (i = 0; i < 8; i++) {
+			count_ = write_trixel(db, table,
+								  i < 4 ? &htm->N[i] : &htm->S[i - 4], &w);
+			if (count_ < 0)
+				goto err;
+			adb_info(db, ADB_LOG_HTM_FILE, " wrote %d %c%d objects\n", count_,
+					 i < 4 ? 'N' : 'S', i & 3);
+			count += count_;
+		}
+	}
 
 	if (count != table->object.count)
 		adb_error(db, "Error wrote %d objects, expected %d\n", count,
 				  table->object.count);
 
+	/* designations follow the compact objects */
+	if (w.encoding == ADB_TABLE_ENCODING_COMPACT &&
+		fwrite(w.pool, 1, w.pool_bytes, f) != w.pool_bytes) {
+		adb_error(db, "Error failed to write table file %s designations\n",
+				  file);
+		count_ = -EIO;
+		goto err;
+	}
+
+	/* aggregates and their trailer end the file */
+	if (db->table_aggregates) {
+		trailer.offset = ftello(f);
+		trailer.count = a.count;
+		trailer.magic = ADB_TABLE_AGGREGATE_MAGIC;
+		if (fwrite(a.aggregate, sizeof(*a.aggregate), a.count, f) != a.count ||
+			fwrite(&trailer, sizeof(trailer), 1, f) != 1) {
+			adb_error(db, "Error failed to write table file %s aggregates\n",
+					  file);
+			count_ = -EIO;
+			goto err;
+		}
+	}
+
+	/* now write the header and trixel directory */
+	rewind(f);
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+		fwrite(w.dir, sizeof(struct trixel_dir), w.trixel_count, f) !=
+			w.trixel_count) {
+		adb_error(db, "Error failed to write table file %s directory\n",
+				  file);
+		count_ = -EIO;
+		goto err;
+	}
+	free(w.dir);
+	free(w.record);
+	free(w.pool);
+	free(a.aggregate);
+
 	for (i = 0; i <= table->db->htm->depth; i++)
 		adb_info(db, ADB_LOG_HTM_FILE, " wrote %d objects at depth %d\n",
 				 table->depth_count[i], i);
@@ -347,6 +1522,10 @@ int table_write_trixels(struct adb_db *db, struct adb_table *table)
 	return count;
 
 err:
+	free(w.dir);
+	free(w.record);
+	free(w.pool);
+	free(a.aggregate);
 	fclose(f);
 	unlink(file);
 	return count_;
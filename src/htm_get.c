@@ -18,12 +18,16 @@
 
 #include <errno.h> // IWYU pragma: keep
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "debug.h"
 #include "htm.h"
 #include "private.h"
+#include "remote.h"
+#include "simd.h"
 #include "table.h"
+#include "libastrodb/db-import.h"
 #include "libastrodb/db.h"
 #include "libastrodb/object.h"
 
@@ -60,11 +64,14 @@ static inline void vertex_cross(struct htm_vertex *a, struct htm_vertex *b,
  * Employs edge cross products multiplied against the target point to determine
  * bounded inclusion within the parent shape boundaries.
  *
- * \param t The UP trixel defining the boundary region.
+ * \param a Trixel corner A.
+ * \param b Trixel corner B.
+ * \param c Trixel corner C.
  * \param point The target point to test for containment.
  * \return 1 if point is inside, 0 otherwise.
  */
-static int vertex_is_inside_up(struct htm_trixel *t, struct htm_vertex *point)
+static int vertex_is_inside_up(struct htm_vertex *a, struct htm_vertex *b,
+							   struct htm_vertex *c, struct htm_vertex *point)
 {
 	struct htm_vertex prod;
 	double val;
@@ -76,19 +83,19 @@ static int vertex_is_inside_up(struct htm_trixel *t, struct htm_vertex *point)
    */
 
 	/* edge a -> b */
-	vertex_cross(t->a, t->b, &prod);
+	vertex_cross(a, b, &prod);
 	val = vertex_mult(&prod, point);
 	if (val < INSIDE_UP_LIMIT)
 		return 0;
 
 	/* edge b -> c */
-	vertex_cross(t->b, t->c, &prod);
+	vertex_cross(b, c, &prod);
 	val = vertex_mult(&prod, point);
 	if (val < INSIDE_UP_LIMIT)
 		return 0;
 
 	/* edge c -> a */
-	vertex_cross(t->c, t->a, &prod);
+	vertex_cross(c, a, &prod);
 	val = vertex_mult(&prod, point);
 	if (val < INSIDE_UP_LIMIT)
 		return 0;
@@ -102,11 +109,15 @@ static int vertex_is_inside_up(struct htm_trixel *t, struct htm_vertex *point)
  *
  * Evaluates inclusion logic using an anti-clockwise edge sequence traversal.
  *
- * \param t The DOWN trixel defining the boundary region.
+ * \param a Trixel corner A.
+ * \param b Trixel corner B.
+ * \param c Trixel corner C.
  * \param point The target test point.
  * \return 1 if point is inside, 0 otherwise.
  */
-static int vertex_is_inside_down(struct htm_trixel *t, struct htm_vertex *point)
+static int vertex_is_inside_down(struct htm_vertex *a, struct htm_vertex *b,
+								 struct htm_vertex *c,
+								 struct htm_vertex *point)
 {
 	struct htm_vertex prod;
 	double val;
@@ -118,19 +129,19 @@ static int vertex_is_inside_down(struct htm_trixel *t, struct htm_vertex *point)
    */
 
 	/* edge a -> c */
-	vertex_cross(t->a, t->c, &prod);
+	vertex_cross(a, c, &prod);
 	val = vertex_mult(&prod, point);
 	if (val < INSIDE_UP_LIMIT)
 		return 0;
 
 	/* edge c -> b */
-	vertex_cross(t->c, t->b, &prod);
+	vertex_cross(c, b, &prod);
 	val = vertex_mult(&prod, point);
 	if (val < INSIDE_UP_LIMIT)
 		return 0;
 
 	/* edge b -> a */
-	vertex_cross(t->b, t->a, &prod);
+	vertex_cross(b, a, &prod);
 	val = vertex_mult(&prod, point);
 	if (val < INSIDE_UP_LIMIT)
 		return 0;
@@ -140,61 +151,112 @@ static int vertex_is_inside_down(struct htm_trixel *t, struct htm_vertex *point)
 }
 
 /**
- * \brief Recursively check each child trixel to find which one contains the target point.
+ * \brief Check if a point is inside a trixel.
+ *
+ * \param v Trixel corners A, B and C.
+ * \param orientation TRIXEL_UP or TRIXEL_DOWN.
+ * \param point The target test point.
+ * \return 1 if point is inside, 0 otherwise.
+ */
+static inline int vertex_is_inside(struct htm_vertex *v[3], int orientation,
+								   struct htm_vertex *point)
+{
+	if (orientation == TRIXEL_UP)
+		return vertex_is_inside_up(v[0], v[1], v[2], point);
+	else
+		return vertex_is_inside_down(v[0], v[1], v[2], point);
+}
+
+/**
+ * \brief Set a vertex to the midpoint of an edge.
+ *
+ * \param a Edge start.
+ * \param b Edge end.
+ * \param mid Midpoint.
+ */
+static inline void vertex_midpoint(const struct htm_vertex *a,
+								   const struct htm_vertex *b,
+								   struct htm_vertex *mid)
+{
+	mid->x = ((a->x + b->x) / 2.0);
+	mid->y = ((a->y + b->y) / 2.0);
+	mid->z = ((a->z + b->z) / 2.0);
+}
+
+/**
+ * \brief Descend from a root trixel to the ID of the trixel holding a point.
  *
- * Traverses down to the specified depth, determining point inclusion at each level.
+ * Child corners are the edge midpoints of the parent in octahedron
+ * coordinates, computed exactly as the mesh computes its vertices, so each
+ * level takes the same child as a walk through the mesh would: the first of
+ * children 0 to 3 holding the point. Only the root trixel is read.
  *
  * \param htm Parent spatial engine.
- * \param t The current parent trixel evaluating its bounds.
+ * \param root Root trixel.
  * \param point Target coordinate to locate.
- * \param depth Maximum recursion depth limit.
- * \param level Current target iteration level.
- * \return Pointer to the matched bounding trixel, or NULL if outside bounds.
+ * \param depth Trixel depth.
+ * \return Trixel ID, a shallower ID if no child holds the point, or 0 if
+ * the root does not hold the point.
  */
-static struct htm_trixel *trixel_is_container(struct htm *htm,
-											  struct htm_trixel *t,
-											  struct htm_vertex *point,
-											  int depth, int level)
+static unsigned int trixel_descend_id(struct htm *htm,
+									  const struct htm_trixel *root,
+									  struct htm_vertex *point, int depth)
 {
-	struct htm_trixel *child;
+	struct htm_vertex corner[3], mid[3], *v[3], *child[3];
+	unsigned int position = 0;
+	int orientation = root->orientation, level, i;
+
+	corner[0] = *root->a;
+	corner[1] = *root->b;
+	corner[2] = *root->c;
+	v[0] = &corner[0];
+	v[1] = &corner[1];
+	v[2] = &corner[2];
+
+	if (!vertex_is_inside(v, orientation, point))
+		return 0;
 
-	/* is point inside this trixel ? */
-	if (t->orientation == TRIXEL_UP)
-		t->visible = vertex_is_inside_up(t, point);
-	else
-		t->visible = vertex_is_inside_down(t, point);
+	for (level = 1; level <= depth; level++) {
+		/* midpoints of edges B-C, A-B and C-A */
+		vertex_midpoint(v[2], v[1], &mid[0]);
+		vertex_midpoint(v[0], v[1], &mid[1]);
+		vertex_midpoint(v[2], v[0], &mid[2]);
+
+		/* child 0 is the middle trixel with the opposite orientation */
+		child[0] = &mid[0];
+		child[1] = &mid[1];
+		child[2] = &mid[2];
+		if (vertex_is_inside(child, !orientation, point)) {
+			orientation = !orientation;
+			i = 0;
+			goto found;
+		}
 
-	/* return NULL if point is not in this trixel */
-	if (!t->visible)
-		return NULL;
+		/* children 1 to 3 take one parent corner each */
+		for (i = 1; i < 4; i++) {
+			child[0] = i == 1 ? v[0] : i == 2 ? &mid[1] : &mid[2];
+			child[1] = i == 1 ? &mid[1] : i == 2 ? v[1] : &mid[0];
+			child[2] = i == 1 ? &mid[2] : i == 2 ? &mid[0] : v[2];
+			if (vertex_is_inside(child, orientation, point))
+				goto found;
+		}
+
+		/* we should never get here as one child will contain point */
+		adb_htm_debug(htm, ADB_LOG_HTM_GET,
+					  "No valid child for X %f Y %f Z %f\n", point->x,
+					  point->y, point->z);
+		break;
+
+found:
+		position |= i << (level << 1);
+		*v[0] = *child[0];
+		*v[1] = *child[1];
+		*v[2] = *child[2];
+	}
 
-	/* return trixel if we are visible and at correct depth */
-	if (level++ == depth)
-		return t;
-
-	/* check child trixels if point is contained with parent */
-	child = trixel_is_container(htm, &t->child[0], point, depth, level);
-	if (child)
-		return child;
-
-	child = trixel_is_container(htm, &t->child[1], point, depth, level);
-	if (child)
-		return child;
-
-	child = trixel_is_container(htm, &t->child[2], point, depth, level);
-	if (child)
-		return child;
-
-	child = trixel_is_container(htm, &t->child[3], point, depth, level);
-	if (child)
-		return child;
-
-	/* we should never get here as one child will contain point */
-	adb_htm_debug(htm, ADB_LOG_HTM_GET, "No valid child for X %f Y %f Z %f\n",
-				  point->x, point->y, point->z);
-	printf("\n!!!!! No valid child for X %f Y %f Z %f\n", point->x, point->y,
-		   point->z);
-	return t; /* return the parent, it's better than nothing */
+	return 1 << HTM_ID_VALID_SHIFT | root->hemisphere << HTM_ID_HEMI_SHIFT |
+		   root->quadrant << HTM_ID_QUAD_SHIFT |
+		   (level - 1) << HTM_ID_DEPTH_SHIFT | position;
 }
 
 /**
@@ -235,6 +297,45 @@ static int htm_validate_point(struct htm *htm, struct htm_vertex *point)
 	return 0;
 }
 
+/**
+ * \brief Compute the ID of the trixel holding a point at a given depth.
+ *
+ * The first of the root sectors holding the point is descended, which is
+ * the trixel htm_get_home_trixel() finds in a full mesh.
+ *
+ * \param htm Spatial indexing instance.
+ * \param point Target RA/Dec vertex matching position.
+ * \param depth Trixel depth.
+ * \return Trixel ID, or 0 on invalid input.
+ */
+unsigned int htm_get_home_id(struct htm *htm, struct htm_vertex *point,
+							 int depth)
+{
+	unsigned int id;
+	int i;
+
+	if (htm_validate_point(htm, point) < 0)
+		return 0;
+
+	if (depth > htm->depth)
+		depth = htm->depth - 1;
+
+	for (i = 0; i < 4; i++) {
+		id = trixel_descend_id(htm, &htm->N[i], point, depth);
+		if (id)
+			return id;
+	}
+	for (i = 0; i < 4; i++) {
+		id = trixel_descend_id(htm, &htm->S[i], point, depth);
+		if (id)
+			return id;
+	}
+
+	adb_htm_error(htm, "No valid trixel for X %f Y %f Z %f\n", point->x,
+				  point->y, point->z);
+	return 0;
+}
+
 /**
  * \brief Search the HTM for all trixels containing a point at a given depth.
  *
@@ -250,9 +351,10 @@ static int htm_validate_point(struct htm *htm, struct htm_vertex *point)
  * \return Number of matching trixels found (0 on invalid input).
  */
 int htm_get_home_trixels(struct htm *htm, struct htm_vertex *point, int depth,
-						struct htm_trixel **results, int max_results)
+						 struct htm_trixel **results, int max_results)
 {
-	struct htm_trixel *t;
+	struct htm_trixel *roots[8], *t;
+	unsigned int id;
 	int i, count = 0;
 
 	if (htm_validate_point(htm, point) < 0)
@@ -261,15 +363,18 @@ int htm_get_home_trixels(struct htm *htm, struct htm_vertex *point, int depth,
 	if (depth > htm->depth)
 		depth = htm->depth - 1;
 
-	/* northern hemisphere quad trixels */
-	for (i = 0; i < 4 && count < max_results; i++) {
-		t = trixel_is_container(htm, &htm->N[i], point, depth, 0);
-		if (t)
-			results[count++] = t;
+	for (i = 0; i < 4; i++) {
+		roots[i] = &htm->N[i];
+		roots[i + 4] = &htm->S[i];
 	}
-	/* southern hemisphere quad trixels */
-	for (i = 0; i < 4 && count < max_results; i++) {
-		t = trixel_is_container(htm, &htm->S[i], point, depth, 0);
+
+	/* northern then southern hemisphere quad trixels */
+	for (i = 0; i < 8 && count < max_results; i++) {
+		id = trixel_descend_id(htm, roots[i], point, depth);
+		if (!id)
+			continue;
+
+		t = htm_get_trixel(htm, id);
 		if (t)
 			results[count++] = t;
 	}
@@ -281,6 +386,7 @@ int htm_get_home_trixels(struct htm *htm, struct htm_vertex *point, int depth,
 	return count;
 }
 
+
 /**
  * \brief Search the HTM down to depth for a point's bounding parent trixel.
  *
@@ -305,6 +411,28 @@ struct htm_trixel *htm_get_home_trixel(struct htm *htm,
 	return result;
 }
 
+/**
+ * \brief Get the trixel at depth a point is inserted into.
+ *
+ * Creates the sparse mesh trixels down to depth and the trixel object data.
+ *
+ * \param htm Spatial indexing instance.
+ * \param point Target RA/Dec vertex matching position.
+ * \param depth Insert depth.
+ * \return The trixel at depth, or NULL.
+ */
+struct htm_trixel *htm_new_home_trixel(struct htm *htm,
+									   struct htm_vertex *point, int depth)
+{
+	unsigned int id;
+
+	id = htm_get_home_id(htm, point, depth);
+	if (!id)
+		return NULL;
+
+	return htm_new_trixel(htm, id);
+}
+
 /**
  * \brief Copy all trixels associated with a specific vertex into an array.
  *
@@ -407,124 +535,6 @@ int vertex_get_trixels_depth(struct htm *htm, struct htm_vertex *v,
 	return num - empty;
 }
 
-/**
- * \brief Retrieve all immediate neighboring trixels sharing any vertices with a target block.
- *
- * \param htm Spatial engine.
- * \param t The center trixel to discover neighbors for.
- * \param depth The specified depth tier to search within.
- * \param set Target bounded collection managing output buffers.
- * \return Total collected neighboring elements.
- */
-static int trixel_get_neighbours(struct htm *htm, struct htm_trixel *t,
-								 int depth, struct adb_object_set *set,
-								 int offset)
-{
-	int neighbours;
-
-	/* vertex A */
-	neighbours = vertex_get_trixels_depth(htm, t->a, t, set->trixels,
-										  htm->trixel_count, depth, offset);
-
-	/* vertex B */
-	neighbours += vertex_get_trixels_depth(
-		htm, t->b, t, set->trixels, htm->trixel_count, depth,
-		offset + neighbours);
-
-	/* vertex C */
-	neighbours += vertex_get_trixels_depth(
-		htm, t->c, t, set->trixels, htm->trixel_count, depth,
-		offset + neighbours);
-
-	adb_htm_debug(htm, ADB_LOG_HTM_GET, "found %d neighbours at depth %d\n",
-				  neighbours, depth);
-	return neighbours;
-}
-
-/**
- * \brief Register the parent of a given trixel into a unique collection buffer.
- *
- * Extracts a trixel's top-level parent and ensures it's uniquely inserted
- * into the buffer tracking array exactly once.
- *
- * \param htm Spatial engine.
- * \param trixel_buf Pointer to the bounding collection buffer.
- * \param offset Index identifying the child block whose parent is being stored.
- * \param buffer_start Search window start for duplicate checking.
- * \param buffer_end Search window limit for duplicate checking.
- * \return 1 if successfully added, 0 on failure or pre-existing duplicate.
- */
-static int trixel_add_parent(struct htm *htm, struct htm_trixel **trixel_buf,
-							 int offset, int buffer_start, int buffer_end)
-{
-	struct htm_trixel *t = trixel_buf[offset]->parent;
-	int i;
-
-	/* top level */
-	if (!t)
-		return 0;
-
-	for (i = buffer_start; i < buffer_end; i++) {
-		/* already in buffer ? */
-		if (trixel_buf[i] == t)
-			return 0;
-
-		/* not in buffer, so add */
-		if (trixel_buf[i] == NULL) {
-			trixel_buf[i] = t;
-			adb_htm_vdebug(htm, ADB_LOG_HTM_GET, "add trixel at pos %d\n", i);
-			htm_dump_trixel(htm, t);
-			return 1;
-		}
-	}
-
-	adb_htm_error(htm, "out of space");
-	return 0;
-}
-
-/**
- * \brief Recursively extract all cascading parent structures originating from an initial trixel list.
- *
- * Reverses upward through the hierarchy grabbing parents until reaching a defined minimum
- * depth ceiling. Used for constructing wide, high-level structural bounds above detailed areas.
- *
- * \param htm Spatial engine.
- * \param set Managed subset state bounds object.
- * \param buf_size Limits parameter blocking overflows.
- * \param current_depth Deepest originating starting depth constraint limit.
- * \param buffer_start Origin slice for checking.
- * \param buffer_end Trailing tail slice point.
- * \param parents Accumulated valid parent sum tracking.
- * \return Final running count of all unified mapped parents.
- */
-static int trixel_get_parents(struct htm *htm, struct adb_object_set *set,
-							  int buf_size, int current_depth, int buffer_start,
-							  int buffer_end, int parents)
-{
-	int i, new = 0;
-
-	/* finished if we are at min depth */
-	if (current_depth == set->min_depth) {
-		adb_htm_debug(htm, ADB_LOG_HTM_GET, "found %d parents to depth %d\n",
-					  parents, set->min_depth);
-		return parents;
-	}
-
-	/* add parents from last iteration */
-	for (i = buffer_start; i < buffer_end; i++) {
-		if (i == buf_size) {
-			adb_htm_error(htm, "no space for new trixels at depth\n",
-						  current_depth);
-			return parents;
-		}
-		new += trixel_add_parent(htm, set->trixels, i, buffer_end, buf_size);
-	}
-
-	/* add parents for next iteration at depth - 1 */
-	return trixel_get_parents(htm, set, buf_size, current_depth - 1, buffer_end,
-							  buffer_end + new, parents + new);
-}
-
 /**
  * \brief Recursively navigate downward returning all subdivided children from a parent context.
  *
@@ -540,8 +550,8 @@ static int trixel_get_children(struct htm *htm, struct adb_object_set *set,
 							   struct htm_trixel *parent, int buf_size,
 							   int current_depth, int buf_pos)
 {
-	/* finished ? */
-	if (current_depth++ >= set->max_depth)
+	/* finished or a sparse mesh leaf ? */
+	if (current_depth++ >= set->max_depth || !parent->child)
 		return buf_pos;
 
 	adb_htm_vdebug(htm, ADB_LOG_HTM_GET,
@@ -578,6 +588,229 @@ static int trixel_get_children(struct htm *htm, struct adb_object_set *set,
 	return buf_pos;
 }
 
+/**
+ * \brief Map an octahedron coordinate back onto the unit sphere.
+ *
+ * \param q Octahedron coordinate.
+ * \return Unit sphere coordinate.
+ */
+static inline double octa_to_unit(double q)
+{
+	if (q < 0.0)
+		return q < -1.0 ? -1.0 : -sqrt(-q);
+	return q > 1.0 ? 1.0 : sqrt(q);
+}
+
+/**
+ * \brief Get a spherical cap containing a trixel.
+ *
+ * Trixels are flat triangles on the octahedron so each octahedron coordinate
+ * is bounded by the vertices. The sphere mapping is monotonic per axis so the
+ * same bounds give a box on the sphere that contains the trixel. The box is
+ * widened by the point location tolerance so objects filed just outside the
+ * trixel edges are still covered. The cap is centred on the box and reaches
+ * the furthest box corner.
+ *
+ * \param t Trixel to bound.
+ * \param centre Output cap centre unit vector.
+ * \return Cap radius in radians.
+ */
+static double trixel_get_cap(struct htm_trixel *t, double centre[3])
+{
+	const double q[3][3] = {
+		{ t->a->x, t->b->x, t->c->x },
+		{ t->a->y, t->b->y, t->c->y },
+		{ t->a->z, t->b->z, t->c->z },
+	};
+	struct htm_vertex prod;
+	double edge, margin, lo, hi, half[3], len = 0.0, chord = 0.0;
+	int i;
+
+	/* point location accepts points up to INSIDE_UP_LIMIT past an edge */
+	vertex_cross(t->a, t->b, &prod);
+	edge = vertex_mult(&prod, &prod);
+	vertex_cross(t->b, t->c, &prod);
+	edge = fmin(edge, vertex_mult(&prod, &prod));
+	vertex_cross(t->c, t->a, &prod);
+	edge = fmin(edge, vertex_mult(&prod, &prod));
+	margin = -2.0 * INSIDE_UP_LIMIT / sqrt(edge);
+
+	for (i = 0; i < 3; i++) {
+		lo = octa_to_unit(fmin(fmin(q[i][0], q[i][1]), q[i][2]) - margin);
+		hi = octa_to_unit(fmax(fmax(q[i][0], q[i][1]), q[i][2]) + margin);
+		centre[i] = (lo + hi) / 2.0;
+		half[i] = (hi - lo) / 2.0;
+		len += centre[i] * centre[i];
+	}
+
+	/* furthest box corner from the unit cap centre */
+	len = sqrt(len);
+	for (i = 0; i < 3; i++) {
+		edge = fabs(centre[i] - centre[i] / len) + half[i];
+		chord += edge * edge;
+		centre[i] /= len;
+	}
+
+	return 2.0 * asin(fmin(1.0, sqrt(chord) / 2.0));
+}
+
+/**
+ * \brief Classify a trixel against a clipping cone.
+ *
+ * \param t Trixel to classify.
+ * \param centre Cone centre unit vector.
+ * \param fov Cone radius in radians.
+ * \return HTM_VISIBLE_NONE, HTM_VISIBLE_PARTIAL or HTM_VISIBLE_FULL.
+ */
+static int trixel_clip_visible(struct htm_trixel *t, const double centre[3],
+							   double fov)
+{
+	double cap[3], radius, dist;
+
+	radius = trixel_get_cap(t, cap);
+	dist = acos(fmax(-1.0, fmin(1.0, cap[0] * centre[0] + cap[1] * centre[1] +
+										 cap[2] * centre[2])));
+
+	if (dist - radius > fov)
+		return HTM_VISIBLE_NONE;
+	if (dist + radius <= fov)
+		return HTM_VISIBLE_FULL;
+	return HTM_VISIBLE_PARTIAL;
+}
+
+/**
+ * \brief Gather every trixel intersecting a cone down to the maximum depth.
+ *
+ * Trixels outside the cone are pruned with their children, trixels fully
+ * inside the cone add all their children without further tests.
+ *
+ * \param htm Spatial engine.
+ * \param set Container accumulating the trixels.
+ * \param t Trixel to test.
+ * \param centre Cone centre unit vector.
+ * \param fov Cone radius in radians.
+ * \param buf_pos Active write positioning marker.
+ * \return Position cursor marker indicating buffer write boundary.
+ */
+static int trixel_get_cone(struct htm *htm, struct adb_object_set *set,
+						   struct htm_trixel *t, const double centre[3],
+						   double fov, int buf_pos)
+{
+	int visible, i;
+
+	visible = trixel_clip_visible(t, centre, fov);
+	if (visible == HTM_VISIBLE_NONE)
+		return buf_pos;
+
+	set->trixels[buf_pos++] = t;
+
+	if (visible == HTM_VISIBLE_FULL)
+		return trixel_get_children(htm, set, t,
+								   htm->trixel_count - buf_pos, t->depth,
+								   buf_pos);
+
+	if (t->depth < set->max_depth && t->child) {
+		for (i = 0; i < 4; i++)
+			buf_pos = trixel_get_cone(htm, set, &t->child[i], centre, fov,
+									  buf_pos);
+	}
+
+	return buf_pos;
+}
+
+/**
+ * \brief Fill in the cache key of a clip.
+ *
+ * \param set Clipped object set.
+ * \param key Cover to set the key fields of.
+ */
+static void cover_key(struct adb_object_set *set, struct htm_cover *key)
+{
+	/* the whole sky does not depend on the centre */
+	if (set->fov >= M_PI) {
+		key->centre = 1;
+		key->boundary = 0;
+		key->fov = M_PI;
+	} else {
+		key->centre = htm_trixel_id(set->centre);
+		key->boundary =
+			set->boundary_centre ? htm_trixel_id(set->boundary_centre) : 0;
+		key->fov = set->fov;
+	}
+
+	key->min_depth = set->min_depth;
+	key->max_depth = set->max_depth;
+}
+
+/**
+ * \brief Find the cached trixel list of a clip.
+ *
+ * \param htm Spatial engine.
+ * \param set Clipped object set.
+ * \return Cached cover or NULL on a miss.
+ */
+static struct htm_cover *cover_get(struct htm *htm, struct adb_object_set *set)
+{
+	struct htm_cover key, *cover;
+	int i;
+
+	cover_key(set, &key);
+
+	for (i = 0; i < HTM_COVER_CACHE_SIZE; i++) {
+		cover = &htm->cover[i];
+		if (cover->centre == key.centre && cover->boundary == key.boundary &&
+			cover->fov == key.fov &&
+			cover->min_depth == key.min_depth &&
+			cover->max_depth == key.max_depth) {
+			cover->used = ++htm->cover_use;
+			htm->cover_hits++;
+			adb_htm_vdebug(htm, ADB_LOG_HTM_GET,
+						   "cover cache hit %lu misses %lu\n",
+						   htm->cover_hits, htm->cover_misses);
+			return cover;
+		}
+	}
+
+	htm->cover_misses++;
+	adb_htm_vdebug(htm, ADB_LOG_HTM_GET, "cover cache miss %lu hits %lu\n",
+				   htm->cover_misses, htm->cover_hits);
+	return NULL;
+}
+
+/**
+ * \brief Cache the gathered trixel list of a clip.
+ *
+ * Replaces the least recently used cover. Large covers are not cached.
+ *
+ * \param htm Spatial engine.
+ * \param set Clipped object set with gathered trixels.
+ * \param count Number of trixels.
+ */
+static void cover_put(struct htm *htm, struct adb_object_set *set, int count)
+{
+	struct htm_cover *cover = &htm->cover[0];
+	struct htm_trixel **trixels;
+	int i;
+
+	if (count > HTM_COVER_MAX_TRIXELS)
+		return;
+
+	for (i = 1; i < HTM_COVER_CACHE_SIZE; i++) {
+		if (htm->cover[i].used < cover->used)
+			cover = &htm->cover[i];
+	}
+
+	trixels = realloc(cover->trixels, (count ? count : 1) * sizeof(*trixels));
+	if (trixels == NULL)
+		return;
+
+	memcpy(trixels, set->trixels, count * sizeof(*trixels));
+	cover_key(set, cover);
+	cover->trixels = trixels;
+	cover->count = count;
+	cover->used = ++htm->cover_use;
+}
+
 /**
  * \brief Create a spatial bounding perimeter using FOV degrees and center coordinates.
  *
@@ -587,7 +820,7 @@ static int trixel_get_children(struct htm *htm, struct adb_object_set *set,
  * \param set Target clipping area configuration manager.
  * \param ra Center celestial Right Ascension marking the field middle.
  * \param dec Center celestial Declination marking the field middle.
- * \param fov Diameter Field Of View bounds.
+ * \param fov Field Of View radius.
  * \param min_depth Hard limit minimal recursive block depth tier mapping limit.
  * \param max_depth Hard limit maximal recursive block depth tier mapping limit.
  * \return 0 on successful validation, or -EINVAL on out-of-bounds inputs.
@@ -597,8 +830,16 @@ int htm_clip(struct htm *htm, struct adb_object_set *set, double ra, double dec,
 {
 	struct htm_vertex vertex;
 	struct adb_table *table = set->table;
+	const struct db_trace *trace = &table->db->trace;
 
-	bzero(set->trixels, set->valid_trixels * sizeof(struct htm_trixel *));
+	trace_begin(trace, ADB_TRACE_CLIP, 0);
+
+	/* haystacks prepared from the old clip are stale */
+	target_free_haystacks(set);
+
+	/* trixels are cleared when the next cover is gathered */
+	if (set->valid_trixels > set->stale_trixels)
+		set->stale_trixels = set->valid_trixels;
 	set->valid_trixels = 0;
 
 	set->min_depth = table_get_object_depth_min(table, min_depth);
@@ -606,7 +847,7 @@ int htm_clip(struct htm *htm, struct adb_object_set *set, double ra, double dec,
 	if (set->min_depth < 0 || set->max_depth < 0) {
 		adb_error(table->db, "invalid clip depth min %d max %d\n",
 				  set->min_depth, set->max_depth);
-		return -EINVAL;
+		return trace_end(trace, ADB_TRACE_CLIP, -EINVAL);
 	}
 
 	set->fov_depth = htm_get_depth_from_resolution(fov);
@@ -636,7 +877,7 @@ int htm_clip(struct htm *htm, struct adb_object_set *set, double ra, double dec,
 		if (count == 0) {
 			adb_htm_error(htm, " invalid trixel at %3.3f:%3.3f\n",
 						  vertex.ra * R2D, vertex.dec * R2D);
-			return -EINVAL;
+			return trace_end(trace, ADB_TRACE_CLIP, -EINVAL);
 		}
 
 		set->centre = results[0];
@@ -650,14 +891,14 @@ int htm_clip(struct htm *htm, struct adb_object_set *set, double ra, double dec,
 		}
 	}
 
-	return 0;
+	return trace_end(trace, ADB_TRACE_CLIP, 0);
 }
 
 /**
  * \brief Extract bounding trixels contained inside an initialized object set subset FOV constraint.
  *
- * Traverses spatial bounds radiating outwards from the center subset position
- * returning arrays mapping valid contained areas.
+ * Descends the HTM from the root trixels collecting every trixel that
+ * intersects the clip cone down to the set maximum depth.
  *
  * \param htm Engine configuration reference.
  * \param set Target boundaries structure requesting the map.
@@ -665,7 +906,43 @@ int htm_clip(struct htm *htm, struct adb_object_set *set, double ra, double dec,
  */
 int htm_get_trixels(struct htm *htm, struct adb_object_set *set)
 {
-	int trixels, parents, neighbours, i;
+	struct htm_cover *cover;
+	struct htm_trixel **buf;
+	double centre[3], fov;
+	int trixels, i;
+
+	/* sparse meshes may have grown since the set was created */
+	if (set->trixel_size < htm->trixel_count + 1) {
+		buf = realloc(set->trixels,
+					  (htm->trixel_count + 1) * sizeof(struct htm_trixel *));
+		if (buf == NULL)
+			return -ENOMEM;
+		bzero(buf + set->trixel_size,
+			  (htm->trixel_count + 1 - set->trixel_size) * sizeof(*buf));
+		set->trixels = buf;
+		set->trixel_size = htm->trixel_count + 1;
+	}
+
+	/* the cache is shared by clips from every thread of a frozen db */
+	pthread_mutex_lock(&htm->cover_lock);
+	cover = cover_get(htm, set);
+	if (cover) {
+		memcpy(set->trixels, cover->trixels,
+			   cover->count * sizeof(struct htm_trixel *));
+		trixels = cover->count;
+		pthread_mutex_unlock(&htm->cover_lock);
+
+		set->trixels[trixels] = NULL;
+		if (trixels + 1 > set->stale_trixels)
+			set->stale_trixels = trixels + 1;
+		set->valid_trixels = trixels;
+		return trixels;
+	}
+	pthread_mutex_unlock(&htm->cover_lock);
+
+	/* gathering relies on unused entries being NULL */
+	bzero(set->trixels, set->stale_trixels * sizeof(struct htm_trixel *));
+	set->stale_trixels = 0;
 
 	if (set->fov >= M_PI) {
 		/* get all trixels at depth 0 */
@@ -673,8 +950,6 @@ int htm_get_trixels(struct htm *htm, struct adb_object_set *set)
 					  set->fov_depth);
 
 		trixels = 0;
-		neighbours = 8;
-		parents = 0;
 
 		set->trixels[trixels++] = &htm->N[0];
 		set->trixels[trixels++] = &htm->N[1];
@@ -684,115 +959,570 @@ int htm_get_trixels(struct htm *htm, struct adb_object_set *set)
 		set->trixels[trixels++] = &htm->S[1];
 		set->trixels[trixels++] = &htm->S[2];
 		set->trixels[trixels++] = &htm->S[3];
+
+		/* get children for each trixel */
+		for (i = 0; i < 8; i++)
+			trixels = trixel_get_children(htm, set, set->trixels[i],
+										  htm->trixel_count - trixels, 0,
+										  trixels);
 	} else {
 		adb_htm_debug(htm, ADB_LOG_HTM_GET, "fov < M_PI depth %d\n",
 					  set->fov_depth);
 
-		/* get neighbours for centre trixel */
-		neighbours =
-			trixel_get_neighbours(htm, set->centre, set->fov_depth, set, 0);
-
-		/* also get neighbours for boundary trixel if present */
-		if (set->boundary_centre)
-			neighbours += trixel_get_neighbours(
-				htm, set->boundary_centre, set->fov_depth, set, neighbours);
+		/*
+		 * The cover is shared by every clip of this fov with the same home
+		 * trixel, so gather for the fov centred anywhere in the home
+		 * trixel. Clipped objects are then filtered against the exact cone.
+		 */
+		fov = set->fov + trixel_get_cap(set->centre, centre);
 
-		/* get parents for each trixel */
-		parents = trixel_get_parents(htm, set, htm->trixel_count - neighbours,
-									 set->fov_depth, 0, neighbours, 0);
-
-		trixels = neighbours + parents;
+		trixels = 0;
+		for (i = 0; i < 4; i++) {
+			trixels = trixel_get_cone(htm, set, &htm->N[i], centre, fov,
+									  trixels);
+			trixels = trixel_get_cone(htm, set, &htm->S[i], centre, fov,
+									  trixels);
+		}
 	}
 
-	/* get children for each trixel neighbour */
-	for (i = 0; i < neighbours; i++)
-		trixels = trixel_get_children(htm, set, set->trixels[i],
-									  htm->trixel_count - trixels,
-									  set->fov_depth, trixels);
-
-	adb_htm_debug(htm, ADB_LOG_HTM_GET, "trixels %d parents %d neighbours %d\n",
-				  trixels, parents, neighbours);
+	adb_htm_debug(htm, ADB_LOG_HTM_GET, "trixels %d\n", trixels);
 
 	set->trixels[trixels] = NULL;
 	set->valid_trixels = trixels;
+	set->stale_trixels = trixels + 1;
+	pthread_mutex_lock(&htm->cover_lock);
+	cover_put(htm, set, trixels);
+	pthread_mutex_unlock(&htm->cover_lock);
 	return trixels;
 }
 
 /**
- * \brief Compile heads referencing objects constrained inside a subset.
+ * \brief Order object heads by table position.
  *
- * Analyzes previously clipped trixels within an `adb_object_set` to build consolidated
- * lists of objects populating those constrained blocks.
+ * \param a First object head.
+ * \param b Second object head.
+ * \return Negative, zero or positive as a is before, at or after b.
+ */
+static int head_cmp(const void *a, const void *b)
+{
+	const struct adb_object_head *ha = a, *hb = b;
+
+	return ha->index < hb->index ? -1 : ha->index > hb->index;
+}
+
+/**
+ * \brief Sort the set object heads by table position and join adjacent runs.
  *
- * \param set Bounded configuration instance.
- * \return Valid count of objects bound by the constraints.
+ * Depth layout tables store the objects of each depth in HTM ID order, so
+ * the clip trixels of a depth that are next to each other in the table
+ * become one head and the clip reads a few long runs in table order. Trixel
+ * layout tables keep one head for each clipped trixel.
+ *
+ * \param set Clipped object set.
  */
-int htm_get_clipped_objects(struct adb_object_set *set)
+static void set_merge_heads(struct adb_object_set *set)
 {
-	struct htm *htm = set->db->htm;
-	int trixel_count = 0, populated_trixels = 0;
-	int i, object_count = 0, head_count = 0;
+	struct adb_object_head *heads = set->object_heads;
+	int i, j;
 
-	if (!set->valid_trixels)
-		trixel_count = htm_get_trixels(htm, set);
+	if (set->table->layout != ADB_TABLE_LAYOUT_DEPTH || set->head_count < 2)
+		return;
 
-	if (trixel_count < 0) {
-		adb_htm_error(htm, "invalid trixel count %d\n", trixel_count);
-		adb_htm_debug(htm, ADB_LOG_HTM_GET,
-					  "htm clip depths: min %d max %d fov %d\n", set->min_depth,
-					  set->max_depth, set->fov_depth);
-		adb_htm_debug(htm, ADB_LOG_HTM_GET, "clip fov %3.3f at ",
-					  set->fov * R2D);
-		htm_dump_trixel(htm, set->centre);
-		return -EINVAL;
+	qsort(heads, set->head_count, sizeof(*heads), head_cmp);
+
+	for (i = 1, j = 0; i < set->head_count; i++) {
+		if (heads[i].index == heads[j].index + heads[j].count)
+			heads[j].count += heads[i].count;
+		else
+			heads[++j] = heads[i];
 	}
 
-	adb_htm_debug(htm, ADB_LOG_HTM_GET, "got %d potential clipped trixels\n",
-				  trixel_count);
+	set->head_count = j + 1;
+}
 
-	/* get object head for every clipped trixel */
-	for (i = 0; i < set->valid_trixels; i++) {
-		adb_htm_vdebug(
-			htm, ADB_LOG_HTM_GET,
-			"trixels got %d count %d pos %x objects %d parent pos %x\n",
-			trixel_count, i, set->trixels[i]->position,
-			set->trixels[i]->data[set->table_id].num_objects,
-			set->trixels[i]->parent ? set->trixels[i]->parent->position : 0);
-		adb_htm_vdebug(
-			htm, ADB_LOG_HTM_GET,
-			" RA %3.3f DEC %3.3f RA %3.3f DEC %3.3f RA %3.3f DEC %3.3f\n",
-			set->trixels[i]->a->ra * R2D, set->trixels[i]->a->dec * R2D,
-			set->trixels[i]->b->ra * R2D, set->trixels[i]->b->dec * R2D,
-			set->trixels[i]->c->ra * R2D, set->trixels[i]->c->dec * R2D);
+/**
+ * \brief Append a run of contiguous objects to the set object heads.
+ *
+ * \param set Object set receiving the head.
+ * \param objects First object in the run.
+ * \param count Number of objects in the run.
+ * \return 0 on success or -ENOMEM.
+ */
+static int set_add_head(struct adb_object_set *set, const void *objects,
+						int count)
+{
+	struct adb_object_head *heads;
+
+	if (set->head_count == set->head_size) {
+		heads = realloc(set->object_heads,
+						set->head_size * 2 * sizeof(*heads));
+		if (heads == NULL)
+			return -ENOMEM;
+		set->object_heads = heads;
+		set->head_size *= 2;
+	}
+
+	set->object_heads[set->head_count].objects = objects;
+	set->object_heads[set->head_count].index =
+		((const char *)objects - (const char *)set->table->objects) /
+		set->table->object.bytes;
+	set->object_heads[set->head_count++].count = count;
+	set->count += count;
+	return 0;
+}
+
+/**
+ * \brief Classify a trixel against the clipping polygon edges.
+ *
+ * \param set Object set with polygon edges.
+ * \param t Trixel to classify.
+ * \return HTM_VISIBLE_NONE, HTM_VISIBLE_PARTIAL or HTM_VISIBLE_FULL.
+ */
+static int trixel_polygon_visible(struct adb_object_set *set,
+								  struct htm_trixel *t)
+{
+	double cap[3], radius, dist;
+	int i, visible = HTM_VISIBLE_FULL;
+
+	radius = trixel_get_cap(t, cap);
+
+	/* angular distance of the cap centre inside each edge great circle */
+	for (i = 0; i < set->edges; i++) {
+		dist = asin(fmax(-1.0, fmin(1.0, set->edge[i][0] * cap[0] +
+											 set->edge[i][1] * cap[1] +
+											 set->edge[i][2] * cap[2])));
+		if (dist + radius < 0.0)
+			return HTM_VISIBLE_NONE;
+		if (dist - radius < 0.0)
+			visible = HTM_VISIBLE_PARTIAL;
+	}
+
+	return visible;
+}
+
+/**
+ * \brief Check if a unit vector is inside the set clipping region.
+ *
+ * \param set Object set being clipped.
+ * \param p Unit vector to test.
+ * \param centre Cone centre unit vector.
+ * \param cos_fov Cosine of the cone radius.
+ * \return 1 if the unit vector is inside, 0 otherwise.
+ */
+static int set_point_visible(struct adb_object_set *set, const double p[3],
+							 const double centre[3], double cos_fov)
+{
+	int i;
+
+	/* polygons are the intersection of their inner edge hemispheres */
+	if (set->edges) {
+		for (i = 0; i < set->edges; i++) {
+			if (set->edge[i][0] * p[0] + set->edge[i][1] * p[1] +
+					set->edge[i][2] * p[2] <
+				0.0)
+				return 0;
+		}
+		return 1;
+	}
+
+	return p[0] * centre[0] + p[1] * centre[1] + p[2] * centre[2] >= cos_fov;
+}
+
+/**
+ * \brief Append an object to the run of visible objects being built.
+ *
+ * \param set Object set receiving the heads.
+ * \param object Visible object.
+ * \param pos Object position in the trixel.
+ * \param run First object of the current run.
+ * \param count Objects in the current run.
+ * \param next Position that extends the current run.
+ * \return 0 on success or -ENOMEM.
+ */
+static int set_add_run(struct adb_object_set *set, const char *object,
+					   int pos, const char **run, int *count, int *next)
+{
+	int err;
+
+	if (*count && pos == *next) {
+		(*count)++;
+	} else {
+		if (*count) {
+			err = set_add_head(set, *run, *count);
+			if (err < 0)
+				return err;
+		}
+		*run = object;
+		*count = 1;
+	}
+
+	*next = pos + 1;
+	return 0;
+}
+
+/**
+ * \brief Add the objects of a partially visible trixel inside the clip.
+ *
+ * Cone clips select the objects inside the cone with the SIMD kernels over
+ * the table unit vector arrays. Without the arrays, or for polygons, the
+ * objects in the clip declination band are selected from the objects and
+ * then tested against the cone or polygon. Each contiguous run of visible
+ * objects becomes an object head.
+ *
+ * \param set Object set receiving the heads.
+ * \param data Trixel object data for the set table.
+ * \param centre Cone centre unit vector.
+ * \param cos_fov Cosine of the cone radius.
+ * \return 0 on success or -ENOMEM.
+ */
+static int set_add_partial(struct adb_object_set *set,
+						   struct htm_trixel_data *data,
+						   const double centre[3], double cos_fov)
+{
+	const struct table_columns *columns = table_get_columns(set->table);
+	const int bytes = set->table->object.bytes;
+	const char *objects = (const char *)data->objects, *run = NULL;
+	double min_dec = -M_PI, max_dec = M_PI, p[3], cos_dec;
+	int index[SIMD_CHUNK], i, j, k, n, len, next = -1, count = 0, base = 0;
+	int err;
+
+	if (columns)
+		base = (objects - (const char *)set->table->objects) / bytes;
+
+	if (!set->edges) {
+		min_dec = set->centre_dec - set->fov - 1.0e-9;
+		max_dec = set->centre_dec + set->fov + 1.0e-9;
+	}
+
+	for (i = 0; i < data->num_objects; i += SIMD_CHUNK) {
+		len = data->num_objects - i;
+		if (len > SIMD_CHUNK)
+			len = SIMD_CHUNK;
+
+		/* the cone kernel is exact, no per object test needed */
+		if (columns && !set->edges) {
+			k = base + i;
+			n = simd_select_cone(columns->x + k, columns->y + k,
+								 columns->z + k, len, centre, cos_fov, index);
+			for (j = 0; j < n; j++) {
+				err = set_add_run(set, objects + (size_t)(i + index[j]) * bytes,
+								  i + index[j], &run, &count, &next);
+				if (err < 0)
+					return err;
+			}
+			continue;
+		}
+
+		n = simd_select_dec(objects + (size_t)i * bytes, len, bytes, min_dec,
+							max_dec, index);
+
+		for (j = 0; j < n; j++) {
+			const char *object = objects + (size_t)(i + index[j]) * bytes;
+			const struct adb_object *o = (const void *)object;
+
+			if (columns) {
+				k = base + i + index[j];
+				p[0] = columns->x[k];
+				p[1] = columns->y[k];
+				p[2] = columns->z[k];
+			} else {
+				cos_dec = cos(o->dec);
+				p[0] = cos_dec * sin(o->ra);
+				p[1] = sin(o->dec);
+				p[2] = cos_dec * cos(o->ra);
+			}
+
+			if (!set_point_visible(set, p, centre, cos_fov))
+				continue;
+
+			err = set_add_run(set, object, i + index[j], &run, &count, &next);
+			if (err < 0)
+				return err;
+		}
+	}
+
+	if (count)
+		return set_add_head(set, run, count);
+	return 0;
+}
+
+/**
+ * \brief Classify a gathered trixel against the set clipping region.
+ *
+ * \param set Object set being clipped.
+ * \param t Trixel to classify.
+ * \param centre Cone centre unit vector.
+ * \return HTM_VISIBLE_NONE, HTM_VISIBLE_PARTIAL or HTM_VISIBLE_FULL.
+ */
+static int set_trixel_visible(struct adb_object_set *set, struct htm_trixel *t,
+							  const double centre[3])
+{
+	if (set->edges)
+		return trixel_polygon_visible(set, t);
+	if (set->fov < M_PI)
+		return trixel_clip_visible(t, centre, set->fov);
+	return HTM_VISIBLE_FULL;
+}
+
+/**
+ * \brief Add the objects of a visible trixel to the set object heads.
+ *
+ * Trixels outside the set depth limits or without objects of the set table
+ * are skipped.
+ *
+ * \param set Object set receiving the heads.
+ * \param t Visible trixel.
+ * \param visible HTM_VISIBLE_PARTIAL or HTM_VISIBLE_FULL.
+ * \param centre Cone centre unit vector.
+ * \param cos_fov Cosine of the cone radius.
+ * \return 1 if objects were added, 0 if skipped or a negative error code.
+ */
+static int set_add_trixel(struct adb_object_set *set, struct htm_trixel *t,
+						  int visible, const double centre[3], double cos_fov)
+{
+	struct htm_trixel_data *data;
+	int err;
+
+	if (t->depth < set->min_depth || t->depth > set->max_depth)
+		return 0;
+
+	if (!htm_trixel_num_objects(t, set->table_id))
+		return 0;
+	data = &t->data[set->table_id];
+
+	/* fault in objects for lazily loaded tables */
+	if (table_load_trixel(set->table, t) < 0)
+		return -EIO;
+
+	/* fully visible trixels skip the per object test */
+	if (visible == HTM_VISIBLE_FULL)
+		err = set_add_head(set, data->objects, data->num_objects);
+	else
+		err = set_add_partial(set, data, centre, cos_fov);
+
+	return err < 0 ? err : 1;
+}
+
+/**
+ * \brief Get the cone centre unit vector and radius cosine of a clip.
+ *
+ * Whole sky clips need no classification and keep the defaults.
+ *
+ * \param set Clipped object set.
+ * \param centre Output cone centre unit vector.
+ * \param cos_fov Output cosine of the cone radius.
+ */
+static void set_get_cone(struct adb_object_set *set, double centre[3],
+						 double *cos_fov)
+{
+	double cos_dec;
+
+	centre[0] = centre[1] = centre[2] = 0.0;
+	*cos_fov = -1.0;
+
+	if (set->fov < M_PI) {
+		cos_dec = cos(set->centre_dec);
+		centre[0] = cos_dec * sin(set->centre_ra);
+		centre[1] = sin(set->centre_dec);
+		centre[2] = cos_dec * cos(set->centre_ra);
+		*cos_fov = cos(set->fov);
+	}
+}
+
+/**
+ * \brief Compile heads referencing objects constrained inside a subset.
+ *
+ * Analyzes previously clipped trixels within an `adb_object_set` to build consolidated
+ * lists of objects populating those constrained blocks. Each trixel is
+ * classified against the clipping cone or polygon: outside trixels are
+ * dropped, fully visible trixels add all their objects as one head and
+ * partially visible trixels add a head for each run of objects inside.
+ *
+ * \param set Bounded configuration instance.
+ * \return Number of object heads bound by the constraints.
+ */
+static int set_get_clipped_objects(struct adb_object_set *set)
+{
+	struct htm *htm = set->db->htm;
+	double centre[3], cos_fov;
+	int trixel_count = 0, populated_trixels = 0;
+	int i, visible, err, full = 0, partial = 0;
+
+	if (!set->valid_trixels)
+		trixel_count = htm_get_trixels(htm, set);
+
+	if (trixel_count < 0) {
+		adb_htm_error(htm, "invalid trixel count %d\n", trixel_count);
+		adb_htm_debug(htm, ADB_LOG_HTM_GET,
+					  "htm clip depths: min %d max %d fov %d\n", set->min_depth,
+					  set->max_depth, set->fov_depth);
+		adb_htm_debug(htm, ADB_LOG_HTM_GET, "clip fov %3.3f at ",
+					  set->fov * R2D);
+		htm_dump_trixel(htm, set->centre);
+		return -EINVAL;
+	}
+
+	adb_htm_debug(htm, ADB_LOG_HTM_GET, "got %d potential clipped trixels\n",
+				  trixel_count);
+
+	set_get_cone(set, centre, &cos_fov);
+
+	set->count = 0;
+	set->head_count = 0;
+
+	/* get object heads for every visible clipped trixel */
+	for (i = 0; i < set->valid_trixels; i++) {
+		adb_htm_vdebug(
+			htm, ADB_LOG_HTM_GET,
+			"trixels got %d count %d pos %x objects %d parent pos %x\n",
+			trixel_count, i, set->trixels[i]->position,
+			htm_trixel_num_objects(set->trixels[i], set->table_id),
+			set->trixels[i]->parent ? set->trixels[i]->parent->position : 0);
+		adb_htm_vdebug(
+			htm, ADB_LOG_HTM_GET,
+			" RA %3.3f DEC %3.3f RA %3.3f DEC %3.3f RA %3.3f DEC %3.3f\n",
+			set->trixels[i]->a->ra * R2D, set->trixels[i]->a->dec * R2D,
+			set->trixels[i]->b->ra * R2D, set->trixels[i]->b->dec * R2D,
+			set->trixels[i]->c->ra * R2D, set->trixels[i]->c->dec * R2D);
 		//htm_dump_trixel_objects(htm, set->trixels[i], 0);
 
 		if (set->trixels[i]->depth < set->min_depth ||
-			set->trixels[i]->depth > set->max_depth)
+			set->trixels[i]->depth > set->max_depth ||
+			!htm_trixel_num_objects(set->trixels[i], set->table_id))
 			continue;
 
-		if (set->trixels[i]->data[set->table_id].num_objects == 0)
+		visible = set_trixel_visible(set, set->trixels[i], centre);
+		if (visible == HTM_VISIBLE_NONE)
 			continue;
 
-		set->object_heads[populated_trixels].objects =
-			set->trixels[i]->data[set->table_id].objects;
-		set->object_heads[populated_trixels++].count =
-			set->trixels[i]->data[set->table_id].num_objects;
-		object_count += set->trixels[i]->data[set->table_id].num_objects;
-		head_count++;
+		err = set_add_trixel(set, set->trixels[i], visible, centre, cos_fov);
+		if (err < 0)
+			return err;
+
+		if (visible == HTM_VISIBLE_FULL)
+			full++;
+		else
+			partial++;
+		populated_trixels++;
 	}
 
+	set_merge_heads(set);
+
 	adb_htm_debug(htm, ADB_LOG_HTM_GET,
-				  "got %d populated trixels with %d objects\n",
-				  populated_trixels, object_count);
+				  "got %d populated trixels (%d full %d partial) with %d "
+				  "objects in %d heads\n",
+				  populated_trixels, full, partial, set->count,
+				  set->head_count);
 	adb_htm_debug(htm, ADB_LOG_HTM_GET,
 				  "htm clip depths: min %d max %d fov depth %d\n",
 				  set->min_depth, set->max_depth, set->fov_depth);
 	adb_htm_debug(htm, ADB_LOG_HTM_GET, "clip fov %3.3f\n", set->fov * R2D);
 
-	set->count = object_count;
-	set->head_count = head_count;
+	stats_add(&set->db->stats, STATS_CLIPS, 1);
+	stats_add(&set->db->stats, STATS_TRIXELS, set->valid_trixels);
+	stats_add(&set->db->stats, STATS_HEADS, set->head_count);
+	return set->head_count;
+}
+
+/**
+ * \brief Compile the object heads of a set, traced.
+ *
+ * \param set Bounded configuration instance.
+ * \return Number of object heads bound by the constraints.
+ */
+int htm_get_clipped_objects(struct adb_object_set *set)
+{
+	trace_begin(&set->db->trace, ADB_TRACE_CLIPPED_OBJECTS, 0);
+	return trace_end(&set->db->trace, ADB_TRACE_CLIPPED_OBJECTS,
+					 set_get_clipped_objects(set));
+}
+
+/**
+ * \brief Compile the object heads of several tables clipped by one cone.
+ *
+ * The sets must share one cone clip. The cover is gathered once, at the
+ * depth of the shallowest and deepest set, and each trixel is classified
+ * once and then adds the objects of every set table it holds.
+ *
+ * \param sets Object sets clipped by the same cone.
+ * \param count Number of object sets.
+ * \return Number of object heads in all the sets or a negative error code.
+ */
+int htm_get_clipped_multi(struct adb_object_set *sets[], int count)
+{
+	struct adb_object_set *set = sets[0];
+	struct htm *htm = set->db->htm;
+	double centre[3], cos_fov;
+	int min_depth, max_depth, trixels, heads = 0, populated = 0;
+	int i, j, visible, err, added;
+
+	/* the deepest cover holds the cover of every set */
+	min_depth = set->min_depth;
+	max_depth = set->max_depth;
+	for (i = 1; i < count; i++) {
+		if (sets[i]->min_depth < set->min_depth)
+			set->min_depth = sets[i]->min_depth;
+		if (sets[i]->max_depth > set->max_depth)
+			set->max_depth = sets[i]->max_depth;
+	}
+
+	trixels = htm_get_trixels(htm, set);
+	set->min_depth = min_depth;
+	set->max_depth = max_depth;
+	if (trixels < 0) {
+		adb_htm_error(htm, "invalid trixel count %d\n", trixels);
+		return -EINVAL;
+	}
+
+	/* every set keeps a copy so it can be fetched on its own */
+	for (i = 1; i < count; i++) {
+		if (sets[i]->valid_trixels > sets[i]->stale_trixels)
+			sets[i]->stale_trixels = sets[i]->valid_trixels;
+		memcpy(sets[i]->trixels, set->trixels,
+			   (trixels + 1) * sizeof(struct htm_trixel *));
+		if (trixels + 1 > sets[i]->stale_trixels)
+			sets[i]->stale_trixels = trixels + 1;
+		sets[i]->valid_trixels = trixels;
+	}
+
+	set_get_cone(set, centre, &cos_fov);
+
+	for (i = 0; i < count; i++) {
+		sets[i]->count = 0;
+		sets[i]->head_count = 0;
+	}
+
+	for (i = 0; i < trixels; i++) {
+		visible = set_trixel_visible(set, set->trixels[i], centre);
+		if (visible == HTM_VISIBLE_NONE)
+			continue;
+
+		added = 0;
+		for (j = 0; j < count; j++) {
+			err = set_add_trixel(sets[j], set->trixels[i], visible, centre,
+								 cos_fov);
+			if (err < 0)
+				return err;
+			added += err;
+		}
+		if (added)
+			populated++;
+	}
+
+	for (i = 0; i < count; i++) {
+		set_merge_heads(sets[i]);
+		heads += sets[i]->head_count;
+	}
+
+	adb_htm_debug(htm, ADB_LOG_HTM_GET,
+				  "got %d populated trixels of %d tables in %d heads\n",
+				  populated, count, heads);
 
-	return populated_trixels;
+	stats_add(&set->db->stats, STATS_CLIPS, 1);
+	stats_add(&set->db->stats, STATS_TRIXELS, trixels);
+	stats_add(&set->db->stats, STATS_HEADS, heads);
+
+	return heads;
 }
 
 /**
@@ -820,6 +1550,18 @@ struct adb_object_set *adb_table_set_new(struct adb_db *db, int table_id)
 	if (set == NULL)
 		return NULL;
 
+	/* remote sets are clipped by the query daemon */
+	if (db->remote) {
+		set->db = db;
+		set->table = table;
+		set->table_id = table_id;
+		if (remote_set_new(set) < 0) {
+			free(set);
+			return NULL;
+		}
+		return set;
+	}
+
 	/* alloc clipped trixels */
 	set->trixels =
 		calloc(1, (db->htm->trixel_count + 1) * sizeof(struct htm_trixel *));
@@ -827,9 +1569,11 @@ struct adb_object_set *adb_table_set_new(struct adb_db *db, int table_id)
 		free(set);
 		return NULL;
 	}
+	set->trixel_size = db->htm->trixel_count + 1;
 
+	set->head_size = db->htm->trixel_count;
 	set->object_heads =
-		calloc(1, db->htm->trixel_count * sizeof(struct adb_object_head));
+		calloc(1, set->head_size * sizeof(struct adb_object_head));
 	if (set->object_heads == NULL) {
 		free(set->trixels);
 		free(set);
@@ -853,6 +1597,13 @@ struct adb_object_set *adb_table_set_new(struct adb_db *db, int table_id)
 int adb_table_set_constraints(struct adb_object_set *set, double ra, double dec,
 							  double fov, double start, double end)
 {
+	if (set->remote)
+		return remote_set_constraints(set, ra, dec, fov, start, end);
+
+	free(set->edge);
+	set->edge = NULL;
+	set->edges = 0;
+
 	set->centre_ra = ra;
 	set->centre_dec = dec;
 	set->fov = fov;
@@ -861,6 +1612,300 @@ int adb_table_set_constraints(struct adb_object_set *set, double ra, double dec,
 					set->fov, start, end);
 }
 
+/**
+ * \brief Append a run of table objects to the set delta heads.
+ *
+ * \param set Re-clipped object set.
+ * \param index Table position of the first object.
+ * \param count Number of objects in the run.
+ * \return 0 on success or -ENOMEM.
+ */
+static int set_add_delta(struct adb_object_set *set, unsigned int index,
+						 unsigned int count)
+{
+	struct adb_object_head *heads;
+	int size;
+
+	if (set->delta_count == set->delta_size) {
+		size = set->delta_size ? set->delta_size * 2 : 64;
+		heads = realloc(set->delta, size * sizeof(*heads));
+		if (heads == NULL)
+			return -ENOMEM;
+		set->delta = heads;
+		set->delta_size = size;
+	}
+
+	set->delta[set->delta_count].objects =
+		(const char *)set->table->objects + index * set->table->object.bytes;
+	set->delta[set->delta_count].index = index;
+	set->delta[set->delta_count++].count = count;
+	return 0;
+}
+
+/**
+ * \brief Add the parts of heads not covered by other heads to the delta.
+ *
+ * Both head lists are sorted by table position and hold disjoint runs, so
+ * one merge pass cuts every other run out of the heads.
+ *
+ * \param set Re-clipped object set.
+ * \param heads Sorted heads to keep parts of.
+ * \param count Number of heads.
+ * \param other Sorted heads to cut out.
+ * \param other_count Number of other heads.
+ * \return 0 on success or -ENOMEM.
+ */
+static int set_diff_heads(struct adb_object_set *set,
+						  const struct adb_object_head *heads, int count,
+						  const struct adb_object_head *other, int other_count)
+{
+	unsigned int start, end;
+	int i, j = 0, k, err;
+
+	for (i = 0; i < count; i++) {
+		start = heads[i].index;
+		end = start + heads[i].count;
+
+		/* skip other runs ending before this run */
+		while (j < other_count && other[j].index + other[j].count <= start)
+			j++;
+
+		for (k = j; k < other_count && other[k].index < end; k++) {
+			if (other[k].index > start) {
+				err = set_add_delta(set, start, other[k].index - start);
+				if (err < 0)
+					return err;
+			}
+			start = other[k].index + other[k].count;
+		}
+
+		if (start < end) {
+			err = set_add_delta(set, start, end - start);
+			if (err < 0)
+				return err;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Copy the set object heads sorted by table position.
+ *
+ * \param set Clipped object set.
+ * \param heads Output sorted heads, NULL for no heads.
+ * \return Number of heads or -ENOMEM.
+ */
+static int set_sorted_heads(struct adb_object_set *set,
+							struct adb_object_head **heads)
+{
+	*heads = NULL;
+	if (set->head_count == 0)
+		return 0;
+
+	*heads = malloc(set->head_count * sizeof(**heads));
+	if (*heads == NULL)
+		return -ENOMEM;
+
+	memcpy(*heads, set->object_heads, set->head_count * sizeof(**heads));
+	qsort(*heads, set->head_count, sizeof(**heads), head_cmp);
+	return set->head_count;
+}
+
+/**
+ * \brief Move the cone of a set and get the objects that entered and left.
+ * \ingroup htm
+ *
+ * The new clip is gathered as usual, the cover cache making a small pan
+ * cheap, and its heads are then diffed against the heads of the previous
+ * clip on table position. Objects in both clips are never reported, so a
+ * consumer updates only the runs that entered or left the field.
+ *
+ * \param set Dataset object set to re-clip
+ * \param ra Cone centre Right Ascension in radians
+ * \param dec Cone centre Declination in radians
+ * \param fov Cone radius in radians
+ * \param start Minimum magnitude limit
+ * \param end Maximum magnitude limit
+ * \param delta Output heads added and removed
+ * \return Number of object heads in the new clip or a negative error code
+ */
+int adb_table_set_reclip(struct adb_object_set *set, double ra, double dec,
+						 double fov, double start, double end,
+						 struct adb_set_delta *delta)
+{
+	struct adb_object_head *old = NULL, *heads = NULL;
+	int old_count = 0, count, added, ret;
+
+	if (delta == NULL)
+		return -EINVAL;
+	memset(delta, 0, sizeof(*delta));
+
+	if (set->remote)
+		return -EOPNOTSUPP;
+
+	/* heads of the previous clip, if they were fetched */
+	if (set->valid_trixels) {
+		old_count = set_sorted_heads(set, &old);
+		if (old_count < 0)
+			return old_count;
+	}
+
+	ret = adb_table_set_constraints(set, ra, dec, fov, start, end);
+	if (ret < 0)
+		goto out;
+
+	ret = htm_get_clipped_objects(set);
+	if (ret < 0)
+		goto out;
+
+	count = set_sorted_heads(set, &heads);
+	if (count < 0) {
+		ret = count;
+		goto out;
+	}
+
+	set->delta_count = 0;
+	ret = set_diff_heads(set, heads, count, old, old_count);
+	if (ret < 0)
+		goto out;
+	added = set->delta_count;
+	ret = set_diff_heads(set, old, old_count, heads, count);
+	if (ret < 0)
+		goto out;
+
+	delta->added = set->delta;
+	delta->added_count = added;
+	delta->removed = set->delta + added;
+	delta->removed_count = set->delta_count - added;
+	ret = set->head_count;
+
+out:
+	free(old);
+	free(heads);
+	return ret;
+}
+
+/**
+ * \brief Constrain a dataset object subset to a convex spherical polygon.
+ * \ingroup htm
+ *
+ * Polygon edges are great circles between consecutive vertices and the last
+ * vertex joins the first. Vertices may wind either way. The HTM cover is
+ * gathered for the cone circumscribing the polygon and trixels are then
+ * classified against the edges.
+ *
+ * \param set Dataset object set to constrain
+ * \param ra Vertex Right Ascensions in radians
+ * \param dec Vertex Declinations in radians
+ * \param count Number of vertices, at least 3
+ * \param start Minimum magnitude limit
+ * \param end Maximum magnitude limit
+ * \return 0 on success, -EINVAL for degenerate or non convex polygons or
+ * -ENOMEM
+ */
+int adb_table_set_polygon(struct adb_object_set *set, const double ra[],
+						  const double dec[], int count, double start,
+						  double end)
+{
+	double (*vertex)[3], (*edge)[3], centre[3] = { 0.0, 0.0, 0.0 };
+	double cos_dec, len, dot, sign = 0.0, fov = 0.0;
+	int i, j, k, err = -EINVAL;
+
+	if (ra == NULL || dec == NULL || count < 3)
+		return -EINVAL;
+	err = db_check_local(set->db);
+	if (err < 0)
+		return err;
+	err = -EINVAL;
+
+	vertex = calloc(count, sizeof(*vertex));
+	edge = calloc(count, sizeof(*edge));
+	if (vertex == NULL || edge == NULL) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		cos_dec = cos(dec[i]);
+		vertex[i][0] = cos_dec * sin(ra[i]);
+		vertex[i][1] = sin(dec[i]);
+		vertex[i][2] = cos_dec * cos(ra[i]);
+		for (k = 0; k < 3; k++)
+			centre[k] += vertex[i][k];
+	}
+
+	/* edge normals, every other vertex must be on the same side */
+	for (i = 0; i < count; i++) {
+		j = (i + 1) % count;
+		edge[i][0] = vertex[i][1] * vertex[j][2] - vertex[i][2] * vertex[j][1];
+		edge[i][1] = vertex[i][2] * vertex[j][0] - vertex[i][0] * vertex[j][2];
+		edge[i][2] = vertex[i][0] * vertex[j][1] - vertex[i][1] * vertex[j][0];
+
+		len = sqrt(edge[i][0] * edge[i][0] + edge[i][1] * edge[i][1] +
+				   edge[i][2] * edge[i][2]);
+		if (len < 1.0e-12) {
+			adb_error(set->db, "polygon edge %d is degenerate\n", i);
+			goto out;
+		}
+		for (k = 0; k < 3; k++)
+			edge[i][k] /= len;
+
+		for (j = 0; j < count; j++) {
+			dot = edge[i][0] * vertex[j][0] + edge[i][1] * vertex[j][1] +
+				  edge[i][2] * vertex[j][2];
+			if (fabs(dot) < 1.0e-12)
+				continue;
+			if (sign == 0.0)
+				sign = dot > 0.0 ? 1.0 : -1.0;
+			else if (dot * sign < 0.0) {
+				adb_error(set->db, "polygon is not convex at edge %d\n", i);
+				goto out;
+			}
+		}
+	}
+
+	len = sqrt(centre[0] * centre[0] + centre[1] * centre[1] +
+			   centre[2] * centre[2]);
+	if (sign == 0.0 || len < 1.0e-12) {
+		adb_error(set->db, "polygon has no area\n");
+		goto out;
+	}
+
+	/* point edge normals inside and find the circumscribing cone */
+	for (i = 0; i < count; i++) {
+		for (k = 0; k < 3; k++)
+			edge[i][k] *= sign;
+		dot = (vertex[i][0] * centre[0] + vertex[i][1] * centre[1] +
+			   vertex[i][2] * centre[2]) /
+			  len;
+		fov = fmax(fov, acos(fmax(-1.0, fmin(1.0, dot))));
+	}
+
+	/* caps reaching a hemisphere may not contain the polygon */
+	if (fov >= M_PI_2)
+		fov = 2.0 * M_PI;
+
+	free(set->edge);
+	set->edge = edge;
+	set->edges = count;
+	edge = NULL;
+
+	set->centre_ra = atan2(centre[0], centre[2]);
+	if (set->centre_ra < 0.0)
+		set->centre_ra += 2.0 * M_PI;
+	set->centre_dec = asin(centre[1] / len);
+	set->fov = fov;
+
+	err = htm_clip(set->db->htm, set, set->centre_ra, set->centre_dec,
+				   set->fov, start, end);
+
+out:
+	free(vertex);
+	free(edge);
+	return err;
+}
+
 /**
  * \brief Free a dataset object subset allocation.
  * \ingroup htm
@@ -875,6 +1920,13 @@ void adb_table_set_free(struct adb_object_set *set)
 	if (set == NULL)
 		return;
 
+	if (set->remote)
+		remote_set_free(set);
+	target_free_haystacks(set);
+	hash_free_set_maps(set);
+	free(set->aggregates);
+	free(set->delta);
+	free(set->edge);
 	free(set->object_heads);
 	free(set->trixels);
 	free(set);
@@ -885,18 +1937,21 @@ void adb_table_set_free(struct adb_object_set *set)
  * \ingroup htm
  *
  * Reads or utilizes previously clipped HTM trixels within the dataset
- * set's declared spatial bounds, returning the number of valid constrained
- * trixels mapped for examination.
+ * set's declared spatial bounds, returning the number of object heads
+ * holding the objects inside the clipping cone.
  *
  * \param set Configured dataset set object boundary
- * \return The number of populated object head trixels, or a negative error code
+ * \return The number of object heads, or a negative error code
  */
 int adb_set_get_objects(struct adb_object_set *set)
 {
+	if (set->remote)
+		return remote_set_get_objects(set);
+
 	/* check for previous "get" since trixels will still be valid */
 	if (set->valid_trixels) {
 		adb_debug(set->db, ADB_LOG_HTM_GET, "using existing clipped trixels\n");
-		return set->valid_trixels;
+		return set->head_count;
 	}
 
 	/* get trixels from HTM */
@@ -905,107 +1960,403 @@ int adb_set_get_objects(struct adb_object_set *set)
 	return htm_get_clipped_objects(set);
 }
 
-struct adb_object_head *adb_set_get_head(struct adb_object_set *set)
+/*! \struct bright_heap
+ * \brief Brightest objects kept while walking the clip depths
+ * \ingroup htm
+ *
+ * A max heap on magnitude, so the faintest kept object is object[0].
+ */
+struct bright_heap {
+	const struct adb_object **object; /*!< kept objects */
+	int size; /*!< heap capacity */
+	int count; /*!< objects in heap */
+};
+
+/**
+ * \brief Offer an object to the brightest kept objects.
+ *
+ * \param heap Brightest objects.
+ * \param object Object to offer.
+ */
+static void bright_heap_add(struct bright_heap *heap,
+							const struct adb_object *object)
 {
-	return set->object_heads;
+	const struct adb_object **o = heap->object;
+	float mag = object->mag;
+	int i, child;
+
+	/* objects without a magnitude are never the brightest */
+	if (isnan(mag))
+		return;
+
+	if (heap->count < heap->size) {
+		/* sift up */
+		for (i = heap->count++; i > 0; i = (i - 1) / 2) {
+			if (o[(i - 1) / 2]->mag >= mag)
+				break;
+			o[i] = o[(i - 1) / 2];
+		}
+		o[i] = object;
+		return;
+	}
+
+	if (mag >= o[0]->mag)
+		return;
+
+	/* replace the faintest object and sift down */
+	for (i = 0; (child = 2 * i + 1) < heap->count; i = child) {
+		if (child + 1 < heap->count && o[child + 1]->mag > o[child]->mag)
+			child++;
+		if (o[child]->mag <= mag)
+			break;
+		o[i] = o[child];
+	}
+	o[i] = object;
 }
 
-int adb_set_get_count(struct adb_object_set *set)
+/**
+ * \brief Sort the kept objects brightest first.
+ *
+ * \param heap Brightest objects.
+ */
+static void bright_heap_sort(struct bright_heap *heap)
 {
-	return set->count;
+	const struct adb_object **o = heap->object, *object;
+	int count = heap->count, i, child;
+
+	while (count > 1) {
+		/* move the faintest object to the end and sift down the last */
+		object = o[--count];
+		o[count] = o[0];
+		for (i = 0; (child = 2 * i + 1) < count; i = child) {
+			if (child + 1 < count && o[child + 1]->mag > o[child]->mag)
+				child++;
+			if (o[child]->mag <= object->mag)
+				break;
+			o[i] = o[child];
+		}
+		o[i] = object;
+	}
 }
 
 /**
- * \brief Retrieve a key-matching index offset mapping to the hash definition arrays.
+ * \brief Get the brightest objects inside the set clip.
+ * \ingroup htm
  *
- * \param set The subset collection being queried.
- * \param key Desired property mapping symbolic string.
- * \return Discovered mapped integer layout identifier, or -EINVAL on miss.
+ * Objects are bucketed on magnitude into HTM depths, every object at a depth
+ * being fainter than the objects at shallower depths. The clip depths are
+ * walked shallow to deep, gathering the cover only down to the depth being
+ * walked, and the walk stops at the first depth that completes the N
+ * brightest objects, so fainter deeper trixels are never gathered or loaded.
+ *
+ * The set object heads hold the objects of the walked depths afterwards, and
+ * the next adb_set_get_objects() clips the set again.
+ *
+ * \param set Constrained dataset object set
+ * \param n Number of objects wanted
+ * \param objects Output array of at least n objects, brightest first
+ * \return Number of objects, less than n if the clip has fewer, or a
+ * negative error code
  */
-static int set_get_hashmap(struct adb_object_set *set, const char *key)
+int adb_set_get_brightest(struct adb_object_set *set, int n,
+						  const struct adb_object *objects[])
 {
-	int i;
+	struct htm *htm = set->db->htm;
+	struct bright_heap heap;
+	const char *object;
+	double centre[3], cos_fov;
+	int min_depth = set->min_depth, max_depth = set->max_depth;
+	int depth, trixels, visible, heads, visited = 0, err = 0, i;
+	unsigned int k;
+
+	if (n <= 0 || objects == NULL)
+		return -EINVAL;
+	err = db_check_local(set->db);
+	if (err < 0)
+		return err;
+
+	heap.object = objects;
+	heap.size = n;
+	heap.count = 0;
+
+	set_get_cone(set, centre, &cos_fov);
+	set->count = 0;
+	set->head_count = 0;
+
+	for (depth = min_depth; depth <= max_depth; depth++) {
+		/* objects are imported strictly inside their depth band */
+		if (set->table->depth_map[depth].min_value >=
+			set->table->depth_map[depth].max_value)
+			continue;
 
-	for (i = 0; i < set->hash.num; i++) {
-		if (!strcmp(key, set->hash.map[i].key))
-			return i;
+		/* the cover down to this depth */
+		set->min_depth = depth;
+		set->max_depth = depth;
+		trixels = htm_get_trixels(htm, set);
+		set->min_depth = min_depth;
+		set->max_depth = max_depth;
+		if (trixels < 0) {
+			err = trixels;
+			break;
+		}
+
+		heads = set->head_count;
+		visited += trixels;
+		for (i = 0; i < trixels; i++) {
+			if (set->trixels[i]->depth != depth ||
+				!htm_trixel_num_objects(set->trixels[i], set->table_id))
+				continue;
+
+			visible = set_trixel_visible(set, set->trixels[i], centre);
+			if (visible == HTM_VISIBLE_NONE)
+				continue;
+
+			err = set_add_trixel(set, set->trixels[i], visible, centre,
+								 cos_fov);
+			if (err < 0)
+				break;
+		}
+		if (err < 0)
+			break;
+
+		/* merge the heads of this depth on magnitude */
+		for (i = heads; i < set->head_count; i++) {
+			object = set->object_heads[i].objects;
+			for (k = 0; k < set->object_heads[i].count; k++) {
+				bright_heap_add(&heap, (const void *)object);
+				object += set->table->object.bytes;
+			}
+		}
+
+		/* deeper objects are all fainter */
+		if (heap.count == n)
+			break;
 	}
 
-	return -EINVAL;
+	/* the heads only hold the walked depths */
+	if (set->valid_trixels > set->stale_trixels)
+		set->stale_trixels = set->valid_trixels;
+	set->valid_trixels = 0;
+
+	if (err < 0)
+		return err;
+
+	bright_heap_sort(&heap);
+
+	adb_htm_debug(htm, ADB_LOG_HTM_GET,
+				  "brightest %d objects of %d from depths %d to %d\n",
+				  heap.count, set->count, min_depth,
+				  depth > max_depth ? max_depth : depth);
+
+	stats_add(&set->db->stats, STATS_CLIPS, 1);
+	stats_add(&set->db->stats, STATS_TRIXELS, visited);
+	stats_add(&set->db->stats, STATS_HEADS, set->head_count);
+	return heap.count;
+}
+
+/* table aggregates are sorted by trixel ID */
+static int aggregate_find(const void *key, const void *elem)
+{
+	unsigned int id = *(const unsigned int *)key;
+	const struct adb_trixel_aggregate *aggregate = elem;
+
+	return id < aggregate->id ? -1 : id > aggregate->id;
 }
 
 /**
- * \brief Look up a data entry by identifying value traversing rapid hash tables.
- *
- * \param hash Core structural framework storing precompiled hash table metadata.
- * \param id Identifying input argument (as string, integer, etc).
- * \param map Target active array definitions layout ID.
- * \param offset Object field value index jump offset position.
- * \param ctype Target object underlying value layout datatype format.
- * \param count Total limit iterating objects.
- * \param object Output address receiving the generated database query element.
- * \return 1 on successful retrieval hit, 0 on missing record, and -EINVAL on bad type.
+ * \brief Append a trixel aggregate to the set aggregates.
+ *
+ * \param set Object set receiving the aggregate.
+ * \param aggregate Table aggregate of a visible trixel.
+ * \return 0 on success or -ENOMEM.
  */
-static int hash_get_object(struct table_hash *hash, const void *id, int map,
-						   int offset, adb_ctype ctype, int count,
-						   const struct adb_object **object)
+static int set_add_aggregate(struct adb_object_set *set,
+							 const struct adb_trixel_aggregate *aggregate)
 {
-	int i, index;
+	struct adb_trixel_aggregate *aggregates;
+	int size;
+
+	if (set->aggregate_count == set->aggregate_size) {
+		size = set->aggregate_size ? set->aggregate_size * 2 : 64;
+		aggregates = realloc(set->aggregates, size * sizeof(*aggregates));
+		if (aggregates == NULL)
+			return -ENOMEM;
+		set->aggregates = aggregates;
+		set->aggregate_size = size;
+	}
 
-	switch (ctype) {
-	case ADB_CTYPE_STRING:
-		index = hash_string((const char *)id, strlen((const char *)id), count);
+	set->aggregates[set->aggregate_count++] = *aggregate;
+	return 0;
+}
 
-		/* any objects at hash index ? */
-		if (!hash->map[map].index[index])
-			return 0;
+/**
+ * \brief Gather the aggregates of the visible trixels at a depth.
+ *
+ * Trixels without an aggregate have no objects in or below them, so the
+ * descent stops there without testing them against the clip.
+ *
+ * \param set Constrained object set.
+ * \param t Trixel to test.
+ * \param centre Cone centre unit vector.
+ * \param depth Depth of the aggregates.
+ * \return 0 on success or -ENOMEM.
+ */
+static int set_get_aggregates(struct adb_object_set *set, struct htm_trixel *t,
+							  const double centre[3], int depth)
+{
+	const struct adb_trixel_aggregate *aggregate;
+	unsigned int id = htm_trixel_id(t);
+	int i, ret;
 
-		/* search through hashes for exact match */
-		for (i = 0; i < hash->map[map].index[index]->count; i++) {
-			const struct adb_object *o = hash->map[map].index[index]->object[i];
-			char *_id = ((char *)o) + offset;
+	aggregate = bsearch(&id, set->table->aggregates,
+						set->table->aggregate_count, sizeof(*aggregate),
+						aggregate_find);
+	if (aggregate == NULL ||
+		set_trixel_visible(set, t, centre) == HTM_VISIBLE_NONE)
+		return 0;
 
-			if (!strstr(_id, id))
-				continue;
+	/* sparse mesh leaves above the depth hold all their objects */
+	if (t->depth >= depth || !t->child)
+		return set_add_aggregate(set, aggregate);
 
-			*object = o;
-			return 1;
-		}
-		break;
-	case ADB_CTYPE_SHORT:
-	case ADB_CTYPE_INT:
-		index = hash_int(*((int *)id), count);
+	for (i = 0; i < 4; i++) {
+		ret = set_get_aggregates(set, &t->child[i], centre, depth);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
 
-		/* any objects at hash index ? */
-		if (!hash->map[map].index[index])
-			return 0;
+/**
+ * \brief Get the trixel aggregates covering a constrained dataset.
+ * \ingroup htm
+ *
+ * Descends the mesh to the shallowest depth with trixels no larger than the
+ * resolution, so the cost depends on the clip and resolution rather than on
+ * the number of objects. Lazy tables load no objects.
+ *
+ * \param set Constrained object set
+ * \param resolution Largest trixel size wanted (radians)
+ * \param aggregates Output aggregates, owned by the set
+ * \return Number of aggregates, -ENOENT without table aggregates or -ENOMEM
+ */
+int adb_set_get_aggregates(struct adb_object_set *set, double resolution,
+						   const struct adb_trixel_aggregate **aggregates)
+{
+	struct htm *htm = set->db->htm;
+	double centre[3], cos_fov;
+	int depth, i, ret = 0;
 
-		/* search through hashes for exact match */
-		for (i = 0; i < hash->map[map].index[index]->count; i++) {
-			const void *o = hash->map[map].index[index]->object[i];
-			int *_id = ((int *)(o + offset));
+	if (set->remote)
+		return -EOPNOTSUPP;
+	if (set->table->aggregates == NULL)
+		return -ENOENT;
 
-			if (*_id != *((int *)id))
-				continue;
+	depth = htm_get_depth_from_resolution(resolution);
+	if (depth > htm->depth)
+		depth = htm->depth;
+
+	set_get_cone(set, centre, &cos_fov);
+	set->aggregate_count = 0;
+	for (i = 0; i < 4 && ret == 0; i++) {
+		ret = set_get_aggregates(set, &htm->N[i], centre, depth);
+		if (ret == 0)
+			ret = set_get_aggregates(set, &htm->S[i], centre, depth);
+	}
+	if (ret < 0)
+		return ret;
 
-			*object = o;
-			return 1;
-		}
-		break;
-	case ADB_CTYPE_DOUBLE_MPC:
-	case ADB_CTYPE_SIGN:
-	case ADB_CTYPE_NULL:
-	case ADB_CTYPE_FLOAT:
-	case ADB_CTYPE_DOUBLE:
-	case ADB_CTYPE_DEGREES:
-	case ADB_CTYPE_DOUBLE_DMS_DEGS:
-	case ADB_CTYPE_DOUBLE_DMS_MINS:
-	case ADB_CTYPE_DOUBLE_DMS_SECS:
-	case ADB_CTYPE_DOUBLE_HMS_HRS:
-	case ADB_CTYPE_DOUBLE_HMS_MINS:
-	case ADB_CTYPE_DOUBLE_HMS_SECS:
-	default:
+	adb_htm_debug(htm, ADB_LOG_HTM_GET, "%d aggregates at depth %d\n",
+				  set->aggregate_count, depth);
+	*aggregates = set->aggregates;
+	return set->aggregate_count;
+}
+
+struct adb_object_head *adb_set_get_head(struct adb_object_set *set)
+{
+	return set->object_heads;
+}
+
+int adb_set_get_count(struct adb_object_set *set)
+{
+	return set->count;
+}
+
+int adb_set_export_columns(struct adb_object_set *set, double ra[],
+						   double dec[], float mag[], const char *fields[],
+						   void *columns[], int num_fields, int count)
+{
+	const struct adb_object_head *head;
+	const struct adb_object *o;
+	const char *object;
+	size_t bytes = set->table->object.bytes;
+	int *offset, *size, i, j, k, n = 0, ret = 0;
+
+	if (count < 0 || num_fields < 0 || (num_fields && fields == NULL) ||
+		(num_fields && columns == NULL))
 		return -EINVAL;
+	ret = db_check_local(set->db);
+	if (ret < 0)
+		return ret;
+
+	offset = calloc(num_fields + 1, sizeof(*offset));
+	size = calloc(num_fields + 1, sizeof(*size));
+	if (offset == NULL || size == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (k = 0; k < num_fields; k++) {
+		offset[k] = adb_table_get_field_offset(set->db, set->table_id,
+											   fields[k]);
+		size[k] = adb_table_get_field_size(set->db, set->table_id, fields[k]);
+		if (offset[k] < 0 || size[k] <= 0 || columns[k] == NULL) {
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	/* one pass over each head, objects are contiguous inside a head */
+	for (i = 0; i < set->head_count && n < count; i++) {
+		head = &set->object_heads[i];
+		object = head->objects;
+
+		for (j = 0; j < (int)head->count && n < count; j++, n++) {
+			o = (const struct adb_object *)object;
+			if (ra)
+				ra[n] = o->ra;
+			if (dec)
+				dec[n] = o->dec;
+			if (mag)
+				mag[n] = o->mag;
+			for (k = 0; k < num_fields; k++)
+				memcpy((char *)columns[k] + (size_t)n * size[k],
+					   object + offset[k], size[k]);
+			object += bytes;
+		}
+	}
+	ret = n;
+
+out:
+	free(offset);
+	free(size);
+	return ret;
+}
+
+/**
+ * \brief Retrieve a key-matching index offset mapping to the hash definition arrays.
+ *
+ * \param hash The set or table hash maps being queried.
+ * \param key Desired property mapping symbolic string.
+ * \return Discovered mapped integer layout identifier, or -EINVAL on miss.
+ */
+static int hash_find_map(const struct table_hash *hash, const char *key)
+{
+	int i;
+
+	for (i = 0; i < hash->num; i++) {
+		if (!strcmp(key, hash->map[i].key))
+			return i;
 	}
 
 	return -EINVAL;
@@ -1014,6 +2365,9 @@ static int hash_get_object(struct table_hash *hash, const void *id, int map,
 /**
  * \brief Look up a specific object within a filtered bounding subset by value field key.
  *
+ * Keys only hashed on the table use the table map, skipping objects that
+ * are not in the set object heads.
+ *
  * \param set The subset area limiting valid candidates.
  * \param id Matcher evaluating value payload bounds.
  * \param field Target property dimension string.
@@ -1030,8 +2384,7 @@ int adb_set_get_object(struct adb_object_set *set, const void *id,
 
 	*object = NULL;
 
-	/* get map based on key */
-	map = set_get_hashmap(set, field);
+	map = db_check_local(db);
 	if (map < 0)
 		return map;
 
@@ -1042,8 +2395,19 @@ int adb_set_get_object(struct adb_object_set *set, const void *id,
 	/* get hash index */
 	ctype = adb_table_get_field_type(db, table->id, field);
 
-	return hash_get_object(&set->hash, id, map, offset, ctype, set->count,
-						   object);
+	/* keys hashed on the set have their own map */
+	map = hash_find_map(&set->hash, field);
+	if (map >= 0 && set->hash.map[map].slot)
+		return hash_get_object(table, &set->hash.map[map], NULL, id, offset,
+							   ctype, object);
+
+	/* otherwise filter the table map by the set objects */
+	map = hash_find_map(&table->hash, field);
+	if (map < 0)
+		return map;
+
+	return hash_get_object(table, &table->hash.map[map], set, id, offset,
+						   ctype, object);
 }
 
 /**
@@ -1065,6 +2429,9 @@ int adb_table_get_object(struct adb_db *db, int table_id, const void *id,
 
 	*object = NULL;
 
+	if (db->remote)
+		return remote_table_get_object(db, table, id, field, object);
+
 	/* get map based on key */
 	map = table_get_hashmap(db, table->id, field);
 	if (map < 0)
@@ -1077,8 +2444,8 @@ int adb_table_get_object(struct adb_db *db, int table_id, const void *id,
 	/* get hash index */
 	ctype = adb_table_get_field_type(db, table->id, field);
 
-	return hash_get_object(&table->hash, id, map, offset, ctype,
-						   table->object.count, object);
+	return hash_get_object(table, &table->hash.map[map], NULL, id, offset,
+						   ctype, object);
 }
 
 /**
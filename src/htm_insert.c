@@ -95,7 +95,7 @@ int htm_table_insert_object(struct htm *htm, struct adb_table *table,
 		return -EINVAL;
 	}
 
-	trixel = htm_get_trixel(htm, trixel_id);
+	trixel = htm_new_trixel(htm, trixel_id);
 	if (!trixel) {
 		adb_htm_error(htm, "no trixel at %x\n", trixel_id);
 		return -EINVAL;
@@ -0,0 +1,333 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "htm.h"
+#include "table.h"
+#include "libastrodb/db.h"
+#include "libastrodb/object.h"
+
+/* initial size of the de-duplication neighbour buffer */
+#define MULTI_NEAR_SIZE 16
+
+/*! \struct multi_span
+ * \brief Run of table objects inside a clipped set
+ * \ingroup htm
+ */
+struct multi_span {
+	unsigned int index; /*!< table position of the first object */
+	unsigned int count; /*!< number of objects */
+};
+
+/*! \struct adb_multi_set
+ * \brief Object sets of several tables clipped by one cone
+ * \ingroup htm
+ */
+struct adb_multi_set {
+	struct adb_db *db;
+	struct adb_object_set *set[ADB_MAX_TABLES]; /*!< set of each table */
+	int count; /*!< number of tables */
+	int valid; /*!< sets clipped since the last constraint */
+
+	/* clipped object runs of each set in table order */
+	struct multi_span *span[ADB_MAX_TABLES];
+	int spans[ADB_MAX_TABLES];
+
+	/* merged objects */
+	struct adb_multi_object *objects;
+	int object_size; /*!< allocated merged objects */
+
+	/* KD tree neighbours of a de-duplicated object */
+	const struct adb_object **near;
+	int near_size;
+};
+
+struct adb_multi_set *adb_multi_set_new(struct adb_db *db, const int table_id[],
+										int count)
+{
+	struct adb_multi_set *mset;
+	int i, j;
+
+	if (table_id == NULL || count < 1 || count > ADB_MAX_TABLES)
+		return NULL;
+	if (db_check_local(db) < 0)
+		return NULL;
+
+	for (i = 0; i < count; i++) {
+		if (table_id[i] < 0 || table_id[i] >= ADB_MAX_TABLES)
+			return NULL;
+		for (j = 0; j < i; j++) {
+			if (table_id[j] == table_id[i])
+				return NULL;
+		}
+	}
+
+	mset = calloc(1, sizeof(*mset));
+	if (mset == NULL)
+		return NULL;
+
+	mset->db = db;
+	mset->count = count;
+	for (i = 0; i < count; i++) {
+		mset->set[i] = adb_table_set_new(db, table_id[i]);
+		if (mset->set[i] == NULL) {
+			adb_multi_set_free(mset);
+			return NULL;
+		}
+	}
+
+	return mset;
+}
+
+int adb_multi_set_constraints(struct adb_multi_set *mset, double ra,
+							  double dec, double fov, double min_Z,
+							  double max_Z)
+{
+	int i, err;
+
+	mset->valid = 0;
+
+	for (i = 0; i < mset->count; i++) {
+		err = adb_table_set_constraints(mset->set[i], ra, dec, fov, min_Z,
+										max_Z);
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+static int span_cmp(const void *a, const void *b)
+{
+	const struct multi_span *sa = a, *sb = b;
+
+	if (sa->index < sb->index)
+		return -1;
+	return sa->index > sb->index;
+}
+
+/**
+ * \brief Build the sorted object runs of one clipped table set.
+ *
+ * \param mset Multi table set.
+ * \param i Position of the table set.
+ * \return 0 on success or -ENOMEM.
+ */
+static int multi_build_spans(struct adb_multi_set *mset, int i)
+{
+	struct adb_object_set *set = mset->set[i];
+	struct multi_span *span;
+	int j;
+
+	span = realloc(mset->span[i], (set->head_count ? set->head_count : 1) *
+									  sizeof(*span));
+	if (span == NULL)
+		return -ENOMEM;
+	mset->span[i] = span;
+
+	for (j = 0; j < set->head_count; j++) {
+		span[j].index = set->object_heads[j].index;
+		span[j].count = set->object_heads[j].count;
+	}
+	mset->spans[i] = set->head_count;
+
+	qsort(span, mset->spans[i], sizeof(*span), span_cmp);
+	return 0;
+}
+
+/**
+ * \brief Check if a table object is inside the clip of a table set.
+ *
+ * \param mset Multi table set.
+ * \param i Position of the table set.
+ * \param object Object of the set table.
+ * \return 1 if the object was clipped by the set, 0 otherwise.
+ */
+static int multi_set_has_object(struct adb_multi_set *mset, int i,
+								const struct adb_object *object)
+{
+	const struct adb_table *table = mset->set[i]->table;
+	const struct multi_span *span = mset->span[i];
+	unsigned int index;
+	int low = 0, high = mset->spans[i], mid;
+
+	index = ((const char *)object - (const char *)table->objects) /
+			table->object.bytes;
+
+	/* last run starting at or before the object */
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (span[mid].index <= index)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low > 0 && index < span[low - 1].index + span[low - 1].count;
+}
+
+/**
+ * \brief Check if an earlier table set holds an object near a position.
+ *
+ * \param mset Multi table set.
+ * \param count Number of earlier table sets to check.
+ * \param object Object being merged.
+ * \param radius Match radius in radians.
+ * \return 1 for a duplicate, 0 otherwise or a negative error code.
+ */
+static int multi_is_duplicate(struct adb_multi_set *mset, int count,
+							  const struct adb_object *object, double radius)
+{
+	const struct adb_object **near;
+	int i, j, found;
+
+	for (i = 0; i < count; i++) {
+		found = adb_table_set_get_within_radius(mset->set[i], object->ra,
+												object->dec, radius,
+												mset->near, mset->near_size);
+		if (found < 0)
+			return found;
+
+		/* neighbours are found in the whole table, keep every one */
+		if (found > mset->near_size) {
+			near = realloc(mset->near, found * sizeof(*near));
+			if (near == NULL)
+				return -ENOMEM;
+			mset->near = near;
+			mset->near_size = found;
+
+			found = adb_table_set_get_within_radius(
+				mset->set[i], object->ra, object->dec, radius, mset->near,
+				mset->near_size);
+			if (found < 0)
+				return found;
+		}
+
+		for (j = 0; j < found; j++) {
+			if (multi_set_has_object(mset, i, mset->near[j]))
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+int adb_multi_set_get_objects(struct adb_multi_set *mset, double radius,
+							  const struct adb_multi_object **objects)
+{
+	struct adb_multi_object *merged;
+	struct adb_object_set *set;
+	const char *object;
+	int i, j, k, total = 0, count = 0, err;
+
+	if (radius < 0.0 || objects == NULL)
+		return -EINVAL;
+
+	/* one HTM traversal clips every table */
+	if (!mset->valid) {
+		err = htm_get_clipped_multi(mset->set, mset->count);
+		if (err < 0)
+			return err;
+
+		for (i = 0; i < mset->count; i++) {
+			err = multi_build_spans(mset, i);
+			if (err < 0)
+				return err;
+		}
+		mset->valid = 1;
+	}
+
+	for (i = 0; i < mset->count; i++)
+		total += mset->set[i]->count;
+
+	if (total > mset->object_size) {
+		merged = realloc(mset->objects, total * sizeof(*merged));
+		if (merged == NULL)
+			return -ENOMEM;
+		mset->objects = merged;
+		mset->object_size = total;
+	}
+
+	if (radius > 0.0 && mset->near == NULL) {
+		mset->near = calloc(MULTI_NEAR_SIZE, sizeof(*mset->near));
+		if (mset->near == NULL)
+			return -ENOMEM;
+		mset->near_size = MULTI_NEAR_SIZE;
+	}
+
+	for (i = 0; i < mset->count; i++) {
+		set = mset->set[i];
+
+		for (j = 0; j < set->head_count; j++) {
+			object = set->object_heads[j].objects;
+
+			for (k = 0; k < set->object_heads[j].count; k++) {
+				const struct adb_object *o = (const void *)object;
+
+				object += set->table->object.bytes;
+
+				/* the first table keeps every object */
+				if (radius > 0.0 && i > 0) {
+					err = multi_is_duplicate(mset, i, o, radius);
+					if (err < 0)
+						return err;
+					if (err)
+						continue;
+				}
+
+				mset->objects[count].object = o;
+				mset->objects[count++].table_id = set->table_id;
+			}
+		}
+	}
+
+	adb_debug(mset->db, ADB_LOG_HTM_GET,
+			  "merged %d of %d objects from %d tables\n", count, total,
+			  mset->count);
+
+	*objects = mset->objects;
+	return count;
+}
+
+struct adb_object_set *adb_multi_set_get_set(struct adb_multi_set *mset,
+											 int index)
+{
+	if (index < 0 || index >= mset->count)
+		return NULL;
+	return mset->set[index];
+}
+
+void adb_multi_set_free(struct adb_multi_set *mset)
+{
+	int i;
+
+	if (mset == NULL)
+		return;
+
+	for (i = 0; i < mset->count; i++) {
+		adb_table_set_free(mset->set[i]);
+		free(mset->span[i]);
+	}
+	free(mset->objects);
+	free(mset->near);
+	free(mset);
+}
@@ -18,14 +18,17 @@
 
 #include <dirent.h>
 #include <errno.h> // IWYU pragma: keep
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "debug.h"
+#include "hash.h"
 #include "private.h"
 #include "readme.h"
 #include "schema.h"
@@ -34,63 +37,223 @@
 #include "libastrodb/db.h"
 #include "libastrodb/object.h"
 
-/* table type import's */
-static int int_import(struct adb_object *object, int offset, char *src)
+/*
+ * Fixed width column parsers.
+ *
+ * CDS I and F columns are parsed straight from the row text using the column
+ * width, without copying or terminating the field first. Plain decimals are
+ * converted exactly: a mantissa of at most 2^53 (2^24 for float) divided by
+ * an exact power of ten is correctly rounded, so it gives the same result as
+ * strtod()/strtof(). Anything else (exponents, very long mantissas, inf/nan)
+ * falls back to a terminated copy and the C library.
+ */
+#define PARSE_SLOW_SIZE		64
+#define PARSE_DOUBLE_MANT	(1ULL << 53)
+#define PARSE_FLOAT_MANT	(1ULL << 24)
+
+static const double parse_pow10[] = {
+	1e0,  1e1,	1e2,  1e3,	1e4,  1e5,	1e6,  1e7,	1e8,  1e9,	1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static const float parse_pow10f[] = {
+	1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+};
+
+static inline int parse_is_space(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline int parse_is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/* terminated copy of the column for the C library parsers */
+static inline void parse_copy(char *buf, const char *src, int len)
+{
+	if (len >= PARSE_SLOW_SIZE)
+		len = PARSE_SLOW_SIZE - 1;
+	memcpy(buf, src, len);
+	buf[len] = 0;
+}
+
+static int parse_long_slow(const char *src, int len, long *val)
+{
+	char buf[PARSE_SLOW_SIZE], *ptr;
+
+	parse_copy(buf, src, len);
+	*val = strtol(buf, &ptr, 10);
+	return ptr == buf ? -1 : 0;
+}
+
+static int parse_double_slow(const char *src, int len, double *val)
+{
+	char buf[PARSE_SLOW_SIZE], *ptr;
+
+	parse_copy(buf, src, len);
+	*val = strtod(buf, &ptr);
+	return ptr == buf ? -1 : 0;
+}
+
+static int parse_float_slow(const char *src, int len, float *val)
+{
+	char buf[PARSE_SLOW_SIZE], *ptr;
+
+	parse_copy(buf, src, len);
+	*val = strtof(buf, &ptr);
+	return ptr == buf ? -1 : 0;
+}
+
+/* split a decimal column into sign, mantissa and fraction digits */
+static inline int parse_decimal(const char *src, int len,
+								unsigned long long *mant, int *frac, int *neg)
 {
-	char *ptr, *dest = (char *)object + offset;
+	const char *end = src + len;
+	int digits = 0;
+
+	*mant = 0;
+	*frac = 0;
+	*neg = 0;
+
+	while (src < end && parse_is_space(*src))
+		src++;
+	if (src < end && (*src == '-' || *src == '+'))
+		*neg = *src++ == '-';
+
+	for (; src < end && parse_is_digit(*src); src++, digits++)
+		*mant = *mant * 10 + (*src - '0');
 
-	*(int *)dest = strtol(src, &ptr, 10);
+	if (src < end && *src == '.') {
+		for (src++; src < end && parse_is_digit(*src); src++, digits++) {
+			*mant = *mant * 10 + (*src - '0');
+			(*frac)++;
+		}
+	}
+
+	/* exponents, inf, nan and hex need the C library */
+	if (src < end && *src && !parse_is_space(*src) &&
+		(digits == 0 || *src == 'e' || *src == 'E'))
+		return 1;
+
+	/* mantissa may have overflowed */
+	if (digits > 19)
+		return 1;
+
+	return digits ? 0 : -1;
+}
+
+static int parse_long(const char *src, int len, long *val)
+{
+	unsigned long long mant;
+	int frac, neg, ret;
 
-	if (src == ptr)
+	ret = parse_decimal(src, len, &mant, &frac, &neg);
+	if (ret < 0) {
+		*val = 0;
 		return -1;
+	}
+	if (ret > 0 || frac || mant > LONG_MAX)
+		return parse_long_slow(src, len, val);
+
+	*val = neg ? -(long)mant : (long)mant;
 	return 0;
 }
 
-static int short_import(struct adb_object *object, int offset, char *src)
+static int parse_double(const char *src, int len, double *val)
 {
-	char *ptr, *dest = (char *)object + offset;
+	unsigned long long mant;
+	int frac, neg, ret;
+
+	ret = parse_decimal(src, len, &mant, &frac, &neg);
+	if (ret < 0) {
+		*val = 0.0;
+		return -1;
+	}
+	if (ret > 0 || mant > PARSE_DOUBLE_MANT || frac >= adb_size(parse_pow10))
+		return parse_double_slow(src, len, val);
+
+	*val = (double)mant / parse_pow10[frac];
+	if (neg)
+		*val = -*val;
+	return 0;
+}
 
-	*(short *)dest = strtol(src, &ptr, 10);
+static int parse_float(const char *src, int len, float *val)
+{
+	unsigned long long mant;
+	int frac, neg, ret;
 
-	if (unlikely(src == ptr))
+	ret = parse_decimal(src, len, &mant, &frac, &neg);
+	if (ret < 0) {
+		*val = 0.0f;
 		return -1;
+	}
+	if (ret > 0 || mant > PARSE_FLOAT_MANT || frac >= adb_size(parse_pow10f))
+		return parse_float_slow(src, len, val);
+
+	*val = (float)mant / parse_pow10f[frac];
+	if (neg)
+		*val = -*val;
 	return 0;
 }
 
-static int float_import(struct adb_object *object, int offset, char *src)
+/* table type column parsers */
+static int int_parse(struct adb_object *object, int offset, const char *src,
+					 int len)
+{
+	char *dest = (char *)object + offset;
+	long val;
+	int ret;
+
+	ret = parse_long(src, len, &val);
+	*(int *)dest = val;
+	return ret;
+}
+
+static int short_parse(struct adb_object *object, int offset, const char *src,
+					   int len)
 {
-	char *ptr, *dest = (char *)object + offset;
+	char *dest = (char *)object + offset;
+	long val;
+	int ret;
+
+	ret = parse_long(src, len, &val);
+	*(short *)dest = val;
+	return ret;
+}
 
-	*(float *)dest = strtof(src, &ptr);
+static int float_parse(struct adb_object *object, int offset, const char *src,
+					   int len)
+{
+	char *dest = (char *)object + offset;
 
-	if (unlikely(src == ptr)) {
+	if (unlikely(parse_float(src, len, (float *)dest) < 0)) {
 		*(float *)dest = FP_NAN;
 		return -1;
 	}
 	return 0;
 }
 
-static int double_import(struct adb_object *object, int offset, char *src)
+static int double_parse(struct adb_object *object, int offset, const char *src,
+						int len)
 {
-	char *ptr, *dest = (char *)object + offset;
-
-	*(double *)dest = strtod(src, &ptr);
+	char *dest = (char *)object + offset;
 
-	if (unlikely(src == ptr)) {
+	if (unlikely(parse_double(src, len, (double *)dest) < 0)) {
 		*(double *)dest = FP_NAN;
 		return -1;
 	}
 	return 0;
 }
 
-static int double_degrees_import(struct adb_object *object, int offset,
-								 char *src)
+static int double_degrees_parse(struct adb_object *object, int offset,
+								const char *src, int len)
 {
-	char *ptr, *dest = (char *)object + offset;
-
-	*(double *)dest = strtod(src, &ptr);
+	char *dest = (char *)object + offset;
 
-	if (unlikely(src == ptr)) {
+	if (unlikely(parse_double(src, len, (double *)dest) < 0)) {
 		*(double *)dest = FP_NAN;
 		return -1;
 	}
@@ -101,103 +264,112 @@ static int double_degrees_import(struct adb_object *object, int offset,
 	return 0;
 }
 
-static int str_import(struct adb_object *object, int offset, char *src)
+static int str_parse(struct adb_object *object, int offset, const char *src,
+					 int len)
 {
 	char *dest = (char *)object + offset;
 
 	/* copy string and terminating NULL */
-	strcpy(dest, src);
+	len = strnlen(src, len);
+	memcpy(dest, src, len);
+	dest[len] = 0;
 	return 0;
 }
 
-static int double_dms_degs(struct adb_object *object, int offset, char *src)
+static int double_dms_degs_parse(struct adb_object *object, int offset,
+								 const char *src, int len)
 {
-	char *ptr, *dest = (char *)object + offset;
-
-	*(double *)dest = strtod(src, &ptr) * D2R;
+	char *dest = (char *)object + offset;
+	double val;
 
-	if (unlikely(src == ptr)) {
+	if (unlikely(parse_double(src, len, &val) < 0)) {
 		*(double *)dest = FP_NAN;
 		return -1;
 	}
+
+	*(double *)dest = val * D2R;
 	return 0;
 }
 
-static int double_dms_mins(struct adb_object *object, int offset, char *src)
+static int double_dms_mins_parse(struct adb_object *object, int offset,
+								 const char *src, int len)
 {
-	char *ptr, *dest = (char *)object + offset;
-
-	*(double *)dest += (strtod(src, &ptr) / 60.0) * D2R;
+	char *dest = (char *)object + offset;
+	double val;
+	int ret;
 
-	if (unlikely(src == ptr))
-		return -1;
-	return 0;
+	ret = parse_double(src, len, &val);
+	*(double *)dest += (val / 60.0) * D2R;
+	return ret;
 }
 
-static int double_dms_secs(struct adb_object *object, int offset, char *src)
+static int double_dms_secs_parse(struct adb_object *object, int offset,
+								 const char *src, int len)
 {
-	char *ptr, *dest = (char *)object + offset;
-
-	*(double *)dest += (strtod(src, &ptr) / 3600.0) * D2R;
+	char *dest = (char *)object + offset;
+	double val;
+	int ret;
 
-	if (unlikely(src == ptr))
-		return -1;
-	return 0;
+	ret = parse_double(src, len, &val);
+	*(double *)dest += (val / 3600.0) * D2R;
+	return ret;
 }
 
-static int sign_import(struct adb_object *object, int offset, char *src)
+static int sign_parse(struct adb_object *object, int offset, const char *src,
+					  int len)
 {
 	char *dest = (char *)object + offset;
 
-	if (*(char *)src == '-')
+	if (len > 0 && *src == '-')
 		*(double *)dest *= -1.0;
 	return 0;
 }
 
-static int double_hms_hrs(struct adb_object *object, int offset, char *src)
+static int double_hms_hrs_parse(struct adb_object *object, int offset,
+								const char *src, int len)
 {
-	char *ptr, *dest = (char *)object + offset;
-
-	*(double *)dest = (strtod(src, &ptr) * 15.0) * D2R;
+	char *dest = (char *)object + offset;
+	double val;
+	int ret;
 
-	if (unlikely(src == ptr))
-		return -1;
-	return 0;
+	ret = parse_double(src, len, &val);
+	*(double *)dest = (val * 15.0) * D2R;
+	return ret;
 }
 
-static int double_hms_mins(struct adb_object *object, int offset, char *src)
+static int double_hms_mins_parse(struct adb_object *object, int offset,
+								 const char *src, int len)
 {
-	char *ptr, *dest = (char *)object + offset;
-
-	*(double *)dest += ((strtod(src, &ptr) / 60.0) * 15.0) * D2R;
+	char *dest = (char *)object + offset;
+	double val;
+	int ret;
 
-	if (unlikely(src == ptr))
-		return -1;
-	return 0;
+	ret = parse_double(src, len, &val);
+	*(double *)dest += ((val / 60.0) * 15.0) * D2R;
+	return ret;
 }
 
-static int double_hms_secs(struct adb_object *object, int offset, char *src)
+static int double_hms_secs_parse(struct adb_object *object, int offset,
+								 const char *src, int len)
 {
-	char *ptr, *dest = (char *)object + offset;
-
-	*(double *)dest += ((strtod(src, &ptr) / 3600.0) * 15.0) * D2R;
+	char *dest = (char *)object + offset;
+	double val;
+	int ret;
 
-	if (unlikely(src == ptr))
-		return -1;
-	return 0;
+	ret = parse_double(src, len, &val);
+	*(double *)dest += ((val / 3600.0) * 15.0) * D2R;
+	return ret;
 }
 
-static int float_alt_import(struct adb_object *object, int offset, char *src,
-							char *src2)
+static int float_alt_parse(struct adb_object *object, int offset,
+						   const char *src, int len, const char *src2,
+						   int len2)
 {
-	char *ptr, *dest = (char *)object + offset;
-
-	*(float *)dest = strtof(src, &ptr);
+	char *dest = (char *)object + offset;
 
 	/* is primary source invalid then try alternate source */
-	if (src == ptr) {
-		*(float *)dest = strtof(src2, &ptr);
-		if (unlikely(src2 == ptr)) {
+	if (parse_float(src, len, (float *)dest) < 0) {
+		if (unlikely(parse_float(src2, len2, (float *)dest) < 0)) {
 			*(float *)dest = FP_NAN;
 			return -1;
 		}
@@ -205,17 +377,15 @@ static int float_alt_import(struct adb_object *object, int offset, char *src,
 	return 0;
 }
 
-static int double_alt_import(struct adb_object *object, int offset, char *src,
-							 char *src2)
+static int double_alt_parse(struct adb_object *object, int offset,
+							const char *src, int len, const char *src2,
+							int len2)
 {
-	char *ptr, *dest = (char *)object + offset;
-
-	*(double *)dest = strtod(src, &ptr);
+	char *dest = (char *)object + offset;
 
 	/* is primary source invalid then try alternate source */
-	if (src == ptr) {
-		*(double *)dest = strtod(src2, &ptr);
-		if (unlikely(src2 == ptr)) {
+	if (parse_double(src, len, (double *)dest) < 0) {
+		if (unlikely(parse_double(src2, len2, (double *)dest) < 0)) {
 			*(double *)dest = FP_NAN;
 			return -1;
 		}
@@ -223,6 +393,66 @@ static int double_alt_import(struct adb_object *object, int offset, char *src,
 	return 0;
 }
 
+/* table type import's - terminated string wrappers for the column parsers */
+#define import_wrap1(name)                                             \
+	static int name##_import(struct adb_object *object, int offset,  \
+							 char *src)                                \
+	{                                                                  \
+		return name##_parse(object, offset, src, strlen(src));         \
+	}
+
+#define import_wrap2(name)                                               \
+	static int name##_import(struct adb_object *object, int offset,    \
+							 char *src, char *src2)                      \
+	{                                                                    \
+		return name##_parse(object, offset, src, strlen(src), src2,      \
+							strlen(src2));                               \
+	}
+
+import_wrap1(int)
+import_wrap1(short)
+import_wrap1(float)
+import_wrap1(double)
+import_wrap1(double_degrees)
+import_wrap1(str)
+import_wrap1(double_dms_degs)
+import_wrap1(double_dms_mins)
+import_wrap1(double_dms_secs)
+import_wrap1(sign)
+import_wrap1(double_hms_hrs)
+import_wrap1(double_hms_mins)
+import_wrap1(double_hms_secs)
+import_wrap2(float_alt)
+import_wrap2(double_alt)
+
+/* built in importers and their column parsers */
+static const struct {
+	adb_field_import1 import;
+	import_parse1 parse;
+} column_parsers[] = {
+	{ int_import, int_parse },
+	{ short_import, short_parse },
+	{ float_import, float_parse },
+	{ double_import, double_parse },
+	{ double_degrees_import, double_degrees_parse },
+	{ str_import, str_parse },
+	{ double_dms_degs_import, double_dms_degs_parse },
+	{ double_dms_mins_import, double_dms_mins_parse },
+	{ double_dms_secs_import, double_dms_secs_parse },
+	{ sign_import, sign_parse },
+	{ double_hms_hrs_import, double_hms_hrs_parse },
+	{ double_hms_mins_import, double_hms_mins_parse },
+	{ double_hms_secs_import, double_hms_secs_parse },
+};
+
+static const struct {
+	adb_field_import2 import;
+	import_parse2 parse;
+} alt_column_parsers[] = {
+	{ float_alt_import, float_alt_parse },
+	{ double_alt_import, double_alt_parse },
+};
+
 /**
  * @brief Convert an ASCII format character to a C type enumeration.
  * @ingroup import
@@ -301,22 +531,22 @@ adb_field_import1 table_get_column_import(struct adb_db *db, adb_ctype type)
 	case ADB_CTYPE_FLOAT:
 		return float_import;
 	case ADB_CTYPE_DOUBLE_DMS_DEGS:
-		return double_dms_degs;
+		return double_dms_degs_import;
 	case ADB_CTYPE_DOUBLE_DMS_MINS:
-		return double_dms_mins;
+		return double_dms_mins_import;
 	case ADB_CTYPE_DOUBLE_DMS_SECS:
-		return double_dms_secs;
+		return double_dms_secs_import;
 	case ADB_CTYPE_SIGN:
 		return sign_import;
 	case ADB_CTYPE_DOUBLE_MPC:
 	case ADB_CTYPE_NULL:
 		return NULL;
 	case ADB_CTYPE_DOUBLE_HMS_HRS:
-		return double_hms_hrs;
+		return double_hms_hrs_import;
 	case ADB_CTYPE_DOUBLE_HMS_MINS:
-		return double_hms_mins;
+		return double_hms_mins_import;
 	case ADB_CTYPE_DOUBLE_HMS_SECS:
-		return double_hms_secs;
+		return double_hms_secs_import;
 	}
 	adb_error(db, "Invalid column import key type %d\n", type);
 	return NULL;
@@ -432,6 +662,39 @@ static void get_import_buffer_size(struct adb_db *db, struct adb_table *table)
 			 table->import.text_buffer_bytes);
 }
 
+/* use the column parsers for fields with built in importers */
+static void get_import_parsers(struct adb_db *db, struct adb_table *table)
+{
+	struct alt_field *alt;
+	int i, j, fast = 0;
+
+	for (i = 0; i < table->object.field_count; i++) {
+		table->import.field_parse[i] = NULL;
+		for (j = 0; j < adb_size(column_parsers); j++) {
+			if (table->import.field[i].import == column_parsers[j].import) {
+				table->import.field_parse[i] = column_parsers[j].parse;
+				fast++;
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < table->object.num_alt_fields; i++) {
+		alt = &table->import.alt_field[i];
+		alt->parse = NULL;
+		for (j = 0; j < adb_size(alt_column_parsers); j++) {
+			if (alt->import == alt_column_parsers[j].import) {
+				alt->parse = alt_column_parsers[j].parse;
+				break;
+			}
+		}
+	}
+
+	adb_info(db, ADB_LOG_CDS_IMPORT,
+			 "Using column parsers for %d of %d fields\n", fast,
+			 table->object.field_count);
+}
+
 static void get_histogram_keys(struct adb_db *db, struct adb_table *table)
 {
 	int key_idx, alt_key_idx;
@@ -505,40 +768,47 @@ void histo_depth_calc(struct adb_db *db, struct adb_table *table, float histo)
 	if (count % 10000 == 0)  \
 		adb_info(db, ADB_LOG_CDS_IMPORT, "\r Parsed %d", count);
 
-static int table_histogram_import(struct adb_db *db, struct adb_table *table,
-								  FILE *f)
-{
-	struct adb_object object;
-	struct adb_schema_field *key = table->import.histogram_key;
-	int j, rsize, import, used = 0, hindex, oor = 0;
-	char *line;
-	char buf[ADB_IMPORT_LINE_SIZE];
-	size_t size;
-	float histo;
-
-	line = malloc(ADB_IMPORT_LINE_SIZE);
-	if (line == NULL)
-		return -ENOMEM;
-
-	adb_info(db, ADB_LOG_CDS_IMPORT,
-			 "Creating histogram using field %s for depth\n", key->symbol);
-
-	histo = (table->object.max_value - table->object.min_value) /
-			(ADB_TABLE_HISTOGRAM_DIVS - 1);
+/* magnitude histogram of the depth field over the imported rows */
+struct import_histo {
+	float div; /*!< magnitude range of each histogram bin */
+	int used; /*!< rows counted in the histogram */
+	int oor; /*!< rows out of the table magnitude range */
+	int blank; /*!< rows with a blank depth field */
+	uint64_t ns; /*!< time spent adding rows */
+};
 
-	size = table->import.text_length + 10;
+static void histogram_begin(struct adb_db *db, struct adb_table *table,
+							struct import_histo *histo)
+{
+	struct alt_field *alt = table->import.histogram_alt_key;
+
+	if (table->import.histogram_key) {
+		adb_info(db, ADB_LOG_CDS_IMPORT,
+				 "Creating histogram using field %s for depth\n",
+				 table->import.histogram_key->symbol);
+	} else {
+		adb_info(db, ADB_LOG_CDS_IMPORT,
+				 "Creating histogram using field %s/%s for depth\n",
+				 alt->key_field.symbol, alt->alt_field.symbol);
+	}
 
-	for (j = 0; j < table->object.count || table->object.count == 0; j++) {
-		bzero(line, ADB_IMPORT_LINE_SIZE);
+	bzero(histo, sizeof(*histo));
+	histo->div = (table->object.max_value - table->object.min_value) /
+				 (ADB_TABLE_HISTOGRAM_DIVS - 1);
+}
 
-		/* try and read a little extra padding */
-		rsize = getline(&line, &size, f);
-		if (rsize <= 0) {
-			adb_error(db, "cant read line %d\n", j);
-			goto out;
-		}
+/* add the depth field of the row text to the histogram */
+static void histogram_add_row(struct adb_db *db, struct adb_table *table,
+							  struct import_histo *histo, const char *line)
+{
+	struct adb_schema_field *key = table->import.histogram_key;
+	struct alt_field *alt = table->import.histogram_alt_key;
+	struct adb_object object;
+	char buf[ADB_IMPORT_LINE_SIZE], buf2[ADB_IMPORT_LINE_SIZE];
+	int import, hindex;
 
-		bzero(buf, table->import.text_buffer_bytes);
+	bzero(buf, table->import.text_buffer_bytes);
+	if (key) {
 		strncpy(buf, line + key->text_offset, key->text_size);
 
 		/* terminate string */
@@ -546,63 +816,66 @@ static int table_histogram_import(struct adb_db *db, struct adb_table *table,
 			buf[key->text_size] = 0;
 
 		import = key->import(&object, key->struct_offset, buf);
-		if (import < 0) {
-			adb_vdebug(db, ADB_LOG_CDS_IMPORT, " blank field %s on buf: %s\n",
-					   key->symbol, buf);
-			continue;
-		}
+	} else {
+		key = &alt->key_field;
+		bzero(buf2, table->import.text_buffer_bytes);
+		strncpy(buf, line + key->text_offset, key->text_size);
+		strncpy(buf2, line + alt->alt_field.text_offset,
+				alt->alt_field.text_size);
 
-		if (object.mag < table->object.min_value ||
-			object.mag > table->object.max_value) {
-			oor++;
-			continue;
-		}
+		import = alt->import(&object, key->struct_offset, buf, buf2);
+	}
 
-		hindex = (object.mag - table->object.min_value) / histo;
-		if (hindex >= ADB_TABLE_HISTOGRAM_DIVS || hindex < 0) {
-			adb_error(db, "hash index out of range %d for %s have val %f\n",
-					  hindex, buf, object.mag);
-			oor++;
-			continue;
-		}
+	if (import < 0) {
+		adb_vdebug(db, ADB_LOG_CDS_IMPORT, " blank field %s on buf: %s\n",
+				   key->symbol, buf);
+		histo->blank++;
+		return;
+	}
 
-		table->file_index.histo[hindex]++;
-		used++;
-		histo_inc(db, j);
+	if (object.mag < table->object.min_value ||
+		object.mag > table->object.max_value) {
+		histo->oor++;
+		return;
 	}
 
-out:
+	hindex = (object.mag - table->object.min_value) / histo->div;
+	if (hindex >= ADB_TABLE_HISTOGRAM_DIVS || hindex < 0) {
+		adb_error(db, "hash index out of range %d for %s have val %f\n",
+				  hindex, buf, object.mag);
+		histo->oor++;
+		return;
+	}
+
+	table->file_index.histo[hindex]++;
+	histo->used++;
+}
+
+/* map the histogram onto the HTM depths */
+static void histogram_end(struct adb_db *db, struct adb_table *table,
+						  struct import_histo *histo)
+{
 	adb_info(db, ADB_LOG_CDS_IMPORT,
-			 "Used %d objects for histogram %d out of range\n", used, oor);
+			 "Used %d objects for histogram %d out of range %d blank\n",
+			 histo->used, histo->oor, histo->blank);
 	if (table->object.count == 0)
-		table->object.count = used;
-	histo_depth_calc(db, table, histo);
-	fseek(f, 0, SEEK_SET);
-	free(line);
-	return 0;
+		table->object.count = histo->used;
+	histo_depth_calc(db, table, histo->div);
 }
 
-static int table_histogram_alt_import(struct adb_db *db,
-									  struct adb_table *table, FILE *f)
+static int table_histogram_import(struct adb_db *db, struct adb_table *table,
+								  FILE *f)
 {
-	struct adb_object object;
-	struct alt_field *key = table->import.histogram_alt_key;
-	int j, rsize, import, used = 0, hindex, oor = 0, blank = 0;
+	struct import_histo histo;
+	int j, rsize;
 	char *line;
-	char buf[ADB_IMPORT_LINE_SIZE], buf2[ADB_IMPORT_LINE_SIZE];
 	size_t size;
-	float histo;
 
 	line = malloc(ADB_IMPORT_LINE_SIZE);
 	if (line == NULL)
 		return -ENOMEM;
 
-	adb_info(db, ADB_LOG_CDS_IMPORT,
-			 "Creating histogram using field %s/%s for depth\n",
-			 key->key_field.symbol, key->alt_field.symbol);
-
-	histo = (table->object.max_value - table->object.min_value) /
-			(ADB_TABLE_HISTOGRAM_DIVS - 1);
+	histogram_begin(db, table, &histo);
 
 	size = table->import.text_length + 10;
 
@@ -612,53 +885,15 @@ static int table_histogram_alt_import(struct adb_db *db,
 		/* try and read a little extra padding */
 		rsize = getline(&line, &size, f);
 		if (rsize <= 0) {
-			adb_error(db, "can't read line\n");
-			goto out;
-		}
-
-		bzero(buf, table->import.text_buffer_bytes);
-		bzero(buf2, table->import.text_buffer_bytes);
-		strncpy(buf, line + key->key_field.text_offset,
-				key->key_field.text_size);
-		strncpy(buf2, line + key->alt_field.text_offset,
-				key->alt_field.text_size);
-
-		import = key->import(&object, key->key_field.struct_offset, buf, buf2);
-		if (import < 0) {
-			adb_vdebug(db, ADB_LOG_CDS_IMPORT, " blank field %s on buf: %s\n",
-					   key->key_field.symbol, buf);
-			blank++;
-			continue;
-		}
-
-		if (object.mag < table->object.min_value ||
-			object.mag > table->object.max_value) {
-			oor++;
-			continue;
-		}
-
-		hindex = (object.mag - table->object.min_value) / histo;
-		if (hindex >= ADB_TABLE_HISTOGRAM_DIVS || hindex < 0) {
-			adb_error(db,
-					  "hash index out of range %d for %s (%s) have val %f\n",
-					  hindex, buf, buf2, object.mag);
-			oor++;
-			continue;
+			adb_error(db, "cant read line %d\n", j);
+			break;
 		}
 
-		table->file_index.histo[hindex]++;
-		used++;
+		histogram_add_row(db, table, &histo, line);
 		histo_inc(db, j);
 	}
 
-out:
-	adb_info(db, ADB_LOG_CDS_IMPORT,
-			 "Used %d objects for histogram %d out of range %d blank\n", used,
-			 oor, blank);
-	if (table->object.count == 0)
-		table->object.count = used;
-	histo_depth_calc(db, table, histo);
-	fseek(f, 0, SEEK_SET);
+	histogram_end(db, table, &histo);
 	free(line);
 	return 0;
 }
@@ -677,7 +912,7 @@ static int import_object_ascending(struct adb_db *db, struct adb_object *object,
 
 	vertex.ra = adb_object_ra(object);
 	vertex.dec = adb_object_dec(object);
-	trixel = htm_get_home_trixel(htm, &vertex, depth);
+	trixel = htm_new_home_trixel(htm, &vertex, depth);
 	if (!trixel) {
 		adb_error(db, "no trixel at RA %f DEC %f\n",
 				  adb_object_ra(object) * R2D, adb_object_dec(object) * R2D);
@@ -703,7 +938,7 @@ static int import_object_descending(struct adb_db *db,
 
 	vertex.ra = adb_object_ra(object);
 	vertex.dec = adb_object_dec(object);
-	trixel = htm_get_home_trixel(htm, &vertex, depth);
+	trixel = htm_new_home_trixel(htm, &vertex, depth);
 	if (!trixel) {
 		adb_error(db, "no trixel at RA %f DEC %f\n",
 				  adb_object_ra(object) * R2D, adb_object_dec(object) * R2D);
@@ -722,245 +957,529 @@ static int import_object_descending(struct adb_db *db,
 		adb_info(db, ADB_LOG_CDS_IMPORT, "\r Imported %3.1f percent", pc); \
 	}
 
-/**
- * @brief Parse text strings into the table's structural objects memory cache buffer arrays.
- *
- * Reads flat-text formatted catalog dumps, utilizing predefined schema keys and structural bindings
- * dynamically locating offsets importing converted values mapping each delimited string component backwards
- * into raw struct storage blocks allocated sequentially into array pools for the active adb_table environment.
- *
- * @param db Operating hierarchical tracking schema mapping object properties offsets bounds contexts.
- * @param table_id Logical index targeting an active tracked database component table instances layout schemas constraints parameters.
- * @param f Reference pointing towards actively loaded stream source flat-file data resources target text buffers arrays sequences.
- * @return Zero indicating positive successful termination states or negative failure condition variants.
+/*
+ * Rows are imported into a single arena of table->object.count objects and
+ * KD nodes rather than a calloc() per row. Each catalog row owns the slot at
+ * its line number so rows can be parsed independently of each other. The
+ * arena lives until the trixels are written.
  */
-static int import_rows(struct adb_db *db, int table_id, FILE *f)
+static int import_arena_new(struct adb_db *db, struct adb_table *table)
 {
-	struct adb_table *table;
-	struct adb_object *object;
-	int i, j, count = 0, short_records = 0;
-	int import, warn = 0, line_count = 0, blank = 0;
-	int div, pc_count = 0;
-	char *line, buf[ADB_IMPORT_LINE_SIZE];
-	float pc = 0.0;
-	size_t size;
-	ssize_t rsize;
+	import_arena_free(table);
 
-	line = malloc(ADB_IMPORT_LINE_SIZE);
-	if (line == NULL)
-		return -ENOMEM;
+	table->import.arena_objects =
+		calloc(table->object.count, table->object.bytes);
+	if (table->import.arena_objects == NULL)
+		goto err;
 
-	table = &db->table[table_id];
-	if (table->object.bytes == 0) {
-		adb_error(db, "error: object size is 0\n");
-		return -EINVAL;
-	}
+	table->import.arena_kd =
+		calloc(table->object.count, sizeof(struct adb_kd_tree));
+	if (table->import.arena_kd == NULL)
+		goto err;
 
-	adb_info(db, ADB_LOG_CDS_IMPORT,
-			 "Starting import with objects %d size %d bytes\n",
-			 table->object.count, table->object.bytes);
+	table->import.arena_size = table->object.count;
+	return 0;
 
-	size = table->import.text_length + 10;
-	div = table->object.count / 10000;
+err:
+	adb_error(db, "failed to allocate import arena for %d objects\n",
+			  table->object.count);
+	import_arena_free(table);
+	return -ENOMEM;
+}
 
-	for (j = 0; j < table->object.count; j++) {
-		object = calloc(1, table->object.bytes);
-		if (object == NULL) {
-			free(line);
-			return -ENOMEM;
-		}
+void import_arena_free(struct adb_table *table)
+{
+	free(table->import.arena_objects);
+	free(table->import.arena_kd);
+	table->import.arena_objects = NULL;
+	table->import.arena_kd = NULL;
+	table->import.arena_size = 0;
+}
 
-		object->import.kd = calloc(1, sizeof(struct adb_kd_tree));
-		if (object->import.kd == NULL) {
-			free(object);
-			free(line);
-			return -ENOMEM;
-		}
+/* grow the arena for a table imported without a known row count */
+static int import_arena_grow(struct adb_db *db, struct adb_table *table,
+							 int size)
+{
+	int old = table->import.arena_size;
+	void *objects;
+	struct adb_kd_tree *kd;
 
-		bzero(line, ADB_IMPORT_LINE_SIZE);
+	objects = realloc(table->import.arena_objects,
+					  (size_t)size * table->object.bytes);
+	if (objects == NULL)
+		goto err;
+	table->import.arena_objects = objects;
 
-		/* try and read a little extra padding */
-		rsize = getline(&line, &size, f);
-		if (rsize <= 0) {
-			free(object);
-			goto out;
-		}
-		if (rsize < table->import.text_length)
-			short_records++;
+	kd = realloc(table->import.arena_kd,
+				 (size_t)size * sizeof(struct adb_kd_tree));
+	if (kd == NULL)
+		goto err;
+	table->import.arena_kd = kd;
 
-		/* create row by importing column (field) data */
-		for (i = 0; i < table->object.field_count; i++) {
-			bzero(buf, table->import.text_buffer_bytes);
-			strncpy(buf, line + table->import.field[i].text_offset,
-					table->import.field[i].text_size);
+	memset(objects + (size_t)old * table->object.bytes, 0,
+		   (size_t)(size - old) * table->object.bytes);
+	memset(kd + old, 0, (size_t)(size - old) * sizeof(struct adb_kd_tree));
+	table->import.arena_size = size;
+	return 0;
 
-			/* terminate string */
-			if (table->import.field[i].type == ADB_CTYPE_STRING)
-				buf[table->import.field[i].text_size] = 0;
-
-			import = table->import.field[i].import(
-				object, table->import.field[i].struct_offset, buf);
-			if (import < 0) {
-				adb_vdebug(db, ADB_LOG_CDS_IMPORT, " blank field %s\n",
-						   table->import.field[i].symbol);
-				blank++;
-			}
-		}
+err:
+	adb_error(db, "failed to grow import arena to %d objects\n", size);
+	return -ENOMEM;
+}
 
-		/* import row into table */
-		import = table->object.import(db, object, table);
-		if (import == 0)
-			warn++;
-		else if (import == 1)
-			count++;
-		else {
-			adb_error(db, "failed to import object at line %d: %s\n", j, line);
-			return -EINVAL;
-		}
+/* get the arena slot for the catalog row */
+static inline struct adb_object *import_arena_object(struct adb_table *table,
+													int row)
+{
+	struct adb_object *object;
 
-		if (warn) {
-			adb_vdebug(db, ADB_LOG_CDS_IMPORT, "At line %d with length %d :-\n",
-					   line_count, strlen(line));
-			adb_vdebug(db, ADB_LOG_CDS_IMPORT, "line %s\n\n", line);
-		}
-		line_count++;
-		import_inc(db, pc_count, pc, div);
+	object = table->import.arena_objects + row * table->object.bytes;
+	object->import.kd = &table->import.arena_kd[row];
+	return object;
+}
+
+/*! \struct import_update
+ * \brief Key index of the objects of a table being updated.
+ * \ingroup import
+ *
+ * Open addressed slots hold the arena slot + 1 of the object with each key,
+ * so a row with the key of an object already in the table replaces it.
+ */
+struct import_update {
+	int offset; /*!< key field offset in the object */
+	int size; /*!< key field size in bytes */
+	unsigned int mask; /*!< slot mask, the slot count is a power of 2 */
+	int *slot; /*!< arena slot + 1 of each key or 0 */
+	int replaced; /*!< objects replaced by updated rows */
+};
+
+/* hash the key bytes of an object, 0 for objects without a key */
+static unsigned int update_hash(const struct import_update *update,
+								const struct adb_object *object)
+{
+	const unsigned char *key = (const void *)object + update->offset;
+	unsigned int val = 2166136261u;
+	int i, blank = 1;
+
+	for (i = 0; i < update->size; i++) {
+		val ^= key[i];
+		val *= 16777619u;
+		blank &= key[i] == 0;
 	}
 
-out:
-	adb_info(db, ADB_LOG_CDS_IMPORT,
-			 "Got %d short, %d blank records %d warnings\n", short_records,
-			 blank, warn);
-	adb_info(db, ADB_LOG_CDS_IMPORT, "Imported %d records\n", count);
-	table->object.count = count;
-	free(line);
-	return count;
+	return blank ? 0 : hash_int(val) | 1;
 }
 
-static int import_rows_with_alternatives(struct adb_db *db, int table_id,
-										 FILE *f)
+/* find the key slot of the object, or the empty slot for its key */
+static int *update_find(struct import_update *update,
+						struct adb_table *table,
+						const struct adb_object *object, unsigned int hash)
 {
-	struct adb_table *table;
-	int i, j, k, count = 0, short_records = 0, warn, import, line_count = 0;
-	int div, pc_count = 0;
-	float pc = 0.0;
-	char *line;
-	char buf[ADB_IMPORT_LINE_SIZE], buf2[ADB_IMPORT_LINE_SIZE];
-	struct adb_object *object;
-	size_t size;
-	ssize_t rsize;
+	const void *key = (const void *)object + update->offset;
+	unsigned int i = hash & update->mask;
+	const void *found;
+
+	while (update->slot[i]) {
+		found = table->import.arena_objects +
+				(update->slot[i] - 1) * table->object.bytes;
+		if (!memcmp(found + update->offset, key, update->size))
+			break;
+		i = (i + 1) & update->mask;
+	}
 
-	line = malloc(ADB_IMPORT_LINE_SIZE);
-	if (line == NULL)
-		return -ENOMEM;
+	return &update->slot[i];
+}
 
-	table = &db->table[table_id];
-	if (table->object.bytes == 0) {
-		adb_error(db, "error: object size is 0\n");
-		return -EINVAL;
-	}
+/* remove an imported object from its trixel list */
+static int import_remove_object(struct adb_db *db, struct adb_object *object,
+								struct adb_table *table)
+{
+	struct adb_object **next;
+	struct htm_trixel *trixel;
+	struct htm_vertex vertex;
+	int depth;
 
-	adb_info(db, ADB_LOG_CDS_IMPORT,
-			 "Starting alt import with objects %d size %d bytes\n",
-			 table->object.count, table->object.bytes);
-	adb_info(db, ADB_LOG_CDS_IMPORT, "Importing %d alt fields\n",
-			 table->object.num_alt_fields);
+	depth = import_get_object_depth_min(table, adb_object_mag(object));
+	if (depth < 0)
+		return -EINVAL;
 
-	size = table->import.text_length + 10;
-	div = table->object.count / 10000;
+	vertex.ra = adb_object_ra(object);
+	vertex.dec = adb_object_dec(object);
+	trixel = htm_new_home_trixel(db->htm, &vertex, depth);
+	if (!trixel)
+		return -EINVAL;
 
-	for (j = 0; j < table->object.count; j++) {
-		object = calloc(1, table->object.bytes);
-		if (object == NULL) {
-			free(line);
-			return -ENOMEM;
+	for (next = &trixel->data[table->id].objects; *next;
+		 next = &(*next)->import.next) {
+		if (*next == object) {
+			*next = object->import.next;
+			trixel->data[table->id].num_objects--;
+			return 0;
 		}
+	}
 
-		object->import.kd = calloc(1, sizeof(struct adb_kd_tree));
-		if (object->import.kd == NULL) {
-			free(object);
-			free(line);
-			return -ENOMEM;
-		}
+	return -ENOENT;
+}
 
-		warn = 0;
-		bzero(line, ADB_IMPORT_LINE_SIZE);
+/*
+ * Index the key of an imported row. A row with the key of an object that is
+ * already in the table replaces the object.
+ */
+static void import_update_row(struct adb_db *db, struct adb_table *table,
+							  int row)
+{
+	struct import_update *update = table->import.update;
+	struct adb_object *object, *old;
+	unsigned int hash;
+	int *slot;
+
+	object = table->import.arena_objects + row * table->object.bytes;
+	if (update->size == 0)
+		return;
+	hash = update_hash(update, object);
+	if (hash == 0)
+		return;
+
+	slot = update_find(update, table, object, hash);
+	if (*slot) {
+		old = table->import.arena_objects + (*slot - 1) * table->object.bytes;
+		if (import_remove_object(db, old, table) == 0)
+			update->replaced++;
+		else
+			adb_error(db, "failed to remove object at slot %d\n", *slot - 1);
+	}
+	*slot = row + 1;
+}
 
-		/* try and read a little extra padding */
-		rsize = getline(&line, &size, f);
-		if (rsize < 0) {
-			free(object);
-			goto out;
-		}
+/*! \struct import_chunk
+ * \brief Block of catalog text rows.
+ * \ingroup import
+ *
+ * Rows are copied into fixed size, zero padded slots so that short records
+ * read as blank fields, just like a bzero()ed line buffer.
+ */
+struct import_chunk {
+	char *text; /*!< rows * stride bytes of row text */
+	size_t stride; /*!< bytes per row */
+	int rows; /*!< rows in chunk */
+	int short_records; /*!< rows shorter than the record length */
+};
+
+/* read up to max_rows catalog rows into the chunk */
+static int import_read_chunk(struct adb_table *table,
+							 struct import_chunk *chunk, FILE *f, char **line,
+							 size_t *size, int max_rows)
+{
+	ssize_t rsize;
+	char *row;
+
+	for (chunk->rows = 0; chunk->rows < max_rows; chunk->rows++) {
+		rsize = getline(line, size, f);
+		if (rsize <= 0)
+			break;
 		if (rsize < table->import.text_length)
-			short_records++;
+			chunk->short_records++;
+		if (rsize >= chunk->stride)
+			rsize = chunk->stride - 1;
+
+		row = chunk->text + chunk->rows * chunk->stride;
+		memcpy(row, *line, rsize);
+		memset(row + rsize, 0, chunk->stride - rsize);
+	}
 
-		/* create row by importing field data */
-		for (i = 0; i < table->object.field_count; i++) {
+	return chunk->rows;
+}
+
+/* import the row text columns into the object, returns blank field count */
+static int import_row_fields(struct adb_db *db, struct adb_table *table,
+							 struct adb_object *object, const char *line)
+{
+	struct adb_schema_field *field;
+	char buf[ADB_IMPORT_LINE_SIZE];
+	int i, ret, blank = 0;
+
+	for (i = 0; i < table->object.field_count; i++) {
+		field = &table->import.field[i];
+
+		if (likely(table->import.field_parse[i] != NULL)) {
+			/* parse straight from the row text */
+			ret = table->import.field_parse[i](object, field->struct_offset,
+											   line + field->text_offset,
+											   field->text_size);
+		} else {
+			/* custom importers take a terminated copy of the field */
 			bzero(buf, table->import.text_buffer_bytes);
-			strncpy(buf, line + table->import.field[i].text_offset,
-					table->import.field[i].text_size);
+			strncpy(buf, line + field->text_offset, field->text_size);
 
 			/* terminate string */
-			if (table->import.field[i].type == ADB_CTYPE_STRING)
-				buf[table->import.field[i].text_size] = 0;
+			if (field->type == ADB_CTYPE_STRING)
+				buf[field->text_size] = 0;
 
-			import = table->import.field[i].import(
-				object, table->import.field[i].struct_offset, buf);
+			ret = field->import(object, field->struct_offset, buf);
+		}
 
-			if (import < 0)
-				adb_vdebug(db, ADB_LOG_CDS_IMPORT, " blank field %s\n",
-						   table->import.field[i].symbol);
+		if (ret < 0) {
+			adb_vdebug(db, ADB_LOG_CDS_IMPORT, " blank field %s\n",
+					   field->symbol);
+			blank++;
 		}
+	}
+
+	return blank;
+}
 
-		/* complete row by importing alt field data */
-		for (k = 0; k < table->object.num_alt_fields; k++) {
+/* complete the object from the alt field columns, returns blank count */
+static int import_row_alt_fields(struct adb_db *db, struct adb_table *table,
+								 struct adb_object *object, const char *line)
+{
+	char buf[ADB_IMPORT_LINE_SIZE], buf2[ADB_IMPORT_LINE_SIZE];
+	struct alt_field *alt;
+	int k, ret, blank = 0;
+
+	for (k = 0; k < table->object.num_alt_fields; k++) {
+		alt = &table->import.alt_field[k];
+
+		if (likely(alt->parse != NULL)) {
+			ret = alt->parse(object, alt->key_field.struct_offset,
+							 line + alt->key_field.text_offset,
+							 alt->key_field.text_size,
+							 line + alt->alt_field.text_offset,
+							 alt->alt_field.text_size);
+		} else {
 			bzero(buf, table->import.text_buffer_bytes);
 			bzero(buf2, table->import.text_buffer_bytes);
-			strncpy(buf,
-					line + table->import.alt_field[k].key_field.text_offset,
-					table->import.alt_field[k].key_field.text_size);
-			strncpy(buf2,
-					line + table->import.alt_field[k].alt_field.text_offset,
-					table->import.alt_field[k].alt_field.text_size);
-
-			import = table->import.alt_field[k].import(
-				object, table->import.alt_field[k].key_field.struct_offset, buf,
-				buf2);
-			if (import < 0) {
-				adb_vdebug(db, ADB_LOG_CDS_IMPORT, " blank fields %s %s\n",
-						   table->import.alt_field[k].key_field.symbol,
-						   table->import.alt_field[k].alt_field.symbol);
-				warn = 1;
+			strncpy(buf, line + alt->key_field.text_offset,
+					alt->key_field.text_size);
+			strncpy(buf2, line + alt->alt_field.text_offset,
+					alt->alt_field.text_size);
+			ret = alt->import(object, alt->key_field.struct_offset, buf, buf2);
+		}
+
+		if (ret < 0) {
+			adb_vdebug(db, ADB_LOG_CDS_IMPORT, " blank fields %s %s\n",
+					   alt->key_field.symbol, alt->alt_field.symbol);
+			blank++;
+		}
+	}
+
+	return blank;
+}
+
+/* insert the arena row into the HTM, returns 1 if imported or 0 if skipped */
+static int import_insert_row(struct adb_db *db, struct adb_table *table,
+							 int row)
+{
+	struct adb_object *object;
+	int import;
+
+	object = import_arena_object(table, row);
+	import = table->object.import(db, object, table);
+	if (import == 1 && table->import.update)
+		import_update_row(db, table, row);
+	return import;
+}
+
+/**
+ * @brief Import the catalog text rows into the table import arena.
+ *
+ * Rows are read in chunks of ADB_IMPORT_CHUNK_ROWS lines. The column fields
+ * of each chunk are parsed in parallel (when built with OpenMP) into the
+ * arena slot owned by each row, then the rows are inserted into the HTM
+ * serially in file order so the magnitude ordering and depth of every
+ * trixel list is the same as a serial import.
+ *
+ * With a histogram the depth key of each chunk is added to it while the row
+ * text is still in memory, and the rows are only inserted once every row has
+ * been parsed and the HTM depths are known. The arena grows when the table
+ * row count is not known.
+ *
+ * @param db Database catalog
+ * @param table_id Target table ID
+ * @param f Catalog data file
+ * @param first Arena slot of the first row
+ * @param rows Maximum number of rows to import
+ * @param histo Histogram to build before inserting, or NULL
+ * @return Number of imported records, or a negative error code
+ */
+static int import_rows(struct adb_db *db, int table_id, FILE *f, int first,
+					   int rows, struct import_histo *histo)
+{
+	struct adb_table *table;
+	struct adb_object *object;
+	struct import_chunk chunk;
+	int j, k, count = 0, blank = 0, alt_blank, ret;
+	int import, warn = 0, div, pc_count = 0, parsed = 0, size_rows;
+	unsigned char *row_warn;
+	uint64_t start;
+	char *line;
+	float pc = 0.0;
+	size_t size;
+
+	table = &db->table[table_id];
+	if (table->object.bytes == 0) {
+		adb_error(db, "error: object size is 0\n");
+		return -EINVAL;
+	}
+
+	adb_info(db, ADB_LOG_CDS_IMPORT,
+			 "Starting import with objects %d size %d bytes\n", rows,
+			 table->object.bytes);
+	if (table->object.num_alt_fields)
+		adb_info(db, ADB_LOG_CDS_IMPORT, "Importing %d alt fields\n",
+				 table->object.num_alt_fields);
+
+	bzero(&chunk, sizeof(chunk));
+	chunk.stride = ADB_IMPORT_LINE_SIZE;
+	if (chunk.stride <= table->import.text_length)
+		chunk.stride = table->import.text_length + 1;
+
+	size = ADB_IMPORT_LINE_SIZE;
+	line = malloc(size);
+	chunk.text = malloc(chunk.stride * ADB_IMPORT_CHUNK_ROWS);
+	row_warn = malloc(ADB_IMPORT_CHUNK_ROWS);
+	if (line == NULL || chunk.text == NULL || row_warn == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	div = rows / 10000;
+
+	for (j = 0; j < rows; j += chunk.rows) {
+		k = rows - j;
+		if (k > ADB_IMPORT_CHUNK_ROWS)
+			k = ADB_IMPORT_CHUNK_ROWS;
+		if (first + j + k > table->import.arena_size) {
+			size_rows = table->import.arena_size * 2;
+			if (size_rows < first + j + k)
+				size_rows = first + j + k;
+			ret = import_arena_grow(db, table, size_rows);
+			if (ret < 0)
+				goto out;
+		}
+		if (import_read_chunk(table, &chunk, f, &line, &size, k) == 0)
+			break;
+
+		/* parse row fields, each row has its own arena slot */
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) private(object, alt_blank) \
+	reduction(+ : blank) num_threads(db_workers(db))
+#endif
+		for (k = 0; k < chunk.rows; k++) {
+			object = import_arena_object(table, first + j + k);
+			blank += import_row_fields(db, table, object,
+									   chunk.text + k * chunk.stride);
+
+			alt_blank = 0;
+			if (table->object.num_alt_fields)
+				alt_blank = import_row_alt_fields(
+					db, table, object, chunk.text + k * chunk.stride);
+			row_warn[k] = alt_blank ? 1 : 0;
+		}
+
+		/* depths are not known until every row is in the histogram */
+		if (histo) {
+			start = stats_now();
+			for (k = 0; k < chunk.rows; k++) {
+				histogram_add_row(db, table, histo,
+								  chunk.text + k * chunk.stride);
+				warn += row_warn[k];
 			}
+			histo->ns += stats_now() - start;
+			parsed += chunk.rows;
+			continue;
 		}
 
-		/* import row into table */
-		import = table->object.import(db, object, table);
-		if (import == 0)
-			warn = 1;
-		else if (import == 1)
-			count++;
-		else {
-			adb_error(db, "failed to import object at line %d: %s\n", j, line);
-			return -EINVAL;
+		/* insert rows into the HTM in file order */
+		for (k = 0; k < chunk.rows; k++) {
+			import = import_insert_row(db, table, first + j + k);
+			if (import == 0)
+				row_warn[k] = 1;
+			else if (import == 1)
+				count++;
+			else {
+				adb_error(db, "failed to import object at line %d: %s\n",
+						  j + k, chunk.text + k * chunk.stride);
+				ret = -EINVAL;
+				goto out;
+			}
+
+			if (row_warn[k]) {
+				warn++;
+				adb_vdebug(db, ADB_LOG_CDS_IMPORT,
+						   "At line %d with length %d :-\n", j + k,
+						   strlen(chunk.text + k * chunk.stride));
+				adb_vdebug(db, ADB_LOG_CDS_IMPORT, "line %s\n\n",
+						   chunk.text + k * chunk.stride);
+			}
+			import_inc(db, pc_count, pc, div);
 		}
+	}
 
-		if (warn) {
-			adb_vdebug(db, ADB_LOG_CDS_IMPORT, "At line %d with length %d :-\n",
-					   line_count, strlen(line));
-			adb_vdebug(db, ADB_LOG_CDS_IMPORT, "line %s\n\n", line);
+	if (histo) {
+		start = stats_now();
+		histogram_end(db, table, histo);
+		histo->ns += stats_now() - start;
+
+		/* insert the parsed rows into the HTM in file order */
+		div = parsed / 10000;
+		for (j = 0; j < parsed; j++) {
+			import = import_insert_row(db, table, first + j);
+			if (import == 0)
+				warn++;
+			else if (import == 1)
+				count++;
+			else {
+				adb_error(db, "failed to import object at line %d\n", j);
+				ret = -EINVAL;
+				goto out;
+			}
+			import_inc(db, pc_count, pc, div);
 		}
-		line_count++;
-		import_inc(db, pc_count, pc, div);
 	}
 
-out:
-	adb_info(db, ADB_LOG_CDS_IMPORT, "Got %d short records\n", short_records);
+	adb_info(db, ADB_LOG_CDS_IMPORT,
+			 "Got %d short, %d blank records %d warnings\n",
+			 chunk.short_records, blank, warn);
 	adb_info(db, ADB_LOG_CDS_IMPORT, "Imported %d records\n", count);
-	table->object.count = count;
+	ret = count;
+
+out:
+	free(row_warn);
+	free(chunk.text);
 	free(line);
-	return count;
+	return ret;
+}
+
+/*
+ * Single pass import. The rows are parsed into the arena with the depth key
+ * added to the histogram as each chunk is read, so the data file is read
+ * once. A table without a known row count grows the arena as it is read.
+ */
+static int table_import_single(struct adb_db *db, int table_id,
+							   struct cds_stream *stream)
+{
+	struct adb_table *table = &db->table[table_id];
+	struct import_histo histo;
+	uint64_t start;
+	int ret, rows = table->object.count;
+
+	start = stats_now();
+	histogram_begin(db, table, &histo);
+
+	/* allocate import arena */
+	import_arena_free(table);
+	if (rows) {
+		ret = import_arena_new(db, table);
+		if (ret < 0)
+			return ret;
+	} else
+		rows = INT_MAX;
+
+	ret = import_rows(db, table_id, cds_stream_file(stream), 0, rows, &histo);
+	stats_add(&db->stats, STATS_IMPORT_HISTOGRAM_NS, histo.ns);
+	stats_add(&db->stats, STATS_IMPORT_ROWS_NS,
+			  stats_now() - start - histo.ns);
+	return ret;
 }
 
 /**
@@ -972,21 +1491,20 @@ out:
  *
  * @param db Database catalog
  * @param table_id Target ID of the table to import to
- * @param file Path to the data file to import
+ * @param ext Data file extension, appended to the table file name
  * @return The total number of valid imported records, or a negative error code
  */
-int table_import(struct adb_db *db, int table_id, char *file)
+int table_import(struct adb_db *db, int table_id, const char *ext)
 {
 	struct adb_table *table;
-	FILE *f;
-	char file_path[ADB_PATH_SIZE];
-	int ret;
+	struct cds_stream *stream;
+	uint64_t start;
+	int ret, err;
 
 	table = &db->table[table_id];
-	sprintf(file_path, "%s%s", table->path.local, file);
 	adb_info(db, ADB_LOG_CDS_IMPORT,
-			 "Importing table %s from CDS ASCII format file %s\n", file_path,
-			 file);
+			 "Importing table %s from CDS ASCII format file %s%s\n",
+			 table->path.local, table->path.file, ext);
 
 	/* make sure we have valid import type */
 	if (!table->object.import) {
@@ -994,42 +1512,369 @@ int table_import(struct adb_db *db, int table_id, char *file)
 		return -EINVAL;
 	}
 
-	/* open data file */
-	f = fopen(file_path, "r");
-	if (f == NULL) {
-		adb_debug(db, ADB_LOG_CDS_IMPORT, "failed to open file %s\n", file_path);
+	/* open data file(s) */
+	stream = cds_stream_open(db, table, ext);
+	if (stream == NULL)
 		return -EIO;
-	}
 
 	/* order the into into ascending order */
 	schema_order_import_index(db, table);
 
 	/* calculate import buffer size */
 	get_import_buffer_size(db, table);
+	get_import_parsers(db, table);
 
-	/* calculate histogram of size/magnitude */
 	get_histogram_keys(db, table);
-	if (table->import.histogram_key)
-		table_histogram_import(db, table, f);
-	else
-		table_histogram_alt_import(db, table, f);
+	if (db->import_single_pass) {
+		ret = table_import_single(db, table_id, stream);
+		if (ret < 0)
+			goto out;
+		goto kd;
+	}
+
+	/* calculate histogram of size/magnitude */
+	start = stats_now();
+	table_histogram_import(db, table, cds_stream_file(stream));
+	stats_add_time(&db->stats, STATS_IMPORT_HISTOGRAM_NS, start);
+
+	ret = cds_stream_rewind(stream);
+	if (ret < 0)
+		goto out;
+
+	/* allocate import arena */
+	ret = import_arena_new(db, table);
+	if (ret < 0)
+		goto out;
 
 	/* import rows */
-	if (table->object.num_alt_fields)
-		ret = import_rows_with_alternatives(db, table_id, f);
-	else
-		ret = import_rows(db, table_id, f);
+	start = stats_now();
+	ret = import_rows(db, table_id, cds_stream_file(stream), 0,
+					  table->object.count, NULL);
+	stats_add_time(&db->stats, STATS_IMPORT_ROWS_NS, start);
 	if (ret < 0)
 		goto out;
 
+kd:
+	stats_add(&db->stats, STATS_IMPORT_OBJECTS, ret);
+	table->object.count = ret;
+
 	/* build KD-Tree */
+	start = stats_now();
 	ret = import_build_kdtree(db, table);
+	stats_add_time(&db->stats, STATS_IMPORT_KD_NS, start);
 
 out:
+	/* a stream that failed to inflate has lost rows */
+	err = cds_stream_close(stream);
+	if (err < 0 && ret >= 0)
+		ret = err;
+	if (ret < 0)
+		import_arena_free(table);
+	return ret;
+}
+
+/* count the rows of an update data file */
+static int update_count_rows(FILE *f)
+{
+	char *line = NULL;
+	size_t size = 0;
+	int rows = 0;
+
+	while (getline(&line, &size, f) > 0)
+		rows++;
+
+	free(line);
+	rewind(f);
+	return rows;
+}
+
+/*
+ * Load the objects of the table file into the start of a new import arena
+ * with room for the update rows, and put them back into their trixel lists.
+ * Objects are inserted faintest first so each one goes to the head of its
+ * list rather than walking it.
+ */
+static int update_load_objects(struct adb_db *db, struct adb_table *table,
+							   struct import_update *update, int rows)
+{
+	enum adb_table_load load = db->table_load;
+	struct adb_object *object;
+	unsigned int hash;
+	int i, old, ret, count = 0, *slot;
+
+	ret = schema_read_index(db, table);
+	if (ret < 0)
+		return ret;
+	old = table->object.count;
+
+	/* read a private copy */
+	db->table_load = ADB_TABLE_LOAD_COPY;
+	ret = table_read_trixels(db, table);
+	db->table_load = load;
+	if (ret < 0)
+		return ret;
+	table_clear_trixels(db, table->id);
+	memset(table->depth_count, 0, sizeof(table->depth_count));
+
+	table->object.count = old + rows;
+	ret = import_arena_new(db, table);
+	if (ret < 0)
+		goto out;
+	memcpy(table->import.arena_objects, table->objects,
+		   (size_t)old * table->object.bytes);
+
+	/* key slots are never more than half full */
+	for (update->mask = 1; update->mask < 2 * (old + rows);)
+		update->mask <<= 1;
+	update->slot = calloc(update->mask--, sizeof(int));
+	if (update->slot == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = old - 1; i >= 0; i--) {
+		object = import_arena_object(table, i);
+		object->import.next = NULL;
+
+		ret = table->object.import(db, object, table);
+		if (ret < 0)
+			goto out;
+		if (ret == 0) {
+			adb_warn(db, ADB_LOG_CDS_IMPORT,
+					 "object at %d outside the table limits\n", i);
+			continue;
+		}
+		count++;
+
+		hash = update->size ? update_hash(update, object) : 0;
+		if (hash == 0)
+			continue;
+		slot = update_find(update, table, object, hash);
+		if (*slot == 0)
+			*slot = i + 1;
+	}
+	ret = count;
+
+out:
+	table_free_trixels(table);
+	return ret;
+}
+
+/* remove the hash maps and quad index built from the old table file */
+static void update_remove_caches(struct adb_db *db, struct adb_table *table)
+{
+	char file[ADB_PATH_SIZE];
+	struct dirent *entry;
+	size_t len, elen;
+	DIR *dir;
+
+	dir = opendir(table->path.local);
+	if (dir == NULL)
+		return;
+
+	len = strlen(table->path.file);
+	while ((entry = readdir(dir)) != NULL) {
+		elen = strlen(entry->d_name);
+		if (elen <= len + 5 || strncmp(entry->d_name, table->path.file, len) ||
+			entry->d_name[len] != '.' ||
+			(strcmp(entry->d_name + elen - 5, ".hash") &&
+			 strcmp(entry->d_name + elen - 5, ".quad")))
+			continue;
+
+		snprintf(file, ADB_PATH_SIZE, "%s%s", table->path.local,
+				 entry->d_name);
+		adb_info(db, ADB_LOG_CDS_TABLE, "Removing stale %s\n", file);
+		unlink(file);
+	}
+
+	closedir(dir);
+}
+
+/**
+ * @brief Apply new and changed catalog rows to an imported table.
+ *
+ * The objects of the table file are loaded back into their trixels using
+ * the depth map saved at import, the rows of the update file are parsed and
+ * inserted, then the KD tree is rebuilt and the table file rewritten. The
+ * catalog data files are not read again and no histogram is taken.
+ *
+ * @param db Database catalog
+ * @param table_id Table set up by adb_table_import_new() and schema
+ * @param file Data file with the new and changed rows
+ * @param key Field matching changed rows to objects or NULL to append
+ * @return The number of objects in the updated table or a negative error
+ */
+int adb_table_import_update(struct adb_db *db, int table_id, const char *file,
+							const char *key)
+{
+	struct import_update update;
+	struct adb_table *table;
+	int idx, rows, count, ret;
+	uint64_t start;
+	FILE *f;
+
+	if (table_id < 0 || table_id >= ADB_MAX_TABLES)
+		return -EINVAL;
+	if (db_check_thawed(db) < 0)
+		return -EBUSY;
+	if (db_check_local(db) < 0)
+		return -EOPNOTSUPP;
+	table = &db->table[table_id];
+
+	if (!table->object.import || table->path.file == NULL) {
+		adb_error(db, "Invalid object import\n");
+		return -EINVAL;
+	}
+
+	bzero(&update, sizeof(update));
+	if (key) {
+		idx = schema_get_field(db, table, key);
+		if (idx < 0) {
+			adb_error(db, "field not found %s\n", key);
+			return -EINVAL;
+		}
+		update.offset = table->import.field[idx].struct_offset;
+		update.size = table->import.field[idx].struct_bytes;
+	}
+
+	f = fopen(file, "r");
+	if (f == NULL) {
+		ret = -errno;
+		adb_error(db, "Error can't open update file %s %d\n", file, ret);
+		return ret;
+	}
+
+	adb_info(db, ADB_LOG_CDS_IMPORT, "Updating table %s%s from %s\n",
+			 table->path.local, table->path.file, file);
+
+	schema_order_import_index(db, table);
+	get_import_buffer_size(db, table);
+	get_import_parsers(db, table);
+
+	rows = update_count_rows(f);
+	count = update_load_objects(db, table, &update, rows);
+	if (count < 0) {
+		ret = count;
+		goto out;
+	}
+
+	/* import rows after the table objects */
+	table->import.update = &update;
+	start = stats_now();
+	ret = import_rows(db, table_id, f, table->object.count - rows, rows,
+					  NULL);
+	stats_add_time(&db->stats, STATS_IMPORT_ROWS_NS, start);
+	table->import.update = NULL;
+	if (ret < 0)
+		goto out;
+	stats_add(&db->stats, STATS_IMPORT_OBJECTS, ret);
+
+	table->object.count = count + ret - update.replaced;
+	adb_info(db, ADB_LOG_CDS_IMPORT,
+			 "Updated with %d records replacing %d objects\n", ret,
+			 update.replaced);
+
+	/* the KD tree indexes the whole table */
+	start = stats_now();
+	ret = import_build_kdtree(db, table);
+	stats_add_time(&db->stats, STATS_IMPORT_KD_NS, start);
+	if (ret < 0)
+		goto out;
+
+	start = stats_now();
+	ret = schema_write(db, table);
+	if (ret < 0) {
+		adb_error(db, "Error failed to save table schema %d\n", ret);
+		goto out;
+	}
+
+	ret = table_write_trixels(db, table);
+	stats_add_time(&db->stats, STATS_IMPORT_WRITE_NS, start);
+	if (ret < 0) {
+		adb_error(db, "Error failed write table objects %d\n", ret);
+		goto out;
+	}
+
+	update_remove_caches(db, table);
+	ret = table->object.count;
+
+out:
+	table_clear_trixels(db, table_id);
+	import_arena_free(table);
+	free(update.slot);
 	fclose(f);
+	free(table->path.file);
+	table->path.file = NULL;
 	return ret;
 }
 
+/**
+ * @brief Stream compressed or split catalog data files into the importer.
+ *
+ * @param db Database catalog
+ * @param enable Non zero to stream the data files
+ */
+void adb_set_import_stream(struct adb_db *db, int enable)
+{
+	db->import_stream = enable;
+}
+
+/**
+ * @brief Import catalog data files in one pass.
+ *
+ * @param db Database catalog
+ * @param enable Non zero to read the data files once
+ */
+void adb_set_import_single_pass(struct adb_db *db, int enable)
+{
+	db->import_single_pass = enable;
+}
+
+/**
+ * @brief Set how the KD tree is built for imported tables.
+ *
+ * @param db Database catalog
+ * @param build KD tree build mode
+ */
+void adb_set_kd_build(struct adb_db *db, enum adb_kd_build build)
+{
+	db->kd_build = build;
+}
+
+/**
+ * @brief Set how imported tables store their objects in the table file.
+ *
+ * @param db Database catalog
+ * @param encoding Table file encoding
+ */
+void adb_set_table_encoding(struct adb_db *db,
+							enum adb_table_encoding encoding)
+{
+	db->table_encoding = encoding;
+}
+
+/**
+ * @brief Set the object order of imported table files.
+ *
+ * @param db Database catalog
+ * @param layout Table file layout
+ */
+void adb_set_table_layout(struct adb_db *db, enum adb_table_layout layout)
+{
+	db->table_layout = layout;
+}
+
+/**
+ * @brief Store trixel aggregates in imported table files.
+ *
+ * @param db Database catalog
+ * @param enable Non zero to store the aggregates
+ */
+void adb_set_table_aggregates(struct adb_db *db, int enable)
+{
+	db->table_aggregates = enable;
+}
+
 /**
  * @brief Set an alternative import data field as a fallback.
  *
@@ -1167,6 +2012,11 @@ int adb_table_import_new(struct adb_db *db, const char *cat_class,
 	char local[ADB_PATH_SIZE];
 	char remote[ADB_PATH_SIZE];
 
+	if (db_check_thawed(db) < 0)
+		return -EBUSY;
+	if (db_check_local(db) < 0)
+		return -EOPNOTSUPP;
+
 	table_id = table_get_id(db);
 	if (table_id < 0)
 		return -EINVAL;
@@ -1199,6 +2049,7 @@ int adb_table_import_new(struct adb_db *db, const char *cat_class,
 	if (table->path.local == NULL)
 		goto err;
 	table->cds.host = db->lib->host;
+	table->cds.mirror = db->lib->mirror;
 	table->import.depth_field = depth_field;
 
 	adb_info(db, ADB_LOG_CDS_TABLE, "Table local path %s\n", table->path.local);
@@ -1220,6 +2071,7 @@ int adb_table_import_new(struct adb_db *db, const char *cat_class,
 	err = cds_get_readme(db, table_id);
 	if (err < 0) {
 		adb_error(db, "Failed to create table %s err %d\n", table_name, err);
+		cds_fetch_finish(table);
 		return err;
 	}
 
@@ -1227,6 +2079,7 @@ int adb_table_import_new(struct adb_db *db, const char *cat_class,
 	err = table_parse_readme(db, table_id);
 	if (err < 0) {
 		adb_error(db, "Failed to create table %s err %d\n", table_name, err);
+		cds_fetch_finish(table);
 		return err;
 	}
 
@@ -1276,6 +2129,7 @@ int adb_table_import_new(struct adb_db *db, const char *cat_class,
 
 err:
 	adb_error(db, "Failed to create new table %s\n", table_name);
+	cds_fetch_finish(table);
 	free(table->cds.cat_class);
 	free(table->cds.index);
 	free(table->path.remote);
@@ -1291,21 +2145,13 @@ static const char *file_extensions[] = {
 	"",
 };
 
-/**
- * @brief Executes sequence downloading and processing target catalogs natively into memory models.
- *
- * Primary public handler executing discovery, download, and file-parsing routines mapping
- * registered ReadMe specifications onto native C structs arrays configured to hold target elements.
- *
- * @param db Catalog database reference mapping states configuration tables structures limits pointers descriptors identifiers.
- * @param table_id Logical targeting active descriptor identifier pointer linking.
- * @return Returns termination logic status descriptors (zero identifying completion).
- */
-int adb_table_import(struct adb_db *db, int table_id)
+/* find, download and import the table data files */
+static int table_import_files(struct adb_db *db, int table_id)
 {
 	struct adb_table *table = &db->table[table_id];
 	int ret = -EINVAL, num_files, i;
 	char file[ADB_PATH_SIZE];
+	uint64_t start;
 
 	/* do we have an alternate dataset configured ? */
 	if (table->import.alt_dataset) {
@@ -1332,6 +2178,10 @@ int adb_table_import(struct adb_db *db, int table_id)
 	for (i = 0; i < adb_size(file_extensions); i++) {
 		/* try split files */
 		ret = cds_get_split_dataset(db, table, file_extensions[i]);
+
+		/* streamed parts are imported while they download */
+		if (ret == 0 && table->cds.fetch)
+			goto import;
 		if (ret == 0)
 			goto prepare;
 	}
@@ -1365,7 +2215,7 @@ i < adb_size(file_extensions); i++)
 	memset(file, 0, ADB_PATH_SIZE);
 	sprintf(file, "%s%s", table->path.file, file_extensions[i]);
 	adb_info(db, ADB_LOG_CDS_TABLE, "Importing CDS ASCII data %s\n", file);
-	ret = table_import(db, table_id, file);
+	ret = table_import(db, table_id, file_extensions[i]);
 	if (ret < 0) {
 		adb_warn(db, ADB_LOG_CDS_TABLE,
 				 "Error failed to import CDS table %s %d\n", table->path.file,
@@ -1381,14 +2231,18 @@ i < adb_size(file_extensions); i++)
 	return ret;
 
 schema:
+	start = stats_now();
 	ret = schema_write(db, table);
 	if (ret < 0) {
 		adb_error(db, "Error failed to save table schema %d\n", ret);
+		import_arena_free(table);
 		free(table->path.file);
 		return ret;
 	}
 
 	ret = table_write_trixels(db, table);
+	stats_add_time(&db->stats, STATS_IMPORT_WRITE_NS, start);
+	import_arena_free(table);
 	if (ret < 0) {
 		adb_error(db, "Error failed write table objects %d\n", ret);
 		free(table->path.file);
@@ -1399,3 +2253,32 @@ schema:
 	table->path.file = NULL;
 	return table->object.count;
 }
+
+/**
+ * @brief Executes sequence downloading and processing target catalogs natively into memory models.
+ *
+ * Primary public handler executing discovery, download, and file-parsing routines mapping
+ * registered ReadMe specifications onto native C structs arrays configured to hold target elements.
+ *
+ * @param db Catalog database reference mapping states configuration tables structures limits pointers descriptors identifiers.
+ * @param table_id Logical targeting active descriptor identifier pointer linking.
+ * @return Returns termination logic status descriptors (zero identifying completion).
+ */
+int adb_table_import(struct adb_db *db, int table_id)
+{
+	struct adb_table *table = &db->table[table_id];
+	int ret, err;
+
+	if (db_check_thawed(db) < 0)
+		return -EBUSY;
+	if (db_check_local(db) < 0)
+		return -EOPNOTSUPP;
+
+	ret = table_import_files(db, table_id);
+
+	/* wait for downloads still feeding a failed streamed import */
+	err = cds_fetch_finish(table);
+	if (ret >= 0 && err < 0)
+		ret = err;
+	return ret;
+}
@@ -41,6 +41,19 @@
 
 struct adb_db;
 
+/*! \typedef import_parse1
+ * \brief Fixed width column parser, reads len chars of unterminated text.
+ * \ingroup import
+ */
+typedef int (*import_parse1)(struct adb_object *, int, const char *, int);
+
+/*! \typedef import_parse2
+ * \brief Fixed width column parser with an alternate source column.
+ * \ingroup import
+ */
+typedef int (*import_parse2)(struct adb_object *, int, const char *, int,
+							 const char *, int);
+
 /*! \struct alt_field
  * \brief Alternate field description.
  * \ingroup import
@@ -51,6 +64,7 @@ struct alt_field {
 	struct adb_schema_field key_field; /*!< Primary field index */
 	struct adb_schema_field alt_field; /*!< Alternate field index */
 	adb_field_import2 import; /*!< Alternate field importer function */
+	import_parse2 parse; /*!< Column parser, NULL for custom importers */
 };
 
 /*! \struct struct cds_importer
@@ -68,6 +82,8 @@ struct cds_importer {
 	struct adb_schema_field
 		field[ADB_TABLE_MAX_FIELDS]; /*!< key and custom field descriptors */
 	struct alt_field alt_field[ADB_TABLE_MAX_ALT_FIELDS]; /*!< alt src data */
+	import_parse1
+		field_parse[ADB_TABLE_MAX_FIELDS]; /*!< column parsers, NULL if custom */
 	int text_length; /*!< length in chars of each record */
 	int text_buffer_bytes; /*!< largest import record text size */
 
@@ -79,8 +95,16 @@ struct cds_importer {
 	/* KD Tree data */
 	int kd_root;
 
+	/* import arena - one object and KD node slot per catalog row */
+	void *arena_objects;
+	struct adb_kd_tree *arena_kd;
+	int arena_size; /*!< rows allocated in the arena */
+
 	/* Alt dataset name - when does not match ReadMe */
 	const char *alt_dataset;
+
+	/* key index of the table objects during an update */
+	struct import_update *update;
 };
 
 typedef int (*object_import)(struct adb_db *, struct adb_object *,
@@ -134,6 +158,14 @@ adb_field_import1 table_get_column_import(struct adb_db *db, adb_ctype type);
  */
 int table_write_trixels(struct adb_db *db, struct adb_table *table);
 
+/*!
+ * \brief Free the table import arena once the objects are written.
+ * \ingroup import
+ *
+ * \param table Pointer to the table being imported
+ */
+void import_arena_free(struct adb_table *table);
+
 /*!
  * \brief Build the KD-Tree for the table during import.
  * \ingroup import
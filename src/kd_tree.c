@@ -19,12 +19,15 @@
 #include <ctype.h> // IWYU pragma: keep
 #include <errno.h> // IWYU pragma: keep
 #include <math.h>
+#include <stddef.h>
 #include <stdio.h> // IWYU pragma: keep
 #include <stdlib.h>
 #include <string.h> // IWYU pragma: keep
 #include <unistd.h>
 
+#include "alloc.h"
 #include "debug.h"
+#include "remote.h"
 #include "table.h"
 #include "libastrodb/db.h"
 #include "libastrodb/object.h"
@@ -32,6 +35,12 @@
 /* debug KD tree search for nearest */
 #define CHECK_KD_TREE 0
 
+/* smallest subtree worth building as a parallel task */
+#define KD_TASK_MIN_ELEMS 4096
+
+/* tree levels a search can track without allocating */
+#define KD_STACK_LEVELS 64
+
 enum kd_pivot {
 	KD_PIVOT_X = 0,
 	KD_PIVOT_Y = 1,
@@ -96,8 +105,8 @@ struct kd_elem {
 struct kd_base {
 	struct adb_db *db; /*!< database */
 	int count; /*!< count */
-	int total; /*!< total */
-	float percent; /*!< percentage */
+	int total; /*!< elements per 0.1 percent progress */
+	int tasks; /*!< build subtrees as parallel tasks */
 	struct kd_base_elem *base; /*!< base array */
 	struct kd_elem *x_base; /*!< X elements */
 	struct kd_elem *y_base; /*!< Y elements */
@@ -114,6 +123,7 @@ struct kd_init {
 	struct kd_base *kbase; /*!< kbase */
 	int table_id; /*!< table ID */
 	int iid; /*!< initial ID */
+	int depth; /*!< layout pass depth, -1 for every depth */
 };
 
 static struct kd_base_elem *kd_x_select_elem(struct kd_base *mbase, int x_start,
@@ -144,24 +154,6 @@ static inline void equ_to_kd_vertex(double ra, double dec, struct kd_vertex *v)
 	v->z = cos_dec * cos(ra);
 }
 
-/**
- * \brief Convert a Cartesian 3D unit vector back to equatorial coordinates.
- *
- * Computes Right Ascension (RA) and Declination (DEC) from a given 3D vector.
- *
- * \param ra Pointer to store the computed Right Ascension in radians.
- * \param dec Pointer to store the computed Declination in radians.
- * \param v The input 3D vertex to convert.
- */
-static inline void kd_vertex_to_equ(double *ra, double *dec,
-									struct kd_vertex *v)
-{
-	*dec = asin(v->y);
-	*ra = atan2(v->x, v->z);
-	if (*ra < 0.0)
-		*ra += 2.0 * M_PI;
-}
-
 /**
  * \brief Extract the X coordinate value from a KD tree element array.
  *
@@ -261,13 +253,10 @@ static int elem_z_cmp(const void *o1, const void *o2)
  * \param elem The KD tree element to validate.
  * \param min The lower bound for the X coordinate.
  * \param max The upper bound for the X coordinate.
- * \return 1 if valid and unused, 0 otherwise.
+ * \return 1 if within bounds, 0 otherwise.
  */
 static inline int valid_x_elem(struct kd_elem *elem, double min, double max)
 {
-	if (elem->base->used)
-		return 0;
-
 	if (elem->base->v.x < min || elem->base->v.x > max)
 		return 0;
 
@@ -280,13 +269,10 @@ static inline int valid_x_elem(struct kd_elem *elem, double min, double max)
  * \param elem The KD tree element to validate.
  * \param min The lower bound for the Y coordinate.
  * \param max The upper bound for the Y coordinate.
- * \return 1 if valid and unused, 0 otherwise.
+ * \return 1 if within bounds, 0 otherwise.
  */
 static inline int valid_y_elem(struct kd_elem *elem, double min, double max)
 {
-	if (elem->base->used)
-		return 0;
-
 	if (elem->base->v.y < min || elem->base->v.y > max)
 		return 0;
 
@@ -299,19 +285,25 @@ static inline int valid_y_elem(struct kd_elem *elem, double min, double max)
  * \param elem The KD tree element to validate.
  * \param min The lower bound for the Z coordinate.
  * \param max The upper bound for the Z coordinate.
- * \return 1 if valid and unused, 0 otherwise.
+ * \return 1 if within bounds, 0 otherwise.
  */
 static inline int valid_z_elem(struct kd_elem *elem, double min, double max)
 {
-	if (elem->base->used)
-		return 0;
-
 	if (elem->base->v.z < min || elem->base->v.z > max)
 		return 0;
 
 	return 1;
 }
 
+/*
+ * Elements are bounds checked before their used flag is read. Elements outside
+ * the bounds may belong to a subtree that is being built by another thread.
+ */
+static inline int unused_elem(struct kd_elem *elem)
+{
+	return !elem->base->used;
+}
+
 /**
  * \brief Find the median element along the X axis within a given bounding box.
  *
@@ -336,18 +328,21 @@ static struct kd_elem *elem_get_median_x_elem(struct kd_elem *x_base,
 	int index = count + x_start, i = 1;
 
 	if (valid_y_elem(&x_base[index], y_min, y_max) &&
-		valid_z_elem(&x_base[index], z_min, z_max))
+		valid_z_elem(&x_base[index], z_min, z_max) &&
+		unused_elem(&x_base[index]))
 		return &x_base[index];
 
 	while (i <= count) {
 		int start = index - i, end = index + i;
 
 		if (valid_y_elem(&x_base[start], y_min, y_max) &&
-			valid_z_elem(&x_base[start], z_min, z_max))
+			valid_z_elem(&x_base[start], z_min, z_max) &&
+			unused_elem(&x_base[start]))
 			return &x_base[start];
 
 		if (valid_y_elem(&x_base[end], y_min, y_max) &&
-			valid_z_elem(&x_base[end], z_min, z_max))
+			valid_z_elem(&x_base[end], z_min, z_max) &&
+			unused_elem(&x_base[end]))
 			return &x_base[end];
 
 		i++;
@@ -355,7 +350,8 @@ static struct kd_elem *elem_get_median_x_elem(struct kd_elem *x_base,
 
 	/* ra end is not checked if gap is even */
 	if ((size & 0x1) != 0 && valid_y_elem(&x_base[x_end], y_min, y_max) &&
-		valid_z_elem(&x_base[x_end], z_min, z_max))
+		valid_z_elem(&x_base[x_end], z_min, z_max) &&
+		unused_elem(&x_base[x_end]))
 		return &x_base[x_end];
 
 	return NULL;
@@ -385,18 +381,21 @@ static struct kd_elem *elem_get_median_y_elem(struct kd_elem *y_base,
 	int index = count + y_start, i = 1;
 
 	if (valid_x_elem(&y_base[index], x_min, x_max) &&
-		valid_z_elem(&y_base[index], z_min, z_max))
+		valid_z_elem(&y_base[index], z_min, z_max) &&
+		unused_elem(&y_base[index]))
 		return &y_base[index];
 
 	while (i <= count) {
 		int start = index - i, end = index + i;
 
 		if (valid_x_elem(&y_base[start], x_min, x_max) &&
-			valid_z_elem(&y_base[start], z_min, z_max))
+			valid_z_elem(&y_base[start], z_min, z_max) &&
+			unused_elem(&y_base[start]))
 			return &y_base[start];
 
 		if (valid_x_elem(&y_base[end], x_min, x_max) &&
-			valid_z_elem(&y_base[end], z_min, z_max))
+			valid_z_elem(&y_base[end], z_min, z_max) &&
+			unused_elem(&y_base[end]))
 			return &y_base[end];
 
 		i++;
@@ -404,7 +403,8 @@ static struct kd_elem *elem_get_median_y_elem(struct kd_elem *y_base,
 
 	/* ra end is not checked if gap is even */
 	if ((size & 0x1) != 0 && valid_x_elem(&y_base[y_end], x_min, x_max) &&
-		valid_z_elem(&y_base[y_end], z_min, z_max))
+		valid_z_elem(&y_base[y_end], z_min, z_max) &&
+		unused_elem(&y_base[y_end]))
 		return &y_base[y_end];
 
 	return NULL;
@@ -434,18 +434,21 @@ static struct kd_elem *elem_get_median_z_elem(struct kd_elem *z_base,
 	int index = count + z_start, i = 1;
 
 	if (valid_x_elem(&z_base[index], x_min, x_max) &&
-		valid_y_elem(&z_base[index], y_min, y_max))
+		valid_y_elem(&z_base[index], y_min, y_max) &&
+		unused_elem(&z_base[index]))
 		return &z_base[index];
 
 	while (i <= count) {
 		int start = index - i, end = index + i;
 
 		if (valid_x_elem(&z_base[start], x_min, x_max) &&
-			valid_y_elem(&z_base[start], y_min, y_max))
+			valid_y_elem(&z_base[start], y_min, y_max) &&
+			unused_elem(&z_base[start]))
 			return &z_base[start];
 
 		if (valid_x_elem(&z_base[end], x_min, x_max) &&
-			valid_y_elem(&z_base[end], y_min, y_max))
+			valid_y_elem(&z_base[end], y_min, y_max) &&
+			unused_elem(&z_base[end]))
 			return &z_base[end];
 
 		i++;
@@ -453,7 +456,8 @@ static struct kd_elem *elem_get_median_z_elem(struct kd_elem *z_base,
 
 	/* ra end is not checked if gap is even */
 	if ((size & 0x1) != 0 && valid_x_elem(&z_base[z_end], x_min, x_max) &&
-		valid_y_elem(&z_base[z_end], y_min, y_max))
+		valid_y_elem(&z_base[z_end], y_min, y_max) &&
+		unused_elem(&z_base[z_end]))
 		return &z_base[z_end];
 
 	return NULL;
@@ -468,13 +472,59 @@ static struct kd_elem *elem_get_median_z_elem(struct kd_elem *z_base,
  */
 static inline void mbase_inc(struct kd_base *mbase)
 {
-	mbase->count++;
-	if (mbase->count >= mbase->total) {
-		mbase->percent += 0.1;
+	int count;
+
+#if HAVE_OPENMP
+#pragma omp atomic capture
+#endif
+	count = ++mbase->count;
+
+	if (mbase->total && count % mbase->total == 0)
 		adb_info(mbase->db, ADB_LOG_CDS_KDTREE, "\r Building %3.1f percent ",
-				 mbase->percent);
-		mbase->count = 0;
-	}
+				 (float)count / mbase->total / 10.0);
+}
+
+/**
+ * \brief Check whether the two subtrees of a pivot can be built in parallel.
+ *
+ * Each subtree only claims elements inside its own bounds, so the subtrees
+ * are independent unless an element shares the pivot coordinate value across
+ * the split. Such splits are built serially so the tree is identical to a
+ * serial build.
+ *
+ * \param mbase The main context capturing tree structure states.
+ * \param size Number of elements below the pivot.
+ * \param pivot Pivot coordinate value.
+ * \param next Coordinate value of the first element of the RHS subtree.
+ * \return 1 if the LHS subtree should be built as a separate task.
+ */
+static inline int kd_task(struct kd_base *mbase, int size, double pivot,
+						  double next)
+{
+	return mbase->tasks && size >= KD_TASK_MIN_ELEMS && pivot < next;
+}
+
+/**
+ * \brief Link the LHS and RHS subtrees to their parent element.
+ *
+ * \param parent Parent element.
+ * \param lhs LHS subtree root or NULL.
+ * \param rhs RHS subtree root or NULL.
+ */
+static inline void kd_link(struct kd_base_elem *parent,
+						   struct kd_base_elem *lhs, struct kd_base_elem *rhs)
+{
+	if (lhs) {
+		lhs->kd.parent = parent->bid;
+		parent->kd.child[0] = lhs->bid;
+	} else
+		parent->kd.child[0] = -1;
+
+	if (rhs) {
+		rhs->kd.parent = parent->bid;
+		parent->kd.child[1] = rhs->bid;
+	} else
+		parent->kd.child[1] = -1;
 }
 
 /**
@@ -496,7 +546,7 @@ static struct kd_base_elem *kd_x_select_elem(struct kd_base *mbase, int x_start,
 											 int z_start, int z_end)
 {
 	struct kd_elem *x_base, *x_elem, *y_base, *z_base;
-	struct kd_base_elem *child, *parent;
+	struct kd_base_elem *lhs, *rhs, *parent;
 	double y_min, y_max, z_min, z_max;
 	int x_id;
 
@@ -520,28 +570,35 @@ static struct kd_base_elem *kd_x_select_elem(struct kd_base *mbase, int x_start,
 	parent = x_elem->base;
 	parent->used = 1;
 
-	/* get LHS child */
-	child =
-		kd_y_select_elem(mbase, x_start, x_id, y_start, y_end, z_start, z_end);
-	if (child) {
-		child->kd.parent = parent->bid;
-		parent->kd.child[0] = child->bid;
-	} else
-		parent->kd.child[0] = -1;
-
-	/* get RHS child */
-	if (x_id == x_end)
-		child = kd_y_select_elem(mbase, x_id, x_end, y_start, y_end, z_start,
-								 z_end);
-	else
-		child = kd_y_select_elem(mbase, x_id + 1, x_end, y_start, y_end,
-								 z_start, z_end);
-	if (child) {
-		child->kd.parent = parent->bid;
-		parent->kd.child[1] = child->bid;
-	} else
-		parent->kd.child[1] = -1;
+	/* build the LHS subtree as a task while this thread builds the RHS */
+	if (x_id < x_end &&
+		kd_task(mbase, x_id - x_start, kd_get_x(x_base, x_id),
+				kd_get_x(x_base, x_id + 1))) {
+#if HAVE_OPENMP
+#pragma omp task shared(lhs)
+#endif
+		lhs = kd_y_select_elem(mbase, x_start, x_id, y_start,
+							   y_end, z_start, z_end);
+		rhs = kd_y_select_elem(mbase, x_id + 1, x_end, y_start,
+							   y_end, z_start, z_end);
+#if HAVE_OPENMP
+#pragma omp taskwait
+#endif
+	} else {
+		/* get LHS child */
+		lhs = kd_y_select_elem(mbase, x_start, x_id, y_start,
+							   y_end, z_start, z_end);
+
+		/* get RHS child */
+		if (x_id == x_end)
+			rhs = kd_y_select_elem(mbase, x_id, x_end, y_start,
+								   y_end, z_start, z_end);
+		else
+			rhs = kd_y_select_elem(mbase, x_id + 1, x_end, y_start,
+								   y_end, z_start, z_end);
+	}
 
+	kd_link(parent, lhs, rhs);
 	return parent;
 }
 
@@ -564,7 +621,7 @@ static struct kd_base_elem *kd_y_select_elem(struct kd_base *mbase, int x_start,
 											 int z_start, int z_end)
 {
 	struct kd_elem *y_base, *y_elem, *x_base, *z_base;
-	struct kd_base_elem *child, *parent;
+	struct kd_base_elem *lhs, *rhs, *parent;
 	double x_min, x_max, z_min, z_max;
 	int y_id;
 
@@ -588,28 +645,35 @@ static struct kd_base_elem *kd_y_select_elem(struct kd_base *mbase, int x_start,
 	parent = y_elem->base;
 	parent->used = 1;
 
-	/* get LHS child */
-	child =
-		kd_z_select_elem(mbase, x_start, x_end, y_start, y_id, z_start, z_end);
-	if (child) {
-		child->kd.parent = parent->bid;
-		parent->kd.child[0] = child->bid;
-	} else
-		parent->kd.child[0] = -1;
-
-	/* get RHS child */
-	if (y_id == y_end)
-		child = kd_z_select_elem(mbase, x_start, x_end, y_id, y_end, z_start,
-								 z_end);
-	else
-		child = kd_z_select_elem(mbase, x_start, x_end, y_id + 1, y_end,
-								 z_start, z_end);
-	if (child) {
-		child->kd.parent = parent->bid;
-		parent->kd.child[1] = child->bid;
-	} else
-		parent->kd.child[1] = -1;
+	/* build the LHS subtree as a task while this thread builds the RHS */
+	if (y_id < y_end &&
+		kd_task(mbase, y_id - y_start, kd_get_y(y_base, y_id),
+				kd_get_y(y_base, y_id + 1))) {
+#if HAVE_OPENMP
+#pragma omp task shared(lhs)
+#endif
+		lhs = kd_z_select_elem(mbase, x_start, x_end, y_start,
+							   y_id, z_start, z_end);
+		rhs = kd_z_select_elem(mbase, x_start, x_end, y_id + 1,
+							   y_end, z_start, z_end);
+#if HAVE_OPENMP
+#pragma omp taskwait
+#endif
+	} else {
+		/* get LHS child */
+		lhs = kd_z_select_elem(mbase, x_start, x_end, y_start,
+							   y_id, z_start, z_end);
+
+		/* get RHS child */
+		if (y_id == y_end)
+			rhs = kd_z_select_elem(mbase, x_start, x_end, y_id,
+								   y_end, z_start, z_end);
+		else
+			rhs = kd_z_select_elem(mbase, x_start, x_end, y_id + 1,
+								   y_end, z_start, z_end);
+	}
 
+	kd_link(parent, lhs, rhs);
 	return parent;
 }
 
@@ -632,7 +696,7 @@ static struct kd_base_elem *kd_z_select_elem(struct kd_base *mbase, int x_start,
 											 int z_start, int z_end)
 {
 	struct kd_elem *z_base, *z_elem, *x_base, *y_base;
-	struct kd_base_elem *child, *parent;
+	struct kd_base_elem *lhs, *rhs, *parent;
 	double x_min, x_max, y_min, y_max;
 	int z_id;
 
@@ -656,28 +720,35 @@ static struct kd_base_elem *kd_z_select_elem(struct kd_base *mbase, int x_start,
 	parent = z_elem->base;
 	parent->used = 1;
 
-	/* get LHS child */
-	child =
-		kd_x_select_elem(mbase, x_start, x_end, y_start, y_end, z_start, z_id);
-	if (child) {
-		child->kd.parent = parent->bid;
-		parent->kd.child[0] = child->bid;
-	} else
-		parent->kd.child[0] = -1;
-
-	/* get RHS child */
-	if (z_id == z_end)
-		child = kd_x_select_elem(mbase, x_start, x_end, y_start, y_end, z_id,
-								 z_end);
-	else
-		child = kd_x_select_elem(mbase, x_start, x_end, y_start, y_end,
-								 z_id + 1, z_end);
-	if (child) {
-		child->kd.parent = parent->bid;
-		parent->kd.child[1] = child->bid;
-	} else
-		parent->kd.child[1] = -1;
+	/* build the LHS subtree as a task while this thread builds the RHS */
+	if (z_id < z_end &&
+		kd_task(mbase, z_id - z_start, kd_get_z(z_base, z_id),
+				kd_get_z(z_base, z_id + 1))) {
+#if HAVE_OPENMP
+#pragma omp task shared(lhs)
+#endif
+		lhs = kd_x_select_elem(mbase, x_start, x_end, y_start,
+							   y_end, z_start, z_id);
+		rhs = kd_x_select_elem(mbase, x_start, x_end, y_start,
+							   y_end, z_id + 1, z_end);
+#if HAVE_OPENMP
+#pragma omp taskwait
+#endif
+	} else {
+		/* get LHS child */
+		lhs = kd_x_select_elem(mbase, x_start, x_end, y_start,
+							   y_end, z_start, z_id);
+
+		/* get RHS child */
+		if (z_id == z_end)
+			rhs = kd_x_select_elem(mbase, x_start, x_end, y_start,
+								   y_end, z_id, z_end);
+		else
+			rhs = kd_x_select_elem(mbase, x_start, x_end, y_start,
+								   y_end, z_id + 1, z_end);
+	}
 
+	kd_link(parent, lhs, rhs);
 	return parent;
 }
 
@@ -745,8 +816,9 @@ static void insert_elem_object(struct kd_init *init, struct htm_trixel *trixel)
 	if (!trixel)
 		return;
 
-	/* insert children if this trixel has no objects */
-	if (!trixel->data[init->table_id].num_objects)
+	/* insert children if this trixel has no objects in this pass */
+	if (!htm_trixel_num_objects(trixel, init->table_id) ||
+		!htm_layout_takes(trixel, init->depth))
 		goto children;
 
 	/* insert objects into elems */
@@ -760,7 +832,7 @@ static void insert_elem_object(struct kd_init *init, struct htm_trixel *trixel)
 	}
 
 children:
-	if (!trixel->child)
+	if (!htm_layout_descends(trixel, init->depth))
 		return;
 
 	insert_elem_object(init, &trixel->child[0]);
@@ -781,22 +853,22 @@ static void insert_elem_objects(struct adb_db *db, struct adb_table *table,
 {
 	struct htm *htm = db->htm;
 	struct kd_init init;
+	int pass, i;
 
-	/* create array or elems for HTM object order */
+	/* create array or elems in table file object order */
 	init.kbase = mbase;
 	init.db = db;
 	init.table = table;
 	init.table_id = table->id;
 	init.iid = 0;
 
-	insert_elem_object(&init, &htm->N[0]);
-	insert_elem_object(&init, &htm->N[1]);
-	insert_elem_object(&init, &htm->N[2]);
-	insert_elem_object(&init, &htm->N[3]);
-	insert_elem_object(&init, &htm->S[0]);
-	insert_elem_object(&init, &htm->S[1]);
-	insert_elem_object(&init, &htm->S[2]);
-	insert_elem_object(&init, &htm->S[3]);
+	for (pass = 0; pass < htm_layout_passes(htm, db->table_layout); pass++) {
+		init.depth = htm_layout_depth(db->table_layout, pass);
+		for (i = 0; i < 4; i++)
+			insert_elem_object(&init, &htm->N[i]);
+		for (i = 0; i < 4; i++)
+			insert_elem_object(&init, &htm->S[i]);
+	}
 }
 
 /**
@@ -824,23 +896,18 @@ static void update_objects(struct kd_base_elem *base, struct adb_table *table,
 }
 
 /**
- * \brief Build a fully structured KD-tree encompassing all objects within a dataset.
+ * \brief Build the KD tree from X, Y and Z sorted copies of the objects.
  *
  * \param db The active database context.
  * \param table The table structure whose objects will be indexed into the tree.
  * \return 0 on success, or a negative error code on failure.
  */
-int import_build_kdtree(struct adb_db *db, struct adb_table *table)
+static int kd_build_sorted(struct adb_db *db, struct adb_table *table)
 {
 	struct kd_base mbase;
 	struct kd_base_elem *base, *root;
 	int i, ret = 0;
 
-	if (table->object.count <= 0) {
-		adb_error(db, "error: table %s is empty\n", table->cds.name);
-		return -EINVAL;
-	}
-
 	/* allocate idx elem, ra elem  and dec elem arrays */
 	base = calloc(1, (sizeof(struct kd_base_elem) * table->object.count) +
 						 (sizeof(struct kd_elem) * table->object.count * 3));
@@ -850,8 +917,12 @@ int import_build_kdtree(struct adb_db *db, struct adb_table *table)
 	mbase.db = db;
 	mbase.base = base;
 	mbase.count = 0;
-	mbase.percent = 0.0;
 	mbase.total = table->object.count / 1000;
+#if HAVE_OPENMP
+	mbase.tasks = db_workers(db) > 1;
+#else
+	mbase.tasks = 0;
+#endif
 	mbase.x_base = (struct kd_elem *)(base + table->object.count);
 	mbase.y_base = mbase.x_base + table->object.count;
 	mbase.z_base = mbase.y_base + table->object.count;
@@ -869,12 +940,26 @@ int import_build_kdtree(struct adb_db *db, struct adb_table *table)
 	adb_info(db, ADB_LOG_CDS_KDTREE, "Sorting KD Tree source objects...\n");
 
 	/* sort RA and DEC elems in order */
-	qsort(mbase.x_base, table->object.count, sizeof(struct kd_elem),
-		  elem_x_cmp);
-	qsort(mbase.y_base, table->object.count, sizeof(struct kd_elem),
-		  elem_y_cmp);
-	qsort(mbase.z_base, table->object.count, sizeof(struct kd_elem),
-		  elem_z_cmp);
+#if HAVE_OPENMP
+#pragma omp parallel sections num_threads(db_workers(db))
+#endif
+	{
+#if HAVE_OPENMP
+#pragma omp section
+#endif
+		qsort(mbase.x_base, table->object.count, sizeof(struct kd_elem),
+			  elem_x_cmp);
+#if HAVE_OPENMP
+#pragma omp section
+#endif
+		qsort(mbase.y_base, table->object.count, sizeof(struct kd_elem),
+			  elem_y_cmp);
+#if HAVE_OPENMP
+#pragma omp section
+#endif
+		qsort(mbase.z_base, table->object.count, sizeof(struct kd_elem),
+			  elem_z_cmp);
+	}
 
 	/* give XYZ elems index numbers */
 	for (i = 0; i < table->object.count; i++) {
@@ -885,6 +970,10 @@ int import_build_kdtree(struct adb_db *db, struct adb_table *table)
 
 	/* build the KD tree starting on X */
 	adb_info(db, ADB_LOG_CDS_KDTREE, "\r Building 0.0 percent ");
+#if HAVE_OPENMP
+#pragma omp parallel num_threads(db_workers(db)) if (mbase.tasks)
+#pragma omp single
+#endif
 	root = kd_x_select_elem(&mbase, 0, table->object.count - 1, 0,
 							table->object.count - 1, 0,
 							table->object.count - 1);
@@ -907,241 +996,1302 @@ out:
 	return ret;
 }
 
+/*! \struct kd_select_elem
+ * \brief KD select build element
+ * \ingroup kdtree
+ */
+struct kd_select_elem {
+	struct kd_vertex v; /*!< vertex */
+	int bid; /*!< object index in HTM order */
+};
+
+/*! \struct kd_select
+ * \brief KD select build context
+ * \ingroup kdtree
+ */
+struct kd_select {
+	struct adb_db *db; /*!< database */
+	int table_id; /*!< table ID */
+	int iid; /*!< next object index */
+	int count; /*!< nodes built */
+	int total; /*!< nodes per 0.1 percent progress */
+	int tasks; /*!< build subtrees as parallel tasks */
+	int depth; /*!< layout pass depth, -1 for every depth */
+	struct kd_select_elem *elem; /*!< elements, partitioned in place */
+	struct adb_object **object; /*!< objects by index */
+};
+
+/**
+ * \brief Get the coordinate of a select element on the pivot axis.
+ *
+ * \param elem Select element.
+ * \param pivot Pivot axis.
+ * \return Coordinate value.
+ */
+static inline double select_coord(const struct kd_select_elem *elem,
+								  enum kd_pivot pivot)
+{
+	switch (pivot) {
+	case KD_PIVOT_X:
+		return elem->v.x;
+	case KD_PIVOT_Y:
+		return elem->v.y;
+	default:
+		return elem->v.z;
+	}
+}
+
 /**
- * \brief Calculate spherical angular separation between equatorial coordinates and a Cartesian vector.
+ * \brief Comparator function to sort select elements by their X coordinate.
  *
- * \param ra1 Right ascension of the first point in radians.
- * \param dec1 Declination of the first point in radians.
- * \param v Pointer to the KD vertex indicating the 3D position of the second point.
- * \return The angular distance between the points in radians.
+ * \param o1 First select element pointer.
+ * \param o2 Second select element pointer.
+ * \return -1 if o1 < o2, 1 if o1 > o2, 0 if equal.
  */
-static double get_distance(double ra1, double dec1, struct kd_vertex *v)
+static int select_x_cmp(const void *o1, const void *o2)
 {
-	double ra2, dec2;
-	double x, y, z;
+	const struct kd_select_elem *elem1 = o1, *elem2 = o2;
 
-	kd_vertex_to_equ(&ra2, &dec2, v);
+	return (elem1->v.x > elem2->v.x) - (elem1->v.x < elem2->v.x);
+}
 
-	x = (cos(dec1) * sin(dec2)) - (sin(dec1) * cos(dec2) * cos(ra2 - ra1));
-	y = cos(dec2) * sin(ra2 - ra1);
-	z = (sin(dec1) * sin(dec2)) + (cos(dec1) * cos(dec2) * cos(ra2 - ra1));
+/**
+ * \brief Comparator function to sort select elements by their Y coordinate.
+ *
+ * \param o1 First select element pointer.
+ * \param o2 Second select element pointer.
+ * \return -1 if o1 < o2, 1 if o1 > o2, 0 if equal.
+ */
+static int select_y_cmp(const void *o1, const void *o2)
+{
+	const struct kd_select_elem *elem1 = o1, *elem2 = o2;
 
-	x = x * x;
-	y = y * y;
-	return atan2(sqrt(x + y), z);
+	return (elem1->v.y > elem2->v.y) - (elem1->v.y < elem2->v.y);
 }
 
-/*! \struct kd_get_data
- * \brief get kd data
- * \ingroup kdtree
+/**
+ * \brief Comparator function to sort select elements by their Z coordinate.
+ *
+ * \param o1 First select element pointer.
+ * \param o2 Second select element pointer.
+ * \return -1 if o1 < o2, 1 if o1 > o2, 0 if equal.
  */
-struct kd_get_data {
-	struct adb_table *table; /*!< table */
-	const struct adb_object *closest; /*!< closest object */
-	const struct adb_object *exclude; /*!< excluded object */
-	double distance; /*!< distance */
-	struct kd_vertex target; /*!< target */
-	double ra; /*!< Right Ascension */
-	double dec; /*!< Declination */
+static int select_z_cmp(const void *o1, const void *o2)
+{
+	const struct kd_select_elem *elem1 = o1, *elem2 = o2;
+
+	return (elem1->v.z > elem2->v.z) - (elem1->v.z < elem2->v.z);
+}
+
+static int (*const select_cmp[])(const void *, const void *) = {
+	select_x_cmp,
+	select_y_cmp,
+	select_z_cmp,
 };
 
 /**
- * \brief Recursively traverse the tree to fetch the nearest matching object.
+ * \brief Swap two select elements.
  *
- * Navigates nodes spatially to locate the closest astronomical object to a target coordinate.
- *
- * \param kd Search configuration variables, boundaries, and current closest tracker structure.
- * \param node The current node ID under evaluation.
- * \param pivot The active spatial axis being tracked for this depth.
- * \return 0 if traversal should continue up the stack, 1 if leaf node end reached.
+ * \param a First select element.
+ * \param b Second select element.
  */
-int get_nearest(struct kd_get_data *kd, int node, enum kd_pivot pivot)
+static inline void select_swap(struct kd_select_elem *a,
+							   struct kd_select_elem *b)
 {
-	struct adb_table *table = kd->table;
-	const struct adb_object *current =
-		(const void *)table->objects + node * table->object.bytes;
-	struct kd_vertex plane_vertex, current_vertex;
-	double d;
-	int end;
-
-	/* are we at leaf end ? */
-	if (node < 0)
-		return 1;
+	struct kd_select_elem t = *a;
 
-	/* get xyz for current */
-	equ_to_kd_vertex(current->ra, current->dec, &current_vertex);
+	*a = *b;
+	*b = t;
+}
 
-	/* get the new node */
-	switch (pivot) {
-	case KD_PIVOT_X:
-		if (kd->target.x < current_vertex.x)
-			node = current->kd.child[0];
-		else
-			node = current->kd.child[1];
-		break;
-	case KD_PIVOT_Y:
-		if (kd->target.y < current_vertex.y)
-			node = current->kd.child[0];
-		else
-			node = current->kd.child[1];
-		break;
-	case KD_PIVOT_Z:
-		if (kd->target.z < current_vertex.z)
-			node = current->kd.child[0];
-		else
-			node = current->kd.child[1];
-		break;
-	}
+/**
+ * \brief Partially order elements so the nth element is in sorted position.
+ *
+ * Introselect: quickselect with a median of three pivot that falls back to
+ * sorting the remaining range when partitioning stops converging. Elements
+ * before n are not greater than the nth element on the pivot axis and
+ * elements after it are not less.
+ *
+ * \param elem Elements to partition.
+ * \param count Number of elements.
+ * \param n Index of the element to select.
+ * \param pivot Pivot axis.
+ */
+static void select_nth_elem(struct kd_select_elem *elem, int count, int n,
+							enum kd_pivot pivot)
+{
+	int lo = 0, hi = count - 1, mid, i, j, depth = 0;
+	double value;
 
-	/* get to leaf */
-	end = get_nearest(kd, node, pivot_next(pivot));
-	if (end && kd->closest == NULL) {
-		/* at leaf, so unwind and this will be initial closest */
-		if (current != kd->exclude) {
-			kd->closest = current;
-			kd->distance = get_distance(kd->ra, kd->dec, &current_vertex);
+	for (i = count; i > 1; i >>= 1)
+		depth += 2;
+
+	while (hi > lo) {
+		if (depth-- == 0) {
+			qsort(elem + lo, hi - lo + 1, sizeof(*elem), select_cmp[pivot]);
+			return;
 		}
-		return 0;
-	}
 
-	/* unwinding, check object for closest */
-	d = get_distance(kd->ra, kd->dec, &current_vertex);
+		/* median of three, also bounds both scans below */
+		mid = lo + (hi - lo) / 2;
+		if (select_coord(&elem[mid], pivot) < select_coord(&elem[lo], pivot))
+			select_swap(&elem[mid], &elem[lo]);
+		if (select_coord(&elem[hi], pivot) < select_coord(&elem[lo], pivot))
+			select_swap(&elem[hi], &elem[lo]);
+		if (select_coord(&elem[hi], pivot) < select_coord(&elem[mid], pivot))
+			select_swap(&elem[hi], &elem[mid]);
+		value = select_coord(&elem[mid], pivot);
+
+		i = lo;
+		j = hi;
+		while (i <= j) {
+			while (select_coord(&elem[i], pivot) < value)
+				i++;
+			while (select_coord(&elem[j], pivot) > value)
+				j--;
+			if (i <= j)
+				select_swap(&elem[i++], &elem[j--]);
+		}
 
-	/* update, since object is closest */
-	if (d < kd->distance && current != kd->exclude) {
-		kd->closest = current;
-		kd->distance = d;
+		/* elements between j and i are equal to the pivot value */
+		if (n <= j)
+			hi = j;
+		else if (n >= i)
+			lo = i;
+		else
+			return;
 	}
+}
 
-	/* calc distance to ther pivot plane */
-	switch (pivot) {
-	case KD_PIVOT_X:
-		plane_vertex.x = current_vertex.x;
-		plane_vertex.y = kd->target.y;
-		plane_vertex.z = kd->target.z;
-		break;
-	case KD_PIVOT_Y:
-		plane_vertex.x = kd->target.x;
-		plane_vertex.y = current_vertex.y;
-		plane_vertex.z = kd->target.z;
-		break;
-	case KD_PIVOT_Z:
-		plane_vertex.x = kd->target.x;
-		plane_vertex.y = kd->target.y;
-		plane_vertex.z = current_vertex.z;
-		break;
-	}
+/**
+ * \brief Recursively build a KD subtree over a range of select elements.
+ *
+ * The median element on the pivot axis becomes the subtree root and the
+ * elements either side of it form its children on the next axis. The two
+ * ranges are disjoint so large subtrees are built as parallel tasks.
+ *
+ * \param sel Select build context.
+ * \param start First element of the range.
+ * \param count Number of elements in the range.
+ * \param pivot Pivot axis for this depth.
+ * \return Object index of the subtree root, or -1 for an empty range.
+ */
+static int select_build(struct kd_select *sel, int start, int count,
+						enum kd_pivot pivot)
+{
+	struct adb_kd_tree *kd;
+	int mid = count / 2, lhs, rhs, progress;
 
-	d = get_distance(kd->ra, kd->dec, &plane_vertex);
+	if (count <= 0)
+		return -1;
 
-	/* pivot plane closer so check */
-	if (d < kd->distance) {
-		if (node == current->kd.child[0])
-			node = current->kd.child[1];
-		else
-			node = current->kd.child[0];
+	select_nth_elem(sel->elem + start, count, mid, pivot);
 
-		end = get_nearest(kd, node, pivot_next(pivot));
+	if (sel->tasks && count >= KD_TASK_MIN_ELEMS) {
+#if HAVE_OPENMP
+#pragma omp task shared(lhs)
+#endif
+		lhs = select_build(sel, start, mid, pivot_next(pivot));
+		rhs = select_build(sel, start + mid + 1, count - mid - 1,
+						   pivot_next(pivot));
+#if HAVE_OPENMP
+#pragma omp taskwait
+#endif
+	} else {
+		lhs = select_build(sel, start, mid, pivot_next(pivot));
+		rhs = select_build(sel, start + mid + 1, count - mid - 1,
+						   pivot_next(pivot));
 	}
 
-	return 0;
+	kd = sel->object[sel->elem[start + mid].bid]->import.kd;
+	kd->index = sel->elem[start + mid].bid;
+	kd->child[0] = lhs;
+	kd->child[1] = rhs;
+	if (lhs >= 0)
+		sel->object[lhs]->import.kd->parent = kd->index;
+	if (rhs >= 0)
+		sel->object[rhs]->import.kd->parent = kd->index;
+
+#if HAVE_OPENMP
+#pragma omp atomic capture
+#endif
+	progress = ++sel->count;
+
+	if (sel->total && progress % sel->total == 0)
+		adb_info(sel->db, ADB_LOG_CDS_KDTREE, "\r Building %3.1f percent ",
+				 (float)progress / sel->total / 10.0);
+
+	return kd->index;
 }
 
-#if CHECK_KD_TREE
-static void check_search(struct adb_table *table, double ra, double dec,
-						 double distance, const struct adb_object *object)
+/**
+ * \brief Add the objects of a trixel and its children in HTM order.
+ *
+ * \param sel Select build context.
+ * \param trixel HTM trixel.
+ */
+static void select_insert_object(struct kd_select *sel,
+								 struct htm_trixel *trixel)
 {
-	const struct adb_object *current;
-	struct kd_vertex current_v, pos_v;
-	double d;
-	int i;
+	struct adb_object *object;
+	struct kd_select_elem *elem;
 
-	/* get xyz for pos */
-	equ_to_kd_vertex(ra, dec, &pos_v);
+	if (!trixel)
+		return;
 
-	for (i = 0; i < table->object.count; i++) {
-		current = (const void *)table->objects + i * table->object.bytes;
+	/* insert children if this trixel has no objects in this pass */
+	if (!htm_trixel_num_objects(trixel, sel->table_id) ||
+		!htm_layout_takes(trixel, sel->depth))
+		goto children;
 
-		/* get xyz for current */
-		equ_to_kd_vertex(current->ra, current->dec, &current_v);
+	object = trixel->data[sel->table_id].objects;
+	while (object) {
+		elem = &sel->elem[sel->iid];
+		equ_to_kd_vertex(object->ra, object->dec, &elem->v);
+		elem->bid = sel->iid;
+		sel->object[sel->iid++] = object;
+		object = object->import.next;
+	}
 
-		d = get_distance(current->ra, current->dec, &pos_v);
+children:
+	if (!htm_layout_descends(trixel, sel->depth))
+		return;
 
-		if (d < distance && current != object) {
-			printf("closer new %9.9f old %9.9f id %ld ra %f dec"
-				   "%f X %f Y %f Z %f\n",
-				   d, distance, current->id, adb_object_ra(current) * R2D,
-				   adb_object_dec(current) * R2D, current_v.x, current_v.y,
-				   current_v.z);
-			distance = d;
-		}
-	}
+	select_insert_object(sel, &trixel->child[0]);
+	select_insert_object(sel, &trixel->child[1]);
+	select_insert_object(sel, &trixel->child[2]);
+	select_insert_object(sel, &trixel->child[3]);
 }
-#endif
 
 /**
- * \brief Retrieve the closest object to a supplied spatial coordinate pair.
+ * \brief Build the KD tree by in place median selection.
  *
- * \param set The active object set specifying table and constraints.
- * \param ra Right Ascension coordinate limit target in radians.
- * \param dec Declination angle coordinate target in radians.
- * \return Pointer to the matched nearest object, or NULL if none evaluated.
+ * Uses one array of object vertices instead of three sorted element copies,
+ * which needs less than half the memory of the sorted build and avoids its
+ * used element scans. Each tree level is partitioned in linear time.
+ *
+ * \param db The active database context.
+ * \param table The table structure whose objects will be indexed into the tree.
+ * \return 0 on success, or a negative error code on failure.
  */
-const struct adb_object *
-adb_table_set_get_nearest_on_pos(struct adb_object_set *set, double ra,
-								 double dec)
+static int kd_build_select(struct adb_db *db, struct adb_table *table)
 {
-	struct adb_table *table = set->table;
-	struct kd_get_data kd;
+	struct htm *htm = db->htm;
+	struct kd_select sel;
+	int pass, i, root;
+
+	sel.elem = malloc(sizeof(*sel.elem) * table->object.count);
+	sel.object = malloc(sizeof(*sel.object) * table->object.count);
+	if (sel.elem == NULL || sel.object == NULL) {
+		free(sel.elem);
+		free(sel.object);
+		return -ENOMEM;
+	}
 
-	/* get xyz for object */
-	equ_to_kd_vertex(ra, dec, &kd.target);
+	sel.db = db;
+	sel.table_id = table->id;
+	sel.iid = 0;
+	sel.count = 0;
+	sel.total = table->object.count / 1000;
+#if HAVE_OPENMP
+	sel.tasks = db_workers(db) > 1;
+#else
+	sel.tasks = 0;
+#endif
+
+	adb_info(db, ADB_LOG_CDS_KDTREE,
+			 "Preparing KD Tree for %s with %d objects\n", table->cds.name,
+			 table->object.count);
 
-	kd.closest = NULL;
-	kd.distance = 10e9;
-	kd.table = table;
-	kd.exclude = NULL;
-	kd.ra = ra;
-	kd.dec = dec;
+	/* Get objects from HTM in table file order */
+	for (pass = 0; pass < htm_layout_passes(htm, db->table_layout); pass++) {
+		sel.depth = htm_layout_depth(db->table_layout, pass);
+		for (i = 0; i < 4; i++)
+			select_insert_object(&sel, &htm->N[i]);
+		for (i = 0; i < 4; i++)
+			select_insert_object(&sel, &htm->S[i]);
+	}
 
-	get_nearest(&kd, table->kd_root, KD_PIVOT_X);
-#if CHECK_KD_TREE
-	check_search(table, ra, dec, kd.distance, kd.closest);
+	/* build the KD tree starting on X */
+	adb_info(db, ADB_LOG_CDS_KDTREE, "\r Building 0.0 percent ");
+#if HAVE_OPENMP
+#pragma omp parallel num_threads(db_workers(db)) if (sel.tasks)
+#pragma omp single
 #endif
-	return kd.closest;
+	root = select_build(&sel, 0, sel.iid, KD_PIVOT_X);
+	adb_info(db, ADB_LOG_CDS_KDTREE, "\r Building 100.0 percent\n");
+
+	table->import.kd_root = root;
+
+	adb_info(db, ADB_LOG_CDS_KDTREE,
+			 "Completed KD Tree for %s with %d objects at root %d\n",
+			 table->cds.name, table->object.count, root);
+
+	free(sel.elem);
+	free(sel.object);
+	return 0;
 }
 
 /**
- * \brief Retrieve the nearest object to a given reference object.
- *
- * Functions similarly to coordinate-based neighbor checking, but explicitly excludes the input object itself from the results so that it evaluates its closest distinct neighbor.
+ * \brief Build a fully structured KD-tree encompassing all objects within a dataset.
  *
- * \param set Active object scope set parameters.
- * \param object Target object serving as search origin coordinate.
- * \return Pointer to the matched distinct nearest neighbor object, or NULL.
+ * \param db The active database context.
+ * \param table The table structure whose objects will be indexed into the tree.
+ * \return 0 on success, or a negative error code on failure.
  */
-const struct adb_object *
-adb_table_set_get_nearest_on_object(struct adb_object_set *set,
-									const struct adb_object *object)
+int import_build_kdtree(struct adb_db *db, struct adb_table *table)
 {
-	struct adb_table *table = set->table;
-	struct kd_get_data kd;
+	int ret;
 
-	/* get xyz for object */
-	equ_to_kd_vertex(adb_object_ra(object), adb_object_dec(object), &kd.target);
-
-	kd.closest = NULL;
-	kd.distance = 10e9;
-	kd.exclude = object;
-	kd.ra = adb_object_ra(object);
-	kd.dec = adb_object_dec(object);
-	kd.table = table;
+	if (table->object.count <= 0) {
+		adb_error(db, "error: table %s is empty\n", table->cds.name);
+		return -EINVAL;
+	}
 
-	get_nearest(&kd, table->kd_root, KD_PIVOT_X);
+	trace_begin(&db->trace, ADB_TRACE_KD_BUILD, table->object.count);
+	if (db->kd_build == ADB_KD_BUILD_SELECT)
+		ret = kd_build_select(db, table);
+	else
+		ret = kd_build_sorted(db, table);
+	return trace_end(&db->trace, ADB_TRACE_KD_BUILD, ret);
+}
+
+/*! \struct kd_node
+ * \brief Packed KD search node
+ * \ingroup kdtree
+ *
+ * Search nodes are kept apart from the catalog rows so a search only touches
+ * this array and does no trigonometry.
+ */
+struct kd_node {
+	struct kd_vertex v; /*!< unit vector of the object */
+	int32_t child[2]; /*!< child node positions or -1 */
+	int32_t index; /*!< object index in the table */
+};
+
+/**
+ * \brief Set a search node from a table object.
+ *
+ * \param table Table with the KD tree.
+ * \param node Node to set.
+ * \param index Object index.
+ */
+static void kd_node_set(struct adb_table *table, struct kd_node *node,
+						int index)
+{
+	const struct adb_object *object =
+		(const void *)table->objects + index * table->object.bytes;
+
+	equ_to_kd_vertex(object->ra, object->dec, &node->v);
+	node->child[0] = -1;
+	node->child[1] = -1;
+	node->index = index;
+}
+
+/**
+ * \brief Get the packed search nodes for a table, creating them on first use.
+ *
+ * The object KD tree is copied in breadth first order, so the upper levels
+ * that every search visits share a few cache lines.
+ *
+ * \param table Table with loaded objects.
+ * \return Search nodes or NULL on failure.
+ */
+static struct kd_node *kd_get_nodes(struct adb_table *table)
+{
+	const struct adb_object *object;
+	struct kd_node *nodes;
+	int count = table->object.count, tail = 0, child, i, j;
+	int depth = 1, level_end = 1;
+
+	if (table->kd_nodes)
+		return table->kd_nodes;
+
+	if (count <= 0 || table->kd_root < 0 || table->kd_root >= count)
+		return NULL;
+
+	nodes = alloc_large(table->db, sizeof(*nodes) * count, &table->kd_mapped);
+	if (nodes == NULL)
+		return NULL;
+
+	kd_node_set(table, &nodes[tail++], table->kd_root);
+
+	for (i = 0; i < tail; i++) {
+		/* all nodes of the next level have been queued */
+		if (i == level_end) {
+			depth++;
+			level_end = tail;
+		}
+
+		object = (const void *)table->objects +
+				 nodes[i].index * table->object.bytes;
+
+		for (j = 0; j < 2; j++) {
+			child = object->kd.child[j];
+			if (child < 0 || child >= count || tail == count)
+				continue;
+
+			nodes[i].child[j] = tail;
+			kd_node_set(table, &nodes[tail++], child);
+		}
+	}
+
+	adb_info(table->db, ADB_LOG_CDS_KDTREE,
+			 "Packed %d KD search nodes for %s depth %d\n", tail,
+			 table->cds.name, depth);
+
+	table->kd_nodes = nodes;
+	table->kd_depth = depth;
+	return nodes;
+}
+
+/**
+ * \brief Build the packed search nodes of a table ahead of searches.
+ *
+ * \param table Table with loaded objects.
+ * \return 0 on success or without a KD tree, -ENOMEM on failure.
+ */
+int kd_prepare_nodes(struct adb_table *table)
+{
+	int count = table->object.count;
+
+	if (count <= 0 || table->kd_root < 0 || table->kd_root >= count)
+		return 0;
+
+	return kd_get_nodes(table) ? 0 : -ENOMEM;
+}
+
+/**
+ * \brief Free the packed search nodes of a table.
+ *
+ * \param table Table with KD search nodes.
+ */
+void kd_free_nodes(struct adb_table *table)
+{
+	alloc_free_large(table->kd_nodes, table->kd_mapped);
+	table->kd_nodes = NULL;
+	table->kd_mapped = 0;
+	table->kd_depth = 0;
+}
+
+/**
+ * \brief Squared chord distance between two unit vectors.
+ *
+ * Orders points the same way as their angular distance.
+ *
+ * \param a First unit vector.
+ * \param b Second unit vector.
+ * \return Squared chord distance.
+ */
+static inline double kd_chord2(const struct kd_vertex *a,
+							   const struct kd_vertex *b)
+{
+	double x = a->x - b->x, y = a->y - b->y, z = a->z - b->z;
+
+	return x * x + y * y + z * z;
+}
+
+/**
+ * \brief Get the unit vector coordinate on a pivot axis.
+ *
+ * \param v Unit vector.
+ * \param pivot Pivot axis.
+ * \return Coordinate value.
+ */
+static inline double kd_axis(const struct kd_vertex *v, enum kd_pivot pivot)
+{
+	switch (pivot) {
+	case KD_PIVOT_X:
+		return v->x;
+	case KD_PIVOT_Y:
+		return v->y;
+	default:
+		return v->z;
+	}
+}
+
+
+/*! \struct kd_match
+ * \brief KD search match
+ * \ingroup kdtree
+ */
+struct kd_match {
+	double distance; /*!< squared chord distance */
+	int index; /*!< object index */
+};
+
+/*! \struct kd_stack
+ * \brief Deferred far side subtree of a KD search
+ * \ingroup kdtree
+ */
+struct kd_stack {
+	int node; /*!< subtree root node position */
+	enum kd_pivot pivot; /*!< subtree root pivot axis */
+	double plane; /*!< squared distance from target to the parent plane */
+};
+
+/*! \struct kd_get_data
+ * \brief get kd data
+ * \ingroup kdtree
+ *
+ * Matches are kept in a max heap of at most size entries ordered on
+ * distance, so the furthest kept match is heap[0].
+ */
+struct kd_get_data {
+	const struct kd_node *nodes; /*!< packed search nodes */
+	struct kd_vertex target; /*!< target */
+	int exclude; /*!< excluded object index or -1 */
+	double limit; /*!< squared chord search radius */
+	int all; /*!< count every match within limit, not only the kept ones */
+	struct kd_match *heap; /*!< kept matches */
+	int size; /*!< heap capacity */
+	int count; /*!< matches in heap */
+	int found; /*!< matches within limit */
+	int visited; /*!< nodes visited */
+};
+
+/**
+ * \brief Get the squared distance bound a subtree must beat to be searched.
+ *
+ * \param kd Search state.
+ * \return Squared chord distance bound.
+ */
+static inline double kd_bound(struct kd_get_data *kd)
+{
+	if (!kd->all && kd->count == kd->size && kd->heap[0].distance < kd->limit)
+		return kd->heap[0].distance;
+	return kd->limit;
+}
+
+/**
+ * \brief Offer an object to the kept matches.
+ *
+ * \param kd Search state.
+ * \param distance Squared chord distance of the object.
+ * \param index Object index.
+ */
+static void kd_heap_add(struct kd_get_data *kd, double distance, int index)
+{
+	struct kd_match *heap = kd->heap, match;
+	int i, child;
+
+	kd->found++;
+
+	if (kd->count < kd->size) {
+		/* sift up */
+		for (i = kd->count++; i > 0; i = (i - 1) / 2) {
+			if (heap[(i - 1) / 2].distance >= distance)
+				break;
+			heap[i] = heap[(i - 1) / 2];
+		}
+		heap[i].distance = distance;
+		heap[i].index = index;
+		return;
+	}
+
+	if (kd->size == 0 || distance >= heap[0].distance)
+		return;
+
+	/* replace the furthest match and sift down */
+	match.distance = distance;
+	match.index = index;
+	for (i = 0; (child = 2 * i + 1) < kd->count; i = child) {
+		if (child + 1 < kd->count &&
+			heap[child + 1].distance > heap[child].distance)
+			child++;
+		if (heap[child].distance <= distance)
+			break;
+		heap[i] = heap[child];
+	}
+	heap[i] = match;
+}
+
+/**
+ * \brief Sort the kept matches nearest first.
+ *
+ * \param kd Search state.
+ */
+static void kd_heap_sort(struct kd_get_data *kd)
+{
+	struct kd_match *heap = kd->heap, match;
+	int count = kd->count, i, child;
+
+	while (count > 1) {
+		/* move the furthest match to the end and sift down the last */
+		match = heap[--count];
+		heap[count] = heap[0];
+		for (i = 0; (child = 2 * i + 1) < count; i = child) {
+			if (child + 1 < count &&
+				heap[child + 1].distance > heap[child].distance)
+				child++;
+			if (heap[child].distance <= match.distance)
+				break;
+			heap[i] = heap[child];
+		}
+		heap[i] = match;
+	}
+}
+
+/**
+ * \brief Search the KD tree for matches to the target.
+ *
+ * Walks down the side of each pivot plane holding the target and defers the
+ * other side on an explicit stack with its distance to the plane. A deferred
+ * subtree is skipped when the plane is further than the search bound, which
+ * is exact since the plane distance bounds the chord to any point beyond it.
+ * The stack never holds more entries than the tree has levels.
+ *
+ * \param kd Search state.
+ * \param stack Stack with at least one entry per tree level.
+ */
+static void get_nearest(struct kd_get_data *kd, struct kd_stack *stack)
+{
+	const struct kd_node *current;
+	enum kd_pivot pivot;
+	double d, plane;
+	int node, top = 0;
+
+	stack[top].node = 0;
+	stack[top].pivot = KD_PIVOT_X;
+	stack[top++].plane = 0.0;
+
+	while (top > 0) {
+		top--;
+		if (stack[top].plane > kd_bound(kd))
+			continue;
+
+		node = stack[top].node;
+		pivot = stack[top].pivot;
+
+		/* get to leaf on the target side of each plane */
+		while (node >= 0) {
+			current = &kd->nodes[node];
+			kd->visited++;
+
+			d = kd_chord2(&kd->target, &current->v);
+			if (d <= kd_bound(kd) && current->index != kd->exclude)
+				kd_heap_add(kd, d, current->index);
+
+			plane = kd_axis(&kd->target, pivot) - kd_axis(&current->v, pivot);
+			pivot = pivot_next(pivot);
+
+			if (current->child[plane < 0.0 ? 1 : 0] >= 0) {
+				stack[top].node = current->child[plane < 0.0 ? 1 : 0];
+				stack[top].pivot = pivot;
+				stack[top++].plane = plane * plane;
+			}
+			node = current->child[plane < 0.0 ? 0 : 1];
+		}
+	}
+}
 
 #if CHECK_KD_TREE
-	check_search(table, adb_object_ra(object), adb_object_dec(object),
-				 kd.distance, object);
+static void check_search(struct adb_table *table, struct kd_get_data *kd)
+{
+	const struct adb_object *current;
+	struct kd_vertex current_v;
+	double d, distance = kd->count ? kd->heap[0].distance : kd->limit;
+	int i;
+
+	for (i = 0; i < table->object.count; i++) {
+		current = (const void *)table->objects + i * table->object.bytes;
+
+		/* get xyz for current */
+		equ_to_kd_vertex(current->ra, current->dec, &current_v);
+
+		d = kd_chord2(&kd->target, &current_v);
+
+		if (kd->count == 1 && d < distance && i != kd->exclude) {
+			printf("closer new %9.9f old %9.9f id %ld ra %f dec"
+				   "%f X %f Y %f Z %f\n",
+				   d, distance, current->id, adb_object_ra(current) * R2D,
+				   adb_object_dec(current) * R2D, current_v.x, current_v.y,
+				   current_v.z);
+			distance = d;
+		}
+	}
+}
 #endif
-	return kd.closest;
+
+/**
+ * \brief Search the table KD tree around a position.
+ *
+ * \param table Table to search.
+ * \param ra Right Ascension in radians.
+ * \param dec Declination in radians.
+ * \param exclude Object to skip or NULL.
+ * \param kd Search state with limit, all, heap and size set, updated with
+ *           the matches sorted nearest first.
+ * \return 0 on success or a negative error code.
+ */
+static int kd_search(struct adb_table *table, double ra, double dec,
+					 const struct adb_object *exclude,
+					 struct kd_get_data *kd)
+{
+	struct kd_stack levels[KD_STACK_LEVELS], *stack = levels;
+	ptrdiff_t offset;
+
+	kd->count = 0;
+	kd->found = 0;
+	kd->visited = 0;
+
+	if (table_load_all(table) < 0)
+		return -EIO;
+
+	kd->nodes = kd_get_nodes(table);
+	if (kd->nodes == NULL)
+		return table->object.count > 0 ? -ENOMEM : 0;
+
+	/* only unbalanced trees deeper than the on stack levels allocate */
+	if (table->kd_depth > KD_STACK_LEVELS) {
+		stack = malloc(sizeof(*stack) * table->kd_depth);
+		if (stack == NULL)
+			return -ENOMEM;
+	}
+
+	/* get xyz for object */
+	equ_to_kd_vertex(ra, dec, &kd->target);
+
+	/* exclude by index, objects outside the table are never matched */
+	kd->exclude = -1;
+	offset = (const char *)exclude - (const char *)table->objects;
+	if (exclude && offset >= 0 && offset % table->object.bytes == 0 &&
+		offset / table->object.bytes < table->object.count)
+		kd->exclude = offset / table->object.bytes;
+
+	trace_begin(&table->db->trace, ADB_TRACE_KD_NEAREST, 0);
+	get_nearest(kd, stack);
+	trace_end(&table->db->trace, ADB_TRACE_KD_NEAREST, kd->count);
+	kd_heap_sort(kd);
+	stats_add(&table->db->stats, STATS_KD_SEARCHES, 1);
+	stats_add(&table->db->stats, STATS_KD_NODES, kd->visited);
+#if CHECK_KD_TREE
+	check_search(table, kd);
+#endif
+
+	if (stack != levels)
+		free(stack);
+	return 0;
+}
+
+/**
+ * \brief Get the table object of a KD search match.
+ *
+ * \param table Table searched.
+ * \param match Search match.
+ * \return Matched object.
+ */
+static inline const struct adb_object *kd_match_object(struct adb_table *table,
+													   struct kd_match *match)
+{
+	return (const void *)table->objects + match->index * table->object.bytes;
+}
+
+/**
+ * \brief Search the table KD tree for the object nearest a position.
+ *
+ * \param table Table to search.
+ * \param ra Right Ascension in radians.
+ * \param dec Declination in radians.
+ * \param exclude Object to skip or NULL.
+ * \return Pointer to the nearest object, or NULL if none evaluated.
+ */
+static const struct adb_object *
+kd_search_nearest(struct adb_table *table, double ra, double dec,
+				  const struct adb_object *exclude)
+{
+	struct kd_get_data kd;
+	struct kd_match match;
+
+	kd.limit = HUGE_VAL;
+	kd.all = 0;
+	kd.heap = &match;
+	kd.size = 1;
+
+	if (kd_search(table, ra, dec, exclude, &kd) < 0 || kd.count == 0)
+		return NULL;
+
+	return kd_match_object(table, &match);
+}
+
+/**
+ * \brief Retrieve the closest object to a supplied spatial coordinate pair.
+ *
+ * \param set The active object set specifying table and constraints.
+ * \param ra Right Ascension coordinate limit target in radians.
+ * \param dec Declination angle coordinate target in radians.
+ * \return Pointer to the matched nearest object, or NULL if none evaluated.
+ */
+const struct adb_object *
+adb_table_set_get_nearest_on_pos(struct adb_object_set *set, double ra,
+								 double dec)
+{
+	if (set->remote)
+		return remote_set_get_nearest(set, ra, dec, NULL);
+
+	return kd_search_nearest(set->table, ra, dec, NULL);
+}
+
+/**
+ * \brief Retrieve the nearest object to a given reference object.
+ *
+ * Functions similarly to coordinate-based neighbor checking, but explicitly excludes the input object itself from the results so that it evaluates its closest distinct neighbor.
+ *
+ * \param set Active object scope set parameters.
+ * \param object Target object serving as search origin coordinate.
+ * \return Pointer to the matched distinct nearest neighbor object, or NULL.
+ */
+const struct adb_object *
+adb_table_set_get_nearest_on_object(struct adb_object_set *set,
+									const struct adb_object *object)
+{
+	if (set->remote)
+		return remote_set_get_nearest(set, adb_object_ra(object),
+									  adb_object_dec(object), object);
+
+	return kd_search_nearest(set->table, adb_object_ra(object),
+							 adb_object_dec(object), object);
+}
+
+/**
+ * \brief Retrieve the k objects nearest a position.
+ *
+ * \param set The active object set specifying the table.
+ * \param ra Right Ascension in radians.
+ * \param dec Declination in radians.
+ * \param k Number of objects to find.
+ * \param objects Array of at least k entries for the objects, nearest first.
+ * \return Number of objects found or a negative error code.
+ */
+int adb_table_set_get_knearest_on_pos(struct adb_object_set *set, double ra,
+									  double dec, int k,
+									  const struct adb_object *objects[])
+{
+	struct adb_table *table = set->table;
+	struct kd_get_data kd;
+	int i, ret;
+
+	if (set->remote)
+		return remote_set_get_knearest(set, ra, dec, k, objects);
+
+	if (k < 0)
+		return -EINVAL;
+	if (k == 0)
+		return 0;
+
+	kd.heap = malloc(sizeof(*kd.heap) * k);
+	if (kd.heap == NULL)
+		return -ENOMEM;
+
+	kd.limit = HUGE_VAL;
+	kd.all = 0;
+	kd.size = k;
+
+	ret = kd_search(table, ra, dec, NULL, &kd);
+	if (ret == 0) {
+		for (i = 0; i < kd.count; i++)
+			objects[i] = kd_match_object(table, &kd.heap[i]);
+		ret = kd.count;
+	}
+
+	free(kd.heap);
+	return ret;
+}
+
+/**
+ * \brief Retrieve the objects within a radius of a position.
+ *
+ * \param set The active object set specifying the table.
+ * \param ra Right Ascension in radians.
+ * \param dec Declination in radians.
+ * \param radius Search radius in radians.
+ * \param objects Array for up to size objects, nearest first.
+ * \param size Size of the objects array.
+ * \return Number of objects within radius or a negative error code.
+ */
+int adb_table_set_get_within_radius(struct adb_object_set *set, double ra,
+									double dec, double radius,
+									const struct adb_object *objects[],
+									int size)
+{
+	struct adb_table *table = set->table;
+	struct kd_get_data kd;
+	double chord;
+	int i, ret;
+
+	if (set->remote)
+		return remote_set_get_within(set, ra, dec, radius, objects, size);
+
+	if (radius < 0.0 || size < 0)
+		return -EINVAL;
+
+	kd.heap = malloc(sizeof(*kd.heap) * (size ? size : 1));
+	if (kd.heap == NULL)
+		return -ENOMEM;
+
+	/* chord length of the radius on the unit sphere */
+	chord = radius < M_PI ? 2.0 * sin(radius / 2.0) : 2.0;
+	kd.limit = chord * chord;
+	kd.all = 1;
+	kd.size = size;
+
+	ret = kd_search(table, ra, dec, NULL, &kd);
+	if (ret == 0) {
+		for (i = 0; i < kd.count; i++)
+			objects[i] = kd_match_object(table, &kd.heap[i]);
+		ret = kd.found;
+	}
+
+	free(kd.heap);
+	return ret;
+}
+
+/*! \struct kd_xmatch
+ * \brief Cross match input position in HTM order
+ * \ingroup kdtree
+ */
+struct kd_xmatch {
+	unsigned int key; /*!< HTM order of the home trixel, 0 if invalid */
+	int input; /*!< input position index */
+};
+
+/**
+ * \brief Get a sort key that orders trixels depth first through the HTM.
+ *
+ * Trixel IDs hold the position at depth 1 in the lowest bits, so the key
+ * reverses them to keep trixels with a common parent next to each other.
+ *
+ * \param id Trixel ID.
+ * \return Sort key.
+ */
+static unsigned int xmatch_key(unsigned int id)
+{
+	unsigned int key, depth, i;
+
+	key = 1 << 3 | ((id >> HTM_ID_QUAD_SHIFT) & 0x7);
+	depth = htm_trixel_depth(id);
+	for (i = 1; i <= depth; i++)
+		key = key << 2 | htm_trixel_position(id, i);
+
+	return key;
+}
+
+/**
+ * \brief Comparator function to sort cross match inputs in HTM order.
+ *
+ * \param o1 First cross match input pointer.
+ * \param o2 Second cross match input pointer.
+ * \return -1 if o1 < o2, 1 if o1 > o2, 0 if equal.
+ */
+static int xmatch_cmp(const void *o1, const void *o2)
+{
+	const struct kd_xmatch *x1 = o1, *x2 = o2;
+
+	if (x1->key != x2->key)
+		return x1->key < x2->key ? -1 : 1;
+	return x1->input - x2->input;
+}
+
+/**
+ * \brief Match many positions to their nearest table objects in one call.
+ *
+ * Inputs are searched in HTM order so consecutive searches walk the same
+ * KD tree paths, and are split between the db worker threads.
+ *
+ * \param set The active object set specifying the table.
+ * \param ra Right Ascension of each input position in radians.
+ * \param dec Declination of each input position in radians.
+ * \param n Number of input positions.
+ * \param radius Match radius in radians.
+ * \param out Nearest object within radius for each input, or NULL.
+ * \return Number of matched inputs or a negative error code.
+ */
+int adb_table_crossmatch(struct adb_object_set *set, const double ra[],
+						 const double dec[], int n, double radius,
+						 const struct adb_object *out[])
+{
+	struct adb_table *table = set->table;
+	struct htm *htm = set->db->htm;
+	struct kd_xmatch *order;
+	double chord, limit;
+	int i, matches = 0, ret = 0;
+
+	if (n < 0 || radius < 0.0)
+		return -EINVAL;
+
+	for (i = 0; i < n; i++)
+		out[i] = NULL;
+	if (n == 0)
+		return 0;
+
+	if (set->remote)
+		return remote_set_crossmatch(set, ra, dec, n, radius, out);
+
+	/* load objects and pack nodes now so the searches only read them */
+	if (table_load_all(table) < 0)
+		return -EIO;
+	if (kd_get_nodes(table) == NULL)
+		return table->object.count > 0 ? -ENOMEM : 0;
+
+	order = malloc(sizeof(*order) * n);
+	if (order == NULL)
+		return -ENOMEM;
+
+	chord = radius < M_PI ? 2.0 * sin(radius / 2.0) : 2.0;
+	limit = chord * chord;
+
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(db_workers(set->db))
+#endif
+	for (i = 0; i < n; i++) {
+		struct htm_vertex point;
+		unsigned int id;
+
+		/* ID lookups do not touch the mesh so are safe in parallel */
+		point.ra = ra[i];
+		point.dec = dec[i];
+		id = htm_get_home_id(htm, &point, htm->depth - 1);
+
+		order[i].key = id ? xmatch_key(id) : 0;
+		order[i].input = i;
+	}
+
+	qsort(order, n, sizeof(*order), xmatch_cmp);
+
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : matches) \
+	num_threads(db_workers(set->db))
+#endif
+	for (i = 0; i < n; i++) {
+		struct kd_get_data kd;
+		struct kd_match match;
+		int input = order[i].input;
+
+		/* invalid positions have no home trixel */
+		if (order[i].key == 0)
+			continue;
+
+		kd.limit = limit;
+		kd.all = 0;
+		kd.heap = &match;
+		kd.size = 1;
+
+		if (kd_search(table, ra[input], dec[input], NULL, &kd) < 0) {
+#if HAVE_OPENMP
+#pragma omp atomic write
+#endif
+			ret = -ENOMEM;
+			continue;
+		}
+
+		if (kd.count) {
+			out[input] = kd_match_object(table, &match);
+			matches++;
+		}
+	}
+
+	free(order);
+	return ret < 0 ? ret : matches;
+}
+
+/* pairs handed to the join callback at a time */
+#define KD_JOIN_BATCH 1024
+
+/* table A objects a join worker takes at a time */
+#define KD_JOIN_CHUNK 256
+
+/*! \struct kd_join
+ * \brief Spatial join state shared by the join workers
+ * \ingroup kdtree
+ */
+struct kd_join {
+	adb_join_callback callback; /*!< batch consumer */
+	void *data; /*!< callback data */
+	int pairs; /*!< pairs delivered */
+	int stop; /*!< callback stopped the join or a worker failed */
+	int ret; /*!< first error */
+};
+
+/**
+ * \brief Stop a join with an error or callback stop.
+ *
+ * \param join Join state.
+ * \param ret Negative error code or 0.
+ */
+static void kd_join_stop(struct kd_join *join, int ret)
+{
+	if (join->ret == 0)
+		join->ret = ret;
+#if HAVE_OPENMP
+#pragma omp atomic write
+#endif
+	join->stop = 1;
+}
+
+/**
+ * \brief Deliver a batch of join pairs to the callback.
+ *
+ * Batches from all workers are delivered one at a time so the callback
+ * never runs concurrently with itself.
+ *
+ * \param join Join state.
+ * \param pairs Batch of pairs.
+ * \param count Number of pairs in the batch.
+ */
+static void kd_join_flush(struct kd_join *join,
+						  const struct adb_join_pair *pairs, int count)
+{
+	int ret;
+
+	if (count == 0)
+		return;
+
+#if HAVE_OPENMP
+#pragma omp critical(kd_join)
+#endif
+	{
+		if (!join->stop) {
+			ret = join->callback(pairs, count, join->data);
+			join->pairs += count;
+			if (ret != 0)
+				kd_join_stop(join, ret < 0 ? ret : 0);
+		}
+	}
+}
+
+/**
+ * \brief Join the objects of two tables that lie within a radius.
+ *
+ * Table A objects are taken in their stored HTM order so neighbouring
+ * workers search the same part of the table B tree, and every object
+ * within the radius is matched through the table B KD tree. A self join
+ * reports each pair once and never pairs an object with itself.
+ *
+ * \param db Database holding both tables.
+ * \param table_a Table ID of the first object of each pair.
+ * \param table_b Table ID of the second object of each pair.
+ * \param radius Join radius (radians).
+ * \param callback Called with each batch of pairs.
+ * \param data Callback data.
+ * \return Number of pairs delivered, the negative callback return or error.
+ */
+int adb_table_join(struct adb_db *db, int table_a, int table_b, double radius,
+				   adb_join_callback callback, void *data)
+{
+	struct adb_table *a, *b;
+	struct kd_join join;
+	double chord, limit;
+	int i, self, ret;
+
+	if (table_a < 0 || table_a >= ADB_MAX_TABLES || table_b < 0 ||
+		table_b >= ADB_MAX_TABLES)
+		return -EINVAL;
+	if (radius < 0.0 || callback == NULL)
+		return -EINVAL;
+	ret = db_check_local(db);
+	if (ret < 0)
+		return ret;
+
+	a = &db->table[table_a];
+	b = &db->table[table_b];
+	self = table_a == table_b;
+
+	/* load objects and pack nodes now so the searches only read them */
+	if (table_load_all(a) < 0 || table_load_all(b) < 0)
+		return -EIO;
+	if (a->object.count == 0 || b->object.count == 0)
+		return 0;
+	if (kd_get_nodes(b) == NULL)
+		return -ENOMEM;
+
+	chord = radius < M_PI ? 2.0 * sin(radius / 2.0) : 2.0;
+	limit = chord * chord;
+
+	memset(&join, 0, sizeof(join));
+	join.callback = callback;
+	join.data = data;
+
+#if HAVE_OPENMP
+#pragma omp parallel num_threads(db_workers(db))
+#endif
+	{
+		struct adb_join_pair *pairs;
+		struct kd_get_data kd;
+		int count = 0, size = 64, j, stop;
+
+		pairs = malloc(sizeof(*pairs) * KD_JOIN_BATCH);
+		kd.heap = malloc(sizeof(*kd.heap) * size);
+		if (pairs == NULL || kd.heap == NULL) {
+#if HAVE_OPENMP
+#pragma omp critical(kd_join)
+#endif
+			kd_join_stop(&join, -ENOMEM);
+		}
+
+#if HAVE_OPENMP
+#pragma omp for schedule(dynamic, KD_JOIN_CHUNK)
+#endif
+		for (i = 0; i < a->object.count; i++) {
+			const struct adb_object *object;
+			struct kd_match *heap;
+
+#if HAVE_OPENMP
+#pragma omp atomic read
+#endif
+			stop = join.stop;
+			if (stop)
+				continue;
+
+			object = (const void *)a->objects + i * a->object.bytes;
+			kd.limit = limit;
+			kd.all = 1;
+			kd.size = size;
+
+			if (kd_search(b, adb_object_ra(object), adb_object_dec(object),
+						  self ? object : NULL, &kd) < 0)
+				goto err;
+
+			/* dense fields overflow the heap so search again with room */
+			if (kd.found > size) {
+				heap = realloc(kd.heap, sizeof(*heap) * kd.found);
+				if (heap == NULL)
+					goto err;
+				kd.heap = heap;
+				size = kd.found;
+				kd.size = size;
+				if (kd_search(b, adb_object_ra(object), adb_object_dec(object),
+							  self ? object : NULL, &kd) < 0)
+					goto err;
+			}
+
+			for (j = 0; j < kd.count; j++) {
+				/* the other order of a self join pair is reported by j */
+				if (self && kd.heap[j].index < i)
+					continue;
+
+				pairs[count].a = object;
+				pairs[count].b = kd_match_object(b, &kd.heap[j]);
+				pairs[count].distance =
+					2.0 * asin(sqrt(kd.heap[j].distance) / 2.0);
+				if (++count == KD_JOIN_BATCH) {
+					kd_join_flush(&join, pairs, count);
+					count = 0;
+				}
+			}
+			continue;
+
+		err:
+#if HAVE_OPENMP
+#pragma omp critical(kd_join)
+#endif
+			kd_join_stop(&join, -ENOMEM);
+		}
+
+		if (pairs)
+			kd_join_flush(&join, pairs, count);
+		free(pairs);
+		free(kd.heap);
+	}
+
+	return join.ret < 0 ? join.ret : join.pairs;
 }
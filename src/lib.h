@@ -25,6 +25,8 @@
 #include "table.h"
 #include "import.h"
 #include "private.h"
+#include "stats.h"
+#include "trace.h"
 
 /*
  * The library container.
@@ -33,6 +35,7 @@ struct adb_library {
 	char *local;	/*!< local repository and cache */
 	char *remote;	/*!< remote repository */
 	char *host;
+	char *mirror;	/*!< HTTP(S) mirror of remote, or NULL */
 	unsigned int err; /*!< last error */
 };
 
@@ -47,12 +50,55 @@ struct adb_db {
 	/* tables */
 	struct adb_table table[ADB_MAX_TABLES];   /*!< Catalog datasets */
 	int table_in_use[ADB_MAX_TABLES];
+	enum adb_table_load table_load;	/*!< object load mode for table open */
+	int import_stream;	/*!< stream data files instead of inflating */
+	int import_single_pass;	/*!< read data files once on import */
+	enum adb_kd_build kd_build;	/*!< KD tree build mode for import */
+	enum adb_table_encoding table_encoding; /*!< table file object encoding */
+	enum adb_table_layout table_layout; /*!< table file object order */
+	int table_aggregates;	/*!< store trixel aggregates on import */
+	int workers;		/*!< worker threads, 0 for OpenMP default */
+	unsigned int alloc;	/*!< enum adb_alloc placement flags */
+	int frozen;		/*!< tables are read only for concurrent queries */
+	struct db_stats stats;	/*!< query, solve and import counters */
+	struct db_trace trace;	/*!< hot path event callback */
+	struct remote_conn *remote;	/*!< query daemon connection, or NULL */
 
 	/* logging */
 	enum adb_msg_level msg_level;
 	int msg_flags;
 };
 
+/* tables may not change while queries run concurrently */
+int db_check_thawed(struct adb_db *db);
+
+/* remote databases only support the calls the query daemon serves */
+int db_check_local(struct adb_db *db);
+
+#if HAVE_OPENMP
+#include <omp.h>
+
+/* number of threads for a parallel region */
+static inline int db_workers(struct adb_db *db)
+{
+	return db->workers > 0 ? db->workers : omp_get_max_threads();
+}
+#else
+#include <unistd.h>
+
+/* number of threads for native thread pools */
+static inline int db_workers(struct adb_db *db)
+{
+	long cpus;
+
+	if (db->workers > 0)
+		return db->workers;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return cpus > 0 ? cpus : 1;
+}
+#endif
+
 #endif
 
 #endif
@@ -70,6 +70,7 @@ extern "C" {
 #include <libastrodb/db-import.h>
 #include <libastrodb/db.h>
 #include <libastrodb/object.h>
+#include <libastrodb/remote.h>
 #include <libastrodb/search.h>
 #include <libastrodb/solve.h>
 
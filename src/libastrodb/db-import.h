@@ -221,6 +221,150 @@ int adb_table_import_field(struct adb_db *db, int table_id, const char *field,
  */
 int adb_table_import(struct adb_db *db, int table_id);
 
+/**
+ * \brief Apply new and changed catalog rows to an imported table
+ * \ingroup import
+ *
+ * The table is set up with adb_table_import_new() and
+ * adb_table_import_schema() using the same arguments as its import. Objects
+ * are read back from the table file and keep the depth map of the import,
+ * then each row of the update file is parsed and inserted into its trixel.
+ * A row whose key field matches an object in the table replaces it, other
+ * rows are added. Update rows have the same format as the catalog data file.
+ *
+ * The KD tree indexes the whole table so it is rebuilt and the table file
+ * is rewritten, but the catalog data is not read, inflated or histogrammed
+ * again. Hash maps and quad indexes of the table are removed and rebuilt on
+ * next use.
+ *
+ * \param db Database catalog
+ * \param table_id Table ID from adb_table_import_new()
+ * \param file Path of the data file with the new and changed rows
+ * \param key Field symbol matching rows to objects, NULL to only add rows
+ * \return Number of objects in the updated table or a negative error code
+ */
+int adb_table_import_update(struct adb_db *db, int table_id, const char *file,
+							const char *key);
+
+/**
+ * \brief Stream compressed or split catalog data files into the importer
+ * \ingroup import
+ *
+ * By default .gz data files are inflated to disk and split data files are
+ * concatenated into one file before the import reads them. When streaming is
+ * enabled the data file parts are inflated in order by a separate thread and
+ * fed straight to the row parser, and the .gz files are kept.
+ *
+ * \param db Database catalog
+ * \param enable Non zero to stream the data files
+ */
+void adb_set_import_stream(struct adb_db *db, int enable);
+
+/**
+ * \brief Import catalog data files in a single pass
+ * \ingroup import
+ *
+ * By default the importer reads the data file twice, once to build the
+ * magnitude histogram that sets the HTM depths and again to parse the rows.
+ * In single pass mode every row is parsed into memory while the histogram is
+ * built, and the rows are then placed in the HTM from memory. This halves the
+ * disk reads of catalogs larger than the page cache and inflates streamed
+ * data files only once. The imported tables are the same in both modes.
+ *
+ * \param db Database catalog
+ * \param enable Non zero to read the data files once
+ */
+void adb_set_import_single_pass(struct adb_db *db, int enable);
+
+/*! \enum adb_kd_build
+ * \brief How the KD tree is built when a table is imported
+ * \ingroup import
+ */
+enum adb_kd_build {
+	ADB_KD_BUILD_SORTED = 0, /*!< Median scans over X, Y and Z sorted copies */
+	ADB_KD_BUILD_SELECT = 1, /*!< In place median selection on one array */
+};
+
+/**
+ * \brief Set how the KD tree is built for tables imported after this call
+ * \ingroup import
+ *
+ * The sorted build is the default and reproduces the trees of existing table
+ * files. The select build splits each subtree at its exact median in place,
+ * needs less than half the memory and is faster on large catalogs. Its trees
+ * differ from the sorted build so the table files are not byte identical.
+ *
+ * \param db Database catalog
+ * \param build KD tree build mode, ADB_KD_BUILD_SORTED by default
+ */
+void adb_set_kd_build(struct adb_db *db, enum adb_kd_build build);
+
+/*! \enum adb_table_encoding
+ * \brief How objects are stored in the table file of an imported table
+ * \ingroup import
+ */
+enum adb_table_encoding {
+	ADB_TABLE_ENCODING_RAW = 0, /*!< Objects as they are laid out in memory */
+	ADB_TABLE_ENCODING_COMPACT = 1, /*!< Fixed point positions, pooled names */
+};
+
+/**
+ * \brief Set how tables imported after this call store their objects
+ * \ingroup import
+ *
+ * Compact table files keep RA and DEC as 32 bit fixed point, good to better
+ * than 0.2 mas, magnitudes in millimags and designations in a string pool,
+ * shrinking the fixed part of each object from 56 to 36 bytes plus its
+ * designation. Objects are decoded as they are loaded so queries see the
+ * usual objects, and mapped loads are read into a private buffer instead.
+ * Tables with positions or magnitudes outside the compact range, like 99.9
+ * magnitude placeholders, are stored raw.
+ *
+ * \param db Database catalog
+ * \param encoding Table file encoding, ADB_TABLE_ENCODING_RAW by default
+ */
+void adb_set_table_encoding(struct adb_db *db,
+							enum adb_table_encoding encoding);
+
+/*! \enum adb_table_layout
+ * \brief Order of the objects in the table file of an imported table
+ * \ingroup import
+ */
+enum adb_table_layout {
+	ADB_TABLE_LAYOUT_TRIXEL = 0, /*!< Each trixel followed by its children */
+	ADB_TABLE_LAYOUT_DEPTH = 1, /*!< Each depth in HTM ID order, shallow first */
+};
+
+/**
+ * \brief Set the object order of the table files imported after this call
+ * \ingroup import
+ *
+ * The trixel layout writes each trixel followed by its children. The depth
+ * layout keeps the objects of each depth in one array sorted by HTM ID, and
+ * clips of these tables join the object heads of trixels that are next to
+ * each other in the table, so a clip gives a few long runs in table order
+ * rather than one head per trixel. The table file format is unchanged and
+ * either layout is read by any reader of the file version.
+ *
+ * \param db Database catalog
+ * \param layout Table file layout, ADB_TABLE_LAYOUT_TRIXEL by default
+ */
+void adb_set_table_layout(struct adb_db *db, enum adb_table_layout layout);
+
+/**
+ * \brief Store trixel aggregates in the table files imported after this call
+ * \ingroup import
+ *
+ * Each trixel holding objects of the table, or holding them in its child
+ * trixels, gets the object count, brightest magnitude, integrated flux and
+ * mean position of those objects. The aggregates are read with the table and
+ * returned by adb_set_get_aggregates().
+ *
+ * \param db Database catalog
+ * \param enable Non zero to store the aggregates, disabled by default
+ */
+void adb_set_table_aggregates(struct adb_db *db, int enable);
+
 /**
  * \brief Peek dynamically evaluating the schema type configured representing a struct field
  * \ingroup import
@@ -243,6 +387,17 @@ adb_ctype adb_table_get_field_type(struct adb_db *db, int table_id,
 int adb_table_get_field_offset(struct adb_db *db, int table_id,
 							   const char *field);
 
+/**
+ * \brief Get the byte size of a schema field inside an object
+ * \ingroup import
+ * \param db Database context
+ * \param table_id Table ID
+ * \param field Field symbol
+ * \return Field size in bytes, or -EINVAL if the field is not found
+ */
+int adb_table_get_field_size(struct adb_db *db, int table_id,
+							 const char *field);
+
 /**
  * \brief Forcibly assign an explicit unique alias and record scale footprint independent of file mapping
  * \ingroup import
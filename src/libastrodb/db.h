@@ -31,6 +31,8 @@ extern "C" {
  */
 struct adb_db;
 
+struct adb_object;
+
 /********************** Library and debug *************************************/
 
 /**
@@ -109,6 +111,20 @@ void adb_set_msg_level(struct adb_db *db, enum adb_msg_level level);
  */
 void adb_set_log_level(struct adb_db *db, unsigned int log);
 
+/**
+ * \brief Set the number of worker threads used by a database instance
+ * \ingroup library
+ * \param db The target database context
+ * \param workers Worker threads, 0 (default) uses the OpenMP default or the
+ * number of online CPUs without OpenMP
+ *
+ * Workers parse imported catalog rows, build the import KD tree and search
+ * the object heads of large search sets when the library is built with
+ * OpenMP. Plate solves always use a native pool of this many threads, and
+ * split catalog downloads use up to four of them.
+ */
+void adb_set_workers(struct adb_db *db, int workers);
+
 /*! \struct adb_library
  * \brief Internal context wrapping paths or state for the library instance
  * \ingroup library
@@ -133,6 +149,19 @@ struct adb_library *adb_open_library(const char *host, const char *remote,
  */
 void adb_close_library(struct adb_library *lib);
 
+/**
+ * \brief Set an HTTP(S) mirror used when FTP downloads fail
+ * \ingroup library
+ * \param lib The targeted library context
+ * \param url Mirror of the remote repository, e.g.
+ * "https://cdsarc.cds.unistra.fr/ftp", or NULL to only use FTP
+ * \return 0 on success, -ENOTSUP if built without libcurl
+ *
+ * Catalog files are fetched from url/class/id/file. Partial mirror
+ * downloads left by an interrupted import are resumed.
+ */
+int adb_library_set_mirror(struct adb_library *lib, const char *url);
+
 /**
  * \brief Get the libastrodb version number as a static string
  * \ingroup library
@@ -157,6 +186,65 @@ const char *adb_get_version(void);
  */
 struct adb_db *adb_create_db(struct adb_library *lib, int depth, int tables);
 
+/*! \enum adb_mesh
+ * \brief How the HTM mesh of a database is built
+ * \ingroup catalog
+ */
+enum adb_mesh {
+	ADB_MESH_FULL = 0, /*!< Build every trixel down to the depth at create */
+	ADB_MESH_SPARSE = 1, /*!< Build trixels as objects are inserted */
+};
+
+/**
+ * \brief Allocate and initialize a new catalog database with a mesh mode
+ * \ingroup catalog
+ * \param lib Base library wrapper previously established
+ * \param depth Specifies HTM detail level constraints or tree depths
+ * \param tables Total number of maximum open tables anticipated
+ * \param mesh HTM mesh build mode, adb_create_db() uses ADB_MESH_FULL
+ * \return A pointer to the database layout, or NULL on error
+ *
+ * A full mesh costs memory for every trixel down to depth, which grows by
+ * four each level. A sparse mesh only holds the trixels on the path to
+ * objects of open tables, so deep meshes over small or clustered catalogs
+ * stay small. Clips and lookups give the same objects with either mode.
+ */
+struct adb_db *adb_create_db_mesh(struct adb_library *lib, int depth,
+								  int tables, enum adb_mesh mesh);
+
+/*! \enum adb_alloc
+ * \brief Placement of large table arrays, the HTM mesh and worker threads
+ * \ingroup catalog
+ *
+ * Flags may be combined. Large arrays are the table objects, KD search
+ * nodes and field arrays of at least 2 MB.
+ */
+enum adb_alloc {
+	ADB_ALLOC_DEFAULT = 0, /*!< Heap arrays placed by the first thread */
+	ADB_ALLOC_HUGEPAGE = 1 << 0, /*!< Transparent huge pages for arrays */
+	ADB_ALLOC_HUGETLB = 1 << 1, /*!< Reserved 2 MB pages, else transparent */
+	ADB_ALLOC_INTERLEAVE = 1 << 2, /*!< Interleave arrays and mesh on nodes */
+	ADB_ALLOC_BIND_WORKERS = 1 << 3, /*!< Spread workers over NUMA nodes */
+};
+
+/**
+ * \brief Allocate a new catalog database with a memory placement policy
+ * \ingroup catalog
+ * \param lib Base library wrapper previously established
+ * \param depth Specifies HTM detail level constraints or tree depths
+ * \param tables Total number of maximum open tables anticipated
+ * \param mesh HTM mesh build mode
+ * \param alloc enum adb_alloc flags, adb_create_db() uses ADB_ALLOC_DEFAULT
+ * \return A pointer to the database layout, or NULL on error
+ *
+ * The full mesh is built here, so the policy is given at create. Node
+ * interleaving and worker binding need a build with ENABLE_NUMA and are
+ * ignored otherwise, as are policies the kernel does not offer.
+ */
+struct adb_db *adb_create_db_alloc(struct adb_library *lib, int depth,
+								   int tables, enum adb_mesh mesh,
+								   unsigned int alloc);
+
 /**
  * \brief Gracefully destroys a catalog context, flushing data and freeing handles
  * \ingroup catalog
@@ -164,8 +252,146 @@ struct adb_db *adb_create_db(struct adb_library *lib, int depth, int tables);
  */
 void adb_db_free(struct adb_db *db);
 
+/**
+ * \brief Freeze a catalog for concurrent read only queries
+ * \ingroup catalog
+ * \param db The database descriptor with its tables open
+ * \return 0 on success or a negative error code
+ *
+ * Loads every lazy table object and builds the column and KD search
+ * indexes that queries would otherwise create on first use. Clips, object
+ * gets, searches, nearest and radius queries and hash lookups may then run
+ * from any number of threads, each using its own object sets and searches.
+ * Quad indexes for plate solves are prepared before freezing. Opening,
+ * closing, importing and keying tables fail with -EBUSY until thawed.
+ */
+int adb_db_freeze(struct adb_db *db);
+
+/**
+ * \brief Thaw a frozen catalog so its tables may be changed again
+ * \ingroup catalog
+ * \param db The database descriptor, with no queries in flight
+ */
+void adb_db_thaw(struct adb_db *db);
+
+/*! \struct adb_db_stats
+ * \brief Query, solve and import counters of a database
+ * \ingroup catalog
+ *
+ * Counts since the database was created or the counters were last reset.
+ */
+struct adb_db_stats {
+	uint64_t clips; /*!< object set clips */
+	uint64_t trixels; /*!< clipped trixels visited */
+	uint64_t heads; /*!< object heads clipped */
+	uint64_t searches; /*!< searches run */
+	uint64_t objects_tested; /*!< objects tested by searches */
+	uint64_t kd_searches; /*!< KD tree nearest and radius searches */
+	uint64_t kd_nodes; /*!< KD tree nodes visited */
+	uint64_t hash_lookups; /*!< hash key lookups */
+	uint64_t hash_probes; /*!< hash slots probed */
+	uint64_t solve_primaries; /*!< solver primaries tried */
+	uint64_t solve_mag; /*!< secondaries passing the magnitude stage */
+	uint64_t solve_dist; /*!< clusters passing the distance stage */
+	uint64_t solve_pa; /*!< clusters passing the position angle stage */
+	uint64_t import_objects; /*!< objects imported */
+	uint64_t import_histogram_ns; /*!< time in the magnitude histogram */
+	uint64_t import_rows_ns; /*!< time parsing and inserting rows */
+	uint64_t import_kd_ns; /*!< time building KD trees */
+	uint64_t import_write_ns; /*!< time writing schemas and tables */
+};
+
+/**
+ * \brief Get the query, solve and import counters of a database
+ * \ingroup catalog
+ * \param db The database descriptor
+ * \param stats Output counters
+ * \return 0 on success, -EINVAL without stats or -ENOTSUP when the library
+ * was built without counters
+ *
+ * Every thread counts into its own counters, which are summed here, so
+ * this may be called while queries run.
+ */
+int adb_db_get_stats(struct adb_db *db, struct adb_db_stats *stats);
+
+/**
+ * \brief Reset the counters of a database to zero
+ * \ingroup catalog
+ * \param db The database descriptor
+ */
+void adb_db_reset_stats(struct adb_db *db);
+
+/*! \enum adb_trace_point
+ * \brief Hot paths with trace events
+ * \ingroup catalog
+ */
+enum adb_trace_point {
+	ADB_TRACE_CLIP = 0, /*!< object set clip constraint, htm_clip() */
+	ADB_TRACE_CLIPPED_OBJECTS = 1, /*!< clipped object heads, result heads */
+	ADB_TRACE_KD_NEAREST = 2, /*!< KD tree search, result matches kept */
+	ADB_TRACE_SOLVE_PRIMARY = 3, /*!< solver primary, value its index */
+	ADB_TRACE_SOLVE_DIST = 4, /*!< solver distance stage, result clusters */
+	ADB_TRACE_SOLVE_PA = 5, /*!< solver PA stage, result clusters */
+	ADB_TRACE_KD_BUILD = 6, /*!< import KD tree build */
+	ADB_TRACE_POINTS = 7, /*!< number of trace points */
+};
+
+/*! \enum adb_trace_event
+ * \brief Trace event kind
+ * \ingroup catalog
+ */
+enum adb_trace_event {
+	ADB_TRACE_BEGIN = 0, /*!< path entered */
+	ADB_TRACE_END = 1, /*!< path left, value is its result */
+};
+
+/**
+ * \brief Trace event callback
+ * \ingroup catalog
+ *
+ * Called on the thread running the path, including solver and OpenMP
+ * worker threads, so it must be thread safe and should be quick.
+ */
+typedef void (*adb_trace_callback)(void *data, enum adb_trace_point point,
+								   enum adb_trace_event event, long value);
+
+/**
+ * \brief Register a callback for the begin and end events of hot paths
+ * \ingroup catalog
+ * \param db The database descriptor
+ * \param callback Event callback, or NULL to stop tracing
+ * \param data Private data passed to the callback
+ * \return 0 on success, -EBUSY while frozen or -ENOTSUP when the library
+ * was built without tracing
+ */
+int adb_set_trace(struct adb_db *db, adb_trace_callback callback, void *data);
+
 /********************* Table Management ***************************************/
 
+/*! \enum adb_table_load
+ * \brief How table objects are loaded from the local binary table file
+ * \ingroup dataset
+ */
+enum adb_table_load {
+	ADB_TABLE_LOAD_COPY = 0, /*!< Read objects into a private heap buffer */
+	ADB_TABLE_LOAD_MMAP = 1, /*!< Map objects read only and shared */
+	ADB_TABLE_LOAD_LAZY = 2, /*!< Read each trixel's objects on first use */
+};
+
+/**
+ * \brief Set how tables opened after this call load their objects
+ * \ingroup dataset
+ * \param db Connected Database wrapper Context
+ * \param load Table load mode, ADB_TABLE_LOAD_COPY by default
+ *
+ * Mapped tables share page cache pages between processes and open without
+ * copying, but their objects are read only. Lazy tables only read the
+ * trixels touched by object set clips until a table wide operation such as
+ * a nearest object search or table hash needs them all. Legacy table files
+ * are always copied.
+ */
+void adb_set_table_load(struct adb_db *db, enum adb_table_load load);
+
 /**
  * \brief Opens or initializes a specific catalog dataset as a logical table
  * \ingroup dataset
@@ -197,6 +423,88 @@ int adb_table_close(struct adb_db *db, int table_id);
  */
 int adb_table_hash_key(struct adb_db *db, int table_id, const char *key);
 
+/**
+ * \brief Add a sorted range index on a table field
+ * \ingroup dataset
+ *
+ * Searches with less than or greater than comparators on the field, inside
+ * AND lists, scan the index range and test only the objects inside it that
+ * are also inside the searched set. Int, float and double fields can be
+ * indexed. String fields, like designations, are indexed for equal and
+ * wildcard "prefix*" comparators.
+ *
+ * \param db Reference Database context wrapper
+ * \param table_id Registered internal table scope reference
+ * \param key The field name to index
+ * \return 0 on success, or negative on failures
+ */
+int adb_table_range_key(struct adb_db *db, int table_id, const char *key);
+
+/*! \enum adb_pm_units
+ * \brief Units of the proper motion fields of a table
+ * \ingroup dataset
+ */
+enum adb_pm_units {
+	ADB_PM_MAS = 0, /*!< mas/yr, RA motion scaled by cos(DEC) (Tycho-2) */
+	ADB_PM_ARCSEC = 1, /*!< arcsec/yr, RA motion scaled by cos(DEC) */
+	ADB_PM_SEC_ARCSEC = 2, /*!< RA in time s/yr, DEC in arcsec/yr (Sky2000) */
+};
+
+/**
+ * \brief Set the proper motion fields used to propagate table positions
+ * \ingroup dataset
+ *
+ * Clears any epoch positions computed with earlier proper motion fields.
+ * Int, float and double fields can be used, NaN proper motions count as
+ * no motion.
+ *
+ * \param db Reference Database context wrapper
+ * \param table_id Registered internal table scope reference
+ * \param pm_ra RA proper motion field name
+ * \param pm_dec DEC proper motion field name
+ * \param units Proper motion field units
+ * \param JD Julian Date of the catalog positions, 2451545.0 for J2000
+ * \return 0 on success, or negative on failures
+ */
+int adb_table_proper_motion(struct adb_db *db, int table_id, const char *pm_ra,
+							const char *pm_dec, enum adb_pm_units units,
+							double JD);
+
+/**
+ * \brief Compute the positions of all table objects at an epoch
+ * \ingroup dataset
+ *
+ * Positions are propagated along great circles on the sky and kept for the
+ * most recently used epochs, so later position gets at the same epoch are
+ * array reads. Views needed by concurrent queries must be computed before
+ * the catalog is frozen.
+ *
+ * \param db Reference Database context wrapper
+ * \param table_id Registered internal table scope reference
+ * \param JD Julian Date to propagate the positions to
+ * \return 0 on success, -EINVAL without proper motion fields, -EBUSY if
+ * the epoch is not cached and the catalog is frozen, or -ENOMEM
+ */
+int adb_table_epoch_view(struct adb_db *db, int table_id, double JD);
+
+/**
+ * \brief Get the position of a table object at an epoch
+ * \ingroup dataset
+ *
+ * Computes the epoch view of the table first if it is not cached.
+ *
+ * \param db Reference Database context wrapper
+ * \param table_id Registered internal table scope reference
+ * \param object Table object from an object set, search or get
+ * \param JD Julian Date of the position
+ * \param ra RA of the object at JD in radians
+ * \param dec DEC of the object at JD in radians
+ * \return 0 on success, or negative on failures
+ */
+int adb_table_get_epoch_position(struct adb_db *db, int table_id,
+								 const struct adb_object *object, double JD,
+								 double *ra, double *dec);
+
 /**
  * \brief Get total cache file bounds dynamically in bytes
  * \ingroup dataset
@@ -138,6 +138,54 @@ struct adb_object_set *adb_table_set_new(struct adb_db *db, int table_id);
 int adb_table_set_constraints(struct adb_object_set *set, double ra, double dec,
 							  double fov, double min_Z, double max_Z);
 
+/*! \struct adb_set_delta
+ * \brief Object heads changed by a re-clip
+ * \ingroup dataset
+ *
+ * Heads are runs of table objects in table order, valid until the set is
+ * re-clipped again or freed.
+ */
+struct adb_set_delta {
+	const struct adb_object_head *added; /*!< runs new to the clip */
+	int added_count; /*!< number of added heads */
+	const struct adb_object_head *removed; /*!< runs no longer clipped */
+	int removed_count; /*!< number of removed heads */
+};
+
+/**
+ * \brief Move the cone of a set and get the objects that entered and left
+ * \ingroup dataset
+ * \param set The dataset to re-clip
+ * \param ra Right Ascension coordinate representing the region center
+ * \param dec Declination coordinate representing the region center
+ * \param fov Field of View defining the radius around the coordinates
+ * \param min_Z Minimum Z or magnitude limit for filtering
+ * \param max_Z Maximum Z or magnitude limit for filtering
+ * \param delta Heads added and removed against the previous clip
+ * \return Number of object heads in the new clip, or error
+ *
+ * The set objects are fetched for the new clip. Every head is added when
+ * the set objects were not fetched since it was last constrained.
+ */
+int adb_table_set_reclip(struct adb_object_set *set, double ra, double dec,
+						 double fov, double min_Z, double max_Z,
+						 struct adb_set_delta *delta);
+
+/**
+ * \brief Constrain a dataset to a convex spherical polygon
+ * \ingroup dataset
+ * \param set The targeted dataset to constrain
+ * \param ra Vertex Right Ascensions, edges join consecutive vertices
+ * \param dec Vertex Declinations
+ * \param count Number of vertices, at least 3
+ * \param min_Z Minimum Z or magnitude limit for filtering
+ * \param max_Z Maximum Z or magnitude limit for filtering
+ * \return 0 on success, or an error code
+ */
+int adb_table_set_polygon(struct adb_object_set *set, const double ra[],
+						  const double dec[], int count, double min_Z,
+						  double max_Z);
+
 /**
  * \brief Frees an active dataset and any associated memory
  * \ingroup dataset
@@ -184,19 +232,24 @@ void adb_table_set_free(struct adb_object_set *set);
 struct adb_object_head {
 	const void *objects; /*!< array pointer containing matching objects */
 	unsigned int count; /*!< count indicating the size of the objects array */
+	unsigned int index; /*!< table position of the first object */
 };
 
 /**
  * \brief Evaluate and populate the underlying objects in a constrained dataset
  * \ingroup dataset
  * \param set The target dataset representation
- * \return 0 on success, or an error code
+ * \return Number of object heads inside the clip, or an error code
  */
 int adb_set_get_objects(struct adb_object_set *set);
 
 /**
  * \brief Use a target dataset to look up and cache properties of a hash key string
  * \ingroup dataset
+ *
+ * Keys hashed on the table need no set map, adb_set_get_object() filters
+ * the table map by the set objects.
+ *
  * \param set The target dataset context
  * \param key The character string representing the hash query key
  * \return 0 on success, or an error code
@@ -251,6 +304,89 @@ const struct adb_object *
 adb_table_set_get_nearest_on_pos(struct adb_object_set *set, double ra,
 								 double dec);
 
+/**
+ * \brief Find the k nearest spatial neighbors around specific coordinates
+ * \ingroup dataset
+ * \param set Constrained initialized dataset of surrounding objects
+ * \param ra Right Ascension coordinate query (radians)
+ * \param dec Declination coordinate query (radians)
+ * \param k Number of neighbors to find
+ * \param objects Array of at least k entries filled nearest first
+ * \return Number of objects found, fewer than k for small tables, or error
+ */
+int adb_table_set_get_knearest_on_pos(struct adb_object_set *set, double ra,
+									  double dec, int k,
+									  const struct adb_object *objects[]);
+
+/**
+ * \brief Find all spatial neighbors within a radius of specific coordinates
+ * \ingroup dataset
+ * \param set Constrained initialized dataset of surrounding objects
+ * \param ra Right Ascension coordinate query (radians)
+ * \param dec Declination coordinate query (radians)
+ * \param radius Search radius (radians)
+ * \param objects Array filled with up to size objects nearest first
+ * \param size Number of entries in objects
+ * \return Number of objects within radius, which may exceed size, or error
+ */
+int adb_table_set_get_within_radius(struct adb_object_set *set, double ra,
+									double dec, double radius,
+									const struct adb_object *objects[],
+									int size);
+
+/**
+ * \brief Match many coordinates to their nearest objects in one call
+ * \ingroup dataset
+ * \param set Constrained initialized dataset of surrounding objects
+ * \param ra Right Ascension of each query (radians)
+ * \param dec Declination of each query (radians)
+ * \param n Number of queries
+ * \param radius Match radius (radians)
+ * \param out Nearest object within radius for each query, NULL if none
+ * \return Number of matched queries, or error
+ */
+int adb_table_crossmatch(struct adb_object_set *set, const double ra[],
+						 const double dec[], int n, double radius,
+						 const struct adb_object *out[]);
+
+/*! \struct adb_join_pair
+ * \brief Pair of objects found by a spatial join
+ * \ingroup dataset
+ */
+struct adb_join_pair {
+	const struct adb_object *a; /*!< object from the first table */
+	const struct adb_object *b; /*!< object from the second table */
+	double distance; /*!< separation (radians) */
+};
+
+/**
+ * \brief Spatial join batch consumer
+ * \param pairs Batch of pairs, valid only during the call
+ * \param count Number of pairs in the batch
+ * \param data Caller data passed to adb_table_join()
+ * \return 0 to continue, positive to stop or negative error to abort
+ */
+typedef int (*adb_join_callback)(const struct adb_join_pair *pairs, int count,
+								 void *data);
+
+/**
+ * \brief Find every pair of objects from two tables within a radius
+ * \ingroup dataset
+ * \param db Database holding both tables
+ * \param table_a Table ID of the first object of each pair
+ * \param table_b Table ID of the second object of each pair
+ * \param radius Join radius (radians)
+ * \param callback Called with batches of pairs in no set order, never
+ *                 concurrently
+ * \param data Caller data for the callback
+ * \return Number of pairs delivered, or error
+ *
+ * Joining a table with itself reports each pair once and never pairs an
+ * object with itself.
+ */
+int adb_table_join(struct adb_db *db, int table_a, int table_b, double radius,
+				   adb_join_callback callback, void *data);
+
 /**
  * \brief Fetch the internal linear object head context for a loaded object set
  * \ingroup dataset
@@ -267,6 +403,158 @@ struct adb_object_head *adb_set_get_head(struct adb_object_set *set);
  */
 int adb_set_get_count(struct adb_object_set *set);
 
+/**
+ * \brief Get the brightest objects inside a constrained dataset
+ * \ingroup dataset
+ *
+ * Walks the magnitude depths shallow to deep and stops at the first depth
+ * completing the n brightest, so faint deep trixels are not touched.
+ *
+ * \param set The target constrained dataset
+ * \param n Number of objects wanted
+ * \param objects Output array of at least n objects, brightest first
+ * \return Number of objects, fewer than n if the clip holds fewer, or an
+ * error code
+ */
+int adb_set_get_brightest(struct adb_object_set *set, int n,
+						  const struct adb_object *objects[]);
+
+/**
+ * \brief Export the objects of a populated dataset as contiguous columns
+ * \ingroup dataset
+ *
+ * Copies RA, DEC, magnitude and any named schema fields of each clipped
+ * object into caller arrays in object head order, so bindings and analysis
+ * code can use whole columns without touching each object. Each field
+ * column holds count values of adb_table_get_field_size() bytes.
+ *
+ * \param set The populated dataset
+ * \param ra Output RA column of count values, or NULL
+ * \param dec Output DEC column of count values, or NULL
+ * \param mag Output magnitude column of count values, or NULL
+ * \param fields Schema field names, or NULL when num_fields is 0
+ * \param columns Output column for each field
+ * \param num_fields Number of fields
+ * \param count Size of each output column in values
+ * \return Number of objects exported, at most count, or an error code
+ */
+int adb_set_export_columns(struct adb_object_set *set, double ra[],
+						   double dec[], float mag[], const char *fields[],
+						   void *columns[], int num_fields, int count);
+
+/*! \struct adb_trixel_aggregate
+ * \brief Summary of the objects of a table inside one trixel
+ * \ingroup dataset
+ *
+ * Covers every object stored in the trixel and in its child trixels, at all
+ * magnitudes.
+ */
+struct adb_trixel_aggregate {
+	uint32_t id; /*!< HTM trixel ID */
+	uint32_t count; /*!< number of objects */
+	float brightest; /*!< brightest magnitude, NAN without magnitudes */
+	float flux; /*!< integrated flux in units of a magnitude 0 object */
+	double ra; /*!< mean object Right Ascension in radians */
+	double dec; /*!< mean object Declination in radians */
+};
+
+/**
+ * \brief Get the trixel aggregates covering a constrained dataset
+ * \ingroup dataset
+ *
+ * Returns a summary for each trixel of the clip that is no larger than the
+ * resolution, such as the size of a screen pixel, instead of its objects,
+ * so wide fields can be drawn without reading the objects. Trixels without
+ * objects are skipped. The aggregates ignore the magnitude limits of the set
+ * and need a table imported with adb_set_table_aggregates().
+ *
+ * \param set The constrained dataset
+ * \param resolution Largest trixel size wanted (radians)
+ * \param aggregates Output aggregates, owned by the set
+ * \return Number of aggregates, -ENOENT if the table has no aggregates, or
+ * an error code
+ */
+int adb_set_get_aggregates(struct adb_object_set *set, double resolution,
+						   const struct adb_trixel_aggregate **aggregates);
+
+/****************** Multi Table Clipping **************************************/
+
+/*! \struct adb_multi_set
+ * \brief Opaque structure holding the object sets of several tables clipped
+ * together
+ * \ingroup dataset
+ */
+struct adb_multi_set;
+
+/*! \struct adb_multi_object
+ * \brief An object of a merged multi table clip
+ * \ingroup dataset
+ */
+struct adb_multi_object {
+	const struct adb_object *object; /*!< object in its table layout */
+	int table_id; /*!< table holding the object */
+};
+
+/**
+ * \brief Creates a dataset collection clipping several tables together
+ * \ingroup dataset
+ * \param db Pointer to the database context
+ * \param table_id Identifiers of the tables, in de-duplication priority
+ * \param count Number of tables
+ * \return Pointer to the new multi table set, or NULL on error
+ */
+struct adb_multi_set *adb_multi_set_new(struct adb_db *db, const int table_id[],
+										int count);
+
+/**
+ * \brief Apply one cone constraint to every table of a multi table set
+ * \ingroup dataset
+ * \param mset The targeted multi table set to constrain
+ * \param ra Right Ascension coordinate representing the region center
+ * \param dec Declination coordinate representing the region center
+ * \param fov Field of View defining the radius around the coordinates
+ * \param min_Z Minimum Z or magnitude limit for filtering
+ * \param max_Z Maximum Z or magnitude limit for filtering
+ * \return 0 on success, or an error code
+ */
+int adb_multi_set_constraints(struct adb_multi_set *mset, double ra,
+							  double dec, double fov, double min_Z,
+							  double max_Z);
+
+/**
+ * \brief Get the merged objects of every table inside the constraint
+ * \ingroup dataset
+ *
+ * The tables are clipped together in one HTM traversal. With a positive
+ * radius an object is dropped when an object of an earlier table lies
+ * within the radius of it.
+ *
+ * \param mset The target multi table set
+ * \param radius De-duplication match radius (radians), 0 keeps all objects
+ * \param objects Output merged objects, owned by the set
+ * \return Number of merged objects, or an error code
+ */
+int adb_multi_set_get_objects(struct adb_multi_set *mset, double radius,
+							  const struct adb_multi_object **objects);
+
+/**
+ * \brief Get the object set of one table of a multi table set
+ * \ingroup dataset
+ * \param mset The target multi table set
+ * \param index Position of the table in the table identifiers
+ * \return The table object set, clipped by adb_multi_set_get_objects(), or
+ * NULL on error
+ */
+struct adb_object_set *adb_multi_set_get_set(struct adb_multi_set *mset,
+											 int index);
+
+/**
+ * \brief Frees a multi table set and its table object sets
+ * \ingroup dataset
+ * \param mset The target multi table set
+ */
+void adb_multi_set_free(struct adb_multi_set *mset);
+
 #ifdef __cplusplus
 };
 #endif
@@ -0,0 +1,107 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#ifndef __LIBADB_REMOTE_H
+#define __LIBADB_REMOTE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct adb_db;
+
+/**
+ * \defgroup remote Query Daemon
+ * \brief Share one loaded catalog between processes
+ *
+ * A query daemon keeps its tables and their hashes resident and serves
+ * queries over a Unix socket. Processes connect a remote database, then
+ * use the usual table, set and search calls on it. Tables are shared by
+ * every client, and adbd maps their objects from the table files so the
+ * pages are also shared with any local database using the same tables.
+ *
+ * Remote databases support table open, close, counts and field queries,
+ * keys hashed with adb_table_hash_key() and looked up with
+ * adb_table_get_object(), cone sets, nearest, radius and batched
+ * adb_table_crossmatch() queries, and searches built from comparators.
+ * Objects returned by a remote query are copies that stay valid until the
+ * next query of the same kind on the same set, table or search. Other
+ * calls return -EOPNOTSUPP or NULL.
+ */
+
+/*! \struct adb_server
+ * \brief Opaque query daemon serving a database
+ * \ingroup remote
+ */
+struct adb_server;
+
+/**
+ * \brief Connect to a query daemon
+ * \ingroup remote
+ * \param path Daemon Unix socket path
+ * \return Remote database to be freed with adb_db_free(), or NULL on error
+ */
+struct adb_db *adb_connect_db(const char *path);
+
+/**
+ * \brief Create a query daemon for a database
+ * \ingroup remote
+ *
+ * Clients may open any table of the database library. Tables opened by the
+ * daemon stay open until it is freed.
+ *
+ * \param db Database to serve, not frozen and not remote
+ * \param path Unix socket path, replaced if it exists
+ * \return Daemon, or NULL on error
+ */
+struct adb_server *adb_server_new(struct adb_db *db, const char *path);
+
+/**
+ * \brief Serve clients until the daemon is stopped
+ * \ingroup remote
+ *
+ * Clients are served in turn by the calling thread, each having its
+ * requests answered in order.
+ *
+ * \param server The daemon
+ * \return 0 when stopped, or a negative error code
+ */
+int adb_server_run(struct adb_server *server);
+
+/**
+ * \brief Stop a running daemon
+ * \ingroup remote
+ *
+ * Safe to call from signal handlers and other threads.
+ *
+ * \param server The daemon
+ */
+void adb_server_stop(struct adb_server *server);
+
+/**
+ * \brief Free a query daemon and remove its socket
+ * \ingroup remote
+ * \param server The daemon, not running
+ */
+void adb_server_free(struct adb_server *server);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
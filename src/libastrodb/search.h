@@ -57,6 +57,15 @@ enum adb_comparator {
 	ADB_COMP_NE /*!< Not equal to comparator (!=) */
 };
 
+/*! \enum adb_search_limit
+ * \brief Search hits kept when a search result limit is set
+ * \ingroup search
+ */
+enum adb_search_limit {
+	ADB_LIMIT_FIRST, /*!< First hits in object head order */
+	ADB_LIMIT_BRIGHTEST /*!< Brightest hits in ascending magnitude order */
+};
+
 /*! \typedef adb_custom_comparator
  * \brief A custom object search comparator function pointer type
  * \ingroup search
@@ -149,7 +158,8 @@ int adb_search_add_custom_comparator(struct adb_search *search,
  * \ingroup search
  *
  * Runs the compiled RPN query on the provided object set and collects pointers
- * to objects that match all search criteria.
+ * to objects that match all search criteria. Large sets are searched by the
+ * database workers, results are always in object head order.
  *
  * \param search The search context containing the compiled query
  * \param set The target object set containing candidate objects to query against
@@ -160,6 +170,47 @@ int adb_search_get_results(struct adb_search *search,
 						   struct adb_object_set *set,
 						   const struct adb_object **objects[]);
 
+/**
+ * \brief Limit the number of search results
+ * \ingroup search
+ *
+ * Limited searches stop early. First hit limits stop at the limit, while
+ * brightest hit limits skip objects fainter than the brightest hits found so
+ * far without testing them. Objects without a magnitude are never among the
+ * brightest hits.
+ *
+ * \param search The search context
+ * \param limit Maximum number of results, 0 (default) for all hits
+ * \param type The hits kept under the limit
+ * \return 0 on success, or an error code
+ */
+int adb_search_set_limit(struct adb_search *search, int limit,
+						 enum adb_search_limit type);
+
+/**
+ * \brief Start iterating over search results
+ * \ingroup search
+ *
+ * Iteration searches the set lazily, head by head, returning each hit as it
+ * is found from adb_search_iter_next(). Changing the search ends the
+ * iteration.
+ *
+ * \param search The search context containing the compiled query
+ * \param set The target object set containing candidate objects to query against
+ * \return 0 on success, or a negative error code
+ */
+int adb_search_iter_begin(struct adb_search *search,
+						  struct adb_object_set *set);
+
+/**
+ * \brief Get the next search result
+ * \ingroup search
+ *
+ * \param search The search context started by adb_search_iter_begin()
+ * \return The next matching object, or NULL when the search is complete
+ */
+const struct adb_object *adb_search_iter_next(struct adb_search *search);
+
 /**
  * \brief Get the total number of search hits (successful matches)
  * \ingroup search
@@ -80,6 +80,8 @@ enum adb_find {
 	ADB_FIND_ASTEROIDS = 1 << 3, /*!< include asteroids in search */
 	ADB_FIND_PROPER_MOTION = 1
 							 << 4, /*!< apply Proper Motion (PM) in solution */
+	ADB_FIND_INDEX = 1 << 5, /*!< only try primaries from the quad index */
+	ADB_FIND_NEIGHBOURS = 1 << 6, /*!< match on cached neighbour lists */
 };
 
 /*! \enum adb_plate_bounds
@@ -94,6 +96,15 @@ enum adb_plate_bounds {
 	ADB_BOUND_CENTRE, /*!< Center of the plate */
 };
 
+/*! \enum adb_plate_fit
+ * \brief Plate to equatorial transform used by a solution
+ * \ingroup solve
+ */
+enum adb_plate_fit {
+	ADB_PLATE_FIT_PAIRS, /*!< average the transforms of reference pairs */
+	ADB_PLATE_FIT_LSQ, /*!< least squares affine fit to the references */
+};
+
 /*! \struct adb_source_objects
  * \brief Source objects wrapper
  * \ingroup solve
@@ -133,6 +144,17 @@ struct adb_solve_solution;
  */
 struct adb_solve;
 
+/*! \struct adb_solve_frame
+ * \brief Plate frame solved by adb_solve_batch
+ * \ingroup solve
+ */
+struct adb_solve_frame {
+	struct adb_solve *solve; /*!< solver holding the frame plate objects */
+	struct adb_object_set *set; /*!< object set to solve against */
+	enum adb_find find; /*!< adb_find flags for the frame */
+	int result; /*!< solutions found, or a negative error code */
+};
+
 /**
  * \brief Creates a new solver context
  * \ingroup solve
@@ -186,6 +208,30 @@ int adb_solve_set_pa_delta(struct adb_solve *solve, double delta_degrees);
 int adb_solve_add_plate_object(struct adb_solve *solve,
 							   struct adb_pobject *pobject);
 
+/**
+ * \brief Set the plate drift allowed between frames for adb_solve_track
+ * \ingroup solve
+ * \param solve The solver context
+ * \param delta_pixels The largest plate object movement in pixels
+ * \return 0 on success, or an error code
+ */
+int adb_solve_set_track_delta(struct adb_solve *solve, double delta_pixels);
+
+/**
+ * \brief Set the plate to equatorial transform used by solutions
+ * \ingroup solve
+ *
+ * ADB_PLATE_FIT_PAIRS averages the transforms of every reference object
+ * pair, costing a pass over the pairs per position. ADB_PLATE_FIT_LSQ uses
+ * the least squares affine fit to the unclipped reference objects, costing
+ * a fixed transform per position and modelling plate shear.
+ *
+ * \param solve The solver context
+ * \param fit The transform, default ADB_PLATE_FIT_PAIRS
+ * \return 0 on success, or an error code
+ */
+int adb_solve_set_plate_fit(struct adb_solve *solve, enum adb_plate_fit fit);
+
 /**
  * \brief Set a specific solver constraint (like FOV limits)
  * \ingroup solve
@@ -201,6 +247,18 @@ int adb_solve_constraint(struct adb_solve *solve, enum adb_constraint type,
 /**
  * \brief Execute the solve process
  * \ingroup solve
+ *
+ * The magnitude sorted source objects are kept on the object set and reused
+ * by later solves, from any solver, with the same magnitude constraint. They
+ * are prepared again after the set constraints change.
+ *
+ * ADB_FIND_NEIGHBOURS also keeps the separation and PA of every source
+ * object pair within the maximum ADB_CONSTRAINT_FOV with the source
+ * objects. The first solve builds them, then each primary only looks up the
+ * separation window of its pattern instead of computing the distance to
+ * every magnitude candidate. It's worth the memory for repeat solves on the
+ * same set.
+ *
  * \param solve The solver context
  * \param set Target object set to use for solving (can be NULL)
  * \param find Bitmask of adb_find flags controlling the search behavior
@@ -209,6 +267,139 @@ int adb_solve_constraint(struct adb_solve *solve, enum adb_constraint type,
 int adb_solve(struct adb_solve *solve, struct adb_object_set *set,
 			  enum adb_find find);
 
+/**
+ * \brief Solve many independent plate frames concurrently
+ * \ingroup solve
+ *
+ * Frames are solved on a pool of db worker threads, each frame by its
+ * own solver. Frames with the same object set and magnitude constraint
+ * share one source object preparation. The result of each frame is
+ * stored in its result field, and adb_solve_get_progress() reports the
+ * progress of each frame solver while the batch runs. All ADB_FIND_INDEX
+ * frames on a table must use the same index constraints.
+ *
+ * \param frame Array of frames to solve
+ * \param count Number of frames
+ * \return Number of frames with at least one solution, or a negative
+ * error code
+ */
+int adb_solve_batch(struct adb_solve_frame *frame, int count);
+
+/**
+ * \brief Execute the solve process seeded by the solution of a previous frame
+ * \ingroup solve
+ *
+ * For image sequences where the pointing moves only a little between
+ * frames. The prior solution predicts the sky position of each plate
+ * object, and only catalog objects within the track delta of a predicted
+ * primary are tried. Each object of a solution must be the nearest catalog
+ * object to its predicted position. A full adb_solve() is run when no
+ * plate window can be tracked.
+ *
+ * \param solve The solver context
+ * \param set Target object set to use for solving (can be NULL)
+ * \param prior Solution of the previous frame on the same table
+ * \param find Bitmask of adb_find flags controlling the search behavior
+ * \return Number of solutions found, or a negative error code
+ */
+int adb_solve_track(struct adb_solve *solve, struct adb_object_set *set,
+					struct adb_solve_solution *prior, enum adb_find find);
+
+/**
+ * \brief Execute the solve process within a time budget
+ * \ingroup solve
+ *
+ * For latency bound solving. Solves with the configured magnitude, distance
+ * and PA deltas first, then with doubled and quadrupled deltas while no
+ * solution is found. Every pass tries primaries brightest first and stops at
+ * the deadline, even inside a primary with many candidates, and the
+ * solutions found in time are kept. Use adb_solution_divergence() on the
+ * first solution as the match confidence, lower is better. Building an
+ * ADB_FIND_INDEX index or ADB_FIND_NEIGHBOURS lists does not check the
+ * deadline, so prepare them with an earlier solve for a strict budget.
+ *
+ * \param solve The solver context
+ * \param set Target object set to use for solving
+ * \param find Bitmask of adb_find flags controlling the search behavior
+ * \param msecs Time budget in milliseconds
+ * \return Number of solutions found, -ETIMEDOUT if none were found in time,
+ * or a negative error code
+ */
+int adb_solve_timed(struct adb_solve *solve, struct adb_object_set *set,
+					enum adb_find find, int msecs);
+
+/**
+ * \brief Asynchronous solve completion callback
+ * \ingroup solve
+ *
+ * Called once on the solver thread when an adb_solve_start() solve ends,
+ * so it must be thread safe and must not free or wait for the solver.
+ */
+typedef void (*adb_solve_callback)(void *data, struct adb_solve *solve,
+								   int result);
+
+/**
+ * \brief Start adb_solve() on its own solver thread and return at once
+ * \ingroup solve
+ *
+ * The caller keeps running while the solve proceeds, and can follow it
+ * with adb_solve_get_progress() and end it early with adb_solve_stop().
+ * Completion is signalled by the callback and by the adb_solve_get_fd()
+ * descriptor becoming readable. Every started solve must be collected
+ * with adb_solve_wait() before the solver is used again. The solver and
+ * object set must not be changed until then.
+ *
+ * \param solve The solver context
+ * \param set Target object set to use for solving
+ * \param find Bitmask of adb_find flags controlling the search behavior
+ * \param callback Completion callback, or NULL
+ * \param data Private data passed to the callback
+ * \return 0 on success, -EBUSY if a solve is already started, or an error
+ * code
+ */
+int adb_solve_start(struct adb_solve *solve, struct adb_object_set *set,
+					enum adb_find find, adb_solve_callback callback,
+					void *data);
+
+/**
+ * \brief Get a descriptor that becomes readable when a started solve ends
+ * \ingroup solve
+ *
+ * For poll() and event loops. The descriptor is owned by the solver and
+ * stays valid until adb_solve_wait() returns.
+ *
+ * \param solve The solver context
+ * \return File descriptor, or -EINVAL if no solve is started
+ */
+int adb_solve_get_fd(struct adb_solve *solve);
+
+/**
+ * \brief Wait for a started solve to end and collect its result
+ * \ingroup solve
+ * \param solve The solver context
+ * \return The adb_solve() result of the started solve, or -EINVAL if no
+ * solve is started
+ */
+int adb_solve_wait(struct adb_solve *solve);
+
+/**
+ * \brief Load or build the plate solving quad index of the solver table
+ * \ingroup solve
+ *
+ * The quad index holds scale and rotation invariant codes for each star
+ * down to the faint ADB_CONSTRAINT_MAG limit with pairs of its brightest
+ * neighbours inside the maximum ADB_CONSTRAINT_FOV. ADB_FIND_INDEX solves
+ * look up the plate pattern codes to try only matching primaries instead of
+ * the whole object set. The index is saved as a .quad file next to the
+ * table file and read back by later solves with the same constraints. A
+ * pattern using stars outside the neighbours of its primary is not
+ * indexed and needs a solve without ADB_FIND_INDEX.
+ *
+ * \param solve The solver context with its constraints set
+ * \return 0 on success, or an error code
+ */
+int adb_solve_prepare_index(struct adb_solve *solve);
+
 /**
  * \brief Get a specific solution from the solver after running adb_solve
  * \ingroup solve
@@ -379,6 +570,79 @@ void adb_solution_equ_to_plate_position_fast(struct adb_solve_solution *solution
 											 double ra, double dec, double *x,
 											 double *y);
 
+/**
+ * \brief Convert many plate pixel positions to equatorial coordinates
+ * \ingroup solve
+ *
+ * Array form of adb_solution_plate_to_equ_position(), each reference pair
+ * transform is calculated once and applied to every position.
+ *
+ * \param solution The solver solution containing transformation logic
+ * \param x Plate x pixel coordinates, count long
+ * \param y Plate y pixel coordinates, count long
+ * \param count Number of positions
+ * \param ra Output Right Ascensions in radians, count long
+ * \param dec Output Declinations in radians, count long
+ * \return 0 on success, or a negative error code
+ */
+int adb_solution_plate_to_equ_positions(struct adb_solve_solution *solution,
+										const double *x, const double *y,
+										int count, double *ra, double *dec);
+
+/**
+ * \brief Convert many equatorial coordinates to plate pixel positions
+ * \ingroup solve
+ *
+ * Array form of adb_solution_equ_to_plate_position().
+ *
+ * \param solution The solver solution containing transformation logic
+ * \param ra Right Ascensions in radians, count long
+ * \param dec Declinations in radians, count long
+ * \param count Number of positions
+ * \param x Output plate x pixel coordinates, count long
+ * \param y Output plate y pixel coordinates, count long
+ * \return 0 on success, or a negative error code
+ */
+int adb_solution_equ_to_plate_positions(struct adb_solve_solution *solution,
+										const double *ra, const double *dec,
+										int count, double *x, double *y);
+
+/**
+ * \brief Fast approximate conversion of many plate pixel positions
+ * \ingroup solve
+ *
+ * Array form of adb_solution_plate_to_equ_position_fast().
+ *
+ * \param solution The solver solution
+ * \param x Plate x pixel coordinates, count long
+ * \param y Plate y pixel coordinates, count long
+ * \param count Number of positions
+ * \param ra Output Right Ascensions in radians, count long
+ * \param dec Output Declinations in radians, count long
+ * \return 0 on success, or a negative error code
+ */
+int adb_solution_plate_to_equ_positions_fast(
+	struct adb_solve_solution *solution, const double *x, const double *y,
+	int count, double *ra, double *dec);
+
+/**
+ * \brief Fast approximate conversion of many equatorial coordinates
+ * \ingroup solve
+ *
+ * Array form of adb_solution_equ_to_plate_position_fast().
+ *
+ * \param solution The solver solution
+ * \param ra Right Ascensions in radians, count long
+ * \param dec Declinations in radians, count long
+ * \param count Number of positions
+ * \param x Output plate x pixel coordinates, count long
+ * \param y Output plate y pixel coordinates, count long
+ * \return 0 on success, or a negative error code
+ */
+int adb_solution_equ_to_plate_positions_fast(
+	struct adb_solve_solution *solution, const double *ra, const double *dec,
+	int count, double *x, double *y);
+
 /**
  * \brief Calculate photometry properties for matches in a solution
  * \ingroup solve
@@ -398,6 +662,11 @@ int adb_solution_calc_astrometry(struct adb_solve_solution *solution);
 /**
  * \brief Request the solver to stop the current long-running operation
  * \ingroup solve
+ *
+ * Safe to call from another thread. A stop requested after
+ * adb_solve_start() stops the started solve even if it has not begun
+ * solving yet.
+ *
  * \param solve The solver context
  */
 void adb_solve_stop(struct adb_solve *solve);
@@ -16,132 +16,206 @@
  *  Copyright (C) 2013 - 2014 Liam Girdwood
  */
 
+#include <errno.h>
 #include <math.h>
+#include <stdlib.h>
 
+#include "debug.h"
+#include "lib.h"
+#include "simd.h"
 #include "solve.h"
 
-/**
- * @brief Calculate the mean magnitude difference between a target and reference objects.
- *
- * Compares the brightness of a specific plate object against all successfully
- * solved reference plate objects, calculating average differences to establish a 
- * magnitude baseline.
- *
- * @param solution Active solved layout containing both references and target.
- * @param target Internal index within the referenced array for the source object.
- * @return The computed baseline mean magnitude delta.
+/* reference plate position, sorted to group refs at the same position */
+struct mag_posn {
+	int x;
+	int y;
+	int id;
+};
+
+/*
+ * Reference magnitude terms as contiguous arrays. The delta between a target
+ * t and reference i is zero[i] - zero[t] for the mean and inst[i] - inst[t]
+ * for the sigma, so the sums over all unclipped references are gathered once
+ * per clip pass and each target then removes the references that share its
+ * plate position.
  */
-static float get_ref_mag_delta_mean(struct adb_solve_solution *solution,
-									int target)
+struct mag_clip {
+	int count;
+	double *zero; /* catalog mag + instrumental mag of the ref */
+	double *inst; /* catalog mag - instrumental mag, less its mean */
+	double *keep; /* 1.0 for unclipped refs */
+	double *kinst; /* keep * inst */
+	double *gsum; /* count, zero, inst and inst^2 sums per position group */
+	int *group; /* first ref at the same plate position */
+	double n, zero_sum, inst_sum, inst_sq_sum;
+};
+
+static int mag_posn_cmp(const void *a, const void *b)
 {
-	struct adb_reference_object *ref, *reft;
-	float mean = 0.0, plate_delta, db_delta;
-	int count = 0, i;
+	const struct mag_posn *pa = a, *pb = b;
 
-	reft = &solution->ref[target];
+	if (pa->x != pb->x)
+		return pa->x < pb->x ? -1 : 1;
+	if (pa->y != pb->y)
+		return pa->y < pb->y ? -1 : 1;
+	return pa->id - pb->id;
+}
 
-	/* compare target against each solved object */
-	for (i = 0; i < solution->num_ref_objects; i++) {
-		ref = &solution->ref[i];
+static void mag_clip_free(struct mag_clip *clip)
+{
+	free(clip->zero);
+	free(clip->group);
+}
 
-		/* dont compare object against itself */
-		if (ref->pobject.x == reft->pobject.x &&
-			ref->pobject.y == reft->pobject.y)
-			continue;
+/**
+ * @brief Gather the magnitude terms of each reference object.
+ *
+ * @param solution Solution holding the reference objects.
+ * @param clip Clip arrays to fill.
+ * @return 0 on success or -ENOMEM.
+ */
+static int mag_clip_init(struct adb_solve_solution *solution,
+						 struct mag_clip *clip)
+{
+	struct adb_reference_object *ref;
+	struct mag_posn *posn;
+	double adu, mean = 0.0;
+	int n = solution->num_ref_objects, i;
+
+	clip->count = n;
+	clip->zero = calloc(n * 8, sizeof(double));
+	clip->group = calloc(n, sizeof(int));
+	posn = calloc(n, sizeof(*posn));
+	if (clip->zero == NULL || clip->group == NULL || posn == NULL) {
+		free(posn);
+		mag_clip_free(clip);
+		return -ENOMEM;
+	}
 
-		/* ignore any object with mean difference > sigma */
-		if (ref->clip_mag)
-			continue;
+	clip->inst = clip->zero + n;
+	clip->keep = clip->inst + n;
+	clip->kinst = clip->keep + n;
+	clip->gsum = clip->kinst + n;
 
-		/* difference between plate objects */
-		plate_delta = mag_get_plate_diff(&reft->pobject, &ref->pobject);
+	for (i = 0; i < n; i++) {
+		ref = &solution->ref[i];
 
-		/* difference between catalog objects */
-		db_delta = ref->object->mag - reft->object->mag;
+		/* catch any objects with 0 ADU */
+		adu = ref->pobject.adu ? ref->pobject.adu : 1;
+		clip->zero[i] = ref->object->mag + 2.5 * log10(adu);
+		clip->inst[i] = ref->object->mag - 2.5 * log10(adu);
+		mean += clip->inst[i];
 
-		/* calculate average difference */
-		mean += db_delta - plate_delta;
-		count++;
+		posn[i].x = ref->pobject.x;
+		posn[i].y = ref->pobject.y;
+		posn[i].id = i;
 	}
 
-	if (count)
-		mean /= count;
+	/* centre the sigma terms so their squares don't lose precision */
+	mean /= n;
+	for (i = 0; i < n; i++)
+		clip->inst[i] -= mean;
+
+	/* refs at the same plate position are never compared */
+	qsort(posn, n, sizeof(*posn), mag_posn_cmp);
+	for (i = 0; i < n; i++) {
+		if (i > 0 && posn[i].x == posn[i - 1].x && posn[i].y == posn[i - 1].y)
+			clip->group[posn[i].id] = clip->group[posn[i - 1].id];
+		else
+			clip->group[posn[i].id] = posn[i].id;
+	}
 
-	return mean;
+	free(posn);
+	return 0;
 }
 
-/* TODO: investigate speedup with only 4 ref objects found in soln */
 /**
- * @brief Calculate the magnitude variance (sigma) for a target object.
- *
- * Compares a plate object's relative brightness against reference objects and
- * computes the standard deviation (sigma) of its magnitude deltas against the mean.
+ * @brief Sum the magnitude terms of the unclipped reference objects.
  *
- * @param solution Active solved layout parameters containing matched components.
- * @param target Numeric index defining the object within the reference stack.
- * @param mean Pre-computed mean magnitude delta for the evaluated object.
- * @return Standard deviation representing magnitude error constraints.
+ * @param solution Solution holding the reference objects.
+ * @param clip Clip arrays to update.
  */
-static float get_ref_mag_delta_sigma(struct adb_solve_solution *solution,
-									 int target, float mean)
+static void mag_clip_update(struct adb_solve_solution *solution,
+							struct mag_clip *clip)
 {
-	struct adb_reference_object *ref, *reft;
-	float plate_delta, db_delta, diff, sigma = 0.0;
-	int count = 0, i;
-
-	reft = &solution->ref[target];
-
-	/* compare target against each solved object */
-	for (i = 0; i < solution->num_ref_objects; i++) {
-		ref = &solution->ref[i];
+	double *gsum;
+	int n = clip->count, i;
+
+	for (i = 0; i < n; i++) {
+		clip->keep[i] = solution->ref[i].clip_mag ? 0.0 : 1.0;
+		clip->kinst[i] = clip->keep[i] * clip->inst[i];
+		gsum = &clip->gsum[clip->group[i] * 4];
+		gsum[0] = gsum[1] = gsum[2] = gsum[3] = 0.0;
+	}
 
-		/* dont compare object against itself */
-		if (ref->pobject.x == reft->pobject.x &&
-			ref->pobject.y == reft->pobject.y)
+	for (i = 0; i < n; i++) {
+		if (!clip->keep[i])
 			continue;
 
-		/* ignore any object with mean difference > sigma */
-		if (ref->clip_mag)
-			continue;
+		gsum = &clip->gsum[clip->group[i] * 4];
+		gsum[0] += 1.0;
+		gsum[1] += clip->zero[i];
+		gsum[2] += clip->inst[i];
+		gsum[3] += clip->kinst[i] * clip->inst[i];
+	}
 
-		/* mag difference between target and solved plate object */
-		plate_delta = mag_get_plate_diff(&ref->pobject, &reft->pobject);
+	clip->n = simd_dot(clip->keep, clip->keep, n);
+	clip->zero_sum = simd_dot(clip->keep, clip->zero, n);
+	clip->inst_sum = simd_dot(clip->keep, clip->inst, n);
+	clip->inst_sq_sum = simd_dot(clip->kinst, clip->inst, n);
+}
 
-		/* delta between target object mag and detected object mag */
-		db_delta = ref->object->mag - reft->object->mag;
+/**
+ * @brief Calculate the magnitude delta mean and sigma for a target object.
+ *
+ * The target is compared against every unclipped reference object at another
+ * plate position, the mean being the average catalog delta less the plate
+ * delta and the sigma its standard deviation.
+ *
+ * @param clip Clip arrays summed for this pass.
+ * @param target Index of the target reference object.
+ * @param mean Mean magnitude delta.
+ * @param sigma Standard deviation of the magnitude deltas.
+ */
+static void mag_clip_stats(const struct mag_clip *clip, int target,
+						   float *mean, float *sigma)
+{
+	const double *gsum = &clip->gsum[clip->group[target] * 4];
+	double count, m, c, sq;
 
-		/* calc sigma */
-		diff = db_delta - plate_delta;
-		diff -= mean;
-		diff *= diff;
-		sigma += diff;
-		count++;
+	count = clip->n - gsum[0];
+	if (count < 0.5) {
+		*mean = 0.0;
+		*sigma = 0.0;
+		return;
 	}
 
-	if (count)
-		sigma /= count;
+	m = (clip->zero_sum - gsum[1]) / count - clip->zero[target];
 
-	return sqrtf(sigma);
+	/* sum of (inst[i] - c)^2 expanded over the gathered sums */
+	c = clip->inst[target] + m;
+	sq = (clip->inst_sq_sum - gsum[3]) -
+		 2.0 * c * (clip->inst_sum - gsum[2]) + count * c * c;
+
+	*mean = m;
+	*sigma = sqrt(sq > 0.0 ? sq / count : 0.0);
 }
 
-/* TODO: investigate speedup with only 4 ref objects found in soln */
 /**
- * @brief Estimate the absolute magnitude of an unsolved plate object.
+ * @brief Calculate the plate magnitude zero point of the reference objects.
  *
- * Extracts mean magnitude differences against confirmed references applying average
- * delta to approximate the visual magnitude for the remaining unmatched targets.
+ * Each reference object gives the catalog magnitude a plate object of 1 ADU
+ * would have, the mean of these is the plate zero point.
  *
  * @param solution Executing layout framework bounds containing registered references.
- * @param target Index position of the specific unsolved plate target points.
+ * @return The mean magnitude of a 1 ADU plate object.
  */
-static void calc_unsolved_plate_magnitude(struct adb_solve_solution *solution,
-										  int target)
+static double get_ref_mag_zero(struct adb_solve_solution *solution)
 {
 	struct adb_reference_object *ref;
+	double zero = 0.0, adu;
 	int i, count = 0;
-	float mean = 0.0;
 
-	/* compare plate object to reference objects */
 	for (i = 0; i < solution->num_ref_objects; i++) {
 		ref = &solution->ref[i];
 
@@ -150,15 +224,13 @@ static void calc_unsolved_plate_magnitude(struct adb_solve_solution *solution,
 		if (ref->clip_mag)
 			continue;
 
-		/* calculate mean difference in magnitude */
-		mean += ref->object->mag +
-				mag_get_plate_diff(&ref->pobject,
-								   &solution->solve_object[target].pobject);
+		/* catch any objects with 0 ADU */
+		adu = ref->pobject.adu ? ref->pobject.adu : 1;
+		zero += ref->object->mag + 2.5 * log10(adu);
 		count++;
 	}
 
-	/* use mean magnitude as estimated plate magnitude */
-	solution->solve_object[target].mag = mean / count;
+	return zero / count;
 }
 
 /**
@@ -172,32 +244,37 @@ static void calc_unsolved_plate_magnitude(struct adb_solve_solution *solution,
 void mag_calc_plate_coefficients(struct adb_solve_solution *solution)
 {
 	struct adb_reference_object *ref;
+	struct mag_clip mclip;
 	int i, count = 0, tries = 10, lastcount;
 	float mean_sigma = 0.0, sigma_sigma = 0.0, t, clip;
 
 	if (solution->num_ref_objects < 3)
 		return;
 
+	if (mag_clip_init(solution, &mclip) < 0) {
+		adb_error(solution->db, "can't allocate magnitude clip\n");
+		return;
+	}
+
 	do {
 		lastcount = count;
 		count = 0;
 
 		/* calc mean delta per reference target */
+		mag_clip_update(solution, &mclip);
 		for (i = 0; i < solution->num_ref_objects; i++) {
 			ref = &solution->ref[i];
 
 			if (ref->clip_mag)
 				continue;
 
-			ref->mag_mean = get_ref_mag_delta_mean(solution, i);
-			ref->mag_sigma =
-				get_ref_mag_delta_sigma(solution, i, ref->mag_mean);
+			mag_clip_stats(&mclip, i, &ref->mag_mean, &ref->mag_sigma);
 			mean_sigma += ref->mag_sigma;
 			count++;
 		}
 
 		if (count == 0)
-			return;
+			break;
 
 		mean_sigma /= count;
 
@@ -216,7 +293,7 @@ void mag_calc_plate_coefficients(struct adb_solve_solution *solution)
 		}
 
 		if (count == 0)
-			return;
+			break;
 
 		sigma_sigma /= count;
 		sigma_sigma = sqrtf(sigma_sigma);
@@ -234,6 +311,8 @@ void mag_calc_plate_coefficients(struct adb_solve_solution *solution)
 
 		/* clip targets outside sigma */
 	} while (count != lastcount && --tries);
+
+	mag_clip_free(&mclip);
 }
 
 /**
@@ -247,9 +326,16 @@ void mag_calc_plate_coefficients(struct adb_solve_solution *solution)
 void mag_calc_unsolved_plate(struct adb_solve_solution *solution)
 {
 	struct adb_solve_object *solve_object;
+	double zero, adu;
 	int i;
 
-	/* compare each unsolved object against reference objects */
+	/* the zero point is shared by every unsolved object */
+	zero = get_ref_mag_zero(solution);
+
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) private(solve_object, adu) \
+	num_threads(db_workers(solution->db)) if (solution->total_objects > 4096)
+#endif
 	for (i = 0; i < solution->total_objects; i++) {
 		solve_object = &solution->solve_object[i];
 
@@ -257,7 +343,9 @@ void mag_calc_unsolved_plate(struct adb_solve_solution *solution)
 		if (solve_object->object)
 			continue;
 
-		calc_unsolved_plate_magnitude(solution, i);
+		/* use mean magnitude as estimated plate magnitude */
+		adu = solve_object->pobject.adu ? solve_object->pobject.adu : 1;
+		solve_object->mag = zero - 2.5 * log10(adu);
 	}
 }
 
@@ -272,8 +360,18 @@ void mag_calc_unsolved_plate(struct adb_solve_solution *solution)
 void mag_calc_solved_plate(struct adb_solve_solution *solution)
 {
 	struct adb_reference_object *ref;
+	struct mag_clip mclip;
 	int i, idx;
 
+	if (solution->num_ref_objects == 0)
+		return;
+
+	if (mag_clip_init(solution, &mclip) < 0) {
+		adb_error(solution->db, "can't allocate magnitude clip\n");
+		return;
+	}
+	mag_clip_update(solution, &mclip);
+
 	/* compare each detected object against reference objects */
 	for (i = 0; i < solution->num_ref_objects; i++) {
 		ref = &solution->ref[i];
@@ -283,13 +381,13 @@ void mag_calc_solved_plate(struct adb_solve_solution *solution)
 		if (solution->solve_object[idx].object == NULL)
 			continue;
 
-		solution->solve_object[idx].mean = get_ref_mag_delta_mean(solution, i);
+		mag_clip_stats(&mclip, i, &solution->solve_object[idx].mean,
+					   &solution->solve_object[idx].sigma);
 
 		solution->solve_object[idx].mag =
 			solution->solve_object[idx].object->mag +
 			solution->solve_object[idx].mean;
-
-		solution->solve_object[idx].sigma = get_ref_mag_delta_sigma(
-			solution, i, solution->solve_object[idx].mean);
 	}
+
+	mag_clip_free(&mclip);
 }
@@ -36,6 +36,7 @@
 #define ADB_PATH_SIZE		1024
 #define ADB_MAX_TABLES		16
 #define ADB_IMPORT_LINE_SIZE	1024
+#define ADB_IMPORT_CHUNK_ROWS	4096
 
 #define likely(x)       __builtin_expect((x),1)
 #define unlikely(x)     __builtin_expect((x),0)
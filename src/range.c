@@ -0,0 +1,244 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "range.h"
+#include "table.h"
+#include "libastrodb/db.h"
+#include "libastrodb/object.h"
+
+static int range_entry_cmp(const void *a, const void *b)
+{
+	const struct range_entry *ea = a, *eb = b;
+
+	if (ea->value != eb->value)
+		return ea->value < eb->value ? -1 : 1;
+	return ea->index < eb->index ? -1 : ea->index > eb->index;
+}
+
+/*! \struct range_strings
+ * \ingroup range
+ * \brief String fields sorted by range_string_cmp().
+ */
+struct range_strings {
+	const char *objects; /*!< first table object */
+	int bytes; /*!< object size */
+	int offset; /*!< field offset in object */
+	int size; /*!< field size */
+};
+
+static int range_string_cmp(const void *a, const void *b, void *data)
+{
+	const struct range_entry *ea = a, *eb = b;
+	const struct range_strings *s = data;
+	int cmp;
+
+	cmp = strncmp(s->objects + (size_t)ea->index * s->bytes + s->offset,
+				  s->objects + (size_t)eb->index * s->bytes + s->offset,
+				  s->size);
+	if (cmp)
+		return cmp;
+	return ea->index < eb->index ? -1 : ea->index > eb->index;
+}
+
+/**
+ * \brief Read a numeric field as a double.
+ *
+ * \param field Field data.
+ * \param type Field C type.
+ * \return Field value.
+ */
+static double range_field_value(const void *field, adb_ctype type)
+{
+	switch (type) {
+	case ADB_CTYPE_INT:
+		return *(const int *)field;
+	case ADB_CTYPE_FLOAT:
+		return *(const float *)field;
+	default:
+		return *(const double *)field;
+	}
+}
+
+/**
+ * \brief Build a range index over a table field.
+ *
+ * Every loaded table object is added with its field value, then the entries
+ * are sorted on value. Ties keep table object order. String fields are
+ * sorted on the field characters.
+ *
+ * \param table Table with the range index declared.
+ * \param index Range index to build.
+ * \return 0 on success, or a negative error code.
+ */
+int range_build_table(struct adb_table *table, int index)
+{
+	struct range_index *range = &table->range.index[index];
+	const char *object;
+	double value;
+	int i, ret;
+
+	if (table->object.count == 0) {
+		adb_error(table->db, "table has no objects to index\n");
+		return -EINVAL;
+	}
+
+	ret = table_load_all(table);
+	if (ret < 0)
+		return ret;
+
+	range->entry = malloc(table->object.count * sizeof(*range->entry));
+	if (range->entry == NULL)
+		return -ENOMEM;
+
+	object = (const char *)table->objects;
+
+	/* strings are sorted in place on the objects */
+	if (range->type == ADB_CTYPE_STRING) {
+		struct range_strings strings = {
+			.objects = object,
+			.bytes = table->object.bytes,
+			.offset = range->offset,
+			.size = range->size,
+		};
+
+		for (i = 0; i < table->object.count; i++) {
+			range->entry[i].value = 0.0;
+			range->entry[i].index = i;
+		}
+		range->count = table->object.count;
+
+		qsort_r(range->entry, range->count, sizeof(*range->entry),
+				range_string_cmp, &strings);
+		return 0;
+	}
+
+	for (i = 0, range->count = 0; i < table->object.count; i++) {
+		value = range_field_value(object + range->offset, range->type);
+
+		/* NaN fails every range test */
+		if (value == value) {
+			range->entry[range->count].value = value;
+			range->entry[range->count++].index = i;
+		}
+		object += table->object.bytes;
+	}
+
+	qsort(range->entry, range->count, sizeof(*range->entry), range_entry_cmp);
+	return 0;
+}
+
+/**
+ * \brief Free the range indexes of a table.
+ *
+ * \param table Table with range indexes.
+ */
+void range_free_indexes(struct adb_table *table)
+{
+	int i;
+
+	for (i = 0; i < table->range.num; i++) {
+		free(table->range.index[i].entry);
+		table->range.index[i].entry = NULL;
+	}
+
+	table->range.num = 0;
+}
+
+const struct range_index *range_get_index(struct adb_table *table, int offset)
+{
+	int i;
+
+	for (i = 0; i < table->range.num; i++) {
+		if (table->range.index[i].offset == offset)
+			return &table->range.index[i];
+	}
+
+	return NULL;
+}
+
+/* first entry with a value above min, or above or equal when inclusive */
+static int range_lower(const struct range_index *index, double min,
+					   int inclusive)
+{
+	int low = 0, high = index->count, mid;
+
+	while (low < high) {
+		mid = (low + high) >> 1;
+		if (index->entry[mid].value < min ||
+			(!inclusive && index->entry[mid].value == min))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+int range_find(const struct range_index *index, double min, double max,
+			   int *start)
+{
+	int end;
+
+	*start = range_lower(index, min, 0);
+	end = range_lower(index, max, 1);
+
+	return end > *start ? end - *start : 0;
+}
+
+/* first string entry comparing above the prefix, or above or equal */
+static int range_lower_prefix(const struct adb_table *table,
+							  const struct range_index *index,
+							  const char *prefix, int len, int inclusive)
+{
+	const char *objects = (const char *)table->objects + index->offset;
+	int low = 0, high = index->count, mid, cmp;
+
+	while (low < high) {
+		mid = (low + high) >> 1;
+		cmp = strncmp(objects +
+						  (size_t)index->entry[mid].index * table->object.bytes,
+					  prefix, len);
+		if (cmp < 0 || (!inclusive && cmp == 0))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+int range_find_prefix(const struct adb_table *table,
+					  const struct range_index *index, const char *prefix,
+					  int len, int *start)
+{
+	int end;
+
+	/* fields are not terminated when full */
+	if (len > index->size)
+		len = index->size;
+
+	*start = range_lower_prefix(table, index, prefix, len, 1);
+	end = range_lower_prefix(table, index, prefix, len, 0);
+
+	return end - *start;
+}
@@ -0,0 +1,133 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#ifndef __ADB_RANGE_H
+#define __ADB_RANGE_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include "libastrodb/db-import.h"
+
+/*! \defgroup range Range
+ *
+ * \brief Sorted field indexes for range searches.
+ *
+ * Numeric fields sorted with their table object positions, so objects with
+ * a field value in a range are found by binary search rather than by
+ * testing every object. String fields are sorted the same way, so objects
+ * with a field starting with a prefix are found by binary search.
+ */
+
+#define ADB_MAX_RANGE_INDEXES 16 /* number of range indexes */
+
+struct adb_table;
+
+/*! \struct range_entry
+ * \brief Field value of one table object.
+ * \ingroup range
+ */
+struct range_entry {
+	double value; /*!< field value, unused for string fields */
+	unsigned int index; /*!< table object position */
+};
+
+/*! \struct range_index
+ * \brief Single range index.
+ * \ingroup range
+ *
+ * Table objects in ascending field value order. Objects with a NaN field
+ * value are left out, no range test can select them. String fields are in
+ * strncmp() order over the field size.
+ */
+struct range_index {
+	struct range_entry *entry; /*!< ascending field values */
+	int count; /*!< number of entries */
+	int offset; /*!< field offset in object */
+	int size; /*!< field size in bytes */
+	adb_ctype type; /*!< field C type */
+	const char *key; /*!< field name */
+};
+
+/*! \struct table_range
+ * \brief Database Table Range Indexes.
+ * \ingroup range
+ */
+struct table_range {
+	struct range_index index[ADB_MAX_RANGE_INDEXES];
+	int num;
+};
+
+/*!
+ * \brief Build a range index over a table field.
+ * \ingroup range
+ *
+ * \param table Database table to index
+ * \param index Index inside `table->range` to populate
+ * \return 0 on success, negative error code on failure
+ */
+int range_build_table(struct adb_table *table, int index);
+
+/*!
+ * \brief Free the range indexes of a table.
+ * \ingroup range
+ *
+ * \param table Database table pointer
+ */
+void range_free_indexes(struct adb_table *table);
+
+/*!
+ * \brief Get the range index for a field offset.
+ * \ingroup range
+ *
+ * \param table Database table pointer
+ * \param offset Field offset in object
+ * \return The range index, or NULL if the field is not indexed
+ */
+const struct range_index *range_get_index(struct adb_table *table, int offset);
+
+/*!
+ * \brief Find the entries with a field value inside an open range.
+ * \ingroup range
+ *
+ * \param index Range index
+ * \param min Values must be greater than min
+ * \param max Values must be less than max
+ * \param start First entry inside the range
+ * \return Number of entries inside the range from start
+ */
+int range_find(const struct range_index *index, double min, double max,
+			   int *start);
+
+/*!
+ * \brief Find the entries of a string range index starting with a prefix.
+ * \ingroup range
+ *
+ * \param table Database table holding the indexed objects
+ * \param index String range index
+ * \param prefix Prefix the field values must start with
+ * \param len Prefix length
+ * \param start First entry starting with the prefix
+ * \return Number of entries starting with the prefix from start
+ */
+int range_find_prefix(const struct adb_table *table,
+					  const struct range_index *index, const char *prefix,
+					  int len, int *start);
+
+#endif
+
+#endif
@@ -116,6 +116,24 @@ int cds_get_dataset(struct adb_db *db, struct adb_table *table,
 	const char *ext);
 int cds_prepare_files(struct adb_db *db, struct adb_table *table,
 	const char *ext);
+int cds_inflate_file(struct adb_db *db, const char *path, const char *src_file,
+	const char *dest_file);
+
+struct cds_fetch;
+int cds_fetch_file(struct adb_table *table, const char *file);
+int cds_fetch_files(struct adb_table *table, const char *pattern);
+int cds_fetch_count(struct cds_fetch *fetch);
+const char *cds_fetch_name(struct cds_fetch *fetch, int i);
+int cds_fetch_wait(struct cds_fetch *fetch, const char *path);
+int cds_fetch_resuming(struct adb_table *table);
+int cds_fetch_finish(struct adb_table *table);
+
+struct cds_stream;
+struct cds_stream *cds_stream_open(struct adb_db *db, struct adb_table *table,
+	const char *ext);
+FILE *cds_stream_file(struct cds_stream *stream);
+int cds_stream_rewind(struct cds_stream *stream);
+int cds_stream_close(struct cds_stream *stream);
 int table_parse_readme(struct adb_db *db, int table_id);
 
 #endif
@@ -0,0 +1,838 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "lib.h"
+#include "remote.h"
+#include "libastrodb/object.h"
+#include "libastrodb/remote.h"
+
+int remote_buf_put(struct remote_buf *buf, const void *data, size_t bytes)
+{
+	size_t size;
+	char *new;
+
+	if (buf->len + bytes > buf->size) {
+		size = buf->size ? buf->size : 256;
+		while (size < buf->len + bytes)
+			size *= 2;
+
+		new = realloc(buf->data, size);
+		if (new == NULL)
+			return -ENOMEM;
+		buf->data = new;
+		buf->size = size;
+	}
+
+	memcpy(buf->data + buf->len, data, bytes);
+	buf->len += bytes;
+	return 0;
+}
+
+int remote_buf_put_int(struct remote_buf *buf, int32_t val)
+{
+	return remote_buf_put(buf, &val, sizeof(val));
+}
+
+int remote_buf_put_double(struct remote_buf *buf, double val)
+{
+	return remote_buf_put(buf, &val, sizeof(val));
+}
+
+int remote_buf_put_str(struct remote_buf *buf, const char *str)
+{
+	int32_t len = strlen(str);
+	int ret;
+
+	ret = remote_buf_put_int(buf, len);
+	if (ret < 0)
+		return ret;
+
+	/* the terminator goes too, so gets can point into the payload */
+	return remote_buf_put(buf, str, len + 1);
+}
+
+const void *remote_buf_get_data(struct remote_buf *buf, size_t bytes)
+{
+	const void *data;
+
+	if (bytes > buf->len - buf->pos)
+		return NULL;
+
+	data = buf->data + buf->pos;
+	buf->pos += bytes;
+	return data;
+}
+
+int remote_buf_get(struct remote_buf *buf, void *data, size_t bytes)
+{
+	const void *src = remote_buf_get_data(buf, bytes);
+
+	if (src == NULL)
+		return -EPROTO;
+
+	memcpy(data, src, bytes);
+	return 0;
+}
+
+int remote_buf_get_int(struct remote_buf *buf, int32_t *val)
+{
+	return remote_buf_get(buf, val, sizeof(*val));
+}
+
+int remote_buf_get_double(struct remote_buf *buf, double *val)
+{
+	return remote_buf_get(buf, val, sizeof(*val));
+}
+
+const char *remote_buf_get_str(struct remote_buf *buf)
+{
+	const char *str;
+	int32_t len;
+
+	if (remote_buf_get_int(buf, &len) < 0 || len < 0)
+		return NULL;
+
+	str = remote_buf_get_data(buf, (size_t)len + 1);
+	if (str == NULL || str[len] != '\0')
+		return NULL;
+
+	return str;
+}
+
+void remote_buf_free(struct remote_buf *buf)
+{
+	free(buf->data);
+	memset(buf, 0, sizeof(*buf));
+}
+
+/**
+ * \brief Write all bytes to a socket.
+ *
+ * \param fd Socket.
+ * \param data Bytes to write.
+ * \param bytes Number of bytes.
+ * \return 0 on success or a negative error code.
+ */
+static int remote_write(int fd, const void *data, size_t bytes)
+{
+	const char *pos = data;
+	ssize_t ret;
+
+	while (bytes) {
+		ret = send(fd, pos, bytes, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		pos += ret;
+		bytes -= ret;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Read all bytes from a socket.
+ *
+ * \param fd Socket.
+ * \param data Buffer for the bytes.
+ * \param bytes Number of bytes.
+ * \return 0 on success or a negative error code.
+ */
+static int remote_read(int fd, void *data, size_t bytes)
+{
+	char *pos = data;
+	ssize_t ret;
+
+	while (bytes) {
+		ret = recv(fd, pos, bytes, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (ret == 0)
+			return -ECONNRESET;
+		pos += ret;
+		bytes -= ret;
+	}
+
+	return 0;
+}
+
+struct remote_conn *remote_begin(struct adb_db *db)
+{
+	struct remote_conn *conn = db->remote;
+	struct remote_hdr hdr = { 0 };
+
+	pthread_mutex_lock(&conn->mutex);
+
+	/* the header is filled in when the request is sent */
+	conn->req.len = 0;
+	remote_buf_put(&conn->req, &hdr, sizeof(hdr));
+	return conn;
+}
+
+void remote_end(struct remote_conn *conn)
+{
+	pthread_mutex_unlock(&conn->mutex);
+}
+
+int remote_call(struct adb_db *db, struct remote_conn *conn,
+				enum remote_op op)
+{
+	struct remote_hdr *hdr, reply;
+	int32_t status;
+	int ret;
+
+	if (conn->fd < 0)
+		return -ENOTCONN;
+	if (conn->req.len < sizeof(*hdr))
+		return -ENOMEM;
+
+	hdr = (struct remote_hdr *)conn->req.data;
+	hdr->magic = REMOTE_MAGIC;
+	hdr->op = op;
+	hdr->tag = ++conn->tag;
+	hdr->size = conn->req.len - sizeof(*hdr);
+
+	ret = remote_write(conn->fd, conn->req.data, conn->req.len);
+	if (ret < 0)
+		goto err;
+
+	ret = remote_read(conn->fd, &reply, sizeof(reply));
+	if (ret < 0)
+		goto err;
+
+	if (reply.magic != REMOTE_MAGIC || reply.op != (uint32_t)op ||
+		reply.tag != conn->tag || reply.size < sizeof(status) ||
+		reply.size > REMOTE_MAX_PAYLOAD) {
+		ret = -EPROTO;
+		goto err;
+	}
+
+	conn->reply.len = 0;
+	conn->reply.pos = 0;
+	if (conn->reply.size < reply.size) {
+		free(conn->reply.data);
+		conn->reply.data = malloc(reply.size);
+		conn->reply.size = conn->reply.data ? reply.size : 0;
+		if (conn->reply.data == NULL) {
+			ret = -ENOMEM;
+			goto err;
+		}
+	}
+
+	ret = remote_read(conn->fd, conn->reply.data, reply.size);
+	if (ret < 0)
+		goto err;
+	conn->reply.len = reply.size;
+
+	remote_buf_get_int(&conn->reply, &status);
+	return status;
+
+err:
+	/* the reply stream is out of step, so nothing more can be read */
+	adb_error(db, "query daemon request %d failed %d\n", op, ret);
+	close(conn->fd);
+	conn->fd = -1;
+	return ret;
+}
+
+int remote_get_objects(struct remote_conn *conn, struct adb_table *table,
+					   int count, void **objects)
+{
+	size_t bytes = (size_t)count * table->object.bytes;
+	const void *data;
+	void *new;
+
+	if (count < 0)
+		return -EPROTO;
+
+	data = remote_buf_get_data(&conn->reply, bytes);
+	if (data == NULL)
+		return -EPROTO;
+
+	new = realloc(*objects, bytes ? bytes : 1);
+	if (new == NULL)
+		return -ENOMEM;
+
+	memcpy(new, data, bytes);
+	*objects = new;
+	return 0;
+}
+
+struct adb_db *adb_connect_db(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct remote_conn *conn;
+	struct adb_db *db;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return NULL;
+	strcpy(addr.sun_path, path);
+
+	db = calloc(1, sizeof(*db));
+	if (db == NULL)
+		return NULL;
+	db->msg_level = ADB_MSG_INFO;
+	db->msg_flags = ADB_LOG_SEARCH | ADB_LOG_SOLVE;
+	stats_init(&db->stats);
+
+	conn = calloc(1, sizeof(*conn));
+	if (conn == NULL)
+		goto err;
+	pthread_mutex_init(&conn->mutex, NULL);
+	db->remote = conn;
+
+	conn->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (conn->fd < 0)
+		goto err;
+
+	if (connect(conn->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		adb_error(db, "can't connect to query daemon %s %d\n", path, -errno);
+		goto err;
+	}
+
+	return db;
+
+err:
+	remote_db_free(db);
+	stats_free(&db->stats);
+	free(db);
+	return NULL;
+}
+
+void remote_db_free(struct adb_db *db)
+{
+	struct remote_conn *conn = db->remote;
+	int i;
+
+	if (conn == NULL)
+		return;
+
+	for (i = 0; i < ADB_MAX_TABLES; i++) {
+		if (db->table_in_use[i])
+			adb_table_close(db, i);
+	}
+
+	if (conn->fd >= 0)
+		close(conn->fd);
+	remote_buf_free(&conn->req);
+	remote_buf_free(&conn->reply);
+	pthread_mutex_destroy(&conn->mutex);
+	free(conn);
+	db->remote = NULL;
+}
+
+int remote_table_open(struct adb_db *db, struct adb_table *table,
+					  const char *table_name)
+{
+	struct remote_conn *conn = remote_begin(db);
+	struct cds_importer *import = &table->import;
+	int32_t id, count, bytes, fields, alt_fields;
+	int i, ret;
+
+	ret = remote_buf_put_str(&conn->req, table->cds.cat_class);
+	ret |= remote_buf_put_str(&conn->req, table->cds.index);
+	ret |= remote_buf_put_str(&conn->req, table_name);
+	if (ret < 0) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = remote_call(db, conn, REMOTE_OP_OPEN);
+	if (ret < 0)
+		goto out;
+
+	ret = remote_buf_get_int(&conn->reply, &id);
+	ret |= remote_buf_get_int(&conn->reply, &count);
+	ret |= remote_buf_get_int(&conn->reply, &bytes);
+	ret |= remote_buf_get_int(&conn->reply, &fields);
+	ret |= remote_buf_get_int(&conn->reply, &alt_fields);
+	if (ret < 0 || fields < 0 || fields > ADB_TABLE_MAX_FIELDS ||
+		alt_fields < 0 || alt_fields > ADB_TABLE_MAX_ALT_FIELDS ||
+		bytes < (int)sizeof(struct adb_object)) {
+		ret = -EPROTO;
+		goto out;
+	}
+
+	/* the schema answers field queries without asking the daemon */
+	for (i = 0; i < fields; i++) {
+		ret = remote_buf_get(&conn->reply, &import->field[i],
+							 sizeof(import->field[i]));
+		if (ret < 0)
+			goto out;
+		import->field[i].import = NULL;
+	}
+	for (i = 0; i < alt_fields; i++) {
+		ret = remote_buf_get(&conn->reply, &import->alt_field[i].key_field,
+							 sizeof(import->alt_field[i].key_field));
+		if (ret < 0)
+			goto out;
+		import->alt_field[i].key_field.import = NULL;
+	}
+
+	table->remote_id = id;
+	table->object.count = count;
+	table->object.bytes = bytes;
+	table->object.field_count = fields;
+	table->object.num_alt_fields = alt_fields;
+
+	adb_info(db, ADB_LOG_CDS_TABLE,
+			 "Opened remote table %s as %d with %d objects of %d bytes\n",
+			 table_name, id, count, bytes);
+	ret = 0;
+
+out:
+	remote_end(conn);
+	return ret;
+}
+
+void remote_table_close(struct adb_table *table)
+{
+	free(table->remote_object);
+	table->remote_object = NULL;
+}
+
+int remote_table_hash_key(struct adb_db *db, struct adb_table *table,
+						  const char *key)
+{
+	struct remote_conn *conn = remote_begin(db);
+	int ret;
+
+	ret = remote_buf_put_int(&conn->req, table->remote_id);
+	ret |= remote_buf_put_str(&conn->req, key);
+	if (ret == 0)
+		ret = remote_call(db, conn, REMOTE_OP_HASH_KEY);
+	else
+		ret = -ENOMEM;
+
+	remote_end(conn);
+	return ret;
+}
+
+int remote_table_get_object(struct adb_db *db, struct adb_table *table,
+							const void *id, const char *field,
+							const struct adb_object **object)
+{
+	struct remote_conn *conn;
+	int size, ret;
+
+	*object = NULL;
+
+	size = adb_table_get_field_size(db, table->id, field);
+	if (size < 0)
+		return size;
+	if (adb_table_get_field_type(db, table->id, field) == ADB_CTYPE_STRING)
+		size = strnlen(id, size);
+	if (size > REMOTE_MAX_KEY)
+		return -EINVAL;
+
+	conn = remote_begin(db);
+	ret = remote_buf_put_int(&conn->req, table->remote_id);
+	ret |= remote_buf_put_str(&conn->req, field);
+	ret |= remote_buf_put_int(&conn->req, size);
+	ret |= remote_buf_put(&conn->req, id, size);
+	if (ret < 0) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = remote_call(db, conn, REMOTE_OP_GET_OBJECT);
+	if (ret > 0) {
+		if (remote_get_objects(conn, table, 1, &table->remote_object) < 0)
+			ret = -EPROTO;
+		else
+			*object = table->remote_object;
+	}
+
+out:
+	remote_end(conn);
+	return ret;
+}
+
+int remote_set_new(struct adb_object_set *set)
+{
+	set->remote = calloc(1, sizeof(*set->remote));
+	if (set->remote == NULL)
+		return -ENOMEM;
+
+	set->head_size = 1;
+	set->object_heads = calloc(1, sizeof(struct adb_object_head));
+	if (set->object_heads == NULL) {
+		free(set->remote);
+		return -ENOMEM;
+	}
+
+	set->remote->all = 1;
+	set->fov = 2.0 * M_PI;
+	return 0;
+}
+
+void remote_set_free(struct adb_object_set *set)
+{
+	free(set->remote->objects);
+	free(set->remote->query);
+	free(set->remote);
+}
+
+int remote_set_constraints(struct adb_object_set *set, double ra, double dec,
+						   double fov, double start, double end)
+{
+	struct remote_set *remote = set->remote;
+
+	remote->all = 0;
+	remote->valid = 0;
+	remote->ra = ra;
+	remote->dec = dec;
+	remote->fov = fov;
+	remote->start = start;
+	remote->end = end;
+
+	set->centre_ra = ra;
+	set->centre_dec = dec;
+	set->fov = fov;
+	set->count = 0;
+	set->head_count = 0;
+	return 0;
+}
+
+/**
+ * \brief Add the set table and constraints to a request.
+ *
+ * \param conn Connection with the request being built.
+ * \param set The remote object set.
+ * \return 0 on success or -ENOMEM.
+ */
+static int remote_put_set(struct remote_conn *conn,
+						  struct adb_object_set *set)
+{
+	struct remote_set *remote = set->remote;
+	int ret;
+
+	ret = remote_buf_put_int(&conn->req, set->table->remote_id);
+	ret |= remote_buf_put_int(&conn->req, remote->all);
+	ret |= remote_buf_put_double(&conn->req, remote->ra);
+	ret |= remote_buf_put_double(&conn->req, remote->dec);
+	ret |= remote_buf_put_double(&conn->req, remote->fov);
+	ret |= remote_buf_put_double(&conn->req, remote->start);
+	ret |= remote_buf_put_double(&conn->req, remote->end);
+	return ret < 0 ? -ENOMEM : 0;
+}
+
+int remote_set_get_objects(struct adb_object_set *set)
+{
+	struct remote_set *remote = set->remote;
+	struct remote_conn *conn;
+	int ret;
+
+	if (remote->valid)
+		return set->head_count;
+
+	conn = remote_begin(set->db);
+	ret = remote_put_set(conn, set);
+	if (ret < 0)
+		goto out;
+
+	ret = remote_call(set->db, conn, REMOTE_OP_CONE);
+	if (ret < 0)
+		goto out;
+
+	set->count = ret;
+	ret = remote_get_objects(conn, set->table, set->count, &remote->objects);
+	if (ret < 0) {
+		set->count = 0;
+		goto out;
+	}
+
+	/* fetched objects are one contiguous head */
+	set->object_heads[0].objects = remote->objects;
+	set->object_heads[0].count = set->count;
+	set->object_heads[0].index = 0;
+	set->head_count = set->count ? 1 : 0;
+	remote->valid = 1;
+	ret = set->head_count;
+
+out:
+	remote_end(conn);
+	return ret;
+}
+
+/**
+ * \brief Point an array at objects fetched into the set query buffer.
+ *
+ * \param set The remote object set.
+ * \param objects Array of object pointers to fill.
+ * \param count Number of objects.
+ */
+static void remote_point_objects(struct adb_object_set *set,
+								 const struct adb_object *objects[], int count)
+{
+	const char *pos = set->remote->query;
+	int i;
+
+	for (i = 0; i < count; i++)
+		objects[i] =
+			(const struct adb_object *)(pos + i * set->table->object.bytes);
+}
+
+int remote_set_get_knearest(struct adb_object_set *set, double ra, double dec,
+							int k, const struct adb_object *objects[])
+{
+	struct remote_conn *conn;
+	int ret;
+
+	if (k < 0 || k > REMOTE_MAX_NEAREST)
+		return -EINVAL;
+	if (k == 0)
+		return 0;
+
+	conn = remote_begin(set->db);
+	ret = remote_buf_put_int(&conn->req, set->table->remote_id);
+	ret |= remote_buf_put_double(&conn->req, ra);
+	ret |= remote_buf_put_double(&conn->req, dec);
+	ret |= remote_buf_put_int(&conn->req, k);
+	if (ret < 0) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = remote_call(set->db, conn, REMOTE_OP_KNEAREST);
+	if (ret < 0)
+		goto out;
+	if (ret > k) {
+		ret = -EPROTO;
+		goto out;
+	}
+
+	if (remote_get_objects(conn, set->table, ret, &set->remote->query) < 0)
+		ret = -EPROTO;
+	else
+		remote_point_objects(set, objects, ret);
+
+out:
+	remote_end(conn);
+	return ret;
+}
+
+const struct adb_object *
+remote_set_get_nearest(struct adb_object_set *set, double ra, double dec,
+					   const struct adb_object *exclude)
+{
+	const struct adb_object *objects[2], *nearest = NULL;
+	size_t bytes = set->table->object.bytes;
+	void *copy = NULL;
+	int count, i;
+
+	/* an excluded object is a copy, so it's found by its contents, and it
+	 * may be in the query buffer the nearest objects are fetched into */
+	if (exclude) {
+		copy = malloc(bytes);
+		if (copy == NULL)
+			return NULL;
+		memcpy(copy, exclude, bytes);
+	}
+
+	count = remote_set_get_knearest(set, ra, dec, copy ? 2 : 1, objects);
+	for (i = 0; i < count && nearest == NULL; i++) {
+		if (copy == NULL || memcmp(objects[i], copy, bytes))
+			nearest = objects[i];
+	}
+
+	free(copy);
+	return nearest;
+}
+
+int remote_set_get_within(struct adb_object_set *set, double ra, double dec,
+						  double radius, const struct adb_object *objects[],
+						  int size)
+{
+	struct remote_conn *conn;
+	int32_t count;
+	int ret;
+
+	if (size < 0 || radius < 0.0)
+		return -EINVAL;
+
+	conn = remote_begin(set->db);
+	ret = remote_buf_put_int(&conn->req, set->table->remote_id);
+	ret |= remote_buf_put_double(&conn->req, ra);
+	ret |= remote_buf_put_double(&conn->req, dec);
+	ret |= remote_buf_put_double(&conn->req, radius);
+	ret |= remote_buf_put_int(&conn->req, size);
+	if (ret < 0) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = remote_call(set->db, conn, REMOTE_OP_WITHIN);
+	if (ret < 0)
+		goto out;
+
+	/* the count within radius may exceed the objects returned */
+	if (remote_buf_get_int(&conn->reply, &count) < 0 || count > size ||
+		remote_get_objects(conn, set->table, count, &set->remote->query) < 0)
+		ret = -EPROTO;
+	else
+		remote_point_objects(set, objects, count);
+
+out:
+	remote_end(conn);
+	return ret;
+}
+
+int remote_set_crossmatch(struct adb_object_set *set, const double ra[],
+						  const double dec[], int n, double radius,
+						  const struct adb_object *out[])
+{
+	const struct adb_object **objects = NULL;
+	struct remote_conn *conn;
+	int32_t count, index;
+	int i, ret;
+
+	if (n < 0 || radius < 0.0)
+		return -EINVAL;
+
+	/* every position goes in one request */
+	conn = remote_begin(set->db);
+	ret = remote_buf_put_int(&conn->req, set->table->remote_id);
+	ret |= remote_buf_put_int(&conn->req, n);
+	ret |= remote_buf_put_double(&conn->req, radius);
+	ret |= remote_buf_put(&conn->req, ra, n * sizeof(double));
+	ret |= remote_buf_put(&conn->req, dec, n * sizeof(double));
+	if (ret < 0) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = remote_call(set->db, conn, REMOTE_OP_XMATCH);
+	if (ret < 0)
+		goto out;
+
+	/* matched object index per position, then the matched objects */
+	conn->reply.pos += n * sizeof(int32_t);
+	if (conn->reply.pos > conn->reply.len ||
+		remote_buf_get_int(&conn->reply, &count) < 0 || count > n ||
+		remote_get_objects(conn, set->table, count, &set->remote->query) < 0) {
+		ret = -EPROTO;
+		goto out;
+	}
+
+	objects = malloc((count ? count : 1) * sizeof(*objects));
+	if (objects == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	remote_point_objects(set, objects, count);
+
+	conn->reply.pos = sizeof(int32_t);
+	for (i = 0; i < n; i++) {
+		remote_buf_get_int(&conn->reply, &index);
+		out[i] = index >= 0 && index < count ? objects[index] : NULL;
+	}
+	free(objects);
+
+out:
+	remote_end(conn);
+	return ret;
+}
+
+int remote_search_add_operator(struct remote_search *search, int op)
+{
+	int ret;
+
+	ret = remote_buf_put_int(&search->program, REMOTE_TOKEN_OPERATOR);
+	ret |= remote_buf_put_int(&search->program, op);
+	if (ret < 0)
+		return -ENOMEM;
+
+	search->tokens++;
+	return 0;
+}
+
+int remote_search_add_comparator(struct remote_search *search, int comp,
+								 const char *field, const char *value)
+{
+	int ret;
+
+	ret = remote_buf_put_int(&search->program, REMOTE_TOKEN_COMPARATOR);
+	ret |= remote_buf_put_int(&search->program, comp);
+	ret |= remote_buf_put_str(&search->program, field);
+	ret |= remote_buf_put_str(&search->program, value);
+	if (ret < 0)
+		return -ENOMEM;
+
+	search->tokens++;
+	return 0;
+}
+
+int remote_search_get_results(struct remote_search *search,
+							  struct adb_object_set *set, int limit,
+							  int limit_type, int *tests)
+{
+	struct remote_conn *conn;
+	int32_t count;
+	int ret;
+
+	/* the daemon rebuilds the search from its program */
+	conn = remote_begin(set->db);
+	ret = remote_put_set(conn, set);
+	ret |= remote_buf_put_int(&conn->req, limit);
+	ret |= remote_buf_put_int(&conn->req, limit_type);
+	ret |= remote_buf_put_int(&conn->req, search->tokens);
+	ret |= remote_buf_put(&conn->req, search->program.data,
+						  search->program.len);
+	if (ret < 0) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = remote_call(set->db, conn, REMOTE_OP_SEARCH);
+	if (ret < 0)
+		goto out;
+
+	if (remote_buf_get_int(&conn->reply, &count) < 0 ||
+		remote_get_objects(conn, set->table, ret, &search->objects) < 0)
+		ret = -EPROTO;
+	else
+		*tests = count;
+
+out:
+	remote_end(conn);
+	return ret;
+}
+
+void remote_search_free(struct remote_search *search)
+{
+	if (search == NULL)
+		return;
+
+	remote_buf_free(&search->program);
+	free(search->objects);
+	free(search);
+}
@@ -0,0 +1,194 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#ifndef __ADB_REMOTE_H
+#define __ADB_REMOTE_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*! \defgroup remote Remote
+ *
+ * \brief Query daemon protocol shared by the server and remote databases.
+ *
+ * Each request and reply is a fixed header followed by a packed payload in
+ * host byte order, the daemon socket only ever being local. Clients may
+ * write many requests before reading and the server replies to each in
+ * order. Every reply payload starts with an int32 status, the result of
+ * the request or a negative error code.
+ */
+
+#define REMOTE_MAGIC 0x41444201 /* "ADB" and protocol version 1 */
+#define REMOTE_MAX_PAYLOAD (256 << 20) /* largest request or reply payload */
+#define REMOTE_MAX_KEY 256 /* largest object lookup key in bytes */
+#define REMOTE_MAX_NEAREST 65536 /* most objects for one nearest request */
+
+struct adb_db;
+struct adb_object;
+struct adb_object_set;
+struct adb_table;
+
+/*! \enum remote_op
+ * \brief Request operations.
+ * \ingroup remote
+ */
+enum remote_op {
+	REMOTE_OP_OPEN = 1, /*!< open or share a table, reply has its schema */
+	REMOTE_OP_HASH_KEY, /*!< hash a table key */
+	REMOTE_OP_GET_OBJECT, /*!< get an object by hashed key */
+	REMOTE_OP_CONE, /*!< get the objects in a set */
+	REMOTE_OP_KNEAREST, /*!< get the k objects nearest a position */
+	REMOTE_OP_WITHIN, /*!< get the objects within a radius */
+	REMOTE_OP_XMATCH, /*!< match a batch of positions */
+	REMOTE_OP_SEARCH, /*!< search the objects in a set */
+};
+
+/*! \enum remote_token
+ * \brief Search program tokens, in the order they were added.
+ * \ingroup remote
+ */
+enum remote_token {
+	REMOTE_TOKEN_OPERATOR, /*!< int32 operator */
+	REMOTE_TOKEN_COMPARATOR, /*!< int32 comparator, field and value */
+};
+
+/*! \struct remote_hdr
+ * \brief Request and reply header.
+ * \ingroup remote
+ */
+struct remote_hdr {
+	uint32_t magic; /*!< REMOTE_MAGIC */
+	uint32_t op; /*!< enum remote_op */
+	uint32_t tag; /*!< request sequence, echoed by the reply */
+	uint32_t size; /*!< payload bytes following the header */
+};
+
+/*! \struct remote_buf
+ * \brief Growable payload buffer with a read position.
+ * \ingroup remote
+ */
+struct remote_buf {
+	char *data;
+	size_t size; /*!< allocated bytes */
+	size_t len; /*!< bytes written */
+	size_t pos; /*!< next byte to read */
+};
+
+/*! \struct remote_conn
+ * \brief Remote database connection to the query daemon.
+ * \ingroup remote
+ */
+struct remote_conn {
+	int fd; /*!< connected daemon socket */
+	uint32_t tag; /*!< last request tag */
+	pthread_mutex_t mutex; /*!< one request and reply at a time */
+	struct remote_buf req; /*!< request being built */
+	struct remote_buf reply; /*!< last reply payload */
+};
+
+/*! \struct remote_set
+ * \brief Constraints and fetched objects of a remote object set.
+ * \ingroup remote
+ */
+struct remote_set {
+	int all; /*!< no constraints, the whole table */
+	int valid; /*!< objects fetched for the constraints */
+	double ra, dec, fov, start, end; /*!< cone constraints */
+	void *objects; /*!< set objects */
+	void *query; /*!< objects from the last nearest or match query */
+};
+
+/*! \struct remote_search
+ * \brief Search program and results of a remote search.
+ * \ingroup remote
+ */
+struct remote_search {
+	struct remote_buf program; /*!< tokens added to the search */
+	int tokens; /*!< number of tokens */
+	void *objects; /*!< result objects */
+};
+
+/*
+ * Payload buffers. Puts return -ENOMEM and gets return -EPROTO when the
+ * payload is too short.
+ */
+int remote_buf_put(struct remote_buf *buf, const void *data, size_t bytes);
+int remote_buf_put_int(struct remote_buf *buf, int32_t val);
+int remote_buf_put_double(struct remote_buf *buf, double val);
+int remote_buf_put_str(struct remote_buf *buf, const char *str);
+int remote_buf_get(struct remote_buf *buf, void *data, size_t bytes);
+int remote_buf_get_int(struct remote_buf *buf, int32_t *val);
+int remote_buf_get_double(struct remote_buf *buf, double *val);
+const char *remote_buf_get_str(struct remote_buf *buf);
+const void *remote_buf_get_data(struct remote_buf *buf, size_t bytes);
+void remote_buf_free(struct remote_buf *buf);
+
+/*
+ * Requests. remote_begin() takes the connection and clears its request
+ * payload, remote_call() sends it and reads the reply payload returning its
+ * status, and remote_end() releases the connection.
+ */
+struct remote_conn *remote_begin(struct adb_db *db);
+int remote_call(struct adb_db *db, struct remote_conn *conn,
+				enum remote_op op);
+void remote_end(struct remote_conn *conn);
+int remote_get_objects(struct remote_conn *conn, struct adb_table *table,
+					   int count, void **objects);
+
+/*
+ * Remote database backend, called by the table, set and search entry
+ * points when the database is connected to a query daemon.
+ */
+void remote_db_free(struct adb_db *db);
+int remote_table_open(struct adb_db *db, struct adb_table *table,
+					  const char *table_name);
+void remote_table_close(struct adb_table *table);
+int remote_table_hash_key(struct adb_db *db, struct adb_table *table,
+						  const char *key);
+int remote_table_get_object(struct adb_db *db, struct adb_table *table,
+							const void *id, const char *field,
+							const struct adb_object **object);
+int remote_set_new(struct adb_object_set *set);
+void remote_set_free(struct adb_object_set *set);
+int remote_set_constraints(struct adb_object_set *set, double ra, double dec,
+						   double fov, double start, double end);
+int remote_set_get_objects(struct adb_object_set *set);
+const struct adb_object *
+remote_set_get_nearest(struct adb_object_set *set, double ra, double dec,
+					   const struct adb_object *exclude);
+int remote_set_get_knearest(struct adb_object_set *set, double ra, double dec,
+							int k, const struct adb_object *objects[]);
+int remote_set_get_within(struct adb_object_set *set, double ra, double dec,
+						  double radius, const struct adb_object *objects[],
+						  int size);
+int remote_set_crossmatch(struct adb_object_set *set, const double ra[],
+						  const double dec[], int n, double radius,
+						  const struct adb_object *out[]);
+int remote_search_add_operator(struct remote_search *search, int op);
+int remote_search_add_comparator(struct remote_search *search, int comp,
+								 const char *field, const char *value);
+int remote_search_get_results(struct remote_search *search,
+							  struct adb_object_set *set, int limit,
+							  int limit_type, int *tests);
+void remote_search_free(struct remote_search *search);
+
+#endif
+#endif
@@ -468,6 +468,47 @@ out:
 	return ret;
 }
 
+/**
+ * \brief Read and check a schema file header.
+ *
+ * Fills the table file index and depth map from the header.
+ *
+ * \param db Database catalog to log against
+ * \param table Table the schema belongs to
+ * \param f Schema file at its start
+ * \param file Schema file name
+ * \return 0 on success, or -EIO
+ */
+static int schema_read_hdr(struct adb_db *db, struct adb_table *table, FILE *f,
+						   const char *file)
+{
+	struct table_file_index *hdr = &table->file_index;
+	size_t size;
+	int i;
+
+	/* read schema header */
+	size = fread((char *)hdr, sizeof(struct table_file_index), 1, f);
+	if (size == 0) {
+		adb_error(db, "Error failed to read schema %s header\n", file);
+		return -EIO;
+	}
+
+	if (hdr->catalog_magic != ADB_IDX_VERSION) {
+		adb_error(db, "Error schema %s is version %d need %d\n", file,
+				  hdr->catalog_magic, ADB_IDX_VERSION);
+		return -EIO;
+	}
+
+	for (i = 0; i <= db->htm->depth; i++) {
+		table->depth_map[i].min_value = hdr->depth[i].min;
+		table->depth_map[i].max_value = hdr->depth[i].max;
+		adb_info(db, ADB_LOG_CDS_SCHEMA, "depth level %d min %f max %f\n", i,
+				 table->depth_map[i].min_value, table->depth_map[i].max_value);
+	}
+
+	return 0;
+}
+
 /**
  * \brief Load a dataset header and schema from disk.
  *
@@ -485,7 +526,7 @@ int schema_read(struct adb_db *db, struct adb_table *table)
 	FILE *f;
 	size_t size;
 	char file[128];
-	int ret = 0, i;
+	int ret = 0;
 
 	sprintf(file, "%s%s%s", table->path.local, table->path.file, ".schema");
 	adb_info(db, ADB_LOG_CDS_SCHEMA, "Reading schema from %s\n", file);
@@ -497,20 +538,9 @@ int schema_read(struct adb_db *db, struct adb_table *table)
 		return -EIO;
 	}
 
-	/* read schema header */
-	size = fread((char *)hdr, sizeof(struct table_file_index), 1, f);
-	if (size == 0) {
-		adb_error(db, "Error failed to read schema %s header\n", file);
-		ret = -EIO;
+	ret = schema_read_hdr(db, table, f, file);
+	if (ret < 0)
 		goto out;
-	}
-
-	if (hdr->catalog_magic != ADB_IDX_VERSION) {
-		adb_error(db, "Error schema %s is version %d need %d\n", file,
-				  hdr->catalog_magic, ADB_IDX_VERSION);
-		ret = -EIO;
-		goto out;
-	}
 
 	/* read schema row descriptors */
 	size = fread((char *)table->import.field, sizeof(struct adb_schema_field),
@@ -526,13 +556,6 @@ int schema_read(struct adb_db *db, struct adb_table *table)
 	table->object.count = hdr->object_count;
 	table->kd_root = hdr->kd_root;
 
-	for (i = 0; i <= db->htm->depth; i++) {
-		table->depth_map[i].min_value = hdr->depth[i].min;
-		table->depth_map[i].max_value = hdr->depth[i].max;
-		adb_info(db, ADB_LOG_CDS_SCHEMA, "depth level %d min %f max %f\n", i,
-				 table->depth_map[i].min_value, table->depth_map[i].max_value);
-	}
-
 	if (table->object.count == 0) {
 		adb_error(db, "no objects in table %s\n", file);
 		ret = -EINVAL;
@@ -542,3 +565,55 @@ out:
 	fclose(f);
 	return ret;
 }
+
+/**
+ * \brief Load the index of an imported table for an update.
+ *
+ * Reads only the schema header, the fields stay as they were imported for
+ * the update. The header must match the object size and field count of
+ * the table.
+ *
+ * \param db Database catalog to log against
+ * \param table Table being updated, with its import schema
+ * \return 0 on success, or a negative error code on failure (-EIO or -EINVAL)
+ */
+int schema_read_index(struct adb_db *db, struct adb_table *table)
+{
+	struct table_file_index *hdr = &table->file_index;
+	char file[128];
+	FILE *f;
+	int ret;
+
+	sprintf(file, "%s%s%s", table->path.local, table->path.file, ".schema");
+	adb_info(db, ADB_LOG_CDS_SCHEMA, "Reading schema index from %s\n", file);
+
+	f = fopen(file, "r");
+	if (f == NULL) {
+		adb_error(db, "Error can't open schema file %s for reading\n", file);
+		return -EIO;
+	}
+
+	ret = schema_read_hdr(db, table, f, file);
+	fclose(f);
+	if (ret < 0)
+		return ret;
+
+	if (hdr->object_bytes != table->object.bytes ||
+		hdr->field_count !=
+			table->object.field_count + table->object.num_alt_fields) {
+		adb_error(db, "Error schema %s has %d fields of %d bytes, "
+				  "table has %d fields of %d bytes\n", file,
+				  hdr->field_count, hdr->object_bytes,
+				  table->object.field_count + table->object.num_alt_fields,
+				  table->object.bytes);
+		return -EINVAL;
+	}
+
+	if (hdr->object_count <= 0) {
+		adb_error(db, "no objects in table %s\n", file);
+		return -EINVAL;
+	}
+
+	table->object.count = hdr->object_count;
+	return 0;
+}
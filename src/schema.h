@@ -157,6 +157,19 @@ int schema_write(struct adb_db *db, struct adb_table *table);
  */
 int schema_read(struct adb_db *db, struct adb_table *table);
 
+/*!
+ * \brief Read the index of an imported table for an update.
+ * \ingroup schema
+ *
+ * Loads the depth map, histogram and object count from the schema header
+ * and checks it matches the import schema of the table.
+ *
+ * \param db Database instance
+ * \param table Database table being updated
+ * \return 0 on success, negative error code on failure
+ */
+int schema_read_index(struct adb_db *db, struct adb_table *table);
+
 #endif
 
 #endif
@@ -17,11 +17,14 @@
  */
 
 #include <errno.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "debug.h"
+#include "lib.h"
 #include "readme.h"
+#include "remote.h"
 #include "table.h"
 #include "libastrodb/db.h"
 #include "libastrodb/object.h"
@@ -32,6 +35,7 @@
 #define ADB_SRCH_PARAM_COMP 1
 #define ADB_SRCH_OP_OP 0
 #define ADB_SRCH_OP_COMP 1
+#define ADB_SRCH_OP_TEST 2
 
 #define ADB_SRCH_MAX_BRANCH_TESTS 32
 
@@ -41,7 +45,8 @@
  *
  * Implements a Reverse Polish Notation (RPN) evaluation engine to process 
  * complex, nested queries with logical operators (AND, OR) and comparators
- * over catalog metrics.
+ * over catalog metrics. The RPN tree is compiled into a flat short circuit
+ * plan of field tests before objects are searched.
  */
 
 /*! \struct adb_search_branch
@@ -49,6 +54,11 @@
  */
 struct adb_search_branch;
 
+/*! \struct search_plan
+ * \brief Compiled search plan
+ */
+struct search_plan;
+
 /*! \struct adb_search
  * \ingroup search
  * \brief Search object
@@ -63,409 +73,875 @@ struct adb_search {
 	struct adb_search_branch *root; /*!< root search test */
 
 	struct adb_search_branch
-		*branch_orphan[ADB_SRCH_MAX_BRANCH_TESTS]; /*!< orphaned operator_t
+		*branch_orphan[ADB_SRCH_MAX_BRANCH_TESTS]; /*!< orphaned operator
                                                     children */
 	int branch_orphan_count; /*!< branch orphan count */
 
 	struct adb_search_branch
-		*test_orphan[ADB_SRCH_MAX_BRANCH_TESTS]; /*!< orphaned comparator_t
+		*test_orphan[ADB_SRCH_MAX_BRANCH_TESTS]; /*!< orphaned comparator
                                                   children */
 	int test_orphan_count; /*!< test orphan count */
 
 	struct adb_search_branch *start_branch; /*!< start branch */
 	int search_test_count; /*!< number of search nodes */
 
+	struct search_plan *plan; /*!< compiled on first results, or NULL */
+
+	int objects_size; /*!< allocated search result objects */
+	int limit; /*!< result limit, 0 for all hits */
+	enum adb_search_limit limit_type; /*!< hits kept under the limit */
+
+	/* result cursor */
+	struct adb_object_set *iter_set; /*!< set being iterated */
+	int iter_head; /*!< next object head */
+	int iter_pos; /*!< next object in head, or next brightest result */
+
 	const struct adb_object **objects; /*!< search result objects */
+
+	struct remote_search *remote; /*!< program for remote databases */
 };
 
-/* compares <data> with <value> using <comparator_t> */
-typedef int (*comparator_t)(void *data, void *value);
+/* search plan test outcomes, instruction indices are >= 0 */
+#define ADB_SRCH_PLAN_MISS -1
+#define ADB_SRCH_PLAN_HIT -2
 
-/* operation on  nodes / lists */
-typedef int (*operator_t)(const struct adb_object *object,
-						  struct adb_search_branch *, int num);
+/* objects sampled to estimate test selectivity */
+#define ADB_SRCH_PLAN_SAMPLE 512
+
+/* smallest object set searched in parallel */
+#define ADB_SRCH_PARALLEL_MIN 4096
+
+/* range index scans must test this many times fewer objects than the set */
+#define ADB_SRCH_RANGE_RATIO 4
+
+/* relative cost of numeric and string tests */
+#define ADB_SRCH_COST_NUMERIC 1.0f
+#define ADB_SRCH_COST_STRING 4.0f
+
+/*! \enum search_kind
+ * \ingroup search
+ * \brief Field test type and comparison.
+ */
+enum search_kind {
+	SEARCH_INT_LT,
+	SEARCH_INT_GT,
+	SEARCH_INT_EQ,
+	SEARCH_INT_NE,
+	SEARCH_FLOAT_LT,
+	SEARCH_FLOAT_GT,
+	SEARCH_FLOAT_EQ,
+	SEARCH_FLOAT_NE,
+	SEARCH_DOUBLE_LT,
+	SEARCH_DOUBLE_GT,
+	SEARCH_DOUBLE_EQ,
+	SEARCH_DOUBLE_NE,
+	SEARCH_STRING_LT,
+	SEARCH_STRING_GT,
+	SEARCH_STRING_EQ,
+	SEARCH_STRING_NE,
+	SEARCH_STRING_PREFIX, /*!< wildcard "prefix*" match */
+};
+
+/*! \struct search_test
+ * \ingroup search
+ * \brief Single field test, also a search plan instruction.
+ */
+struct search_test {
+	enum search_kind kind; /*!< test type and comparison */
+	int offset; /*!< field offset in object */
+	union {
+		int i;
+		float f;
+		double d;
+		const char *s;
+	} value; /*!< value compared with the field */
+	int len; /*!< prefix length for wildcard matches */
+	int next[2]; /*!< next instruction on miss [0] and hit [1] */
+};
+
+/*! \struct search_plan
+ * \ingroup search
+ * \brief Search tree flattened into short circuit test instructions.
+ */
+struct search_plan {
+	struct search_test *test; /*!< instructions */
+	int count; /*!< number of instructions */
+	int entry; /*!< first instruction */
+};
 
 struct adb_search_branch {
-	comparator_t compare; /*!< comparator_t func */
-	int offset; /*!< data offset */
-	void *value; /*!< value */
+	struct search_test test; /*!< field test for test branches */
+	char *string; /*!< owned string test value */
 
-	operator_t operator; /*!< operator_t on list */
+	enum adb_operator op; /*!< operator on list */
 	unsigned int type; /*!< type */
 
 	struct adb_search_branch *branch[ADB_SRCH_MAX_BRANCH_TESTS]; /*!< branches */
 	int test_count; /*!< test count */
+
+	float pass; /*!< estimated fraction of objects passing */
+	float cost; /*!< estimated cost to evaluate */
 };
 
 /**
- * \brief Internal comparator for less-than logic on integer types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data < value, 0 otherwise.
+ * \brief Evaluate a single field test against an object.
+ * \param test Field test.
+ * \param object Object to test.
+ * \return 1 if the object passes the test, 0 otherwise.
  */
-static int int_lt_comp(void *data, void *value)
+static inline int search_test(const struct search_test *test,
+							  const char *object)
 {
-	return *(int *)data < *(int *)value;
+	const void *data = object + test->offset;
+
+	switch (test->kind) {
+	case SEARCH_INT_LT:
+		return *(const int *)data < test->value.i;
+	case SEARCH_INT_GT:
+		return *(const int *)data > test->value.i;
+	case SEARCH_INT_EQ:
+		return *(const int *)data == test->value.i;
+	case SEARCH_INT_NE:
+		return *(const int *)data != test->value.i;
+	case SEARCH_FLOAT_LT:
+		return *(const float *)data < test->value.f;
+	case SEARCH_FLOAT_GT:
+		return *(const float *)data > test->value.f;
+	case SEARCH_FLOAT_EQ:
+		return *(const float *)data == test->value.f;
+	case SEARCH_FLOAT_NE:
+		return *(const float *)data != test->value.f;
+	case SEARCH_DOUBLE_LT:
+		return *(const double *)data < test->value.d;
+	case SEARCH_DOUBLE_GT:
+		return *(const double *)data > test->value.d;
+	case SEARCH_DOUBLE_EQ:
+		return *(const double *)data == test->value.d;
+	case SEARCH_DOUBLE_NE:
+		return *(const double *)data != test->value.d;
+	case SEARCH_STRING_LT:
+		return strcmp(data, test->value.s) > 0;
+	case SEARCH_STRING_GT:
+		return strcmp(data, test->value.s) < 0;
+	case SEARCH_STRING_EQ:
+		return !strcmp(data, test->value.s);
+	case SEARCH_STRING_NE:
+		return strcmp(data, test->value.s) != 0;
+	case SEARCH_STRING_PREFIX:
+		return !strncmp(data, test->value.s, test->len);
+	}
+	return 0;
 }
 
 /**
- * \brief Internal comparator for greater-than logic on integer types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data > value, 0 otherwise.
+ * \brief Run the search plan against an object.
+ *
+ * Each instruction names the next instruction for either outcome, so AND
+ * and OR lists stop at their first deciding test.
+ *
+ * \param plan Compiled search plan.
+ * \param object Object to test.
+ * \return 1 if the object matches the search, 0 otherwise.
  */
-static int int_gt_comp(void *data, void *value)
+static inline int search_plan_check(const struct search_plan *plan,
+									const char *object)
 {
-	return *(int *)data > *(int *)value;
-}
+	const struct search_test *test;
+	int pc = plan->entry;
 
-/**
- * \brief Internal comparator for equality logic on integer types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data == value, 0 otherwise.
- */
-static int int_eq_comp(void *data, void *value)
-{
-	return *(int *)data == *(int *)value;
-}
+	while (pc >= 0) {
+		test = &plan->test[pc];
+		pc = test->next[search_test(test, object)];
+	}
 
-/**
- * \brief Internal comparator for strict inequality logic on integer types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data != value, 0 otherwise.
- */
-static int int_ne_comp(void *data, void *value)
-{
-	return *(int *)data != *(int *)value;
+	return pc == ADB_SRCH_PLAN_HIT;
 }
 
 /**
- * \brief Internal comparator for less-than logic on float types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data < value, 0 otherwise.
+ * \brief Get the field test type for a comparator and field C type.
+ *
+ * \param comp Comparator (e.g. `ADB_COMP_LT`).
+ * \param ctype Field C type.
+ * \return Field test type, or -EINVAL for unsupported combinations.
  */
-static int float_lt_comp(void *data, void *value)
+static int get_test_kind(enum adb_comparator comp, adb_ctype ctype)
 {
-	return *(float *)data < *(float *)value;
+	switch (ctype) {
+	case ADB_CTYPE_INT:
+	case ADB_CTYPE_SHORT:
+		return SEARCH_INT_LT + comp;
+	case ADB_CTYPE_FLOAT:
+		return SEARCH_FLOAT_LT + comp;
+	case ADB_CTYPE_DEGREES:
+	case ADB_CTYPE_DOUBLE:
+		return SEARCH_DOUBLE_LT + comp;
+	case ADB_CTYPE_STRING:
+		return SEARCH_STRING_LT + comp;
+	case ADB_CTYPE_DOUBLE_DMS_DEGS:
+	case ADB_CTYPE_DOUBLE_DMS_MINS:
+	case ADB_CTYPE_DOUBLE_DMS_SECS:
+	case ADB_CTYPE_DOUBLE_HMS_HRS:
+	case ADB_CTYPE_DOUBLE_HMS_MINS:
+	case ADB_CTYPE_DOUBLE_HMS_SECS:
+	case ADB_CTYPE_SIGN:
+	case ADB_CTYPE_NULL:
+	case ADB_CTYPE_DOUBLE_MPC:
+		return -EINVAL;
+	}
+	return -EINVAL;
 }
 
 /**
- * \brief Internal comparator for greater-than logic on float types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data > value, 0 otherwise.
+ * \brief Estimate how selective and costly a search branch is.
+ *
+ * Field tests are run on sampled objects. Operator children are then sorted
+ * so AND lists run the tests most likely to fail cheaply first and OR lists
+ * the tests most likely to pass cheaply first. Reordering never changes the
+ * search result, only the number of tests needed to decide it.
+ *
+ * \param branch Search branch.
+ * \param sample Sampled objects.
+ * \param count Number of sampled objects.
  */
-static int float_gt_comp(void *data, void *value)
+static void branch_estimate(struct adb_search_branch *branch,
+							const char **sample, int count)
 {
-	return *(float *)data > *(float *)value;
-}
+	struct adb_search_branch *child;
+	float pass, key, best;
+	int i, j, k, hits = 0;
+
+	if (branch->type == ADB_SRCH_OP_TEST) {
+		for (i = 0; i < count; i++)
+			hits += search_test(&branch->test, sample[i]);
+
+		/* smoothed so untested branches are not certain */
+		branch->pass = (hits + 1.0f) / (count + 2.0f);
+		branch->cost = branch->test.kind >= SEARCH_STRING_LT ?
+						   ADB_SRCH_COST_STRING :
+						   ADB_SRCH_COST_NUMERIC;
+		return;
+	}
 
-/**
- * \brief Internal comparator for equality logic on float types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data == value, 0 otherwise.
- */
-static int float_eq_comp(void *data, void *value)
-{
-	return *(float *)data == *(float *)value;
+	for (i = 0; i < branch->test_count; i++)
+		branch_estimate(branch->branch[i], sample, count);
+
+	/* selection sort on cost per deciding outcome, lists are short */
+	for (i = 0; i < branch->test_count; i++) {
+		best = 0.0f;
+		k = i;
+		for (j = i; j < branch->test_count; j++) {
+			child = branch->branch[j];
+			pass = branch->op == ADB_OP_AND ? 1.0f - child->pass : child->pass;
+			key = child->cost / pass;
+			if (j == i || key < best) {
+				best = key;
+				k = j;
+			}
+		}
+		child = branch->branch[k];
+		branch->branch[k] = branch->branch[i];
+		branch->branch[i] = child;
+	}
+
+	/* expected cost of the ordered list, assuming independent tests */
+	branch->cost = 0.0f;
+	pass = 1.0f;
+	for (i = 0; i < branch->test_count; i++) {
+		child = branch->branch[i];
+		if (branch->op == ADB_OP_AND) {
+			branch->cost += pass * child->cost;
+			pass *= child->pass;
+		} else {
+			branch->cost += pass * child->cost;
+			pass *= 1.0f - child->pass;
+		}
+	}
+	branch->pass = branch->op == ADB_OP_AND ? pass : 1.0f - pass;
 }
 
 /**
- * \brief Internal comparator for inequality logic on float types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data != value, 0 otherwise.
+ * \brief Count the field tests below a search branch.
+ *
+ * \param branch Search branch.
+ * \return Number of field tests.
  */
-static int float_ne_comp(void *data, void *value)
+static int branch_count_tests(const struct adb_search_branch *branch)
 {
-	return *(float *)data != *(float *)value;
+	int i, count = 0;
+
+	if (branch->type == ADB_SRCH_OP_TEST)
+		return 1;
+
+	for (i = 0; i < branch->test_count; i++)
+		count += branch_count_tests(branch->branch[i]);
+	return count;
 }
 
 /**
- * \brief Internal comparator for less-than logic on double types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data < value, 0 otherwise.
+ * \brief Emit the instructions of a search branch.
+ *
+ * Instructions are emitted backwards from the end of the plan so the
+ * targets of each test are known when it is emitted.
+ *
+ * \param plan Search plan being emitted.
+ * \param branch Search branch.
+ * \param hit Instruction to run when the branch matches.
+ * \param miss Instruction to run when the branch does not match.
+ * \param pos Next free instruction from the end, updated.
+ * \return First instruction of the branch.
  */
-static int double_lt_comp(void *data, void *value)
+static int branch_emit(struct search_plan *plan,
+					   const struct adb_search_branch *branch, int hit,
+					   int miss, int *pos)
 {
-	return *(double *)data < *(double *)value;
+	struct search_test *test;
+	int i, entry;
+
+	if (branch->type == ADB_SRCH_OP_TEST) {
+		test = &plan->test[--(*pos)];
+		*test = branch->test;
+		test->next[0] = miss;
+		test->next[1] = hit;
+		return *pos;
+	}
+
+	/* an empty list never matches */
+	if (branch->test_count == 0)
+		return miss;
+
+	/* AND children continue on a hit, OR children on a miss */
+	entry = branch->op == ADB_OP_AND ? hit : miss;
+	for (i = branch->test_count - 1; i >= 0; i--) {
+		if (branch->op == ADB_OP_AND)
+			entry = branch_emit(plan, branch->branch[i], entry, miss, pos);
+		else
+			entry = branch_emit(plan, branch->branch[i], hit, entry, pos);
+	}
+
+	return entry;
 }
 
 /**
- * \brief Internal comparator for greater-than logic on double types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data > value, 0 otherwise.
+ * \brief Compile the search tree into a search plan.
+ *
+ * \param search Search with a balanced search tree.
+ * \param set Object set used to sample test selectivity.
+ * \return 0 on success or -ENOMEM.
  */
-static int double_gt_comp(void *data, void *value)
+static int search_plan_compile(struct adb_search *search,
+							   struct adb_object_set *set)
 {
-	return *(double *)data > *(double *)value;
+	struct search_plan *plan;
+	const char **sample;
+	int i, j, step, count = 0, pos;
+
+	sample = calloc(ADB_SRCH_PLAN_SAMPLE, sizeof(*sample));
+	if (sample == NULL)
+		return -ENOMEM;
+
+	/* sample objects evenly across the set */
+	step = set->count / ADB_SRCH_PLAN_SAMPLE + 1;
+	for (i = 0, pos = 0; i < set->head_count; i++) {
+		const struct adb_object_head *head = &set->object_heads[i];
+
+		for (j = pos; j < (int)head->count && count < ADB_SRCH_PLAN_SAMPLE;
+			 j += step)
+			sample[count++] = (const char *)head->objects +
+							  (size_t)j * search->table->object.bytes;
+		pos = j - head->count;
+	}
+
+	branch_estimate(search->start_branch, sample, count);
+	free(sample);
+
+	plan = calloc(1, sizeof(*plan));
+	if (plan == NULL)
+		return -ENOMEM;
+
+	plan->count = branch_count_tests(search->start_branch);
+	plan->test = calloc(plan->count, sizeof(*plan->test));
+	if (plan->test == NULL) {
+		free(plan);
+		return -ENOMEM;
+	}
+
+	pos = plan->count;
+	plan->entry = branch_emit(plan, search->start_branch, ADB_SRCH_PLAN_HIT,
+							  ADB_SRCH_PLAN_MISS, &pos);
+
+	adb_info(search->db, ADB_LOG_SEARCH,
+			 "compiled search plan with %d tests, expected cost %3.3f "
+			 "pass %3.3f from %d samples\n",
+			 plan->count, search->start_branch->cost,
+			 search->start_branch->pass, count);
+
+	search->plan = plan;
+	return 0;
 }
 
 /**
- * \brief Internal comparator for equality logic on double types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data == value, 0 otherwise.
+ * \brief Free the compiled search plan.
+ *
+ * \param search Search with a compiled plan.
  */
-static int double_eq_comp(void *data, void *value)
+static void search_plan_free(struct adb_search *search)
 {
-	return *(double *)data == *(double *)value;
+	/* a changed search ends any iteration */
+	search->iter_set = NULL;
+
+	if (search->plan == NULL)
+		return;
+
+	free(search->plan->test);
+	free(search->plan);
+	search->plan = NULL;
 }
 
 /**
- * \brief Internal comparator for inequality logic on double types.
- * \param data Pointer to the source data field.
- * \param value Pointer to the target value to compare against.
- * \return 1 if data != value, 0 otherwise.
+ * \brief Search the objects of one object head.
+ *
+ * \param search Search with a compiled plan.
+ * \param head Object head to search.
+ * \param hits Output matching objects, head count long.
+ * \param max Stop after this many matching objects.
+ * \param tests Number of objects tested, updated.
+ * \return Number of matching objects.
  */
-static int double_ne_comp(void *data, void *value)
+static int search_head(struct adb_search *search,
+					   const struct adb_object_head *head,
+					   const struct adb_object **hits, int max, int *tests)
 {
-	return *(double *)data != *(double *)value;
+	const char *object = head->objects;
+	int bytes = search->table->object.bytes, count = 0;
+	unsigned int j;
+
+	for (j = 0; j < head->count && count < max; j++, object += bytes) {
+		if (search_plan_check(search->plan, object))
+			hits[count++] = (const struct adb_object *)object;
+	}
+
+	*tests += j;
+	return count;
 }
 
-/**
- * \brief Internal comparator for alphabetical less-than (precedes) logic on strings.
- * \param data Pointer to the source data field string.
- * \param value Pointer to the target value string to compare against.
- * \return 1 if data precedes value, 0 otherwise.
+/*! \struct search_top
+ * \ingroup search
+ * \brief Brightest search hit candidate.
  */
-static int string_lt_comp(void *data, void *value)
+struct search_top {
+	const struct adb_object *object; /*!< matching object */
+	int seq; /*!< hit order, breaks magnitude ties */
+};
+
+/* candidate a ranks below candidate b */
+static inline int top_below(const struct search_top *a,
+							const struct search_top *b)
 {
-	return (strcmp(data, value) > 0);
+	return a->object->mag > b->object->mag ||
+		   (a->object->mag == b->object->mag && a->seq > b->seq);
 }
 
-/**
- * \brief Internal comparator for alphabetical greater-than (follows) logic on strings.
- * \param data Pointer to the source data field string.
- * \param value Pointer to the target value string to compare against.
- * \return 1 if data follows value, 0 otherwise.
- */
-static int string_gt_comp(void *data, void *value)
+static int top_cmp(const void *a, const void *b)
 {
-	return (strcmp(data, value) < 0);
+	return top_below(a, b) ? 1 : -1;
 }
 
-/**
- * \brief Internal comparator for strict string equality.
- * \param data Pointer to the source data field string.
- * \param value Pointer to the target value string to compare against.
- * \return 1 if identically equal, 0 otherwise.
- */
-static int string_eq_comp(void *data, void *value)
+/* restore the heap below the root, faintest candidate at the root */
+static void top_sift_down(struct search_top *top, int count, int i)
 {
-	return !strcmp(data, value);
+	struct search_top tmp;
+	int child;
+
+	while ((child = 2 * i + 1) < count) {
+		if (child + 1 < count && top_below(&top[child + 1], &top[child]))
+			child++;
+		if (!top_below(&top[child], &top[i]))
+			break;
+		tmp = top[i];
+		top[i] = top[child];
+		top[child] = tmp;
+		i = child;
+	}
 }
 
-/**
- * \brief Internal comparator for strict string inequality.
- * \param data Pointer to the source data field string.
- * \param value Pointer to the target value string to compare against.
- * \return 1 if strings are different, 0 if identical.
- */
-static int string_ne_comp(void *data, void *value)
+static void top_sift_up(struct search_top *top, int i)
 {
-	return strcmp(data, value);
+	struct search_top tmp;
+	int parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (!top_below(&top[i], &top[parent]))
+			break;
+		tmp = top[i];
+		top[i] = top[parent];
+		top[parent] = tmp;
+		i = parent;
+	}
 }
 
 /**
- * \brief Internal comparator for basic wildcard prefix string matching.
+ * \brief Search for the brightest matching objects.
  *
- * Implements a simple wildcard `*` filter, verifying if the data string 
- * begins with the literal prefix defined before the `*` symbol in the value.
+ * Keeps the brightest hits so far in a heap. Once the heap is full, objects
+ * no brighter than its faintest hit are skipped on their magnitude alone,
+ * read from the table field arrays when available, so the search tests run
+ * mostly on the bright start of each magnitude sorted trixel.
  *
- * \param data Pointer to the source data string evaluated.
- * \param value Pointer to the wildcard value string (e.g. "prefix*").
- * \return 1 if successfully matched the prefix, 0 otherwise.
+ * \param search Search with a compiled plan.
+ * \param set Object set with object heads.
+ * \return Number of results, in ascending magnitude, or -ENOMEM.
  */
-// TODO: implement regcomp
-static int string_eq_wildcard_comp(void *data, void *value)
+static int search_brightest(struct adb_search *search,
+							struct adb_object_set *set)
 {
-	int i = 0;
-	char *ptr = value;
+	const struct table_columns *columns = table_get_columns(search->table);
+	int bytes = search->table->object.bytes, count = 0, seq = 0, i;
+	struct search_top *top;
+	unsigned int j;
+	float mag;
+
+	top = calloc(search->limit, sizeof(*top));
+	if (top == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < set->head_count; i++) {
+		const struct adb_object_head *head = &set->object_heads[i];
+		const char *object = head->objects;
+
+		for (j = 0; j < head->count; j++, object += bytes) {
+			mag = columns ? columns->mag[head->index + j] :
+							((const struct adb_object *)object)->mag;
+
+			/* unranked, or no brighter than the faintest kept hit */
+			if (mag != mag ||
+				(count == search->limit && !(mag < top[0].object->mag)))
+				continue;
 
-	while (*ptr != '*') {
-		i++;
-		ptr++;
+			search->test_count++;
+			if (!search_plan_check(search->plan, object))
+				continue;
+
+			if (count < search->limit) {
+				top[count].object = (const void *)object;
+				top[count].seq = seq++;
+				top_sift_up(top, count++);
+			} else {
+				top[0].object = (const void *)object;
+				top[0].seq = seq++;
+				top_sift_down(top, count, 0);
+			}
+		}
 	}
 
-	return !strncmp(data, value, i);
+	qsort(top, count, sizeof(*top), top_cmp);
+	for (i = 0; i < count; i++)
+		search->objects[i] = top[i].object;
+
+	free(top);
+	return count;
 }
 
-/**
- * \brief Execute an AND condition compiling multiple test components.
- *
- * Iterates descending down the branch's list of registered evaluation leaves, verifying 
- * each one individually against the physical object until a failure breaks the chain recursively.
- *
- * \param object Structural pointer addressing the physical object evaluating logic chains.
- * \param branch Originating parent search execution tree node block.
- * \param num The current index array tracking list evaluations down to zero.
- * \return True (1) if all nodes match passing the logical AND gate, else False (0).
+/*! \struct search_range
+ * \ingroup search
+ * \brief Open range on an indexed field required by the search.
+ */
+struct search_range {
+	const struct range_index *index; /*!< field range index */
+	double min; /*!< field values must be greater */
+	double max; /*!< field values must be less */
+	const char *prefix; /*!< string field values must start with */
+	int len; /*!< prefix length */
+};
+
+/*! \struct search_span
+ * \ingroup search
+ * \brief Table object positions of an object head.
  */
-static int test_AND_comp(const struct adb_object *object,
-						 struct adb_search_branch *branch, int num)
+struct search_span {
+	unsigned int index; /*!< table position of the first object */
+	unsigned int count; /*!< number of objects */
+	int head; /*!< object head in the set */
+};
+
+static int span_cmp(const void *a, const void *b)
 {
-	struct adb_search_branch *test = branch->branch[--num];
-	char *ptr = (char *)object;
+	const struct search_span *sa = a, *sb = b;
+
+	return sa->index < sb->index ? -1 : sa->index > sb->index;
+}
 
-	if (num > 0)
-		return test->compare(ptr + test->offset, test->value) &&
-			   test_AND_comp(object, branch, num);
+static int hit_cmp(const void *a, const void *b)
+{
+	const unsigned long long *ha = a, *hb = b;
 
-	/* last one */
-	return test->compare(ptr + test->offset, test->value);
+	return *ha < *hb ? -1 : *ha > *hb;
 }
 
 /**
- * \brief Execute an OR condition validating across multiple test components.
+ * \brief Collect the indexed field ranges every match must be inside.
  *
- * Iterates down the associated test leaves, immediately returning a passing boolean 
- * representing success on the first positive comparative correlation discovered recursively.
+ * Less and greater than tests on range indexed fields are gathered through
+ * AND lists, and through lists of one test, where every test must pass.
+ * Equal and wildcard tests on range indexed string fields give the prefix
+ * the field values must start with, the longest one is kept.
  *
- * \param object Valid pointer addressing individual data rows.
- * \param branch Structural defining associative OR tree hierarchy parameters block.
- * \param num Tracking array bounds identifying specific test evaluations.
- * \return True (1) recognizing a positive path passing the logic OR gate, else False (0).
+ * \param search Search context.
+ * \param branch Search branch.
+ * \param range Ranges found, one per indexed field.
+ * \param count Number of ranges found, updated.
  */
-static int test_OR_comp(const struct adb_object *object,
-						struct adb_search_branch *branch, int num)
+static void branch_ranges(struct adb_search *search,
+						  const struct adb_search_branch *branch,
+						  struct search_range *range, int *count)
 {
-	struct adb_search_branch *test = branch->branch[--num];
-	char *ptr = (char *)object;
+	const struct search_test *test = &branch->test;
+	const struct range_index *index;
+	const char *prefix = NULL;
+	double value = 0.0;
+	int i, lt, len = 0;
+
+	if (branch->type != ADB_SRCH_OP_TEST) {
+		if (branch->op != ADB_OP_AND && branch->test_count != 1)
+			return;
+		for (i = 0; i < branch->test_count; i++)
+			branch_ranges(search, branch->branch[i], range, count);
+		return;
+	}
+
+	switch (test->kind) {
+	case SEARCH_INT_LT:
+	case SEARCH_INT_GT:
+		value = test->value.i;
+		break;
+	case SEARCH_FLOAT_LT:
+	case SEARCH_FLOAT_GT:
+		value = test->value.f;
+		break;
+	case SEARCH_DOUBLE_LT:
+	case SEARCH_DOUBLE_GT:
+		value = test->value.d;
+		break;
+	case SEARCH_STRING_EQ:
+		prefix = test->value.s;
+		len = strlen(prefix);
+		break;
+	case SEARCH_STRING_PREFIX:
+		prefix = test->value.s;
+		len = test->len;
+		break;
+	default:
+		return;
+	}
+	lt = test->kind == SEARCH_INT_LT || test->kind == SEARCH_FLOAT_LT ||
+		 test->kind == SEARCH_DOUBLE_LT;
+
+	index = range_get_index(search->table, test->offset);
+	if (index == NULL || (prefix != NULL) != (index->type == ADB_CTYPE_STRING))
+		return;
 
-	if (num > 0)
-		return test->compare(ptr + test->offset, test->value) ||
-			   test_OR_comp(object, branch, num);
+	for (i = 0; i < *count; i++) {
+		if (range[i].index == index)
+			break;
+	}
 
-	/* last one */
-	return test->compare(ptr + test->offset, test->value);
+	if (i == *count) {
+		if (*count == ADB_MAX_RANGE_INDEXES)
+			return;
+		range[i].index = index;
+		range[i].min = -INFINITY;
+		range[i].max = INFINITY;
+		range[i].prefix = NULL;
+		range[i].len = 0;
+		(*count)++;
+	}
+
+	if (prefix) {
+		if (range[i].prefix == NULL || len > range[i].len) {
+			range[i].prefix = prefix;
+			range[i].len = len;
+		}
+	} else if (lt && value < range[i].max)
+		range[i].max = value;
+	else if (!lt && value > range[i].min)
+		range[i].min = value;
 }
 
 /**
- * \brief Execute a cascading AND logic condition over subordinate operators lists.
+ * \brief Search the set through a field range index.
  *
- * Passes recursion dynamically deeper handling branched associative logic execution trees integrating lists.
+ * The narrowest indexed field range the search requires is scanned and
+ * each object inside it that is also inside the set object heads is tested.
+ * Hits are then put back in object head order, matching a full scan, and
+ * the first max of them are returned.
  *
- * \param object Record structure validating nested conditions dynamically.
- * \param branch Current originating layout branch matrix configuring AND bounds.
- * \param num Remaining operator node count inside operational nested list matrix tracking execution lengths.
- * \return Logic success identifier defining true mapping validity matrices logic.
+ * \param search Search with a compiled plan.
+ * \param set Object set with object heads.
+ * \param max Maximum number of results.
+ * \return Number of matching objects, -ENOENT if no range index is narrow
+ * enough to be worth scanning, or -ENOMEM.
  */
-static int test_AND_oper(const struct adb_object *object,
-						 struct adb_search_branch *branch, int num)
+static int search_range(struct adb_search *search, struct adb_object_set *set,
+						int max)
 {
-	struct adb_search_branch *test = branch->branch[--num];
+	struct search_range range[ADB_MAX_RANGE_INDEXES];
+	const struct range_entry *entry;
+	struct search_span *span;
+	unsigned long long *hit;
+	int i, count = 0, best = -1, start, size, best_start = 0, best_size = 0;
+	int low, high, mid, hits = 0, bytes = search->table->object.bytes;
+	const char *object;
+
+	branch_ranges(search, search->start_branch, range, &count);
+
+	for (i = 0; i < count; i++) {
+		/* strings without a prefix test can not be narrowed */
+		if (range[i].index->type == ADB_CTYPE_STRING) {
+			if (range[i].prefix == NULL)
+				continue;
+			size = range_find_prefix(search->table, range[i].index,
+									 range[i].prefix, range[i].len, &start);
+		} else
+			size = range_find(range[i].index, range[i].min, range[i].max,
+							  &start);
+		if (best < 0 || size < best_size) {
+			best = i;
+			best_start = start;
+			best_size = size;
+		}
+	}
+
+	if (best < 0 || best_size * ADB_SRCH_RANGE_RATIO >= set->count)
+		return -ENOENT;
+
+	adb_debug(search->db, ADB_LOG_SEARCH,
+			  "scanning %d range entries of %s for %d set objects\n",
+			  best_size, range[best].index->key, set->count);
+
+	span = calloc(set->head_count, sizeof(*span));
+	hit = calloc(best_size ? best_size : 1, sizeof(*hit));
+	if (span == NULL || hit == NULL) {
+		free(span);
+		free(hit);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < set->head_count; i++) {
+		span[i].index = set->object_heads[i].index;
+		span[i].count = set->object_heads[i].count;
+		span[i].head = i;
+	}
+	qsort(span, set->head_count, sizeof(*span), span_cmp);
+
+	entry = range[best].index->entry + best_start;
+	for (i = 0; i < best_size; i++) {
+		/* last head starting at or before the entry object */
+		low = 0;
+		high = set->head_count - 1;
+		while (low < high) {
+			mid = (low + high + 1) >> 1;
+			if (span[mid].index <= entry[i].index)
+				low = mid;
+			else
+				high = mid - 1;
+		}
 
-	if (num > 0)
-		return test->operator(object, test, test->test_count) &&
-			   test_AND_oper(object, branch, num);
+		if (span[low].index > entry[i].index ||
+			entry[i].index - span[low].index >= span[low].count)
+			continue;
 
-	/* last one */
-	return test->operator(object, test, test->test_count);
+		search->test_count++;
+		object = (const char *)search->table->objects +
+				 (size_t)entry[i].index * bytes;
+		if (search_plan_check(search->plan, object))
+			hit[hits++] = (unsigned long long)span[low].head << 32 |
+						  (entry[i].index - span[low].index);
+	}
+
+	qsort(hit, hits, sizeof(*hit), hit_cmp);
+	if (hits > max)
+		hits = max;
+	for (i = 0; i < hits; i++)
+		search->objects[i] =
+			(const void *)((const char *)set->object_heads[hit[i] >> 32]
+							   .objects +
+						   (size_t)(hit[i] & 0xffffffff) * bytes);
+
+	free(span);
+	free(hit);
+	return hits;
 }
 
 /**
- * \brief Execute a cascading OR logic condition over child operators dynamically terminating appropriately.
+ * \brief Make room for search results.
  *
- * \param object Target validation item checking nested dependencies recursively tracking states.
- * \param branch Origin nested list executing logic configurations handling OR definitions dynamically.
- * \param num Target length variable decrementing mapping validation paths execution branches correctly.
- * \return State definition Boolean acknowledging logic gate resolution status paths. 
+ * \param search Search context.
+ * \param count Results needed.
+ * \return 0 on success or -ENOMEM.
  */
-static int test_OR_oper(const struct adb_object *object,
-						struct adb_search_branch *branch, int num)
+static int search_results_alloc(struct adb_search *search, int count)
 {
-	struct adb_search_branch *test = branch->branch[--num];
+	const struct adb_object **objects;
+
+	if (count <= search->objects_size)
+		return 0;
 
-	if (num > 0)
-		return test->operator(object, test, test->test_count) ||
-			   test_OR_oper(object, branch, num);
-	/* last one */
-	return test->operator(object, test, test->test_count);
+	objects = realloc(search->objects, count * sizeof(*objects));
+	if (objects == NULL)
+		return -ENOMEM;
+
+	search->objects = objects;
+	search->objects_size = count;
+	return 0;
 }
 
+#if HAVE_OPENMP
 /**
- * \brief Parse combination constants determining an appropriate functional logic check mapping.
+ * \brief Search object heads in parallel.
  *
- * Resolves static internal comparator checking endpoints (e.g `float_lt_comp`) utilizing paired definition types
- * binding target datatypes and logic boundary condition variables natively validating execution rules safely.
+ * Each head writes its hits to the results from its first object position
+ * in the set, which no earlier head can reach. The hits are then packed in
+ * head order, so results match the serial search.
  *
- * \param comp Numeric enumeration representing comparison operators (e.g. `ADB_COMP_LT`). 
- * \param ctype Enum identifying physical schema datatype field blocks.
- * \return Selected validation callback binding functions, returning NULL identifying unknown unsupported bounds safely.
+ * \param search Search with a compiled plan.
+ * \param set Object set with object heads.
+ * \return Number of matching objects or -ENOMEM.
  */
-static comparator_t get_comparator(enum adb_comparator comp, adb_ctype ctype)
+static int search_heads_parallel(struct adb_search *search,
+								 struct adb_object_set *set)
 {
-	switch (ctype) {
-	case ADB_CTYPE_INT:
-	case ADB_CTYPE_SHORT:
-		switch (comp) {
-		case ADB_COMP_LT:
-			return int_lt_comp;
-		case ADB_COMP_GT:
-			return int_gt_comp;
-		case ADB_COMP_EQ:
-			return int_eq_comp;
-		case ADB_COMP_NE:
-			return int_ne_comp;
-		}
-		break;
-	case ADB_CTYPE_FLOAT:
-		switch (comp) {
-		case ADB_COMP_LT:
-			return float_lt_comp;
-		case ADB_COMP_GT:
-			return float_gt_comp;
-		case ADB_COMP_EQ:
-			return float_eq_comp;
-		case ADB_COMP_NE:
-			return float_ne_comp;
-		}
-		break;
-	case ADB_CTYPE_DEGREES:
-	case ADB_CTYPE_DOUBLE:
-		switch (comp) {
-		case ADB_COMP_LT:
-			return double_lt_comp;
-		case ADB_COMP_GT:
-			return double_gt_comp;
-		case ADB_COMP_EQ:
-			return double_eq_comp;
-		case ADB_COMP_NE:
-			return double_ne_comp;
-		}
-		break;
-	case ADB_CTYPE_STRING:
-		switch (comp) {
-		case ADB_COMP_LT:
-			return string_lt_comp;
-		case ADB_COMP_GT:
-			return string_gt_comp;
-		case ADB_COMP_EQ:
-			return string_eq_comp;
-		case ADB_COMP_NE:
-			return string_ne_comp;
-		}
-		break;
-	case ADB_CTYPE_DOUBLE_DMS_DEGS:
-	case ADB_CTYPE_DOUBLE_DMS_MINS:
-	case ADB_CTYPE_DOUBLE_DMS_SECS:
-	case ADB_CTYPE_DOUBLE_HMS_HRS:
-	case ADB_CTYPE_DOUBLE_HMS_MINS:
-	case ADB_CTYPE_DOUBLE_HMS_SECS:
-	case ADB_CTYPE_SIGN:
-	case ADB_CTYPE_NULL:
-	case ADB_CTYPE_DOUBLE_MPC:
-		return NULL;
+	int *start, *hits, i, count = 0;
+
+	start = calloc(set->head_count * 2, sizeof(*start));
+	if (start == NULL)
+		return -ENOMEM;
+	hits = start + set->head_count;
+
+	for (i = 1; i < set->head_count; i++)
+		start[i] = start[i - 1] + set->object_heads[i - 1].count;
+
+	adb_debug(search->db, ADB_LOG_SEARCH, "searching %d heads with %d workers\n",
+			  set->head_count, db_workers(search->db));
+
+#pragma omp parallel for schedule(dynamic) num_threads(db_workers(search->db))
+	for (i = 0; i < set->head_count; i++) {
+		int tests = 0;
+
+		hits[i] = search_head(search, &set->object_heads[i],
+							  search->objects + start[i],
+							  set->object_heads[i].count, &tests);
 	}
-	return NULL;
+
+	for (i = 0; i < set->head_count; i++) {
+		memmove(search->objects + count, search->objects + start[i],
+				hits[i] * sizeof(*search->objects));
+		count += hits[i];
+	}
+
+	free(start);
+	return count;
 }
+#endif
 
 /**
  * \brief Create a new search object.
@@ -480,7 +956,6 @@ static comparator_t get_comparator(enum adb_comparator comp, adb_ctype ctype)
  */
 struct adb_search *adb_search_new(struct adb_db *db, int table_id)
 {
-	struct adb_table *table = &db->table[table_id];
 	struct adb_search *search;
 
 	if (table_id < 0 || table_id >= ADB_MAX_TABLES)
@@ -493,12 +968,15 @@ struct adb_search *adb_search_new(struct adb_db *db, int table_id)
 	search->db = db;
 	search->table = &db->table[table_id];
 
-	search->objects = calloc(table->object.count, sizeof(struct adb_object *));
-	if (search->objects == NULL) {
-		free(search);
-		return NULL;
+	if (db->remote) {
+		search->remote = calloc(1, sizeof(*search->remote));
+		if (search->remote == NULL) {
+			free(search);
+			return NULL;
+		}
 	}
 
+	/* results are allocated on use, sized for the set or limit */
 	return search;
 }
 
@@ -509,7 +987,7 @@ static inline void free_branch(struct adb_search_branch *branch)
 	for (i = 0; i < branch->test_count; i++)
 		free_branch(branch->branch[i]);
 
-	free(branch->value);
+	free(branch->string);
 	free(branch);
 }
 
@@ -523,8 +1001,11 @@ static inline void free_branch(struct adb_search_branch *branch)
  */
 void adb_search_free(struct adb_search *search)
 {
+	search_plan_free(search);
+	remote_search_free(search->remote);
 	free(search->objects);
-	free_branch(search->start_branch);
+	if (search->start_branch)
+		free_branch(search->start_branch);
 	free(search);
 }
 
@@ -544,7 +1025,7 @@ int adb_search_add_operator(struct adb_search *search, enum adb_operator op)
 	struct adb_search_branch *branch;
 	int i;
 
-	/* cannot have lone operator_t */
+	/* cannot have lone operator */
 	if (search->root == NULL && search->branch_orphan_count == 0 &&
 		search->test_orphan_count == 0) {
 		return -EINVAL;
@@ -554,6 +1035,9 @@ int adb_search_add_operator(struct adb_search *search, enum adb_operator op)
 	if (branch == NULL)
 		return -ENOMEM;
 
+	search_plan_free(search);
+	branch->op = op;
+
 	adb_debug(search->db, ADB_LOG_SEARCH,
 			  "new %s branch with %d test and %d branch orphans\n",
 			  op == ADB_OP_AND ? "AND" : "OR", search->test_orphan_count,
@@ -562,50 +1046,32 @@ int adb_search_add_operator(struct adb_search *search, enum adb_operator op)
 	/* we either have a parent of a compare or op
    * or a sibling of an op
    *
-   * comparator_t parent = test_orphan != NULL, branch_orphan = NULL
-   * operator_t parent = test_orphan = NULL, branch_orphan != NULL
+   * comparator parent = test_orphan != NULL, branch_orphan = NULL
+   * operator parent = test_orphan = NULL, branch_orphan != NULL
    */
 
 	if (search->test_orphan_count > 0) {
-		/* comparator_t parent */
-		switch (op) {
-		case ADB_OP_AND:
-			branch->operator = test_AND_comp;
-			break;
-		case ADB_OP_OR:
-			branch->operator = test_OR_comp;
-			break;
-		}
+		/* comparator parent */
 		branch->type = ADB_SRCH_OP_COMP;
 
 		for (i = 0; i < search->test_orphan_count; i++) {
 			branch->branch[i] = search->test_orphan[i];
 			adb_debug(search->db, ADB_LOG_SEARCH,
 					  "added test for offset %d index %d to branch\n",
-					  branch->branch[i]->offset, i);
+					  branch->branch[i]->test.offset, i);
 		}
 
 		branch->test_count = search->test_orphan_count;
 		search->test_orphan_count = 0;
 
 	} else {
-		/* operator_t parent */
-		switch (op) {
-		case ADB_OP_AND:
-			branch->operator = test_AND_oper;
-			break;
-		case ADB_OP_OR:
-			branch->operator = test_OR_oper;
-			break;
-		}
-
+		/* operator parent */
 		for (i = 0; i < search->branch_orphan_count; i++) {
 			branch->branch[i] = search->branch_orphan[i];
 			adb_debug(search->db, ADB_LOG_SEARCH,
 					  "added %s branch at index %d\n",
-					  search->branch_orphan[i]->operator == test_AND_oper ?
-						  "AND" :
-						  "OR",
+					  search->branch_orphan[i]->op == ADB_OP_AND ? "AND" :
+																	"OR",
 					  i);
 		}
 
@@ -623,9 +1089,12 @@ int adb_search_add_operator(struct adb_search *search, enum adb_operator op)
 	search->branch_orphan_count++;
 	adb_debug(
 		search->db, ADB_LOG_SEARCH, "added %s branch as root index, total %d\n",
-		search->branch_orphan[0]->operator == test_AND_oper ? "AND" : "OR",
+		search->branch_orphan[0]->op == ADB_OP_AND ? "AND" : "OR",
 		search->search_test_count);
 	search->search_test_count++;
+
+	if (search->remote)
+		return remote_search_add_operator(search->remote, op);
 	return 0;
 }
 
@@ -649,7 +1118,7 @@ int adb_search_add_comparator(struct adb_search *search, const char *field,
 {
 	adb_ctype ctype;
 	struct adb_search_branch *test;
-	comparator_t search_comp;
+	int kind;
 
 	ctype = adb_table_get_field_type(search->db, search->table->id, field);
 	if (ctype == ADB_CTYPE_NULL) {
@@ -657,57 +1126,54 @@ int adb_search_add_comparator(struct adb_search *search, const char *field,
 		return -EINVAL;
 	}
 
-	search_comp = get_comparator(comp, ctype);
-	if (search_comp == NULL) {
+	kind = get_test_kind(comp, ctype);
+	if (kind < 0) {
 		adb_error(search->db, "failed to get comparator %d for C type %d\n",
 				  comp, ctype);
 		return -EINVAL;
 	}
 
-	if (strstr(value, "*"))
-		search_comp = string_eq_wildcard_comp;
-
 	test = calloc(1, sizeof(struct adb_search_branch));
 	if (test == NULL)
 		return -ENOMEM;
 
-	test->offset =
+	test->type = ADB_SRCH_OP_TEST;
+	test->test.kind = kind;
+	test->test.offset =
 		adb_table_get_field_offset(search->db, search->table->id, field);
-	test->compare = search_comp;
 
 	adb_debug(search->db, ADB_LOG_SEARCH,
 			  "new test on field %s for value %s with type %d offset %d "
-			  "at %d comp %p\n\n",
-			  field, value, ctype, test->offset, search->test_orphan_count,
-			  test->compare);
+			  "at %d kind %d\n\n",
+			  field, value, ctype, test->test.offset,
+			  search->test_orphan_count, kind);
+
+	/* wildcards match the prefix before the '*' */
+	if (strstr(value, "*")) {
+		test->test.kind = SEARCH_STRING_PREFIX;
+		test->test.len = strstr(value, "*") - value;
+		ctype = ADB_CTYPE_STRING;
+	}
 
 	switch (ctype) {
 	case ADB_CTYPE_SIGN:
 	case ADB_CTYPE_NULL:
 	case ADB_CTYPE_STRING:
 	case ADB_CTYPE_DOUBLE_MPC:
-		test->value = strdup(value);
-		if (test->value == NULL)
+		test->string = strdup(value);
+		if (test->string == NULL)
 			goto err;
+		test->test.value.s = test->string;
 		break;
 	case ADB_CTYPE_SHORT:
 	case ADB_CTYPE_INT:
-		test->value = calloc(1, sizeof(int));
-		if (test->value == NULL)
-			goto err;
-		*((int *)test->value) = strtol(value, NULL, 10);
+		test->test.value.i = strtol(value, NULL, 10);
 		break;
 	case ADB_CTYPE_FLOAT:
-		test->value = calloc(1, sizeof(float));
-		if (test->value == NULL)
-			goto err;
-		*((float *)test->value) = strtod(value, NULL);
+		test->test.value.f = strtod(value, NULL);
 		break;
 	case ADB_CTYPE_DEGREES:
-		test->value = calloc(1, sizeof(double));
-		if (test->value == NULL)
-			goto err;
-		*((double *)test->value) = strtod(value, NULL) * D2R;
+		test->test.value.d = strtod(value, NULL) * D2R;
 		break;
 	case ADB_CTYPE_DOUBLE:
 	case ADB_CTYPE_DOUBLE_DMS_DEGS:
@@ -716,20 +1182,23 @@ int adb_search_add_comparator(struct adb_search *search, const char *field,
 	case ADB_CTYPE_DOUBLE_HMS_HRS:
 	case ADB_CTYPE_DOUBLE_HMS_MINS:
 	case ADB_CTYPE_DOUBLE_HMS_SECS:
-		test->value = calloc(1, sizeof(double));
-		if (test->value == NULL)
-			goto err;
-		*((double *)test->value) = strtod(value, NULL);
+		test->test.value.d = strtod(value, NULL);
 		break;
 	}
 
+	search_plan_free(search);
 	search->test_orphan[search->test_orphan_count++] = test;
 	search->search_test_count++;
 	search->start_branch = NULL;
 
+	/* the tree checks the program, the daemon runs it */
+	if (search->remote)
+		return remote_search_add_comparator(search->remote, comp, field,
+											value);
 	return 0;
 
 err:
+	free(test);
 	return -ENOMEM;
 }
 
@@ -751,24 +1220,106 @@ int adb_search_add_custom_comparator(struct adb_search *search,
 }
 
 /**
- * \brief Single point encapsulating execution branch checks tracking object evaluations safely.
+ * \brief Check the search tree is balanced and find its root.
+ *
+ * \param search Search context.
+ * \return 0 on success, or -EINVAL for an unbalanced search.
+ */
+static int search_check(struct adb_search *search)
+{
+	if (search->branch_orphan_count > 0) {
+		search->root = search->branch_orphan[0];
+	} else if (search->test_orphan_count > 0) {
+		adb_error(search->db, "unbalanced search - test orphans exist\n");
+		return -EINVAL;
+	}
+
+	if (search->start_branch == NULL) {
+		adb_error(search->db, "unbalanced search - no start branch\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Search a set of a remote database on the query daemon.
+ *
+ * \param search Search context with its remote program.
+ * \param set Remote object set to search.
+ * \return Number of hits, or a negative error code.
+ */
+static int search_remote(struct adb_search *search,
+						 struct adb_object_set *set)
+{
+	size_t bytes = search->table->object.bytes;
+	const char *object;
+	int i, hits, err;
+
+	err = search_check(search);
+	if (err < 0)
+		return err;
+
+	hits = remote_search_get_results(search->remote, set, search->limit,
+									 search->limit_type, &search->test_count);
+	if (hits < 0)
+		return hits;
+
+	err = search_results_alloc(search, hits);
+	if (err < 0)
+		return err;
+
+	object = search->remote->objects;
+	for (i = 0; i < hits; i++)
+		search->objects[i] =
+			(const struct adb_object *)(object + (size_t)i * bytes);
+	search->hit_count = hits;
+
+	stats_add(&search->db->stats, STATS_SEARCHES, 1);
+	stats_add(&search->db->stats, STATS_OBJECTS_TESTED, search->test_count);
+	return hits;
+}
+
+/**
+ * \brief Check the search tree and get it ready to search a set.
  *
- * \param branch Evaluator tree structure map targeting execution parameters context configurations.
- * \param object Catalog input tracking specific target layout row structures physically extracted.
- * \return Positive boolean mapping verified object valid configurations matching tree parameters layout.
+ * \param search Search context.
+ * \param set Object set to search.
+ * \return Number of object heads in the set, or a negative error code.
  */
-static inline int check_object(struct adb_search_branch *branch,
-							   const struct adb_object *object)
+static int search_prepare(struct adb_search *search,
+						  struct adb_object_set *set)
 {
-	return branch->operator(object, branch, branch->test_count);
+	int object_heads, err;
+
+	err = search_check(search);
+	if (err < 0)
+		return err;
+
+	/* operator is root */
+	object_heads = adb_set_get_objects(set);
+	if (object_heads <= 0)
+		return object_heads;
+
+	/* compile the search tree on first use */
+	if (search->plan == NULL) {
+		err = search_plan_compile(search, set);
+		if (err < 0)
+			return err;
+	}
+
+	return object_heads;
 }
 
 /**
  * \brief Execute the search and retrieve matching objects.
  *
  * Processes the completely built RPN logic execution tree across all objects
- * within the given dataset boundary (object set). It populates an array with
- * pointers to the objects that successfully satisfy the search conditions.
+ * within the given dataset boundary (object set). The tree is compiled into
+ * a search plan on the first call, ordering the tests on their selectivity
+ * in the set, and reused until the search is changed. It populates an array
+ * with pointers to the objects that successfully satisfy the search
+ * conditions.
  *
  * \param search Configured search context
  * \param set The object dataset boundary to iterate through
@@ -781,51 +1332,194 @@ int adb_search_get_results(struct adb_search *search,
 						   struct adb_object_set *set,
 						   const struct adb_object **objects[])
 {
-	struct adb_table *table = search->table;
-	int i, j, object_heads;
+	int i, object_heads, err, max;
 
-	if (search->branch_orphan_count > 0) {
-		search->root = search->branch_orphan[0];
-	} else if (search->test_orphan_count > 0) {
-		adb_error(search->db, "unbalanced search - test orphans exist\n");
-		return -EINVAL;
-	}
-
-	if (search->start_branch == NULL) {
-		adb_error(search->db, "unbalanced search - no start branch\n");
-		return -EINVAL;
+	if (search->remote) {
+		err = search_remote(search, set);
+		if (err >= 0)
+			*objects = search->objects;
+		return err;
 	}
 
-	/* operator_t is root */
-	object_heads = adb_set_get_objects(set);
-
+	object_heads = search_prepare(search, set);
 	if (object_heads <= 0)
 		return object_heads;
 
+	max = set->count;
+	if (search->limit && search->limit < max)
+		max = search->limit;
+
+	err = search_results_alloc(search, max);
+	if (err < 0)
+		return err;
+
 	search->hit_count = 0;
 	search->test_count = 0;
 
-	/* search objects in each object head */
-	for (i = 0; i < object_heads; i++) {
-		const void *object = set->object_heads[i].objects;
-
-		for (j = 0; j < set->object_heads[i].count; j++) {
-			if (check_object(search->start_branch, object))
-				search->objects[search->hit_count++] = object;
+	if (search->limit && search->limit_type == ADB_LIMIT_BRIGHTEST) {
+		err = search_brightest(search, set);
+		if (err < 0)
+			return err;
+		search->hit_count = err;
+		goto out;
+	}
 
-			object += table->object.bytes;
-			search->test_count++;
-		}
+	/* narrow ranges on indexed fields avoid testing the whole set */
+	err = search_range(search, set, max);
+	if (err >= 0) {
+		search->hit_count = err;
+		goto out;
+	}
+	if (err != -ENOENT)
+		return err;
+
+#if HAVE_OPENMP
+	/* large sets like all sky queries search heads in parallel */
+	if (!search->limit && set->count >= ADB_SRCH_PARALLEL_MIN &&
+		object_heads > 1 && db_workers(search->db) > 1) {
+		err = search_heads_parallel(search, set);
+		if (err < 0)
+			return err;
+		search->hit_count = err;
+		search->test_count = set->count;
+		goto out;
 	}
+#endif
 
+	/* search objects in each object head, stopping at the limit */
+	for (i = 0; i < object_heads && search->hit_count < max; i++)
+		search->hit_count += search_head(search, &set->object_heads[i],
+										 search->objects + search->hit_count,
+										 max - search->hit_count,
+										 &search->test_count);
+
+out:
 	adb_info(search->db, ADB_LOG_SEARCH,
 			 "search count %d clipped heads %d tested objects %d\n", set->count,
 			 object_heads, search->test_count);
+	stats_add(&search->db->stats, STATS_SEARCHES, 1);
+	stats_add(&search->db->stats, STATS_OBJECTS_TESTED, search->test_count);
 
 	*objects = search->objects;
 	return search->hit_count;
 }
 
+/**
+ * \brief Set a limit on the number of search results.
+ *
+ * \param search Search context
+ * \param limit Maximum number of results, 0 for all hits
+ * \param type Hits kept under the limit
+ * \return 0 on success, or -EINVAL for a negative limit
+ */
+int adb_search_set_limit(struct adb_search *search, int limit,
+						 enum adb_search_limit type)
+{
+	if (limit < 0)
+		return -EINVAL;
+
+	search->limit = limit;
+	search->limit_type = type;
+	return 0;
+}
+
+/**
+ * \brief Start iterating over search results.
+ *
+ * Objects are searched lazily by adb_search_iter_next(), head by head, so
+ * no result array is needed. Searches limited to the brightest hits are
+ * searched here, since any object could be among them.
+ *
+ * \param search Configured search context
+ * \param set The object dataset boundary to iterate through
+ * \return 0 on success, or a negative error code
+ */
+int adb_search_iter_begin(struct adb_search *search,
+						  struct adb_object_set *set)
+{
+	int object_heads, err;
+
+	/* remote results are all fetched and then iterated */
+	if (search->remote) {
+		search->iter_set = NULL;
+		search->iter_pos = 0;
+		err = search_remote(search, set);
+		if (err < 0)
+			return err;
+		search->iter_set = set;
+		return 0;
+	}
+
+	object_heads = search_prepare(search, set);
+	if (object_heads < 0)
+		return object_heads;
+
+	search->iter_set = set;
+	search->iter_head = 0;
+	search->iter_pos = 0;
+	search->hit_count = 0;
+	search->test_count = 0;
+
+	if (object_heads && search->limit &&
+		search->limit_type == ADB_LIMIT_BRIGHTEST) {
+		err = search_results_alloc(search, search->limit);
+		if (err < 0)
+			return err;
+
+		err = search_brightest(search, set);
+		if (err < 0)
+			return err;
+		search->hit_count = err;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Get the next search result.
+ *
+ * \param search Search context started by adb_search_iter_begin()
+ * \return The next matching object, or NULL when there are no more
+ */
+const struct adb_object *adb_search_iter_next(struct adb_search *search)
+{
+	struct adb_object_set *set = search->iter_set;
+	const struct adb_object_head *head;
+	const char *object;
+
+	if (set == NULL)
+		return NULL;
+
+	if (search->remote ||
+		(search->limit && search->limit_type == ADB_LIMIT_BRIGHTEST)) {
+		if (search->iter_pos >= search->hit_count)
+			return NULL;
+		return search->objects[search->iter_pos++];
+	}
+
+	if (search->limit && search->hit_count >= search->limit)
+		return NULL;
+
+	for (; search->iter_head < set->head_count; search->iter_head++) {
+		head = &set->object_heads[search->iter_head];
+
+		while (search->iter_pos < (int)head->count) {
+			object = (const char *)head->objects +
+					 (size_t)search->iter_pos++ * search->table->object.bytes;
+
+			search->test_count++;
+			if (search_plan_check(search->plan, object)) {
+				search->hit_count++;
+				return (const struct adb_object *)object;
+			}
+		}
+
+		search->iter_pos = 0;
+	}
+
+	return NULL;
+}
+
 /**
  * \brief Get the number of successful search hits.
  *
@@ -0,0 +1,933 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "lib.h"
+#include "remote.h"
+#include "libastrodb/object.h"
+#include "libastrodb/remote.h"
+#include "libastrodb/search.h"
+
+/* bytes read from a client at a time */
+#define SERVER_READ_SIZE (64 * 1024)
+
+/*! \struct server_client
+ * \brief Connected client with its unparsed requests and unsent replies.
+ */
+struct server_client {
+	int fd; /*!< client socket, -1 once dropped */
+	struct remote_buf in; /*!< received bytes, pos is the next request */
+	struct remote_buf out; /*!< replies, pos is the next byte to send */
+};
+
+struct adb_server {
+	struct adb_db *db;
+	char *path; /*!< socket path */
+	int fd; /*!< listening socket */
+	int stop[2]; /*!< stop pipe, written by adb_server_stop() */
+
+	struct server_client **client;
+	int num_clients;
+	int client_size; /*!< allocated clients */
+
+	/* tables opened for clients */
+	int opened[ADB_MAX_TABLES];
+	struct adb_object_set *set[ADB_MAX_TABLES]; /*!< whole table sets */
+
+	/* hash keys are kept by the tables, so they live as long as the server */
+	char **key;
+	int num_keys;
+};
+
+/**
+ * \brief Get a table opened by the database.
+ *
+ * \param server The daemon.
+ * \param id Table ID from a request.
+ * \return The table or NULL for an invalid ID.
+ */
+static struct adb_table *server_table(struct adb_server *server, int32_t id)
+{
+	if (id < 0 || id >= ADB_MAX_TABLES || !server->db->table_in_use[id])
+		return NULL;
+
+	return &server->db->table[id];
+}
+
+/**
+ * \brief Get the whole table set used by nearest and match requests.
+ *
+ * \param server The daemon.
+ * \param table The table.
+ * \return The set or NULL on failure.
+ */
+static struct adb_object_set *server_table_set(struct adb_server *server,
+											   struct adb_table *table)
+{
+	if (server->set[table->id] == NULL)
+		server->set[table->id] = adb_table_set_new(server->db, table->id);
+
+	return server->set[table->id];
+}
+
+/**
+ * \brief Create a set with the table and constraints of a request.
+ *
+ * \param server The daemon.
+ * \param req Request with the set at its read position.
+ * \param set_ Output set to be freed by the caller.
+ * \return 0 on success or a negative error code.
+ */
+static int server_get_set(struct adb_server *server, struct remote_buf *req,
+						  struct adb_object_set **set_)
+{
+	struct adb_object_set *set;
+	struct adb_table *table;
+	double ra, dec, fov, start, end;
+	int32_t id, all;
+	int ret;
+
+	ret = remote_buf_get_int(req, &id);
+	ret |= remote_buf_get_int(req, &all);
+	ret |= remote_buf_get_double(req, &ra);
+	ret |= remote_buf_get_double(req, &dec);
+	ret |= remote_buf_get_double(req, &fov);
+	ret |= remote_buf_get_double(req, &start);
+	ret |= remote_buf_get_double(req, &end);
+	if (ret < 0)
+		return -EPROTO;
+
+	table = server_table(server, id);
+	if (table == NULL)
+		return -EINVAL;
+
+	set = adb_table_set_new(server->db, id);
+	if (set == NULL)
+		return -ENOMEM;
+
+	if (!all) {
+		ret = adb_table_set_constraints(set, ra, dec, fov, start, end);
+		if (ret < 0) {
+			adb_table_set_free(set);
+			return ret;
+		}
+	}
+
+	*set_ = set;
+	return 0;
+}
+
+/**
+ * \brief Add objects to a reply.
+ *
+ * \param out Reply payload.
+ * \param table Table of the objects.
+ * \param objects Objects to add.
+ * \param count Number of objects.
+ * \return 0 on success or -ENOMEM.
+ */
+static int server_put_objects(struct remote_buf *out,
+							  const struct adb_table *table,
+							  const struct adb_object *objects[], int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (remote_buf_put(out, objects[i], table->object.bytes) < 0)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static int server_open(struct adb_server *server, struct remote_buf *req,
+					   struct remote_buf *out)
+{
+	struct adb_db *db = server->db;
+	struct cds_importer *import;
+	struct adb_schema_field field;
+	const char *cat_class, *cat_id, *name;
+	struct adb_table *table;
+	int i, id = -1, ret;
+
+	cat_class = remote_buf_get_str(req);
+	cat_id = remote_buf_get_str(req);
+	name = remote_buf_get_str(req);
+	if (cat_class == NULL || cat_id == NULL || name == NULL)
+		return -EPROTO;
+
+	/* clients share tables already open */
+	for (i = 0; i < ADB_MAX_TABLES; i++) {
+		table = &db->table[i];
+		if (db->table_in_use[i] && table->cds.cat_class && table->cds.index &&
+			table->path.file && !strcmp(table->cds.cat_class, cat_class) &&
+			!strcmp(table->cds.index, cat_id) &&
+			!strcmp(table->path.file, name)) {
+			id = i;
+			break;
+		}
+	}
+
+	if (id < 0) {
+		id = adb_table_open(db, cat_class, cat_id, name);
+		if (id < 0)
+			return id;
+		server->opened[id] = 1;
+	}
+
+	table = &db->table[id];
+	import = &table->import;
+	ret = remote_buf_put_int(out, id);
+	ret |= remote_buf_put_int(out, table->object.count);
+	ret |= remote_buf_put_int(out, table->object.bytes);
+	ret |= remote_buf_put_int(out, table->object.field_count);
+	ret |= remote_buf_put_int(out, table->object.num_alt_fields);
+
+	/* importer callbacks mean nothing in another process */
+	for (i = 0; i < table->object.field_count; i++) {
+		field = import->field[i];
+		field.import = NULL;
+		ret |= remote_buf_put(out, &field, sizeof(field));
+	}
+	for (i = 0; i < table->object.num_alt_fields; i++) {
+		field = import->alt_field[i].key_field;
+		field.import = NULL;
+		ret |= remote_buf_put(out, &field, sizeof(field));
+	}
+
+	return ret < 0 ? -ENOMEM : 0;
+}
+
+static int server_hash_key(struct adb_server *server, struct remote_buf *req,
+						   struct remote_buf *out)
+{
+	struct adb_table *table;
+	const char *key;
+	char **keys;
+	int32_t id;
+	int i;
+
+	(void)out;
+	if (remote_buf_get_int(req, &id) < 0)
+		return -EPROTO;
+	key = remote_buf_get_str(req);
+	if (key == NULL)
+		return -EPROTO;
+
+	table = server_table(server, id);
+	if (table == NULL)
+		return -EINVAL;
+
+	/* keys are hashed once for every client */
+	for (i = 0; i < table->hash.num; i++) {
+		if (!strcmp(key, table->hash.map[i].key))
+			return 0;
+	}
+
+	keys = realloc(server->key, (server->num_keys + 1) * sizeof(*keys));
+	if (keys == NULL)
+		return -ENOMEM;
+	server->key = keys;
+	keys[server->num_keys] = strdup(key);
+	if (keys[server->num_keys] == NULL)
+		return -ENOMEM;
+
+	return adb_table_hash_key(server->db, id, keys[server->num_keys++]);
+}
+
+static int server_get_object(struct adb_server *server, struct remote_buf *req,
+							 struct remote_buf *out)
+{
+	const struct adb_object *object;
+	struct adb_table *table;
+	const char *field;
+	/* keys are copied so numeric keys are aligned and strings terminated */
+	union {
+		long long align;
+		char data[REMOTE_MAX_KEY + 1];
+	} key = { 0 };
+	int32_t id, size;
+	int ret;
+
+	if (remote_buf_get_int(req, &id) < 0)
+		return -EPROTO;
+	field = remote_buf_get_str(req);
+	if (field == NULL || remote_buf_get_int(req, &size) < 0 || size < 0 ||
+		size > REMOTE_MAX_KEY || remote_buf_get(req, key.data, size) < 0)
+		return -EPROTO;
+
+	table = server_table(server, id);
+	if (table == NULL)
+		return -EINVAL;
+
+	ret = adb_table_get_object(server->db, id, key.data, field, &object);
+	if (ret <= 0 || object == NULL)
+		return ret;
+
+	if (server_put_objects(out, table, &object, 1) < 0)
+		return -ENOMEM;
+	return 1;
+}
+
+static int server_cone(struct adb_server *server, struct remote_buf *req,
+					   struct remote_buf *out)
+{
+	struct adb_object_set *set;
+	struct adb_object_head *head;
+	int i, heads, ret;
+
+	ret = server_get_set(server, req, &set);
+	if (ret < 0)
+		return ret;
+
+	heads = adb_set_get_objects(set);
+	if (heads < 0) {
+		ret = heads;
+		goto out;
+	}
+
+	/* heads are runs of objects in table order */
+	head = adb_set_get_head(set);
+	for (i = 0; i < heads; i++) {
+		ret = remote_buf_put(out, head[i].objects,
+							 (size_t)head[i].count * set->table->object.bytes);
+		if (ret < 0)
+			goto out;
+	}
+	ret = adb_set_get_count(set);
+
+out:
+	adb_table_set_free(set);
+	return ret;
+}
+
+static int server_knearest(struct adb_server *server, struct remote_buf *req,
+						   struct remote_buf *out)
+{
+	const struct adb_object **objects;
+	struct adb_object_set *set;
+	struct adb_table *table;
+	int32_t id, k;
+	double ra, dec;
+	int ret;
+
+	ret = remote_buf_get_int(req, &id);
+	ret |= remote_buf_get_double(req, &ra);
+	ret |= remote_buf_get_double(req, &dec);
+	ret |= remote_buf_get_int(req, &k);
+	if (ret < 0 || k < 0 || k > REMOTE_MAX_NEAREST)
+		return -EPROTO;
+
+	table = server_table(server, id);
+	if (table == NULL)
+		return -EINVAL;
+	set = server_table_set(server, table);
+	if (set == NULL)
+		return -ENOMEM;
+
+	objects = malloc((k ? k : 1) * sizeof(*objects));
+	if (objects == NULL)
+		return -ENOMEM;
+
+	ret = adb_table_set_get_knearest_on_pos(set, ra, dec, k, objects);
+	if (ret > 0 && server_put_objects(out, table, objects, ret) < 0)
+		ret = -ENOMEM;
+
+	free(objects);
+	return ret;
+}
+
+static int server_within(struct adb_server *server, struct remote_buf *req,
+						 struct remote_buf *out)
+{
+	const struct adb_object **objects;
+	struct adb_object_set *set;
+	struct adb_table *table;
+	double ra, dec, radius;
+	int32_t id, size;
+	int ret, count;
+
+	ret = remote_buf_get_int(req, &id);
+	ret |= remote_buf_get_double(req, &ra);
+	ret |= remote_buf_get_double(req, &dec);
+	ret |= remote_buf_get_double(req, &radius);
+	ret |= remote_buf_get_int(req, &size);
+	if (ret < 0 || size < 0)
+		return -EPROTO;
+
+	table = server_table(server, id);
+	if (table == NULL)
+		return -EINVAL;
+	set = server_table_set(server, table);
+	if (set == NULL)
+		return -ENOMEM;
+
+	if (size > table->object.count)
+		size = table->object.count;
+	objects = malloc((size ? size : 1) * sizeof(*objects));
+	if (objects == NULL)
+		return -ENOMEM;
+
+	ret = adb_table_set_get_within_radius(set, ra, dec, radius, objects, size);
+	if (ret >= 0) {
+		count = ret < size ? ret : size;
+		if (remote_buf_put_int(out, count) < 0 ||
+			server_put_objects(out, table, objects, count) < 0)
+			ret = -ENOMEM;
+	}
+
+	free(objects);
+	return ret;
+}
+
+static int server_xmatch(struct adb_server *server, struct remote_buf *req,
+						 struct remote_buf *out)
+{
+	const struct adb_object **match;
+	const double *ra, *dec;
+	struct adb_object_set *set;
+	struct adb_table *table;
+	double radius, *pos = NULL;
+	int32_t id, n, count = 0;
+	int i, ret;
+
+	ret = remote_buf_get_int(req, &id);
+	ret |= remote_buf_get_int(req, &n);
+	ret |= remote_buf_get_double(req, &radius);
+	if (ret < 0 || n < 0 || (size_t)n > req->len / (2 * sizeof(double)))
+		return -EPROTO;
+
+	/* positions may be unaligned in the request */
+	pos = malloc((n ? n : 1) * 2 * sizeof(double));
+	match = malloc((n ? n : 1) * sizeof(*match));
+	if (pos == NULL || match == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	if (remote_buf_get(req, pos, n * 2 * sizeof(double)) < 0) {
+		ret = -EPROTO;
+		goto out;
+	}
+	ra = pos;
+	dec = pos + n;
+
+	table = server_table(server, id);
+	if (table == NULL) {
+		ret = -EINVAL;
+		goto out;
+	}
+	set = server_table_set(server, table);
+	if (set == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = adb_table_crossmatch(set, ra, dec, n, radius, match);
+	if (ret < 0)
+		goto out;
+
+	/* index of each match in the objects that follow */
+	for (i = 0; i < n; i++) {
+		if (remote_buf_put_int(out, match[i] ? count++ : -1) < 0)
+			ret = -ENOMEM;
+	}
+	if (remote_buf_put_int(out, count) < 0)
+		ret = -ENOMEM;
+	for (i = 0; i < n && ret >= 0; i++) {
+		if (match[i] && server_put_objects(out, table, &match[i], 1) < 0)
+			ret = -ENOMEM;
+	}
+
+out:
+	free(match);
+	free(pos);
+	return ret;
+}
+
+static int server_search(struct adb_server *server, struct remote_buf *req,
+						 struct remote_buf *out)
+{
+	const struct adb_object **objects;
+	struct adb_object_set *set;
+	struct adb_search *search;
+	const char *field, *value;
+	int32_t limit, type, tokens, kind, op;
+	int i, ret;
+
+	ret = server_get_set(server, req, &set);
+	if (ret < 0)
+		return ret;
+
+	search = adb_search_new(server->db, set->table_id);
+	if (search == NULL) {
+		adb_table_set_free(set);
+		return -ENOMEM;
+	}
+
+	ret = remote_buf_get_int(req, &limit);
+	ret |= remote_buf_get_int(req, &type);
+	ret |= remote_buf_get_int(req, &tokens);
+	if (ret < 0) {
+		ret = -EPROTO;
+		goto out;
+	}
+
+	if (limit) {
+		ret = adb_search_set_limit(search, limit, type);
+		if (ret < 0)
+			goto out;
+	}
+
+	/* replay the RPN program as the client built it */
+	for (i = 0; i < tokens; i++) {
+		if (remote_buf_get_int(req, &kind) < 0 ||
+			remote_buf_get_int(req, &op) < 0) {
+			ret = -EPROTO;
+			goto out;
+		}
+
+		if (kind == REMOTE_TOKEN_OPERATOR) {
+			ret = adb_search_add_operator(search, op);
+		} else if (kind == REMOTE_TOKEN_COMPARATOR) {
+			field = remote_buf_get_str(req);
+			value = remote_buf_get_str(req);
+			if (field == NULL || value == NULL) {
+				ret = -EPROTO;
+				goto out;
+			}
+			ret = adb_search_add_comparator(search, field, op, value);
+		} else {
+			ret = -EPROTO;
+		}
+		if (ret < 0)
+			goto out;
+	}
+
+	ret = adb_set_get_objects(set);
+	if (ret < 0)
+		goto out;
+
+	ret = adb_search_get_results(search, set, &objects);
+	if (ret < 0)
+		goto out;
+
+	if (remote_buf_put_int(out, adb_search_get_tests(search)) < 0 ||
+		server_put_objects(out, set->table, objects, ret) < 0)
+		ret = -ENOMEM;
+
+out:
+	adb_search_free(search);
+	adb_table_set_free(set);
+	return ret;
+}
+
+/**
+ * \brief Answer one request.
+ *
+ * \param server The daemon.
+ * \param client The requesting client.
+ * \param hdr Request header.
+ * \param req Request payload.
+ * \return 0 on success or -ENOMEM if the reply can't be queued.
+ */
+static int server_reply(struct adb_server *server,
+						struct server_client *client,
+						const struct remote_hdr *hdr, struct remote_buf *req)
+{
+	struct remote_buf *out = &client->out;
+	struct remote_hdr reply = *hdr;
+	size_t start = out->len, payload;
+	int32_t status = 0;
+
+	if (remote_buf_put(out, &reply, sizeof(reply)) < 0 ||
+		remote_buf_put_int(out, status) < 0) {
+		out->len = start;
+		return -ENOMEM;
+	}
+	payload = out->len;
+
+	switch (hdr->op) {
+	case REMOTE_OP_OPEN:
+		status = server_open(server, req, out);
+		break;
+	case REMOTE_OP_HASH_KEY:
+		status = server_hash_key(server, req, out);
+		break;
+	case REMOTE_OP_GET_OBJECT:
+		status = server_get_object(server, req, out);
+		break;
+	case REMOTE_OP_CONE:
+		status = server_cone(server, req, out);
+		break;
+	case REMOTE_OP_KNEAREST:
+		status = server_knearest(server, req, out);
+		break;
+	case REMOTE_OP_WITHIN:
+		status = server_within(server, req, out);
+		break;
+	case REMOTE_OP_XMATCH:
+		status = server_xmatch(server, req, out);
+		break;
+	case REMOTE_OP_SEARCH:
+		status = server_search(server, req, out);
+		break;
+	default:
+		status = -EOPNOTSUPP;
+		break;
+	}
+
+	if (status >= 0 && out->len - start - sizeof(reply) > REMOTE_MAX_PAYLOAD)
+		status = -E2BIG;
+
+	/* failed requests only reply with their status */
+	if (status < 0)
+		out->len = payload;
+
+	reply.size = out->len - start - sizeof(reply);
+	memcpy(out->data + start, &reply, sizeof(reply));
+	memcpy(out->data + start + sizeof(reply), &status, sizeof(status));
+	return 0;
+}
+
+/**
+ * \brief Answer every complete request received from a client.
+ *
+ * \param server The daemon.
+ * \param client The client.
+ * \return 0 on success or a negative error code to drop the client.
+ */
+static int server_process(struct adb_server *server,
+						  struct server_client *client)
+{
+	struct remote_buf *in = &client->in;
+	struct remote_buf req;
+	struct remote_hdr hdr;
+	int ret;
+
+	while (in->len - in->pos >= sizeof(hdr)) {
+		memcpy(&hdr, in->data + in->pos, sizeof(hdr));
+		if (hdr.magic != REMOTE_MAGIC || hdr.size > REMOTE_MAX_PAYLOAD)
+			return -EPROTO;
+		if (in->len - in->pos - sizeof(hdr) < hdr.size)
+			break;
+
+		req.data = in->data + in->pos + sizeof(hdr);
+		req.size = req.len = hdr.size;
+		req.pos = 0;
+
+		ret = server_reply(server, client, &hdr, &req);
+		if (ret < 0)
+			return ret;
+		in->pos += sizeof(hdr) + hdr.size;
+	}
+
+	/* keep any partial request at the start of the buffer */
+	memmove(in->data, in->data + in->pos, in->len - in->pos);
+	in->len -= in->pos;
+	in->pos = 0;
+	return 0;
+}
+
+/**
+ * \brief Send queued replies to a client.
+ *
+ * \param client The client.
+ * \return 0 on success or a negative error code to drop the client.
+ */
+static int server_flush(struct server_client *client)
+{
+	struct remote_buf *out = &client->out;
+	ssize_t ret;
+
+	while (out->pos < out->len) {
+		ret = send(client->fd, out->data + out->pos, out->len - out->pos,
+				   MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -errno;
+		}
+		out->pos += ret;
+	}
+
+	out->len = out->pos = 0;
+	return 0;
+}
+
+/**
+ * \brief Read requests from a client and answer them.
+ *
+ * \param server The daemon.
+ * \param client The client.
+ * \return 0 on success or a negative error code to drop the client.
+ */
+static int server_read(struct adb_server *server, struct server_client *client)
+{
+	struct remote_buf *in = &client->in;
+	char *new;
+	ssize_t ret;
+
+	if (in->size - in->len < SERVER_READ_SIZE) {
+		new = realloc(in->data, in->len + SERVER_READ_SIZE);
+		if (new == NULL)
+			return -ENOMEM;
+		in->data = new;
+		in->size = in->len + SERVER_READ_SIZE;
+	}
+
+	ret = recv(client->fd, in->data + in->len, SERVER_READ_SIZE, MSG_DONTWAIT);
+	if (ret < 0)
+		return errno == EAGAIN || errno == EINTR ? 0 : -errno;
+	if (ret == 0)
+		return -ECONNRESET;
+	in->len += ret;
+
+	ret = server_process(server, client);
+	if (ret < 0)
+		return ret;
+
+	return server_flush(client);
+}
+
+static void server_client_free(struct server_client *client)
+{
+	if (client->fd >= 0)
+		close(client->fd);
+	remote_buf_free(&client->in);
+	remote_buf_free(&client->out);
+	free(client);
+}
+
+/**
+ * \brief Accept a new client.
+ *
+ * \param server The daemon.
+ * \return 0 on success or a negative error code.
+ */
+static int server_accept(struct adb_server *server)
+{
+	struct server_client **clients, *client;
+	int fd, size;
+
+	fd = accept4(server->fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (fd < 0)
+		return errno == EAGAIN || errno == EINTR ? 0 : -errno;
+
+	if (server->num_clients == server->client_size) {
+		size = server->client_size ? server->client_size * 2 : 8;
+		clients = realloc(server->client, size * sizeof(*clients));
+		if (clients == NULL) {
+			close(fd);
+			return -ENOMEM;
+		}
+		server->client = clients;
+		server->client_size = size;
+	}
+
+	client = calloc(1, sizeof(*client));
+	if (client == NULL) {
+		close(fd);
+		return -ENOMEM;
+	}
+	client->fd = fd;
+	server->client[server->num_clients++] = client;
+
+	adb_info(server->db, ADB_LOG_CDS_DB, "query daemon client %d connected\n",
+			 fd);
+	return 0;
+}
+
+struct adb_server *adb_server_new(struct adb_db *db, const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct adb_server *server;
+
+	if (db->remote || strlen(path) >= sizeof(addr.sun_path))
+		return NULL;
+	strcpy(addr.sun_path, path);
+
+	server = calloc(1, sizeof(*server));
+	if (server == NULL)
+		return NULL;
+	server->db = db;
+	server->stop[0] = server->stop[1] = -1;
+
+	server->path = strdup(path);
+	if (server->path == NULL)
+		goto err;
+
+	if (pipe2(server->stop, O_CLOEXEC | O_NONBLOCK) < 0)
+		goto err;
+
+	server->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (server->fd < 0)
+		goto err;
+
+	/* a stale socket from a previous daemon is replaced */
+	unlink(path);
+	if (bind(server->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		listen(server->fd, SOMAXCONN) < 0) {
+		adb_error(db, "can't listen on %s %d\n", path, -errno);
+		close(server->fd);
+		goto err;
+	}
+
+	return server;
+
+err:
+	if (server->stop[0] >= 0) {
+		close(server->stop[0]);
+		close(server->stop[1]);
+	}
+	free(server->path);
+	free(server);
+	return NULL;
+}
+
+int adb_server_run(struct adb_server *server)
+{
+	struct pollfd *pfd = NULL, *new;
+	struct server_client *client;
+	int i, j, fds, size = 0, ret = 0;
+	char stop;
+
+	for (;;) {
+		fds = server->num_clients + 2;
+		if (fds > size) {
+			new = realloc(pfd, fds * sizeof(*pfd));
+			if (new == NULL) {
+				ret = -ENOMEM;
+				break;
+			}
+			pfd = new;
+			size = fds;
+		}
+
+		pfd[0].fd = server->stop[0];
+		pfd[0].events = POLLIN;
+		pfd[1].fd = server->fd;
+		pfd[1].events = POLLIN;
+
+		/* clients with replies to send are read once they are sent */
+		for (i = 0; i < server->num_clients; i++) {
+			client = server->client[i];
+			pfd[i + 2].fd = client->fd;
+			pfd[i + 2].events = client->out.len ? POLLOUT : POLLIN;
+		}
+
+		if (poll(pfd, fds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			break;
+		}
+
+		if (pfd[0].revents) {
+			while (read(server->stop[0], &stop, 1) == 1)
+				;
+			break;
+		}
+
+		for (i = 2; i < fds; i++) {
+			client = server->client[i - 2];
+			if (pfd[i].revents & POLLOUT)
+				ret = server_flush(client);
+			else if (pfd[i].revents & (POLLIN | POLLHUP | POLLERR))
+				ret = server_read(server, client);
+			else
+				continue;
+
+			if (ret < 0) {
+				adb_info(server->db, ADB_LOG_CDS_DB,
+						 "query daemon client %d dropped %d\n", client->fd,
+						 ret);
+				close(client->fd);
+				client->fd = -1;
+			}
+		}
+		ret = 0;
+
+		/* drop closed clients */
+		for (i = 0, j = 0; i < server->num_clients; i++) {
+			if (server->client[i]->fd < 0)
+				server_client_free(server->client[i]);
+			else
+				server->client[j++] = server->client[i];
+		}
+		server->num_clients = j;
+
+		if (pfd[1].revents & POLLIN) {
+			ret = server_accept(server);
+			if (ret < 0)
+				adb_error(server->db, "can't accept client %d\n", ret);
+			ret = 0;
+		}
+	}
+
+	free(pfd);
+	return ret;
+}
+
+void adb_server_stop(struct adb_server *server)
+{
+	char stop = 1;
+
+	/* only async signal safe calls here */
+	if (write(server->stop[1], &stop, 1) < 0)
+		return;
+}
+
+void adb_server_free(struct adb_server *server)
+{
+	int i;
+
+	if (server == NULL)
+		return;
+
+	for (i = 0; i < server->num_clients; i++)
+		server_client_free(server->client[i]);
+	free(server->client);
+
+	for (i = 0; i < ADB_MAX_TABLES; i++) {
+		adb_table_set_free(server->set[i]);
+		if (server->opened[i])
+			adb_table_close(server->db, i);
+	}
+
+	for (i = 0; i < server->num_keys; i++)
+		free(server->key[i]);
+	free(server->key);
+
+	close(server->fd);
+	close(server->stop[0]);
+	close(server->stop[1]);
+	unlink(server->path);
+	free(server->path);
+	free(server);
+}
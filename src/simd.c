@@ -0,0 +1,632 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+#include "libastrodb/object.h"
+
+/* kernels use per function target attributes, no global -m flags needed */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/*! \struct simd_kernels
+ * \ingroup simd
+ *
+ * Filter kernels for one instruction set.
+ */
+struct simd_kernels {
+	int (*select_mag)(const void *objects, int count, int stride, float min,
+					  float max, int *index);
+	int (*select_dec)(const void *objects, int count, int stride, double min,
+					  double max, int *index);
+	int (*select_cone)(const double *x, const double *y, const double *z,
+					   int count, const double centre[3], double cos_fov,
+					   int *index);
+	void (*plate_to_equ)(const double *x, const double *y, int count,
+						 const struct simd_plate_pair *pair, double *ra_sum,
+						 double *dec_sum, double *hits);
+	double (*dot)(const double *a, const double *b, int count);
+};
+
+#define OBJECT_MAG(object)                  \
+	(*(const float *)((const char *)(object) + \
+					  offsetof(struct adb_object, mag)))
+#define OBJECT_DEC(object)                   \
+	(*(const double *)((const char *)(object) + \
+					   offsetof(struct adb_object, dec)))
+
+/* select from object i on, also finishing vector kernel tails */
+static int tail_select_mag(const char *object, int i, int count, int stride,
+						   float min, float max, int *index, int n)
+{
+	for (; i < count; i++, object += stride) {
+		if (OBJECT_MAG(object) >= min && OBJECT_MAG(object) <= max)
+			index[n++] = i;
+	}
+	return n;
+}
+
+static int tail_select_dec(const char *object, int i, int count, int stride,
+						   double min, double max, int *index, int n)
+{
+	for (; i < count; i++, object += stride) {
+		if (OBJECT_DEC(object) >= min && OBJECT_DEC(object) <= max)
+			index[n++] = i;
+	}
+	return n;
+}
+
+static int tail_select_cone(const double *x, const double *y,
+							const double *z, int i, int count,
+							const double centre[3], double cos_fov, int *index,
+							int n)
+{
+	for (; i < count; i++) {
+		if (x[i] * centre[0] + y[i] * centre[1] + z[i] * centre[2] >= cos_fov)
+			index[n++] = i;
+	}
+	return n;
+}
+
+/* transform from position i on, also finishing vector kernel tails */
+static void tail_plate_to_equ(const double *x, const double *y, int i,
+							  int count, const struct simd_plate_pair *pair,
+							  double *ra_sum, double *dec_sum, double *hits)
+{
+	double u, v, ra, dec;
+
+	for (; i < count; i++) {
+		if ((x[i] == pair->x1 && y[i] == pair->y1) ||
+			(x[i] == pair->x2 && y[i] == pair->y2))
+			continue;
+
+		/* reverse RA since RHS of plate increases X and RHS of sky is
+		 * decreasing in RA */
+		u = pair->x1 - x[i];
+		v = pair->y1 - y[i];
+		ra = -(u * pair->cos_pa + v * pair->sin_pa) * pair->rad_per_pix /
+			 pair->cos_mid_dec;
+		dec = -(v * pair->cos_pa - u * pair->sin_pa) * pair->rad_per_pix +
+			  pair->dec;
+
+		/* make sure DEC is -90.0 .. 90.0 */
+		if (dec > M_PI_2) {
+			dec = M_PI_2 - (dec - M_PI_2);
+			ra += M_PI;
+		} else if (dec < -M_PI_2) {
+			dec = -M_PI_2 - (dec + M_PI_2);
+			ra += M_PI;
+		}
+
+		/* make sure RA is between 0..360 */
+		ra += pair->ra;
+		if (ra > 2.0 * M_PI)
+			ra -= 2.0 * M_PI;
+		if (ra < 0.0)
+			ra += 2.0 * M_PI;
+
+		ra_sum[i] += ra;
+		dec_sum[i] += dec;
+		hits[i] += 1.0;
+	}
+}
+
+/* sum products from position i on, also finishing vector kernel tails */
+static double tail_dot(const double *a, const double *b, int i, int count,
+					   double sum)
+{
+	for (; i < count; i++)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+static int scalar_select_mag(const void *objects, int count, int stride,
+							 float min, float max, int *index)
+{
+	return tail_select_mag(objects, 0, count, stride, min, max, index, 0);
+}
+
+static int scalar_select_dec(const void *objects, int count, int stride,
+							 double min, double max, int *index)
+{
+	return tail_select_dec(objects, 0, count, stride, min, max, index, 0);
+}
+
+static int scalar_select_cone(const double *x, const double *y,
+							  const double *z, int count,
+							  const double centre[3], double cos_fov,
+							  int *index)
+{
+	return tail_select_cone(x, y, z, 0, count, centre, cos_fov, index, 0);
+}
+
+static void scalar_plate_to_equ(const double *x, const double *y, int count,
+								const struct simd_plate_pair *pair,
+								double *ra_sum, double *dec_sum, double *hits)
+{
+	tail_plate_to_equ(x, y, 0, count, pair, ra_sum, dec_sum, hits);
+}
+
+static double scalar_dot(const double *a, const double *b, int count)
+{
+	return tail_dot(a, b, 0, count, 0.0);
+}
+
+static const struct simd_kernels scalar_kernels = {
+	.select_mag = scalar_select_mag,
+	.select_dec = scalar_select_dec,
+	.select_cone = scalar_select_cone,
+	.plate_to_equ = scalar_plate_to_equ,
+	.dot = scalar_dot,
+};
+
+#ifdef SIMD_X86
+
+/* append the lanes set in a compare mask as object indices */
+static inline int mask_to_index(unsigned int mask, int base, int *index, int n)
+{
+	while (mask) {
+		index[n++] = base + __builtin_ctz(mask);
+		mask &= mask - 1;
+	}
+	return n;
+}
+
+__attribute__((target("avx2"))) static int
+avx2_select_mag(const void *objects, int count, int stride, float min,
+				float max, int *index)
+{
+	const char *object = objects;
+	const __m256i lanes = _mm256_mullo_epi32(
+		_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+	const __m256 vmin = _mm256_set1_ps(min), vmax = _mm256_set1_ps(max);
+	__m256 mag, in;
+	int i, n = 0;
+
+	for (i = 0; i + 8 <= count; i += 8, object += 8 * stride) {
+		mag = _mm256_i32gather_ps(&OBJECT_MAG(object), lanes, 1);
+		in = _mm256_and_ps(_mm256_cmp_ps(mag, vmin, _CMP_GE_OQ),
+						   _mm256_cmp_ps(mag, vmax, _CMP_LE_OQ));
+		n = mask_to_index(_mm256_movemask_ps(in), i, index, n);
+	}
+
+	return tail_select_mag(object, i, count, stride, min, max, index, n);
+}
+
+__attribute__((target("avx2"))) static int
+avx2_select_dec(const void *objects, int count, int stride, double min,
+				double max, int *index)
+{
+	const char *object = objects;
+	const __m128i lanes =
+		_mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(stride));
+	const __m256d vmin = _mm256_set1_pd(min), vmax = _mm256_set1_pd(max);
+	__m256d dec, in;
+	int i, n = 0;
+
+	for (i = 0; i + 4 <= count; i += 4, object += 4 * stride) {
+		dec = _mm256_i32gather_pd(&OBJECT_DEC(object), lanes, 1);
+		in = _mm256_and_pd(_mm256_cmp_pd(dec, vmin, _CMP_GE_OQ),
+						   _mm256_cmp_pd(dec, vmax, _CMP_LE_OQ));
+		n = mask_to_index(_mm256_movemask_pd(in), i, index, n);
+	}
+
+	return tail_select_dec(object, i, count, stride, min, max, index, n);
+}
+
+__attribute__((target("avx2"))) static int
+avx2_select_cone(const double *x, const double *y, const double *z, int count,
+				 const double centre[3], double cos_fov, int *index)
+{
+	const __m256d cx = _mm256_set1_pd(centre[0]),
+				  cy = _mm256_set1_pd(centre[1]),
+				  cz = _mm256_set1_pd(centre[2]),
+				  vcos = _mm256_set1_pd(cos_fov);
+	__m256d dot;
+	int i, n = 0;
+
+	/* same operation order as the scalar kernel for identical results */
+	for (i = 0; i + 4 <= count; i += 4) {
+		dot = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(x + i), cx),
+							_mm256_mul_pd(_mm256_loadu_pd(y + i), cy));
+		dot = _mm256_add_pd(dot, _mm256_mul_pd(_mm256_loadu_pd(z + i), cz));
+		n = mask_to_index(
+			_mm256_movemask_pd(_mm256_cmp_pd(dot, vcos, _CMP_GE_OQ)), i,
+			index, n);
+	}
+
+	return tail_select_cone(x, y, z, i, count, centre, cos_fov, index, n);
+}
+
+__attribute__((target("avx2"))) static void
+avx2_plate_to_equ(const double *x, const double *y, int count,
+				  const struct simd_plate_pair *pair, double *ra_sum,
+				  double *dec_sum, double *hits)
+{
+	const __m256d x1 = _mm256_set1_pd(pair->x1), y1 = _mm256_set1_pd(pair->y1),
+				  x2 = _mm256_set1_pd(pair->x2), y2 = _mm256_set1_pd(pair->y2),
+				  cos_pa = _mm256_set1_pd(pair->cos_pa),
+				  sin_pa = _mm256_set1_pd(pair->sin_pa),
+				  scale = _mm256_set1_pd(pair->rad_per_pix),
+				  cos_mid = _mm256_set1_pd(pair->cos_mid_dec),
+				  pra = _mm256_set1_pd(pair->ra),
+				  pdec = _mm256_set1_pd(pair->dec),
+				  sign = _mm256_set1_pd(-0.0), zero = _mm256_setzero_pd(),
+				  one = _mm256_set1_pd(1.0), pi = _mm256_set1_pd(M_PI),
+				  pi_2 = _mm256_set1_pd(M_PI_2),
+				  npi_2 = _mm256_set1_pd(-M_PI_2),
+				  two_pi = _mm256_set1_pd(2.0 * M_PI);
+	__m256d vx, vy, u, v, ra, dec, skip, hi, lo;
+	int i;
+
+	/* same operation order as the scalar kernel */
+	for (i = 0; i + 4 <= count; i += 4) {
+		vx = _mm256_loadu_pd(x + i);
+		vy = _mm256_loadu_pd(y + i);
+		skip = _mm256_or_pd(
+			_mm256_and_pd(_mm256_cmp_pd(vx, x1, _CMP_EQ_OQ),
+						  _mm256_cmp_pd(vy, y1, _CMP_EQ_OQ)),
+			_mm256_and_pd(_mm256_cmp_pd(vx, x2, _CMP_EQ_OQ),
+						  _mm256_cmp_pd(vy, y2, _CMP_EQ_OQ)));
+
+		u = _mm256_sub_pd(x1, vx);
+		v = _mm256_sub_pd(y1, vy);
+		ra = _mm256_add_pd(_mm256_mul_pd(u, cos_pa), _mm256_mul_pd(v, sin_pa));
+		ra = _mm256_div_pd(_mm256_mul_pd(_mm256_xor_pd(ra, sign), scale),
+						   cos_mid);
+		dec = _mm256_sub_pd(_mm256_mul_pd(v, cos_pa), _mm256_mul_pd(u, sin_pa));
+		dec = _mm256_add_pd(_mm256_mul_pd(_mm256_xor_pd(dec, sign), scale),
+							pdec);
+
+		hi = _mm256_cmp_pd(dec, pi_2, _CMP_GT_OQ);
+		lo = _mm256_cmp_pd(dec, npi_2, _CMP_LT_OQ);
+		dec = _mm256_blendv_pd(
+			dec, _mm256_sub_pd(pi_2, _mm256_sub_pd(dec, pi_2)), hi);
+		dec = _mm256_blendv_pd(
+			dec, _mm256_sub_pd(npi_2, _mm256_add_pd(dec, pi_2)), lo);
+		ra = _mm256_blendv_pd(ra, _mm256_add_pd(ra, pi), _mm256_or_pd(hi, lo));
+
+		ra = _mm256_add_pd(ra, pra);
+		ra = _mm256_blendv_pd(ra, _mm256_sub_pd(ra, two_pi),
+							  _mm256_cmp_pd(ra, two_pi, _CMP_GT_OQ));
+		ra = _mm256_blendv_pd(ra, _mm256_add_pd(ra, two_pi),
+							  _mm256_cmp_pd(ra, zero, _CMP_LT_OQ));
+
+		_mm256_storeu_pd(ra_sum + i,
+						 _mm256_add_pd(_mm256_loadu_pd(ra_sum + i),
+									   _mm256_andnot_pd(skip, ra)));
+		_mm256_storeu_pd(dec_sum + i,
+						 _mm256_add_pd(_mm256_loadu_pd(dec_sum + i),
+									   _mm256_andnot_pd(skip, dec)));
+		_mm256_storeu_pd(hits + i, _mm256_add_pd(_mm256_loadu_pd(hits + i),
+												 _mm256_andnot_pd(skip, one)));
+	}
+
+	tail_plate_to_equ(x, y, i, count, pair, ra_sum, dec_sum, hits);
+}
+
+__attribute__((target("avx2"))) static double
+avx2_dot(const double *a, const double *b, int count)
+{
+	__m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+	double lanes[4];
+	int i;
+
+	/* two accumulators hide the add latency */
+	for (i = 0; i + 8 <= count; i += 8) {
+		sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+												 _mm256_loadu_pd(b + i)));
+		sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4),
+												 _mm256_loadu_pd(b + i + 4)));
+	}
+
+	_mm256_storeu_pd(lanes, _mm256_add_pd(sum0, sum1));
+	return tail_dot(a, b, i, count,
+					(lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+}
+
+static const struct simd_kernels avx2_kernels = {
+	.select_mag = avx2_select_mag,
+	.select_dec = avx2_select_dec,
+	.select_cone = avx2_select_cone,
+	.plate_to_equ = avx2_plate_to_equ,
+	.dot = avx2_dot,
+};
+
+__attribute__((target("avx512f"))) static int
+avx512_select_mag(const void *objects, int count, int stride, float min,
+				  float max, int *index)
+{
+	const char *object = objects;
+	const __m512i lanes =
+		_mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+											 10, 11, 12, 13, 14, 15),
+						   _mm512_set1_epi32(stride));
+	const __m512 vmin = _mm512_set1_ps(min), vmax = _mm512_set1_ps(max);
+	__m512 mag;
+	__mmask16 in;
+	int i, n = 0;
+
+	for (i = 0; i + 16 <= count; i += 16, object += 16 * stride) {
+		mag = _mm512_i32gather_ps(lanes, &OBJECT_MAG(object), 1);
+		in = _mm512_cmp_ps_mask(mag, vmin, _CMP_GE_OQ);
+		in = _mm512_mask_cmp_ps_mask(in, mag, vmax, _CMP_LE_OQ);
+		n = mask_to_index(in, i, index, n);
+	}
+
+	return tail_select_mag(object, i, count, stride, min, max, index, n);
+}
+
+__attribute__((target("avx512f"))) static int
+avx512_select_dec(const void *objects, int count, int stride, double min,
+				  double max, int *index)
+{
+	const char *object = objects;
+	const __m256i lanes = _mm256_mullo_epi32(
+		_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+	const __m512d vmin = _mm512_set1_pd(min), vmax = _mm512_set1_pd(max);
+	__m512d dec;
+	__mmask8 in;
+	int i, n = 0;
+
+	for (i = 0; i + 8 <= count; i += 8, object += 8 * stride) {
+		dec = _mm512_i32gather_pd(lanes, &OBJECT_DEC(object), 1);
+		in = _mm512_cmp_pd_mask(dec, vmin, _CMP_GE_OQ);
+		in = _mm512_mask_cmp_pd_mask(in, dec, vmax, _CMP_LE_OQ);
+		n = mask_to_index(in, i, index, n);
+	}
+
+	return tail_select_dec(object, i, count, stride, min, max, index, n);
+}
+
+__attribute__((target("avx512f"))) static int
+avx512_select_cone(const double *x, const double *y, const double *z,
+				   int count, const double centre[3], double cos_fov,
+				   int *index)
+{
+	const __m512d cx = _mm512_set1_pd(centre[0]),
+				  cy = _mm512_set1_pd(centre[1]),
+				  cz = _mm512_set1_pd(centre[2]),
+				  vcos = _mm512_set1_pd(cos_fov);
+	__m512d dot;
+	int i, n = 0;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		dot = _mm512_add_pd(_mm512_mul_pd(_mm512_loadu_pd(x + i), cx),
+							_mm512_mul_pd(_mm512_loadu_pd(y + i), cy));
+		dot = _mm512_add_pd(dot, _mm512_mul_pd(_mm512_loadu_pd(z + i), cz));
+		n = mask_to_index(_mm512_cmp_pd_mask(dot, vcos, _CMP_GE_OQ), i, index,
+						  n);
+	}
+
+	return tail_select_cone(x, y, z, i, count, centre, cos_fov, index, n);
+}
+
+__attribute__((target("avx512f"))) static void
+avx512_plate_to_equ(const double *x, const double *y, int count,
+					const struct simd_plate_pair *pair, double *ra_sum,
+					double *dec_sum, double *hits)
+{
+	const __m512d x1 = _mm512_set1_pd(pair->x1), y1 = _mm512_set1_pd(pair->y1),
+				  x2 = _mm512_set1_pd(pair->x2), y2 = _mm512_set1_pd(pair->y2),
+				  cos_pa = _mm512_set1_pd(pair->cos_pa),
+				  sin_pa = _mm512_set1_pd(pair->sin_pa),
+				  scale = _mm512_set1_pd(pair->rad_per_pix),
+				  cos_mid = _mm512_set1_pd(pair->cos_mid_dec),
+				  pra = _mm512_set1_pd(pair->ra),
+				  pdec = _mm512_set1_pd(pair->dec),
+				  zero = _mm512_setzero_pd(), one = _mm512_set1_pd(1.0),
+				  pi = _mm512_set1_pd(M_PI), pi_2 = _mm512_set1_pd(M_PI_2),
+				  npi_2 = _mm512_set1_pd(-M_PI_2),
+				  two_pi = _mm512_set1_pd(2.0 * M_PI);
+	__m512d vx, vy, u, v, ra, dec;
+	__mmask8 keep, hi, lo;
+	int i;
+
+	/* same operation order as the scalar kernel */
+	for (i = 0; i + 8 <= count; i += 8) {
+		vx = _mm512_loadu_pd(x + i);
+		vy = _mm512_loadu_pd(y + i);
+		keep = ~((_mm512_cmp_pd_mask(vx, x1, _CMP_EQ_OQ) &
+				  _mm512_cmp_pd_mask(vy, y1, _CMP_EQ_OQ)) |
+				 (_mm512_cmp_pd_mask(vx, x2, _CMP_EQ_OQ) &
+				  _mm512_cmp_pd_mask(vy, y2, _CMP_EQ_OQ)));
+
+		u = _mm512_sub_pd(x1, vx);
+		v = _mm512_sub_pd(y1, vy);
+		ra = _mm512_add_pd(_mm512_mul_pd(u, cos_pa), _mm512_mul_pd(v, sin_pa));
+		ra = _mm512_div_pd(_mm512_mul_pd(_mm512_sub_pd(zero, ra), scale),
+						   cos_mid);
+		dec = _mm512_sub_pd(_mm512_mul_pd(v, cos_pa), _mm512_mul_pd(u, sin_pa));
+		dec = _mm512_add_pd(_mm512_mul_pd(_mm512_sub_pd(zero, dec), scale),
+							pdec);
+
+		hi = _mm512_cmp_pd_mask(dec, pi_2, _CMP_GT_OQ);
+		lo = _mm512_cmp_pd_mask(dec, npi_2, _CMP_LT_OQ);
+		dec = _mm512_mask_sub_pd(dec, hi, pi_2, _mm512_sub_pd(dec, pi_2));
+		dec = _mm512_mask_sub_pd(dec, lo, npi_2, _mm512_add_pd(dec, pi_2));
+		ra = _mm512_mask_add_pd(ra, hi | lo, ra, pi);
+
+		ra = _mm512_add_pd(ra, pra);
+		ra = _mm512_mask_sub_pd(ra, _mm512_cmp_pd_mask(ra, two_pi, _CMP_GT_OQ),
+								ra, two_pi);
+		ra = _mm512_mask_add_pd(ra, _mm512_cmp_pd_mask(ra, zero, _CMP_LT_OQ),
+								ra, two_pi);
+
+		_mm512_storeu_pd(ra_sum + i, _mm512_mask_add_pd(
+										 _mm512_loadu_pd(ra_sum + i), keep,
+										 _mm512_loadu_pd(ra_sum + i), ra));
+		_mm512_storeu_pd(dec_sum + i, _mm512_mask_add_pd(
+										  _mm512_loadu_pd(dec_sum + i), keep,
+										  _mm512_loadu_pd(dec_sum + i), dec));
+		_mm512_storeu_pd(hits + i,
+						 _mm512_mask_add_pd(_mm512_loadu_pd(hits + i), keep,
+											_mm512_loadu_pd(hits + i), one));
+	}
+
+	tail_plate_to_equ(x, y, i, count, pair, ra_sum, dec_sum, hits);
+}
+
+__attribute__((target("avx512f"))) static double
+avx512_dot(const double *a, const double *b, int count)
+{
+	__m512d sum0 = _mm512_setzero_pd(), sum1 = _mm512_setzero_pd();
+	int i;
+
+	/* two accumulators hide the add latency */
+	for (i = 0; i + 16 <= count; i += 16) {
+		sum0 = _mm512_add_pd(sum0, _mm512_mul_pd(_mm512_loadu_pd(a + i),
+												 _mm512_loadu_pd(b + i)));
+		sum1 = _mm512_add_pd(sum1, _mm512_mul_pd(_mm512_loadu_pd(a + i + 8),
+												 _mm512_loadu_pd(b + i + 8)));
+	}
+
+	return tail_dot(a, b, i, count,
+					_mm512_reduce_add_pd(_mm512_add_pd(sum0, sum1)));
+}
+
+static const struct simd_kernels avx512_kernels = {
+	.select_mag = avx512_select_mag,
+	.select_dec = avx512_select_dec,
+	.select_cone = avx512_select_cone,
+	.plate_to_equ = avx512_plate_to_equ,
+	.dot = avx512_dot,
+};
+
+#endif
+
+static const struct simd_kernels *kernels;
+static enum simd_level kernels_level;
+
+/**
+ * \brief Check if the CPU supports an instruction set.
+ *
+ * \param level Instruction set.
+ * \return 1 if supported, 0 otherwise.
+ */
+static int simd_supported(enum simd_level level)
+{
+	switch (level) {
+	case SIMD_SCALAR:
+		return 1;
+#ifdef SIMD_X86
+	case SIMD_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+	case SIMD_AVX512:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx512f");
+#endif
+	default:
+		return 0;
+	}
+}
+
+int simd_set_level(enum simd_level level)
+{
+	if (!simd_supported(level))
+		return -EINVAL;
+
+	switch (level) {
+#ifdef SIMD_X86
+	case SIMD_AVX512:
+		kernels = &avx512_kernels;
+		break;
+	case SIMD_AVX2:
+		kernels = &avx2_kernels;
+		break;
+#endif
+	default:
+		kernels = &scalar_kernels;
+		break;
+	}
+
+	kernels_level = level;
+	return 0;
+}
+
+/**
+ * \brief Get the kernels, selecting them on first use.
+ *
+ * \return Filter kernels.
+ */
+static const struct simd_kernels *simd_kernels(void)
+{
+	enum simd_level level = SIMD_AVX512;
+	const char *env;
+
+	if (kernels)
+		return kernels;
+
+	env = getenv("ADB_SIMD");
+	if (env && !strcmp(env, "scalar"))
+		level = SIMD_SCALAR;
+	else if (env && !strcmp(env, "avx2"))
+		level = SIMD_AVX2;
+
+	/* fall back to the widest supported kernels */
+	while (simd_set_level(level) < 0)
+		level--;
+
+	return kernels;
+}
+
+enum simd_level simd_get_level(void)
+{
+	simd_kernels();
+	return kernels_level;
+}
+
+int simd_select_mag(const void *objects, int count, int stride, float min,
+					float max, int *index)
+{
+	return simd_kernels()->select_mag(objects, count, stride, min, max, index);
+}
+
+int simd_select_dec(const void *objects, int count, int stride, double min,
+					double max, int *index)
+{
+	return simd_kernels()->select_dec(objects, count, stride, min, max, index);
+}
+
+int simd_select_cone(const double *x, const double *y, const double *z,
+					 int count, const double centre[3], double cos_fov,
+					 int *index)
+{
+	return simd_kernels()->select_cone(x, y, z, count, centre, cos_fov,
+									   index);
+}
+
+void simd_plate_to_equ(const double *x, const double *y, int count,
+					   const struct simd_plate_pair *pair, double *ra_sum,
+					   double *dec_sum, double *hits)
+{
+	simd_kernels()->plate_to_equ(x, y, count, pair, ra_sum, dec_sum, hits);
+}
+
+double simd_dot(const double *a, const double *b, int count)
+{
+	return simd_kernels()->dot(a, b, count);
+}
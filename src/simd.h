@@ -0,0 +1,158 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#ifndef __ADB_SIMD_H
+#define __ADB_SIMD_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+/*! \defgroup simd SIMD
+ *
+ * \brief Vectorised object filter and transform kernels.
+ *
+ * Filters runs of objects in their on disk layout, gathering the filtered
+ * field at the object stride, or runs of table field arrays, and transforms
+ * runs of plate positions. The widest kernels supported by the CPU are
+ * selected at run time.
+ */
+
+/* object count filtered per call by chunked callers */
+#define SIMD_CHUNK 256
+
+/*! \enum simd_level
+ * \ingroup simd
+ *
+ * Filter kernel instruction set.
+ */
+enum simd_level {
+	SIMD_SCALAR = 0, /*!< portable C */
+	SIMD_AVX2 = 1, /*!< AVX2 gathers */
+	SIMD_AVX512 = 2, /*!< AVX-512F gathers and mask compares */
+};
+
+/*! \struct simd_plate_pair
+ * \ingroup simd
+ *
+ * Plate to equatorial transform taken from one pair of reference objects.
+ */
+struct simd_plate_pair {
+	double x1, y1; /*!< plate position of the first reference */
+	double x2, y2; /*!< plate position of the second reference */
+	double ra, dec; /*!< equatorial position of the first reference */
+	double cos_pa, sin_pa; /*!< plate to equatorial rotation */
+	double rad_per_pix; /*!< plate scale */
+	double cos_mid_dec; /*!< cosine of the mean reference declination */
+};
+
+/**
+ * \brief Select the filter kernels.
+ * \ingroup simd
+ * \param level Instruction set to use.
+ * \return 0 on success or -EINVAL if the CPU lacks the instruction set.
+ */
+int simd_set_level(enum simd_level level);
+
+/**
+ * \brief Get the filter kernels in use.
+ * \ingroup simd
+ *
+ * Defaults to the widest supported instruction set, the ADB_SIMD
+ * environment variable ("scalar", "avx2" or "avx512") lowers it.
+ *
+ * \return Selected instruction set.
+ */
+enum simd_level simd_get_level(void);
+
+/**
+ * \brief Select objects with a magnitude in a range.
+ * \ingroup simd
+ * \param objects First object.
+ * \param count Number of objects.
+ * \param stride Object size in bytes.
+ * \param min Smallest magnitude selected.
+ * \param max Largest magnitude selected.
+ * \param index Output ascending indices of selected objects, count long.
+ * \return Number of selected objects.
+ */
+int simd_select_mag(const void *objects, int count, int stride, float min,
+					float max, int *index);
+
+/**
+ * \brief Select objects with a declination in a range.
+ * \ingroup simd
+ * \param objects First object.
+ * \param count Number of objects.
+ * \param stride Object size in bytes.
+ * \param min Smallest declination selected.
+ * \param max Largest declination selected.
+ * \param index Output ascending indices of selected objects, count long.
+ * \return Number of selected objects.
+ */
+int simd_select_dec(const void *objects, int count, int stride, double min,
+					double max, int *index);
+
+/**
+ * \brief Select unit vectors inside a cone.
+ * \ingroup simd
+ * \param x First unit vector X.
+ * \param y First unit vector Y.
+ * \param z First unit vector Z.
+ * \param count Number of unit vectors.
+ * \param centre Cone centre unit vector.
+ * \param cos_fov Cosine of the cone radius.
+ * \param index Output ascending indices of selected vectors, count long.
+ * \return Number of selected vectors.
+ */
+int simd_select_cone(const double *x, const double *y, const double *z,
+					 int count, const double centre[3], double cos_fov,
+					 int *index);
+
+/**
+ * \brief Add the plate to equatorial transform of one reference pair.
+ * \ingroup simd
+ *
+ * Positions at either reference plate position are skipped.
+ *
+ * \param x Plate X positions.
+ * \param y Plate Y positions.
+ * \param count Number of positions.
+ * \param pair Reference pair transform.
+ * \param ra_sum RA sums, count long.
+ * \param dec_sum DEC sums, count long.
+ * \param hits Pairs added to each sum, count long.
+ */
+void simd_plate_to_equ(const double *x, const double *y, int count,
+					   const struct simd_plate_pair *pair, double *ra_sum,
+					   double *dec_sum, double *hits);
+
+/**
+ * \brief Sum the products of two arrays.
+ * \ingroup simd
+ *
+ * Vector kernels add the products in a different order, so results can
+ * differ from the scalar kernel in the last bits.
+ *
+ * \param a First array.
+ * \param b Second array.
+ * \param count Array length.
+ * \return Sum of a[i] * b[i].
+ */
+double simd_dot(const double *a, const double *b, int count);
+
+#endif
+#endif
@@ -27,18 +27,18 @@
 #include "solve.h"
 
 /**
- * \brief Comparison callback for sorting solutions by divergence.
+ * \brief Comparison callback for sorting candidates by divergence.
  *
- * Used by `qsort` to order an array of candidate solver solutions based on 
+ * Used by `qsort` to order an array of candidate solver matches based on 
  * their computed divergence error. Lower divergence indicates a better match.
  *
- * \param o1 Pointer to the first solution.
- * \param o2 Pointer to the second solution.
+ * \param o1 Pointer to the first candidate.
+ * \param o2 Pointer to the second candidate.
  * \return 1 if o1 has higher divergence, -1 if o2 has higher divergence, 0 if equal.
  */
 static int solution_cmp(const void *o1, const void *o2)
 {
-	const struct adb_solve_solution *p1 = o1, *p2 = o2;
+	const struct solve_candidate *p1 = o1, *p2 = o2;
 
 	if (p1->divergance < p2->divergance)
 		return 1;
@@ -103,6 +103,114 @@ static void calc_object_divergence(struct solve_runtime *runtime,
 	}
 }
 
+/**
+ * \brief Comparison callback for sorting source objects on distance.
+ *
+ * \param o1 Pointer to the first source distance.
+ * \param o2 Pointer to the second source distance.
+ * \return -1, 0 or 1 as o1 is nearer, as near or further than o2.
+ */
+static int source_distance_cmp(const void *o1, const void *o2)
+{
+	const struct source_distance *d1 = o1, *d2 = o2;
+
+	if (d1->distance < d2->distance)
+		return -1;
+	else if (d1->distance > d2->distance)
+		return 1;
+	else
+		return 0;
+}
+
+/**
+ * \brief Comparison callback for sorting source positions.
+ *
+ * \param o1 Pointer to the first position.
+ * \param o2 Pointer to the second position.
+ * \return Negative, 0 or positive as o1 is before, at or after o2.
+ */
+static int source_index_cmp(const void *o1, const void *o2)
+{
+	const int *i1 = o1, *i2 = o2;
+
+	return *i1 - *i2;
+}
+
+/**
+ * \brief Order the solution source objects on distance to object 0.
+ *
+ * \param solution The solution with its search limits set.
+ * \return 0 on success or -ENOMEM.
+ */
+static int solution_index_source(struct adb_solve_solution *solution)
+{
+	struct source_distance *sd;
+	int i;
+
+	if (solution->source_distance != NULL)
+		return 0;
+
+	sd = calloc(solution->source.num_objects + 1, sizeof(*sd));
+	solution->source_index =
+		calloc(solution->source.num_objects + 1, sizeof(int));
+	if (sd == NULL || solution->source_index == NULL) {
+		free(sd);
+		free(solution->source_index);
+		solution->source_index = NULL;
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < solution->source.num_objects; i++) {
+		sd[i].distance = distance_get_equ(solution->object[0],
+										  solution->source.objects[i]);
+		sd[i].index = i;
+	}
+
+	qsort(sd, solution->source.num_objects, sizeof(*sd), source_distance_cmp);
+	solution->source_distance = sd;
+	return 0;
+}
+
+/**
+ * \brief Pick the magnitude candidates at the pattern distance from object 0.
+ *
+ * The distance check to object 0 is the first single object check, so
+ * only the source objects in that annulus can match. They are returned in
+ * source order, the order distance_solve_single_object() checks them.
+ *
+ * \param runtime Runtime with the magnitude range and single object target.
+ * \param solution The solution with its source ordered on distance.
+ * \return Number of candidates in solution->source_index.
+ */
+static int get_annulus_candidates(struct solve_runtime *runtime,
+								  struct adb_solve_solution *solution)
+{
+	struct target_solve_mag *range = &runtime->pot_magnitude;
+	struct source_distance *sd = solution->source_distance;
+	double min = runtime->soln_target[0].distance.pattern_min;
+	double max = runtime->soln_target[0].distance.pattern_max;
+	int low = 0, high = solution->source.num_objects, mid, count = 0;
+
+	/* first source object at or beyond the inner radius */
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (sd[mid].distance < min)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (; low < solution->source.num_objects && sd[low].distance <= max;
+		 low++) {
+		if (sd[low].index >= range->start_pos[0] &&
+			sd[low].index < range->end_pos[0])
+			solution->source_index[count++] = sd[low].index;
+	}
+
+	qsort(solution->source_index, count, sizeof(int), source_index_cmp);
+	return count;
+}
+
 /**
  * \brief Associate a raw photographic plate object with a catalog source identification.
  *
@@ -128,9 +236,8 @@ static int get_object(struct adb_solve *solve, int object_id,
 	if (solution->set == NULL)
 		return -EINVAL;
 
-	memset(&runtime, 0, sizeof(runtime));
+	solve_runtime_reset(&runtime, solve);
 	memset(sobject, 0, sizeof(*sobject));
-	runtime.solve = solve;
 
 	/* check if pobject is solve object from solution */
 	if (solve->solution == solution) {
@@ -153,8 +260,14 @@ static int get_object(struct adb_solve *solve, int object_id,
 		return 0;
 
 	/* at this point we have a range of candidate stars that match the
-	 * magnitude bounds of the plate object now check for distance alignment */
-	count = distance_solve_single_object(&runtime, solution);
+	 * magnitude bounds of the plate object, only those at the right distance
+	 * from object 0 need the distance alignment checks */
+	count = get_annulus_candidates(&runtime, solution);
+	if (count == 0)
+		return 0;
+
+	count = distance_solve_single_object_list(&runtime, solution,
+											  solution->source_index, count);
 	if (count == 0)
 		return 0;
 
@@ -165,7 +278,7 @@ static int get_object(struct adb_solve *solve, int object_id,
 		return 0;
 
 	/* it's possible we may have > 1 potential object so order them */
-	qsort(&runtime.pot_pa, count, sizeof(struct adb_solve_solution),
+	qsort(&runtime.pot_pa, runtime.num_pot_pa, sizeof(struct solve_candidate),
 		  solution_cmp);
 
 	/* assign closest object */
@@ -203,9 +316,8 @@ static int get_extended_object(struct adb_solve *solve, int object_id,
 	if (solution->set == NULL)
 		return -EINVAL;
 
-	memset(&runtime, 0, sizeof(runtime));
+	solve_runtime_reset(&runtime, solve);
 	memset(sobject, 0, sizeof(*sobject));
-	runtime.solve = solve;
 
 	/* calculate plate parameters for new object */
 	target_create_single(solve, pobject, solution, &runtime);
@@ -255,6 +367,13 @@ int adb_solution_set_search_limits(struct adb_solve_solution *solution,
 	set = solution->set;
 	if (set)
 		adb_table_set_free(set);
+	free(solution->source.objects);
+	free(solution->source_distance);
+	free(solution->source_index);
+	solution->source.objects = NULL;
+	solution->source.num_objects = 0;
+	solution->source_distance = NULL;
+	solution->source_index = NULL;
 
 	centre_ra = solution->object[0]->ra;
 	centre_dec = solution->object[0]->dec;
@@ -447,6 +566,12 @@ int adb_solution_get_objects(struct adb_solve_solution *solution)
 	solve->exit = 0;
 	solve->progress = 0;
 
+	if (solution->set != NULL) {
+		ret = solution_index_source(solution);
+		if (ret < 0)
+			return ret;
+	}
+
 	/* solve each new plate object */
 #if 0 /* race condition somewhere cause a few differences in detected objects */
 #pragma omp parallel for schedule(dynamic, 10) private(ret) \
@@ -581,6 +706,46 @@ void adb_solution_plate_to_equ_position_fast(
 	posn_plate_to_equ_fast(solution, &p, ra, dec);
 }
 
+int adb_solution_plate_to_equ_positions(struct adb_solve_solution *solution,
+										const double *x, const double *y,
+										int count, double *ra, double *dec)
+{
+	if (count < 0)
+		return -EINVAL;
+
+	return posn_plate_to_equ_array(solution, x, y, count, ra, dec, 0);
+}
+
+int adb_solution_equ_to_plate_positions(struct adb_solve_solution *solution,
+										const double *ra, const double *dec,
+										int count, double *x, double *y)
+{
+	if (count < 0)
+		return -EINVAL;
+
+	return posn_equ_to_plate_array(solution, ra, dec, count, x, y, 0);
+}
+
+int adb_solution_plate_to_equ_positions_fast(
+	struct adb_solve_solution *solution, const double *x, const double *y,
+	int count, double *ra, double *dec)
+{
+	if (count < 0)
+		return -EINVAL;
+
+	return posn_plate_to_equ_array(solution, x, y, count, ra, dec, 1);
+}
+
+int adb_solution_equ_to_plate_positions_fast(
+	struct adb_solve_solution *solution, const double *ra, const double *dec,
+	int count, double *x, double *y)
+{
+	if (count < 0)
+		return -EINVAL;
+
+	return posn_equ_to_plate_array(solution, ra, dec, count, x, y, 1);
+}
+
 /*
  * Get the plate boundaries using solution.
  */
@@ -17,16 +17,45 @@
  */
 
 #include <errno.h> // IWYU pragma: keep
+#include <limits.h>
 #include <math.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "alloc.h"
 #include "debug.h"
 #include "lib.h"
 #include "solve.h"
 
+/* primaries claimed at a time by each solver thread */
+#define SOLVE_CHUNK 8
+
+/* timed solve passes, each doubling the tolerances of the last */
+#define SOLVE_PASSES 3
+
+/*! \struct solve_thread
+ * \brief Solver thread state.
+ *
+ * Candidates are buffered per thread in primary order and merged into the
+ * solver after the threads are joined.
+ */
+struct solve_thread {
+	struct adb_solve *solve; /*!< solver */
+	struct adb_source_objects *primaries; /*!< primaries to try */
+	struct solve_runtime runtime; /*!< reused for each primary */
+	struct solve_candidate solution[MAX_RT_SOLUTIONS]; /*!< candidates */
+	int primary[MAX_RT_SOLUTIONS]; /*!< primary index of each solution */
+	int num_solutions; /*!< solutions found */
+	int merged; /*!< solutions merged */
+	int first; /*!< stop after the first solved primary */
+	int overflow; /*!< solutions were dropped */
+	int worker; /*!< worker index, 0 for the calling thread */
+	pthread_t thread; /*!< thread, unused by the calling thread */
+};
+
 /**
  * \brief Sorts solver solutions sequentially determining the best match.
  *
@@ -65,7 +94,7 @@ static double calc_magnitude_deltas(struct solve_runtime *runtime, int pot,
 									int idx)
 {
 	struct adb_solve *solve = runtime->solve;
-	struct adb_solve_solution *s = &runtime->pot_pa[pot];
+	struct solve_candidate *s = &runtime->pot_pa[pot];
 	double plate_diff, db_diff;
 
 	plate_diff = mag_get_plate_diff(&solve->plate.object[idx],
@@ -103,88 +132,115 @@ static void calc_cluster_divergence(struct solve_runtime *runtime)
 	}
 }
 
+/**
+ * \brief Check whether two clusters are made of the same 4 catalog objects.
+ *
+ * \param o1 Objects of the first cluster.
+ * \param o2 Objects of the second cluster.
+ * \return 1 if identical, 0 otherwise.
+ */
+static int is_same_cluster(const struct adb_object *const *o1,
+						   const struct adb_object *const *o2)
+{
+	return o1[0] == o2[0] && o1[1] == o2[1] && o1[2] == o2[2] &&
+		   o1[3] == o2[3];
+}
+
 /**
  * \brief Verify if a candidate configuration mirrors an existing recorded solution.
  *
  * Iterates across current finalized solutions checking explicit celestial
  * component structures addressing the identical 4 stars.
  *
- * \param solve Core solver environment.
- * \param s1 The new solution layout proposing 4 catalog objects.
+ * \param solve Parent master context retaining active solution arrays tracking.
+ * \param c The new candidate proposing 4 catalog objects.
  * \return 1 if identical to prior knowledge, 0 for unique new record.
  */
 static int is_solution_dupe(struct adb_solve *solve,
-							struct adb_solve_solution *s1)
+							const struct solve_candidate *c)
 {
-	struct adb_solve_solution *s2;
 	int i;
 
 	for (i = 0; i < solve->num_solutions; i++) {
-		s2 = &solve->solution[i];
-		if (s2->object[0] == s1->object[0] && s2->object[1] == s1->object[1] &&
-			s2->object[2] == s1->object[2] && s2->object[3] == s1->object[3]) {
+		if (is_same_cluster(solve->solution[i].object, c->object))
 			return 1;
-		}
 	}
 	return 0;
 }
 
 /**
- * \brief Lock and duplicate functional valid runtime candidates to public arrays.
+ * \brief Record the surviving runtime candidates in the solver thread buffer.
  *
- * Operates a mutex-controlled commit step for threaded concurrent search spaces,
- * registering any candidates overcoming thresholds safely into parent state buffers.
+ * Each thread keeps its own candidates in primary order so no locking is
+ * needed, the buffers are merged once the threads are done.
  *
- * \param runtime Executed runtime structure mapping valid position angles buffers.
+ * \param thread Solver thread that tried the primary.
+ * \param index Position of the primary in the solver primaries.
  */
-static void copy_solution(struct solve_runtime *runtime)
+static void copy_solution(struct solve_thread *thread, int index)
 {
-	struct adb_solve *solve = runtime->solve;
-	struct adb_solve_solution *soln;
-	struct adb_db *db;
-	int i;
+	struct solve_runtime *runtime = &thread->runtime;
+	int i, j;
 
-	/* solution array is shared between threads */
-	pthread_mutex_lock(&solve->mutex);
+	for (i = 0; i < runtime->num_pot_pa; i++) {
+		/* too many solutions ? reported when merging */
+		if (thread->num_solutions == MAX_RT_SOLUTIONS) {
+			thread->overflow = 1;
+			return;
+		}
 
-	/* too many solutions ? */
-	if (solve->num_solutions == MAX_RT_SOLUTIONS) {
-		adb_error(solve->db, "too many solutions, narrow params\n");
-		pthread_mutex_unlock(&solve->mutex);
-		return;
+		for (j = 0; j < thread->num_solutions; j++) {
+			if (is_same_cluster(thread->solution[j].object,
+								runtime->pot_pa[i].object))
+				break;
+		}
+		if (j < thread->num_solutions)
+			continue;
+
+		thread->primary[thread->num_solutions] = index;
+		thread->solution[thread->num_solutions++] = runtime->pot_pa[i];
 	}
+}
 
-	for (i = 0; i < runtime->num_pot_pa; i++) {
-		soln = &solve->solution[solve->num_solutions];
-		db = soln->db;
+/**
+ * \brief Get the monotonic clock in nanoseconds.
+ *
+ * \return Current time.
+ */
+static long long solve_clock_ns(void)
+{
+	struct timespec ts;
 
-		/* is duplicate then try next. FIXME, just return here ? */
-		if (is_solution_dupe(solve, &runtime->pot_pa[i]))
-			continue;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-		/* copy solution */
-		*soln = runtime->pot_pa[i];
-		soln->solve = solve;
-		soln->db = db;
+int solve_expired(struct adb_solve *solve)
+{
+	if (__atomic_load_n(&solve->exit, __ATOMIC_RELAXED))
+		return 1;
 
-		adb_info(db, ADB_LOG_SOLVE, "Adding solution %d\n",
-				 solve->num_solutions);
-		adb_info(db, ADB_LOG_SOLVE, " plate 0: X %d Y %d ADU %d\n",
-				 soln->soln_pobject[0].x, soln->soln_pobject[0].y,
-				 soln->soln_pobject[0].adu);
-		adb_info(db, ADB_LOG_SOLVE, " plate 1: X %d Y %d ADU %d\n",
-				 soln->soln_pobject[1].x, soln->soln_pobject[1].y,
-				 soln->soln_pobject[1].adu);
-		adb_info(db, ADB_LOG_SOLVE, " plate 2: X %d Y %d ADU %d\n",
-				 soln->soln_pobject[2].x, soln->soln_pobject[2].y,
-				 soln->soln_pobject[2].adu);
-		adb_info(db, ADB_LOG_SOLVE, " plate 3: X %d Y %d ADU %d\n",
-				 soln->soln_pobject[3].x, soln->soln_pobject[3].y,
-				 soln->soln_pobject[3].adu);
-		solve->num_solutions++;
-	}
+	if (solve->deadline == 0 || solve_clock_ns() < solve->deadline)
+		return 0;
+
+	__atomic_store_n(&solve->exit, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+/**
+ * \brief Lower the first solved primary for ADB_FIND_FIRST solves.
+ *
+ * \param solve Solver context.
+ * \param index Position of a primary with a solution.
+ */
+static void solve_set_first(struct adb_solve *solve, int index)
+{
+	int first = __atomic_load_n(&solve->first, __ATOMIC_RELAXED);
 
-	pthread_mutex_unlock(&solve->mutex);
+	while (index < first &&
+		   !__atomic_compare_exchange_n(&solve->first, &first, index, 0,
+										__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
 }
 
 /**
@@ -195,114 +251,271 @@ static void copy_solution(struct solve_runtime *runtime)
  * verifies secondary geometries by separation distances, validates asterisms against
  * exact position angles layouts, scoring surviving outputs via discrepancy coefficients.
  *
- * \param solve Orchestrating astrometrist context.
+ * \param thread Solver thread collecting the solutions.
  * \param primary Specific catalog item tested as the anchor center node.
- * \return Overall system solutions accumulated so far during the validation execution.
+ * \param index Position of the primary in the solver primaries.
+ * \return Number of solutions found for the primary.
  */
-static int try_object_as_primary(struct adb_solve *solve,
-								 const struct adb_object *primary)
+static int try_object_as_primary(struct solve_thread *thread,
+								 const struct adb_object *primary, int index)
 {
-	struct solve_runtime runtime;
-	int i, count;
+	struct adb_solve *solve = thread->solve;
+	struct solve_runtime *runtime = &thread->runtime;
+	int i, count, mags = 0;
 
-	memset(&runtime, 0, sizeof(runtime));
-	runtime.solve = solve;
+	solve_runtime_reset(runtime, solve);
+	stats_add(&solve->db->stats, STATS_SOLVE_PRIMARIES, 1);
 	adb_vdebug(solve->db, ADB_LOG_SOLVE, "\n");
 	/* find secondary candidate adb_source_objects on magnitude */
 	for (i = 0; i < MIN_PLATE_OBJECTS - 1; i++) {
-		count = mag_solve_object(&runtime, primary, i);
+		count = mag_solve_object(runtime, primary, i);
 		if (!count)
 			return 0;
+		mags += count;
 	}
+	stats_add(&solve->db->stats, STATS_SOLVE_MAG, mags);
 	adb_vdebug(solve->db, ADB_LOG_SOLVE, "\n");
 	/* at this point we have a range of candidate stars that match the
    * magnitude bounds of the primary object and each secondary object,
    * now check secondary candidates for distance alignment */
-	count = distance_solve_object(&runtime, primary);
+	trace_begin(&solve->db->trace, ADB_TRACE_SOLVE_DIST, 0);
+	count = distance_solve_object(runtime, primary);
+	trace_end(&solve->db->trace, ADB_TRACE_SOLVE_DIST, count);
+	stats_add(&solve->db->stats, STATS_SOLVE_DIST, count);
 	if (!count)
 		return 0;
 	adb_vdebug(solve->db, ADB_LOG_SOLVE, "\n");
 	/* At this point we have a list of clusters that match on magnitude and
    * distance, so we finally check the candidates clusters for PA alignment*/
-	count = pa_solve_object(&runtime, primary, i);
+	trace_begin(&solve->db->trace, ADB_TRACE_SOLVE_PA, 0);
+	count = pa_solve_object(runtime, primary, i);
+	trace_end(&solve->db->trace, ADB_TRACE_SOLVE_PA, count);
+	stats_add(&solve->db->stats, STATS_SOLVE_PA, count);
 	if (!count)
 		return 0;
 	adb_vdebug(solve->db, ADB_LOG_SOLVE, "\n");
-	calc_cluster_divergence(&runtime);
+	calc_cluster_divergence(runtime);
 
-	/* copy matching clusters to solver */
-	copy_solution(&runtime);
+	/* copy matching clusters to the thread */
+	copy_solution(thread, index);
 
-	return solve->num_solutions;
+	if (thread->first)
+		solve_set_first(solve, index);
+
+	return runtime->num_pot_pa;
+}
+
+/**
+ * \brief Try primaries claimed in chunks until none are left.
+ *
+ * Chunks are claimed in primary order, so once a primary after the first
+ * ADB_FIND_FIRST solution is claimed every primary that could come before
+ * it has been claimed too and the thread can stop. adb_solve_stop() is
+ * checked before each primary.
+ *
+ * \param data Solver thread.
+ * \return NULL.
+ */
+static void *solve_thread_run(void *data)
+{
+	struct solve_thread *thread = data;
+	struct adb_solve *solve = thread->solve;
+	struct adb_source_objects *primaries = thread->primaries;
+	int i, end, found;
+
+	/* the calling thread stays where the application put it */
+	if (thread->worker)
+		alloc_bind_worker(solve->db, thread->worker);
+
+	for (;;) {
+		i = __atomic_fetch_add(&solve->next, SOLVE_CHUNK, __ATOMIC_RELAXED);
+		if (i >= primaries->num_objects)
+			return NULL;
+
+		end = i + SOLVE_CHUNK;
+		if (end > primaries->num_objects)
+			end = primaries->num_objects;
+
+		for (; i < end; i++) {
+			if (solve_expired(solve) ||
+				i > __atomic_load_n(&solve->first, __ATOMIC_RELAXED))
+				return NULL;
+
+			trace_begin(&solve->db->trace, ADB_TRACE_SOLVE_PRIMARY, i);
+			found = try_object_as_primary(thread, primaries->objects[i], i);
+			trace_end(&solve->db->trace, ADB_TRACE_SOLVE_PRIMARY, found);
+			__atomic_add_fetch(&solve->progress, 1, __ATOMIC_RELAXED);
+		}
+	}
 }
 
 /**
- * \brief Iteratively scan ALL subset entities checking matches generating solutions parallel bounds.
+ * \brief Merge the solver thread solutions into the solver.
+ *
+ * Solutions are merged in primary order, which is the order a single
+ * thread finds them, so the result doesn't depend on the thread count.
  *
- * \param solve Primary execution constraints state framework context.
- * \param set Core physical source space defining raw object mappings structures.
- * \return Number of matching candidate geometries located during exploration matrix.
+ * \param solve Solver context.
+ * \param thread Solver threads.
+ * \param threads Number of solver threads.
+ * \return Number of solutions added.
  */
-static int solve_plate_cluster_for_set_all(struct adb_solve *solve,
-										   struct adb_object_set *set)
+static int solve_merge_solutions(struct adb_solve *solve,
+								 struct solve_thread *thread, int threads)
 {
+	struct adb_solve_solution *soln;
+	struct solve_candidate *next;
+	struct solve_thread *best;
+	struct adb_db *db;
 	int i, count = 0;
 
-	/* attempt to solve for each object in set */
-#if HAVE_OPENMP
-#pragma omp parallel for schedule(dynamic, 10) reduction(+ : count)
-#endif
-	for (i = 0; i < solve->haystack.num_objects; i++) {
-		solve->progress++;
+	for (;;) {
+		/* lowest primary left in the thread buffers */
+		for (i = 0, best = NULL; i < threads; i++) {
+			if (thread[i].merged == thread[i].num_solutions)
+				continue;
+			if (best == NULL || thread[i].primary[thread[i].merged] <
+									best->primary[best->merged])
+				best = &thread[i];
+		}
+
+		if (best == NULL)
+			break;
+
+		/* only the first solved primary for ADB_FIND_FIRST */
+		if (best->primary[best->merged] > solve->first)
+			break;
 
-		/* we cant break OpenMP loops */
-		if (solve->exit)
+		next = &best->solution[best->merged++];
+
+		/* is duplicate then try next */
+		if (is_solution_dupe(solve, next))
 			continue;
 
-		count += try_object_as_primary(solve, solve->haystack.objects[i]);
+		/* too many solutions ? */
+		if (solve->num_solutions == MAX_RT_SOLUTIONS) {
+			best->overflow = 1;
+			break;
+		}
+
+		/* materialise the solution from the candidate */
+		soln = &solve->solution[solve->num_solutions];
+		db = soln->db;
+		memset(soln, 0, sizeof(*soln));
+		soln->solve = solve;
+		soln->db = db;
+		for (i = 0; i < MIN_PLATE_OBJECTS; i++) {
+			soln->object[i] = next->object[i];
+			soln->soln_pobject[i] =
+				solve->plate.object[solve->plate.window_start + i];
+		}
+		soln->delta = next->delta;
+		soln->divergance = next->divergance;
+		soln->rad_per_pix = next->rad_per_pix;
+		soln->flip = next->flip;
+
+		adb_info(db, ADB_LOG_SOLVE, "Adding solution %d\n",
+				 solve->num_solutions);
+		adb_info(db, ADB_LOG_SOLVE, " plate 0: X %d Y %d ADU %d\n",
+				 soln->soln_pobject[0].x, soln->soln_pobject[0].y,
+				 soln->soln_pobject[0].adu);
+		adb_info(db, ADB_LOG_SOLVE, " plate 1: X %d Y %d ADU %d\n",
+				 soln->soln_pobject[1].x, soln->soln_pobject[1].y,
+				 soln->soln_pobject[1].adu);
+		adb_info(db, ADB_LOG_SOLVE, " plate 2: X %d Y %d ADU %d\n",
+				 soln->soln_pobject[2].x, soln->soln_pobject[2].y,
+				 soln->soln_pobject[2].adu);
+		adb_info(db, ADB_LOG_SOLVE, " plate 3: X %d Y %d ADU %d\n",
+				 soln->soln_pobject[3].x, soln->soln_pobject[3].y,
+				 soln->soln_pobject[3].adu);
+		solve->num_solutions++;
+		count++;
 	}
 
-	if (count >= MAX_RT_SOLUTIONS)
-		count = MAX_RT_SOLUTIONS - 1;
+	for (i = 0; i < threads; i++) {
+		if (thread[i].overflow) {
+			adb_error(solve->db, "too many solutions, narrow params\n");
+			break;
+		}
+	}
 
 	return count;
 }
 
 /**
- * \brief Fast path search returning control block after identifying initial success tuple.
+ * \brief Look for the current pattern with each primary on a pool of threads.
  *
- * Operates an accelerated exploration matrix isolating target correlations, actively
- * interrupting concurrent parallel streams once positive correlation verification locks.
+ * The calling thread works alongside db_workers() - 1 solver threads, or
+ * the batch share of them, that
+ * each collect solutions in their own buffer. ADB_FIND_FIRST solves stop
+ * claiming primaries once a primary is solved, and all threads stop
+ * promptly after adb_solve_stop().
  *
- * \param solve General solver bounds limit contexts.
- * \param set Active target database segment map.
- * \return Valid count equal to 1 reflecting rapid success or 0 failing check thresholds.
+ * \param solve Solver context with the current window pattern.
+ * \param primaries Haystack objects to try as the pattern primary.
+ * \param find Solve flags.
+ * \return Number of solutions added, or a negative error code.
  */
-static int solve_plate_cluster_for_set_first(struct adb_solve *solve,
-											 struct adb_object_set *set)
+static int solve_plate_cluster(struct adb_solve *solve,
+							   struct adb_source_objects *primaries,
+							   enum adb_find find)
 {
-	int i, count = 0;
+	struct solve_thread *thread;
+	int workers, started, i, count;
+
+	workers = solve->workers > 0 ? solve->workers : db_workers(solve->db);
+	if (workers > primaries->num_objects / SOLVE_CHUNK)
+		workers = primaries->num_objects / SOLVE_CHUNK;
+	if (workers < 1)
+		workers = 1;
+
+	thread = calloc(workers, sizeof(*thread));
+	if (thread == NULL)
+		return -ENOMEM;
+
+	solve->next = 0;
+	solve->first = INT_MAX;
+	solve->progress = 0;
+	solve->window_primaries = primaries->num_objects;
+
+	for (i = 0; i < workers; i++) {
+		thread[i].solve = solve;
+		thread[i].primaries = primaries;
+		thread[i].first = !(find & ADB_FIND_ALL);
+		thread[i].worker = i;
+
+		/* scoring buffers are sized for the whole haystack */
+		if (solve_runtime_alloc(&thread[i].runtime,
+								solve->haystack.num_objects) < 0) {
+			while (i >= 0)
+				solve_runtime_free(&thread[i--].runtime);
+			free(thread);
+			return -ENOMEM;
+		}
+	}
 
-	/* attempt to solve for each object in set */
-#if HAVE_OPENMP
-#pragma omp parallel for schedule(dynamic, 10)
-#endif
-	for (i = 0; i < solve->haystack.num_objects; i++) {
-		adb_vdebug(solve->db, ADB_LOG_SOLVE, " check %d\n", i);
-		solve->progress++;
+	/* the caller still solves everything if no threads can start */
+	for (started = 1; started < workers; started++) {
+		if (pthread_create(&thread[started].thread, NULL, solve_thread_run,
+						   &thread[started]))
+			break;
+	}
 
-		/* we cant break OpenMP loops */
-		if (count || solve->exit)
-			continue;
+	adb_debug(solve->db, ADB_LOG_SOLVE, "solving %d primaries on %d threads\n",
+			  primaries->num_objects, started);
 
-		if (try_object_as_primary(solve, solve->haystack.objects[i])) {
-			count = 1;
-			/* TODO OpenMP cancel is supported in gcc 4.9 */
-			/* #pragma omp cancel for */
-		}
-	}
-	/* #pragma omp cancellation point for */
+	solve_thread_run(&thread[0]);
+	for (i = 1; i < started; i++)
+		pthread_join(thread[i].thread, NULL);
 
+	/* the rest of the window can't change the result */
+	if (!__atomic_load_n(&solve->exit, __ATOMIC_RELAXED))
+		solve->progress = solve->window_primaries;
+
+	count = solve_merge_solutions(solve, thread, workers);
+	for (i = 0; i < workers; i++)
+		solve_runtime_free(&thread[i].runtime);
+	free(thread);
 	return count;
 }
 
@@ -407,8 +620,30 @@ int adb_solve_constraint(struct adb_solve *solve, enum adb_constraint type,
 int adb_solve(struct adb_solve *solve, struct adb_object_set *set,
 			  enum adb_find find)
 {
-	int ret, i;
+	int ret;
+
+	ret = solve_check_plate(solve);
+	if (ret < 0)
+		return ret;
+
+	/* prepare the set of objects to use for solving */
+	ret = target_prepare_source_objects(solve, set, &solve->haystack);
+	if (ret <= 0) {
+		adb_error(solve->db, "cant get trixels %d\n", ret);
+		return ret;
+	}
 
+	return solve_plate_windows(solve, find);
+}
+
+/**
+ * \brief Check the solver has enough plate objects for a pattern.
+ *
+ * \param solve Solver context.
+ * \return 0 or -EINVAL.
+ */
+int solve_check_plate(struct adb_solve *solve)
+{
 	/* do we have enough plate adb_source_objects to solve */
 	if (solve->plate.num_objects < MIN_PLATE_OBJECTS) {
 		adb_error(solve->db,
@@ -417,16 +652,62 @@ int adb_solve(struct adb_solve *solve, struct adb_object_set *set,
 		return -EINVAL;
 	}
 
-	/* prepare the set of objects to use for solving */
-	ret = target_prepare_source_objects(solve, set, &solve->haystack);
-	if (ret <= 0) {
-		adb_error(solve->db, "cant get trixels %d\n", ret);
-		return ret;
+	return 0;
+}
+
+/**
+ * \brief Select the haystack neighbour lists for ADB_FIND_NEIGHBOURS solves.
+ *
+ * \param solve Solver context with its haystack prepared.
+ * \param find Specification of matching rule.
+ * \return 0 on success or a negative error code.
+ */
+static int solve_prepare_neighbours(struct adb_solve *solve,
+									enum adb_find find)
+{
+	solve->neighbours = NULL;
+
+	if (!(find & ADB_FIND_NEIGHBOURS))
+		return 0;
+
+	return distance_prepare_neighbours(solve);
+}
+
+/**
+ * \brief Look for each plate window pattern in the prepared haystack.
+ *
+ * \param solve Solver context with its haystack prepared.
+ * \param find Specification of matching rule.
+ * \return The number of acceptable solutions found, or a negative error code
+ */
+int solve_plate_windows(struct adb_solve *solve, enum adb_find find)
+{
+	struct adb_source_objects *primaries = &solve->haystack;
+	int ret, i;
+
+	/* candidate primaries are sized for the haystack */
+	free(solve->candidates.objects);
+	free(solve->quad_mark);
+	solve->candidates.objects = NULL;
+	solve->quad_mark = NULL;
+
+	if (find & ADB_FIND_INDEX) {
+		ret = quad_prepare_index(solve);
+		if (ret < 0)
+			return ret;
+		primaries = &solve->candidates;
 	}
 
+	ret = solve_prepare_neighbours(solve, find);
+	if (ret < 0)
+		return ret;
+
 	/* status reporting and exit */
-	solve->progress = 0.0;
-	solve->exit = 0;
+	solve->progress = 0;
+	solve->window_primaries = 0;
+	__atomic_store_n(&solve->exit,
+					 __atomic_load_n(&solve->async.stop, __ATOMIC_RELAXED),
+					 __ATOMIC_RELAXED);
 
 	/*
    * Iterate through plate objects using a window that is used to generate
@@ -447,15 +728,22 @@ int adb_solve(struct adb_solve *solve, struct adb_object_set *set,
 		/* create the target pattern from the current window */
 		target_create_pattern(solve);
 
+		/* only try primaries with quad codes matching the pattern */
+		if (find & ADB_FIND_INDEX) {
+			ret = quad_get_candidates(solve);
+			if (ret < 0)
+				return ret;
+		}
+
 		/* now look for the window pattern in the object set */
-		if (find & ADB_FIND_ALL)
-			ret = solve_plate_cluster_for_set_all(solve, set);
-		else
-			ret = solve_plate_cluster_for_set_first(solve, set);
+		ret = solve_plate_cluster(solve, primaries, find);
 
 		/* move on to next if good */
 		if (ret < 0)
 			return ret;
+
+		if (__atomic_load_n(&solve->exit, __ATOMIC_RELAXED))
+			break;
 	}
 
 	/* it's possible we may have > 1 solution so order them */
@@ -467,6 +755,245 @@ int adb_solve(struct adb_solve *solve, struct adb_object_set *set,
 	return solve->num_solutions;
 }
 
+/**
+ * \brief Check tracked solutions against the positions predicted by the prior.
+ *
+ * Every catalog object of a solution must be the nearest haystack object to
+ * the position the prior predicts for its plate object. Failing solutions
+ * are dropped.
+ *
+ * \param solve Solver context.
+ * \param prior Solution of the previous frame.
+ * \param first First solution added for the current window.
+ * \param radius Largest distance to the predicted position in radians.
+ */
+static void track_verify_solutions(struct adb_solve *solve,
+								   struct adb_solve_solution *prior, int first,
+								   double radius)
+{
+	struct adb_solve_solution *soln;
+	const struct adb_object *nearest;
+	struct adb_object predict;
+	double dist, best;
+	int i, j, k, count = first;
+
+	for (i = first; i < solve->num_solutions; i++) {
+		soln = &solve->solution[i];
+
+		for (j = 0; j < MIN_PLATE_OBJECTS; j++) {
+			posn_plate_to_equ_solve(prior, &soln->soln_pobject[j], &predict.ra,
+									&predict.dec);
+
+			nearest = NULL;
+			best = radius;
+			for (k = 0; k < solve->haystack.num_objects; k++) {
+				dist = distance_get_equ(&predict, solve->haystack.objects[k]);
+				if (dist <= best) {
+					best = dist;
+					nearest = solve->haystack.objects[k];
+				}
+			}
+
+			if (nearest != soln->object[j])
+				break;
+		}
+
+		if (j < MIN_PLATE_OBJECTS) {
+			adb_info(solve->db, ADB_LOG_SOLVE,
+					 "tracked solution %d is not at the prior position\n", i);
+			continue;
+		}
+
+		if (count != i)
+			solve->solution[count] = *soln;
+		count++;
+	}
+
+	solve->num_solutions = count;
+}
+
+/**
+ * \brief Solve a plate that moved a little from a previously solved frame.
+ *
+ * Each plate window primary is predicted on the sky with the prior
+ * solution and only haystack objects within the track delta of that
+ * position are tried as primaries. Solutions are then verified against
+ * the predicted position of each plate object. The first window with a
+ * solution ends the solve, and a full adb_solve() is run if no window
+ * tracks.
+ *
+ * \param solve Solver context fully populated with constraints and plate
+ * targets
+ * \param set Bounded reference dataset subset of known stars
+ * \param prior Solution of the previous frame, from any solver on the table
+ * \param find Specification of matching rule (e.g. `ADB_FIND_ALL` or
+ * `ADB_FIND_FIRST`)
+ * \return The number of acceptable solutions found, or a negative error code
+ */
+int adb_solve_track(struct adb_solve *solve, struct adb_object_set *set,
+					struct adb_solve_solution *prior, enum adb_find find)
+{
+	struct adb_source_objects near;
+	struct adb_object predict;
+	double radius;
+	int ret = 0, i, j, first;
+
+	if (prior == NULL || prior->solve == NULL ||
+		prior->solve->table != solve->table || prior->rad_per_pix <= 0.0)
+		return -EINVAL;
+
+	ret = solve_check_plate(solve);
+	if (ret < 0)
+		return ret;
+
+	/* prepare the set of objects to use for solving */
+	ret = target_prepare_source_objects(solve, set, &solve->haystack);
+	if (ret <= 0) {
+		adb_error(solve->db, "cant get trixels %d\n", ret);
+		return ret;
+	}
+
+	ret = solve_prepare_neighbours(solve, find);
+	if (ret < 0)
+		return ret;
+
+	near.objects = calloc(solve->haystack.num_objects, sizeof(*near.objects));
+	if (near.objects == NULL)
+		return -ENOMEM;
+
+	radius = solve->track_delta * prior->rad_per_pix;
+
+	/* status reporting and exit */
+	solve->progress = 0;
+	solve->window_primaries = 0;
+	__atomic_store_n(&solve->exit,
+					 __atomic_load_n(&solve->async.stop, __ATOMIC_RELAXED),
+					 __ATOMIC_RELAXED);
+
+	for (i = 0; i <= solve->plate.num_objects - MIN_PLATE_OBJECTS; i++) {
+		/* set the window bounds */
+		solve->plate.window_start = i;
+		solve->plate.window_end = MIN_PLATE_OBJECTS + i;
+
+		/* try the objects near the predicted primary position */
+		posn_plate_to_equ_solve(prior, &solve->plate.object[i], &predict.ra,
+								&predict.dec);
+		for (j = 0, near.num_objects = 0; j < solve->haystack.num_objects;
+			 j++) {
+			if (distance_get_equ(&predict, solve->haystack.objects[j]) <=
+				radius)
+				near.objects[near.num_objects++] = solve->haystack.objects[j];
+		}
+
+		adb_info(solve->db, ADB_LOG_SOLVE,
+				 "tracking plate object[%d] -> object[%d] with %d primaries\n",
+				 solve->plate.window_start, solve->plate.window_end - 1,
+				 near.num_objects);
+
+		if (near.num_objects == 0)
+			continue;
+
+		/* create the target pattern from the current window */
+		target_create_pattern(solve);
+
+		first = solve->num_solutions;
+		ret = solve_plate_cluster(solve, &near, find);
+		if (ret < 0)
+			goto out;
+
+		track_verify_solutions(solve, prior, first, radius);
+
+		if (solve->num_solutions > first ||
+			__atomic_load_n(&solve->exit, __ATOMIC_RELAXED))
+			break;
+	}
+
+out:
+	free(near.objects);
+	if (ret < 0)
+		return ret;
+
+	/* lost track so solve the whole set */
+	if (solve->num_solutions == 0 &&
+		!__atomic_load_n(&solve->exit, __ATOMIC_RELAXED)) {
+		adb_info(solve->db, ADB_LOG_SOLVE, "track lost, solving whole set\n");
+		return adb_solve(solve, set, find);
+	}
+
+	/* it's possible we may have > 1 solution so order them */
+	qsort(solve->solution, solve->num_solutions,
+		  sizeof(struct adb_solve_solution), solution_cmp);
+
+	adb_info(solve->db, ADB_LOG_SOLVE, "Total %d tracked solutions\n",
+			 solve->num_solutions);
+	return solve->num_solutions;
+}
+
+/**
+ * \brief Solve a plate within a time budget.
+ *
+ * Runs adb_solve() passes until one finds a solution, doubling the
+ * magnitude, distance and PA tolerances after each pass without one.
+ * Primaries are tried brightest first in every pass and each pass stops at
+ * the deadline, so the best solution found in time is kept.
+ *
+ * \param solve Solver context fully populated with constraints and plate
+ * targets
+ * \param set Bounded reference dataset subset of known stars
+ * \param find Specification of matching rule (e.g. `ADB_FIND_ALL` or
+ * `ADB_FIND_FIRST`)
+ * \param msecs Time budget in milliseconds
+ * \return The number of acceptable solutions found, -ETIMEDOUT if none were
+ * found in time, or a negative error code
+ */
+int adb_solve_timed(struct adb_solve *solve, struct adb_object_set *set,
+					enum adb_find find, int msecs)
+{
+	struct solve_tolerance tolerance = solve->tolerance;
+	long long deadline;
+	int ret = 0, pass, scale;
+
+	if (msecs <= 0)
+		return -EINVAL;
+
+	deadline = solve_clock_ns() + msecs * 1000000LL;
+	solve->deadline = deadline;
+
+	for (pass = 0, scale = 1; pass < SOLVE_PASSES; pass++, scale *= 2) {
+		solve->tolerance.mag = tolerance.mag * scale;
+		solve->tolerance.dist = tolerance.dist * scale;
+		solve->tolerance.pa = tolerance.pa * scale;
+
+		adb_info(solve->db, ADB_LOG_SOLVE,
+				 "timed solve pass %d with x%d tolerances\n", pass, scale);
+
+		ret = adb_solve(solve, set, find);
+		if (ret != 0 || solve_expired(solve))
+			break;
+	}
+
+	solve->tolerance = tolerance;
+	solve->deadline = 0;
+
+	if (ret == 0 && solve_clock_ns() >= deadline) {
+		adb_info(solve->db, ADB_LOG_SOLVE, "timed solve ran out of time\n");
+		return -ETIMEDOUT;
+	}
+
+	return ret;
+}
+
+/**
+ * \brief Load or build the quad index used by ADB_FIND_INDEX solves.
+ *
+ * \param solve Solver context with its magnitude and FOV constraints set.
+ * \return 0 on success, or a negative error code.
+ */
+int adb_solve_prepare_index(struct adb_solve *solve)
+{
+	return quad_prepare_index(solve);
+}
+
 /**
  * \brief Bind upper thresholds constraining magnitude matching correlations.
  *
@@ -493,6 +1020,38 @@ int adb_solve_set_distance_delta(struct adb_solve *solve, double delta_pixels)
 	return 0;
 }
 
+/**
+ * \brief Set the plate drift allowed between tracked frames.
+ *
+ * \param solve Operational memory configuration node mapping properties.
+ * \param delta_pixels Largest plate object movement in pixels.
+ * \return Success flag constant.
+ */
+int adb_solve_set_track_delta(struct adb_solve *solve, double delta_pixels)
+{
+	if (delta_pixels <= 0.0)
+		return -EINVAL;
+
+	solve->track_delta = delta_pixels;
+	return 0;
+}
+
+/**
+ * \brief Set the plate to equatorial transform used by solutions.
+ *
+ * \param solve Operational memory configuration node mapping properties.
+ * \param fit Reference pair averaging or least squares plate fit.
+ * \return Success flag constant.
+ */
+int adb_solve_set_plate_fit(struct adb_solve *solve, enum adb_plate_fit fit)
+{
+	if (fit != ADB_PLATE_FIT_PAIRS && fit != ADB_PLATE_FIT_LSQ)
+		return -EINVAL;
+
+	solve->plate_fit = fit;
+	return 0;
+}
+
 /**
  * \brief Bind upper thresholds constraining positional mapping angle matching correlations.
  *
@@ -560,20 +1119,35 @@ int adb_solve_get_pobject_count(struct adb_solve *solve,
  */
 void adb_solve_stop(struct adb_solve *solve)
 {
-	solve->exit = 1;
+	/* kept until the started solve is waited for, so it is never lost */
+	if (__atomic_load_n(&solve->async.running, __ATOMIC_ACQUIRE))
+		__atomic_store_n(&solve->async.stop, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&solve->exit, 1, __ATOMIC_RELAXED);
 }
 
 /**
  * \brief Return dynamic completion ratio tracking current matrix exploration boundaries.
- * 
- * Computes fraction representing depth mapped over cumulative valid haystack target arrays.
+ *
+ * Counts the plate windows already solved plus the primaries tried in the
+ * current window, and is safe to call from another thread while solving.
  *
  * \param solve Internal execution limits structures determining thread ranges.
  * \return Numeric percentage fractional representations mapping 0.0 baseline across 1.0 success completions.
  */
 float adb_solve_get_progress(struct adb_solve *solve)
 {
-	return (float)solve->haystack.num_objects / solve->progress;
+	int windows = solve->plate.num_objects - MIN_PLATE_OBJECTS + 1;
+	int primaries = __atomic_load_n(&solve->window_primaries, __ATOMIC_RELAXED);
+	int progress = __atomic_load_n(&solve->progress, __ATOMIC_RELAXED);
+	float window = 1.0;
+
+	if (windows <= 0)
+		return 0.0;
+
+	if (primaries > 0 && progress < primaries)
+		window = (float)progress / primaries;
+
+	return (solve->plate.window_start + window) / windows;
 }
 
 /**
@@ -590,6 +1164,8 @@ struct adb_solve *adb_solve_new(struct adb_db *db, int table_id)
 
 	if (table_id < 0 || table_id >= ADB_MAX_TABLES)
 		return NULL;
+	if (db_check_local(db) < 0)
+		return NULL;
 
 	solve = calloc(1, sizeof(struct adb_solve));
 	if (solve == NULL)
@@ -616,6 +1192,8 @@ struct adb_solve *adb_solve_new(struct adb_db *db, int table_id)
 	solve->constraint.max_JD = 0;
 	solve->constraint.max_pobjects = 1000;
 	solve->constraint.min_pobjects = MIN_PLATE_OBJECTS;
+	solve->track_delta = TRACK_DELTA;
+	solve->plate_fit = ADB_PLATE_FIT_PAIRS;
 	solve->num_solutions = 0;
 
 	for (i = 0; i < MAX_RT_SOLUTIONS; i++) {
@@ -636,6 +1214,12 @@ void adb_solve_free(struct adb_solve *solve)
 	struct adb_solve_solution *solution;
 	int i;
 
+	/* end any started solve before its state is freed */
+	if (solve->async.running) {
+		adb_solve_stop(solve);
+		adb_solve_wait(solve);
+	}
+
 	/* free each solution */
 	for (i = 0; i < MAX_RT_SOLUTIONS; i++) {
 		solution = &solve->solution[i];
@@ -644,8 +1228,11 @@ void adb_solve_free(struct adb_solve *solve)
 		free(solution->solve_object);
 		free(solution->ref);
 		free(solution->source.objects);
+		free(solution->source_distance);
+		free(solution->source_index);
 	}
 
-	free(solve->haystack.objects);
+	free(solve->candidates.objects);
+	free(solve->quad_mark);
 	free(solve);
 }
@@ -47,6 +47,15 @@
 #define DELTA_DIST_COEFF 1.0
 #define DELTA_PA_COEFF 1.0
 
+/* default plate drift in pixels allowed between tracked frames */
+#define TRACK_DELTA 10.0
+
+/* quad index: triangle codes of each star with pairs of its neighbours */
+#define QUAD_NEIGHBOURS 12
+#define QUAD_RATIO_BINS 64
+#define QUAD_ANGLE_BINS 64
+#define QUAD_CELLS (QUAD_RATIO_BINS * QUAD_ANGLE_BINS)
+
 /*! \struct tdata
  * \ingroup solve
  */
@@ -136,6 +145,29 @@ struct adb_reference_object {
 	int clip_posn;
 };
 
+/*! \struct source_distance
+ * \ingroup solve
+ *
+ * Solution source object and its distance to the first solution object.
+ */
+struct source_distance {
+	double distance; /*!< distance to object 0 in radians */
+	int index; /*!< position in the magnitude sorted source */
+};
+
+/*! \struct posn_plate_fit
+ * \ingroup solve
+ *
+ * Least squares affine fit from the plate to the tangent plane at centre.
+ */
+struct posn_plate_fit {
+	const struct adb_object *centre; /*!< tangent point */
+	double xm, ym; /*!< plate position the fit is centred on */
+	double a[3]; /*!< xi = a[0] + a[1] * (x - xm) + a[2] * (y - ym) */
+	double b[3]; /*!< eta = b[0] + b[1] * (x - xm) + b[2] * (y - ym) */
+	int valid; /*!< fitted to the current reference objects */
+};
+
 /*! \struct adb_solve_solution
  * \ingroup solve
  */
@@ -153,6 +185,10 @@ struct adb_solve_solution {
 	/* source object storage */
 	struct adb_source_objects source;
 	struct adb_object_set *set;
+
+	/* source ordered on distance to object 0, built by get_objects */
+	struct source_distance *source_distance;
+	int *source_index; /*!< candidate positions of one plate object */
 	struct adb_db *db;
 
 	/* solution delta to db */
@@ -170,11 +206,130 @@ struct adb_solve_solution {
 	/* reference objects - total solved objects - can come from any table */
 	struct adb_reference_object *ref;
 	int num_ref_objects;
+	struct posn_plate_fit fit; /*!< reference object plate fit */
+};
+
+/*! \struct solve_haystack
+ * \ingroup solve
+ *
+ * Magnitude sorted haystack prepared from the clipped objects of a set.
+ * Kept on the set for one magnitude range until the set is clipped again.
+ */
+struct solve_haystack {
+	struct adb_source_objects source;
+	double min_mag; /*!< faintest magnitude limit */
+	double max_mag; /*!< brightest magnitude limit */
+	struct solve_neighbours *neighbours; /*!< neighbour lists per FOV */
+	struct solve_score *score; /*!< positions for the scoring backend */
+	struct solve_haystack *next;
+};
+
+/*! \struct solve_score
+ * \ingroup solve
+ *
+ * Haystack positions as arrays in haystack order, built once with the
+ * haystack so candidate scoring reads no object pointers.
+ */
+struct solve_score {
+	double *ra; /*!< RA of each haystack object */
+	double *dec; /*!< DEC of each haystack object */
+	double *sin_dec; /*!< sine of each DEC */
+	double *cos_dec; /*!< cosine of each DEC */
+	int count; /*!< number of haystack objects */
+};
+
+struct solve_runtime;
+
+/*! \struct solve_score_backend
+ * \ingroup solve
+ *
+ * Candidate scoring backend, chosen when the library is built. It matches
+ * every (t0, t1, t2) candidate of a primary on the pattern distance windows
+ * and adds the survivors with target_add_match_on_distance().
+ */
+struct solve_score_backend {
+	const char *name; /*!< backend name for logs */
+	struct solve_score *(*prepare)(const struct adb_source_objects *source);
+	void (*release)(struct solve_score *score);
+	int (*distance)(struct solve_runtime *runtime,
+					const struct solve_score *score,
+					const struct adb_object *primary);
+};
+
+/*! \struct solve_neighbour
+ * \ingroup solve
+ *
+ * Haystack object near a primary with its separation and PA from it.
+ */
+struct solve_neighbour {
+	double distance; /*!< separation from the primary */
+	double pa; /*!< PA from the primary */
+	int index; /*!< haystack position */
+};
+
+/*! \struct solve_neighbours
+ * \ingroup solve
+ *
+ * Neighbours of every haystack object within the maximum FOV for
+ * ADB_FIND_NEIGHBOURS solves. Each object list is sorted on separation.
+ */
+struct solve_neighbours {
+	struct solve_neighbour *neighbour; /*!< all neighbour lists */
+	int *start; /*!< first neighbour of each object, num_objects + 1 long */
+	double fov; /*!< maximum FOV the lists were built for */
+	struct solve_neighbours *next;
+};
+
+/*! \struct quad_code
+ * \ingroup solve
+ *
+ * Scale, rotation and parity invariant code of the triangle formed by a
+ * primary star and two of its neighbours.
+ */
+struct quad_code {
+	float ratio; /*!< nearer over further neighbour distance, 0 to 1 */
+	float angle; /*!< angle at the primary between the neighbours, 0 to PI */
+	unsigned int primary; /*!< table position of the primary */
+};
+
+/*! \struct solve_quad
+ * \ingroup solve
+ *
+ * Quad index of a table. Every star down to the index magnitude has codes
+ * for each pair of its QUAD_NEIGHBOURS brightest neighbours within the index
+ * FOV, grouped by ratio and angle cell.
+ */
+struct solve_quad {
+	struct quad_code *code; /*!< codes in cell order */
+	unsigned int cell[QUAD_CELLS + 1]; /*!< first code of each cell */
+	int count; /*!< number of codes */
+	double max_mag; /*!< faintest indexed magnitude */
+	double max_fov; /*!< largest indexed neighbour distance */
+};
+
+/*! \struct solve_candidate
+ * \ingroup solve
+ *
+ * Potential match kept while solving. Only candidates that survive every
+ * check are turned into a struct adb_solve_solution.
+ */
+struct solve_candidate {
+	const struct adb_object *object[MIN_PLATE_OBJECTS]; /*!< cluster */
+	struct solve_tolerance delta; /*!< deltas to the plate pattern */
+	double divergance; /*!< weighted deltas */
+	double rad_per_pix; /*!< plate scale */
+	double pa[MIN_PLATE_OBJECTS - 1]; /*!< cached primary PAs */
+	int has_pa; /*!< pa holds the PAs from the neighbour lists */
+	int flip; /*!< plate is flipped */
 };
 
 /* solver runtime data */
 /*! \struct solve_runtime
  * \ingroup solve
+ *
+ * Reset with solve_runtime_reset() before each use, only the counters are
+ * cleared. Runtimes that score candidates are sized with
+ * solve_runtime_alloc() and freed with solve_runtime_free().
  */
 struct solve_runtime {
 	struct adb_solve *solve;
@@ -183,17 +338,21 @@ struct solve_runtime {
 	struct target_solve_mag pot_magnitude;
 
 	/* potential matches after magnitude and distance checks */
-	struct adb_solve_solution pot_distance[MAX_POTENTAL_MATCHES];
+	struct solve_candidate pot_distance[MAX_POTENTAL_MATCHES];
 	int num_pot_distance;
 	int num_pot_distance_checked;
 
 	/* potential matches after magnitude, distance and PA */
-	struct adb_solve_solution pot_pa[MAX_POTENTAL_MATCHES];
+	struct solve_candidate pot_pa[MAX_ACTUAL_MATCHES];
 	int num_pot_pa;
 
 	/* target cluster */
 	struct needle_object soln_target[MIN_PLATE_OBJECTS];
 
+	/* primary distances of the magnitude matched haystack objects */
+	double *distance;
+	int distance_size;
+
 #ifdef DEBUG
 	int debug;
 #endif
@@ -222,6 +381,21 @@ struct adb_solve_plate {
 /*! \struct adb_solve
  * \ingroup solve
  */
+/*! \struct solve_async
+ * \brief Solve started by adb_solve_start() on its own thread.
+ */
+struct solve_async {
+	pthread_t thread; /*!< solver thread */
+	struct adb_object_set *set; /*!< set to solve on */
+	enum adb_find find; /*!< find flags */
+	adb_solve_callback callback; /*!< completion callback or NULL */
+	void *data; /*!< callback data */
+	int fd[2]; /*!< completion pipe, written once when the solve ends */
+	int result; /*!< adb_solve() result */
+	int running; /*!< started and not yet waited for */
+	int stop; /*!< stop requested while running */
+};
+
 struct adb_solve {
 	struct adb_db *db;
 	struct adb_table *table;
@@ -232,10 +406,19 @@ struct adb_solve {
 	/* target cluster */
 	struct needle_pattern target;
 
-	/* source object set */
+	/* source objects, shared with the object set haystack */
 	struct adb_source_objects haystack;
+	struct solve_haystack *source; /*!< set haystack in use */
+	struct solve_neighbours *neighbours; /*!< neighbour lists or NULL */
+
+	/* haystack primaries matching the pattern quad index codes */
+	struct adb_source_objects candidates;
+	unsigned char *quad_mark; /*!< pattern triangles matched per object */
 
 	struct solve_tolerance tolerance;
+	double track_delta; /*!< tracked plate drift in pixels */
+	enum adb_plate_fit plate_fit; /*!< solution position transform */
+	int workers; /*!< solver threads, 0 for db_workers() */
 
 	/* potential solutions from all runtimes */
 	struct adb_solve_solution solution[MAX_RT_SOLUTIONS];
@@ -244,9 +427,15 @@ struct adb_solve {
 	/* plate properties */
 	struct adb_solve_plate plate;
 
-	/* loop exit */
-	int exit;
-	int progress;
+	/* solver thread state, accessed atomically while solving */
+	int exit; /*!< stop requested */
+	int progress; /*!< primaries tried in the current window */
+	int next; /*!< next primary to claim */
+	int first; /*!< lowest primary with an ADB_FIND_FIRST solution */
+	int window_primaries; /*!< primaries to try in the current window */
+	long long deadline; /*!< monotonic ns to stop at, 0 for none */
+
+	struct solve_async async; /*!< adb_solve_start() state */
 };
 
 #ifdef DEBUG
@@ -532,6 +721,37 @@ int pa_solve_object(struct solve_runtime *runtime,
 int pa_solve_single_object(struct solve_runtime *runtime,
 						   struct adb_solve_solution *solution);
 
+/**
+ * \brief Check if the solve was stopped or ran past its deadline
+ * \ingroup solve
+ *
+ * Sets the solver exit flag once the deadline has passed, so later checks
+ * don't read the clock.
+ *
+ * \param solve Pointer to solve context
+ * \return 1 if the solve should stop, 0 otherwise
+ */
+int solve_expired(struct adb_solve *solve);
+
+/**
+ * \brief Build or reuse the haystack neighbour lists for the maximum FOV
+ * \ingroup solve
+ *
+ * The lists are kept on the set haystack and shared by every solver using
+ * it, so they must be prepared before solver threads start.
+ *
+ * \param solve Pointer to solve context with its haystack prepared
+ * \return 0 if successful, negative error otherwise
+ */
+int distance_prepare_neighbours(struct adb_solve *solve);
+
+/**
+ * \brief Get the candidate scoring backend built into the library
+ * \ingroup solve
+ * \return Scoring backend
+ */
+const struct solve_score_backend *solve_score_get_backend(void);
+
 /**
  * \brief Check magnitude matched objects on pattern distance
  * \ingroup solve
@@ -552,6 +772,19 @@ int distance_solve_object(struct solve_runtime *runtime,
 int distance_solve_single_object(struct solve_runtime *runtime,
 								 struct adb_solve_solution *solution);
 
+/**
+ * \brief Check listed single object candidates on pattern distance
+ * \ingroup solve
+ * \param runtime Pointer to solve runtime
+ * \param solution Pointer to solution context
+ * \param index Ascending solution source positions of the candidates
+ * \param count Number of candidates
+ * \return Number of matching candidates
+ */
+int distance_solve_single_object_list(struct solve_runtime *runtime,
+									  struct adb_solve_solution *solution,
+									  const int *index, int count);
+
 /**
  * \brief Check magnitude matched single object on extended pattern distance
  * \ingroup solve
@@ -562,6 +795,39 @@ int distance_solve_single_object(struct solve_runtime *runtime,
 int distance_solve_single_object_extended(struct solve_runtime *runtime,
 										  struct adb_solve_solution *solution);
 
+/**
+ * \brief Check the solver has enough plate objects for a pattern
+ * \ingroup solve
+ * \param solve Pointer to solve context
+ * \return 0 on success, negative error otherwise
+ */
+int solve_check_plate(struct adb_solve *solve);
+
+/**
+ * \brief Solve each plate window against the prepared haystack
+ * \ingroup solve
+ * \param solve Pointer to solve context with its haystack prepared
+ * \param find Solve flags
+ * \return Number of solutions, negative error otherwise
+ */
+int solve_plate_windows(struct adb_solve *solve, enum adb_find find);
+
+/**
+ * \brief Load or build the quad index for the solve constraints
+ * \ingroup solve
+ * \param solve Pointer to solve context
+ * \return 0 on success, negative error otherwise
+ */
+int quad_prepare_index(struct adb_solve *solve);
+
+/**
+ * \brief Get the haystack primaries matching the current pattern
+ * \ingroup solve
+ * \param solve Pointer to solve context with a prepared quad index
+ * \return Number of candidate primaries, negative error otherwise
+ */
+int quad_get_candidates(struct adb_solve *solve);
+
 /**
  * \brief Calculate equatorial RA/DEC from plate X/Y position
  * \ingroup solve
@@ -584,6 +850,63 @@ void posn_plate_to_equ(struct adb_solve_solution *solution,
 void posn_equ_to_plate(struct adb_solve_solution *solution, double ra,
 					   double dec, double *x_, double *y_);
 
+/**
+ * \brief Calculate equatorial RA/DEC from many plate X/Y positions
+ * \ingroup solve
+ * \param solution Pointer to solution match
+ * \param x Plate X positions
+ * \param y Plate Y positions
+ * \param count Number of positions
+ * \param ra Output RAs
+ * \param dec Output DECs
+ * \param fast Only use the first MIN_PLATE_OBJECTS reference objects
+ * \return 0 on success or -ENOMEM
+ */
+int posn_plate_to_equ_array(struct adb_solve_solution *solution,
+							const double *x, const double *y, int count,
+							double *ra, double *dec, int fast);
+
+/**
+ * \brief Calculate plate X/Y from many equatorial RA/DEC positions
+ * \ingroup solve
+ * \param solution Pointer to solution match
+ * \param ra Input RAs
+ * \param dec Input DECs
+ * \param count Number of positions
+ * \param x Output plate X positions
+ * \param y Output plate Y positions
+ * \param fast Only use the first MIN_PLATE_OBJECTS reference objects
+ * \return 0 on success or -ENOMEM
+ */
+int posn_equ_to_plate_array(struct adb_solve_solution *solution,
+							const double *ra, const double *dec, int count,
+							double *x, double *y, int fast);
+
+/**
+ * \brief Prepare a solve runtime for a new primary or plate object
+ * \ingroup solve
+ * \param runtime Pointer to solve runtime
+ * \param solve Pointer to root solve context
+ */
+void solve_runtime_reset(struct solve_runtime *runtime,
+						 struct adb_solve *solve);
+
+/**
+ * \brief Size the scoring buffers of a solve runtime for a haystack
+ * \ingroup solve
+ * \param runtime Pointer to solve runtime
+ * \param count Number of haystack objects
+ * \return 0 if successful, -ENOMEM otherwise
+ */
+int solve_runtime_alloc(struct solve_runtime *runtime, int count);
+
+/**
+ * \brief Free the scoring buffers of a solve runtime
+ * \ingroup solve
+ * \param runtime Pointer to solve runtime
+ */
+void solve_runtime_free(struct solve_runtime *runtime);
+
 /**
  * \brief Add matching objects i,j,k to list of potentials on distance
  * \ingroup solve
@@ -595,12 +918,13 @@ void posn_equ_to_plate(struct adb_solve_solution *solution, double ra,
  * \param k Index k
  * \param delta Computed distance delta
  * \param rad_per_pix Radians per pixel conversion factor
+ * \param pa Primary to i,j,k PAs or NULL if not known
  */
 void target_add_match_on_distance(struct solve_runtime *runtime,
 								  const struct adb_object *primary,
 								  struct adb_source_objects *source, int i,
 								  int j, int k, double delta,
-								  double rad_per_pix);
+								  double rad_per_pix, const double *pa);
 
 /**
  * \brief Add single object to list of potentials on distance
@@ -643,10 +967,14 @@ void target_add_single_match_extended(struct solve_runtime *runtime,
 /**
  * \brief Get a set of source objects to check the pattern against
  * \ingroup solve
+ *
+ * The sorted objects are owned by the set and reused by every solver using
+ * the same set and magnitude limits until the set is clipped again.
+ *
  * \param solve Pointer to solve config
  * \param set Pointer to object set
  * \param source Pointer to source output
- * \return status 0 for success
+ * \return number of source objects or negative error code
  */
 int target_prepare_source_objects(struct adb_solve *solve,
 								  struct adb_object_set *set,
@@ -751,6 +1079,21 @@ void posn_plate_to_equ_fast(struct adb_solve_solution *solution,
 							struct adb_pobject *primary, double *ra_,
 							double *dec_);
 
+/**
+ * \brief Compute angular coordinates from a fit to the solve objects
+ * \ingroup solve
+ *
+ * Only needs the solve result, reference objects are not used.
+ *
+ * \param solution Pointer to layout parameters
+ * \param primary Pointer to incoming plate object representation
+ * \param ra_ Angular ascension offset target
+ * \param dec_ Angular declination offset target
+ */
+void posn_plate_to_equ_solve(struct adb_solve_solution *solution,
+							 struct adb_pobject *primary, double *ra_,
+							 double *dec_);
+
 #endif
 
 #endif
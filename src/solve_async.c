@@ -0,0 +1,107 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <errno.h> // IWYU pragma: keep
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "solve.h"
+
+/**
+ * \brief Run a started solve and signal its completion.
+ *
+ * \param data Solver.
+ * \return NULL.
+ */
+static void *async_thread_run(void *data)
+{
+	struct adb_solve *solve = data;
+	struct solve_async *async = &solve->async;
+	char done = 1;
+
+	async->result = adb_solve(solve, async->set, async->find);
+
+	if (async->callback)
+		async->callback(async->data, solve, async->result);
+
+	/* the pipe has room for the single byte, so this never blocks */
+	if (write(async->fd[1], &done, 1) != 1)
+		adb_error(solve->db, "can't signal solve completion %d\n", -errno);
+
+	return NULL;
+}
+
+int adb_solve_start(struct adb_solve *solve, struct adb_object_set *set,
+					enum adb_find find, adb_solve_callback callback,
+					void *data)
+{
+	struct solve_async *async = &solve->async;
+	int i, ret;
+
+	if (async->running)
+		return -EBUSY;
+
+	if (pipe(async->fd) < 0)
+		return -errno;
+	for (i = 0; i < 2; i++)
+		fcntl(async->fd[i], F_SETFD, FD_CLOEXEC);
+
+	async->set = set;
+	async->find = find;
+	async->callback = callback;
+	async->data = data;
+	async->result = 0;
+	async->stop = 0;
+	__atomic_store_n(&async->running, 1, __ATOMIC_RELEASE);
+
+	ret = pthread_create(&async->thread, NULL, async_thread_run, solve);
+	if (ret) {
+		__atomic_store_n(&async->running, 0, __ATOMIC_RELEASE);
+		close(async->fd[0]);
+		close(async->fd[1]);
+		return -ret;
+	}
+
+	return 0;
+}
+
+int adb_solve_get_fd(struct adb_solve *solve)
+{
+	if (!solve->async.running)
+		return -EINVAL;
+
+	return solve->async.fd[0];
+}
+
+int adb_solve_wait(struct adb_solve *solve)
+{
+	struct solve_async *async = &solve->async;
+
+	if (!async->running)
+		return -EINVAL;
+
+	pthread_join(async->thread, NULL);
+	close(async->fd[0]);
+	close(async->fd[1]);
+
+	async->stop = 0;
+	__atomic_store_n(&async->running, 0, __ATOMIC_RELEASE);
+	return async->result;
+}
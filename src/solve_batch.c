@@ -0,0 +1,201 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <errno.h> // IWYU pragma: keep
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "lib.h"
+#include "solve.h"
+
+/*! \struct solve_batch
+ * \brief Frames shared by the batch solver threads.
+ */
+struct solve_batch {
+	struct adb_solve_frame *frame; /*!< frames */
+	unsigned char *ready; /*!< frame prepared and waiting to solve */
+	int count; /*!< number of frames */
+	int next; /*!< next frame to claim */
+};
+
+/**
+ * \brief Prepare the haystack and quad index of a frame.
+ *
+ * Runs on the calling thread before the batch threads start, so object
+ * sets and table quad indexes are never changed while frames solve.
+ *
+ * \param batch Batch being prepared.
+ * \param i Frame to prepare.
+ * \return 0 on success or a negative error code for the frame.
+ */
+static int batch_prepare_frame(struct solve_batch *batch, int i)
+{
+	struct adb_solve_frame *frame = &batch->frame[i];
+	struct adb_solve *solve = frame->solve;
+	int ret;
+
+	if (solve == NULL || frame->set == NULL)
+		return -EINVAL;
+
+	ret = solve_check_plate(solve);
+	if (ret < 0)
+		return ret;
+
+	/* frames on the same set and magnitudes share its haystack */
+	ret = target_prepare_source_objects(solve, frame->set, &solve->haystack);
+	if (ret <= 0) {
+		adb_error(solve->db, "cant get trixels %d\n", ret);
+		return ret < 0 ? ret : -ENODATA;
+	}
+
+	/* neighbour lists are shared too so build them before solving */
+	if (frame->find & ADB_FIND_NEIGHBOURS) {
+		ret = distance_prepare_neighbours(solve);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (frame->find & ADB_FIND_INDEX)
+		return quad_prepare_index(solve);
+
+	return 0;
+}
+
+/**
+ * \brief Solve claimed frames until none are left.
+ *
+ * \param data Batch.
+ * \return NULL.
+ */
+static void *batch_thread_run(void *data)
+{
+	struct solve_batch *batch = data;
+	struct adb_solve_frame *frame;
+	int i;
+
+	for (;;) {
+		i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+		if (i >= batch->count)
+			return NULL;
+
+		if (!batch->ready[i])
+			continue;
+
+		frame = &batch->frame[i];
+		frame->result = solve_plate_windows(frame->solve, frame->find);
+	}
+}
+
+int adb_solve_batch(struct adb_solve_frame *frame, int count)
+{
+	struct solve_batch batch;
+	struct adb_solve *solve;
+	struct solve_quad *quad;
+	pthread_t *thread;
+	int *workers, i, ready = 0, threads, started, solved = 0;
+
+	if (frame == NULL || count <= 0)
+		return -EINVAL;
+
+	batch.frame = frame;
+	batch.count = count;
+	batch.next = 0;
+	batch.ready = calloc(count, 1);
+	workers = calloc(count, sizeof(*workers));
+	if (batch.ready == NULL || workers == NULL) {
+		free(batch.ready);
+		free(workers);
+		return -ENOMEM;
+	}
+
+	/* prepare every frame before any frame solves */
+	for (i = 0; i < count; i++) {
+		frame[i].result = batch_prepare_frame(&batch, i);
+		batch.ready[i] = frame[i].result == 0;
+	}
+
+	/* a later frame may have replaced the quad index of an earlier one */
+	for (i = 0; i < count; i++) {
+		solve = frame[i].solve;
+		if (!batch.ready[i] || !(frame[i].find & ADB_FIND_INDEX))
+			continue;
+
+		quad = solve->table->quad;
+		if (quad == NULL || quad->max_mag != solve->constraint.min_mag ||
+			quad->max_fov != solve->constraint.max_fov) {
+			adb_error(solve->db, "frame %d quad index constraints differ\n",
+					  i);
+			frame[i].result = -EINVAL;
+			batch.ready[i] = 0;
+		}
+	}
+
+	for (i = 0; i < count; i++)
+		ready += batch.ready[i];
+
+	if (ready == 0)
+		goto out;
+
+	/* frames run in parallel, the db workers are shared between them */
+	threads = db_workers(frame[0].solve->db);
+	if (threads > ready)
+		threads = ready;
+
+	for (i = 0; i < count; i++) {
+		if (!batch.ready[i])
+			continue;
+		workers[i] = frame[i].solve->workers;
+		frame[i].solve->workers = db_workers(frame[i].solve->db) / threads;
+		if (frame[i].solve->workers < 1)
+			frame[i].solve->workers = 1;
+	}
+
+	thread = calloc(threads, sizeof(*thread));
+	if (thread == NULL)
+		threads = 1;
+
+	/* the caller still solves every frame if no threads can start */
+	for (started = 1; started < threads; started++) {
+		if (pthread_create(&thread[started], NULL, batch_thread_run, &batch))
+			break;
+	}
+
+	adb_info(frame[0].solve->db, ADB_LOG_SOLVE,
+			 "solving %d frames of %d on %d threads\n", ready, count, started);
+
+	batch_thread_run(&batch);
+	for (i = 1; i < started; i++)
+		pthread_join(thread[i], NULL);
+	free(thread);
+
+	for (i = 0; i < count; i++) {
+		if (batch.ready[i])
+			frame[i].solve->workers = workers[i];
+	}
+
+out:
+	for (i = 0; i < count; i++) {
+		if (frame[i].result > 0)
+			solved++;
+	}
+
+	free(batch.ready);
+	free(workers);
+	return solved;
+}
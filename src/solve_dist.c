@@ -16,8 +16,10 @@
  *  Copyright (C) 2013 - 2014 Liam Girdwood
  */
 
+#include <errno.h> // IWYU pragma: keep
 #include <math.h>
 #include <pthread.h>
+#include <stdlib.h>
 
 #include "debug.h"
 #include "solve.h"
@@ -101,97 +103,133 @@ static inline int distance_not_within_fov(struct adb_solve *solve,
 }
 
 /**
- * \brief Attempt to solve a 4-star pattern match utilizing distance ratios targeting a single object.
- *
- * Evaluates candidate database "source" stars checking if their distances
- * to the proposed solution central object match the distances seen on the 
- * photographic plate. Records the divergence.
+ * \brief Check one candidate source object against the single object distances.
  *
  * \param runtime The active solver execution state containing candidate sets.
  * \param solution A proposed solution model tracking current matched objects.
- * \return The number of matched candidate objects verified for the target.
+ * \param s Candidate source object.
+ * \return 1 if the candidate matched and was recorded, 0 otherwise.
  */
-int distance_solve_single_object(struct solve_runtime *runtime,
-								 struct adb_solve_solution *solution)
+static int single_object_distance(struct solve_runtime *runtime,
+								  struct adb_solve_solution *solution,
+								  const struct adb_object *s)
 {
-	const struct adb_object *s;
-	struct target_solve_mag *range = &runtime->pot_magnitude;
-	int i, count = 0;
 	double distance, diff[4], diverge;
 
-	/* check distance ratio for each matching candidate against targets */
-	runtime->num_pot_distance = 0;
+	SOBJ_CHECK(s);
 
-	/* check t0 candidates */
-	for (i = range->start_pos[0]; i < range->end_pos[0]; i++) {
-		s = solution->source.objects[i];
+	/* plate object to candidate object 0 */
+	distance = distance_get_equ(solution->object[0], s);
 
-		SOBJ_CHECK(s);
+	SOBJ_CHECK_DIST(s, distance, runtime->soln_target[0].distance.pattern_min,
+					runtime->soln_target[0].distance.pattern_max, 1);
 
-		/* plate object to candidate object 0 */
-		distance = distance_get_equ(solution->object[0], s);
+	if (distance > runtime->soln_target[0].distance.pattern_max)
+		return 0;
+	if (distance < runtime->soln_target[0].distance.pattern_min)
+		return 0;
+	diff[0] = distance / runtime->soln_target[0].distance.plate_actual;
 
-		SOBJ_CHECK_DIST(s, distance,
-						runtime->soln_target[0].distance.pattern_min,
-						runtime->soln_target[0].distance.pattern_max, 1);
+	/* plate object to candidate object 1 */
+	distance = distance_get_equ(solution->object[1], s);
 
-		if (distance > runtime->soln_target[0].distance.pattern_max)
-			continue;
-		if (distance < runtime->soln_target[0].distance.pattern_min)
-			continue;
-		diff[0] = distance / runtime->soln_target[0].distance.plate_actual;
+	SOBJ_CHECK_DIST(s, distance, runtime->soln_target[1].distance.pattern_min,
+					runtime->soln_target[1].distance.pattern_max, 2);
 
-		/* plate object to candidate object 1 */
-		distance = distance_get_equ(solution->object[1], s);
+	if (distance > runtime->soln_target[1].distance.pattern_max)
+		return 0;
+	if (distance < runtime->soln_target[1].distance.pattern_min)
+		return 0;
+	diff[1] = distance / runtime->soln_target[1].distance.plate_actual;
 
-		SOBJ_CHECK_DIST(s, distance,
-						runtime->soln_target[1].distance.pattern_min,
-						runtime->soln_target[1].distance.pattern_max, 2);
+	/* plate object to candidate object 2 */
+	distance = distance_get_equ(solution->object[2], s);
 
-		if (distance > runtime->soln_target[1].distance.pattern_max)
-			continue;
-		if (distance < runtime->soln_target[1].distance.pattern_min)
-			continue;
-		diff[1] = distance / runtime->soln_target[1].distance.plate_actual;
+	SOBJ_CHECK_DIST(s, distance, runtime->soln_target[2].distance.pattern_min,
+					runtime->soln_target[2].distance.pattern_max, 3);
 
-		/* plate object to candidate object 2 */
-		distance = distance_get_equ(solution->object[2], s);
+	if (distance > runtime->soln_target[2].distance.pattern_max)
+		return 0;
+	if (distance < runtime->soln_target[2].distance.pattern_min)
+		return 0;
+	diff[2] = distance / runtime->soln_target[2].distance.plate_actual;
 
-		SOBJ_CHECK_DIST(s, distance,
-						runtime->soln_target[2].distance.pattern_min,
-						runtime->soln_target[2].distance.pattern_max, 3);
+	/* plate object to candidate object 3 */
+	distance = distance_get_equ(solution->object[3], s);
 
-		if (distance > runtime->soln_target[2].distance.pattern_max)
-			continue;
-		if (distance < runtime->soln_target[2].distance.pattern_min)
-			continue;
-		diff[2] = distance / runtime->soln_target[2].distance.plate_actual;
+	SOBJ_CHECK_DIST(s, distance, runtime->soln_target[3].distance.pattern_min,
+					runtime->soln_target[3].distance.pattern_max, 4);
 
-		/* plate object to candidate object 3 */
-		distance = distance_get_equ(solution->object[3], s);
+	if (distance > runtime->soln_target[3].distance.pattern_max)
+		return 0;
+	if (distance < runtime->soln_target[3].distance.pattern_min)
+		return 0;
+	diff[3] = distance / runtime->soln_target[3].distance.plate_actual;
 
-		SOBJ_CHECK_DIST(s, distance,
-						runtime->soln_target[3].distance.pattern_min,
-						runtime->soln_target[3].distance.pattern_max, 4);
+	diverge = quad_diff(diff[0], diff[1], diff[2], diff[3]);
 
-		if (distance > runtime->soln_target[3].distance.pattern_max)
-			continue;
-		if (distance < runtime->soln_target[3].distance.pattern_min)
-			continue;
-		diff[3] = distance / runtime->soln_target[3].distance.plate_actual;
+	SOBJ_FOUND(s);
 
-		diverge = quad_diff(diff[0], diff[1], diff[2], diff[3]);
+	target_add_single_match_on_distance(runtime, s, &solution->source, diverge,
+										solution->flip);
+	return 1;
+}
 
-		SOBJ_FOUND(s);
+/**
+ * \brief Attempt to solve a 4-star pattern match utilizing distance ratios targeting a single object.
+ *
+ * Evaluates candidate database "source" stars checking if their distances
+ * to the proposed solution central object match the distances seen on the 
+ * photographic plate. Records the divergence.
+ *
+ * \param runtime The active solver execution state containing candidate sets.
+ * \param solution A proposed solution model tracking current matched objects.
+ * \return The number of matched candidate objects verified for the target.
+ */
+int distance_solve_single_object(struct solve_runtime *runtime,
+								 struct adb_solve_solution *solution)
+{
+	struct target_solve_mag *range = &runtime->pot_magnitude;
+	int i, count = 0;
 
-		target_add_single_match_on_distance(runtime, s, &solution->source,
-											diverge, solution->flip);
-		count++;
-	}
+	/* check distance ratio for each matching candidate against targets */
+	runtime->num_pot_distance = 0;
+
+	/* check t0 candidates */
+	for (i = range->start_pos[0]; i < range->end_pos[0]; i++)
+		count += single_object_distance(runtime, solution,
+										solution->source.objects[i]);
 
 	return count;
 }
 
+/**
+ * \brief Check a list of single object candidates on pattern distance.
+ *
+ * Same checks as distance_solve_single_object() for candidates already
+ * picked out of the magnitude range, in the same source order.
+ *
+ * \param runtime The active solver execution state containing candidate sets.
+ * \param solution A proposed solution model tracking current matched objects.
+ * \param index Ascending source positions of the candidates.
+ * \param count Number of candidates.
+ * \return The number of matched candidate objects verified for the target.
+ */
+int distance_solve_single_object_list(struct solve_runtime *runtime,
+									  struct adb_solve_solution *solution,
+									  const int *index, int count)
+{
+	int i, found = 0;
+
+	runtime->num_pot_distance = 0;
+
+	for (i = 0; i < count; i++)
+		found += single_object_distance(runtime, solution,
+										solution->source.objects[index[i]]);
+
+	return found;
+}
+
 /**
  * \brief Extended single object distance solver accounting for dynamic object sizes.
  *
@@ -287,21 +325,316 @@ int distance_solve_single_object_extended(struct solve_runtime *runtime,
 	return count;
 }
 
+/* haystack position with its declination for the neighbour sweep */
+struct neighbour_dec {
+	double dec;
+	int index;
+};
+
+static int neighbour_dec_cmp(const void *o1, const void *o2)
+{
+	const struct neighbour_dec *d1 = o1, *d2 = o2;
+
+	if (d1->dec < d2->dec)
+		return -1;
+	else if (d1->dec > d2->dec)
+		return 1;
+	return d1->index - d2->index;
+}
+
+static int neighbour_distance_cmp(const void *o1, const void *o2)
+{
+	const struct solve_neighbour *n1 = o1, *n2 = o2;
+
+	if (n1->distance < n2->distance)
+		return -1;
+	else if (n1->distance > n2->distance)
+		return 1;
+	return n1->index - n2->index;
+}
+
 /**
- * \brief Core astrometric solver routine utilizing asterism distance ratios.
+ * \brief Build the neighbour lists of every haystack object.
  *
- * Performs a deep nested search through candidate source objects in the 
- * "haystack" catalog. For an unknown "primary" plate object, it builds
- * tuples of three neighboring stars and checks if the relative angular distances
- * between them match the pixel distance ratios measured off the image plate.
- * If a matching 4-star pattern is found, a potential solution is recorded.
+ * Objects are swept in declination order so each object only checks the
+ * objects within the maximum FOV in declination, using the same FOV checks
+ * as the full magnitude range sweep.
+ *
+ * \param solve Solver with its haystack prepared.
+ * \param source Haystack objects.
+ * \return Neighbour lists or NULL if out of memory.
+ */
+static struct solve_neighbours *
+neighbours_new(struct adb_solve *solve, struct adb_source_objects *source)
+{
+	struct solve_neighbours *neighbours;
+	struct solve_neighbour *neighbour;
+	struct neighbour_dec *dec;
+	const struct adb_object *p, *s;
+	double fov = solve->constraint.max_fov, distance;
+	int i, j, lo, hi, mid, count = 0, size = source->num_objects * 8 + 1;
+
+	neighbours = calloc(1, sizeof(*neighbours));
+	dec = calloc(source->num_objects + 1, sizeof(*dec));
+	if (neighbours == NULL || dec == NULL)
+		goto err;
+
+	neighbours->fov = fov;
+	neighbours->start = calloc(source->num_objects + 1, sizeof(int));
+	neighbours->neighbour = calloc(size, sizeof(*neighbours->neighbour));
+	if (neighbours->start == NULL || neighbours->neighbour == NULL)
+		goto err;
+
+	for (i = 0; i < source->num_objects; i++) {
+		dec[i].dec = source->objects[i]->dec;
+		dec[i].index = i;
+	}
+	qsort(dec, source->num_objects, sizeof(*dec), neighbour_dec_cmp);
+
+	for (i = 0; i < source->num_objects; i++) {
+		p = source->objects[i];
+		neighbours->start[i] = count;
+
+		/* first object inside the FOV in declination */
+		lo = 0;
+		hi = source->num_objects;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (dec[mid].dec < p->dec - fov)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		for (j = lo; j < source->num_objects && dec[j].dec <= p->dec + fov;
+			 j++) {
+			s = source->objects[dec[j].index];
+			if (s == p || distance_not_within_fov(solve, p, s))
+				continue;
+
+			distance = distance_get_equ(p, s);
+			if (distance > fov)
+				continue;
+
+			if (count == size) {
+				size *= 2;
+				neighbour = realloc(neighbours->neighbour,
+									size * sizeof(*neighbour));
+				if (neighbour == NULL)
+					goto err;
+				neighbours->neighbour = neighbour;
+			}
+
+			neighbour = &neighbours->neighbour[count++];
+			neighbour->distance = distance;
+			neighbour->pa = pa_get_equ(p, s);
+			neighbour->index = dec[j].index;
+		}
+
+		qsort(neighbours->neighbour + neighbours->start[i],
+			  count - neighbours->start[i], sizeof(struct solve_neighbour),
+			  neighbour_distance_cmp);
+	}
+	neighbours->start[i] = count;
+
+	free(dec);
+	return neighbours;
+
+err:
+	if (neighbours) {
+		free(neighbours->neighbour);
+		free(neighbours->start);
+	}
+	free(neighbours);
+	free(dec);
+	return NULL;
+}
+
+int distance_prepare_neighbours(struct adb_solve *solve)
+{
+	struct solve_haystack *haystack = solve->source;
+	struct solve_neighbours *neighbours;
+
+	if (haystack == NULL)
+		return -EINVAL;
+
+	for (neighbours = haystack->neighbours; neighbours;
+		 neighbours = neighbours->next) {
+		if (neighbours->fov == solve->constraint.max_fov) {
+			solve->neighbours = neighbours;
+			return 0;
+		}
+	}
+
+	neighbours = neighbours_new(solve, &haystack->source);
+	if (neighbours == NULL)
+		return -ENOMEM;
+
+	neighbours->next = haystack->neighbours;
+	haystack->neighbours = neighbours;
+	solve->neighbours = neighbours;
+
+	adb_info(solve->db, ADB_LOG_SOLVE,
+			 "using %d neighbours of %d solver source objects\n",
+			 neighbours->start[haystack->source.num_objects],
+			 haystack->source.num_objects);
+	return 0;
+}
+
+/**
+ * \brief Get the haystack position of a primary.
+ *
+ * \param source Magnitude sorted haystack.
+ * \param primary Haystack object.
+ * \return Position of the primary or -1 if it's not in the haystack.
+ */
+static int neighbour_get_primary(struct adb_source_objects *source,
+								 const struct adb_object *primary)
+{
+	int lo = 0, hi = source->num_objects, mid;
+
+	/* first object as bright as the primary */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (source->objects[mid]->mag < primary->mag)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < source->num_objects &&
+		   source->objects[lo]->mag == primary->mag;
+		 lo++) {
+		if (source->objects[lo] == primary)
+			return lo;
+	}
+
+	return -1;
+}
+
+/**
+ * \brief Get the first neighbour at least a distance from the primary.
+ *
+ * \param neighbour Neighbours of the primary sorted on distance.
+ * \param count Number of neighbours.
+ * \param distance Separation from the primary.
+ * \return Position of the first neighbour, count if there are none.
+ */
+static int neighbour_get_first(const struct solve_neighbour *neighbour,
+							   int count, double distance)
+{
+	int lo = 0, hi = count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (neighbour[mid].distance < distance)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static inline int neighbour_in_range(struct target_solve_mag *range, int t,
+									 int index)
+{
+	return index >= range->start_pos[t] && index < range->end_pos[t];
+}
+
+/**
+ * \brief Check magnitude matched objects on distance from the neighbour lists.
+ *
+ * Same checks as the full magnitude range sweep, but t1 and t2 candidates
+ * are taken from the binary searched separation window of the primary
+ * neighbour list and the primary PAs are passed on from the lists.
  *
  * \param runtime The solver context state controlling current match iterations.
- * \param primary The target primary catalog object being evaluated as the center of the asterism.
- * \return The number of candidate asterisms successfully pattern matched.
+ * \param primary The target primary catalog object.
+ * \return The number of candidate asterisms matched on distance.
  */
-int distance_solve_object(struct solve_runtime *runtime,
-						  const struct adb_object *primary)
+static int distance_solve_neighbours(struct solve_runtime *runtime,
+									 const struct adb_object *primary)
+{
+	const struct solve_neighbour *list, *n[3];
+	struct needle_object *t0, *t1, *t2;
+	struct adb_solve *solve = runtime->solve;
+	struct solve_neighbours *neighbours = solve->neighbours;
+	struct target_solve_mag *range = &runtime->pot_magnitude;
+	int i, j, k, p, count = 0, num;
+	double rad_per_pixel, ratio1, ratio2, delta, pa[3];
+	double t1_min, t1_max, t2_min, t2_max;
+
+	t0 = &solve->target.secondary[0];
+	t1 = &solve->target.secondary[1];
+	t2 = &solve->target.secondary[2];
+	runtime->num_pot_distance = 0;
+
+	p = neighbour_get_primary(&solve->haystack, primary);
+	if (p < 0)
+		return 0;
+
+	list = neighbours->neighbour + neighbours->start[p];
+	num = neighbours->start[p + 1] - neighbours->start[p];
+
+	for (i = 0; i < num; i++) {
+		if (!(i & 63) && solve_expired(solve))
+			break;
+
+		n[0] = &list[i];
+		if (!neighbour_in_range(range, 0, n[0]->index))
+			continue;
+
+		rad_per_pixel = n[0]->distance / t0->distance.plate_actual;
+		t1_min = t1->distance.pattern_min * rad_per_pixel;
+		t1_max = t1->distance.pattern_max * rad_per_pixel;
+		t2_min = t2->distance.pattern_min * rad_per_pixel;
+		t2_max = t2->distance.pattern_max * rad_per_pixel;
+
+		for (j = neighbour_get_first(list, num, t1_min);
+			 j < num && list[j].distance <= t1_max; j++) {
+			n[1] = &list[j];
+			if (n[1] == n[0] || !neighbour_in_range(range, 1, n[1]->index))
+				continue;
+
+			for (k = neighbour_get_first(list, num, t2_min);
+				 k < num && list[k].distance <= t2_max; k++) {
+				n[2] = &list[k];
+				if (n[2] == n[0] || n[2] == n[1] ||
+					!neighbour_in_range(range, 2, n[2]->index))
+					continue;
+
+				ratio1 = n[1]->distance / t1->distance.plate_actual;
+				ratio2 = n[2]->distance / t2->distance.plate_actual;
+				delta = tri_diff(rad_per_pixel, ratio1, ratio2);
+
+				pa[0] = n[0]->pa;
+				pa[1] = n[1]->pa;
+				pa[2] = n[2]->pa;
+				target_add_match_on_distance(
+					runtime, primary, &solve->haystack, n[0]->index,
+					n[1]->index, n[2]->index, delta,
+					tri_avg(rad_per_pixel, ratio1, ratio2), pa);
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+/**
+ * \brief Check magnitude matched objects on distance through the haystack.
+ *
+ * Walks the haystack object pointers, so the DEBUG object traces follow
+ * each stage of the checks.
+ *
+ * \param runtime The solver context state controlling current match iterations.
+ * \param primary The target primary catalog object.
+ * \return The number of candidate asterisms matched on distance.
+ */
+static int distance_solve_haystack(struct solve_runtime *runtime,
+								   const struct adb_object *primary)
 {
 	const struct adb_object *s[3];
 	struct needle_object *t0, *t1, *t2;
@@ -315,7 +648,6 @@ int distance_solve_object(struct solve_runtime *runtime,
 	t0 = &solve->target.secondary[0];
 	t1 = &solve->target.secondary[1];
 	t2 = &solve->target.secondary[2];
-	runtime->num_pot_distance = 0;
 
 	DOBJ_CHECK(1, primary);
 	adb_vdebug(solve->db, ADB_LOG_SOLVE, "0 start %d stop %d\n",
@@ -326,6 +658,10 @@ int distance_solve_object(struct solve_runtime *runtime,
 			   range->start_pos[2], range->end_pos[2]);
 	/* check t0 candidates */
 	for (i = range->start_pos[0]; i < range->end_pos[0]; i++) {
+		/* give up on pathological primaries at the deadline */
+		if (!((i - range->start_pos[0]) & 63) && solve_expired(solve))
+			break;
+
 		/* dont solve against ourself */
 		s[0] = solve->haystack.objects[i];
 		if (s[0] == primary)
@@ -419,7 +755,7 @@ int distance_solve_object(struct solve_runtime *runtime,
 
 						target_add_match_on_distance(
 							runtime, primary, &solve->haystack, i, j, k, delta,
-							tri_avg(rad_per_pixel, ratio1, ratio2));
+							tri_avg(rad_per_pixel, ratio1, ratio2), NULL);
 						count++;
 					}
 				}
@@ -429,3 +765,37 @@ int distance_solve_object(struct solve_runtime *runtime,
 
 	return count;
 }
+
+/**
+ * \brief Core astrometric solver routine utilizing asterism distance ratios.
+ *
+ * Performs a deep nested search through candidate source objects in the 
+ * "haystack" catalog. For an unknown "primary" plate object, it builds
+ * tuples of three neighboring stars and checks if the relative angular distances
+ * between them match the pixel distance ratios measured off the image plate.
+ * If a matching 4-star pattern is found, a potential solution is recorded.
+ *
+ * \param runtime The solver context state controlling current match iterations.
+ * \param primary The target primary catalog object being evaluated as the center of the asterism.
+ * \return The number of candidate asterisms successfully pattern matched.
+ */
+int distance_solve_object(struct solve_runtime *runtime,
+						  const struct adb_object *primary)
+{
+	struct adb_solve *solve = runtime->solve;
+
+	runtime->num_pot_distance = 0;
+
+	if (solve->neighbours != NULL)
+		return distance_solve_neighbours(runtime, primary);
+
+#ifndef DEBUG
+	/* score every candidate on the backend from the haystack positions */
+	if (solve->source != NULL && solve->source->score != NULL)
+		return solve_score_get_backend()->distance(runtime,
+												   solve->source->score,
+												   primary);
+#endif
+
+	return distance_solve_haystack(runtime, primary);
+}
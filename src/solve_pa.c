@@ -88,7 +88,7 @@ double pa_get_equ(const struct adb_object *o1, const struct adb_object *o2)
  * \param delta The cumulative error divergence of the position angles.
  */
 static void add_pot_on_pa(struct solve_runtime *runtime,
-						  struct adb_solve_solution *p, double delta)
+						  struct solve_candidate *p, double delta)
 {
 	if (runtime->num_pot_pa >= MAX_ACTUAL_MATCHES)
 		return;
@@ -140,7 +140,7 @@ static inline int pa_valid(struct needle_object *t, double delta, int flip)
 int pa_solve_object(struct solve_runtime *runtime,
 					const struct adb_object *primary, int idx)
 {
-	struct adb_solve_solution *p;
+	struct solve_candidate *p;
 	struct adb_solve *solve = runtime->solve;
 	struct needle_object *t0, *t1, *t2;
 	double pa1, pa2, pa3, pa_delta12, pa_delta23, pa_delta31, delta;
@@ -157,8 +157,13 @@ int pa_solve_object(struct solve_runtime *runtime,
 		p->flip = 0;
 
 		/* check PA for primary to each secondary object */
-		pa1 = pa_get_equ(p->object[0], p->object[1]);
-		pa2 = pa_get_equ(p->object[0], p->object[2]);
+		if (p->has_pa) {
+			pa1 = p->pa[0];
+			pa2 = p->pa[1];
+		} else {
+			pa1 = pa_get_equ(p->object[0], p->object[1]);
+			pa2 = pa_get_equ(p->object[0], p->object[2]);
+		}
 		pa_delta12 = pa1 - pa2;
 		if (pa_delta12 < 0.0)
 			pa_delta12 += 2.0 * M_PI;
@@ -178,7 +183,7 @@ int pa_solve_object(struct solve_runtime *runtime,
 
 next:
 		/* matches delta 1 - 2, now try 2 - 3 */
-		pa3 = pa_get_equ(p->object[0], p->object[3]);
+		pa3 = p->has_pa ? p->pa[2] : pa_get_equ(p->object[0], p->object[3]);
 		pa_delta23 = pa2 - pa3;
 		if (pa_delta23 < 0.0)
 			pa_delta23 += 2.0 * M_PI;
@@ -225,7 +230,7 @@ next:
 int pa_solve_single_object(struct solve_runtime *runtime,
 						   struct adb_solve_solution *solution)
 {
-	struct adb_solve_solution *p;
+	struct solve_candidate *p;
 	double pa0, pa1, pa2, pa3;
 	double pa_delta01, pa_delta12, pa_delta23, pa_delta30, delta;
 	int i, count = 0;
@@ -0,0 +1,669 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <errno.h> // IWYU pragma: keep
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "debug.h"
+#include "private.h"
+#include "simd.h"
+#include "solve.h"
+
+#define QUAD_FILE_MAGIC 0x44415551 /* "QUAD" */
+#define QUAD_FILE_VERSION 1
+
+/* pattern triangles primary -> t0 t1, t1 t2 and t0 t2 */
+#define QUAD_TRIANGLES 3
+
+/*! \struct quad_file_hdr
+ * \brief quad index file header
+ * \ingroup solve
+ *
+ * The header is followed by the cell offsets and then by the codes in cell
+ * order. Codes refer to table objects by position in the table file.
+ */
+struct quad_file_hdr {
+	u_int32_t magic; /*!< QUAD_FILE_MAGIC */
+	u_int32_t version; /*!< QUAD_FILE_VERSION */
+	u_int32_t object_bytes; /*!< size of each table object */
+	u_int32_t object_count; /*!< number of table objects */
+	u_int32_t neighbours; /*!< QUAD_NEIGHBOURS */
+	u_int32_t cells; /*!< QUAD_CELLS */
+	u_int32_t count; /*!< number of codes */
+	u_int32_t reserved;
+	double max_mag; /*!< faintest indexed magnitude */
+	double max_fov; /*!< largest indexed neighbour distance */
+} __attribute__((packed));
+
+/*! \struct quad_star
+ * \brief indexed star
+ * \ingroup solve
+ */
+struct quad_star {
+	double v[3]; /*!< unit vector */
+	float mag;
+	unsigned int index; /*!< table position */
+};
+
+static int quad_star_cmp(const void *a, const void *b)
+{
+	const struct quad_star *sa = a, *sb = b;
+
+	if (sa->v[1] != sb->v[1])
+		return sa->v[1] < sb->v[1] ? -1 : 1;
+	return sa->index < sb->index ? -1 : sa->index > sb->index;
+}
+
+static inline double quad_dot(const double a[3], const double b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static inline double quad_norm(const double a[3])
+{
+	return sqrt(quad_dot(a, a));
+}
+
+static inline int quad_bin(double value, double range, int bins)
+{
+	int bin = value * bins / range;
+
+	if (bin < 0)
+		return 0;
+	if (bin >= bins)
+		return bins - 1;
+	return bin;
+}
+
+static inline int quad_cell(double ratio, double angle)
+{
+	return quad_bin(ratio, 1.0, QUAD_RATIO_BINS) * QUAD_ANGLE_BINS +
+		   quad_bin(angle, M_PI, QUAD_ANGLE_BINS);
+}
+
+/**
+ * \brief Set the code of the triangle formed by a primary and two neighbours.
+ *
+ * The ratio of the neighbour distances and the angle between them at the
+ * primary don't change with plate scale, rotation or flip. Taking the
+ * nearer neighbour over the further makes the code independent of the
+ * neighbour order.
+ *
+ * \param code Code to set.
+ * \param p Primary star.
+ * \param a First neighbour.
+ * \param b Second neighbour.
+ * \return 0 on success or -EINVAL for coincident stars.
+ */
+static int quad_code_set(struct quad_code *code, const struct quad_star *p,
+						 const struct quad_star *a, const struct quad_star *b)
+{
+	double ta[3], tb[3], c[3], pa, pb, da, db;
+	int i;
+
+	/* neighbour directions in the tangent plane of the primary */
+	pa = quad_dot(p->v, a->v);
+	pb = quad_dot(p->v, b->v);
+	for (i = 0; i < 3; i++) {
+		ta[i] = a->v[i] - p->v[i] * pa;
+		tb[i] = b->v[i] - p->v[i] * pb;
+	}
+
+	da = atan2(quad_norm(ta), pa);
+	db = atan2(quad_norm(tb), pb);
+	if (da <= 0.0 || db <= 0.0)
+		return -EINVAL;
+
+	c[0] = ta[1] * tb[2] - ta[2] * tb[1];
+	c[1] = ta[2] * tb[0] - ta[0] * tb[2];
+	c[2] = ta[0] * tb[1] - ta[1] * tb[0];
+
+	code->ratio = da < db ? da / db : db / da;
+	code->angle = atan2(quad_norm(c), quad_dot(ta, tb));
+	code->primary = p->index;
+	return 0;
+}
+
+/**
+ * \brief Add a star to a neighbour list kept in brightness order.
+ *
+ * \param star Indexed stars.
+ * \param nb Neighbour list, QUAD_NEIGHBOURS long.
+ * \param count Neighbours in the list.
+ * \param s Star to add.
+ * \return New neighbour count.
+ */
+static int quad_add_neighbour(const struct quad_star *star, int *nb, int count,
+							  int s)
+{
+	const struct quad_star *prev;
+	int i;
+
+	/* keep the brightest, ties in table order */
+	for (i = count; i > 0; i--) {
+		prev = &star[nb[i - 1]];
+		if (prev->mag < star[s].mag ||
+			(prev->mag == star[s].mag && prev->index < star[s].index))
+			break;
+		if (i < QUAD_NEIGHBOURS)
+			nb[i] = nb[i - 1];
+	}
+
+	if (i < QUAD_NEIGHBOURS)
+		nb[i] = s;
+
+	return count < QUAD_NEIGHBOURS ? count + 1 : count;
+}
+
+/* first star at or above sin(DEC) */
+static int quad_lower(const double *y, int count, double value)
+{
+	int low = 0, high = count, mid;
+
+	while (low < high) {
+		mid = (low + high) >> 1;
+		if (y[mid] < value)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+/* first star above sin(DEC) */
+static int quad_upper(const double *y, int count, double value)
+{
+	int low = 0, high = count, mid;
+
+	while (low < high) {
+		mid = (low + high) >> 1;
+		if (y[mid] <= value)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+/**
+ * \brief Group quad codes by cell.
+ *
+ * \param quad Quad index, code holding count ungrouped codes.
+ * \return 0 on success or -ENOMEM.
+ */
+static int quad_group_codes(struct solve_quad *quad)
+{
+	struct quad_code *code;
+	unsigned int *fill;
+	int i;
+
+	code = malloc((quad->count ? quad->count : 1) * sizeof(*code));
+	fill = malloc(QUAD_CELLS * sizeof(*fill));
+	if (code == NULL || fill == NULL) {
+		free(code);
+		free(fill);
+		return -ENOMEM;
+	}
+
+	memset(quad->cell, 0, sizeof(quad->cell));
+	for (i = 0; i < quad->count; i++)
+		quad->cell[quad_cell(quad->code[i].ratio, quad->code[i].angle) + 1]++;
+	for (i = 0; i < QUAD_CELLS; i++) {
+		quad->cell[i + 1] += quad->cell[i];
+		fill[i] = quad->cell[i];
+	}
+
+	/* codes keep build order inside each cell */
+	for (i = 0; i < quad->count; i++)
+		code[fill[quad_cell(quad->code[i].ratio, quad->code[i].angle)]++] =
+			quad->code[i];
+
+	free(fill);
+	free(quad->code);
+	quad->code = code;
+	return 0;
+}
+
+/**
+ * \brief Build the quad index of the solve table.
+ *
+ * Each star down to the index magnitude is paired with its QUAD_NEIGHBOURS
+ * brightest neighbours within the index FOV, found by scanning the
+ * declination band of stars sorted on DEC with the cone kernel.
+ *
+ * \param solve Solver context.
+ * \param quad Quad index with magnitude and FOV set.
+ * \return 0 on success, or a negative error code.
+ */
+static int quad_build(struct adb_solve *solve, struct solve_quad *quad)
+{
+	struct adb_table *table = solve->table;
+	const struct table_columns *col;
+	struct quad_star *star = NULL;
+	double *x = NULL, *y, *z, cos_fov, dec, ylo, yhi;
+	int nb[QUAD_NEIGHBOURS], *sel = NULL;
+	int i, j, k, l, n = 0, lo, hi, num, ret;
+
+	if (table->object.count == 0) {
+		adb_error(solve->db, "table has no objects to index\n");
+		return -EINVAL;
+	}
+
+	ret = table_load_all(table);
+	if (ret < 0)
+		return ret;
+
+	col = table_get_columns(table);
+	if (col == NULL)
+		return -ENOMEM;
+
+	star = malloc(col->count * sizeof(*star));
+	if (star == NULL)
+		return -ENOMEM;
+
+	/* same magnitude and bogus object checks as the haystack */
+	for (i = 0; i < col->count; i++) {
+		if (!(col->mag[i] <= quad->max_mag))
+			continue;
+		if (col->ra[i] == 0.0 || col->dec[i] == 0.0 || col->mag[i] == 0.0)
+			continue;
+
+		star[n].v[0] = col->x[i];
+		star[n].v[1] = col->y[i];
+		star[n].v[2] = col->z[i];
+		star[n].mag = col->mag[i];
+		star[n++].index = i;
+	}
+
+	qsort(star, n, sizeof(*star), quad_star_cmp);
+
+	ret = -ENOMEM;
+	x = malloc((n ? n : 1) * 3 * sizeof(*x));
+	sel = malloc((n ? n : 1) * sizeof(*sel));
+	quad->code = malloc((n ? n : 1) * (QUAD_NEIGHBOURS * (QUAD_NEIGHBOURS - 1) /
+									   2) * sizeof(*quad->code));
+	if (x == NULL || sel == NULL || quad->code == NULL)
+		goto out;
+
+	y = x + n;
+	z = y + n;
+	for (i = 0; i < n; i++) {
+		x[i] = star[i].v[0];
+		y[i] = star[i].v[1];
+		z[i] = star[i].v[2];
+	}
+
+	cos_fov = cos(quad->max_fov);
+	quad->count = 0;
+
+	for (i = 0; i < n; i++) {
+		/* only stars in the declination band can be within the FOV */
+		dec = asin(y[i]);
+		ylo = dec - quad->max_fov <= -M_PI_2 ? -1.0 :
+											   sin(dec - quad->max_fov);
+		yhi = dec + quad->max_fov >= M_PI_2 ? 1.0 : sin(dec + quad->max_fov);
+		lo = quad_lower(y, n, ylo);
+		hi = quad_upper(y, n, yhi);
+
+		k = simd_select_cone(x + lo, y + lo, z + lo, hi - lo, star[i].v,
+							 cos_fov, sel);
+
+		for (j = 0, num = 0; j < k; j++) {
+			if (lo + sel[j] != i)
+				num = quad_add_neighbour(star, nb, num, lo + sel[j]);
+		}
+
+		for (j = 0; j < num; j++) {
+			for (l = j + 1; l < num; l++) {
+				if (quad_code_set(&quad->code[quad->count], &star[i],
+								  &star[nb[j]], &star[nb[l]]) == 0)
+					quad->count++;
+			}
+		}
+	}
+
+	ret = quad_group_codes(quad);
+
+out:
+	free(star);
+	free(x);
+	free(sel);
+	if (ret < 0) {
+		free(quad->code);
+		quad->code = NULL;
+	}
+	return ret;
+}
+
+/**
+ * \brief Read a quad index file.
+ *
+ * The file is only used when it was written for the same table objects and
+ * index constraints, and is newer than the table file.
+ *
+ * \param solve Solver context.
+ * \param quad Quad index with magnitude and FOV set.
+ * \param file Quad index file name.
+ * \return 0 on success, or a negative error code.
+ */
+static int quad_read(struct adb_solve *solve, struct solve_quad *quad,
+					 const char *file)
+{
+	struct adb_table *table = solve->table;
+	struct quad_file_hdr hdr;
+	struct stat db_stat, quad_stat;
+	char db_file[ADB_PATH_SIZE];
+	int i, ret = -EINVAL;
+	FILE *f;
+
+	if (stat(file, &quad_stat) < 0)
+		return -errno;
+
+	sprintf(db_file, "%s%s%s", table->path.local, table->path.file, ".db");
+	if (stat(db_file, &db_stat) == 0 && db_stat.st_mtime > quad_stat.st_mtime) {
+		adb_info(solve->db, ADB_LOG_SOLVE, "Quad index %s is stale\n", file);
+		return -EINVAL;
+	}
+
+	f = fopen(file, "r");
+	if (f == NULL)
+		return -errno;
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1)
+		goto out;
+
+	if (hdr.magic != QUAD_FILE_MAGIC || hdr.version != QUAD_FILE_VERSION ||
+		hdr.object_bytes != table->object.bytes ||
+		hdr.object_count != table->object.count ||
+		hdr.neighbours != QUAD_NEIGHBOURS || hdr.cells != QUAD_CELLS ||
+		hdr.max_mag != quad->max_mag || hdr.max_fov != quad->max_fov) {
+		adb_info(solve->db, ADB_LOG_SOLVE,
+				 "Quad index %s is for other constraints\n", file);
+		goto out;
+	}
+
+	if (fread(quad->cell, sizeof(quad->cell), 1, f) != 1)
+		goto out;
+
+	for (i = 0; i < QUAD_CELLS; i++) {
+		if (quad->cell[i] > quad->cell[i + 1])
+			goto out;
+	}
+	if (quad->cell[0] != 0 || quad->cell[QUAD_CELLS] != hdr.count)
+		goto out;
+
+	quad->code = malloc((hdr.count ? hdr.count : 1) * sizeof(*quad->code));
+	if (quad->code == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (hdr.count &&
+		fread(quad->code, sizeof(*quad->code), hdr.count, f) != hdr.count)
+		goto out;
+
+	for (i = 0; i < hdr.count; i++) {
+		if (quad->code[i].primary >= hdr.object_count)
+			goto out;
+	}
+
+	quad->count = hdr.count;
+	ret = 0;
+
+out:
+	fclose(f);
+	if (ret < 0) {
+		adb_error(solve->db, "Error can't use quad index %s\n", file);
+		free(quad->code);
+		quad->code = NULL;
+	}
+	return ret;
+}
+
+/**
+ * \brief Write a quad index file.
+ *
+ * \param solve Solver context.
+ * \param quad Quad index to write.
+ * \param file Quad index file name.
+ * \return 0 on success, or a negative error code.
+ */
+static int quad_write(struct adb_solve *solve, struct solve_quad *quad,
+					  const char *file)
+{
+	struct adb_table *table = solve->table;
+	struct quad_file_hdr hdr;
+	int ret = 0;
+	FILE *f;
+
+	f = fopen(file, "w");
+	if (f == NULL) {
+		adb_error(solve->db, "Error can't open quad index %s for writing\n",
+				  file);
+		return -EIO;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = QUAD_FILE_MAGIC;
+	hdr.version = QUAD_FILE_VERSION;
+	hdr.object_bytes = table->object.bytes;
+	hdr.object_count = table->object.count;
+	hdr.neighbours = QUAD_NEIGHBOURS;
+	hdr.cells = QUAD_CELLS;
+	hdr.count = quad->count;
+	hdr.max_mag = quad->max_mag;
+	hdr.max_fov = quad->max_fov;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+		fwrite(quad->cell, sizeof(quad->cell), 1, f) != 1 ||
+		fwrite(quad->code, sizeof(*quad->code), quad->count, f) != quad->count)
+		ret = -EIO;
+
+	if (fclose(f) != 0)
+		ret = -EIO;
+
+	if (ret < 0) {
+		adb_error(solve->db, "Error writing quad index %s\n", file);
+		remove(file);
+	}
+	return ret;
+}
+
+/**
+ * \brief Load or build the quad index for the solve constraints.
+ *
+ * The index is kept with the table and covers stars down to the faint
+ * ADB_CONSTRAINT_MAG limit with neighbours inside the maximum
+ * ADB_CONSTRAINT_FOV. It is read from the .quad file next to the table .db
+ * file when that was written for the same constraints, otherwise it is built
+ * and saved there.
+ *
+ * \param solve Solver context.
+ * \return 0 on success, or a negative error code.
+ */
+int quad_prepare_index(struct adb_solve *solve)
+{
+	struct adb_table *table = solve->table;
+	struct solve_quad *quad = table->quad;
+	char file[ADB_PATH_SIZE];
+	int ret;
+
+	if (quad && quad->max_mag == solve->constraint.min_mag &&
+		quad->max_fov == solve->constraint.max_fov)
+		return 0;
+
+	quad_free_index(table);
+
+	quad = calloc(1, sizeof(*quad));
+	if (quad == NULL)
+		return -ENOMEM;
+
+	quad->max_mag = solve->constraint.min_mag;
+	quad->max_fov = solve->constraint.max_fov;
+
+	sprintf(file, "%s%s%s", table->path.local, table->path.file, ".quad");
+	if (quad_read(solve, quad, file) == 0) {
+		adb_info(solve->db, ADB_LOG_SOLVE, "Read %d quad codes from %s\n",
+				 quad->count, file);
+		goto out;
+	}
+
+	ret = quad_build(solve, quad);
+	if (ret < 0) {
+		free(quad);
+		return ret;
+	}
+
+	adb_info(solve->db, ADB_LOG_SOLVE,
+			 "Built %d quad codes to mag %3.2f within %3.3f degrees\n",
+			 quad->count, quad->max_mag, quad->max_fov * R2D);
+
+	/* the index still works for this session if it can't be saved */
+	quad_write(solve, quad, file);
+
+out:
+	table->quad = quad;
+	return 0;
+}
+
+void quad_free_index(struct adb_table *table)
+{
+	if (table->quad == NULL)
+		return;
+
+	free(table->quad->code);
+	free(table->quad);
+	table->quad = NULL;
+}
+
+/**
+ * \brief Mark the primaries of codes inside a ratio and angle range.
+ *
+ * \param quad Quad index.
+ * \param mark Marks by table position.
+ * \param bit Mark bit for the pattern triangle.
+ * \param rmin Smallest ratio.
+ * \param rmax Largest ratio.
+ * \param amin Smallest angle.
+ * \param amax Largest angle.
+ */
+static void quad_mark_triangle(const struct solve_quad *quad,
+							   unsigned char *mark, int bit, double rmin,
+							   double rmax, double amin, double amax)
+{
+	const struct quad_code *code;
+	int r, a, rhi, alo, ahi;
+	unsigned int i, cell;
+
+	rhi = quad_bin(rmax, 1.0, QUAD_RATIO_BINS);
+	alo = quad_bin(amin, M_PI, QUAD_ANGLE_BINS);
+	ahi = quad_bin(amax, M_PI, QUAD_ANGLE_BINS);
+
+	for (r = quad_bin(rmin, 1.0, QUAD_RATIO_BINS); r <= rhi; r++) {
+		for (a = alo; a <= ahi; a++) {
+			cell = r * QUAD_ANGLE_BINS + a;
+
+			for (i = quad->cell[cell]; i < quad->cell[cell + 1]; i++) {
+				code = &quad->code[i];
+				if (code->ratio >= rmin && code->ratio <= rmax &&
+					code->angle >= amin && code->angle <= amax)
+					mark[code->primary] |= bit;
+			}
+		}
+	}
+}
+
+/**
+ * \brief Get the haystack primaries matching the current pattern.
+ *
+ * Each pair of pattern secondaries forms a triangle with the pattern primary
+ * whose code range follows from the distance and PA tolerances. Primaries
+ * with codes matching all three triangles become the candidates, kept in
+ * haystack order so the first solution found matches a full sweep.
+ *
+ * \param solve Solver context with a pattern and a prepared quad index.
+ * \return Number of candidates, or a negative error code.
+ */
+int quad_get_candidates(struct adb_solve *solve)
+{
+	static const int pair[QUAD_TRIANGLES][2] = { { 0, 1 }, { 1, 2 }, { 0, 2 } };
+	struct adb_table *table = solve->table;
+	struct adb_source_objects *haystack = &solve->haystack;
+	struct adb_pobject *primary =
+		&solve->plate.object[solve->plate.window_start];
+	double dist[MIN_PLATE_OBJECTS - 1], pa[MIN_PLATE_OBJECTS - 1];
+	double tol = solve->tolerance.dist, near, far, rmin, rmax, angle;
+	const struct adb_object *object;
+	size_t pos;
+	int i, count = 0;
+
+	if (solve->candidates.objects == NULL) {
+		solve->candidates.objects =
+			malloc((haystack->num_objects ? haystack->num_objects : 1) *
+				   sizeof(*solve->candidates.objects));
+		solve->quad_mark = malloc(table->object.count);
+		if (solve->candidates.objects == NULL || solve->quad_mark == NULL)
+			return -ENOMEM;
+	}
+
+	memset(solve->quad_mark, 0, table->object.count);
+
+	for (i = 0; i < MIN_PLATE_OBJECTS - 1; i++) {
+		dist[i] =
+			distance_get_plate(primary, solve->target.secondary[i].pobject);
+		pa[i] = pa_get_plate(primary, solve->target.secondary[i].pobject);
+	}
+
+	for (i = 0; i < QUAD_TRIANGLES; i++) {
+		near = dmin(dist[pair[i][0]], dist[pair[i][1]]);
+		far = dmax(dist[pair[i][0]], dist[pair[i][1]]);
+
+		rmin = dmax((near - tol) / (far + tol), 0.0);
+		rmax = far > tol ? dmin((near + tol) / (far - tol), 1.0) : 1.0;
+
+		/* flipped plates fold onto the same angle */
+		angle = fabs(remainder(pa[pair[i][1]] - pa[pair[i][0]], 2.0 * M_PI));
+
+		quad_mark_triangle(table->quad, solve->quad_mark, 1 << i, rmin, rmax,
+						   dmax(angle - solve->tolerance.pa, 0.0),
+						   dmin(angle + solve->tolerance.pa, M_PI));
+	}
+
+	for (i = 0; i < haystack->num_objects; i++) {
+		object = haystack->objects[i];
+		pos = ((const char *)object - (const char *)table->objects) /
+			  table->object.bytes;
+
+		if (solve->quad_mark[pos] == (1 << QUAD_TRIANGLES) - 1)
+			solve->candidates.objects[count++] = object;
+	}
+
+	solve->candidates.num_objects = count;
+
+	adb_info(solve->db, ADB_LOG_SOLVE,
+			 "quad index matched %d of %d primaries\n", count,
+			 haystack->num_objects);
+	return count;
+}
@@ -0,0 +1,239 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2013 - 2014 Liam Girdwood
+ */
+
+#include <errno.h> // IWYU pragma: keep
+#include <math.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "solve.h"
+
+/*
+ * CPU reference scoring backend. Each primary gets the distance to every
+ * magnitude matched haystack object computed once, the nested candidate
+ * loops then only compare distances against the pattern windows. Other
+ * backends must add the same candidates in the same order.
+ */
+
+/* distance of objects ruled out for the primary */
+#define SCORE_EXCLUDED HUGE_VAL
+
+static void score_cpu_release(struct solve_score *score)
+{
+	free(score->ra);
+	free(score->dec);
+	free(score->sin_dec);
+	free(score->cos_dec);
+	free(score);
+}
+
+static struct solve_score *
+score_cpu_prepare(const struct adb_source_objects *source)
+{
+	struct solve_score *score;
+	size_t bytes;
+	int i;
+
+	score = calloc(1, sizeof(*score));
+	if (score == NULL)
+		return NULL;
+
+	/* one extra so empty haystacks still get arrays */
+	bytes = (source->num_objects + 1) * sizeof(double);
+	score->ra = malloc(bytes);
+	score->dec = malloc(bytes);
+	score->sin_dec = malloc(bytes);
+	score->cos_dec = malloc(bytes);
+	if (score->ra == NULL || score->dec == NULL || score->sin_dec == NULL ||
+		score->cos_dec == NULL) {
+		score_cpu_release(score);
+		return NULL;
+	}
+
+	for (i = 0; i < source->num_objects; i++) {
+		score->ra[i] = source->objects[i]->ra;
+		score->dec[i] = source->objects[i]->dec;
+		score->sin_dec[i] = sin(score->dec[i]);
+		score->cos_dec[i] = cos(score->dec[i]);
+	}
+	score->count = source->num_objects;
+
+	return score;
+}
+
+/* same sums as distance_get_equ() so candidates match it exactly */
+static inline double score_distance(const struct solve_score *score, int i,
+									double ra, double sin_dec, double cos_dec)
+{
+	double x, y, z, ra_diff = score->ra[i] - ra;
+
+	x = (cos_dec * score->sin_dec[i]) -
+		(sin_dec * score->cos_dec[i] * cos(ra_diff));
+	y = score->cos_dec[i] * sin(ra_diff);
+	z = (sin_dec * score->sin_dec[i]) +
+		(cos_dec * score->cos_dec[i] * cos(ra_diff));
+
+	x = x * x;
+	y = y * y;
+
+	return atan2(sqrt(x + y), z);
+}
+
+/* same loose FOV check as distance_not_within_fov() */
+static inline int score_not_within_fov(const struct solve_score *score, int i,
+									   const struct adb_object *p,
+									   double max_fov)
+{
+	double ra_diff = fabs(p->ra - score->ra[i]);
+	double dec_diff = score->dec[i] + ((p->dec - score->dec[i]) / 2.0);
+
+	/* check for large angles near 0 and 2.0 * M_PI */
+	if (ra_diff > M_PI)
+		ra_diff -= 2.0 * M_PI;
+
+	if (cos(dec_diff) * ra_diff > max_fov)
+		return 1;
+	if (fabs(p->dec - score->dec[i]) > max_fov)
+		return 1;
+	return 0;
+}
+
+/**
+ * \brief Get the primary distances of the magnitude matched objects.
+ *
+ * \param runtime Solver runtime holding the distance buffer.
+ * \param score Haystack positions.
+ * \param primary Primary object.
+ * \param lo First haystack position.
+ * \param hi End haystack position.
+ * \return Distances from haystack position lo.
+ */
+static const double *score_get_distances(struct solve_runtime *runtime,
+										 const struct solve_score *score,
+										 const struct adb_object *primary,
+										 int lo, int hi)
+{
+	struct adb_solve *solve = runtime->solve;
+	double *distance, sin_dec, cos_dec, max_fov = solve->constraint.max_fov;
+	int i;
+
+	sin_dec = sin(primary->dec);
+	cos_dec = cos(primary->dec);
+	distance = runtime->distance;
+
+	for (i = lo; i < hi; i++) {
+		/* dont solve against ourself */
+		if (solve->haystack.objects[i] == primary ||
+			score_not_within_fov(score, i, primary, max_fov)) {
+			distance[i - lo] = SCORE_EXCLUDED;
+			continue;
+		}
+
+		/* rule out any distances > plate FOV */
+		distance[i - lo] = score_distance(score, i, primary->ra, sin_dec,
+										  cos_dec);
+		if (distance[i - lo] > max_fov)
+			distance[i - lo] = SCORE_EXCLUDED;
+	}
+
+	return distance;
+}
+
+static int score_cpu_distance(struct solve_runtime *runtime,
+							  const struct solve_score *score,
+							  const struct adb_object *primary)
+{
+	struct adb_solve *solve = runtime->solve;
+	struct target_solve_mag *range = &runtime->pot_magnitude;
+	struct needle_object *t0, *t1, *t2;
+	const double *distance;
+	double rad_per_pixel, ratio1, ratio2, delta;
+	double t1_min, t1_max, t2_min, t2_max;
+	int i, j, k, lo, hi, count = 0;
+
+	t0 = &solve->target.secondary[0];
+	t1 = &solve->target.secondary[1];
+	t2 = &solve->target.secondary[2];
+
+	lo = range->start_pos[0];
+	hi = range->end_pos[0];
+	for (i = 1; i < MIN_PLATE_OBJECTS - 1; i++) {
+		if (range->start_pos[i] < lo)
+			lo = range->start_pos[i];
+		if (range->end_pos[i] > hi)
+			hi = range->end_pos[i];
+	}
+	if (lo >= hi || hi > score->count || hi - lo > runtime->distance_size)
+		return 0;
+
+	distance = score_get_distances(runtime, score, primary, lo, hi);
+
+	/* check t0 candidates */
+	for (i = range->start_pos[0]; i < range->end_pos[0]; i++) {
+		/* give up on pathological primaries at the deadline */
+		if (!((i - range->start_pos[0]) & 63) && solve_expired(solve))
+			break;
+
+		if (distance[i - lo] == SCORE_EXCLUDED)
+			continue;
+
+		/* use ratio based on t0 <-> primary distance for t1 and t2 */
+		rad_per_pixel = distance[i - lo] / t0->distance.plate_actual;
+		t1_min = t1->distance.pattern_min * rad_per_pixel;
+		t1_max = t1->distance.pattern_max * rad_per_pixel;
+		t2_min = t2->distance.pattern_min * rad_per_pixel;
+		t2_max = t2->distance.pattern_max * rad_per_pixel;
+
+		/* check each t1 candidate against the t0 primary ratio */
+		for (j = range->start_pos[1]; j < range->end_pos[1]; j++) {
+			if (j == i || distance[j - lo] < t1_min ||
+				distance[j - lo] > t1_max)
+				continue;
+
+			/* check t2 candidates */
+			for (k = range->start_pos[2]; k < range->end_pos[2]; k++) {
+				if (k == i || k == j || distance[k - lo] < t2_min ||
+					distance[k - lo] > t2_max)
+					continue;
+
+				ratio1 = distance[j - lo] / t1->distance.plate_actual;
+				ratio2 = distance[k - lo] / t2->distance.plate_actual;
+				delta = tri_diff(rad_per_pixel, ratio1, ratio2);
+
+				target_add_match_on_distance(
+					runtime, primary, &solve->haystack, i, j, k, delta,
+					tri_avg(rad_per_pixel, ratio1, ratio2), NULL);
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+static const struct solve_score_backend score_cpu = {
+	.name = "cpu",
+	.prepare = score_cpu_prepare,
+	.release = score_cpu_release,
+	.distance = score_cpu_distance,
+};
+
+const struct solve_score_backend *solve_score_get_backend(void)
+{
+	return &score_cpu;
+}
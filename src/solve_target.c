@@ -18,12 +18,14 @@
 
 #include <stdlib.h>
 #include <errno.h> // IWYU pragma: keep
+#include <string.h>
 #include <unistd.h>
 #include <math.h>
 #include <pthread.h>
 #include <pthread.h>
 
 #include "debug.h"
+#include "simd.h"
 #include "solve.h"
 
 
@@ -65,6 +67,7 @@ int target_add_ref_object(struct adb_solve_solution *soln, int id,
 	soln->ref[soln->num_ref_objects].clip_mag = 0;
 	soln->ref[soln->num_ref_objects].clip_posn = 0;
 	soln->ref[soln->num_ref_objects++].pobject = *pobject;
+	soln->fit.valid = 0;
 
 	pthread_mutex_unlock(&solve->mutex);
 	return 1;
@@ -329,6 +332,51 @@ void target_create_single(struct adb_solve *solve, struct adb_pobject *pobject,
 	t3->pa_flip.pattern_max = 2.0 * M_PI - t3->pa.pattern_max;
 }
 
+/**
+ * \brief Prepare a runtime for the next primary or plate object.
+ *
+ * The candidate buffers are only valid up to their counters, so they are
+ * left as they are rather than cleared each time.
+ *
+ * \param runtime The execution state to reuse.
+ * \param solve The active solver.
+ */
+void solve_runtime_reset(struct solve_runtime *runtime,
+						 struct adb_solve *solve)
+{
+	runtime->solve = solve;
+	runtime->num_pot_distance = 0;
+	runtime->num_pot_distance_checked = 0;
+	runtime->num_pot_pa = 0;
+	memset(&runtime->pot_magnitude, 0, sizeof(runtime->pot_magnitude));
+#ifdef DEBUG
+	runtime->debug = 0;
+#endif
+}
+
+int solve_runtime_alloc(struct solve_runtime *runtime, int count)
+{
+	double *distance;
+
+	if (count <= runtime->distance_size)
+		return 0;
+
+	distance = realloc(runtime->distance, count * sizeof(double));
+	if (distance == NULL)
+		return -ENOMEM;
+
+	runtime->distance = distance;
+	runtime->distance_size = count;
+	return 0;
+}
+
+void solve_runtime_free(struct solve_runtime *runtime)
+{
+	free(runtime->distance);
+	runtime->distance = NULL;
+	runtime->distance_size = 0;
+}
+
 /**
  * \brief Register a potential 4-star candidate combination passing initial distance checks.
  *
@@ -343,15 +391,15 @@ void target_create_single(struct adb_solve *solve, struct adb_pobject *pobject,
  * \param k Index of secondary star 3.
  * \param delta Measured variance error from target geometry.
  * \param rad_per_pix Effective angular scale derivation for this match.
+ * \param pa Primary to secondary PAs from the neighbour lists, or NULL.
  */
 void target_add_match_on_distance(struct solve_runtime *runtime,
 								  const struct adb_object *primary,
 								  struct adb_source_objects *source, int i,
 								  int j, int k, double delta,
-								  double rad_per_pix)
+								  double rad_per_pix, const double *pa)
 {
-	struct adb_solve *solve = runtime->solve;
-	struct adb_solve_solution *p;
+	struct solve_candidate *p;
 
 	if (runtime->num_pot_distance >= MAX_POTENTAL_MATCHES)
 		return;
@@ -362,12 +410,11 @@ void target_add_match_on_distance(struct solve_runtime *runtime,
 	p->object[1] = source->objects[i];
 	p->object[2] = source->objects[j];
 	p->object[3] = source->objects[k];
-	p->soln_pobject[0] = solve->plate.object[solve->plate.window_start];
-	p->soln_pobject[1] = solve->plate.object[solve->plate.window_start + 1];
-	p->soln_pobject[2] = solve->plate.object[solve->plate.window_start + 2];
-	p->soln_pobject[3] = solve->plate.object[solve->plate.window_start + 3];
 	p->delta.dist = delta;
 	p->rad_per_pix = rad_per_pix;
+	p->has_pa = pa != NULL;
+	if (pa != NULL)
+		memcpy(p->pa, pa, sizeof(p->pa));
 	runtime->num_pot_distance++;
 }
 
@@ -385,7 +432,7 @@ void target_add_single_match_on_distance(struct solve_runtime *runtime,
 										 struct adb_source_objects *source,
 										 double delta, int flip)
 {
-	struct adb_solve_solution *p;
+	struct solve_candidate *p;
 
 	if (runtime->num_pot_distance >= MAX_POTENTAL_MATCHES)
 		return;
@@ -411,7 +458,7 @@ void target_add_single_match_extended(struct solve_runtime *runtime,
 									  struct adb_source_objects *source,
 									  double delta, int flip)
 {
-	struct adb_solve_solution *p;
+	struct solve_candidate *p;
 
 	if (runtime->num_pot_distance >= MAX_POTENTAL_MATCHES)
 		return;
@@ -435,10 +482,54 @@ void target_add_single_match_extended(struct solve_runtime *runtime,
  * \param source Structural container taking ownership of the generated flat arrays.
  * \return Total valid contiguous objects pushed into the search array.
  */
+void target_free_haystacks(struct adb_object_set *set)
+{
+	struct solve_haystack *haystack;
+	struct solve_neighbours *neighbours;
+
+	while ((haystack = set->haystack) != NULL) {
+		set->haystack = haystack->next;
+
+		while ((neighbours = haystack->neighbours) != NULL) {
+			haystack->neighbours = neighbours->next;
+			free(neighbours->neighbour);
+			free(neighbours->start);
+			free(neighbours);
+		}
+
+		if (haystack->score)
+			solve_score_get_backend()->release(haystack->score);
+		free(haystack->source.objects);
+		free(haystack);
+	}
+}
+
+/**
+ * \brief Find the haystack prepared for the solver magnitude limits.
+ *
+ * \param solve Solver.
+ * \param set Object set.
+ * \return Prepared haystack or NULL.
+ */
+static struct solve_haystack *target_get_haystack(struct adb_solve *solve,
+												  struct adb_object_set *set)
+{
+	struct solve_haystack *haystack;
+
+	for (haystack = set->haystack; haystack; haystack = haystack->next) {
+		if (haystack->min_mag == solve->constraint.min_mag &&
+			haystack->max_mag == solve->constraint.max_mag)
+			return haystack;
+	}
+
+	return NULL;
+}
+
 int target_prepare_source_objects(struct adb_solve *solve,
 								  struct adb_object_set *set,
 								  struct adb_source_objects *source)
 {
+	struct solve_haystack *haystack;
 	int object_heads, i, j, count = 0, warn_once = 1;
 
 	/* get object heads */
@@ -448,48 +539,87 @@ int target_prepare_source_objects(struct adb_solve *solve,
 
 	debug_init(set);
 
-	/* allocate space for adb_source_objects */
-	source->objects = calloc(set->count, sizeof(struct adb_object *));
-	if (source->objects == NULL)
+	/* reuse the haystack if the set has not been clipped since */
+	haystack = target_get_haystack(solve, set);
+	if (haystack != NULL) {
+		solve->source = haystack;
+		*source = haystack->source;
+		adb_info(solve->db, ADB_LOG_SOLVE,
+				 "reusing %d solver source objects from %d heads\n",
+				 source->num_objects, object_heads);
+		return source->num_objects;
+	}
+
+	haystack = calloc(1, sizeof(*haystack));
+	if (haystack == NULL)
+		return -ENOMEM;
+
+	haystack->source.objects = calloc(set->count + 1,
+									  sizeof(struct adb_object *));
+	if (haystack->source.objects == NULL) {
+		free(haystack);
 		return -ENOMEM;
+	}
 
-	/* copy adb_source_objects ptrs from head set */
+	/* copy adb_source_objects ptrs inside mag limits from head set */
 	for (i = 0; i < object_heads; i++) {
-		const void *object = set->object_heads[i].objects;
-
-		/* copy individual objects */
-		for (j = 0; j < set->object_heads[i].count; j++) {
-			const struct adb_object *o = object;
-
-			/* ignore bogus objects - import errors ?*/
-			if (o->dec == 0.0 || o->ra == 0.0 || o->mag == 0.0) {
-				if (warn_once) {
-					warn_once = 0;
-					adb_error(
-						solve->db,
-						"object with zeroed attributes in db at head %d !\n");
-				}
-			} else {
-				/* valid object */
-				/* dont copy objects outside mag limits */
-				if (o->mag <= solve->constraint.min_mag &&
-					o->mag >= solve->constraint.max_mag) {
-					source->objects[count++] = object;
+		const char *objects = set->object_heads[i].objects;
+		int bytes = solve->table->object.bytes, index[SIMD_CHUNK], n, k;
+
+		for (j = 0; j < set->object_heads[i].count; j += SIMD_CHUNK) {
+			n = set->object_heads[i].count - j;
+			if (n > SIMD_CHUNK)
+				n = SIMD_CHUNK;
+
+			n = simd_select_mag(objects + (size_t)j * bytes, n, bytes,
+								solve->constraint.max_mag,
+								solve->constraint.min_mag, index);
+
+			for (k = 0; k < n; k++) {
+				const struct adb_object *o =
+					(const void *)(objects + (size_t)(j + index[k]) * bytes);
+
+				/* ignore bogus objects - import errors ?*/
+				if (o->dec == 0.0 || o->ra == 0.0 || o->mag == 0.0) {
+					if (warn_once) {
+						warn_once = 0;
+						adb_error(solve->db,
+								  "object with zeroed attributes in db at "
+								  "head %d !\n",
+								  i);
+					}
+					continue;
 				}
-			}
 
-			/* next object */
-			object += solve->table->object.bytes;
+				haystack->source.objects[count++] = o;
+			}
 		}
 	}
 
 	/* sort adb_source_objects on magnitude */
-	qsort(source->objects, count, sizeof(struct adb_object *), mag_object_cmp);
-	source->num_objects = count;
+	qsort(haystack->source.objects, count, sizeof(struct adb_object *),
+		  mag_object_cmp);
+	haystack->source.num_objects = count;
+
+	/* positions are handed to the scoring backend once per haystack */
+	haystack->score = solve_score_get_backend()->prepare(&haystack->source);
+	if (haystack->score == NULL) {
+		free(haystack->source.objects);
+		free(haystack);
+		return -ENOMEM;
+	}
+
+	/* keep it on the set for later solves */
+	haystack->min_mag = solve->constraint.min_mag;
+	haystack->max_mag = solve->constraint.max_mag;
+	haystack->next = set->haystack;
+	set->haystack = haystack;
+	solve->source = haystack;
+	*source = haystack->source;
 
 	adb_info(solve->db, ADB_LOG_SOLVE,
-			 "using %d solver source objects from %d heads\n", count,
-			 object_heads);
+			 "using %d solver source objects from %d heads, %s scoring\n",
+			 count, object_heads, solve_score_get_backend()->name);
 
 	return count;
 }
@@ -0,0 +1,166 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib.h"
+#include "stats.h"
+#include "libastrodb/db.h"
+
+/* database serials, 0 is never used so empty caches never match */
+static unsigned long stats_serial;
+
+void stats_init(struct db_stats *stats)
+{
+	stats->serial = __atomic_add_fetch(&stats_serial, 1, __ATOMIC_RELAXED);
+	pthread_mutex_init(&stats->lock, NULL);
+	stats->block = NULL;
+	memset(stats->base, 0, sizeof(stats->base));
+}
+
+void stats_free(struct db_stats *stats)
+{
+	struct stats_block *block, *next;
+
+	for (block = stats->block; block; block = next) {
+		next = block->next;
+		free(block);
+	}
+	stats->block = NULL;
+	pthread_mutex_destroy(&stats->lock);
+}
+
+#if HAVE_STATS
+
+__thread struct stats_cache stats_cache;
+
+struct stats_block *stats_get_block(struct db_stats *stats)
+{
+	struct stats_block *block;
+	pthread_t self = pthread_self();
+
+	pthread_mutex_lock(&stats->lock);
+
+	/* threads counting again keep their block */
+	for (block = stats->block; block; block = block->next) {
+		if (pthread_equal(block->thread, self))
+			break;
+	}
+
+	if (block == NULL) {
+		block = calloc(1, sizeof(*block));
+		if (block) {
+			block->thread = self;
+			block->next = stats->block;
+			stats->block = block;
+		}
+	}
+
+	pthread_mutex_unlock(&stats->lock);
+
+	if (block) {
+		stats_cache.serial = stats->serial;
+		stats_cache.block = block;
+	}
+	return block;
+}
+
+/**
+ * \brief Sum the thread blocks of a database.
+ *
+ * \param stats Database counters, locked.
+ * \param sum Output counter sums.
+ */
+static void stats_sum(struct db_stats *stats, uint64_t sum[STATS_NUM])
+{
+	struct stats_block *block;
+	int i;
+
+	memset(sum, 0, STATS_NUM * sizeof(*sum));
+	for (block = stats->block; block; block = block->next) {
+		for (i = 0; i < STATS_NUM; i++)
+			sum[i] += __atomic_load_n(&block->counter[i], __ATOMIC_RELAXED);
+	}
+}
+
+/* public statistics field of each counter */
+static const size_t stats_field[STATS_NUM] = {
+	[STATS_CLIPS] = offsetof(struct adb_db_stats, clips),
+	[STATS_TRIXELS] = offsetof(struct adb_db_stats, trixels),
+	[STATS_HEADS] = offsetof(struct adb_db_stats, heads),
+	[STATS_SEARCHES] = offsetof(struct adb_db_stats, searches),
+	[STATS_OBJECTS_TESTED] = offsetof(struct adb_db_stats, objects_tested),
+	[STATS_KD_SEARCHES] = offsetof(struct adb_db_stats, kd_searches),
+	[STATS_KD_NODES] = offsetof(struct adb_db_stats, kd_nodes),
+	[STATS_HASH_LOOKUPS] = offsetof(struct adb_db_stats, hash_lookups),
+	[STATS_HASH_PROBES] = offsetof(struct adb_db_stats, hash_probes),
+	[STATS_SOLVE_PRIMARIES] = offsetof(struct adb_db_stats, solve_primaries),
+	[STATS_SOLVE_MAG] = offsetof(struct adb_db_stats, solve_mag),
+	[STATS_SOLVE_DIST] = offsetof(struct adb_db_stats, solve_dist),
+	[STATS_SOLVE_PA] = offsetof(struct adb_db_stats, solve_pa),
+	[STATS_IMPORT_OBJECTS] = offsetof(struct adb_db_stats, import_objects),
+	[STATS_IMPORT_HISTOGRAM_NS] =
+		offsetof(struct adb_db_stats, import_histogram_ns),
+	[STATS_IMPORT_ROWS_NS] = offsetof(struct adb_db_stats, import_rows_ns),
+	[STATS_IMPORT_KD_NS] = offsetof(struct adb_db_stats, import_kd_ns),
+	[STATS_IMPORT_WRITE_NS] = offsetof(struct adb_db_stats, import_write_ns),
+};
+
+int adb_db_get_stats(struct adb_db *db, struct adb_db_stats *stats)
+{
+	uint64_t sum[STATS_NUM];
+	int i;
+
+	if (stats == NULL)
+		return -EINVAL;
+
+	pthread_mutex_lock(&db->stats.lock);
+	stats_sum(&db->stats, sum);
+	for (i = 0; i < STATS_NUM; i++)
+		sum[i] -= db->stats.base[i];
+	pthread_mutex_unlock(&db->stats.lock);
+
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < STATS_NUM; i++)
+		*(uint64_t *)((char *)stats + stats_field[i]) = sum[i];
+	return 0;
+}
+
+void adb_db_reset_stats(struct adb_db *db)
+{
+	/* blocks are only written by their threads, so rebase instead */
+	pthread_mutex_lock(&db->stats.lock);
+	stats_sum(&db->stats, db->stats.base);
+	pthread_mutex_unlock(&db->stats.lock);
+}
+
+#else
+
+int adb_db_get_stats(struct adb_db *db, struct adb_db_stats *stats)
+{
+	return -ENOTSUP;
+}
+
+void adb_db_reset_stats(struct adb_db *db)
+{
+}
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#ifndef __ADB_STATS_H
+#define __ADB_STATS_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+struct adb_db;
+
+/*! \defgroup stats Statistics
+ *
+ * \brief Query, solve and import counters.
+ *
+ * Each thread counts into its own block of counters for each database, so
+ * counting is a thread local load and store. The blocks are summed when the
+ * counters are read. Counting compiles out without HAVE_STATS.
+ */
+
+/*! \enum stats_counter
+ * \ingroup stats
+ *
+ * Counters kept in each thread block.
+ */
+enum stats_counter {
+	STATS_CLIPS = 0, /*!< object set clips */
+	STATS_TRIXELS, /*!< clipped trixels visited */
+	STATS_HEADS, /*!< object heads clipped */
+	STATS_SEARCHES, /*!< searches run */
+	STATS_OBJECTS_TESTED, /*!< objects tested by searches */
+	STATS_KD_SEARCHES, /*!< KD tree searches */
+	STATS_KD_NODES, /*!< KD tree nodes visited */
+	STATS_HASH_LOOKUPS, /*!< hash key lookups */
+	STATS_HASH_PROBES, /*!< hash slots probed */
+	STATS_SOLVE_PRIMARIES, /*!< solver primaries tried */
+	STATS_SOLVE_MAG, /*!< solver candidates on magnitude */
+	STATS_SOLVE_DIST, /*!< solver candidates on distance */
+	STATS_SOLVE_PA, /*!< solver candidates on position angle */
+	STATS_IMPORT_OBJECTS, /*!< objects imported */
+	STATS_IMPORT_HISTOGRAM_NS, /*!< import magnitude histogram time */
+	STATS_IMPORT_ROWS_NS, /*!< import row parse and insert time */
+	STATS_IMPORT_KD_NS, /*!< import KD tree build time */
+	STATS_IMPORT_WRITE_NS, /*!< import schema and table write time */
+	STATS_NUM,
+};
+
+/*! \struct stats_block
+ * \ingroup stats
+ *
+ * Counters of one thread for one database.
+ */
+struct stats_block {
+	uint64_t counter[STATS_NUM];
+	pthread_t thread; /*!< counting thread */
+	struct stats_block *next;
+};
+
+/*! \struct db_stats
+ * \ingroup stats
+ *
+ * Thread counter blocks of a database.
+ */
+struct db_stats {
+	unsigned long serial; /*!< unique database number for thread caches */
+	pthread_mutex_t lock; /*!< guards the block list and the base */
+	struct stats_block *block; /*!< thread blocks */
+	uint64_t base[STATS_NUM]; /*!< sums at the last reset */
+};
+
+/**
+ * \brief Initialise the counters of a database.
+ * \ingroup stats
+ * \param stats Database counters.
+ */
+void stats_init(struct db_stats *stats);
+
+/**
+ * \brief Free the counters of a database.
+ * \ingroup stats
+ * \param stats Database counters.
+ */
+void stats_free(struct db_stats *stats);
+
+#if HAVE_STATS
+
+/*! \struct stats_cache
+ * \ingroup stats
+ *
+ * Thread block of the database this thread last counted for.
+ */
+struct stats_cache {
+	unsigned long serial; /*!< database serial, 0 for none */
+	struct stats_block *block;
+};
+
+extern __thread struct stats_cache stats_cache;
+
+/**
+ * \brief Get the block of the calling thread, creating it on first use.
+ * \ingroup stats
+ * \param stats Database counters.
+ * \return Thread block or NULL if it could not be allocated.
+ */
+struct stats_block *stats_get_block(struct db_stats *stats);
+
+/**
+ * \brief Add to a counter of the calling thread.
+ * \ingroup stats
+ * \param stats Database counters.
+ * \param counter Counter to add to.
+ * \param value Value to add.
+ */
+static inline void stats_add(struct db_stats *stats,
+							 enum stats_counter counter, uint64_t value)
+{
+	struct stats_block *block = stats_cache.block;
+	uint64_t *c;
+
+	if (stats_cache.serial != stats->serial) {
+		block = stats_get_block(stats);
+		if (block == NULL)
+			return;
+	}
+
+	/* only this thread writes the block, readers may run concurrently */
+	c = &block->counter[counter];
+	__atomic_store_n(c, __atomic_load_n(c, __ATOMIC_RELAXED) + value,
+					 __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Get a monotonic time stamp for timed counters.
+ * \ingroup stats
+ * \return Time in nanoseconds.
+ */
+static inline uint64_t stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#else
+
+static inline void stats_add(struct db_stats *stats,
+							 enum stats_counter counter, uint64_t value)
+{
+}
+
+static inline uint64_t stats_now(void)
+{
+	return 0;
+}
+
+#endif
+
+/**
+ * \brief Add the time since a stamp to a timed counter.
+ * \ingroup stats
+ * \param stats Database counters.
+ * \param counter Timed counter.
+ * \param start Stamp from stats_now().
+ */
+static inline void stats_add_time(struct db_stats *stats,
+								  enum stats_counter counter, uint64_t start)
+{
+	stats_add(stats, counter, stats_now() - start);
+}
+
+#endif
+#endif
@@ -28,9 +28,11 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "alloc.h"
 #include "debug.h"
 #include "private.h"
 #include "readme.h"
+#include "remote.h"
 #include "table.h"
 #include "lib.h"
 #include "libastrodb/db.h"
@@ -149,6 +151,17 @@ void table_put_id(struct adb_db *db, int id)
 	db->table_in_use[id] = 0;
 }
 
+/**
+ * \brief Set the object load mode for subsequently opened tables.
+ *
+ * \param db Database catalog
+ * \param load Table load mode
+ */
+void adb_set_table_load(struct adb_db *db, enum adb_table_load load)
+{
+	db->table_load = load;
+}
+
 /**
  * \brief Open and initialize a dataset table.
  *
@@ -169,6 +182,10 @@ int adb_table_open(struct adb_db *db, const char *cat_class, const char *cat_id,
 	int table_id, ret = -EINVAL;
 	char local[ADB_PATH_SIZE];
 
+	ret = db_check_thawed(db);
+	if (ret < 0)
+		return ret;
+
 	table_id = table_get_id(db);
 	if (table_id < 0)
 		return table_id;
@@ -189,6 +206,20 @@ int adb_table_open(struct adb_db *db, const char *cat_class, const char *cat_id,
 	table->cds.index = strdup(cat_id);
 	if (table->cds.index == NULL)
 		goto err;
+
+	/* remote tables are opened by the query daemon */
+	if (db->remote) {
+		ret = remote_table_open(db, table, table_name);
+		if (ret < 0)
+			goto err;
+		table->path.file = strdup(table_name);
+		if (table->path.file == NULL) {
+			ret = -ENOMEM;
+			goto err;
+		}
+		return table_id;
+	}
+
 	sprintf(local, "%s%s%s%s%s%s", db->lib->local, "/", cat_class, "/", cat_id,
 			"/");
 
@@ -214,6 +245,7 @@ err:
 	free(table->cds.cat_class);
 	free(table->cds.index);
 	free(table->path.local);
+	free(table->path.file);
 	table_put_id(db, table_id);
 	return ret;
 }
@@ -239,8 +271,10 @@ static void clear_trixel_data(struct htm_trixel *t, int table_id)
 {
 	if (!t)
 		return;
-	t->data[table_id].objects = NULL;
-	t->data[table_id].num_objects = 0;
+	if (t->data) {
+		t->data[table_id].objects = NULL;
+		t->data[table_id].num_objects = 0;
+	}
 	if (t->child) {
 		clear_trixel_data(&t->child[0], table_id);
 		clear_trixel_data(&t->child[1], table_id);
@@ -249,30 +283,50 @@ static void clear_trixel_data(struct htm_trixel *t, int table_id)
 	}
 }
 
+void table_clear_trixels(struct adb_db *db, int table_id)
+{
+	int i;
+
+	if (!db->htm)
+		return;
+
+	for (i = 0; i < 4; i++) {
+		clear_trixel_data(&db->htm->N[i], table_id);
+		clear_trixel_data(&db->htm->S[i], table_id);
+	}
+}
+
 int adb_table_close(struct adb_db *db, int table_id)
 {
 	struct adb_table *table;
-	int i;
 
 	if (table_id < 0 || table_id >= ADB_MAX_TABLES)
 		return -EINVAL;
+	if (db_check_thawed(db) < 0)
+		return -EBUSY;
 	table = &db->table[table_id];
 
 	adb_info(db, ADB_LOG_CDS_TABLE, "Closing table %d %s\n", table_id,
 			 table->path.file ? table->path.file : "(null)");
 
+	if (db->remote) {
+		remote_table_close(table);
+		goto out;
+	}
+
 	/* Clear stale object pointers from all HTM trixels for this table.
 	 * Without this, a later import reusing the same table_id would
 	 * traverse freed memory in htm_import_object_ascending(). */
-	if (db->htm) {
-		for (i = 0; i < 4; i++) {
-			clear_trixel_data(&db->htm->N[i], table_id);
-			clear_trixel_data(&db->htm->S[i], table_id);
-		}
-	}
+	table_clear_trixels(db, table_id);
 
 	hash_free_maps(table);
-	free(table->objects);
+	range_free_indexes(table);
+	epoch_free_views(table);
+	quad_free_index(table);
+	table_free_trixels(table);
+	cds_fetch_finish(table);
+
+out:
 	free(table->cds.cat_class);
 	free(table->cds.index);
 	free(table->path.local);
@@ -548,8 +602,12 @@ int adb_table_hash_key(struct adb_db *db, int table_id, const char *key)
 
 	if (table_id < 0 || table_id >= ADB_MAX_TABLES)
 		return -EINVAL;
+	if (db_check_thawed(db) < 0)
+		return -EBUSY;
 
 	table = &db->table[table_id];
+	if (db->remote)
+		return remote_table_hash_key(db, table, key);
 
 	if (table->hash.num == ADB_MAX_HASH_MAPS) {
 		adb_error(db, "too many hashed keys %s\n", key);
@@ -568,16 +626,93 @@ int adb_table_hash_key(struct adb_db *db, int table_id, const char *key)
 			 table->hash.map[table->hash.num].type);
 	table->hash.map[table->hash.num].key = key;
 
-	hash_build_table(table, table->hash.num);
+	ret = hash_build_table(table, table->hash.num);
+	if (ret < 0)
+		return ret;
 	table->hash.num++;
 
 	return ret;
 }
 
+/**
+ * \brief Register a field as a range key for fast range searches.
+ *
+ * Builds a sorted index of the field over all table objects. Searches with
+ * less than or greater than comparators on a numeric field, or equal and
+ * wildcard "prefix*" comparators on a string field, then scan the index
+ * range instead of testing every object.
+ *
+ * \param db Database catalog
+ * \param table_id Table ID
+ * \param key Name or symbol of the field to be indexed
+ * \return 0 on success, or a negative error code on failure
+ */
+int adb_table_range_key(struct adb_db *db, int table_id, const char *key)
+{
+	struct adb_table *table;
+	struct range_index *range;
+	int ret;
+
+	if (table_id < 0 || table_id >= ADB_MAX_TABLES)
+		return -EINVAL;
+	if (db_check_thawed(db) < 0)
+		return -EBUSY;
+	if (db_check_local(db) < 0)
+		return -EOPNOTSUPP;
+
+	table = &db->table[table_id];
+
+	if (table->range.num == ADB_MAX_RANGE_INDEXES) {
+		adb_error(db, "too many range keys %s\n", key);
+		return -EINVAL;
+	}
+
+	range = &table->range.index[table->range.num];
+	range->offset = adb_table_get_field_offset(db, table_id, key);
+	if (range->offset < 0) {
+		adb_error(db, "invalid field offset %s\n", key);
+		return -EINVAL;
+	}
+
+	if (range_get_index(table, range->offset)) {
+		adb_error(db, "field %s already has a range key\n", key);
+		return -EINVAL;
+	}
+
+	/* types read the same way by the search tests */
+	range->type = adb_table_get_field_type(db, table_id, key);
+	switch (range->type) {
+	case ADB_CTYPE_INT:
+	case ADB_CTYPE_FLOAT:
+	case ADB_CTYPE_DOUBLE:
+	case ADB_CTYPE_DEGREES:
+	case ADB_CTYPE_STRING:
+		break;
+	default:
+		adb_error(db, "field %s type not supported for range\n", key);
+		return -EINVAL;
+	}
+
+	range->size = adb_table_get_field_size(db, table_id, key);
+	range->key = key;
+	ret = range_build_table(table, table->range.num);
+	if (ret < 0)
+		return ret;
+
+	adb_info(db, ADB_LOG_CDS_TABLE,
+			 "added range for key %s on table %d with %d objects at "
+			 "offset %d type %d\n",
+			 key, table_id, range->count, range->offset, range->type);
+
+	table->range.num++;
+	return 0;
+}
+
 /**
  * \brief Set a fast O(1) string search hash key onto an object set.
  *
  * Initializes the objects in an active subset to be queryable by a string matching key, establishing the hash map if it has not yet been loaded.
+ * Keys already hashed on the table share the table map instead.
  *
  * \param set The pre-filtered active object set to apply the index to.
  * \param key The name of the field to index strings dynamically for O(1) searches.
@@ -585,7 +720,11 @@ int adb_table_hash_key(struct adb_db *db, int table_id, const char *key)
  */
 int adb_set_hash_key(struct adb_object_set *set, const char *key)
 {
-	int ret;
+	int i, ret;
+
+	ret = db_check_local(set->db);
+	if (ret < 0)
+		return ret;
 
 	if (set->hash.num == ADB_MAX_HASH_MAPS) {
 		adb_error(set->db, "too many hashed keys %s\n", key);
@@ -604,6 +743,14 @@ int adb_set_hash_key(struct adb_object_set *set, const char *key)
 			 set->hash.map[set->hash.num].type);
 	set->hash.map[set->hash.num].key = key;
 
+	/* lookups filter the table map by the set objects */
+	for (i = 0; i < set->table->hash.num; i++) {
+		if (!strcmp(key, set->table->hash.map[i].key)) {
+			set->hash.num++;
+			return 0;
+		}
+	}
+
 	hash_build_set(set, set->hash.num);
 	set->hash.num++;
 
@@ -635,6 +782,79 @@ int table_get_hashmap(struct adb_db *db, int table_id, const char *key)
 	return -EINVAL;
 }
 
+/**
+ * \brief Get the hot object field arrays of a table.
+ *
+ * Copies RA, DEC, magnitude and the unit vector of every object into arrays
+ * in table object order, so table object N is column entry N. Scans of
+ * these fields then read a few bytes per object instead of whole objects.
+ * Lazy tables return NULL so scans keep to the loaded objects.
+ *
+ * \param table Table with loaded objects.
+ * \return Field arrays or NULL on failure.
+ */
+const struct table_columns *table_get_columns(struct adb_table *table)
+{
+	const struct adb_object *object;
+	struct table_columns *columns;
+	int count = table->object.count, i;
+	double cos_dec;
+	size_t size;
+
+	if (table->columns)
+		return table->columns;
+
+	if (count <= 0 || table->objects == NULL || table->lazy)
+		return NULL;
+
+	/* one block, the double arrays first to keep them aligned */
+	size = sizeof(*columns) +
+		   (size_t)count * (5 * sizeof(double) + sizeof(float));
+	columns = alloc_large(table->db, size, &table->columns_mapped);
+	if (columns == NULL)
+		return NULL;
+
+	columns->ra = (double *)(columns + 1);
+	columns->dec = columns->ra + count;
+	columns->x = columns->dec + count;
+	columns->y = columns->x + count;
+	columns->z = columns->y + count;
+	columns->mag = (float *)(columns->z + count);
+	columns->count = count;
+
+	for (i = 0; i < count; i++) {
+		object = (const void *)table->objects + (size_t)i * table->object.bytes;
+
+		columns->ra[i] = object->ra;
+		columns->dec[i] = object->dec;
+		columns->mag[i] = object->mag;
+
+		cos_dec = cos(object->dec);
+		columns->x[i] = cos_dec * sin(object->ra);
+		columns->y[i] = sin(object->dec);
+		columns->z[i] = cos_dec * cos(object->ra);
+	}
+
+	adb_info(table->db, ADB_LOG_CDS_TABLE,
+			 "Built field arrays for %d objects of %s\n", count,
+			 table->cds.name);
+
+	table->columns = columns;
+	return columns;
+}
+
+/**
+ * \brief Free the hot object field arrays of a table.
+ *
+ * \param table Table with field arrays.
+ */
+void table_free_columns(struct adb_table *table)
+{
+	alloc_free_large(table->columns, table->columns_mapped);
+	table->columns = NULL;
+	table->columns_mapped = 0;
+}
+
 #if 0
 /**
  * \brief Register a custom object type schema.
@@ -28,7 +28,9 @@
 #include "hash.h"
 #include "htm.h"
 #include "import.h"
+#include "epoch.h"
 #include "private.h"
+#include "range.h"
 #include "schema.h"
 
 /*! \defgroup table Table
@@ -46,6 +48,10 @@
 
 struct adb_db;
 struct adb_table;
+struct table_lazy;
+struct kd_node;
+struct solve_quad;
+struct solve_haystack;
 
 /*! \struct depth_map
  * \ingroup table
@@ -55,6 +61,17 @@ struct depth_map {
 	float max_value; /*!< maximum object primary key value at this depth */
 };
 
+/*! \struct table_columns
+ * \brief Hot object fields stored as arrays in table object order.
+ */
+struct table_columns {
+	double *ra; /*!< object RA */
+	double *dec; /*!< object DEC */
+	float *mag; /*!< object magnitude */
+	double *x, *y, *z; /*!< object unit vectors */
+	int count; /*!< objects in each array */
+};
+
 /*! \struct adb_object_set
  * \ingroup table
  */
@@ -74,12 +91,35 @@ struct adb_object_set {
 	int table_id;
 
 	int valid_trixels;
+	int stale_trixels; /*!< trixel entries to clear before gathering */
+	int trixel_size; /*!< allocated trixel entries */
 
 	int count;
 	int head_count;
+	int head_size; /*!< allocated object heads */
+
+	/* polygon clipping */
+	double (*edge)[3]; /*!< inner edge normals, NULL for cone clips */
+	int edges; /*!< number of polygon edges */
 
 	/* hashed object searching */
 	struct table_hash hash;
+
+	/* solver haystacks prepared from the clipped objects */
+	struct solve_haystack *haystack;
+
+	/* trixel aggregates of the clip */
+	struct adb_trixel_aggregate *aggregates;
+	int aggregate_count;
+	int aggregate_size; /*!< allocated aggregates */
+
+	/* heads added then removed by the last re-clip */
+	struct adb_object_head *delta;
+	int delta_count;
+	int delta_size; /*!< allocated delta heads */
+
+	/* query daemon constraints and objects for remote databases */
+	struct remote_set *remote;
 };
 
 /*! \struct struct adb_table
@@ -93,6 +133,13 @@ struct adb_table {
 
 	/* KD Tree Root */
 	int kd_root;
+	struct kd_node *kd_nodes; /*!< packed KD search nodes, built on use */
+	size_t kd_mapped; /*!< mapped KD node bytes, 0 for heap nodes */
+	int kd_depth; /*!< levels in the packed KD search nodes */
+
+	/* hot object field arrays */
+	struct table_columns *columns; /*!< built on use, NULL until then */
+	size_t columns_mapped; /*!< mapped field array bytes, 0 for heap */
 
 	/* CDS identifiers */
 	struct table_cds cds;
@@ -111,6 +158,15 @@ struct adb_table {
 	/* hashed object searching */
 	struct table_hash hash;
 
+	/* sorted field range searching */
+	struct table_range range;
+
+	/* proper motion propagated positions */
+	struct table_epoch epoch;
+
+	/* plate solver quad index */
+	struct solve_quad *quad; /*!< built or read on use, NULL until then */
+
 	/* table import info */
 	struct cds_importer import;
 
@@ -121,6 +177,23 @@ struct adb_table {
 
 	/* all objects in array */
 	struct adb_object *objects;
+	enum adb_table_layout layout; /*!< object order of the table file */
+	size_t objects_mapped; /*!< mapped object bytes, 0 for heap objects */
+
+	/* read only table file mapping for ADB_TABLE_LOAD_MMAP */
+	void *map;
+	size_t map_size;
+
+	/* trixel directory state for ADB_TABLE_LOAD_LAZY */
+	struct table_lazy *lazy;
+
+	/* trixel aggregates sorted by trixel ID, NULL if not stored */
+	struct adb_trixel_aggregate *aggregates;
+	unsigned int aggregate_count;
+
+	/* query daemon table ID and last fetched object for remote databases */
+	int remote_id;
+	void *remote_object;
 };
 
 /**
@@ -148,6 +221,82 @@ int table_get_column_csize(char *type);
  */
 int table_read_trixels(struct adb_db *db, struct adb_table *table);
 
+/**
+ * \brief Release table objects read by table_read_trixels().
+ * \ingroup table
+ * \param table pointer to the table
+ */
+void table_free_trixels(struct adb_table *table);
+
+/**
+ * \brief Clear the HTM trixel object lists of a table.
+ * \ingroup table
+ * \param db pointer to the database
+ * \param table_id table whose trixel lists are cleared
+ */
+void table_clear_trixels(struct adb_db *db, int table_id);
+
+/**
+ * \brief Make sure the objects of a trixel are loaded for lazy tables.
+ * \ingroup table
+ * \param table pointer to the table
+ * \param trixel pointer to a trixel with objects for table
+ * \return 0 on success, negative error code on failure
+ */
+int table_load_trixel(struct adb_table *table, struct htm_trixel *trixel);
+
+/**
+ * \brief Make sure all objects are loaded for lazy tables.
+ * \ingroup table
+ * \param table pointer to the table
+ * \return 0 on success, negative error code on failure
+ */
+int table_load_all(struct adb_table *table);
+
+/**
+ * \brief Get the hot object field arrays of a table, building them on use.
+ * \ingroup table
+ * \param table pointer to the table
+ * \return the field arrays, or NULL for lazy or empty tables
+ */
+const struct table_columns *table_get_columns(struct adb_table *table);
+
+/**
+ * \brief Free the hot object field arrays of a table.
+ * \ingroup table
+ * \param table pointer to the table
+ */
+void table_free_columns(struct adb_table *table);
+
+/**
+ * \brief Build the packed KD search nodes of a table ahead of searches.
+ * \ingroup table
+ * \param table pointer to the table with loaded objects
+ * \return 0 on success or if the table has no KD tree, -ENOMEM on failure
+ */
+int kd_prepare_nodes(struct adb_table *table);
+
+/**
+ * \brief Free the packed KD search nodes of a table.
+ * \ingroup table
+ * \param table pointer to the table
+ */
+void kd_free_nodes(struct adb_table *table);
+
+/**
+ * \brief Free the plate solver quad index of a table.
+ * \ingroup table
+ * \param table pointer to the table
+ */
+void quad_free_index(struct adb_table *table);
+
+/**
+ * \brief Free the solver haystacks prepared from an object set.
+ * \ingroup table
+ * \param set pointer to the object set
+ */
+void target_free_haystacks(struct adb_object_set *set);
+
 /**
  * \brief Insert an object into a table.
  * \ingroup table
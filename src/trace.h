@@ -0,0 +1,102 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  Copyright (C) 2008 - 2014 Liam Girdwood
+ */
+
+#ifndef __ADB_TRACE_H
+#define __ADB_TRACE_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include "libastrodb/db.h"
+
+/*! \defgroup trace Tracing
+ *
+ * \brief Begin and end events around hot paths.
+ *
+ * Events go to the callback registered with adb_set_trace(). Without a
+ * callback each event is one load and an untaken branch, and the events
+ * compile out without HAVE_TRACE.
+ */
+
+/*! \struct db_trace
+ * \ingroup trace
+ *
+ * Trace callback of a database.
+ */
+struct db_trace {
+	adb_trace_callback callback; /*!< event callback or NULL */
+	void *data; /*!< callback private data */
+};
+
+#if HAVE_TRACE
+
+/**
+ * \brief Send a trace event to the database callback.
+ * \ingroup trace
+ * \param trace Database trace callback.
+ * \param point Traced path.
+ * \param event Begin or end of the path.
+ * \param value Event value, the result for end events.
+ */
+static inline void trace_event(const struct db_trace *trace,
+							   enum adb_trace_point point,
+							   enum adb_trace_event event, long value)
+{
+	if (__builtin_expect(trace->callback != NULL, 0))
+		trace->callback(trace->data, point, event, value);
+}
+
+#else
+
+static inline void trace_event(const struct db_trace *trace,
+							   enum adb_trace_point point,
+							   enum adb_trace_event event, long value)
+{
+}
+
+#endif
+
+/**
+ * \brief Send a begin event.
+ * \ingroup trace
+ * \param trace Database trace callback.
+ * \param point Traced path.
+ * \param value Event value.
+ */
+static inline void trace_begin(const struct db_trace *trace,
+							   enum adb_trace_point point, long value)
+{
+	trace_event(trace, point, ADB_TRACE_BEGIN, value);
+}
+
+/**
+ * \brief Send an end event and pass the result through.
+ * \ingroup trace
+ * \param trace Database trace callback.
+ * \param point Traced path.
+ * \param result Path result.
+ * \return The path result.
+ */
+static inline int trace_end(const struct db_trace *trace,
+							enum adb_trace_point point, int result)
+{
+	trace_event(trace, point, ADB_TRACE_END, result);
+	return result;
+}
+
+#endif
+#endif
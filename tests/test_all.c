@@ -62,6 +62,22 @@ int main(void) {
 
 #ifndef TEST_SOLVE_PATH
 #define TEST_SOLVE_PATH "./test_solve"
+#endif
+
+#ifndef TEST_FILE_PATH
+#define TEST_FILE_PATH "./test_file"
+#endif
+
+#ifndef TEST_THREADS_PATH
+#define TEST_THREADS_PATH "./test_threads"
+#endif
+
+#ifndef TEST_SYNTH_PATH
+#define TEST_SYNTH_PATH "./test_synth"
+#endif
+
+#ifndef TEST_REMOTE_PATH
+#define TEST_REMOTE_PATH "./test_remote"
 #endif
 
   total++;
@@ -91,6 +107,18 @@ int main(void) {
   total++;
   passed += run_test("Solve Unit Test", TEST_SOLVE_PATH);
 
+  total++;
+  passed += run_test("Table File Unit Test", TEST_FILE_PATH);
+
+  total++;
+  passed += run_test("Thread Unit Test", TEST_THREADS_PATH);
+
+  total++;
+  passed += run_test("Synthetic Catalog Unit Test", TEST_SYNTH_PATH);
+
+  total++;
+  passed += run_test("Query Daemon Unit Test", TEST_REMOTE_PATH);
+
   printf("====================================================================="
          "=\n");
   printf("Test Summary: %d/%d tests passed.\n", passed, total);
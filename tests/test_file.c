@@ -0,0 +1,1046 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <libastrodb/db-import.h>
+#include <libastrodb/db.h>
+#include <libastrodb/object.h>
+#include "../src/table.h"
+#include "../src/lib.h"
+
+#define IMPORT_DIR "import"
+#define STREAM_DIR "stream"
+#define MIRROR_DIR "mirror"
+#define FETCH_DIR "fetch"
+#define UPDATE_DIR "update"
+
+struct ngc_object {
+	struct adb_object object;
+	unsigned char type[4];
+	char desc[51];
+};
+
+static struct adb_schema_field ngc_fields[] = {
+	adb_member("Name", "Name", struct ngc_object, object.designation,
+			   ADB_CTYPE_STRING, "", 0, NULL),
+	adb_member("Type", "Type", struct ngc_object, type, ADB_CTYPE_STRING, "",
+			   0, NULL),
+	adb_gmember("RA Hours", "RAh", struct ngc_object, object.ra,
+				ADB_CTYPE_DOUBLE_HMS_HRS, "hours", 1, NULL),
+	adb_gmember("RA Minutes", "RAm", struct ngc_object, object.ra,
+				ADB_CTYPE_DOUBLE_HMS_MINS, "minutes", 0, NULL),
+	adb_gmember("DEC Degrees", "DEd", struct ngc_object, object.dec,
+				ADB_CTYPE_DOUBLE_DMS_DEGS, "degrees", 2, NULL),
+	adb_gmember("DEC Minutes", "DEm", struct ngc_object, object.dec,
+				ADB_CTYPE_DOUBLE_DMS_MINS, "minutes", 1, NULL),
+	adb_gmember("DEC sign", "DE-", struct ngc_object, object.dec,
+				ADB_CTYPE_SIGN, "", 0, NULL),
+	adb_member("Integrated Mag", "mag", struct ngc_object, object.mag,
+			   ADB_CTYPE_FLOAT, "", 0, NULL),
+	adb_member("Description", "Desc", struct ngc_object, desc,
+			   ADB_CTYPE_STRING, "", 0, NULL),
+	adb_member("Largest Dimension", "size", struct ngc_object, object.size,
+			   ADB_CTYPE_FLOAT, "arcmin", 0, NULL),
+};
+
+/* import_table() flags */
+#define IMPORT_STREAM (1 << 0)
+#define IMPORT_SINGLE_PASS (1 << 1)
+#define IMPORT_AGGREGATES (1 << 2)
+#define IMPORT_DEPTH_LAYOUT (1 << 3)
+
+static void import_table(struct adb_library *lib, int flags,
+						 enum adb_kd_build build, enum adb_mesh mesh,
+						 enum adb_table_encoding encoding)
+{
+	struct adb_db_stats stats;
+	struct adb_db *db;
+	int table_id, ret;
+
+	db = adb_create_db_mesh(lib, 5, 1, mesh);
+	assert(db != NULL);
+	adb_set_import_stream(db, flags & IMPORT_STREAM);
+	adb_set_import_single_pass(db, flags & IMPORT_SINGLE_PASS);
+	adb_set_table_aggregates(db, flags & IMPORT_AGGREGATES);
+	adb_set_table_layout(db, flags & IMPORT_DEPTH_LAYOUT ?
+								 ADB_TABLE_LAYOUT_DEPTH :
+								 ADB_TABLE_LAYOUT_TRIXEL);
+	adb_set_kd_build(db, build);
+	adb_set_table_encoding(db, encoding);
+
+	table_id = adb_table_import_new(db, "VII", "118", "ngc2000", "mag", 0.0,
+									18.0, ADB_IMPORT_INC);
+	assert(table_id >= 0);
+
+	ret = adb_table_import_schema(db, table_id, ngc_fields,
+								  adb_size(ngc_fields),
+								  sizeof(struct ngc_object));
+	assert(ret >= 0);
+
+	ret = adb_table_import(db, table_id);
+	assert(ret >= 0);
+
+	/* every import stage is timed */
+	if (adb_db_get_stats(db, &stats) == 0) {
+		assert(stats.import_objects == (uint64_t)ret);
+		assert(stats.import_histogram_ns > 0 && stats.import_rows_ns > 0);
+		assert(stats.import_kd_ns > 0 && stats.import_write_ns > 0);
+	}
+	(void)ret;
+
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+}
+
+static void test_file_import(struct adb_library *lib)
+{
+	printf("   Testing ngc2000 import...\n");
+	import_table(lib, 0, ADB_KD_BUILD_SORTED, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_RAW);
+	printf("    -> PASS\n");
+}
+
+static struct adb_db *open_table(struct adb_library *lib,
+								 enum adb_table_load load, int *table_id)
+{
+	struct adb_object_set *set;
+	struct adb_db *db;
+	int heads, count;
+
+	db = adb_create_db(lib, 5, 1);
+	assert(db != NULL);
+
+	adb_set_table_load(db, load);
+
+	*table_id = adb_table_open(db, "VII", "118", "ngc2000");
+	assert(*table_id >= 0);
+
+	set = adb_table_set_new(db, *table_id);
+	assert(set != NULL);
+
+	adb_table_set_constraints(set, 0.0, 0.0, 2.0 * M_PI, 0.0, 16.0);
+	heads = adb_set_get_objects(set);
+	count = adb_set_get_count(set);
+	assert(heads == 2706);
+	assert(count == 7765);
+	(void)heads;
+	(void)count;
+
+	adb_table_set_free(set);
+	return db;
+}
+
+static void test_file_load_modes(struct adb_library *lib)
+{
+	struct adb_db *copy_db, *mmap_db;
+	struct adb_table *copy, *map;
+	struct adb_object_set *set;
+	const struct adb_object *nearest;
+	int copy_id, mmap_id;
+
+	printf("   Testing copy and mmap table loads...\n");
+
+	copy_db = open_table(lib, ADB_TABLE_LOAD_COPY, &copy_id);
+	mmap_db = open_table(lib, ADB_TABLE_LOAD_MMAP, &mmap_id);
+
+	copy = &copy_db->table[copy_id];
+	map = &mmap_db->table[mmap_id];
+	assert(copy->map == NULL);
+	assert(map->map != NULL);
+	assert(copy->object.count == map->object.count);
+	assert(!memcmp(copy->objects, map->objects,
+				   copy->object.count * copy->object.bytes));
+
+	/* KD tree searches index straight into the mapping */
+	set = adb_table_set_new(mmap_db, mmap_id);
+	assert(set != NULL);
+	adb_table_set_constraints(set, 0.0, 0.0, 2.0 * M_PI, 0.0, 16.0);
+	nearest = adb_table_set_get_nearest_on_pos(set, 0.0, M_PI_2);
+	assert(nearest != NULL);
+	(void)nearest;
+	adb_table_set_free(set);
+
+	adb_table_close(copy_db, copy_id);
+	adb_db_free(copy_db);
+	adb_table_close(mmap_db, mmap_id);
+	assert(map->map == NULL);
+	adb_db_free(mmap_db);
+	(void)copy;
+	(void)map;
+
+	printf("    -> PASS\n");
+}
+
+static int region_objects(struct adb_db *db, int table_id,
+						  const struct adb_object *objects[], int size)
+{
+	struct adb_object_set *set;
+	struct adb_object_head *head;
+	const void *object;
+	int heads, i, j, count = 0;
+
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	/* 10 degree radius around RA 11h, DEC 10 deg */
+	adb_table_set_constraints(set, 2.87, 0.17, 0.17, 0.0, 16.0);
+	heads = adb_set_get_objects(set);
+	assert(heads > 0);
+	head = adb_set_get_head(set);
+
+	for (i = 0; i < heads; i++) {
+		object = head[i].objects;
+		for (j = 0; j < head[i].count; j++) {
+			assert(count < size);
+			objects[count++] = object;
+			object += adb_table_get_object_size(db, table_id);
+		}
+	}
+
+	adb_table_set_free(set);
+	return count;
+}
+
+static void test_file_lazy(struct adb_library *lib)
+{
+	static const struct adb_object *copy_objects[7765], *lazy_objects[7765];
+	struct adb_db *copy_db, *lazy_db;
+	struct adb_object_set *set;
+	int copy_id, lazy_id, copy_count, lazy_count, bytes, i, unread;
+	const struct adb_object *object;
+	const void *pos;
+
+	printf("   Testing lazy table loads...\n");
+
+	copy_db = adb_create_db(lib, 5, 1);
+	assert(copy_db != NULL);
+	copy_id = adb_table_open(copy_db, "VII", "118", "ngc2000");
+	assert(copy_id >= 0);
+
+	lazy_db = adb_create_db(lib, 5, 1);
+	assert(lazy_db != NULL);
+	adb_set_table_load(lazy_db, ADB_TABLE_LOAD_LAZY);
+	lazy_id = adb_table_open(lazy_db, "VII", "118", "ngc2000");
+	assert(lazy_id >= 0);
+	assert(lazy_db->table[lazy_id].lazy != NULL);
+
+	/* a clip only reads the trixels it touches */
+	copy_count = region_objects(copy_db, copy_id, copy_objects, 7765);
+	lazy_count = region_objects(lazy_db, lazy_id, lazy_objects, 7765);
+	assert(copy_count == lazy_count);
+	assert(lazy_db->table[lazy_id].lazy != NULL);
+
+	bytes = adb_table_get_object_size(copy_db, copy_id);
+	for (i = 0; i < copy_count; i++)
+		assert(!memcmp(copy_objects[i], lazy_objects[i], bytes));
+
+	/* objects outside the clip have not been read */
+	pos = lazy_db->table[lazy_id].objects;
+	for (i = 0, unread = 0; i < lazy_db->table[lazy_id].object.count; i++) {
+		object = pos;
+		if (adb_object_ra(object) == 0.0 && adb_object_dec(object) == 0.0)
+			unread++;
+		pos += bytes;
+	}
+	assert(unread > 0 && unread <= 7765 - lazy_count);
+	(void)unread;
+	(void)lazy_count;
+
+	/* table wide KD search loads everything */
+	set = adb_table_set_new(lazy_db, lazy_id);
+	assert(set != NULL);
+	object = adb_table_set_get_nearest_on_pos(set, 0.0, M_PI_2);
+	assert(object != NULL);
+	assert(lazy_db->table[lazy_id].lazy == NULL);
+	assert(!memcmp(copy_db->table[copy_id].objects,
+				   lazy_db->table[lazy_id].objects,
+				   copy_db->table[copy_id].object.count * bytes));
+	adb_table_set_free(set);
+
+	adb_table_close(copy_db, copy_id);
+	adb_db_free(copy_db);
+	adb_table_close(lazy_db, lazy_id);
+	adb_db_free(lazy_db);
+
+	printf("    -> PASS\n");
+}
+
+/* imported table must match the reference table object for object */
+static void check_reference(struct adb_library *lib)
+{
+	struct adb_library *fixture_lib;
+	struct adb_db *db, *fixture_db;
+	struct adb_table *table, *fixture;
+	int table_id, fixture_id;
+
+	fixture_lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(fixture_lib != NULL);
+
+	db = open_table(lib, ADB_TABLE_LOAD_COPY, &table_id);
+	fixture_db = open_table(fixture_lib, ADB_TABLE_LOAD_COPY, &fixture_id);
+
+	table = &db->table[table_id];
+	fixture = &fixture_db->table[fixture_id];
+	assert(table->object.count == fixture->object.count);
+	assert(table->object.bytes == fixture->object.bytes);
+	assert(!memcmp(table->objects, fixture->objects,
+				   table->object.count * table->object.bytes));
+	(void)table;
+	(void)fixture;
+
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+	adb_table_close(fixture_db, fixture_id);
+	adb_db_free(fixture_db);
+	adb_close_library(fixture_lib);
+}
+
+static void test_file_import_order(struct adb_library *lib)
+{
+	printf("   Testing import matches reference table...\n");
+
+	/* chunked import must insert rows in the same order as the reference */
+	check_reference(lib);
+
+	printf("    -> PASS\n");
+}
+
+static void test_file_sparse(struct adb_library *lib)
+{
+	printf("   Testing sparse mesh import...\n");
+
+	/* a sparse mesh writes the same table as a full mesh */
+	import_table(lib, 0, ADB_KD_BUILD_SORTED, ADB_MESH_SPARSE,
+				 ADB_TABLE_ENCODING_RAW);
+	check_reference(lib);
+
+	printf("    -> PASS\n");
+}
+
+static void test_file_single_pass(struct adb_library *lib)
+{
+	printf("   Testing single pass import...\n");
+
+	/* depths from the in memory histogram match the two pass import */
+	import_table(lib, IMPORT_SINGLE_PASS, ADB_KD_BUILD_SORTED, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_RAW);
+	check_reference(lib);
+
+	/* leave the default import for the tests that follow */
+	import_table(lib, 0, ADB_KD_BUILD_SORTED, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_RAW);
+
+	printf("    -> PASS\n");
+}
+
+/* angle between a position and a cone centre */
+static double cone_distance(double ra, double dec, double cra, double cdec)
+{
+	return acos(fmin(1.0, sin(dec) * sin(cdec) +
+							  cos(dec) * cos(cdec) * cos(ra - cra)));
+}
+
+static void test_file_aggregates(struct adb_library *lib)
+{
+	const struct adb_trixel_aggregate *aggregates;
+	const struct adb_object *object;
+	struct adb_object_set *set;
+	struct adb_table *table;
+	struct adb_db *db;
+	double flux = 0.0, sum, res = 6.0 * M_PI / 180.0, fov = 0.3;
+	float brightest = 99.0f;
+	int table_id, count, total, inside = 0, i, ret;
+
+	printf("   Testing trixel aggregates...\n");
+
+	/* aggregates do not change the objects */
+	import_table(lib, IMPORT_AGGREGATES, ADB_KD_BUILD_SORTED, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_RAW);
+	check_reference(lib);
+
+	db = open_table(lib, ADB_TABLE_LOAD_COPY, &table_id);
+	table = &db->table[table_id];
+	object = table->objects;
+	for (i = 0; i < table->object.count; i++) {
+		if (!isnan(object->mag)) {
+			flux += pow(10.0, -0.4 * object->mag);
+			if (object->mag < brightest)
+				brightest = object->mag;
+		}
+		if (cone_distance(object->ra, object->dec, 1.0, 0.5) <= fov)
+			inside++;
+		object = (const void *)object + table->object.bytes;
+	}
+
+	/* the whole sky aggregates hold every object once */
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+	total = 0;
+	sum = 0.0;
+	count = adb_set_get_aggregates(set, res, &aggregates);
+	assert(count > 8);
+	for (i = 0; i < count; i++) {
+		assert(htm_trixel_depth(aggregates[i].id) == 4);
+		assert(aggregates[i].brightest >= brightest);
+		total += aggregates[i].count;
+		sum += aggregates[i].flux;
+	}
+	assert(total == table->object.count);
+	assert(fabs(sum - flux) < flux * 1e-4);
+
+	/* a cone covers its objects with trixels near it */
+	ret = adb_table_set_constraints(set, 1.0, 0.5, fov, 0.0, 16.0);
+	assert(ret == 0);
+	(void)ret;
+	count = adb_set_get_aggregates(set, res, &aggregates);
+	assert(count > 0);
+	total = 0;
+	for (i = 0; i < count; i++) {
+		assert(cone_distance(aggregates[i].ra, aggregates[i].dec, 1.0, 0.5) <
+			   fov + 2.0 * res);
+		total += aggregates[i].count;
+	}
+	assert(total >= inside && total < table->object.count);
+	(void)total;
+	(void)sum;
+
+	adb_table_set_free(set);
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+
+	/* lazy tables read the aggregates with the trixel directory */
+	db = adb_create_db(lib, 5, 1);
+	assert(db != NULL);
+	adb_set_table_load(db, ADB_TABLE_LOAD_LAZY);
+	table_id = adb_table_open(db, "VII", "118", "ngc2000");
+	assert(table_id >= 0);
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+	count = adb_set_get_aggregates(set, M_PI, &aggregates);
+	assert(count == 8);
+	for (i = 0, total = 0; i < count; i++)
+		total += aggregates[i].count;
+	assert(total == adb_table_get_count(db, table_id));
+	adb_table_set_free(set);
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+
+	/* tables imported without aggregates have none */
+	import_table(lib, 0, ADB_KD_BUILD_SORTED, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_RAW);
+	db = open_table(lib, ADB_TABLE_LOAD_COPY, &table_id);
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+	count = adb_set_get_aggregates(set, res, &aggregates);
+	assert(count == -ENOENT);
+	adb_table_set_free(set);
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+
+	printf("    -> PASS\n");
+}
+
+/* split the raw catalog into two gzipped parts */
+static void write_stream_parts(void)
+{
+	char line[1024], path[256];
+	gzFile part = NULL;
+	FILE *f;
+	int rows = 0;
+
+	f = fopen(IMPORT_DIR "/VII/118/ngc2000.dat", "r");
+	assert(f != NULL);
+
+	while (fgets(line, sizeof(line), f)) {
+		if (rows == 0 || rows == 4000) {
+			if (part)
+				gzclose(part);
+			sprintf(path, STREAM_DIR "/VII/118/ngc2000.dat.%d.gz",
+					rows ? 2 : 1);
+			part = gzopen(path, "wb");
+			assert(part != NULL);
+		}
+		gzputs(part, line);
+		rows++;
+	}
+
+	gzclose(part);
+	fclose(f);
+}
+
+static void test_file_stream(void)
+{
+	struct adb_library *lib;
+	struct stat st;
+	int ret;
+
+	printf("   Testing streamed split gzip import...\n");
+
+	write_stream_parts();
+
+	lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", STREAM_DIR);
+	assert(lib != NULL);
+
+	import_table(lib, IMPORT_STREAM, ADB_KD_BUILD_SORTED, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_RAW);
+	check_reference(lib);
+
+	/* a single pass inflates the parts once for the same table */
+	import_table(lib, IMPORT_STREAM | IMPORT_SINGLE_PASS, ADB_KD_BUILD_SORTED,
+				 ADB_MESH_FULL, ADB_TABLE_ENCODING_RAW);
+	check_reference(lib);
+
+	/* parts are streamed, nothing is inflated or concatenated on disk */
+	ret = stat(STREAM_DIR "/VII/118/ngc2000.dat.1.gz", &st);
+	assert(ret == 0);
+	ret = stat(STREAM_DIR "/VII/118/ngc2000.dat.2.gz", &st);
+	assert(ret == 0);
+	ret = stat(STREAM_DIR "/VII/118/ngc2000.dat", &st);
+	assert(ret < 0);
+	(void)ret;
+
+	adb_close_library(lib);
+
+	printf("    -> PASS\n");
+}
+
+/* start each run with an empty download directory */
+static void clear_fetch_dir(void)
+{
+	char path[512];
+	struct dirent *dent;
+	DIR *dir;
+
+	mkdir(FETCH_DIR, 0755);
+	mkdir(FETCH_DIR "/VII", 0755);
+	mkdir(FETCH_DIR "/VII/118", 0755);
+
+	dir = opendir(FETCH_DIR "/VII/118");
+	assert(dir != NULL);
+	while ((dent = readdir(dir)) != NULL) {
+		if (dent->d_name[0] == '.' && (dent->d_name[1] == 0 ||
+									   !strcmp(dent->d_name, "..")))
+			continue;
+		snprintf(path, sizeof(path), FETCH_DIR "/VII/118/%s", dent->d_name);
+		unlink(path);
+	}
+	closedir(dir);
+}
+
+/* copy the first bytes of a file, as left by an interrupted download */
+static void copy_partial(const char *src, const char *dest, long bytes)
+{
+	char buf[4096];
+	FILE *in, *out;
+	size_t size;
+
+	in = fopen(src, "rb");
+	out = fopen(dest, "wb");
+	assert(in != NULL && out != NULL);
+	while (bytes > 0 && (size = fread(buf, 1, sizeof(buf), in)) > 0) {
+		if ((long)size > bytes)
+			size = bytes;
+		fwrite(buf, 1, size, out);
+		bytes -= size;
+	}
+	fclose(in);
+	fclose(out);
+}
+
+static void test_file_mirror(void)
+{
+	char cwd[256], url[512], *dir;
+	struct adb_library *lib;
+	struct stat st;
+	gzFile gz;
+	FILE *f;
+	char line[1024];
+	int ret;
+
+	printf("   Testing mirror download with resume...\n");
+
+	/* the mirror holds the ReadMe and a single compressed data file */
+	gz = gzopen(MIRROR_DIR "/VII/118/ngc2000.dat.gz", "wb");
+	f = fopen(IMPORT_DIR "/VII/118/ngc2000.dat", "r");
+	assert(gz != NULL && f != NULL);
+	while (fgets(line, sizeof(line), f))
+		gzputs(gz, line);
+	gzclose(gz);
+	fclose(f);
+
+	/* half of the data file is already downloaded */
+	clear_fetch_dir();
+	ret = stat(MIRROR_DIR "/VII/118/ngc2000.dat.gz", &st);
+	assert(ret == 0);
+	copy_partial(MIRROR_DIR "/VII/118/ngc2000.dat.gz",
+				 FETCH_DIR "/VII/118/.ngc2000.dat.gz.part", st.st_size / 2);
+
+	lib = adb_open_library("cdsarc.invalid", "/pub/cats", FETCH_DIR);
+	assert(lib != NULL);
+	dir = getcwd(cwd, sizeof(cwd));
+	assert(dir != NULL);
+	(void)dir;
+	snprintf(url, sizeof(url), "file://%s/" MIRROR_DIR "/", cwd);
+	ret = adb_library_set_mirror(lib, url);
+	if (ret == -ENOTSUP) {
+		printf("    -> SKIP (no libcurl)\n");
+		adb_close_library(lib);
+		return;
+	}
+	assert(ret == 0);
+
+	/* the FTP host is unreachable, so everything comes from the mirror */
+	import_table(lib, 0, ADB_KD_BUILD_SORTED, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_RAW);
+	check_reference(lib);
+
+	ret = stat(FETCH_DIR "/VII/118/ReadMe", &st);
+	assert(ret == 0);
+	ret = stat(FETCH_DIR "/VII/118/ngc2000.dat", &st);
+	assert(ret == 0);
+	ret = stat(FETCH_DIR "/VII/118/.ngc2000.dat.gz.part", &st);
+	assert(ret < 0);
+	ret = stat(FETCH_DIR "/VII/118/.ngc2000.gz.part", &st);
+	assert(ret < 0);
+
+	adb_close_library(lib);
+
+	printf("    -> PASS\n");
+}
+
+/* write the base catalog and an update with the rest and a changed row */
+static void write_update_parts(void)
+{
+	FILE *f, *base, *update;
+	char line[1024];
+	int rows = 0;
+
+	f = fopen(IMPORT_DIR "/VII/118/ngc2000.dat", "r");
+	base = fopen(UPDATE_DIR "/VII/118/ngc2000.dat", "w");
+	update = fopen(UPDATE_DIR "/ngc2000.update", "w");
+	assert(f != NULL && base != NULL && update != NULL);
+
+	while (fgets(line, sizeof(line), f)) {
+		fputs(line, rows < 10000 ? base : update);
+
+		/* I5370 brightens from 15.0 to 9.5 */
+		if (rows++ == 0) {
+			assert(!strncmp(line, "I5370", 5));
+			memcpy(line + 40, " 9.5", 4);
+			fputs(line, update);
+		}
+	}
+
+	fclose(update);
+	fclose(base);
+	fclose(f);
+}
+
+static void test_file_update(void)
+{
+	struct adb_library *lib, *fixture_lib;
+	struct adb_db *db, *fixture_db;
+	const struct adb_object *found;
+	struct adb_object_set *set;
+	struct stat st;
+	int table_id, fixture_id, count, ret;
+
+	printf("   Testing incremental table update...\n");
+
+	write_update_parts();
+	lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", UPDATE_DIR);
+	assert(lib != NULL);
+	import_table(lib, 0, ADB_KD_BUILD_SORTED, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_RAW);
+
+	/* hash the base table so the update has a stale map to remove */
+	db = adb_create_db(lib, 5, 1);
+	assert(db != NULL);
+	table_id = adb_table_open(db, "VII", "118", "ngc2000");
+	assert(table_id >= 0);
+	ret = adb_table_hash_key(db, table_id, "Name");
+	assert(ret == 0);
+	adb_table_close(db, table_id);
+	ret = stat(UPDATE_DIR "/VII/118/ngc2000.Name.hash", &st);
+	assert(ret == 0);
+
+	table_id = adb_table_import_new(db, "VII", "118", "ngc2000", "mag", 0.0,
+									18.0, ADB_IMPORT_INC);
+	assert(table_id >= 0);
+	ret = adb_table_import_schema(db, table_id, ngc_fields,
+								  adb_size(ngc_fields),
+								  sizeof(struct ngc_object));
+	assert(ret >= 0);
+	ret = adb_table_import_update(db, table_id, UPDATE_DIR "/ngc2000.update",
+								  "Name");
+	adb_table_close(db, table_id);
+	count = ret;
+	ret = stat(UPDATE_DIR "/VII/118/ngc2000.Name.hash", &st);
+	assert(ret < 0);
+
+	/* the updated table has the objects of a full import */
+	fixture_lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(fixture_lib != NULL);
+	fixture_db = adb_create_db(fixture_lib, 5, 1);
+	assert(fixture_db != NULL);
+	fixture_id = adb_table_open(fixture_db, "VII", "118", "ngc2000");
+	assert(fixture_id >= 0);
+	assert(count == fixture_db->table[fixture_id].object.count);
+
+	table_id = adb_table_open(db, "VII", "118", "ngc2000");
+	assert(table_id >= 0);
+	assert(db->table[table_id].object.count == count);
+
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+	adb_table_set_constraints(set, 0.0, 0.0, 2.0 * M_PI, 0.0, 16.0);
+	adb_set_get_objects(set);
+	assert(adb_set_get_count(set) == 7765);
+	adb_table_set_free(set);
+
+	/* the changed row replaced its object */
+	ret = adb_table_hash_key(db, table_id, "Name");
+	assert(ret == 0);
+	ret = adb_table_get_object(db, table_id, "I5370", "Name", &found);
+	assert(ret == 1);
+	assert(fabs(found->mag - 9.5) < 1e-6);
+	(void)found;
+	(void)count;
+	(void)ret;
+
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+	adb_table_close(fixture_db, fixture_id);
+	adb_db_free(fixture_db);
+	adb_close_library(fixture_lib);
+	adb_close_library(lib);
+
+	printf("    -> PASS\n");
+}
+
+/* check every node lies inside the bounds set by its ancestors pivots */
+static int check_kd_node(struct adb_table *table, int node, int parent,
+						 int depth, double lo[3], double hi[3])
+{
+	const struct adb_object *object;
+	double v[3], save;
+	int axis = depth % 3, count;
+
+	if (node < 0)
+		return 0;
+
+	assert(node < table->object.count);
+	object = (const void *)table->objects + node * table->object.bytes;
+	assert(object->kd.index == node);
+	assert(parent < 0 || object->kd.parent == parent);
+
+	v[0] = cos(object->dec) * sin(object->ra);
+	v[1] = sin(object->dec);
+	v[2] = cos(object->dec) * cos(object->ra);
+	assert(v[0] >= lo[0] && v[0] <= hi[0]);
+	assert(v[1] >= lo[1] && v[1] <= hi[1]);
+	assert(v[2] >= lo[2] && v[2] <= hi[2]);
+
+	/* balanced median splits */
+	assert(1 << depth <= table->object.count);
+
+	save = hi[axis];
+	hi[axis] = v[axis];
+	count = check_kd_node(table, object->kd.child[0], node, depth + 1, lo, hi);
+	hi[axis] = save;
+
+	save = lo[axis];
+	lo[axis] = v[axis];
+	count += check_kd_node(table, object->kd.child[1], node, depth + 1, lo, hi);
+	lo[axis] = save;
+
+	return count + 1;
+}
+
+static void test_file_kd_select(struct adb_library *lib)
+{
+	struct adb_db *sorted_db, *select_db;
+	struct adb_table *sorted, *select;
+	double lo[3] = { -1.0, -1.0, -1.0 }, hi[3] = { 1.0, 1.0, 1.0 };
+	const void *sorted_pos, *select_pos;
+	size_t kd_end;
+	int sorted_id, select_id, i, count;
+
+	printf("   Testing KD tree select build...\n");
+
+	import_table(lib, 0, ADB_KD_BUILD_SELECT, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_RAW);
+	select_db = open_table(lib, ADB_TABLE_LOAD_COPY, &select_id);
+	select = &select_db->table[select_id];
+
+	/* a valid KD tree holding each object once */
+	count = check_kd_node(select, select->kd_root, -1, 0, lo, hi);
+	assert(count == select->object.count);
+	(void)count;
+
+	/* only the KD fields differ from the sorted build */
+	import_table(lib, 0, ADB_KD_BUILD_SORTED, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_RAW);
+	check_reference(lib);
+	sorted_db = open_table(lib, ADB_TABLE_LOAD_COPY, &sorted_id);
+	sorted = &sorted_db->table[sorted_id];
+	assert(sorted->object.count == select->object.count);
+
+	kd_end = offsetof(struct adb_object, kd) + sizeof(struct adb_kd_tree);
+	sorted_pos = sorted->objects;
+	select_pos = select->objects;
+	for (i = 0; i < sorted->object.count; i++) {
+		assert(!memcmp(sorted_pos, select_pos,
+					   offsetof(struct adb_object, kd)));
+		assert(!memcmp(sorted_pos + kd_end, select_pos + kd_end,
+					   sorted->object.bytes - kd_end));
+		sorted_pos += sorted->object.bytes;
+		select_pos += select->object.bytes;
+	}
+	(void)kd_end;
+
+	adb_table_close(sorted_db, sorted_id);
+	adb_db_free(sorted_db);
+	adb_table_close(select_db, select_id);
+	adb_db_free(select_db);
+
+	printf("    -> PASS\n");
+}
+
+/* clip a cone, returning the object count, heads and the object nearest */
+static int cone_objects(struct adb_db *db, int table_id, double ra,
+						double dec, double fov, int *heads,
+						struct adb_object *nearest)
+{
+	const struct adb_object *object;
+	struct adb_object_set *set;
+	int count;
+
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	adb_table_set_constraints(set, ra, dec, fov, 0.0, 16.0);
+	*heads = adb_set_get_objects(set);
+	count = adb_set_get_count(set);
+	assert(*heads > 0);
+
+	object = adb_table_set_get_nearest_on_pos(set, ra, dec);
+	assert(object != NULL);
+	*nearest = *object;
+
+	adb_table_set_free(set);
+	return count;
+}
+
+static void test_file_depth_layout(struct adb_library *lib)
+{
+	struct adb_db *trixel_db, *depth_db;
+	struct adb_table *trixel, *depth;
+	double lo[3] = { -1.0, -1.0, -1.0 }, hi[3] = { 1.0, 1.0, 1.0 };
+	struct adb_object trixel_obj, depth_obj;
+	int trixel_id, depth_id, trixel_heads, depth_heads, count, i, ret;
+
+	printf("   Testing depth ordered table layout...\n");
+
+	trixel_db = open_table(lib, ADB_TABLE_LOAD_COPY, &trixel_id);
+	trixel = &trixel_db->table[trixel_id];
+	assert(trixel->layout == ADB_TABLE_LAYOUT_TRIXEL);
+
+	import_table(lib, IMPORT_DEPTH_LAYOUT, ADB_KD_BUILD_SELECT,
+				 ADB_MESH_FULL, ADB_TABLE_ENCODING_RAW);
+	depth_db = adb_create_db(lib, 5, 1);
+	assert(depth_db != NULL);
+	depth_id = adb_table_open(depth_db, "VII", "118", "ngc2000");
+	assert(depth_id >= 0);
+	depth = &depth_db->table[depth_id];
+	assert(depth->layout == ADB_TABLE_LAYOUT_DEPTH);
+	assert(depth->object.count == trixel->object.count);
+
+	/* a valid KD tree indexing the depth ordered objects */
+	count = check_kd_node(depth, depth->kd_root, -1, 0, lo, hi);
+	assert(count == depth->object.count);
+
+	/* the whole sky clips to one head per depth */
+	count = cone_objects(depth_db, depth_id, 0.0, 0.0, 2.0 * M_PI,
+						 &depth_heads, &depth_obj);
+	assert(count == 7765);
+	assert(depth_heads < 2706);
+
+	/* same objects from no more heads for smaller cones */
+	for (i = 0; i < 8; i++) {
+		count = cone_objects(trixel_db, trixel_id, i * M_PI / 4.0,
+							 (i - 4) * M_PI / 10.0, 0.3, &trixel_heads,
+							 &trixel_obj);
+		ret = cone_objects(depth_db, depth_id, i * M_PI / 4.0,
+						   (i - 4) * M_PI / 10.0, 0.3, &depth_heads,
+						   &depth_obj);
+		assert(ret == count);
+		assert(depth_heads <= trixel_heads);
+		assert(trixel_obj.ra == depth_obj.ra &&
+			   trixel_obj.dec == depth_obj.dec);
+	}
+	(void)trixel;
+	(void)depth;
+	(void)count;
+	(void)ret;
+
+	adb_table_close(depth_db, depth_id);
+	adb_db_free(depth_db);
+	adb_table_close(trixel_db, trixel_id);
+	adb_db_free(trixel_db);
+
+	/* leave the default import for the tests that follow */
+	import_table(lib, 0, ADB_KD_BUILD_SORTED, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_RAW);
+	check_reference(lib);
+
+	printf("    -> PASS\n");
+}
+
+/* compact objects must match the reference table to the encoding precision */
+static void check_compact(struct adb_db *db, int table_id,
+						  const struct adb_table *fixture)
+{
+	const struct adb_table *table = &db->table[table_id];
+	const struct adb_object *object, *ref;
+	int i;
+
+	assert(table->object.count == fixture->object.count);
+	for (i = 0; i < table->object.count; i++) {
+		object = (const void *)table->objects + i * table->object.bytes;
+		ref = (const void *)fixture->objects + i * table->object.bytes;
+
+		assert(!memcmp(object->designation, ref->designation,
+					   ADB_OBJECT_NAME_SIZE));
+		assert(fabs(object->ra - ref->ra) < 1e-9);
+		assert(fabs(object->dec - ref->dec) < 1e-9);
+		assert(isnan(ref->mag) ? isnan(object->mag) :
+								 fabsf(object->mag - ref->mag) <= 5e-4f);
+		assert(object->size == ref->size);
+		assert(!memcmp(&object->kd, &ref->kd,
+					   table->object.bytes - offsetof(struct adb_object, kd)));
+	}
+	(void)object;
+	(void)ref;
+}
+
+static void test_file_compact(struct adb_library *lib)
+{
+	static const struct adb_object *copy_objects[7765], *lazy_objects[7765];
+	struct adb_library *fixture_lib;
+	struct adb_db *db, *lazy_db, *fixture_db;
+	int table_id, lazy_id, fixture_id, copy_count, i, ret;
+	struct stat raw, compact;
+	double ra, dec;
+
+	printf("   Testing compact table files...\n");
+
+	ret = stat(IMPORT_DIR "/VII/118/ngc2000.db", &raw);
+	assert(ret == 0);
+	import_table(lib, 0, ADB_KD_BUILD_SORTED, ADB_MESH_FULL,
+				 ADB_TABLE_ENCODING_COMPACT);
+	ret = stat(IMPORT_DIR "/VII/118/ngc2000.db", &compact);
+	assert(ret == 0);
+	printf("    raw %ld bytes, compact %ld bytes\n", (long)raw.st_size,
+		   (long)compact.st_size);
+	assert(compact.st_size < raw.st_size);
+
+	fixture_lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(fixture_lib != NULL);
+	fixture_db = open_table(fixture_lib, ADB_TABLE_LOAD_COPY, &fixture_id);
+
+	/* mapped loads decode into a private buffer */
+	db = open_table(lib, ADB_TABLE_LOAD_MMAP, &table_id);
+	assert(db->table[table_id].map == NULL);
+	assert(db->table[table_id].lazy == NULL);
+	check_compact(db, table_id, &fixture_db->table[fixture_id]);
+
+	/* lazy loads decode the clipped trixels and then the rest */
+	lazy_db = open_table(lib, ADB_TABLE_LOAD_LAZY, &lazy_id);
+	assert(lazy_db->table[lazy_id].lazy != NULL);
+	copy_count = region_objects(db, table_id, copy_objects, 7765);
+	ret = region_objects(lazy_db, lazy_id, lazy_objects, 7765);
+	assert(ret == copy_count);
+	for (i = 0; i < copy_count; i++) {
+		ra = adb_object_ra(lazy_objects[i]);
+		dec = adb_object_dec(lazy_objects[i]);
+		assert(ra == adb_object_ra(copy_objects[i]));
+		assert(dec == adb_object_dec(copy_objects[i]));
+	}
+	(void)ra;
+	(void)dec;
+	ret = table_load_all(&lazy_db->table[lazy_id]);
+	assert(ret == 0);
+	(void)ret;
+	check_compact(lazy_db, lazy_id, &fixture_db->table[fixture_id]);
+
+	adb_table_close(lazy_db, lazy_id);
+	adb_db_free(lazy_db);
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+	adb_table_close(fixture_db, fixture_id);
+	adb_db_free(fixture_db);
+	adb_close_library(fixture_lib);
+
+	printf("    -> PASS\n");
+}
+
+static void test_file_legacy_mmap(void)
+{
+	struct adb_library *lib;
+	struct adb_db *db;
+	int table_id;
+
+	printf("   Testing mmap fallback for legacy table files...\n");
+
+	lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+
+	db = open_table(lib, ADB_TABLE_LOAD_MMAP, &table_id);
+	assert(db->table[table_id].map == NULL);
+	assert(db->table[table_id].objects != NULL);
+
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+	adb_close_library(lib);
+
+	printf("    -> PASS\n");
+}
+
+int main(void)
+{
+	struct adb_library *lib;
+
+	printf("Starting Table File Unit Tests...\n");
+
+	lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", IMPORT_DIR);
+	assert(lib != NULL);
+
+	test_file_import(lib);
+	test_file_import_order(lib);
+	test_file_sparse(lib);
+	test_file_single_pass(lib);
+	test_file_aggregates(lib);
+	test_file_load_modes(lib);
+	test_file_lazy(lib);
+	test_file_legacy_mmap();
+	test_file_stream();
+	test_file_mirror();
+	test_file_update();
+	test_file_kd_select(lib);
+	test_file_depth_layout(lib);
+	test_file_compact(lib);
+
+	adb_close_library(lib);
+
+	printf("All Table File Unit Tests Passed Successfully!\n");
+	return 0;
+}
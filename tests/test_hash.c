@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <libastrodb/db.h>
 #include <libastrodb/object.h>
@@ -13,26 +16,19 @@
 static void test_hash_string(void)
 {
 	printf("   Testing hash_string()...\n");
-	int mod = 100;
 
-	/* The actual algorithm in hash_string:
-	 * val = 0;
-	 * while(*str) { if(*str >= '0' && *str <= 'z') val = ((val<<5) ^ (val>>27)) ^ *str; str++; }
-	 * val = abs(val % mod);
-	 */
-
-	int hash1 = hash_string("alp Sco", 7, mod);
-	int hash2 = hash_string("alp sco", 7, mod);
-	int hash3 = hash_string("alp-Sco", 7, mod);
-	int hash4 = hash_string("alp Sco ", 8, mod);
+	/* FNV-1a over the characters between '0' and 'z', then mixed */
+	unsigned int hash1 = hash_string("alp Sco", 7);
+	unsigned int hash2 = hash_string("alp sco", 7);
+	unsigned int hash3 = hash_string("alp-Sco", 7);
+	unsigned int hash4 = hash_string("alp Sco ", 8);
 	(void)hash4;
 	(void)hash3;
 	(void)hash2;
 	(void)hash1;
 
-	/* Spaces and hyphens and trailing spaces are ignored or processed into the hash?
-	 * Actually, space ' ' (ascii 32) and hyphen '-' (ascii 45) are NOT between '0' (48) and 'z' (122), 
-	 * so they are ignored by the hash_string logic!
+	/* Space ' ' (ascii 32) and hyphen '-' (ascii 45) are NOT between
+	 * '0' (48) and 'z' (122), so they are ignored by the hash_string logic!
 	 */
 	assert(hash1 == hash3);
 	assert(hash1 == hash4);
@@ -40,23 +36,27 @@ static void test_hash_string(void)
 	/* Case sensitivity means these will be different hashes */
 	assert(hash1 != hash2);
 
-	/* Mod calculation */
-	assert(hash1 >= 0 && hash1 < mod);
+	/* The length bounds unterminated fields */
+	assert(hash_string("alp Scoxyz", 7) == hash1);
 	printf("    -> PASS\n");
 }
 
 static void test_hash_int(void)
 {
 	printf("   Testing hash_int()...\n");
-	int mod = 100;
+	unsigned int seen[256] = { 0 };
+	int i, used = 0;
 
-	int hash1 = hash_int(12345, mod);
-	int hash2 = hash_int(-12345, mod);
-	(void)hash2;
-	(void)hash1;
+	assert(hash_int(12345) == hash_int(12345));
+	assert(hash_int(12345) != hash_int(-12345));
 
-	assert(hash1 == 45); /* abs(12345 % 100) */
-	assert(hash2 == 45); /* abs(-12345 % 100) */
+	/* consecutive IDs spread over the low bits used to pick slots */
+	for (i = 0; i < 128; i++)
+		seen[hash_int(100000 + i) & 255]++;
+	for (i = 0; i < 256; i++)
+		used += seen[i] > 0;
+	(void)used;
+	assert(used > 96);
 
 	printf("    -> PASS\n");
 }
@@ -99,14 +99,29 @@ static void test_hash_build(void)
 	(void)map;
 	assert(map->type == ADB_CTYPE_STRING);
 
-	/* Let's find an object by hashing manually */
+	/* The slots are a power of two at least twice the object count */
 	int obj_count = table->object.count;
 	assert(obj_count > 0);
-
-	int test_hash = hash_string("21alp Sco", 9, obj_count);
-	(void)test_hash;
-	assert(map->index[test_hash] != NULL);
-	assert(map->index[test_hash]->count > 0);
+	unsigned int slots = map->mask + 1, used = 0, i;
+	assert((slots & map->mask) == 0);
+	assert(slots >= 2 * (unsigned int)obj_count);
+	for (i = 0; i < slots; i++)
+		used += map->slot[i].index >= 0;
+	assert(used == (unsigned int)obj_count);
+
+	/* Every object is found again by its own name */
+	const void *object = table->objects;
+	const struct adb_object *found;
+	for (int j = 0; j < obj_count; j++) {
+		const char *name = (const char *)object + map->offset;
+		if (name[0] != 0) {
+			int ret = adb_table_get_object(db, table_id, name, "Name", &found);
+			assert(ret == 1);
+			assert(strstr((const char *)found + map->offset, name) != NULL);
+			(void)ret;
+		}
+		object += table->object.bytes;
+	}
 
 	printf("    -> PASS\n");
 
@@ -115,6 +130,116 @@ static void test_hash_build(void)
 	adb_close_library(lib);
 }
 
+static void test_hash_file(void)
+{
+	printf("   Testing hash map files and set lookups...\n");
+	const char *file = "tests/V/109/sky2kv4.HD.hash";
+	struct stat st;
+	int ret;
+
+	struct adb_library *lib =
+		adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+
+	/* first open builds and saves the map */
+	unlink(file);
+	struct adb_db *db1 = adb_create_db(lib, 7, 1);
+	assert(db1 != NULL);
+	int id1 = adb_table_open(db1, "V", "109", "sky2kv4");
+	assert(id1 >= 0);
+	ret = adb_table_hash_key(db1, id1, "HD");
+	assert(ret == 0);
+	ret = stat(file, &st);
+	assert(ret == 0);
+
+	struct hash_map *map1 = &db1->table[id1].hash.map[0];
+	unsigned int slots = map1->mask + 1;
+	assert(map1->map == NULL);
+	assert(st.st_size == 40 + slots * sizeof(struct hash_slot));
+	(void)st;
+	(void)slots;
+
+	/* second open maps the same map back */
+	struct adb_db *db2 = adb_create_db(lib, 7, 1);
+	assert(db2 != NULL);
+	int id2 = adb_table_open(db2, "V", "109", "sky2kv4");
+	assert(id2 >= 0);
+	ret = adb_table_hash_key(db2, id2, "HD");
+	assert(ret == 0);
+
+	struct hash_map *map2 = &db2->table[id2].hash.map[0];
+	assert(map2->map != NULL);
+	assert(map2->mask == map1->mask);
+	assert(!memcmp(map1->slot, map2->slot, slots * sizeof(struct hash_slot)));
+	(void)map2;
+
+	/* lookups hit the same objects in both tables */
+	int hd = *(int *)((const char *)db1->table[id1].objects + map1->offset);
+	const struct adb_object *o1, *o2;
+	ret = adb_table_get_object(db1, id1, &hd, "HD", &o1);
+	assert(ret == 1);
+	ret = adb_table_get_object(db2, id2, &hd, "HD", &o2);
+	assert(ret == 1);
+	assert((const char *)o1 - (const char *)db1->table[id1].objects ==
+		   (const char *)o2 - (const char *)db2->table[id2].objects);
+
+	/* sets filter the table map by their objects */
+	struct adb_object_set *set = adb_table_set_new(db2, id2);
+	assert(set != NULL);
+	adb_table_set_constraints(set, adb_object_ra(o2), adb_object_dec(o2),
+							  0.02, -2.0, 16.0);
+	ret = adb_set_get_objects(set);
+	assert(ret > 0);
+	ret = adb_set_get_object(set, &hd, "HD", &o1);
+	assert(ret == 1);
+	assert(o1 == o2);
+	ret = adb_set_hash_key(set, "HD");
+	assert(ret == 0);
+	assert(set->hash.map[0].slot == NULL);
+	ret = adb_set_get_object(set, &hd, "HD", &o1);
+	assert(ret == 1);
+
+	double ra = fmod(adb_object_ra(o2) + M_PI, 2.0 * M_PI);
+	ret = adb_table_set_constraints(set, ra, -adb_object_dec(o2), 0.02, -2.0,
+									16.0);
+	assert(ret == 0);
+	adb_set_get_objects(set);
+	ret = adb_set_get_object(set, &hd, "HD", &o1);
+	assert(ret == 0);
+	assert(o1 == NULL);
+	adb_table_set_free(set);
+
+	/* corrupt slots fail the checksum and the map is rebuilt */
+	FILE *f = fopen(file, "r+");
+	assert(f != NULL);
+	ret = fseek(f, 40 + 4, SEEK_SET);
+	assert(ret == 0);
+	fputc(0x55, f);
+	fclose(f);
+
+	struct adb_db *db3 = adb_create_db(lib, 7, 1);
+	assert(db3 != NULL);
+	int id3 = adb_table_open(db3, "V", "109", "sky2kv4");
+	assert(id3 >= 0);
+	ret = adb_table_hash_key(db3, id3, "HD");
+	assert(ret == 0);
+	assert(db3->table[id3].hash.map[0].map == NULL);
+	assert(!memcmp(map1->slot, db3->table[id3].hash.map[0].slot,
+				   slots * sizeof(struct hash_slot)));
+	adb_table_close(db3, id3);
+	adb_db_free(db3);
+
+	(void)ret;
+
+	adb_table_close(db1, id1);
+	adb_db_free(db1);
+	adb_table_close(db2, id2);
+	adb_db_free(db2);
+	adb_close_library(lib);
+
+	printf("    -> PASS\n");
+}
+
 int main(void)
 {
 	printf("Starting Hash Unit Tests...\n");
@@ -122,6 +247,7 @@ int main(void)
 	test_hash_string();
 	test_hash_int();
 	test_hash_build();
+	test_hash_file();
 
 	printf("All Hash Unit Tests Passed Successfully!\n");
 	return 0;
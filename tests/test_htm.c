@@ -3,6 +3,7 @@
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <errno.h>
 
 #include <libastrodb/db.h>
 #include <libastrodb/object.h>
@@ -14,7 +15,7 @@
 static void test_htm_lifecycle(void)
 {
 	printf("Running HTM Lifecycle Test...\n");
-	struct htm *htm = htm_new(7, 2);
+	struct htm *htm = htm_new(7, 2, ADB_MESH_FULL);
 	assert(htm != NULL);
 	assert(htm->depth == 7);
 	assert(htm->trixel_count > 0);
@@ -35,7 +36,7 @@ static void test_htm_depth_calculations(void)
 	printf("   Resolution 0.1 deg gets depth %d\n", d1);
 
 	/* pseudo magnitude bounds, we need an HTM context */
-	struct htm *htm = htm_new(7, 1);
+	struct htm *htm = htm_new(7, 1, ADB_MESH_FULL);
 
 	/* Removed test for htm_get_depth_from_magnitude and htm_get_object_depth
 	 * because they are declared in htm.h but never defined in libastrodb. */
@@ -47,7 +48,7 @@ static void test_htm_depth_calculations(void)
 static void test_htm_vertices_trixels(void)
 {
 	printf("Running HTM Vertices and Trixel Test...\n");
-	struct htm *htm = htm_new(7, 1);
+	struct htm *htm = htm_new(7, 1, ADB_MESH_FULL);
 	assert(htm != NULL);
 
 	struct htm_vertex v;
@@ -151,7 +152,7 @@ static void test_htm_invalid_trixel(void)
 static void test_htm_all_quadrants(void)
 {
 	printf("Running HTM All Quadrants Test...\n");
-	struct htm *htm = htm_new(7, 1);
+	struct htm *htm = htm_new(7, 1, ADB_MESH_FULL);
 	assert(htm != NULL);
 
 	/* Test representative points in each of the 8 root trixels.
@@ -205,7 +206,7 @@ static void test_htm_all_quadrants(void)
 static void test_htm_nan_rejection(void)
 {
 	printf("Running HTM NaN Rejection Test...\n");
-	struct htm *htm = htm_new(7, 1);
+	struct htm *htm = htm_new(7, 1, ADB_MESH_FULL);
 	assert(htm != NULL);
 
 	struct htm_vertex v;
@@ -244,7 +245,7 @@ static void test_htm_nan_rejection(void)
 static void test_htm_boundary_trixels(void)
 {
 	printf("Running HTM Boundary Trixels Test...\n");
-	struct htm *htm = htm_new(7, 1);
+	struct htm *htm = htm_new(7, 1, ADB_MESH_FULL);
 	assert(htm != NULL);
 
 	struct htm_trixel *results[8];
@@ -287,6 +288,444 @@ static void test_htm_boundary_trixels(void)
 	printf(" -> PASS\n");
 }
 
+static void test_htm_home_id(void)
+{
+	printf("Running HTM Home ID Test...\n");
+	struct htm *htm = htm_new(7, 1, ADB_MESH_FULL);
+	assert(htm != NULL);
+
+	struct htm_vertex v;
+	struct htm_trixel *t;
+	unsigned int id;
+	int i, depth;
+
+	srand(7);
+	for (i = 0; i < 20000; i++) {
+		v.ra = (double)rand() / RAND_MAX * 2.0 * M_PI;
+		v.dec = asin(2.0 * rand() / RAND_MAX - 1.0);
+
+		/* trixel edges and corners */
+		if (i % 5 == 0)
+			v.dec = 0.0;
+		if (i % 7 == 0)
+			v.ra = M_PI_2 * (i % 4);
+		depth = i % 8;
+
+		/* the computed ID names the trixel a mesh walk finds */
+		t = htm_get_home_trixel(htm, &v, depth);
+		assert(t != NULL);
+		id = htm_get_home_id(htm, &v, depth);
+		assert(id == htm_trixel_id(t));
+		assert(htm_get_trixel(htm, id) == t);
+	}
+	(void)t;
+
+	/* invalid points have no ID */
+	v.ra = NAN;
+	v.dec = 0.0;
+	id = htm_get_home_id(htm, &v, 5);
+	assert(id == 0);
+	(void)id;
+
+	htm_free(htm);
+	printf(" -> PASS\n");
+}
+
+/* forget every cached cover so the next clip gathers from the mesh */
+static void cover_flush(struct htm *htm)
+{
+	int i;
+
+	for (i = 0; i < HTM_COVER_CACHE_SIZE; i++)
+		htm->cover[i].centre = 0;
+}
+
+static void test_htm_cover_cache(void)
+{
+	printf("Running HTM Cover Cache Test...\n");
+
+	struct adb_library *lib =
+		adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+	struct adb_db *db = adb_create_db(lib, 7, 1);
+	assert(db != NULL);
+
+	int table_id = adb_table_open(db, "V", "109", "sky2kv4");
+	assert(table_id >= 0);
+
+	struct adb_object_set *set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	static const double fov[] = { 1.0, 20.0, 2.0, 5.0, 1.0 };
+	static struct htm_trixel *gathered[HTM_COVER_MAX_TRIXELS];
+	unsigned long hits;
+	int i, count, pass, ret;
+
+	for (i = 0; i < (int)(sizeof(fov) / sizeof(fov[0])); i++) {
+		for (pass = 0; pass < 3; pass++) {
+			/* pass 0 gathers, pass 1 hits, pass 2 follows a large clip */
+			if (pass == 2) {
+				ret = htm_clip(db->htm, set, 0.0, 0.0, 30.0 * D2R, 0, 5);
+				assert(ret == 0);
+				htm_get_trixels(db->htm, set);
+			}
+			if (pass == 0)
+				cover_flush(db->htm);
+
+			ret = htm_clip(db->htm, set, 10.0 * D2R * i, 20.0 * D2R,
+						   fov[i] * D2R, 0, 5);
+			assert(ret == 0);
+			hits = db->htm->cover_hits;
+			count = htm_get_trixels(db->htm, set);
+
+			if (pass == 0) {
+				assert(count > 0 && count <= HTM_COVER_MAX_TRIXELS);
+				memcpy(gathered, set->trixels, count * sizeof(gathered[0]));
+				continue;
+			}
+
+			/* cached clips give the same trixels */
+			assert(db->htm->cover_hits == hits + 1);
+			assert(count == set->valid_trixels);
+			assert(!memcmp(gathered, set->trixels, count * sizeof(gathered[0])));
+			assert(set->trixels[count] == NULL);
+		}
+	}
+	(void)hits;
+
+	/* clipped objects agree with a freshly gathered cover */
+	ret = htm_clip(db->htm, set, 30.0 * D2R, 20.0 * D2R, 5.0 * D2R, 0, 5);
+	assert(ret == 0);
+	count = adb_set_get_objects(set);
+	cover_flush(db->htm);
+	ret = htm_clip(db->htm, set, 30.0 * D2R, 20.0 * D2R, 5.0 * D2R, 0, 5);
+	assert(ret == 0);
+	ret = adb_set_get_objects(set);
+	assert(ret == count);
+	(void)count;
+	(void)ret;
+
+	adb_table_set_free(set);
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+	adb_close_library(lib);
+
+	printf(" -> PASS\n");
+}
+
+/* copy the clipped objects of a set in head order */
+static int set_objects(struct adb_object_set *set, const void **objects,
+					   int size)
+{
+	struct adb_object_head *head;
+	int heads, bytes, i, j, count = 0;
+
+	heads = adb_set_get_objects(set);
+	assert(heads >= 0);
+	head = adb_set_get_head(set);
+	bytes = adb_table_get_object_size(set->db, set->table_id);
+
+	for (i = 0; i < heads; i++) {
+		for (j = 0; j < head[i].count; j++) {
+			assert(count < size);
+			objects[count++] = (const char *)head[i].objects + j * bytes;
+		}
+	}
+
+	return count;
+}
+
+static void test_htm_sparse(void)
+{
+	printf("Running HTM Sparse Mesh Test...\n");
+
+	struct adb_library *lib =
+		adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+	struct adb_db *full = adb_create_db(lib, 7, 1);
+	assert(full != NULL);
+	struct adb_db *sparse = adb_create_db_mesh(lib, 7, 1, ADB_MESH_SPARSE);
+	assert(sparse != NULL);
+	assert(sparse->htm->trixel_count == 8);
+
+	int full_id = adb_table_open(full, "V", "109", "sky2kv4");
+	assert(full_id >= 0);
+	int sparse_id = adb_table_open(sparse, "V", "109", "sky2kv4");
+	assert(sparse_id >= 0);
+
+	/* only trixels on the path to objects are created */
+	printf("   trixels full %d sparse %d, vertices full %d sparse %d\n",
+		   full->htm->trixel_count, sparse->htm->trixel_count,
+		   full->htm->vertex_count, sparse->htm->vertex_count);
+	assert(sparse->htm->trixel_count < full->htm->trixel_count);
+	assert(sparse->htm->vertex_count < full->htm->vertex_count);
+
+	struct adb_object_set *full_set = adb_table_set_new(full, full_id);
+	assert(full_set != NULL);
+	struct adb_object_set *sparse_set = adb_table_set_new(sparse, sparse_id);
+	assert(sparse_set != NULL);
+
+	static const double clip[][3] = {
+		{ 10.0, 20.0, 4.0 },   { 56.75, 24.1, 2.0 }, { 180.0, -60.0, 5.0 },
+		{ 300.0, 89.0, 10.0 }, { 0.0, 0.0, 30.0 },	 { 0.0, 0.0, 360.0 },
+	};
+	static const void *full_objects[400000], *sparse_objects[400000];
+	int bytes = adb_table_get_object_size(full, full_id);
+	int i, j, full_count, sparse_count;
+
+	for (i = 0; i < (int)(sizeof(clip) / sizeof(clip[0])); i++) {
+		adb_table_set_constraints(full_set, clip[i][0] * D2R,
+								  clip[i][1] * D2R, clip[i][2] * D2R, -2.0,
+								  16.0);
+		adb_table_set_constraints(sparse_set, clip[i][0] * D2R,
+								  clip[i][1] * D2R, clip[i][2] * D2R, -2.0,
+								  16.0);
+		full_count = set_objects(full_set, full_objects, 400000);
+		sparse_count = set_objects(sparse_set, sparse_objects, 400000);
+		printf("   clip %d objects %d\n", i, full_count);
+		assert(full_count > 0 && full_count == sparse_count);
+		for (j = 0; j < full_count; j++)
+			assert(!memcmp(full_objects[j], sparse_objects[j], bytes));
+	}
+	(void)bytes;
+	(void)sparse_count;
+
+	/* lookups do not grow the mesh, inserts create the path */
+	struct htm_vertex v;
+	struct htm_trixel *t;
+	int trixels = sparse->htm->trixel_count;
+
+	v.ra = 45.0 * D2R;
+	v.dec = 45.0 * D2R;
+	t = htm_get_home_trixel(sparse->htm, &v, 7);
+	assert(t != NULL && t->depth <= 7);
+	assert(sparse->htm->trixel_count == trixels);
+	t = htm_new_home_trixel(sparse->htm, &v, 7);
+	assert(t != NULL && t->depth == 7 && t->data != NULL);
+	assert(htm_get_trixel(sparse->htm, htm_trixel_id(t)) == t);
+	assert(htm_get_home_id(sparse->htm, &v, 7) == htm_trixel_id(t));
+	(void)t;
+	(void)trixels;
+
+	adb_table_set_free(full_set);
+	adb_table_set_free(sparse_set);
+	adb_table_close(full, full_id);
+	adb_table_close(sparse, sparse_id);
+	adb_db_free(full);
+	adb_db_free(sparse);
+	adb_close_library(lib);
+
+	printf(" -> PASS\n");
+}
+
+static double object_distance(const struct adb_object *a,
+							  const struct adb_object *b)
+{
+	double d = sin(a->dec) * sin(b->dec) +
+			   cos(a->dec) * cos(b->dec) * cos(a->ra - b->ra);
+
+	return acos(fmax(-1.0, fmin(1.0, d)));
+}
+
+static void test_htm_multi(void)
+{
+	printf("Running HTM Multi Table Clip Test...\n");
+
+	struct adb_library *lib =
+		adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+	struct adb_db *db = adb_create_db(lib, 7, 2);
+	assert(db != NULL);
+
+	int ids[2];
+	ids[0] = adb_table_open(db, "V", "109", "sky2kv4");
+	assert(ids[0] >= 0);
+	ids[1] = adb_table_open(db, "VII", "118", "ngc2000");
+	assert(ids[1] >= 0);
+
+	const int size = 20000;
+	const void **single = calloc(size, sizeof(*single));
+	const void **multi = calloc(size, sizeof(*multi));
+	assert(single != NULL && multi != NULL);
+
+	struct adb_multi_set *mset = adb_multi_set_new(db, NULL, 2);
+	assert(mset == NULL);
+	mset = adb_multi_set_new(db, (int[]){ ids[0], ids[0] }, 2);
+	assert(mset == NULL);
+
+	mset = adb_multi_set_new(db, ids, 2);
+	assert(mset != NULL);
+	assert(adb_multi_set_get_set(mset, 2) == NULL);
+
+	const struct adb_multi_object *objects;
+	double radius = 0.2 * D2R;
+	int i, j, k, count, total = 0, counts[2], dups = 0, ret;
+
+	ret = adb_multi_set_constraints(mset, 83.8 * D2R, -5.4 * D2R, 12.0 * D2R,
+									-2.0, 16.0);
+	assert(ret == 0);
+	ret = adb_multi_set_get_objects(mset, -1.0, &objects);
+	assert(ret == -EINVAL);
+
+	/* one traversal clips each table like its own set */
+	count = adb_multi_set_get_objects(mset, 0.0, &objects);
+	for (i = 0; i < 2; i++) {
+		struct adb_object_set *set = adb_table_set_new(db, ids[i]);
+		assert(set != NULL);
+		ret = adb_table_set_constraints(set, 83.8 * D2R, -5.4 * D2R,
+										12.0 * D2R, -2.0, 16.0);
+		assert(ret == 0);
+		counts[i] = set_objects(set, single, size);
+		assert(counts[i] > 0);
+		ret = set_objects(adb_multi_set_get_set(mset, i), multi, size);
+		assert(ret == counts[i]);
+		assert(!memcmp(single, multi, counts[i] * sizeof(*single)));
+		for (j = 0; j < counts[i]; j++)
+			assert(objects[total + j].object == multi[j] &&
+				   objects[total + j].table_id == ids[i]);
+		total += counts[i];
+		adb_table_set_free(set);
+	}
+	assert(count == total);
+	printf("   stars %d galaxies %d\n", counts[0], counts[1]);
+
+	/* later tables drop objects near a clipped object of an earlier one */
+	ret = set_objects(adb_multi_set_get_set(mset, 0), single, size);
+	assert(ret == counts[0]);
+	ret = set_objects(adb_multi_set_get_set(mset, 1), multi, size);
+	assert(ret == counts[1]);
+	for (j = 0; j < counts[1]; j++) {
+		for (k = 0; k < counts[0]; k++) {
+			if (object_distance(multi[j], single[k]) <= radius) {
+				dups++;
+				break;
+			}
+		}
+	}
+
+	count = adb_multi_set_get_objects(mset, radius, &objects);
+	printf("   merged %d objects, %d duplicates\n", count, dups);
+	assert(dups > 0 && dups < counts[1]);
+	assert(count == total - dups);
+	for (i = 0; i < counts[0]; i++)
+		assert(objects[i].object == single[i]);
+	(void)count;
+	(void)total;
+	(void)ret;
+
+	adb_multi_set_free(mset);
+	free(single);
+	free(multi);
+	adb_table_close(db, ids[1]);
+	adb_table_close(db, ids[0]);
+	adb_db_free(db);
+	adb_close_library(lib);
+
+	printf(" -> PASS\n");
+}
+
+/* mark the objects of a set clip by table position */
+static int set_mark(struct adb_object_set *set, char *mark)
+{
+	struct adb_object_head *head = adb_set_get_head(set);
+	int heads = adb_set_get_objects(set), i, j, count = 0;
+
+	memset(mark, 0, set->table->object.count);
+	for (i = 0; i < heads; i++) {
+		for (j = 0; j < (int)head[i].count; j++) {
+			assert(!mark[head[i].index + j]);
+			mark[head[i].index + j] = 1;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+static void test_htm_reclip(void)
+{
+	printf("Running HTM Re-clip Test...\n");
+
+	struct adb_library *lib =
+		adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+	struct adb_db *db = adb_create_db(lib, 7, 1);
+	assert(db != NULL);
+
+	int table_id = adb_table_open(db, "V", "109", "sky2kv4");
+	assert(table_id >= 0);
+
+	struct adb_object_set *set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	int objects = adb_table_get_count(db, table_id);
+	char *mark = calloc(objects, 1), *clip = calloc(objects, 1);
+	assert(mark != NULL && clip != NULL);
+
+	struct adb_set_delta delta;
+	int i, j, k, heads, added, removed, count = 0;
+
+	/* nothing fetched yet, so every head is added */
+	heads = adb_table_set_reclip(set, 40.0 * D2R, 10.0 * D2R, 8.0 * D2R,
+								 -2.0, 8.0, &delta);
+	assert(heads > 0 && delta.removed_count == 0);
+	for (i = 0; i < delta.added_count; i++)
+		for (j = 0; j < (int)delta.added[i].count; j++)
+			mark[delta.added[i].index + j] = 1;
+	count = set_mark(set, clip);
+	assert(count > 0);
+	assert(!memcmp(mark, clip, objects));
+
+	/* pan in small steps, the delta keeps the marks equal to the clip */
+	for (k = 1; k <= 12; k++) {
+		heads = adb_table_set_reclip(set, (40.0 + 0.25 * k) * D2R,
+									 (10.0 - 0.1 * k) * D2R, 8.0 * D2R, -2.0,
+									 8.0, &delta);
+		assert(heads >= 0);
+		added = removed = 0;
+		for (i = 0; i < delta.added_count; i++) {
+			assert(delta.added[i].count > 0);
+			for (j = 0; j < (int)delta.added[i].count; j++) {
+				assert(!mark[delta.added[i].index + j]);
+				mark[delta.added[i].index + j] = 1;
+				added++;
+			}
+		}
+		for (i = 0; i < delta.removed_count; i++) {
+			assert(delta.removed[i].count > 0);
+			for (j = 0; j < (int)delta.removed[i].count; j++) {
+				assert(mark[delta.removed[i].index + j]);
+				mark[delta.removed[i].index + j] = 0;
+				removed++;
+			}
+		}
+		count = set_mark(set, clip);
+		assert(!memcmp(mark, clip, objects));
+
+		/* a small pan changes only the edges of the field */
+		assert(added + removed < count);
+	}
+
+	/* the same clip again changes nothing */
+	heads = adb_table_set_reclip(set, 43.0 * D2R, 8.8 * D2R, 8.0 * D2R, -2.0,
+								 8.0, &delta);
+	assert(heads >= 0);
+	assert(delta.added_count == 0 && delta.removed_count == 0);
+	(void)heads;
+	(void)added;
+	(void)removed;
+	(void)count;
+
+	free(mark);
+	free(clip);
+	adb_table_set_free(set);
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+	adb_close_library(lib);
+
+	printf(" -> PASS\n");
+}
+
 int main(void)
 {
 	printf("Starting HTM Unit Tests...\n");
@@ -298,6 +737,11 @@ int main(void)
 	test_htm_all_quadrants();
 	test_htm_nan_rejection();
 	test_htm_boundary_trixels();
+	test_htm_home_id();
+	test_htm_cover_cache();
+	test_htm_sparse();
+	test_htm_multi();
+	test_htm_reclip();
 	printf("All HTM Unit Tests Passed Successfully!\n");
 	return 0;
 }
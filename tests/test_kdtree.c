@@ -3,6 +3,7 @@
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <errno.h>
 
 #include <libastrodb/db.h>
 #include <libastrodb/object.h>
@@ -55,9 +56,343 @@ static void test_kdtree_neighbors(void) {
 	printf(" -> PASS\n");
 }
 
+/* angular separation between two positions */
+static double separation(double ra1, double dec1, double ra2, double dec2)
+{
+	double c = sin(dec1) * sin(dec2) + cos(dec1) * cos(dec2) * cos(ra1 - ra2);
+
+	return acos(c > 1.0 ? 1.0 : c);
+}
+
+/* closest object by scanning every object in the table */
+static double brute_nearest(struct adb_table *table, double ra, double dec,
+							const struct adb_object *exclude)
+{
+	const struct adb_object *object;
+	double d, min = M_PI;
+	int i;
+
+	for (i = 0; i < table->object.count; i++) {
+		object = (const void *)table->objects + i * table->object.bytes;
+		if (object == exclude)
+			continue;
+		d = separation(ra, dec, adb_object_ra(object), adb_object_dec(object));
+		if (d < min)
+			min = d;
+	}
+
+	return min;
+}
+
+static void test_kdtree_exact(void) {
+	printf("Running KD-Tree Exact Nearest Test...\n");
+
+	struct adb_library *lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+
+	struct adb_db *db = adb_create_db(lib, 7, 1);
+	assert(db != NULL);
+
+	int table_id = adb_table_open(db, "V", "109", "sky2kv4");
+	assert(table_id >= 0);
+
+	struct adb_object_set *set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	struct adb_table *table = &db->table[table_id];
+	const struct adb_object *nearest, *object;
+	double ra, dec, d, min;
+	int i;
+
+	/* nearest to random positions matches a full scan */
+	srand(9);
+	for (i = 0; i < 200; i++) {
+		ra = 2.0 * M_PI * rand() / RAND_MAX;
+		dec = asin(2.0 * rand() / RAND_MAX - 1.0);
+
+		nearest = adb_table_set_get_nearest_on_pos(set, ra, dec);
+		assert(nearest != NULL);
+		d = separation(ra, dec, adb_object_ra(nearest), adb_object_dec(nearest));
+		min = brute_nearest(table, ra, dec, NULL);
+		assert(fabs(d - min) < 1e-9);
+	}
+
+	/* nearest to an object skips the object itself */
+	for (i = 0; i < 200; i++) {
+		object = (const void *)table->objects +
+				 (rand() % table->object.count) * table->object.bytes;
+		ra = adb_object_ra(object);
+		dec = adb_object_dec(object);
+
+		nearest = adb_table_set_get_nearest_on_object(set, object);
+		assert(nearest != NULL && nearest != object);
+		d = separation(ra, dec, adb_object_ra(nearest), adb_object_dec(nearest));
+		min = brute_nearest(table, ra, dec, object);
+		assert(fabs(d - min) < 1e-9);
+	}
+	(void)d;
+	(void)min;
+
+	adb_table_set_free(set);
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+	adb_close_library(lib);
+
+	printf(" -> PASS\n");
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	const double *d1 = a, *d2 = b;
+
+	return (*d1 > *d2) - (*d1 < *d2);
+}
+
+static void test_kdtree_knearest_radius(void) {
+	printf("Running KD-Tree K-Nearest and Radius Test...\n");
+
+	struct adb_library *lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+
+	struct adb_db *db = adb_create_db(lib, 7, 1);
+	assert(db != NULL);
+
+	int table_id = adb_table_open(db, "V", "109", "sky2kv4");
+	assert(table_id >= 0);
+
+	struct adb_object_set *set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	struct adb_table *table = &db->table[table_id];
+	const struct adb_object *found[32], *object;
+	double *all = malloc(sizeof(double) * table->object.count);
+	double ra, dec, radius = 3.0 * D2R, d, last;
+	int i, j, count, within, ret;
+	assert(all != NULL);
+
+	srand(10);
+	for (i = 0; i < 100; i++) {
+		ra = 2.0 * M_PI * rand() / RAND_MAX;
+		dec = asin(2.0 * rand() / RAND_MAX - 1.0);
+
+		/* every distance from a full scan, nearest first */
+		for (j = 0; j < table->object.count; j++) {
+			object = (const void *)table->objects + j * table->object.bytes;
+			all[j] = separation(ra, dec, adb_object_ra(object),
+								adb_object_dec(object));
+		}
+		qsort(all, table->object.count, sizeof(double), cmp_double);
+
+		/* k nearest are the first k of the scan */
+		count = adb_table_set_get_knearest_on_pos(set, ra, dec, 32, found);
+		assert(count == 32);
+		for (j = 0; j < count; j++) {
+			d = separation(ra, dec, adb_object_ra(found[j]),
+						   adb_object_dec(found[j]));
+			assert(fabs(d - all[j]) < 1e-9);
+		}
+
+		/* radius finds every object inside and keeps the nearest */
+		for (within = 0; within < table->object.count; within++)
+			if (all[within] > radius)
+				break;
+		count = adb_table_set_get_within_radius(set, ra, dec, radius, found,
+												32);
+		assert(count == within);
+		last = 0.0;
+		for (j = 0; j < count && j < 32; j++) {
+			d = separation(ra, dec, adb_object_ra(found[j]),
+						   adb_object_dec(found[j]));
+			assert(d <= radius + 1e-9 && d >= last - 1e-12);
+			assert(fabs(d - all[j]) < 1e-9);
+			last = d;
+		}
+	}
+	(void)d;
+	(void)last;
+
+	/* more neighbors than objects returns the whole table */
+	ret = adb_table_set_get_within_radius(set, 0.0, 0.0, M_PI, NULL, 0);
+	assert(ret == table->object.count);
+	ret = adb_table_set_get_knearest_on_pos(set, 0.0, 0.0, -1, found);
+	assert(ret == -EINVAL);
+	(void)ret;
+
+	free(all);
+	adb_table_set_free(set);
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+	adb_close_library(lib);
+
+	printf(" -> PASS\n");
+}
+
+static void test_kdtree_crossmatch(void) {
+	printf("Running KD-Tree Crossmatch Test...\n");
+
+	struct adb_library *lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+
+	struct adb_db *db = adb_create_db(lib, 7, 1);
+	assert(db != NULL);
+
+	int table_id = adb_table_open(db, "V", "109", "sky2kv4");
+	assert(table_id >= 0);
+
+	struct adb_object_set *set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	struct adb_table *table = &db->table[table_id];
+	static const struct adb_object *out[1000];
+	static double ra[1000], dec[1000];
+	const struct adb_object *nearest, *object;
+	double radius = 1.0 * D2R, d;
+	int i, matches, count = 0;
+
+	/* half near catalog objects, half random across the sky */
+	srand(11);
+	for (i = 0; i < 1000; i++) {
+		if (i & 1) {
+			ra[i] = 2.0 * M_PI * rand() / RAND_MAX;
+			dec[i] = asin(2.0 * rand() / RAND_MAX - 1.0);
+		} else {
+			object = (const void *)table->objects +
+					 (rand() % table->object.count) * table->object.bytes;
+			ra[i] = adb_object_ra(object) + 0.001 * rand() / RAND_MAX;
+			dec[i] = adb_object_dec(object) - 0.001 * rand() / RAND_MAX;
+			if (dec[i] < -M_PI_2)
+				dec[i] = -M_PI_2;
+		}
+	}
+	dec[999] = NAN;
+
+	matches = adb_table_crossmatch(set, ra, dec, 1000, radius, out);
+	assert(matches >= 500);
+
+	/* same result as one search per position */
+	for (i = 0; i < 999; i++) {
+		nearest = adb_table_set_get_nearest_on_pos(set, ra[i], dec[i]);
+		d = separation(ra[i], dec[i], adb_object_ra(nearest),
+					   adb_object_dec(nearest));
+		if (d <= radius) {
+			assert(out[i] == nearest);
+			count++;
+		} else
+			assert(out[i] == NULL);
+	}
+	assert(out[999] == NULL);
+	assert(count == matches);
+	(void)d;
+	(void)count;
+	(void)matches;
+
+	adb_table_set_free(set);
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+	adb_close_library(lib);
+
+	printf(" -> PASS\n");
+}
+
+struct join_check {
+	double radius;
+	int pairs, batches, stop;
+};
+
+static int join_pairs(const struct adb_join_pair *pairs, int count, void *data)
+{
+	struct join_check *check = data;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		assert(pairs[i].a < pairs[i].b);
+		assert(pairs[i].distance <= check->radius + 1e-9);
+		assert(fabs(pairs[i].distance -
+					separation(adb_object_ra(pairs[i].a),
+							   adb_object_dec(pairs[i].a),
+							   adb_object_ra(pairs[i].b),
+							   adb_object_dec(pairs[i].b))) < 1e-6);
+	}
+
+	check->pairs += count;
+	check->batches++;
+	return check->stop && check->batches == check->stop;
+}
+
+static void test_kdtree_join(void) {
+	printf("Running KD-Tree Join Test...\n");
+
+	struct adb_library *lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+
+	struct adb_db *db = adb_create_db(lib, 7, 1);
+	assert(db != NULL);
+
+	int table_id = adb_table_open(db, "V", "109", "sky2kv4");
+	assert(table_id >= 0);
+
+	struct adb_object_set *set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	struct adb_table *table = &db->table[table_id];
+	struct join_check check;
+	const struct adb_object *object;
+	int i, found, pairs, within = 0;
+
+	check.radius = 0.2 * D2R;
+	check.pairs = 0;
+	check.batches = 0;
+	check.stop = 0;
+
+	pairs = adb_table_join(db, table_id, table_id, check.radius, join_pairs,
+						   &check);
+	assert(pairs > 0);
+	assert(pairs == check.pairs);
+
+	/* every pair is within the radius of both of its objects */
+	for (i = 0; i < table->object.count; i++) {
+		object = (const void *)table->objects + i * table->object.bytes;
+		found = adb_table_set_get_within_radius(set, adb_object_ra(object),
+												adb_object_dec(object),
+												check.radius, NULL, 0);
+		assert(found >= 1);
+		within += found - 1;
+	}
+	assert(within == 2 * pairs);
+
+	/* the callback stops the join after its first batch */
+	check.pairs = 0;
+	check.batches = 0;
+	check.stop = 1;
+	pairs = adb_table_join(db, table_id, table_id, check.radius, join_pairs,
+						   &check);
+	assert(pairs == check.pairs);
+	assert(check.batches == 1);
+
+	pairs = adb_table_join(db, table_id, -1, check.radius, join_pairs,
+						   &check);
+	assert(pairs == -EINVAL);
+	pairs = adb_table_join(db, table_id, table_id, -1.0, join_pairs, &check);
+	assert(pairs == -EINVAL);
+	(void)pairs;
+	(void)within;
+	(void)found;
+
+	adb_table_set_free(set);
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+	adb_close_library(lib);
+
+	printf(" -> PASS\n");
+}
+
 int main(void) {
 	printf("Starting KD-Tree Unit Tests...\n");
 	test_kdtree_neighbors();
+	test_kdtree_exact();
+	test_kdtree_knearest_radius();
+	test_kdtree_crossmatch();
+	test_kdtree_join();
 	printf("All KD-Tree Unit Tests Passed Successfully!\n");
 	return 0;
 }
@@ -9,6 +9,8 @@
 #include <libastrodb/db.h>
 #include <libastrodb/object.h>
 
+#include "simd.h"
+
 static void test_query_all_objects(struct adb_db *db, int table_id)
 {
 	struct adb_object_set *set;
@@ -136,6 +138,317 @@ static void test_query_north_pole(struct adb_db *db, int table_id)
 	adb_table_set_free(set);
 }
 
+static double cone_dot(const struct adb_object *obj, double ra, double dec)
+{
+	return sin(obj->dec) * sin(dec) +
+		   cos(obj->dec) * cos(dec) * cos(obj->ra - ra);
+}
+
+static int cone_count(struct adb_db *db, int table_id, double ra, double dec,
+					  double cos_fov)
+{
+	struct adb_object_set *set;
+	struct adb_object_head *heads_arr;
+	int heads, bytes, count = 0;
+
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	adb_table_set_constraints(set, 0.0, 0.0, 2.0 * M_PI, 0.0, 16.0);
+	heads = adb_set_get_objects(set);
+	heads_arr = adb_set_get_head(set);
+	bytes = adb_table_get_object_size(db, table_id);
+
+	for (int i = 0; i < heads; i++) {
+		const struct adb_object *obj = heads_arr[i].objects;
+		for (int j = 0; j < heads_arr[i].count; j++) {
+			if (cone_dot(obj, ra, dec) >= cos_fov)
+				count++;
+			obj = (const void *)obj + bytes;
+		}
+	}
+
+	adb_table_set_free(set);
+	return count;
+}
+
+static void test_query_cone_exact(struct adb_db *db, int table_id)
+{
+	static const double cones[][3] = {
+		{ 2.87, 0.17, 0.17 }, { 6.2, -0.3, 0.05 }, { 0.0, 1.57, 0.17 },
+		{ 4.0, -1.2, 0.6 }, { 1.0, 0.5, 1.7 },
+	};
+	struct adb_object_set *set;
+	struct adb_object_head *heads_arr;
+	const char *base;
+	int c, heads, bytes, count, inside, edge;
+
+	printf("Running Query 6: Exact cone clipping\n");
+	bytes = adb_table_get_object_size(db, table_id);
+
+	for (c = 0; c < (int)(sizeof(cones) / sizeof(cones[0])); c++) {
+		double ra = cones[c][0], dec = cones[c][1], fov = cones[c][2];
+
+		set = adb_table_set_new(db, table_id);
+		assert(set != NULL);
+
+		adb_table_set_constraints(set, ra, dec, fov, 0.0, 16.0);
+		heads = adb_set_get_objects(set);
+		assert(heads > 0);
+		heads_arr = adb_set_get_head(set);
+
+		/* head indices all point back to the same table objects */
+		base = (const char *)heads_arr[0].objects -
+			   (size_t)heads_arr[0].index * bytes;
+
+		count = 0;
+		for (int i = 0; i < heads; i++) {
+			const struct adb_object *obj = heads_arr[i].objects;
+			assert((const char *)obj - (size_t)heads_arr[i].index * bytes ==
+				   base);
+
+			/* every clipped object must lie inside the cone */
+			for (int j = 0; j < heads_arr[i].count; j++) {
+				assert(cone_dot(obj, ra, dec) >= cos(fov) - 1.0e-9);
+				count++;
+				obj = (const void *)obj + bytes;
+			}
+		}
+		assert(count == adb_set_get_count(set));
+
+		/* and every object inside the cone must be clipped */
+		inside = cone_count(db, table_id, ra, dec, cos(fov) + 1.0e-9);
+		edge = cone_count(db, table_id, ra, dec, cos(fov) - 1.0e-9);
+		printf(" -> cone %d found %d objects, brute force %d\n", c, count,
+			   inside);
+		assert(count >= inside && count <= edge);
+		(void)base;
+		(void)edge;
+
+		adb_table_set_free(set);
+	}
+}
+
+static void polygon_edge(const double ra[], const double dec[], int n, int i,
+						 double edge[3])
+{
+	double a[3], b[3];
+	int j = (i + 1) % n;
+
+	a[0] = cos(dec[i]) * sin(ra[i]);
+	a[1] = sin(dec[i]);
+	a[2] = cos(dec[i]) * cos(ra[i]);
+	b[0] = cos(dec[j]) * sin(ra[j]);
+	b[1] = sin(dec[j]);
+	b[2] = cos(dec[j]) * cos(ra[j]);
+
+	edge[0] = a[1] * b[2] - a[2] * b[1];
+	edge[1] = a[2] * b[0] - a[0] * b[2];
+	edge[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static int polygon_inside(const struct adb_object *obj, const double ra[],
+						  const double dec[], int n)
+{
+	double p[3], edge[3], dot, sign;
+	int i;
+
+	/* winding from the third vertex against the first edge */
+	polygon_edge(ra, dec, n, 0, edge);
+	sign = edge[0] * cos(dec[2]) * sin(ra[2]) + edge[1] * sin(dec[2]) +
+		   edge[2] * cos(dec[2]) * cos(ra[2]);
+
+	p[0] = cos(obj->dec) * sin(obj->ra);
+	p[1] = sin(obj->dec);
+	p[2] = cos(obj->dec) * cos(obj->ra);
+
+	for (i = 0; i < n; i++) {
+		polygon_edge(ra, dec, n, i, edge);
+		dot = edge[0] * p[0] + edge[1] * p[1] + edge[2] * p[2];
+		if (fabs(dot) < 1.0e-9)
+			return -1;
+		if (dot * sign < 0.0)
+			return 0;
+	}
+
+	return 1;
+}
+
+static void test_query_polygon(struct adb_db *db, int table_id)
+{
+	/* CCD like footprint around RA 11h DEC 10 deg, then across RA 0 */
+	static const double fp_ra[][4] = {
+		{ 2.7, 3.0, 3.0, 2.7 },
+		{ 6.2, 0.1, 0.1, 6.2 },
+	};
+	static const double fp_dec[][4] = {
+		{ 0.05, 0.05, 0.3, 0.3 },
+		{ 0.3, 0.3, -0.2, -0.2 },
+	};
+	static const double bad_ra[] = { 2.7, 3.0, 2.7, 3.0 };
+	static const double bad_dec[] = { 0.05, 0.3, 0.3, 0.05 };
+	struct adb_object_set *set, *all;
+	struct adb_object_head *heads_arr;
+	int f, heads, bytes, count, brute, ret;
+
+	printf("Running Query 7: Polygon footprints\n");
+	bytes = adb_table_get_object_size(db, table_id);
+
+	all = adb_table_set_new(db, table_id);
+	assert(all != NULL);
+	adb_table_set_constraints(all, 0.0, 0.0, 2.0 * M_PI, 0.0, 16.0);
+
+	for (f = 0; f < 2; f++) {
+		set = adb_table_set_new(db, table_id);
+		assert(set != NULL);
+
+		ret = adb_table_set_polygon(set, fp_ra[f], fp_dec[f], 4, 0.0, 16.0);
+		assert(ret == 0);
+		heads = adb_set_get_objects(set);
+		assert(heads > 0);
+		heads_arr = adb_set_get_head(set);
+
+		count = 0;
+		for (int i = 0; i < heads; i++) {
+			const struct adb_object *obj = heads_arr[i].objects;
+			for (int j = 0; j < heads_arr[i].count; j++) {
+				assert(polygon_inside(obj, fp_ra[f], fp_dec[f], 4) != 0);
+				count++;
+				obj = (const void *)obj + bytes;
+			}
+		}
+
+		/* objects on an edge may go either way */
+		brute = 0;
+		heads = adb_set_get_objects(all);
+		heads_arr = adb_set_get_head(all);
+		for (int i = 0; i < heads; i++) {
+			const struct adb_object *obj = heads_arr[i].objects;
+			for (int j = 0; j < heads_arr[i].count; j++) {
+				brute += polygon_inside(obj, fp_ra[f], fp_dec[f], 4) == 1;
+				obj = (const void *)obj + bytes;
+			}
+		}
+
+		printf(" -> footprint %d found %d objects, brute force %d\n", f,
+			   count, brute);
+		assert(count == brute);
+
+		adb_table_set_free(set);
+	}
+
+	/* self intersecting and degenerate polygons are rejected */
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+	ret = adb_table_set_polygon(set, bad_ra, bad_dec, 4, 0.0, 16.0);
+	assert(ret == -EINVAL);
+	ret = adb_table_set_polygon(set, bad_ra, bad_dec, 2, 0.0, 16.0);
+	assert(ret == -EINVAL);
+
+	/* cone constraints replace a polygon */
+	ret = adb_table_set_polygon(set, fp_ra[0], fp_dec[0], 4, 0.0, 16.0);
+	assert(ret == 0);
+	adb_table_set_constraints(set, 0.0, 0.0, 2.0 * M_PI, 0.0, 16.0);
+	adb_set_get_objects(set);
+	assert(adb_set_get_count(set) == 7765);
+
+	adb_table_set_free(set);
+	adb_table_set_free(all);
+	(void)ret;
+}
+
+static void test_query_simd(struct adb_db *db, int table_id)
+{
+	static int scalar[1000], index[1000];
+	static double x[1000], y[1000], z[1000];
+	const double centre[3] = { 0.6, 0.0, 0.8 };
+	char *buf;
+	double dot, vdot;
+	int bytes, level, i, k, r, n, m, len, clipped[3];
+
+	printf("Running Query 8: SIMD filter and sum kernels\n");
+	bytes = adb_table_get_object_size(db, table_id);
+
+	/* synthetic objects at the table stride, with a few NaNs */
+	buf = calloc(1000, bytes);
+	assert(buf != NULL);
+	srand(15);
+	for (i = 0; i < 1000; i++) {
+		struct adb_object *o = (struct adb_object *)(buf + i * bytes);
+
+		o->dec = (rand() / (double)RAND_MAX - 0.5) * M_PI;
+		o->mag = (i % 97) ? rand() / (float)RAND_MAX * 16.0f : NAN;
+
+		x[i] = cos(o->dec) * sin(i * 0.37);
+		y[i] = (i % 89) ? sin(o->dec) : NAN;
+		z[i] = cos(o->dec) * cos(i * 0.37);
+	}
+
+	for (level = SIMD_SCALAR; level <= SIMD_AVX512; level++) {
+		if (simd_set_level(level) < 0) {
+			printf(" -> level %d not supported\n", level);
+			clipped[level] = -1;
+			continue;
+		}
+
+		/* odd lengths and offsets exercise the vector tails */
+		for (r = 0; r < 40; r++) {
+			const char *objects = buf + (r % 7) * bytes;
+			float mag = 0.4f * r;
+			double dec = -1.5 + 0.07 * r;
+
+			len = 1000 - 7 - r * 13;
+
+			simd_set_level(SIMD_SCALAR);
+			n = simd_select_mag(objects, len, bytes, mag, mag + 4.0f, scalar);
+			simd_set_level(level);
+			m = simd_select_mag(objects, len, bytes, mag, mag + 4.0f, index);
+			assert(m == n);
+			assert(!memcmp(scalar, index, n * sizeof(int)));
+
+			simd_set_level(SIMD_SCALAR);
+			n = simd_select_dec(objects, len, bytes, dec, dec + 0.5, scalar);
+			simd_set_level(level);
+			m = simd_select_dec(objects, len, bytes, dec, dec + 0.5, index);
+			assert(m == n);
+			assert(!memcmp(scalar, index, n * sizeof(int)));
+
+			k = r % 7;
+			simd_set_level(SIMD_SCALAR);
+			n = simd_select_cone(x + k, y + k, z + k, len, centre,
+								 cos(0.05 * r), scalar);
+			simd_set_level(level);
+			m = simd_select_cone(x + k, y + k, z + k, len, centre,
+								 cos(0.05 * r), index);
+			assert(m == n);
+			assert(!memcmp(scalar, index, n * sizeof(int)));
+
+			/* vector sums only reorder the additions */
+			simd_set_level(SIMD_SCALAR);
+			dot = simd_dot(x + k, z + k, len);
+			simd_set_level(level);
+			vdot = simd_dot(x + k, z + k, len);
+			assert(fabs(vdot - dot) < 1e-12 * (1.0 + fabs(dot)));
+			(void)vdot;
+			(void)dot;
+		}
+
+		/* cone clips agree at every level */
+		struct adb_object_set *cone = adb_table_set_new(db, table_id);
+		assert(cone != NULL);
+		adb_table_set_constraints(cone, 4.0, -1.2, 0.6, 0.0, 16.0);
+		adb_set_get_objects(cone);
+		clipped[level] = adb_set_get_count(cone);
+		adb_table_set_free(cone);
+		assert(clipped[level] == clipped[SIMD_SCALAR]);
+		printf(" -> level %d clipped %d objects\n", level, clipped[level]);
+	}
+
+	free(buf);
+	(void)m;
+	(void)n;
+}
+
 int ngc_query_test(const char *lib_dir) {
   struct adb_library *lib;
   struct adb_db *db;
@@ -172,6 +485,9 @@ int ngc_query_test(const char *lib_dir) {
   test_query_specific_region(db, table_id);
   test_query_faint_objects(db, table_id);
   test_query_north_pole(db, table_id);
+  test_query_cone_exact(db, table_id);
+  test_query_polygon(db, table_id);
+  test_query_simd(db, table_id);
 
 table_err:
   adb_table_close(db, table_id);
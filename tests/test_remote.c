@@ -0,0 +1,372 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <libastrodb/db.h>
+#include <libastrodb/db-import.h>
+#include <libastrodb/object.h>
+#include <libastrodb/remote.h>
+#include <libastrodb/search.h>
+#include <libastrodb/solve.h>
+
+#define D2R (1.7453292519943295769e-2)
+
+#define SOCKET "adbd-test.sock"
+#define MATCHES 64
+#define NEAREST 8
+#define RADIUS_SIZE 256
+
+struct daemon {
+	pthread_t thread;
+	struct adb_server *server;
+	int ret;
+};
+
+static void *daemon_run(void *data)
+{
+	struct daemon *d = data;
+
+	d->ret = adb_server_run(d->server);
+	return NULL;
+}
+
+/* objects of a set in head order */
+static int set_objects(struct adb_object_set *set, int bytes, char *buf,
+					   int size)
+{
+	struct adb_object_head *head = adb_set_get_head(set);
+	int heads = adb_set_get_objects(set), i, n = 0;
+
+	for (i = 0; i < heads; i++) {
+		assert(n + (int)head[i].count <= size);
+		memcpy(buf + (size_t)n * bytes, head[i].objects,
+			   (size_t)head[i].count * bytes);
+		n += head[i].count;
+	}
+
+	return n;
+}
+
+static void test_remote_sets(struct adb_db *local, int lid,
+							 struct adb_db *remote, int rid)
+{
+	struct adb_object_set *lset, *rset;
+	int bytes = adb_table_get_object_size(local, lid);
+	int count = adb_table_get_count(local, lid), n, ret;
+	char *lbuf, *rbuf;
+
+	printf("Running Remote Set Test...\n");
+
+	lbuf = malloc((size_t)count * bytes);
+	rbuf = malloc((size_t)count * bytes);
+	assert(lbuf && rbuf);
+
+	lset = adb_table_set_new(local, lid);
+	rset = adb_table_set_new(remote, rid);
+	assert(lset && rset);
+
+	/* whole sky, as test_ngc */
+	adb_table_set_constraints(rset, 0.0, 0.0, 2.0 * M_PI, 0.0, 16.0);
+	ret = adb_set_get_objects(rset);
+	assert(ret == 1);
+	assert(adb_set_get_count(rset) == 7765);
+
+	/* a cone has the same objects in the same order */
+	adb_table_set_constraints(lset, 2.87, 0.17, 0.17, 0.0, 16.0);
+	adb_table_set_constraints(rset, 2.87, 0.17, 0.17, 0.0, 16.0);
+	n = set_objects(lset, bytes, lbuf, count);
+	assert(n > 0);
+	ret = set_objects(rset, bytes, rbuf, count);
+	assert(ret == n);
+	assert(!memcmp(lbuf, rbuf, (size_t)n * bytes));
+	printf(" -> cone has %d objects\n", n);
+
+	/* only cone constraints are served */
+	{
+		double ra[3] = { 1.0, 1.2, 1.1 }, dec[3] = { 0.0, 0.0, 0.2 };
+		const struct adb_object *bright[4];
+
+		ret = adb_table_set_polygon(rset, ra, dec, 3, 0.0, 16.0);
+		assert(ret == -EOPNOTSUPP);
+		ret = adb_set_get_brightest(rset, 4, bright);
+		assert(ret == -EOPNOTSUPP);
+	}
+	(void)ret;
+
+	adb_table_set_free(lset);
+	adb_table_set_free(rset);
+	free(lbuf);
+	free(rbuf);
+}
+
+static void test_remote_hash(struct adb_db *local, int lid,
+							 struct adb_db *remote, int rid)
+{
+	const struct adb_object *lobj, *robj;
+	int bytes = adb_table_get_object_size(local, lid), ret;
+
+	printf("Running Remote Hash Test...\n");
+
+	ret = adb_table_hash_key(local, lid, "Name");
+	assert(ret == 0);
+	ret = adb_table_hash_key(remote, rid, "Name");
+	assert(ret == 0);
+
+	/* keys hashed by another client are reused */
+	ret = adb_table_hash_key(remote, rid, "Name");
+	assert(ret == 0);
+
+	ret = adb_table_get_object(local, lid, "I5370", "Name", &lobj);
+	assert(ret == 1);
+	ret = adb_table_get_object(remote, rid, "I5370", "Name", &robj);
+	assert(ret == 1);
+	assert(!memcmp(lobj, robj, bytes));
+
+	ret = adb_table_get_object(remote, rid, "I9999", "Name", &robj);
+	assert(ret == 0);
+	assert(robj == NULL);
+	ret = adb_table_get_object(remote, rid, "I5370", "Type", &robj);
+	assert(ret < 0);
+	(void)lobj;
+	(void)robj;
+	(void)bytes;
+	(void)ret;
+}
+
+static void test_remote_nearest(struct adb_db *local, int lid,
+								struct adb_db *remote, int rid)
+{
+	const struct adb_object *lnear[NEAREST], *rnear[NEAREST];
+	const struct adb_object *lwithin[RADIUS_SIZE], *rwithin[RADIUS_SIZE];
+	const struct adb_object *lmatch[MATCHES], *rmatch[MATCHES];
+	const struct adb_object *lobj, *robj;
+	struct adb_object_set *lset, *rset;
+	int bytes = adb_table_get_object_size(local, lid);
+	double ra[MATCHES], dec[MATCHES];
+	int i, n, lcount, rcount;
+
+	printf("Running Remote Nearest Test...\n");
+
+	lset = adb_table_set_new(local, lid);
+	rset = adb_table_set_new(remote, rid);
+	assert(lset && rset);
+
+	lobj = adb_table_set_get_nearest_on_pos(lset, 1.0, 0.5);
+	robj = adb_table_set_get_nearest_on_pos(rset, 1.0, 0.5);
+	assert(lobj && robj);
+	assert(!memcmp(lobj, robj, bytes));
+
+	/* the remote object is a copy, excluded by its contents */
+	lobj = adb_table_set_get_nearest_on_object(lset, lobj);
+	robj = adb_table_set_get_nearest_on_object(rset, robj);
+	assert(lobj && robj);
+	assert(!memcmp(lobj, robj, bytes));
+
+	n = adb_table_set_get_knearest_on_pos(lset, 4.0, -0.3, NEAREST, lnear);
+	assert(n == NEAREST);
+	rcount = adb_table_set_get_knearest_on_pos(rset, 4.0, -0.3, NEAREST,
+											   rnear);
+	assert(rcount == n);
+	for (i = 0; i < n; i++)
+		assert(!memcmp(lnear[i], rnear[i], bytes));
+
+	lcount = adb_table_set_get_within_radius(lset, 4.0, -0.3, 5.0 * D2R,
+											 lwithin, RADIUS_SIZE);
+	rcount = adb_table_set_get_within_radius(rset, 4.0, -0.3, 5.0 * D2R,
+											 rwithin, RADIUS_SIZE);
+	assert(lcount > 0 && lcount == rcount);
+	for (i = 0; i < lcount && i < RADIUS_SIZE; i++)
+		assert(!memcmp(lwithin[i], rwithin[i], bytes));
+
+	/* a batch of positions near objects and far from any */
+	for (i = 0; i < MATCHES; i++) {
+		ra[i] = adb_object_ra(lnear[i % NEAREST]) + (i % 3) * 1e-4;
+		dec[i] = adb_object_dec(lnear[i % NEAREST]);
+		if (i % 5 == 4)
+			dec[i] = -1.5;
+	}
+	lcount = adb_table_crossmatch(lset, ra, dec, MATCHES, 0.01, lmatch);
+	rcount = adb_table_crossmatch(rset, ra, dec, MATCHES, 0.01, rmatch);
+	assert(lcount > 0 && lcount == rcount);
+	for (i = 0; i < MATCHES; i++) {
+		assert(!lmatch[i] == !rmatch[i]);
+		if (lmatch[i])
+			assert(!memcmp(lmatch[i], rmatch[i], bytes));
+	}
+	printf(" -> matched %d of %d positions\n", rcount, MATCHES);
+	(void)bytes;
+
+	adb_table_set_free(lset);
+	adb_table_set_free(rset);
+}
+
+static struct adb_search *size_search(struct adb_db *db, int table_id)
+{
+	struct adb_search *search = adb_search_new(db, table_id);
+	int ret;
+
+	assert(search != NULL);
+	ret = adb_search_add_comparator(search, "size", ADB_COMP_GT, "10");
+	assert(ret == 0);
+	ret = adb_search_add_comparator(search, "size", ADB_COMP_LT, "60");
+	assert(ret == 0);
+	ret = adb_search_add_operator(search, ADB_OP_AND);
+	assert(ret == 0);
+	(void)ret;
+	return search;
+}
+
+static void test_remote_search(struct adb_db *local, int lid,
+							   struct adb_db *remote, int rid)
+{
+	const struct adb_object **lobjs, **robjs, *object;
+	struct adb_object_set *lset, *rset;
+	struct adb_search *lsearch, *rsearch;
+	int bytes = adb_table_get_object_size(local, lid);
+	int i, hits, ret;
+
+	printf("Running Remote Search Test...\n");
+
+	lset = adb_table_set_new(local, lid);
+	rset = adb_table_set_new(remote, rid);
+	assert(lset && rset);
+	adb_table_set_constraints(lset, 0.0, 0.0, 2.0 * M_PI, 0.0, 16.0);
+	adb_table_set_constraints(rset, 0.0, 0.0, 2.0 * M_PI, 0.0, 16.0);
+
+	lsearch = size_search(local, lid);
+	rsearch = size_search(remote, rid);
+
+	hits = adb_search_get_results(lsearch, lset, &lobjs);
+	assert(hits > 0);
+	ret = adb_search_get_results(rsearch, rset, &robjs);
+	assert(ret == hits);
+	assert(adb_search_get_hits(rsearch) == hits);
+	assert(adb_search_get_tests(rsearch) == adb_search_get_tests(lsearch));
+	for (i = 0; i < hits; i++)
+		assert(!memcmp(lobjs[i], robjs[i], bytes));
+	printf(" -> %d hits\n", hits);
+
+	/* iterating gives the same hits */
+	ret = adb_search_iter_begin(rsearch, rset);
+	assert(ret == 0);
+	for (i = 0; (object = adb_search_iter_next(rsearch)) != NULL; i++)
+		assert(!memcmp(object, lobjs[i], bytes));
+	assert(i == hits);
+
+	/* limits are applied by the daemon */
+	ret = adb_search_set_limit(rsearch, 5, ADB_LIMIT_FIRST);
+	assert(ret == 0);
+	ret = adb_search_get_results(rsearch, rset, &robjs);
+	assert(ret == 5);
+	(void)robjs;
+	(void)bytes;
+	(void)ret;
+
+	adb_search_free(lsearch);
+	adb_search_free(rsearch);
+	adb_table_set_free(lset);
+	adb_table_set_free(rset);
+}
+
+static void test_remote(void)
+{
+	struct adb_library *lib;
+	struct adb_db *served, *local, *remote, *other;
+	const struct adb_object *object;
+	struct adb_solve *solve;
+	struct daemon d;
+	int lid, rid, oid, ret;
+
+	printf("Running Query Daemon Test...\n");
+
+	lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+
+	/* the daemon maps its tables like adbd */
+	served = adb_create_db(lib, 5, 1);
+	assert(served != NULL);
+	adb_set_table_load(served, ADB_TABLE_LOAD_MMAP);
+	d.server = adb_server_new(served, SOCKET);
+	assert(d.server != NULL);
+	ret = pthread_create(&d.thread, NULL, daemon_run, &d);
+	assert(ret == 0);
+
+	local = adb_create_db(lib, 5, 1);
+	assert(local != NULL);
+	lid = adb_table_open(local, "VII", "118", "ngc2000");
+	assert(lid >= 0);
+
+	other = adb_connect_db("missing.sock");
+	assert(other == NULL);
+	remote = adb_connect_db(SOCKET);
+	assert(remote != NULL);
+	ret = adb_table_open(remote, "VII", "118", "missing");
+	assert(ret < 0);
+	rid = adb_table_open(remote, "VII", "118", "ngc2000");
+	assert(rid >= 0);
+
+	/* the schema is answered by the client */
+	assert(adb_table_get_count(remote, rid) == adb_table_get_count(local, lid));
+	assert(adb_table_get_object_size(remote, rid) ==
+		   adb_table_get_object_size(local, lid));
+	assert(adb_table_get_field_offset(remote, rid, "Name") ==
+		   adb_table_get_field_offset(local, lid, "Name"));
+	assert(adb_table_get_field_type(remote, rid, "size") ==
+		   adb_table_get_field_type(local, lid, "size"));
+
+	test_remote_sets(local, lid, remote, rid);
+	test_remote_hash(local, lid, remote, rid);
+	test_remote_nearest(local, lid, remote, rid);
+	test_remote_search(local, lid, remote, rid);
+
+	/* local only features are refused */
+	solve = adb_solve_new(remote, rid);
+	assert(solve == NULL);
+	ret = adb_db_freeze(remote);
+	assert(ret == -EOPNOTSUPP);
+	ret = adb_table_range_key(remote, rid, "size");
+	assert(ret == -EOPNOTSUPP);
+	(void)solve;
+
+	/* a second client shares the table and its hashed keys */
+	other = adb_connect_db(SOCKET);
+	assert(other != NULL);
+	oid = adb_table_open(other, "VII", "118", "ngc2000");
+	assert(oid >= 0);
+	assert(adb_table_get_count(other, oid) == adb_table_get_count(local, lid));
+	ret = adb_table_get_object(other, oid, "I5370", "Name", &object);
+	assert(ret == 1);
+	ret = adb_table_close(other, oid);
+	assert(ret == 0);
+	adb_db_free(other);
+
+	ret = adb_table_close(remote, rid);
+	assert(ret == 0);
+	adb_db_free(remote);
+
+	adb_server_stop(d.server);
+	pthread_join(d.thread, NULL);
+	assert(d.ret == 0);
+	adb_server_free(d.server);
+	ret = access(SOCKET, F_OK);
+	assert(ret < 0);
+	(void)object;
+	(void)ret;
+
+	adb_table_close(local, lid);
+	adb_db_free(local);
+	adb_db_free(served);
+	adb_close_library(lib);
+}
+
+int main(int argc, char *argv[])
+{
+	test_remote();
+	printf("All query daemon tests passed.\n");
+	return 0;
+}
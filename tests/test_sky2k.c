@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <poll.h>
 #include <sys/time.h>
 #include <assert.h>
 
@@ -64,6 +65,7 @@ static void test_search1(struct adb_db *db, int table_id)
 	/* Example data might have hits if we import enough. Just ensuring no crash. */
 	printf("   Search got %d objects out of %d tests\n",
 		   adb_search_get_hits(search), adb_search_get_tests(search));
+	assert(adb_search_get_hits(search) == 11);
 
 	adb_search_free(search);
 	adb_table_set_free(set);
@@ -91,11 +93,375 @@ static void test_search2(struct adb_db *db, int table_id)
 
 	printf("   Search got %d objects out of %d tests\n",
 		   adb_search_get_hits(search), adb_search_get_tests(search));
+	assert(adb_search_get_hits(search) == 334);
 
 	adb_search_free(search);
 	adb_table_set_free(set);
 }
 
+/* field value of a float or double search field */
+static double field_value(const struct adb_object *obj, int offset,
+						  adb_ctype type)
+{
+	const char *data = (const char *)obj + offset;
+
+	if (type == ADB_CTYPE_FLOAT)
+		return *(const float *)data;
+	return *(const double *)data;
+}
+
+/*
+ * Search for all stars with:-
+ * (pmRA > 0.1 || RV > 30) && Sp == K*
+ * and check the compiled search against a brute force scan.
+ */
+static void test_search3(struct adb_db *db, int table_id)
+{
+	const struct adb_object **object, **serial;
+	struct adb_object_head *heads_arr;
+	struct adb_search *search;
+	struct adb_object_set *set;
+	int pm, rv, sp, bytes, heads, hits, brute = 0, err;
+	adb_ctype pm_type, rv_type;
+
+	printf("Running Search 3: compiled plan against brute force\n");
+	search = adb_search_new(db, table_id);
+	assert(search != NULL);
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	adb_search_add_comparator(search, "pmRA", ADB_COMP_GT, "0.1");
+	adb_search_add_comparator(search, "RV", ADB_COMP_GT, "30");
+	adb_search_add_operator(search, ADB_OP_OR);
+	adb_search_add_comparator(search, "Sp", ADB_COMP_EQ, "K*");
+	adb_search_add_operator(search, ADB_OP_AND);
+	adb_search_add_operator(search, ADB_OP_AND);
+
+	adb_set_workers(db, 1);
+	hits = adb_search_get_results(search, set, &object);
+	assert(hits > 0);
+
+	/* the compiled plan is reused, parallel results keep head order */
+	serial = malloc(hits * sizeof(*serial));
+	assert(serial != NULL);
+	memcpy(serial, object, hits * sizeof(*serial));
+	adb_set_workers(db, 4);
+	err = adb_search_get_results(search, set, &object);
+	assert(err == hits);
+	assert(!memcmp(serial, object, hits * sizeof(*serial)));
+	(void)err;
+	adb_set_workers(db, 0);
+	free(serial);
+
+	pm = adb_table_get_field_offset(db, table_id, "pmRA");
+	rv = adb_table_get_field_offset(db, table_id, "RV");
+	sp = adb_table_get_field_offset(db, table_id, "Sp");
+	pm_type = adb_table_get_field_type(db, table_id, "pmRA");
+	rv_type = adb_table_get_field_type(db, table_id, "RV");
+	bytes = adb_table_get_object_size(db, table_id);
+
+	heads = adb_set_get_objects(set);
+	heads_arr = adb_set_get_head(set);
+	for (int i = 0; i < heads; i++) {
+		const struct adb_object *obj = heads_arr[i].objects;
+
+		for (int j = 0; j < heads_arr[i].count; j++) {
+			const char *s = (const char *)obj + sp;
+			double pm_min = pm_type == ADB_CTYPE_FLOAT ? 0.1f : 0.1;
+
+			if ((field_value(obj, pm, pm_type) > pm_min ||
+				 field_value(obj, rv, rv_type) > 30.0) &&
+				s[0] == 'K')
+				brute++;
+			obj = (const void *)obj + bytes;
+		}
+	}
+
+	printf("   Search got %d objects, brute force %d\n", hits, brute);
+	assert(hits == brute);
+	assert(adb_search_get_tests(search) == adb_set_get_count(set));
+
+	adb_search_free(search);
+	adb_table_set_free(set);
+}
+
+/* order hits on magnitude, then on hit position */
+static const struct adb_object **rank_hits;
+
+static int rank_cmp(const void *a, const void *b)
+{
+	int i = *(const int *)a, j = *(const int *)b;
+
+	if (rank_hits[i]->mag != rank_hits[j]->mag)
+		return rank_hits[i]->mag < rank_hits[j]->mag ? -1 : 1;
+	return i - j;
+}
+
+/*
+ * Iterate and limit the G5 class search of Search 2.
+ */
+static void test_search4(struct adb_db *db, int table_id)
+{
+	const struct adb_object **object, **all, *next;
+	struct adb_search *search;
+	struct adb_object_set *set;
+	int hits, tests, i, ret, *rank;
+
+	printf("Running Search 4: result cursor and limits\n");
+	search = adb_search_new(db, table_id);
+	assert(search != NULL);
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	adb_search_add_comparator(search, "Sp", ADB_COMP_EQ, "G5*");
+	adb_search_add_operator(search, ADB_OP_OR);
+
+	hits = adb_search_get_results(search, set, &object);
+	assert(hits == 334);
+	all = malloc(hits * sizeof(*all));
+	assert(all != NULL);
+	memcpy(all, object, hits * sizeof(*all));
+
+	/* the cursor returns the same hits in the same order */
+	ret = adb_search_iter_begin(search, set);
+	assert(ret == 0);
+	for (i = 0; (next = adb_search_iter_next(search)) != NULL; i++)
+		assert(i < hits && next == all[i]);
+	assert(i == hits && adb_search_get_hits(search) == hits);
+	assert(adb_search_get_tests(search) == adb_set_get_count(set));
+
+	/* first hit limits stop early */
+	ret = adb_search_set_limit(search, 10, ADB_LIMIT_FIRST);
+	assert(ret == 0);
+	ret = adb_search_get_results(search, set, &object);
+	assert(ret == 10);
+	assert(!memcmp(object, all, 10 * sizeof(*all)));
+	tests = adb_search_get_tests(search);
+	assert(tests < adb_set_get_count(set));
+	(void)tests;
+	ret = adb_search_iter_begin(search, set);
+	assert(ret == 0);
+	for (i = 0; adb_search_iter_next(search) != NULL; i++)
+		;
+	assert(i == 10 && adb_search_get_tests(search) == tests);
+
+	/* brightest hit limits match a magnitude ranking of all hits */
+	rank = malloc(hits * sizeof(*rank));
+	assert(rank != NULL);
+	for (i = 0; i < hits; i++)
+		rank[i] = i;
+	rank_hits = all;
+	qsort(rank, hits, sizeof(*rank), rank_cmp);
+
+	ret = adb_search_set_limit(search, 20, ADB_LIMIT_BRIGHTEST);
+	assert(ret == 0);
+	ret = adb_search_get_results(search, set, &object);
+	assert(ret == 20);
+	for (i = 0; i < 20; i++)
+		assert(object[i] == all[rank[i]]);
+	printf("   Brightest 20 of %d hits from %d tests\n", hits,
+		   adb_search_get_tests(search));
+	assert(adb_search_get_tests(search) < adb_set_get_count(set));
+
+	ret = adb_search_iter_begin(search, set);
+	assert(ret == 0);
+	for (i = 0; (next = adb_search_iter_next(search)) != NULL; i++)
+		assert(next == all[rank[i]]);
+	assert(i == 20);
+
+	ret = adb_search_set_limit(search, -1, ADB_LIMIT_FIRST);
+	assert(ret == -EINVAL);
+	(void)ret;
+
+	free(rank);
+	free(all);
+	adb_search_free(search);
+	adb_table_set_free(set);
+}
+
+/*
+ * Search range indexed fields, all sky and inside a cone:-
+ * RV > 30 && pmRA < 0.05
+ */
+static void test_search5(struct adb_db *db, int table_id)
+{
+	const struct adb_object **object, *next;
+	struct adb_search *search;
+	struct adb_object_set *set;
+	int hits, i, pass, ret;
+
+	printf("Running Search 5: range indexed fields\n");
+	ret = adb_table_range_key(db, table_id, "RV");
+	assert(ret == 0);
+	ret = adb_table_range_key(db, table_id, "pmRA");
+	assert(ret == 0);
+	ret = adb_table_range_key(db, table_id, "RV");
+	assert(ret == -EINVAL);
+	ret = adb_table_range_key(db, table_id, "DE-");
+	assert(ret == -EINVAL);
+
+	for (pass = 0; pass < 2; pass++) {
+		search = adb_search_new(db, table_id);
+		assert(search != NULL);
+		set = adb_table_set_new(db, table_id);
+		assert(set != NULL);
+		if (pass)
+			adb_table_set_constraints(set, 1.0, 0.3, 1.7, -2.0, 8.0);
+
+		adb_search_add_comparator(search, "RV", ADB_COMP_GT, "30");
+		adb_search_add_comparator(search, "pmRA", ADB_COMP_LT, "0.05");
+		adb_search_add_operator(search, ADB_OP_AND);
+
+		hits = adb_search_get_results(search, set, &object);
+		assert(hits > 0);
+		printf("   Search got %d objects out of %d tests in %d\n", hits,
+			   adb_search_get_tests(search), adb_set_get_count(set));
+		assert(adb_search_get_tests(search) < adb_set_get_count(set));
+
+		/* the cursor scans the set, hits and order must match */
+		ret = adb_search_iter_begin(search, set);
+		assert(ret == 0);
+		for (i = 0; (next = adb_search_iter_next(search)) != NULL; i++)
+			assert(i < hits && next == object[i]);
+		assert(i == hits);
+
+		adb_search_free(search);
+		adb_table_set_free(set);
+	}
+	(void)ret;
+}
+
+/*
+ * Search a range indexed string field by prefix:-
+ * Sp == "K0*", all objects and the first 10
+ */
+static void test_search6(struct adb_db *db, int table_id)
+{
+	const struct adb_object **object, **scan;
+	struct adb_search *search;
+	struct adb_object_set *set;
+	int hits, tests, ret;
+
+	printf("Running Search 6: range indexed string prefix\n");
+	search = adb_search_new(db, table_id);
+	assert(search != NULL);
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+
+	adb_search_add_comparator(search, "Sp", ADB_COMP_EQ, "K0*");
+	adb_search_add_comparator(search, "Vmag", ADB_COMP_LT, "8");
+	adb_search_add_operator(search, ADB_OP_AND);
+
+	/* full scan first, then through the index */
+	hits = adb_search_get_results(search, set, &object);
+	assert(hits > 10);
+	tests = adb_search_get_tests(search);
+	scan = malloc(hits * sizeof(*scan));
+	assert(scan != NULL);
+	memcpy(scan, object, hits * sizeof(*scan));
+
+	ret = adb_table_range_key(db, table_id, "Sp");
+	assert(ret == 0);
+	ret = adb_search_get_results(search, set, &object);
+	assert(ret == hits);
+	assert(!memcmp(scan, object, hits * sizeof(*scan)));
+	printf("   Search got %d objects out of %d tests, %d without index\n",
+		   hits, adb_search_get_tests(search), tests);
+	assert(adb_search_get_tests(search) < tests);
+
+	/* first hit limits keep the first hits of the scan */
+	ret = adb_search_set_limit(search, 10, ADB_LIMIT_FIRST);
+	assert(ret == 0);
+	ret = adb_search_get_results(search, set, &object);
+	assert(ret == 10);
+	assert(!memcmp(scan, object, 10 * sizeof(*scan)));
+	(void)ret;
+
+	free(scan);
+	adb_search_free(search);
+	adb_table_set_free(set);
+}
+
+/*
+ * Propagate all positions by proper motion a century from J2000 and check
+ * each star moved by its proper motion, in its direction.
+ */
+static void test_epoch1(struct adb_db *db, int table_id)
+{
+	const struct adb_object_head *head;
+	const struct adb_object *object, *first;
+	struct adb_object_set *set;
+	double J2000 = 2451545.0, J2100 = J2000 + 36525.0, ra, dec, pm_ra;
+	double pm_dec, moved, dist;
+	int heads, i, j, pm_ra_offset, pm_dec_offset, moving = 0, ret;
+
+	printf("Running Epoch 1: proper motion propagation\n");
+	ret = adb_table_epoch_view(db, table_id, J2100);
+	assert(ret == -EINVAL);
+	ret = adb_table_proper_motion(db, table_id, "pmRA", "Sp",
+								  ADB_PM_SEC_ARCSEC, J2000);
+	assert(ret == -EINVAL);
+	ret = adb_table_proper_motion(db, table_id, "pmRA", "pmDEC",
+								  ADB_PM_SEC_ARCSEC, J2000);
+	assert(ret == 0);
+
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+	adb_table_set_constraints(set, 0.0, 0.0, 2.0 * M_PI, -2.0, 16.0);
+	heads = adb_set_get_objects(set);
+	head = adb_set_get_head(set);
+	first = head[0].objects;
+	pm_ra_offset = adb_table_get_field_offset(db, table_id, "pmRA");
+	pm_dec_offset = adb_table_get_field_offset(db, table_id, "pmDEC");
+
+	for (i = 0; i < heads; i++) {
+		object = head[i].objects;
+		for (j = 0; j < head[i].count; j++) {
+			/* the catalog epoch gives the catalog positions */
+			ret = adb_table_get_epoch_position(db, table_id, object, J2000,
+											   &ra, &dec);
+			assert(ret == 0);
+			assert(ra == object->ra && dec == object->dec);
+
+			ret = adb_table_get_epoch_position(db, table_id, object, J2100,
+											   &ra, &dec);
+			assert(ret == 0);
+			pm_ra = *(const double *)((const char *)object + pm_ra_offset);
+			pm_dec = *(const double *)((const char *)object + pm_dec_offset);
+			if (pm_ra != 0.0 || pm_dec != 0.0) {
+				moving++;
+				moved = atan(hypot(pm_ra * 15.0 * cos(object->dec), pm_dec) *
+							 100.0 * D2R / 3600.0);
+				dist = acos(fmin(1.0, sin(dec) * sin(object->dec) +
+										  cos(dec) * cos(object->dec) *
+											  cos(ra - object->ra)));
+				assert(fabs(dist - moved) < 1e-8);
+				assert(pm_dec == 0.0 || (dec - object->dec) * pm_dec > 0.0);
+			}
+
+			object = (const void *)object +
+					 adb_table_get_object_size(db, table_id);
+		}
+	}
+	printf("   %d of %d stars moved\n", moving, adb_set_get_count(set));
+	assert(moving > 0);
+	adb_table_set_free(set);
+
+	/* frozen catalogs only read cached epochs */
+	ret = adb_db_freeze(db);
+	assert(ret == 0);
+	ret = adb_table_get_epoch_position(db, table_id, first, J2100, &ra, &dec);
+	assert(ret == 0);
+	ret = adb_table_epoch_view(db, table_id, J2000 + 365.25);
+	assert(ret == -EBUSY);
+	adb_db_thaw(db);
+	ret = adb_table_epoch_view(db, table_id, J2000 + 365.25);
+	assert(ret == 0);
+	(void)moved;
+	(void)dist;
+	(void)ret;
+}
+
 static void test_get1(struct adb_db *db, int table_id)
 {
 	struct adb_object_set *set;
@@ -179,6 +545,144 @@ static void test_get4(struct adb_db *db, int table_id)
 	adb_table_set_free(set);
 }
 
+static int mag_cmp(const void *a, const void *b)
+{
+	float ma = *(const float *)a, mb = *(const float *)b;
+
+	return ma < mb ? -1 : ma > mb;
+}
+
+static void test_get5(struct adb_db *db, int table_id)
+{
+	static const double fov[] = { 2.0 * M_PI, 30.0 * D2R, 5.0 * D2R };
+	const struct adb_object *bright[100];
+	const struct adb_object_head *head;
+	struct adb_object_set *set;
+	int i, j, f, heads, count, found, n = 0;
+	float *mags;
+
+	printf("Running Get 5: Brightest objects\n");
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+	found = adb_set_get_brightest(set, 0, bright);
+	assert(found == -EINVAL);
+
+	for (f = 0; f < (int)adb_size(fov); f++) {
+		adb_table_set_constraints(set, 1.0, 0.5, fov[f], -2.0, 16.0);
+
+		/* brightest first matches a sort of the full clip */
+		found = adb_set_get_brightest(set, adb_size(bright), bright);
+		assert(found > 0);
+
+		heads = adb_set_get_objects(set);
+		count = adb_set_get_count(set);
+		mags = calloc(count, sizeof(*mags));
+		assert(mags != NULL);
+		head = adb_set_get_head(set);
+		for (i = 0, n = 0; i < heads; i++) {
+			const char *object = head[i].objects;
+
+			for (j = 0; j < (int)head[i].count; j++) {
+				const struct adb_object *o = (const void *)object;
+
+				if (!isnan(o->mag))
+					mags[n++] = o->mag;
+				object += adb_table_get_object_size(db, table_id);
+			}
+		}
+		qsort(mags, n, sizeof(*mags), mag_cmp);
+
+		printf(" -> fov %3.1f brightest %d of %d mag %3.2f to %3.2f\n",
+			   fov[f] * R2D, found, count, bright[0]->mag,
+			   bright[found - 1]->mag);
+		assert(found == (n < (int)adb_size(bright) ? n : (int)adb_size(bright)));
+		for (i = 0; i < found; i++)
+			assert(bright[i]->mag == mags[i]);
+		free(mags);
+	}
+
+	adb_table_set_free(set);
+}
+
+static void test_get6(struct adb_db *db, int table_id)
+{
+	const char *fields[] = { "HD", "Sp" };
+	const struct adb_object_head *head;
+	struct adb_object_set *set;
+	int i, j, k, heads, count, hd, sp, sp_size, n = 0, ret;
+	double *ra, *dec;
+	float *mag;
+	int *hd_col;
+	char *sp_col;
+	void *columns[2];
+
+	printf("Running Get 6: Column export\n");
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+	adb_table_set_constraints(set, 1.0, 0.5, 30.0 * D2R, -2.0, 16.0);
+	heads = adb_set_get_objects(set);
+	count = adb_set_get_count(set);
+	assert(count > 0);
+
+	hd = adb_table_get_field_offset(db, table_id, "HD");
+	sp = adb_table_get_field_offset(db, table_id, "Sp");
+	sp_size = adb_table_get_field_size(db, table_id, "Sp");
+	ret = adb_table_get_field_size(db, table_id, "HD");
+	assert(ret == sizeof(int));
+	assert(sp_size > 0);
+
+	ra = calloc(count, sizeof(*ra));
+	dec = calloc(count, sizeof(*dec));
+	mag = calloc(count, sizeof(*mag));
+	hd_col = calloc(count, sizeof(*hd_col));
+	sp_col = calloc(count, sp_size);
+	assert(ra && dec && mag && hd_col && sp_col);
+	columns[0] = hd_col;
+	columns[1] = sp_col;
+
+	ret = adb_set_export_columns(set, ra, dec, mag, fields, columns, 2,
+								 count);
+	assert(ret == count);
+	fields[1] = "NoSuchField";
+	ret = adb_set_export_columns(set, NULL, NULL, NULL, fields, columns, 2,
+								 count);
+	assert(ret == -EINVAL);
+
+	/* columns follow the objects in head order */
+	head = adb_set_get_head(set);
+	for (i = 0; i < heads; i++) {
+		const char *object = head[i].objects;
+
+		for (j = 0; j < (int)head[i].count; j++, n++) {
+			const struct adb_object *o = (const void *)object;
+
+			assert(ra[n] == o->ra && dec[n] == o->dec);
+			assert(mag[n] == o->mag || (isnan(mag[n]) && isnan(o->mag)));
+			assert(hd_col[n] == *(const int *)(object + hd));
+			for (k = 0; k < sp_size; k++)
+				assert(sp_col[n * sp_size + k] == object[sp + k]);
+			object += adb_table_get_object_size(db, table_id);
+			(void)o;
+		}
+	}
+	assert(n == count);
+	(void)hd;
+	(void)sp;
+
+	/* short columns take the first objects */
+	ret = adb_set_export_columns(set, ra, NULL, NULL, NULL, NULL, 0, 10);
+	assert(ret == (count < 10 ? count : 10));
+	(void)ret;
+	printf(" -> exported %d objects\n", count);
+
+	free(ra);
+	free(dec);
+	free(mag);
+	free(hd_col);
+	free(sp_col);
+	adb_table_set_free(set);
+}
+
 static int sky2k_query_test(const char *lib_dir)
 {
 	struct adb_library *lib;
@@ -213,7 +717,14 @@ static int sky2k_query_test(const char *lib_dir)
 	test_get3(db, table_id);
 	test_search1(db, table_id);
 	test_search2(db, table_id);
+	test_search3(db, table_id);
+	test_search4(db, table_id);
+	test_search5(db, table_id);
+	test_search6(db, table_id);
+	test_epoch1(db, table_id);
 	test_get4(db, table_id);
+	test_get5(db, table_id);
+	test_get6(db, table_id);
 
 table_err:
 	adb_table_close(db, table_id);
@@ -223,6 +734,583 @@ lib_err:
 	return ret;
 }
 
+static struct adb_solve *solve_new(struct adb_db *db, int table_id)
+{
+	struct adb_solve *solve;
+
+	solve = adb_solve_new(db, table_id);
+	assert(solve);
+	adb_solve_constraint(solve, ADB_CONSTRAINT_MAG, 6.0, -2.0);
+	adb_solve_constraint(solve, ADB_CONSTRAINT_FOV, 0.1 * D2R, 5.0 * D2R);
+
+	/* add plate/ccd objects */
+	adb_solve_add_plate_object(solve, &pobject[0]);
+	adb_solve_add_plate_object(solve, &pobject[1]);
+	adb_solve_add_plate_object(solve, &pobject[2]);
+	adb_solve_add_plate_object(solve, &pobject[3]);
+	adb_solve_add_plate_object(solve, &pobject[4]);
+
+	adb_solve_set_magnitude_delta(solve, 0.5);
+	adb_solve_set_distance_delta(solve, 5.0);
+	adb_solve_set_pa_delta(solve, 2.0 * D2R);
+	return solve;
+}
+
+/*
+ * Solve again from the quad index in new databases, building it on the
+ * first pass and reading it back from the table directory on the second,
+ * and check it finds the sweep solution.
+ */
+static void test_solve_index(struct adb_library *lib, struct adb_solve *sweep,
+							 int sweep_found)
+{
+	struct adb_solve_solution *s1, *s2;
+	struct adb_object_set *set;
+	struct adb_solve *solve;
+	struct adb_db *db;
+	int pass, found, table_id;
+
+	for (pass = 0; pass < 2; pass++) {
+		db = adb_create_db(lib, 7, 1);
+		assert(db);
+		table_id = adb_table_open(db, "V", "109", "sky2kv4");
+		assert(table_id >= 0);
+		set = adb_table_set_new(db, table_id);
+		assert(set);
+		adb_table_set_constraints(set, 0.0, 0.0, 360.0 * D2R, -90.0, 90.0);
+
+		solve = solve_new(db, table_id);
+		found = adb_solve(solve, set, ADB_FIND_FIRST | ADB_FIND_INDEX);
+		printf(" -> found %d indexed solutions\n", found);
+		assert(found == sweep_found);
+
+		if (found > 0) {
+			s1 = adb_solve_get_solution(sweep, 0);
+			s2 = adb_solve_get_solution(solve, 0);
+			assert(adb_solution_divergence(s1) ==
+				   adb_solution_divergence(s2));
+			assert(adb_solution_get_pixel_size(s1) ==
+				   adb_solution_get_pixel_size(s2));
+			(void)s1;
+			(void)s2;
+		}
+
+		adb_solve_free(solve);
+		adb_table_set_free(set);
+		adb_table_close(db, table_id);
+		adb_db_free(db);
+	}
+}
+
+/*
+ * Solve again on 4 solver threads and check the result matches the single
+ * threaded solve, for ADB_FIND_FIRST and for ADB_FIND_ALL.
+ */
+static void test_solve_workers(struct adb_db *db, int table_id,
+							   struct adb_object_set *set,
+							   struct adb_solve *sweep, int sweep_found)
+{
+	struct adb_solve *solve[2];
+	int i, workers, found[2];
+
+	adb_set_workers(db, 4);
+	solve[0] = solve_new(db, table_id);
+	found[0] = adb_solve(solve[0], set, ADB_FIND_FIRST);
+	printf(" -> found %d solutions on 4 threads\n", found[0]);
+	assert(found[0] == sweep_found);
+	assert(adb_solve_get_progress(solve[0]) == 1.0);
+	if (found[0] > 0)
+		assert(adb_solution_divergence(adb_solve_get_solution(sweep, 0)) ==
+			   adb_solution_divergence(adb_solve_get_solution(solve[0], 0)));
+	adb_solve_free(solve[0]);
+
+	for (workers = 1; workers <= 4; workers += 3) {
+		adb_set_workers(db, workers);
+		solve[workers / 4] = solve_new(db, table_id);
+		found[workers / 4] = adb_solve(solve[workers / 4], set,
+									   ADB_FIND_ALL | ADB_FIND_INDEX);
+	}
+	printf(" -> found %d/%d indexed solutions on 1/4 threads\n", found[0],
+		   found[1]);
+	assert(found[0] == found[1]);
+	for (i = 0; i < found[0]; i++)
+		assert(adb_solution_divergence(adb_solve_get_solution(solve[0], i)) ==
+			   adb_solution_divergence(adb_solve_get_solution(solve[1], i)));
+
+	adb_solve_free(solve[0]);
+	adb_solve_free(solve[1]);
+	adb_set_workers(db, 0);
+}
+
+/* trace events of each point, counted from every solver thread */
+static long trace_events[ADB_TRACE_POINTS][2];
+
+static void trace_count(void *data, enum adb_trace_point point,
+						enum adb_trace_event event, long value)
+{
+	__atomic_add_fetch(&trace_events[point][event], 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Trace a clip, a nearest search and a threaded solve, and check every
+ * traced path begins and ends once per call.
+ */
+static void test_solve_trace(struct adb_db *db, int table_id,
+							 int sweep_found)
+{
+	const struct adb_object *nearest;
+	struct adb_db_stats stats;
+	struct adb_object_set *set;
+	struct adb_solve *solve;
+	int i, found, ret;
+
+	printf("Running trace events\n");
+	if (adb_set_trace(db, trace_count, NULL) == -ENOTSUP)
+		return;
+	memset(trace_events, 0, sizeof(trace_events));
+	adb_db_reset_stats(db);
+
+	set = adb_table_set_new(db, table_id);
+	assert(set);
+	adb_table_set_constraints(set, 0.0, 0.0, 360.0 * D2R, -90.0, 90.0);
+	nearest = adb_table_set_get_nearest_on_pos(set, 1.0, 0.5);
+	assert(nearest != NULL);
+
+	adb_set_workers(db, 4);
+	solve = solve_new(db, table_id);
+	found = adb_solve(solve, set, ADB_FIND_FIRST);
+	assert(found == sweep_found);
+	adb_solve_free(solve);
+	adb_set_workers(db, 0);
+
+	for (i = 0; i < ADB_TRACE_POINTS; i++)
+		assert(trace_events[i][ADB_TRACE_BEGIN] ==
+			   trace_events[i][ADB_TRACE_END]);
+	printf(" -> %ld clips %ld nearest %ld primaries %ld distance %ld PA\n",
+		   trace_events[ADB_TRACE_CLIP][0],
+		   trace_events[ADB_TRACE_KD_NEAREST][0],
+		   trace_events[ADB_TRACE_SOLVE_PRIMARY][0],
+		   trace_events[ADB_TRACE_SOLVE_DIST][0],
+		   trace_events[ADB_TRACE_SOLVE_PA][0]);
+	assert(trace_events[ADB_TRACE_CLIP][0] >= 2);
+	assert(trace_events[ADB_TRACE_CLIPPED_OBJECTS][0] >= 1);
+	assert(trace_events[ADB_TRACE_KD_NEAREST][0] >= 1);
+	assert(trace_events[ADB_TRACE_SOLVE_PRIMARY][0] > 0);
+	assert(trace_events[ADB_TRACE_SOLVE_DIST][0] <=
+		   trace_events[ADB_TRACE_SOLVE_PRIMARY][0]);
+	assert(trace_events[ADB_TRACE_SOLVE_PA][0] <=
+		   trace_events[ADB_TRACE_SOLVE_DIST][0]);
+
+	/* the counters see the same primaries */
+	if (adb_db_get_stats(db, &stats) == 0)
+		assert(stats.solve_primaries ==
+			   trace_events[ADB_TRACE_SOLVE_PRIMARY][0]);
+
+	/* no events once the callback is removed */
+	ret = adb_set_trace(db, NULL, NULL);
+	assert(ret == 0);
+	adb_table_set_get_nearest_on_pos(set, 1.0, 0.5);
+	assert(trace_events[ADB_TRACE_KD_NEAREST][0] ==
+		   trace_events[ADB_TRACE_KD_NEAREST][1]);
+	adb_table_set_free(set);
+	(void)nearest;
+	(void)found;
+	(void)ret;
+}
+
+/*
+ * Track the sweep solution onto the next frame, with the plate objects
+ * moved a few pixels, and check it finds the same stars.
+ */
+static void test_solve_track(struct adb_db *db, int table_id,
+							 struct adb_object_set *set, struct adb_solve *sweep,
+							 int sweep_found)
+{
+	struct adb_pobject drift[5];
+	struct adb_solve *solve;
+	struct timeval start, end;
+	int i, found;
+
+	if (sweep_found <= 0)
+		return;
+
+	solve = adb_solve_new(db, table_id);
+	assert(solve);
+	adb_solve_constraint(solve, ADB_CONSTRAINT_MAG, 6.0, -2.0);
+	adb_solve_constraint(solve, ADB_CONSTRAINT_FOV, 0.1 * D2R, 5.0 * D2R);
+	for (i = 0; i < 5; i++) {
+		drift[i] = pobject[i];
+		drift[i].x += 4;
+		drift[i].y -= 3;
+		adb_solve_add_plate_object(solve, &drift[i]);
+	}
+	adb_solve_set_magnitude_delta(solve, 0.5);
+	adb_solve_set_distance_delta(solve, 5.0);
+	adb_solve_set_pa_delta(solve, 2.0 * D2R);
+
+	gettimeofday(&start, NULL);
+	found = adb_solve_track(solve, set, adb_solve_get_solution(sweep, 0),
+							ADB_FIND_FIRST);
+	gettimeofday(&end, NULL);
+	printf(" -> tracked %d solutions in %ld us\n", found,
+		   (end.tv_sec - start.tv_sec) * 1000000L + end.tv_usec -
+			   start.tv_usec);
+	assert(found == sweep_found);
+	assert(adb_solution_divergence(adb_solve_get_solution(sweep, 0)) ==
+		   adb_solution_divergence(adb_solve_get_solution(solve, 0)));
+
+	adb_solve_free(solve);
+}
+
+/*
+ * Solve three frames, one of them drifted, against the same set in one
+ * batch and check each finds the sweep solution.
+ */
+static void test_solve_batch(struct adb_db *db, int table_id,
+							 struct adb_object_set *set, struct adb_solve *sweep,
+							 int sweep_found)
+{
+	struct adb_solve_frame frame[3];
+	struct adb_pobject drift[5];
+	int i, solved;
+
+	for (i = 0; i < 3; i++) {
+		frame[i].set = set;
+		frame[i].find = ADB_FIND_FIRST | ADB_FIND_INDEX;
+		frame[i].result = 0;
+	}
+
+	frame[0].solve = solve_new(db, table_id);
+	frame[1].solve = solve_new(db, table_id);
+
+	frame[2].solve = adb_solve_new(db, table_id);
+	assert(frame[2].solve);
+	adb_solve_constraint(frame[2].solve, ADB_CONSTRAINT_MAG, 6.0, -2.0);
+	adb_solve_constraint(frame[2].solve, ADB_CONSTRAINT_FOV, 0.1 * D2R,
+						 5.0 * D2R);
+	for (i = 0; i < 5; i++) {
+		drift[i] = pobject[i];
+		drift[i].x -= 6;
+		drift[i].y += 2;
+		adb_solve_add_plate_object(frame[2].solve, &drift[i]);
+	}
+	adb_solve_set_magnitude_delta(frame[2].solve, 0.5);
+	adb_solve_set_distance_delta(frame[2].solve, 5.0);
+	adb_solve_set_pa_delta(frame[2].solve, 2.0 * D2R);
+
+	adb_set_workers(db, 4);
+	solved = adb_solve_batch(frame, 3);
+	adb_set_workers(db, 0);
+	printf(" -> batch solved %d of 3 frames\n", solved);
+	assert(solved == (sweep_found > 0 ? 3 : 0));
+
+	for (i = 0; i < 3; i++) {
+		assert(frame[i].result == sweep_found);
+		assert(adb_solve_get_progress(frame[i].solve) == 1.0);
+		if (sweep_found > 0)
+			assert(adb_solution_divergence(adb_solve_get_solution(sweep, 0)) ==
+				   adb_solution_divergence(
+					   adb_solve_get_solution(frame[i].solve, 0)));
+		adb_solve_free(frame[i].solve);
+	}
+}
+
+/*
+ * Solve with the haystack kept on the set, from a solver with other
+ * magnitude limits and after the set is clipped again, and check each
+ * solve still finds the sweep solution.
+ */
+static void test_solve_haystack(struct adb_db *db, int table_id,
+								struct adb_object_set *set,
+								struct adb_solve *sweep, int sweep_found)
+{
+	struct adb_solve *solve[2];
+	int pass, found;
+
+	solve[1] = solve_new(db, table_id);
+	adb_solve_constraint(solve[1], ADB_CONSTRAINT_MAG, 4.0, -2.0);
+	found = adb_solve(solve[1], set, ADB_FIND_FIRST);
+	assert(found >= 0);
+
+	for (pass = 0; pass < 2; pass++) {
+		if (pass)
+			adb_table_set_constraints(set, 0.0, 0.0, 360.0 * D2R, -90.0,
+									  90.0);
+
+		solve[0] = solve_new(db, table_id);
+		found = adb_solve(solve[0], set, ADB_FIND_FIRST | ADB_FIND_INDEX);
+		printf(" -> found %d solutions from the %s haystack\n", found,
+			   pass ? "reclipped" : "shared");
+		assert(found == sweep_found);
+		if (found > 0)
+			assert(adb_solution_divergence(adb_solve_get_solution(sweep, 0)) ==
+				   adb_solution_divergence(
+					   adb_solve_get_solution(solve[0], 0)));
+		adb_solve_free(solve[0]);
+	}
+
+	adb_solve_free(solve[1]);
+}
+
+/*
+ * Solve from the haystack neighbour lists, building them on the first solve
+ * and reusing them on the second, and check both find the sweep solution
+ * and every indexed solution.
+ */
+static void test_solve_neighbours(struct adb_db *db, int table_id,
+								  struct adb_object_set *set,
+								  struct adb_solve *sweep, int sweep_found)
+{
+	struct adb_solve *solve, *all[2];
+	struct timeval start, end;
+	int i, pass, found, count[2];
+
+	for (pass = 0; pass < 2; pass++) {
+		solve = solve_new(db, table_id);
+		gettimeofday(&start, NULL);
+		found = adb_solve(solve, set, ADB_FIND_FIRST | ADB_FIND_NEIGHBOURS);
+		gettimeofday(&end, NULL);
+		printf(" -> found %d solutions from %s neighbours in %ld us\n", found,
+			   pass ? "cached" : "new",
+			   (end.tv_sec - start.tv_sec) * 1000000L + end.tv_usec -
+				   start.tv_usec);
+		assert(found == sweep_found);
+		if (found > 0)
+			assert(adb_solution_divergence(adb_solve_get_solution(sweep, 0)) ==
+				   adb_solution_divergence(adb_solve_get_solution(solve, 0)));
+		adb_solve_free(solve);
+	}
+
+	/* every indexed solution is found with the same divergence */
+	for (pass = 0; pass < 2; pass++) {
+		all[pass] = solve_new(db, table_id);
+		count[pass] = adb_solve(all[pass], set,
+								ADB_FIND_ALL | ADB_FIND_INDEX |
+									(pass ? ADB_FIND_NEIGHBOURS : 0));
+	}
+	printf(" -> found %d/%d indexed solutions without/with neighbours\n",
+		   count[0], count[1]);
+	assert(count[0] == count[1]);
+	for (i = 0; i < count[0]; i++)
+		assert(adb_solution_divergence(adb_solve_get_solution(all[0], i)) ==
+			   adb_solution_divergence(adb_solve_get_solution(all[1], i)));
+	adb_solve_free(all[0]);
+	adb_solve_free(all[1]);
+}
+
+/*
+ * Solve within a time budget, long enough to find the sweep solution and
+ * too short for a full ADB_FIND_ALL sweep, and check the short solve stops
+ * near its deadline.
+ */
+static void test_solve_timed(struct adb_db *db, int table_id,
+							 struct adb_object_set *set, struct adb_solve *sweep,
+							 int sweep_found)
+{
+	struct adb_solve *solve;
+	struct timeval start, end;
+	long usecs;
+	int found;
+
+	solve = solve_new(db, table_id);
+	found = adb_solve_timed(solve, set, ADB_FIND_FIRST | ADB_FIND_NEIGHBOURS,
+							60000);
+	printf(" -> found %d solutions in time\n", found);
+	assert(found == (sweep_found > 0 ? sweep_found : -ETIMEDOUT));
+	if (found > 0)
+		assert(adb_solution_divergence(adb_solve_get_solution(sweep, 0)) ==
+			   adb_solution_divergence(adb_solve_get_solution(solve, 0)));
+	adb_solve_free(solve);
+
+	solve = solve_new(db, table_id);
+	gettimeofday(&start, NULL);
+	found = adb_solve_timed(solve, set, ADB_FIND_ALL, 50);
+	gettimeofday(&end, NULL);
+	usecs = (end.tv_sec - start.tv_sec) * 1000000L + end.tv_usec -
+			start.tv_usec;
+	printf(" -> found %d solutions in a 50 ms budget after %ld us\n", found,
+		   usecs);
+	assert(found > 0 || found == -ETIMEDOUT);
+	assert(usecs < 500000);
+	adb_solve_free(solve);
+}
+
+static int async_result = -1;
+
+static void async_done(void *data, struct adb_solve *solve, int result)
+{
+	assert(data == &async_result && solve != NULL);
+	__atomic_store_n(&async_result, result, __ATOMIC_RELEASE);
+}
+
+static void test_solve_async(struct adb_db *db, int table_id,
+							 struct adb_object_set *set, struct adb_solve *sweep,
+							 int sweep_found)
+{
+	struct adb_solve *solve;
+	struct pollfd pfd;
+	struct timeval start, end;
+	long usecs;
+	int found, ret;
+
+	/* the caller polls while the solver thread runs */
+	solve = solve_new(db, table_id);
+	ret = adb_solve_get_fd(solve);
+	assert(ret == -EINVAL);
+	ret = adb_solve_wait(solve);
+	assert(ret == -EINVAL);
+	ret = adb_solve_start(solve, set, ADB_FIND_FIRST, async_done,
+						  &async_result);
+	assert(ret == 0);
+	ret = adb_solve_start(solve, set, ADB_FIND_FIRST, NULL, NULL);
+	assert(ret == -EBUSY);
+	pfd.fd = adb_solve_get_fd(solve);
+	pfd.events = POLLIN;
+	assert(pfd.fd >= 0);
+	ret = poll(&pfd, 1, 60000);
+	assert(ret == 1);
+	found = adb_solve_wait(solve);
+	printf(" -> started solve found %d solutions\n", found);
+	assert(found == sweep_found);
+	assert(__atomic_load_n(&async_result, __ATOMIC_ACQUIRE) == found);
+	if (found > 0)
+		assert(adb_solution_divergence(adb_solve_get_solution(sweep, 0)) ==
+			   adb_solution_divergence(adb_solve_get_solution(solve, 0)));
+	ret = adb_solve_get_fd(solve);
+	assert(ret == -EINVAL);
+
+	/* a stop right after the start is not lost */
+	gettimeofday(&start, NULL);
+	ret = adb_solve_start(solve, set, ADB_FIND_ALL, NULL, NULL);
+	assert(ret == 0);
+	adb_solve_stop(solve);
+	found = adb_solve_wait(solve);
+	gettimeofday(&end, NULL);
+	usecs = (end.tv_sec - start.tv_sec) * 1000000L + end.tv_usec -
+			start.tv_usec;
+	printf(" -> stopped solve found %d solutions after %ld us\n", found,
+		   usecs);
+	assert(found >= 0);
+
+	/* and does not stop the next solve */
+	found = adb_solve(solve, set, ADB_FIND_FIRST);
+	assert(found == sweep_found);
+
+	/* freeing a running solve stops and waits for it */
+	ret = adb_solve_start(solve, set, ADB_FIND_ALL, NULL, NULL);
+	assert(ret == 0);
+	adb_solve_free(solve);
+	(void)ret;
+}
+
+/*
+ * Resolve all the plate objects from the sweep solution, including the
+ * one that wasn't part of the solve.
+ */
+static void test_solution_objects(struct adb_solve *sweep, int table_id,
+								  int sweep_found)
+{
+	struct adb_solve_solution *solution;
+	struct adb_solve_object *sobject;
+	int i, solved, ret;
+
+	if (sweep_found <= 0)
+		return;
+
+	solution = adb_solve_get_solution(sweep, 0);
+	ret = adb_solution_set_search_limits(solution, 5.0 * D2R, 6.0, table_id);
+	assert(ret == 0);
+	ret = adb_solution_add_pobjects(solution, pobject, 6);
+	assert(ret == 0);
+	(void)ret;
+
+	solved = adb_solution_get_objects(solution);
+	printf(" -> resolved %d of 6 plate objects\n", solved);
+	assert(solved >= 4);
+
+	for (i = 0; i < 6; i++) {
+		sobject = adb_solution_get_object(solution, i);
+		assert(sobject);
+		if (sobject->object)
+			printf("    plate %d,%d -> RA %.4f DEC %.4f mag %.2f\n",
+				   pobject[i].x, pobject[i].y, sobject->object->ra * R2D,
+				   sobject->object->dec * R2D, sobject->object->mag);
+	}
+}
+
+/*
+ * Transform a plate grid including the reference positions with the array
+ * APIs and check it matches the single position APIs.
+ */
+static void test_solution_positions(struct adb_solve *sweep, int sweep_found)
+{
+	struct adb_solve_solution *solution;
+	double *x, *y, *ra, *dec, *px, *py, sra, sdec, sx, sy;
+	int i, fast, count = 1000, ret;
+
+	if (sweep_found <= 0)
+		return;
+
+	solution = adb_solve_get_solution(sweep, 0);
+	x = calloc(count * 6, sizeof(double));
+	assert(x);
+	y = x + count;
+	ra = y + count;
+	dec = ra + count;
+	px = dec + count;
+	py = px + count;
+
+	for (i = 0; i < count; i++) {
+		if (i < 6) {
+			x[i] = pobject[i].x;
+			y[i] = pobject[i].y;
+		} else {
+			x[i] = (i * 37) % 1200;
+			y[i] = (i * 53) % 800;
+		}
+	}
+
+	for (fast = 0; fast < 2; fast++) {
+		if (fast) {
+			ret = adb_solution_plate_to_equ_positions_fast(solution, x, y,
+														   count, ra, dec);
+			assert(ret == 0);
+			ret = adb_solution_equ_to_plate_positions_fast(solution, ra, dec,
+														   count, px, py);
+			assert(ret == 0);
+		} else {
+			ret = adb_solution_plate_to_equ_positions(solution, x, y, count,
+													  ra, dec);
+			assert(ret == 0);
+			ret = adb_solution_equ_to_plate_positions(solution, ra, dec,
+													  count, px, py);
+			assert(ret == 0);
+		}
+
+		for (i = 0; i < count; i++) {
+			if (fast) {
+				adb_solution_plate_to_equ_position_fast(solution, x[i], y[i],
+														&sra, &sdec);
+				adb_solution_equ_to_plate_position_fast(solution, ra[i],
+														dec[i], &sx, &sy);
+			} else {
+				adb_solution_plate_to_equ_position(solution, x[i], y[i], &sra,
+												   &sdec);
+				adb_solution_equ_to_plate_position(solution, ra[i], dec[i],
+												   &sx, &sy);
+			}
+			assert(fabs(ra[i] - sra) < 1e-12);
+			assert(fabs(dec[i] - sdec) < 1e-12);
+			assert(fabs(px[i] - sx) < 1e-9);
+			assert(fabs(py[i] - sy) < 1e-9);
+		}
+	}
+
+	printf(" -> transformed %d plate positions\n", count);
+	free(x);
+	(void)ret;
+}
+
 static int sky2k_solve_test(const char *lib_dir)
 {
 	struct adb_library *lib;
@@ -259,27 +1347,24 @@ static int sky2k_solve_test(const char *lib_dir)
 	adb_table_set_constraints(set, 0.0 * D2R, 0.0 * D2R, 360.0 * D2R, -90.0,
 							  90.0);
 
-	solve = adb_solve_new(db, table_id);
-	adb_solve_constraint(solve, ADB_CONSTRAINT_MAG, 6.0, -2.0);
-	adb_solve_constraint(solve, ADB_CONSTRAINT_FOV, 0.1 * D2R, 5.0 * D2R);
-
-	/* add plate/ccd objects */
-	adb_solve_add_plate_object(solve, &pobject[0]);
-	adb_solve_add_plate_object(solve, &pobject[1]);
-	adb_solve_add_plate_object(solve, &pobject[2]);
-	adb_solve_add_plate_object(solve, &pobject[3]);
-	adb_solve_add_plate_object(solve, &pobject[4]);
-
-	adb_solve_set_magnitude_delta(solve, 0.5);
-	adb_solve_set_distance_delta(solve, 5.0);
-	adb_solve_set_pa_delta(solve, 2.0 * D2R);
-
+	solve = solve_new(db, table_id);
 	found = adb_solve(solve, set, ADB_FIND_FIRST);
 	printf(" -> found %d solutions\n", found);
 
 	/* Even if found == 0, we're not explicitly asserting on finding solutions if data isn't complete, 
 	   but the flow must run without segfaults. */
 
+	test_solve_index(lib, solve, found);
+	test_solve_workers(db, table_id, set, solve, found);
+	test_solve_track(db, table_id, set, solve, found);
+	test_solve_batch(db, table_id, set, solve, found);
+	test_solve_haystack(db, table_id, set, solve, found);
+	test_solve_neighbours(db, table_id, set, solve, found);
+	test_solve_timed(db, table_id, set, solve, found);
+	test_solve_async(db, table_id, set, solve, found);
+	test_solve_trace(db, table_id, found);
+	test_solution_objects(solve, table_id, found);
+	test_solution_positions(solve, found);
 	adb_solve_free(solve);
 	adb_table_set_free(set);
 set_err:
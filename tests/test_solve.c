@@ -106,6 +106,103 @@ static void test_solve_lifecycle(void)
 	printf("    -> PASS\n");
 }
 
+static void test_solve_score(void)
+{
+	printf("   Testing candidate scoring backend...\n");
+	const struct solve_score_backend *backend = solve_score_get_backend();
+	struct adb_object objects[64];
+	const struct adb_object *haystack[64], *primary;
+	struct solve_candidate *c;
+	struct solve_runtime *runtime;
+	struct solve_score *score;
+	struct adb_solve *solve;
+	struct adb_db db;
+	double d[64], rad_per_pixel;
+	int i, j, k, count, expected = 0, ret;
+
+	memset(&db, 0, sizeof(db));
+	memset(objects, 0, sizeof(objects));
+	solve = adb_solve_new(&db, 0);
+	assert(solve != NULL);
+
+	/* a small field well inside the maximum FOV */
+	srand(57);
+	for (i = 0; i < 64; i++) {
+		objects[i].ra = 1.0 + 0.02 * rand() / RAND_MAX;
+		objects[i].dec = 0.5 + 0.02 * rand() / RAND_MAX;
+		haystack[i] = &objects[i];
+	}
+	solve->haystack.objects = haystack;
+	solve->haystack.num_objects = 64;
+	solve->constraint.max_fov = 0.5;
+
+	score = backend->prepare(&solve->haystack);
+	assert(score != NULL);
+	assert(score->count == 64);
+	assert(score->ra[7] == objects[7].ra && score->dec[7] == objects[7].dec);
+
+	/* t1 and t2 at 1.5 and 2 times the t0 distance */
+	solve->target.secondary[0].distance.plate_actual = 100.0;
+	solve->target.secondary[1].distance.plate_actual = 150.0;
+	solve->target.secondary[1].distance.pattern_min = 135.0;
+	solve->target.secondary[1].distance.pattern_max = 165.0;
+	solve->target.secondary[2].distance.plate_actual = 200.0;
+	solve->target.secondary[2].distance.pattern_min = 180.0;
+	solve->target.secondary[2].distance.pattern_max = 220.0;
+
+	runtime = calloc(1, sizeof(*runtime));
+	assert(runtime != NULL);
+	solve_runtime_reset(runtime, solve);
+	ret = solve_runtime_alloc(runtime, 64);
+	assert(ret == 0);
+	(void)ret;
+	for (i = 0; i < MIN_PLATE_OBJECTS - 1; i++) {
+		runtime->pot_magnitude.start_pos[i] = 4 * i;
+		runtime->pot_magnitude.end_pos[i] = 64 - 8 * i;
+	}
+
+	primary = haystack[10];
+	count = backend->distance(runtime, score, primary);
+
+	/* same candidates in the same order as the pointer walk */
+	for (i = 0; i < 64; i++)
+		d[i] = distance_get_equ(primary, haystack[i]);
+	for (i = 0; i < 64; i++) {
+		if (i == 10)
+			continue;
+		rad_per_pixel = d[i] / 100.0;
+		for (j = 4; j < 56; j++) {
+			if (j == i || j == 10 || d[j] < 135.0 * rad_per_pixel ||
+				d[j] > 165.0 * rad_per_pixel)
+				continue;
+			for (k = 8; k < 48; k++) {
+				if (k == i || k == j || k == 10 ||
+					d[k] < 180.0 * rad_per_pixel ||
+					d[k] > 220.0 * rad_per_pixel)
+					continue;
+				if (expected < runtime->num_pot_distance) {
+					c = &runtime->pot_distance[expected];
+					assert(c->object[0] == primary);
+					assert(c->object[1] == haystack[i]);
+					assert(c->object[2] == haystack[j]);
+					assert(c->object[3] == haystack[k]);
+					(void)c;
+				}
+				expected++;
+			}
+		}
+	}
+	assert(expected > 0);
+	assert(count == expected);
+	(void)count;
+
+	solve_runtime_free(runtime);
+	free(runtime);
+	backend->release(score);
+	adb_solve_free(solve);
+	printf("    -> PASS\n");
+}
+
 int main(void)
 {
 	printf("Starting Solve Unit Tests...\n");
@@ -114,6 +211,7 @@ int main(void)
 	test_solve_plate_mag_diff();
 	test_solve_mag_cmp();
 	test_solve_lifecycle();
+	test_solve_score();
 	printf("All Solve Unit Tests Passed Successfully!\n");
 	return 0;
 }
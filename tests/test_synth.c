@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include <libastrodb/db.h>
+#include <libastrodb/object.h>
+#include <libastrodb/solve.h>
+#include "../bench/synth.h"
+
+#define D2R (1.7453292519943295769e-2) /* deg->radian */
+#define R2D (5.7295779513082320877e1) /* radian->deg */
+
+#define SYNTH_DIR "synth"
+#define OBJECTS 20000
+#define PLATE_OBJECTS 8
+
+static struct synth_star stars[OBJECTS];
+
+static int save_star(void *data, const struct synth_star *star)
+{
+	int *count = data;
+
+	stars[(*count)++] = *star;
+	return 0;
+}
+
+static void catalog_new(struct synth_catalog *cat)
+{
+	synth_catalog_init(cat, "synth", OBJECTS);
+	cat->clusters = 8;
+	cat->cluster_fraction = 0.5;
+	cat->seed = 42;
+}
+
+static void test_synth_walk(void)
+{
+	struct synth_catalog cat;
+	int count = 0, clustered = 0, i, ret;
+
+	printf("   Testing synth_catalog_walk()...\n");
+	catalog_new(&cat);
+	ret = synth_catalog_walk(&cat, save_star, &count);
+	assert(ret == 0);
+	assert(count == OBJECTS);
+
+	for (i = 0; i < OBJECTS; i++) {
+		assert(stars[i].seq == i + 1);
+		assert(stars[i].ra >= 0.0 && stars[i].ra < 2.0 * M_PI);
+		assert(fabs(stars[i].dec) <= M_PI / 2.0);
+		assert(stars[i].mag >= cat.mag_min && stars[i].mag <= cat.mag_max);
+		clustered += stars[i].mag < 8.0;
+	}
+
+	/* counts grow with magnitude */
+	printf("    %d of %d objects brighter than mag 8\n", clustered, OBJECTS);
+	assert(clustered > 0 && clustered < OBJECTS / 100);
+
+	/* the same seed walks the same objects */
+	count = 0;
+	cat.seed = 43;
+	ret = synth_catalog_walk(&cat, save_star, &count);
+	assert(ret == 0);
+	count = 0;
+	cat.seed = 42;
+	ret = synth_catalog_walk(&cat, save_star, &count);
+	assert(ret == 0);
+	cat.seed = 0;
+	ret = synth_catalog_walk(&cat, save_star, &count);
+	assert(ret == -EINVAL);
+	(void)ret;
+	printf("    -> PASS\n");
+}
+
+static void test_synth_import(struct adb_db *db, int *table_id)
+{
+	const struct synth_object *object;
+	const struct adb_object *found;
+	struct adb_object_set *set;
+	struct synth_catalog cat;
+	int i, seq, ret;
+
+	printf("   Testing synth_catalog_write() and import...\n");
+	catalog_new(&cat);
+	mkdir(SYNTH_DIR, 0755);
+	mkdir(SYNTH_DIR "/S", 0755);
+	mkdir(SYNTH_DIR "/S/1", 0755);
+	ret = synth_catalog_write(&cat, SYNTH_DIR "/S/1");
+	assert(ret == 0);
+
+	*table_id = synth_catalog_import(db, "S", "1", &cat);
+	assert(*table_id >= 0);
+	assert(adb_table_get_count(db, *table_id) == OBJECTS);
+
+	/* imported objects are hashed from the table file */
+	ret = adb_table_hash_key(db, *table_id, "Seq");
+	assert(ret == -ENODATA);
+	adb_table_close(db, *table_id);
+	*table_id = adb_table_open(db, "S", "1", "synth");
+	assert(*table_id >= 0);
+
+	set = adb_table_set_new(db, *table_id);
+	assert(set != NULL);
+	adb_table_set_constraints(set, 0.0, 0.0, 2.0 * M_PI, -2.0, 18.0);
+	adb_set_get_objects(set);
+	assert(adb_set_get_count(set) == OBJECTS);
+	adb_table_set_free(set);
+
+	/* opened objects are the walked objects at the written precision */
+	ret = adb_table_hash_key(db, *table_id, "Seq");
+	assert(ret == 0);
+	for (i = 0; i < OBJECTS; i += 997) {
+		seq = stars[i].seq;
+		found = NULL;
+		ret = adb_table_get_object(db, *table_id, &seq, "Seq", &found);
+		assert(ret == 1);
+		object = (const struct synth_object *)found;
+		assert(object->seq == (unsigned int)seq);
+		assert(fabs(object->object.dec - stars[i].dec) * R2D < 1e-6);
+		assert(fabs(object->object.mag - stars[i].mag) < 0.006);
+		(void)object;
+	}
+	(void)ret;
+	printf("    -> PASS\n");
+}
+
+/* solve a plate and count the plate objects matched to their star */
+static int solve_plate(struct adb_db *db, int table_id,
+					   const struct synth_plate *plate,
+					   const struct synth_catalog *cat, int *count,
+					   enum adb_plate_fit fit, double *posn_err, double *mag_err)
+{
+	struct adb_pobject pobject[PLATE_OBJECTS + 2];
+	long seq[PLATE_OBJECTS + 2];
+	struct adb_solve_solution *solution;
+	struct adb_solve_object *sobject;
+	struct adb_object_set *set;
+	struct adb_solve *solve;
+	double fov, bright, faint, err;
+	int i, found, ret, matched = 0;
+
+	*posn_err = *mag_err = 0.0;
+
+	*count = synth_plate_new(plate, cat, pobject, seq);
+	assert(*count == plate->objects + plate->distractors);
+	for (i = 1; i < *count; i++)
+		assert(pobject[i].adu <= pobject[i - 1].adu);
+
+	fov = 1.2 * plate->scale * hypot(plate->width, plate->height);
+	bright = plate->zero_point - 2.5 * log10(pobject[0].adu) - 1.0;
+	faint = plate->zero_point - 2.5 * log10(pobject[*count - 1].adu) + 1.0;
+
+	set = adb_table_set_new(db, table_id);
+	assert(set != NULL);
+	adb_table_set_constraints(set, plate->ra, plate->dec, 10.0 * D2R, -2.0,
+							  18.0);
+
+	solve = adb_solve_new(db, table_id);
+	assert(solve != NULL);
+	adb_solve_constraint(solve, ADB_CONSTRAINT_MAG, faint, bright);
+	adb_solve_constraint(solve, ADB_CONSTRAINT_FOV, 0.1 * D2R, fov);
+	for (i = 0; i < *count; i++)
+		adb_solve_add_plate_object(solve, &pobject[i]);
+	adb_solve_set_magnitude_delta(solve, 0.5);
+	adb_solve_set_distance_delta(solve, 5.0);
+	adb_solve_set_pa_delta(solve, 2.0 * D2R);
+	ret = adb_solve_set_plate_fit(solve, fit);
+	assert(ret == 0);
+
+	found = adb_solve(solve, set, ADB_FIND_FIRST);
+	if (found > 0) {
+		solution = adb_solve_get_solution(solve, 0);
+		ret = adb_solution_set_search_limits(solution, fov, faint, table_id);
+		assert(ret == 0);
+		ret = adb_solution_add_pobjects(solution, pobject, *count);
+		assert(ret == 0);
+		adb_solution_get_objects(solution);
+		ret = adb_solution_calc_astrometry(solution);
+		assert(ret == 0);
+		ret = adb_solution_calc_photometry(solution);
+		assert(ret == 0);
+
+		for (i = 0; i < *count; i++) {
+			sobject = adb_solution_get_object(solution, i);
+			assert(sobject != NULL);
+			if (sobject->object == NULL)
+				continue;
+			if (seq[i] == SYNTH_DISTRACTOR ||
+				((const struct synth_object *)sobject->object)->seq != seq[i])
+				continue;
+			matched++;
+
+			/* worst fitted position in pixels and magnitude */
+			err = sin(sobject->dec) * sin(sobject->object->dec) +
+				  cos(sobject->dec) * cos(sobject->object->dec) *
+					  cos(sobject->ra - sobject->object->ra);
+			err = acos(fmin(1.0, err));
+			*posn_err = fmax(*posn_err, err / plate->scale);
+			*mag_err = fmax(*mag_err, fabs(sobject->mag - sobject->object->mag));
+		}
+	}
+
+	(void)ret;
+
+	adb_solve_free(solve);
+	adb_table_set_free(set);
+	return matched;
+}
+
+static void test_synth_solve(struct adb_db *db, int table_id)
+{
+	struct synth_catalog cat;
+	struct synth_plate plate;
+	double posn_err, mag_err;
+	int matched, count;
+
+	printf("   Testing synth_plate_new() solves...\n");
+	catalog_new(&cat);
+
+	/* exact plate */
+	synth_plate_init(&plate, 0.0, 0.0);
+	synth_plate_random(&plate, 7);
+	plate.objects = PLATE_OBJECTS;
+	plate.noise = 0.0;
+	plate.mag_noise = 0.0;
+	matched = solve_plate(db, table_id, &plate, &cat, &count,
+						  ADB_PLATE_FIT_PAIRS, &posn_err, &mag_err);
+	printf("    exact plate matched %d of %d\n", matched, count);
+	assert(matched >= 4);
+
+	/* noisy plate missing its brightest star with two distractors */
+	plate.noise = 0.5;
+	plate.mag_noise = 0.05;
+	plate.skip = 1;
+	plate.distractors = 2;
+	matched = solve_plate(db, table_id, &plate, &cat, &count,
+						  ADB_PLATE_FIT_PAIRS, &posn_err, &mag_err);
+	printf("    noisy plate matched %d of %d\n", matched, count);
+	assert(matched >= 4);
+	printf("    -> PASS\n");
+}
+
+static void test_synth_fit(struct adb_db *db, int table_id)
+{
+	struct synth_catalog cat;
+	struct synth_plate plate;
+	double posn_err, mag_err;
+	int matched, count;
+
+	printf("   Testing solution astrometry and photometry fits...\n");
+	catalog_new(&cat);
+	synth_plate_init(&plate, 0.0, 0.0);
+	synth_plate_random(&plate, 7);
+	plate.objects = PLATE_OBJECTS;
+	plate.noise = 0.0;
+	plate.mag_noise = 0.0;
+
+	matched = solve_plate(db, table_id, &plate, &cat, &count,
+						  ADB_PLATE_FIT_PAIRS, &posn_err, &mag_err);
+	printf("    pair fit matched %d, error %.3f pixels %.3f mag\n", matched,
+		   posn_err, mag_err);
+	assert(matched >= 4);
+	assert(mag_err < 0.05);
+
+	matched = solve_plate(db, table_id, &plate, &cat, &count,
+						  ADB_PLATE_FIT_LSQ, &posn_err, &mag_err);
+	printf("    lsq fit matched %d, error %.3f pixels %.3f mag\n", matched,
+		   posn_err, mag_err);
+	assert(matched >= 4);
+	assert(posn_err < 1.0);
+	assert(mag_err < 0.05);
+
+	/* position noise stays within its own size */
+	plate.noise = 0.5;
+	matched = solve_plate(db, table_id, &plate, &cat, &count,
+						  ADB_PLATE_FIT_LSQ, &posn_err, &mag_err);
+	printf("    noisy lsq fit matched %d, error %.3f pixels\n", matched,
+		   posn_err);
+	assert(matched >= 4);
+	assert(posn_err < 2.0);
+
+	printf("    -> PASS\n");
+}
+
+int main(void)
+{
+	struct adb_library *lib;
+	struct adb_db *db;
+	int table_id;
+
+	printf("Starting Synthetic Catalog Unit Tests...\n");
+
+	test_synth_walk();
+
+	lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", SYNTH_DIR);
+	assert(lib != NULL);
+	db = adb_create_db(lib, 7, 1);
+	assert(db != NULL);
+	adb_set_msg_level(db, ADB_MSG_NONE);
+
+	test_synth_import(db, &table_id);
+	test_synth_solve(db, table_id);
+	test_synth_fit(db, table_id);
+
+	adb_table_close(db, table_id);
+	adb_db_free(db);
+	adb_close_library(lib);
+
+	printf("All Synthetic Catalog Unit Tests Passed Successfully!\n");
+	return 0;
+}
@@ -6,6 +6,7 @@
 /* clang-format off */
 #include <libastrodb/db.h>
 #include <libastrodb/object.h>
+#include "../src/alloc.h"
 #include "../src/lib.h"
 #include "../src/htm.h"
 #include "../src/table.h"
@@ -104,6 +105,91 @@ static void test_table_read_and_insert(void) {
   printf("    -> PASS\n");
 }
 
+static void test_table_alloc_large(void) {
+  printf("   Testing alloc_large() placement policies...\n");
+  static const unsigned int policy[] = {
+      ADB_ALLOC_HUGEPAGE, ADB_ALLOC_HUGETLB,
+      ADB_ALLOC_HUGEPAGE | ADB_ALLOC_INTERLEAVE | ADB_ALLOC_BIND_WORKERS};
+  struct adb_db db;
+  size_t mapped, size = 2 * ALLOC_HUGE_PAGE + 1;
+  unsigned char *array;
+  unsigned int i;
+
+  memset(&db, 0, sizeof(db));
+
+  /* the default policy and small arrays stay on the heap */
+  array = alloc_large(&db, size, &mapped);
+  assert(array != NULL && mapped == 0);
+  alloc_free_large(array, mapped);
+
+  for (i = 0; i < sizeof(policy) / sizeof(policy[0]); i++) {
+    db.alloc = policy[i];
+
+    array = alloc_large(&db, 4096, &mapped);
+    assert(array != NULL && mapped == 0);
+    alloc_free_large(array, mapped);
+
+    /* large arrays are zeroed, aligned huge page multiples */
+    array = alloc_large(&db, size, &mapped);
+    assert(array != NULL);
+    assert(mapped >= size && mapped % ALLOC_HUGE_PAGE == 0);
+    assert(((size_t)array & (ALLOC_HUGE_PAGE - 1)) == 0);
+    assert(array[0] == 0 && array[size / 2] == 0 && array[size - 1] == 0);
+    memset(array, 0xa5, size);
+    alloc_free_large(array, mapped);
+  }
+
+  printf("    -> PASS\n");
+}
+
+static void test_table_alloc_db(void) {
+  printf("   Testing adb_create_db_alloc() tables...\n");
+  struct adb_library *lib =
+      adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+  assert(lib != NULL);
+
+  struct adb_db *db = adb_create_db(lib, 7, 1);
+  struct adb_db *placed = adb_create_db_alloc(
+      lib, 7, 1, ADB_MESH_FULL,
+      ADB_ALLOC_HUGEPAGE | ADB_ALLOC_INTERLEAVE | ADB_ALLOC_BIND_WORKERS);
+  assert(db != NULL && placed != NULL);
+
+  int id = adb_table_open(db, "V", "109", "sky2kv4");
+  int placed_id = adb_table_open(placed, "V", "109", "sky2kv4");
+  assert(id >= 0 && placed_id >= 0);
+
+  /* placement never changes what queries find */
+  struct adb_object_set *set = adb_table_set_new(db, id);
+  struct adb_object_set *placed_set = adb_table_set_new(placed, placed_id);
+  assert(set != NULL && placed_set != NULL);
+  int ret = adb_table_set_constraints(set, 1.0, 0.5, 0.3, -2.0, 8.0);
+  assert(ret == 0);
+  ret = adb_table_set_constraints(placed_set, 1.0, 0.5, 0.3, -2.0, 8.0);
+  assert(ret == 0);
+  int heads = adb_set_get_objects(set);
+  ret = adb_set_get_objects(placed_set);
+  assert(heads == ret);
+  assert(adb_set_get_count(set) > 0);
+  assert(adb_set_get_count(set) == adb_set_get_count(placed_set));
+  const struct adb_object *nearest =
+      adb_table_set_get_nearest_on_pos(set, 1.0, 0.5);
+  assert(nearest != NULL);
+  nearest = adb_table_set_get_nearest_on_pos(placed_set, 1.0, 0.5);
+  assert(nearest != NULL);
+  (void)heads;
+  (void)nearest;
+  (void)ret;
+
+  adb_table_set_free(set);
+  adb_table_set_free(placed_set);
+  adb_table_close(db, id);
+  adb_table_close(placed, placed_id);
+  adb_db_free(db);
+  adb_db_free(placed);
+  adb_close_library(lib);
+  printf("    -> PASS\n");
+}
+
 int main(void) {
   printf("Starting Table Unit Tests...\n");
 
@@ -113,6 +199,8 @@ int main(void) {
   test_table_depth();
   test_table_hashmap();
   test_table_read_and_insert();
+  test_table_alloc_large();
+  test_table_alloc_db();
 
   printf("All Table Unit Tests Passed Successfully!\n");
   return 0;
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <libastrodb/db.h>
+#include <libastrodb/db-import.h>
+#include <libastrodb/object.h>
+#include <libastrodb/search.h>
+
+#define D2R (1.7453292519943295769e-2)
+
+#define THREADS 4
+#define ROUNDS 8
+#define CLIPS 6
+#define LOOKUPS 16
+#define RADIUS_SIZE 64
+
+/* clip centres and fov in degrees */
+static const double clips[CLIPS][3] = {
+	{ 56.75, 24.12, 2.0 },	{ 0.0, 0.0, 4.0 },	 { 180.0, -45.0, 6.0 },
+	{ 270.0, 66.5, 10.0 },	{ 83.8, -5.4, 3.0 }, { 0.0, 0.0, 360.0 },
+};
+
+/* results of every query, from one thread before threads start */
+struct results {
+	int clip[CLIPS];
+	int search[CLIPS];
+	const struct adb_object *nearest[CLIPS];
+	int radius[CLIPS];
+	const struct adb_object *lookup[LOOKUPS];
+};
+
+struct worker {
+	pthread_t thread;
+	struct adb_db *db;
+	int table_id;
+	int errors;
+};
+
+static int hd[LOOKUPS];
+static struct results reference;
+
+/* run every query with a private set and search */
+static int run_queries(struct adb_db *db, int table_id, struct results *r)
+{
+	const struct adb_object *radius[RADIUS_SIZE];
+	const struct adb_object **objects;
+	struct adb_object_set *set;
+	struct adb_search *search;
+	double ra, dec;
+	int i, ret;
+
+	set = adb_table_set_new(db, table_id);
+	if (set == NULL)
+		return -ENOMEM;
+
+	search = adb_search_new(db, table_id);
+	if (search == NULL) {
+		adb_table_set_free(set);
+		return -ENOMEM;
+	}
+
+	adb_search_add_comparator(search, "Vmag", ADB_COMP_LT, "6");
+	adb_search_add_comparator(search, "RV", ADB_COMP_GT, "0");
+	adb_search_add_operator(search, ADB_OP_AND);
+
+	for (i = 0; i < CLIPS; i++) {
+		ra = clips[i][0] * D2R;
+		dec = clips[i][1] * D2R;
+
+		ret = adb_table_set_constraints(set, ra, dec, clips[i][2] * D2R,
+										-2.0, 16.0);
+		if (ret < 0)
+			goto out;
+
+		adb_set_get_objects(set);
+		r->clip[i] = adb_set_get_count(set);
+		r->search[i] = adb_search_get_results(search, set, &objects);
+		r->nearest[i] = adb_table_set_get_nearest_on_pos(set, ra, dec);
+		r->radius[i] = adb_table_set_get_within_radius(set, ra, dec, D2R,
+													   radius, RADIUS_SIZE);
+	}
+
+	for (i = 0; i < LOOKUPS; i++) {
+		r->lookup[i] = NULL;
+		adb_table_get_object(db, table_id, &hd[i], "HD", &r->lookup[i]);
+	}
+	ret = 0;
+
+out:
+	adb_search_free(search);
+	adb_table_set_free(set);
+	return ret;
+}
+
+static void *worker_run(void *data)
+{
+	struct worker *w = data;
+	struct results r;
+	int i;
+
+	for (i = 0; i < ROUNDS; i++) {
+		memset(&r, 0, sizeof(r));
+		if (run_queries(w->db, w->table_id, &r) < 0 ||
+			memcmp(&r, &reference, sizeof(r)))
+			w->errors++;
+	}
+
+	return NULL;
+}
+
+static void test_threads_frozen(void)
+{
+	struct worker workers[THREADS];
+	struct adb_db_stats once, total;
+	const struct adb_object *object;
+	struct adb_library *lib;
+	struct adb_db *db;
+	int table_id, offset, i, stats, errors = 0, ret;
+
+	printf("Running Frozen Concurrent Query Test...\n");
+
+	lib = adb_open_library("cdsarc.u-strasbg.fr", "/pub/cats", "tests");
+	assert(lib != NULL);
+	db = adb_create_db(lib, 7, 1);
+	assert(db != NULL);
+
+	/* lazy tables are fully loaded by the freeze */
+	adb_set_table_load(db, ADB_TABLE_LOAD_LAZY);
+	adb_set_workers(db, 2);
+
+	table_id = adb_table_open(db, "V", "109", "sky2kv4");
+	assert(table_id >= 0);
+	ret = adb_table_hash_key(db, table_id, "HD");
+	assert(ret == 0);
+
+	ret = adb_db_freeze(db);
+	assert(ret == 0);
+
+	/* hash look up the HD numbers of objects spread over the sky */
+	{
+		struct adb_object_set *set = adb_table_set_new(db, table_id);
+		const struct adb_object_head *head;
+		int heads, count, step, n = 0, j, k = 0;
+
+		assert(set != NULL);
+		adb_table_set_constraints(set, 0.0, 0.0, 2.0 * M_PI, -2.0, 16.0);
+		heads = adb_set_get_objects(set);
+		assert(heads > 0);
+		count = adb_set_get_count(set);
+		assert(count >= LOOKUPS);
+		step = count / LOOKUPS;
+
+		offset = adb_table_get_field_offset(db, table_id, "HD");
+		assert(offset >= 0);
+		head = adb_set_get_head(set);
+		for (i = 0; i < heads && n < LOOKUPS; i++) {
+			object = head[i].objects;
+			for (j = 0; j < head[i].count && n < LOOKUPS; j++, k++) {
+				if (k % step == 0)
+					memcpy(&hd[n++], (const char *)object + offset,
+						   sizeof(int));
+				object = (const void *)object +
+						 adb_table_get_object_size(db, table_id);
+			}
+		}
+		assert(n == LOOKUPS);
+		adb_table_set_free(set);
+	}
+
+	adb_db_reset_stats(db);
+	ret = run_queries(db, table_id, &reference);
+	assert(ret == 0);
+	stats = adb_db_get_stats(db, &once) == 0;
+	for (i = 0; i < CLIPS; i++) {
+		printf("   clip %d objects %d search %d radius %d\n", i,
+			   reference.clip[i], reference.search[i], reference.radius[i]);
+		assert(reference.clip[i] > 0);
+		assert(reference.nearest[i] != NULL);
+	}
+	for (i = 0; i < LOOKUPS; i++)
+		assert(reference.lookup[i] != NULL);
+
+	/* the tables can not change under the queries */
+	ret = adb_table_hash_key(db, table_id, "Name");
+	assert(ret == -EBUSY);
+	ret = adb_table_open(db, "V", "109", "sky2kv4");
+	assert(ret == -EBUSY);
+	ret = adb_table_close(db, table_id);
+	assert(ret == -EBUSY);
+
+	adb_db_reset_stats(db);
+	for (i = 0; i < THREADS; i++) {
+		workers[i].db = db;
+		workers[i].table_id = table_id;
+		workers[i].errors = 0;
+		ret = pthread_create(&workers[i].thread, NULL, worker_run,
+							 &workers[i]);
+		assert(ret == 0);
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		pthread_join(workers[i].thread, NULL);
+		errors += workers[i].errors;
+	}
+	printf("   %d threads x %d rounds, %d mismatches\n", THREADS, ROUNDS,
+		   errors);
+	assert(errors == 0);
+
+	/* per thread counters sum to every round of the reference queries */
+	if (stats) {
+		ret = adb_db_get_stats(db, &total);
+		assert(ret == 0);
+		printf("   clips %lu trixels %lu kd nodes %lu hash probes %lu\n",
+			   (unsigned long)once.clips, (unsigned long)once.trixels,
+			   (unsigned long)once.kd_nodes, (unsigned long)once.hash_probes);
+		assert(once.clips == CLIPS && once.searches == CLIPS);
+		assert(once.hash_lookups == LOOKUPS);
+		assert(once.trixels > 0 && once.heads > 0 && once.kd_nodes > 0);
+		assert(once.hash_probes >= LOOKUPS && once.objects_tested > 0);
+		for (i = 0; i < (int)(sizeof(once) / sizeof(uint64_t)); i++)
+			assert(((uint64_t *)&total)[i] ==
+				   ((uint64_t *)&once)[i] * THREADS * ROUNDS);
+	}
+
+	adb_db_thaw(db);
+	ret = adb_table_close(db, table_id);
+	assert(ret == 0);
+	(void)ret;
+	adb_db_free(db);
+	adb_close_library(lib);
+
+	printf(" -> PASS\n");
+}
+
+int main(void)
+{
+	printf("Starting Thread Unit Tests...\n");
+	test_threads_frozen();
+	printf("All Thread Unit Tests Passed Successfully!\n");
+	return 0;
+}